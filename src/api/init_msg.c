@@ -193,3 +193,25 @@ void slurm_init_trigger_msg (trigger_info_t *trigger_info_msg)
 	memset(trigger_info_msg, 0, sizeof(trigger_info_t));
 	trigger_info_msg->user_id = NO_VAL;
 }
+
+/*
+ * slurm_init_job_info_filter - initialize job information filter to match
+ *	all jobs and return all fields
+ * OUT filter - user defined job information filter
+ */
+void slurm_init_job_info_filter (job_info_filter_t *filter)
+{
+	memset(filter, 0, sizeof(job_info_filter_t));
+	filter->field_mask = JOB_FIELD_ALL;
+}
+
+/*
+ * slurm_init_node_info_filter - initialize node information filter to match
+ *	all nodes and return all fields
+ * OUT filter - user defined node information filter
+ */
+void slurm_init_node_info_filter (node_info_filter_t *filter)
+{
+	memset(filter, 0, sizeof(node_info_filter_t));
+	filter->field_mask = NODE_FIELD_ALL;
+}
@@ -1151,6 +1151,24 @@ line15:
 extern int
 slurm_load_jobs (time_t update_time, job_info_msg_t **job_info_msg_pptr,
 		 uint16_t show_flags)
+{
+	return slurm_load_jobs_filter(update_time, job_info_msg_pptr,
+				      show_flags, NULL);
+}
+
+/*
+ * slurm_load_jobs_filter - issue RPC to get slurm configuration information
+ *	for jobs matching a filter if changed since update_time
+ * IN update_time - time of current configuration data
+ * IN/OUT job_info_msg_pptr - place to store a job configuration pointer
+ * IN show_flags - job filtering options
+ * IN filter - jobs and fields to return, NULL for all
+ * RET 0 or -1 on error
+ * NOTE: free the response using slurm_free_job_info_msg
+ */
+extern int
+slurm_load_jobs_filter (time_t update_time, job_info_msg_t **job_info_msg_pptr,
+			uint16_t show_flags, job_info_filter_t *filter)
 {
 	int rc;
 	slurm_msg_t resp_msg;
@@ -1162,6 +1180,7 @@ slurm_load_jobs (time_t update_time, job_info_msg_t **job_info_msg_pptr,
 
 	req.last_update  = update_time;
 	req.show_flags   = show_flags;
+	req.filter       = filter;
 	req_msg.msg_type = REQUEST_JOB_INFO;
 	req_msg.data     = &req;
 
@@ -1186,6 +1205,124 @@ slurm_load_jobs (time_t update_time, job_info_msg_t **job_info_msg_pptr,
 	return SLURM_PROTOCOL_SUCCESS;
 }
 
+typedef struct {
+	uint32_t job_id;
+	uint32_t inx;		/* index into delta_msg->job_array */
+} delta_job_t;
+
+static int _cmp_delta_job(const void *a, const void *b)
+{
+	uint32_t job_id_a = ((delta_job_t *) a)->job_id;
+	uint32_t job_id_b = ((delta_job_t *) b)->job_id;
+
+	if (job_id_a < job_id_b)
+		return -1;
+	if (job_id_a > job_id_b)
+		return 1;
+	return 0;
+}
+
+/* Merge the records of old_msg, replaced, added and removed as specified by
+ * delta_msg, into delta_msg. Job order is preserved, new jobs are added at
+ * the end. old_msg is left with no records. */
+static void _merge_job_info_msg(job_info_msg_t *old_msg,
+				job_info_msg_t *delta_msg)
+{
+	delta_job_t *updated, *removed, key, *match;
+	bool *used;
+	job_info_t *job_array;
+	uint32_t i, cnt = 0;
+
+	updated = xmalloc(sizeof(delta_job_t) * (delta_msg->record_count + 1));
+	for (i = 0; i < delta_msg->record_count; i++) {
+		updated[i].job_id = delta_msg->job_array[i].job_id;
+		updated[i].inx = i;
+	}
+	qsort(updated, delta_msg->record_count, sizeof(delta_job_t),
+	      _cmp_delta_job);
+	removed = xmalloc(sizeof(delta_job_t) * (delta_msg->removed_cnt + 1));
+	for (i = 0; i < delta_msg->removed_cnt; i++)
+		removed[i].job_id = delta_msg->removed_ids[i];
+	qsort(removed, delta_msg->removed_cnt, sizeof(delta_job_t),
+	      _cmp_delta_job);
+	used = xmalloc(sizeof(bool) * (delta_msg->record_count + 1));
+
+	job_array = xmalloc(sizeof(job_info_t) *
+			    (old_msg->record_count + delta_msg->record_count));
+	for (i = 0; i < old_msg->record_count; i++) {
+		key.job_id = old_msg->job_array[i].job_id;
+		match = bsearch(&key, updated, delta_msg->record_count,
+				sizeof(delta_job_t), _cmp_delta_job);
+		if (match) {
+			slurm_free_job_info_members(&old_msg->job_array[i]);
+			memcpy(&job_array[cnt++],
+			       &delta_msg->job_array[match->inx],
+			       sizeof(job_info_t));
+			used[match->inx] = true;
+		} else if (bsearch(&key, removed, delta_msg->removed_cnt,
+				   sizeof(delta_job_t), _cmp_delta_job)) {
+			slurm_free_job_info_members(&old_msg->job_array[i]);
+		} else {
+			memcpy(&job_array[cnt++], &old_msg->job_array[i],
+			       sizeof(job_info_t));
+		}
+	}
+	for (i = 0; i < delta_msg->record_count; i++) {
+		if (!used[i]) {
+			memcpy(&job_array[cnt++], &delta_msg->job_array[i],
+			       sizeof(job_info_t));
+		}
+	}
+	xfree(updated);
+	xfree(removed);
+	xfree(used);
+
+	xfree(old_msg->job_array);
+	old_msg->record_count = 0;
+	xfree(delta_msg->job_array);
+	delta_msg->job_array = job_array;
+	delta_msg->record_count = cnt;
+	delta_msg->delta = 0;
+	xfree(delta_msg->removed_ids);
+	delta_msg->removed_cnt = 0;
+}
+
+/*
+ * slurm_load_jobs_delta - issue RPC to get slurm information about jobs
+ *	changed since an earlier response, which is updated to create the
+ *	new response
+ * IN old_job_msg - earlier response, NULL to load all job information
+ * OUT job_info_msg_pptr - place to store a job configuration pointer
+ * IN show_flags - job filtering options
+ * IN filter - jobs and fields to return, NULL for all, must be the same as
+ *	used to load old_job_msg
+ * RET 0 or -1 on error
+ * NOTE: On success, records of old_job_msg are moved to the new response.
+ *	Free both using slurm_free_job_info_msg
+ */
+extern int
+slurm_load_jobs_delta (job_info_msg_t *old_job_msg,
+		       job_info_msg_t **job_info_msg_pptr,
+		       uint16_t show_flags, job_info_filter_t *filter)
+{
+	if (old_job_msg == NULL) {
+		return slurm_load_jobs_filter((time_t) NULL, job_info_msg_pptr,
+					      show_flags & (~SHOW_DELTA),
+					      filter);
+	}
+
+	*job_info_msg_pptr = NULL;
+	if (slurm_load_jobs_filter(old_job_msg->last_update,
+				   job_info_msg_pptr, show_flags | SHOW_DELTA,
+				   filter))
+		return SLURM_ERROR;
+
+	if (*job_info_msg_pptr && (*job_info_msg_pptr)->delta)
+		_merge_job_info_msg(old_job_msg, *job_info_msg_pptr);
+
+	return SLURM_PROTOCOL_SUCCESS;
+}
+
 /*
  * slurm_load_job_user - issue RPC to get slurm information about all jobs
  *	to be run as the specified user
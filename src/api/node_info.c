@@ -455,6 +455,23 @@ slurm_sprint_node_table (node_info_t * node_ptr,
  */
 extern int slurm_load_node (time_t update_time,
 			    node_info_msg_t **resp, uint16_t show_flags)
+{
+	return slurm_load_node_filter(update_time, resp, show_flags, NULL);
+}
+
+/*
+ * slurm_load_node_filter - issue RPC to get slurm configuration information
+ *	for nodes matching a filter if changed since update_time
+ * IN update_time - time of current configuration data
+ * OUT resp - place to store a node configuration pointer
+ * IN show_flags - node filtering options
+ * IN filter - nodes and fields to return, NULL for all
+ * RET 0 or a slurm error code
+ * NOTE: free the response using slurm_free_node_info_msg
+ */
+extern int slurm_load_node_filter (time_t update_time,
+				   node_info_msg_t **resp, uint16_t show_flags,
+				   node_info_filter_t *filter)
 {
 	int rc;
 	slurm_msg_t req_msg;
@@ -465,6 +482,7 @@ extern int slurm_load_node (time_t update_time,
 	slurm_msg_t_init(&resp_msg);
 	req.last_update  = update_time;
 	req.show_flags   = show_flags;
+	req.filter       = filter;
 	req_msg.msg_type = REQUEST_NODE_INFO;
 	req_msg.data     = &req;
 
@@ -490,6 +508,79 @@ extern int slurm_load_node (time_t update_time,
 	return SLURM_PROTOCOL_SUCCESS;
 }
 
+/* Merge the records of old_msg, replaced as specified by delta_msg, into
+ * delta_msg. old_msg is left with no records.
+ * RET SLURM_ERROR if the node tables differ */
+static int _merge_node_info_msg(node_info_msg_t *old_msg,
+				node_info_msg_t *delta_msg)
+{
+	uint32_t i, inx;
+
+	if (old_msg->record_count != delta_msg->node_cnt)
+		return SLURM_ERROR;
+	for (i = 0; i < delta_msg->record_count; i++) {
+		if (delta_msg->delta_inx[i] >= old_msg->record_count)
+			return SLURM_ERROR;
+	}
+
+	for (i = 0; i < delta_msg->record_count; i++) {
+		inx = delta_msg->delta_inx[i];
+		slurm_free_node_info_members(&old_msg->node_array[inx]);
+		memcpy(&old_msg->node_array[inx], &delta_msg->node_array[i],
+		       sizeof(node_info_t));
+	}
+	xfree(delta_msg->node_array);
+	delta_msg->node_array = old_msg->node_array;
+	delta_msg->record_count = old_msg->record_count;
+	delta_msg->delta = 0;
+	delta_msg->node_cnt = 0;
+	xfree(delta_msg->delta_inx);
+	old_msg->node_array = NULL;
+	old_msg->record_count = 0;
+
+	return SLURM_SUCCESS;
+}
+
+/*
+ * slurm_load_node_delta - issue RPC to get slurm information about nodes
+ *	changed since an earlier response, which is updated to create the
+ *	new response
+ * IN old_node_msg - earlier response, NULL to load all node information
+ * OUT resp - place to store a node configuration pointer
+ * IN show_flags - node filtering options
+ * IN filter - nodes and fields to return, NULL for all, must be the same as
+ *	used to load old_node_msg
+ * RET 0 or a slurm error code
+ * NOTE: On success, records of old_node_msg are moved to the new response.
+ *	Free both using slurm_free_node_info_msg
+ */
+extern int slurm_load_node_delta (node_info_msg_t *old_node_msg,
+				  node_info_msg_t **resp, uint16_t show_flags,
+				  node_info_filter_t *filter)
+{
+	if (old_node_msg == NULL) {
+		return slurm_load_node_filter((time_t) NULL, resp,
+					      show_flags & (~SHOW_DELTA),
+					      filter);
+	}
+
+	if (slurm_load_node_filter(old_node_msg->last_update, resp,
+				   show_flags | SHOW_DELTA, filter))
+		return SLURM_ERROR;
+
+	if (*resp && (*resp)->delta &&
+	    (_merge_node_info_msg(old_node_msg, *resp) != SLURM_SUCCESS)) {
+		/* Node table changed, should not happen */
+		slurm_free_node_info_msg(*resp);
+		*resp = NULL;
+		return slurm_load_node_filter((time_t) NULL, resp,
+					      show_flags & (~SHOW_DELTA),
+					      filter);
+	}
+
+	return SLURM_PROTOCOL_SUCCESS;
+}
+
 /*
  * slurm_load_node_single - issue RPC to get slurm configuration information
  *	for a specific node
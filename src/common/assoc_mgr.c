@@ -2736,8 +2736,10 @@ extern int assoc_mgr_update_assocs(slurmdb_update_object_t *update)
 				}
 			}
 
-			if (object->grp_cpu_mins != (uint64_t)NO_VAL)
+			if (object->grp_cpu_mins != (uint64_t)NO_VAL) {
+				update_jobs = true;
 				rec->grp_cpu_mins = object->grp_cpu_mins;
+			}
 			if (object->grp_cpu_run_mins != (uint64_t)NO_VAL)
 				rec->grp_cpu_run_mins =
 					object->grp_cpu_run_mins;
@@ -2767,8 +2769,10 @@ extern int assoc_mgr_update_assocs(slurmdb_update_object_t *update)
 				resort = 1;
 			}
 
-			if (object->max_cpu_mins_pj != (uint64_t)NO_VAL)
+			if (object->max_cpu_mins_pj != (uint64_t)NO_VAL) {
+				update_jobs = true;
 				rec->max_cpu_mins_pj = object->max_cpu_mins_pj;
+			}
 			if (object->max_cpu_run_mins != (uint64_t)NO_VAL)
 				rec->max_cpu_run_mins =
 					object->max_cpu_run_mins;
@@ -3381,8 +3385,10 @@ extern int assoc_mgr_update_qos(slurmdb_update_object_t *update)
 
 			if (object->grace_time != NO_VAL)
 				rec->grace_time = object->grace_time;
-			if (object->grp_cpu_mins != (uint64_t)NO_VAL)
+			if (object->grp_cpu_mins != (uint64_t)NO_VAL) {
+				update_jobs = true;
 				rec->grp_cpu_mins = object->grp_cpu_mins;
+			}
 			if (object->grp_cpu_run_mins != (uint64_t)NO_VAL)
 				rec->grp_cpu_run_mins =
 					object->grp_cpu_run_mins;
@@ -3407,8 +3413,10 @@ extern int assoc_mgr_update_qos(slurmdb_update_object_t *update)
 				rec->grp_wall = object->grp_wall;
 			}
 
-			if (object->max_cpu_mins_pj != (uint64_t)NO_VAL)
+			if (object->max_cpu_mins_pj != (uint64_t)NO_VAL) {
+				update_jobs = true;
 				rec->max_cpu_mins_pj = object->max_cpu_mins_pj;
+			}
 			if (object->max_cpu_run_mins_pu != (uint64_t)NO_VAL)
 				rec->max_cpu_run_mins_pu =
 					object->max_cpu_run_mins_pu;
@@ -0,0 +1,246 @@
+/*****************************************************************************\
+ *  bitrle.c - run length encoded bitmaps
+ *****************************************************************************
+ *  Copyright (C) 2015 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <string.h>
+
+#include "src/common/bitrle.h"
+#include "src/common/log.h"
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#define BITRLE_MAGIC	0x42524c45
+
+struct bitrle {
+	uint32_t magic;
+	bitoff_t nbits;		/* size of the bitmap in bits */
+	int32_t set_cnt;	/* count of bits set */
+	int32_t run_cnt;	/* count of runs of set bits */
+	bitoff_t *run;		/* first and last bit of each run, in order */
+};
+
+/* Allocate a bitrle_t with space for run_cnt runs in the same block */
+static bitrle_t *_rle_alloc(bitoff_t nbits, int32_t run_cnt)
+{
+	bitrle_t *r;
+
+	r = xmalloc(sizeof(bitrle_t) + (run_cnt * 2 * sizeof(bitoff_t)));
+	r->magic = BITRLE_MAGIC;
+	r->nbits = nbits;
+	r->run_cnt = run_cnt;
+	r->run = (bitoff_t *) (r + 1);
+	return r;
+}
+
+/* Return the index of the run containing bit, or -1 if bit is clear */
+static int32_t _rle_find(bitrle_t *r, bitoff_t bit)
+{
+	int32_t lo = 0, hi = r->run_cnt - 1, mid;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (bit < r->run[mid * 2])
+			hi = mid - 1;
+		else if (bit > r->run[mid * 2 + 1])
+			lo = mid + 1;
+		else
+			return mid;
+	}
+	return -1;
+}
+
+extern bitrle_t *bit_rle_from_bitstr(bitstr_t *b)
+{
+	bitoff_t nbits = bit_size(b), first, end;
+	int32_t run_cnt = 0, i;
+	bitrle_t *r;
+
+	/* Count the runs, then record them */
+	for (end = 0; (end < nbits) &&
+		      ((first = bit_ffs_from_bit(b, end)) != -1); run_cnt++) {
+		end = bit_ffc_from_bit(b, first);
+		if (end == -1)
+			end = nbits;
+	}
+
+	r = _rle_alloc(nbits, run_cnt);
+	for (i = 0, end = 0; i < run_cnt; i++) {
+		first = bit_ffs_from_bit(b, end);
+		end = bit_ffc_from_bit(b, first);
+		if (end == -1)
+			end = nbits;
+		r->run[i * 2]     = first;
+		r->run[i * 2 + 1] = end - 1;
+		r->set_cnt += end - first;
+	}
+	return r;
+}
+
+extern bitstr_t *bit_rle_to_bitstr(bitrle_t *r)
+{
+	bitstr_t *b;
+
+	xassert(r->magic == BITRLE_MAGIC);
+	b = bit_alloc(r->nbits);
+	bit_rle_or(b, r);
+	return b;
+}
+
+extern bitrle_t *bit_rle_copy(bitrle_t *r)
+{
+	bitrle_t *new;
+
+	xassert(r->magic == BITRLE_MAGIC);
+	new = _rle_alloc(r->nbits, r->run_cnt);
+	new->set_cnt = r->set_cnt;
+	memcpy(new->run, r->run, r->run_cnt * 2 * sizeof(bitoff_t));
+	return new;
+}
+
+extern void bit_rle_free(bitrle_t *r)
+{
+	xassert(r->magic == BITRLE_MAGIC);
+	r->magic = ~BITRLE_MAGIC;
+	xfree(r);
+}
+
+extern bitoff_t bit_rle_size(bitrle_t *r)
+{
+	xassert(r->magic == BITRLE_MAGIC);
+	return r->nbits;
+}
+
+extern int bit_rle_test(bitrle_t *r, bitoff_t bit)
+{
+	xassert(r->magic == BITRLE_MAGIC);
+	xassert((bit >= 0) && (bit < r->nbits));
+	return (_rle_find(r, bit) != -1) ? 1 : 0;
+}
+
+extern int32_t bit_rle_set_count(bitrle_t *r)
+{
+	xassert(r->magic == BITRLE_MAGIC);
+	return r->set_cnt;
+}
+
+extern int32_t bit_rle_overlap(bitrle_t *r, bitstr_t *b)
+{
+	int32_t count = 0, i;
+
+	xassert(r->magic == BITRLE_MAGIC);
+	xassert(bit_size(b) == r->nbits);
+	for (i = 0; i < r->run_cnt; i++) {
+		count += bit_set_count_range(b, r->run[i * 2],
+					     r->run[i * 2 + 1] + 1);
+	}
+	return count;
+}
+
+extern void bit_rle_or(bitstr_t *b, bitrle_t *r)
+{
+	int32_t i;
+
+	xassert(r->magic == BITRLE_MAGIC);
+	xassert(bit_size(b) == r->nbits);
+	for (i = 0; i < r->run_cnt; i++)
+		bit_nset(b, r->run[i * 2], r->run[i * 2 + 1]);
+}
+
+extern void bit_rle_and_not(bitstr_t *b, bitrle_t *r)
+{
+	int32_t i;
+
+	xassert(r->magic == BITRLE_MAGIC);
+	xassert(bit_size(b) == r->nbits);
+	for (i = 0; i < r->run_cnt; i++)
+		bit_nclear(b, r->run[i * 2], r->run[i * 2 + 1]);
+}
+
+extern char *bit_rle_fmt(bitrle_t *r)
+{
+	char *str = NULL, *sep = "";
+	int32_t i;
+
+	xassert(r->magic == BITRLE_MAGIC);
+	for (i = 0; i < r->run_cnt; i++) {
+		if (r->run[i * 2] == r->run[i * 2 + 1]) {
+			xstrfmtcat(str, "%s%d", sep, (int) r->run[i * 2]);
+		} else {
+			xstrfmtcat(str, "%s%d-%d", sep, (int) r->run[i * 2],
+				   (int) r->run[i * 2 + 1]);
+		}
+		sep = ",";
+	}
+	if (!str)
+		str = xstrdup("");
+	return str;
+}
+
+extern bitrle_t *bit_rle_unfmt(bitoff_t nbits, char *str)
+{
+	int32_t *intvec, pair_cnt, run_cnt = 0, i;
+	bitrle_t *r;
+
+	if (!str || (str[0] == '\0'))
+		return _rle_alloc(nbits, 0);
+	if (!(intvec = bitfmt2int(str)))
+		return NULL;
+	for (pair_cnt = 0; intvec[pair_cnt * 2] != -1; pair_cnt++)
+		;
+
+	r = _rle_alloc(nbits, pair_cnt);
+	for (i = 0; i < pair_cnt; i++) {
+		bitoff_t first = intvec[i * 2], last = intvec[i * 2 + 1];
+
+		if ((first > last) || (last >= nbits) ||
+		    (run_cnt && (first <= r->run[run_cnt * 2 - 1]))) {
+			error("%s: invalid bitmap string %s", __func__, str);
+			xfree(intvec);
+			bit_rle_free(r);
+			return NULL;
+		}
+		if (run_cnt && (first == (r->run[run_cnt * 2 - 1] + 1))) {
+			r->run[run_cnt * 2 - 1] = last;	/* adjacent, merge */
+		} else {
+			r->run[run_cnt * 2]     = first;
+			r->run[run_cnt * 2 + 1] = last;
+			run_cnt++;
+		}
+		r->set_cnt += last - first + 1;
+	}
+	r->run_cnt = run_cnt;
+	xfree(intvec);
+	return r;
+}
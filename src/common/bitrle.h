@@ -0,0 +1,100 @@
+/*****************************************************************************\
+ *  bitrle.h - run length encoded bitmaps
+ *****************************************************************************
+ *  Copyright (C) 2015 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _BITRLE_H
+#define _BITRLE_H
+
+#include "src/common/bitstring.h"
+
+/*
+ * A bitrle_t holds the same bits as a bitstr_t of the same size, stored as
+ * a sorted list of runs of set bits. Its size depends upon how fragmented
+ * the set bits are, not upon the size of the bitmap, so it is suited for
+ * long lived, rarely changed bitmaps over all of a cluster's nodes or cores
+ * which are mostly long runs of set or clear bits (e.g. a reservation's
+ * cores). A bitrle_t is not modified once built: build a bitstr_t and
+ * convert it, or combine a bitrle_t into a bitstr_t with bit_rle_or() and
+ * bit_rle_and_not().
+ */
+typedef struct bitrle bitrle_t;
+
+/* Build a bitrle_t with the same bits as b, free with bit_rle_free() */
+extern bitrle_t *bit_rle_from_bitstr(bitstr_t *b);
+
+/* Build a bitstr_t with the same bits as r, free with bit_free() */
+extern bitstr_t *bit_rle_to_bitstr(bitrle_t *r);
+
+/* Return a copy of r */
+extern bitrle_t *bit_rle_copy(bitrle_t *r);
+
+extern void bit_rle_free(bitrle_t *r);
+
+#define FREE_NULL_BITRLE(_X)			\
+	do {					\
+		if (_X) bit_rle_free (_X);	\
+		_X	= NULL;			\
+	} while (0)
+
+/* Return the size in bits of r */
+extern bitoff_t bit_rle_size(bitrle_t *r);
+
+/* Return 1 if bit is set in r, 0 otherwise */
+extern int bit_rle_test(bitrle_t *r, bitoff_t bit);
+
+/* Return the count of bits set in r */
+extern int32_t bit_rle_set_count(bitrle_t *r);
+
+/* Return the count of bits set in both r and b, which are the same size */
+extern int32_t bit_rle_overlap(bitrle_t *r, bitstr_t *b);
+
+/* b |= r, b and r are the same size */
+extern void bit_rle_or(bitstr_t *b, bitrle_t *r);
+
+/* b &= ~r, b and r are the same size */
+extern void bit_rle_and_not(bitstr_t *b, bitrle_t *r);
+
+/*
+ * Return r in bit_fmt() format (e.g. "0-5,42"), xfree the return value.
+ * Unlike bit_fmt() the string is never truncated.
+ */
+extern char *bit_rle_fmt(bitrle_t *r);
+
+/*
+ * Build a bitrle_t of nbits bits from a string in bit_fmt() format,
+ * RET NULL if the string is invalid or names bits beyond nbits
+ */
+extern bitrle_t *bit_rle_unfmt(bitoff_t nbits, char *str);
+
+#endif /* !_BITRLE_H */
@@ -50,7 +50,9 @@
 #include "slurm/slurm.h"
 
 #include "src/common/forward.h"
+#include "src/common/msg_aio.h"
 #include "src/common/xmalloc.h"
+#include "src/common/xhash.h"
 #include "src/common/xstring.h"
 #include "src/common/slurm_auth.h"
 #include "src/common/slurm_route.h"
@@ -61,380 +63,205 @@
 #  include <pthread.h>
 #endif /* WITH_PTHREADS */
 
-#define MAX_RETRIES 3
+#define FORWARD_MAX_CONN	256	/* connections open at once by the
+					 * forwarding engine */
 
 typedef struct {
-	pthread_cond_t *notify;
-	int            *p_thr_count;
-	slurm_msg_t *orig_msg;
+	pthread_cond_t notify;
+	pthread_mutex_t tree_mutex;
+	int branch_cnt;		/* engine requests outstanding */
 	List ret_list;
-	int timeout;
-	hostlist_t tree_hl;
-	pthread_mutex_t *tree_mutex;
 } fwd_tree_t;
 
-void _destroy_tree_fwd(fwd_tree_t *fwd_tree)
+typedef struct {
+	char *name;
+	uint32_t cpu_load;
+} ping_load_t;
+
+static pthread_mutex_t fwd_aio_mutex = PTHREAD_MUTEX_INITIALIZER;
+static msg_aio_t *fwd_aio = NULL;
+static bool fwd_aio_atfork = false;
+
+/* A child process does not have the engine's thread, close the engine
+ * inherited from its parent so that it does not hold the parent's
+ * connections open */
+static void _fwd_aio_atfork_child(void)
 {
-	if (fwd_tree) {
-		if (fwd_tree->tree_hl)
-			hostlist_destroy(fwd_tree->tree_hl);
-
-		/*
-		 * Lock and decrease thread counter, start_msg_tree is waiting
-		 * for a null thread count to exit its main loop
-		 */
-		slurm_mutex_lock(fwd_tree->tree_mutex);
-		(*(fwd_tree->p_thr_count))--;
-		pthread_cond_signal(fwd_tree->notify);
-		slurm_mutex_unlock(fwd_tree->tree_mutex);
-
-		xfree(fwd_tree);
-	}
+	slurm_mutex_init(&fwd_aio_mutex);
+	msg_aio_fork_close(fwd_aio);
+	fwd_aio = NULL;
 }
 
-void *_forward_thread(void *arg)
+/*
+ * Return the engine forwarding messages for this process, a single thread
+ * for every branch of every tree. It is started on first use, again in a
+ * child process which uses it.
+ */
+static msg_aio_t *_fwd_aio(void)
 {
-	forward_msg_t *fwd_msg = (forward_msg_t *)arg;
-	Buf buffer = init_buf(BUF_SIZE);	/* probably enough for header */
-	List ret_list = NULL;
-	slurm_fd_t fd = -1;
-	ret_data_info_t *ret_data_info = NULL;
-	char *name = NULL;
-	hostlist_t hl = hostlist_create(fwd_msg->header.forward.nodelist);
-	slurm_addr_t addr;
-	char *buf = NULL;
-	int steps = 0;
-	int start_timeout = fwd_msg->timeout;
-
-	/* repeat until we are sure the message was sent */
-	while ((name = hostlist_shift(hl))) {
-		if (slurm_conf_get_addr(name, &addr) == SLURM_ERROR) {
-			error("forward_thread: can't find address for host "
-			      "%s, check slurm.conf", name);
-			slurm_mutex_lock(fwd_msg->forward_mutex);
-			mark_as_failed_forward(&fwd_msg->ret_list, name,
-					       SLURM_UNKNOWN_FORWARD_ADDR);
- 			free(name);
-			if (hostlist_count(hl) > 0) {
-				slurm_mutex_unlock(fwd_msg->forward_mutex);
-				continue;
-			}
-			goto cleanup;
-		}
-		if ((fd = slurm_open_msg_conn(&addr)) < 0) {
-			error("forward_thread to %s: %m", name);
-
-			slurm_mutex_lock(fwd_msg->forward_mutex);
-			mark_as_failed_forward(
-				&fwd_msg->ret_list, name,
-				SLURM_COMMUNICATIONS_CONNECTION_ERROR);
-			free(name);
-			if (hostlist_count(hl) > 0) {
-				slurm_mutex_unlock(fwd_msg->forward_mutex);
-				continue;
-			}
-			goto cleanup;
-		}
-		buf = hostlist_ranged_string_xmalloc(hl);
-
-		xfree(fwd_msg->header.forward.nodelist);
-		fwd_msg->header.forward.nodelist = buf;
-		fwd_msg->header.forward.cnt = hostlist_count(hl);
-#if 0
-		info("sending %d forwards (%s) to %s",
-		     fwd_msg->header.forward.cnt,
-		     fwd_msg->header.forward.nodelist, name);
-#endif
-		if (fwd_msg->header.forward.nodelist[0]) {
-			debug3("forward: send to %s along with %s",
-			       name, fwd_msg->header.forward.nodelist);
-		} else
-			debug3("forward: send to %s ", name);
-
-		pack_header(&fwd_msg->header, buffer);
-
-		/* add forward data to buffer */
-		if (remaining_buf(buffer) < fwd_msg->buf_len) {
-			int new_size = buffer->processed + fwd_msg->buf_len;
-			new_size += 1024; /* padded for paranoia */
-			xrealloc_nz(buffer->head, new_size);
-			buffer->size = new_size;
-		}
-		if (fwd_msg->buf_len) {
-			memcpy(&buffer->head[buffer->processed],
-			       fwd_msg->buf, fwd_msg->buf_len);
-			buffer->processed += fwd_msg->buf_len;
+	msg_aio_t *aio;
+	int err;
+
+	slurm_mutex_lock(&fwd_aio_mutex);
+	if (!fwd_aio) {
+		if (!fwd_aio_atfork) {
+			if ((err = pthread_atfork(NULL, NULL,
+						  _fwd_aio_atfork_child)))
+				error("forward: pthread_atfork: %s",
+				      slurm_strerror(err));
+			fwd_aio_atfork = true;
 		}
+		fwd_aio = msg_aio_create(1, FORWARD_MAX_CONN);
+	}
+	aio = fwd_aio;
+	slurm_mutex_unlock(&fwd_aio_mutex);
 
-		/*
-		 * forward message
-		 */
-		if (slurm_msg_sendto(fd,
-				     get_buf_data(buffer),
-				     get_buf_offset(buffer),
-				     SLURM_PROTOCOL_NO_SEND_RECV_FLAGS ) < 0) {
-			error("forward_thread: slurm_msg_sendto: %m");
-
-			slurm_mutex_lock(fwd_msg->forward_mutex);
-			mark_as_failed_forward(&fwd_msg->ret_list, name,
-					       errno);
-			free(name);
-			if (hostlist_count(hl) > 0) {
-				free_buf(buffer);
-				buffer = init_buf(fwd_msg->buf_len);
-				slurm_mutex_unlock(fwd_msg->forward_mutex);
-				slurm_close(fd);
-				fd = -1;
-				continue;
-			}
-			goto cleanup;
-		}
+	return aio;
+}
 
-		if ((fwd_msg->header.msg_type == REQUEST_SHUTDOWN) ||
-		    (fwd_msg->header.msg_type == REQUEST_RECONFIGURE) ||
-		    (fwd_msg->header.msg_type == REQUEST_REBOOT_NODES)) {
-			slurm_mutex_lock(fwd_msg->forward_mutex);
-			ret_data_info = xmalloc(sizeof(ret_data_info_t));
-			list_push(fwd_msg->ret_list, ret_data_info);
-			ret_data_info->node_name = xstrdup(name);
-			free(name);
-			while ((name = hostlist_shift(hl))) {
-				ret_data_info =
-					xmalloc(sizeof(ret_data_info_t));
-				list_push(fwd_msg->ret_list, ret_data_info);
-				ret_data_info->node_name = xstrdup(name);
-				free(name);
-			}
-			goto cleanup;
-		}
+/* Merge the responses of a branch of start_msg_tree() */
+static void _fwd_tree_done(List ret_list, int rc, void *arg)
+{
+	fwd_tree_t *fwd_tree = (fwd_tree_t *) arg;
+
+	slurm_mutex_lock(&fwd_tree->tree_mutex);
+	list_transfer(fwd_tree->ret_list, ret_list);
+	fwd_tree->branch_cnt--;
+	pthread_cond_signal(&fwd_tree->notify);
+	slurm_mutex_unlock(&fwd_tree->tree_mutex);
+	list_destroy(ret_list);
+}
 
-		if (fwd_msg->header.forward.cnt > 0) {
-			static int message_timeout = -1;
-			if (message_timeout < 0)
-				message_timeout =
-					slurm_get_msg_timeout() * 1000;
-			steps = (fwd_msg->header.forward.cnt+1) /
-				slurm_get_tree_width();
-			fwd_msg->timeout = (message_timeout*steps);
-/* 			info("got %d * %d = %d", message_timeout, steps, fwd_msg->timeout); */
-			steps++;
-			fwd_msg->timeout += (start_timeout*steps);
-/* 			info("now  + %d*%d = %d", start_timeout, steps, fwd_msg->timeout); */
-		}
+/* Merge the responses of a branch of forward_msg() */
+static void _forward_done(List ret_list, int rc, void *arg)
+{
+	forward_struct_t *forward_struct = (forward_struct_t *) arg;
+	ret_data_info_t *ret_data_info;
 
-		ret_list = slurm_receive_msgs(fd, steps, fwd_msg->timeout);
-		/* info("sent %d forwards got %d back", */
-/* 		     fwd_msg->header.forward.cnt, list_count(ret_list)); */
-
-		if (!ret_list || (fwd_msg->header.forward.cnt != 0
-				 && list_count(ret_list) <= 1)) {
-			slurm_mutex_lock(fwd_msg->forward_mutex);
-			mark_as_failed_forward(&fwd_msg->ret_list, name,
-					       errno);
-			free(name);
-			if (ret_list)
-				list_destroy(ret_list);
-			if (hostlist_count(hl) > 0) {
-				free_buf(buffer);
-				buffer = init_buf(fwd_msg->buf_len);
-				slurm_mutex_unlock(fwd_msg->forward_mutex);
-				slurm_close(fd);
-				fd = -1;
-				continue;
-			}
-			goto cleanup;
-		} else if ((fwd_msg->header.forward.cnt+1)
-			  != list_count(ret_list)) {
-			/* this should never be called since the above
-			   should catch the failed forwards and pipe
-			   them back down, but this is here so we
-			   never have to worry about a locked
-			   mutex */
-			ListIterator itr = NULL;
-			char *tmp = NULL;
-			int first_node_found = 0;
-			hostlist_iterator_t host_itr
-				= hostlist_iterator_create(hl);
-			error("We shouldn't be here.  We forwarded to %d "
-			      "but only got %d back",
-			      (fwd_msg->header.forward.cnt+1),
-			      list_count(ret_list));
-			while ((tmp = hostlist_next(host_itr))) {
-				int node_found = 0;
-				itr = list_iterator_create(ret_list);
-				while ((ret_data_info = list_next(itr))) {
-					if (!ret_data_info->node_name) {
-						first_node_found = 1;
-						ret_data_info->node_name =
-							xstrdup(name);
-					}
-					if (!strcmp(tmp,
-						   ret_data_info->node_name)) {
-						node_found = 1;
-						break;
-					}
-				}
-				list_iterator_destroy(itr);
-				if (!node_found) {
-					mark_as_failed_forward(
-						&fwd_msg->ret_list,
-						tmp,
-						SLURM_COMMUNICATIONS_CONNECTION_ERROR);
-				}
-				free(tmp);
-			}
-			hostlist_iterator_destroy(host_itr);
-			if (!first_node_found) {
-				mark_as_failed_forward(&fwd_msg->ret_list,
-						       name,
-						       SLURM_COMMUNICATIONS_CONNECTION_ERROR);
-			}
-		}
-		break;
-	}
-	slurm_mutex_lock(fwd_msg->forward_mutex);
-	if (ret_list) {
-		while ((ret_data_info = list_pop(ret_list)) != NULL) {
-			if (!ret_data_info->node_name) {
-				ret_data_info->node_name = xstrdup(name);
-			}
-			list_push(fwd_msg->ret_list, ret_data_info);
-			debug3("got response from %s",
-			       ret_data_info->node_name);
-		}
-		list_destroy(ret_list);
+	slurm_mutex_lock(&forward_struct->forward_mutex);
+	while ((ret_data_info = list_pop(ret_list))) {
+		debug3("got response from %s", ret_data_info->node_name);
+		list_push(forward_struct->ret_list, ret_data_info);
 	}
-	free(name);
-cleanup:
-	if ((fd >= 0) && slurm_close(fd) < 0)
-		error ("close(%d): %m", fd);
-	hostlist_destroy(hl);
-	destroy_forward(&fwd_msg->header.forward);
-	free_buf(buffer);
-	pthread_cond_signal(fwd_msg->notify);
-	slurm_mutex_unlock(fwd_msg->forward_mutex);
+	forward_struct->branch_cnt--;
+	pthread_cond_signal(&forward_struct->notify);
+	slurm_mutex_unlock(&forward_struct->forward_mutex);
+	list_destroy(ret_list);
+}
 
-	return (NULL);
+static const char *_ping_load_name(void *item)
+{
+	return ((ping_load_t *) item)->name;
 }
 
-void *_fwd_tree_thread(void *arg)
+static void _ping_load_free(void *item)
 {
-	fwd_tree_t *fwd_tree = (fwd_tree_t *)arg;
-	List ret_list = NULL;
-	char *name = NULL;
-	char *buf = NULL;
-	slurm_msg_t send_msg;
-
-	slurm_msg_t_init(&send_msg);
-	send_msg.msg_type = fwd_tree->orig_msg->msg_type;
-	send_msg.data = fwd_tree->orig_msg->data;
-	send_msg.protocol_version = fwd_tree->orig_msg->protocol_version;
-
-	/* repeat until we are sure the message was sent */
-	while ((name = hostlist_shift(fwd_tree->tree_hl))) {
-		if (slurm_conf_get_addr(name, &send_msg.address)
-		    == SLURM_ERROR) {
-			error("fwd_tree_thread: can't find address for host "
-			      "%s, check slurm.conf", name);
-			slurm_mutex_lock(fwd_tree->tree_mutex);
-			mark_as_failed_forward(&fwd_tree->ret_list, name,
-					       SLURM_UNKNOWN_FORWARD_ADDR);
- 			pthread_cond_signal(fwd_tree->notify);
-			slurm_mutex_unlock(fwd_tree->tree_mutex);
-			free(name);
+	ping_load_t *ping_load = (ping_load_t *) item;
 
-			continue;
-		}
+	xfree(ping_load->name);
+	xfree(ping_load);
+}
 
-		send_msg.forward.timeout = fwd_tree->timeout;
-		if ((send_msg.forward.cnt = hostlist_count(fwd_tree->tree_hl))){
-			buf = hostlist_ranged_string_xmalloc(
-					fwd_tree->tree_hl);
-			send_msg.forward.nodelist = buf;
-		} else
-			send_msg.forward.nodelist = NULL;
+static void _add_ping_load(xhash_t *loads, hostlist_t hl, char *name,
+			   uint32_t cpu_load)
+{
+	ping_load_t *ping_load;
+
+	if (xhash_get(loads, name))
+		return;
+	ping_load = xmalloc(sizeof(ping_load_t));
+	ping_load->name = xstrdup(name);
+	ping_load->cpu_load = cpu_load;
+	xhash_add(loads, ping_load);
+	hostlist_push_host(hl, name);
+}
 
-		if (send_msg.forward.nodelist && send_msg.forward.nodelist[0]) {
-			debug3("Tree sending to %s along with %s",
-			       name, send_msg.forward.nodelist);
-		} else
-			debug3("Tree sending to %s", name);
-
-		ret_list = slurm_send_addr_recv_msgs(&send_msg, name,
-						     fwd_tree->timeout);
-
-		xfree(send_msg.forward.nodelist);
-
-		if (ret_list) {
-			int ret_cnt = list_count(ret_list);
-			/* This is most common if a slurmd is running
-			   an older version of Slurm than the
-			   originator of the message.
-			*/
-			if ((ret_cnt <= send_msg.forward.cnt) &&
-			    (errno != SLURM_COMMUNICATIONS_CONNECTION_ERROR)) {
-				error("fwd_tree_thread: %s failed to forward "
-				      "the message, expecting %d ret got only "
-				      "%d",
-				      name, send_msg.forward.cnt + 1, ret_cnt);
-				if (ret_cnt > 1) { /* not likely */
-					ret_data_info_t *ret_data_info = NULL;
-					ListIterator itr =
-						list_iterator_create(ret_list);
-					while ((ret_data_info =
-						list_next(itr))) {
-						if (strcmp(ret_data_info->
-							   node_name, name))
-							hostlist_delete_host(
-								fwd_tree->
-								tree_hl,
-								ret_data_info->
-								node_name);
-					}
-					list_iterator_destroy(itr);
-				}
-			}
+/*
+ * Replace the RESPONSE_PING_SLURMD of the nodes in ret_list, and the
+ * RESPONSE_PING_AGGREGATE of nodes forwarding the message further, with a
+ * single RESPONSE_PING_AGGREGATE naming the nodes with a hostlist
+ * expression. Every other response is left as it is, so a large tree
+ * returns just the nodes which failed along with one compact record of
+ * those which did not.
+ */
+static void _aggregate_pings(List ret_list)
+{
+	ListIterator itr;
+	ret_data_info_t *ret_data_info;
+	ping_slurmd_aggr_msg_t *aggr;
+	ping_load_t *ping_load;
+	hostlist_t hl, aggr_hl;
+	hostlist_iterator_t hl_itr;
+	xhash_t *loads;
+	char *name;
+	int merge_cnt = 0;
+	uint32_t i;
+
+	itr = list_iterator_create(ret_list);
+	while ((ret_data_info = list_next(itr))) {
+		if ((ret_data_info->type == RESPONSE_PING_SLURMD) ||
+		    (ret_data_info->type == RESPONSE_PING_AGGREGATE))
+			merge_cnt++;
+	}
+	if (merge_cnt < 2) {
+		list_iterator_destroy(itr);
+		return;
+	}
 
-			slurm_mutex_lock(fwd_tree->tree_mutex);
-			list_transfer(fwd_tree->ret_list, ret_list);
-			pthread_cond_signal(fwd_tree->notify);
-			slurm_mutex_unlock(fwd_tree->tree_mutex);
-			list_destroy(ret_list);
-			/* try next node */
-			if (ret_cnt <= send_msg.forward.cnt) {
-				free(name);
+	loads = xhash_init(_ping_load_name, _ping_load_free, NULL, 0);
+	hl = hostlist_create(NULL);
+	list_iterator_reset(itr);
+	while ((ret_data_info = list_next(itr))) {
+		if (ret_data_info->type == RESPONSE_PING_SLURMD) {
+			ping_slurmd_resp_msg_t *ping_resp = ret_data_info->data;
+			_add_ping_load(loads, hl, ret_data_info->node_name,
+				       ping_resp->cpu_load);
+		} else if (ret_data_info->type == RESPONSE_PING_AGGREGATE) {
+			aggr = ret_data_info->data;
+			aggr_hl = hostlist_create(ret_data_info->node_name);
+			if (hostlist_count(aggr_hl) != aggr->node_cnt) {
+				error("%s: %u loads for nodes %s", __func__,
+				      aggr->node_cnt,
+				      ret_data_info->node_name);
+				hostlist_destroy(aggr_hl);
 				continue;
 			}
-		} else {
-			/* This should never happen (when this was
-			 * written slurm_send_addr_recv_msgs always
-			 * returned a list */
-			error("fwd_tree_thread: no return list given from "
-			      "slurm_send_addr_recv_msgs spawned for %s",
-			      name);
-			slurm_mutex_lock(fwd_tree->tree_mutex);
-			mark_as_failed_forward(
-				&fwd_tree->ret_list, name,
-				SLURM_COMMUNICATIONS_CONNECTION_ERROR);
- 			pthread_cond_signal(fwd_tree->notify);
-			slurm_mutex_unlock(fwd_tree->tree_mutex);
-			free(name);
-
+			for (i = 0; (name = hostlist_shift(aggr_hl)); i++) {
+				_add_ping_load(loads, hl, name,
+					       aggr->cpu_load[i]);
+				free(name);
+			}
+			hostlist_destroy(aggr_hl);
+		} else
 			continue;
-		}
-
-		free(name);
+		list_delete_item(itr);
+	}
+	list_iterator_destroy(itr);
 
-		/* check for error and try again */
-		if (errno == SLURM_COMMUNICATIONS_CONNECTION_ERROR)
- 			continue;
+	hostlist_uniq(hl);
+	ret_data_info = xmalloc(sizeof(ret_data_info_t));
+	ret_data_info->type = RESPONSE_PING_AGGREGATE;
+	ret_data_info->node_name = hostlist_ranged_string_xmalloc(hl);
+	hostlist_destroy(hl);
 
-		break;
+	/* Order the loads as the expression will be read back */
+	aggr = xmalloc(sizeof(ping_slurmd_aggr_msg_t));
+	hl = hostlist_create(ret_data_info->node_name);
+	aggr->node_cnt = hostlist_count(hl);
+	aggr->cpu_load = xmalloc(sizeof(uint32_t) * aggr->node_cnt);
+	hl_itr = hostlist_iterator_create(hl);
+	for (i = 0; (name = hostlist_next(hl_itr)); i++) {
+		if ((ping_load = xhash_get(loads, name)))
+			aggr->cpu_load[i] = ping_load->cpu_load;
+		free(name);
 	}
+	hostlist_iterator_destroy(hl_itr);
+	hostlist_destroy(hl);
+	xhash_free(loads);
 
-	_destroy_tree_fwd(fwd_tree);
-
-	return NULL;
+	ret_data_info->data = aggr;
+	list_push(ret_list, ret_data_info);
+	debug3("aggregated pings of %u nodes", aggr->node_cnt);
 }
 
 /*
@@ -474,13 +301,11 @@ extern void forward_init(forward_t *forward, forward_t *from)
 extern int forward_msg(forward_struct_t *forward_struct,
 		       header_t *header)
 {
-	int j = 0;
-	int retries = 0;
-	forward_msg_t *forward_msg = NULL;
-	int thr_count = 0;
+	msg_aio_t *aio = _fwd_aio();
 	hostlist_t hl = NULL;
 	hostlist_t* sp_hl;
-	int hl_count = 0;
+	int j, hl_count = 0;
+	bool get_reply;
 
 	if (!forward_struct->ret_list) {
 		error("didn't get a ret_list from forward_struct");
@@ -494,60 +319,27 @@ extern int forward_msg(forward_struct_t *forward_struct,
 		hostlist_destroy(hl);
 		return SLURM_ERROR;
 	}
-	for (j = 0; j < hl_count; j++) {
-
-		pthread_attr_t attr_agent;
-		pthread_t thread_agent;
-		char *buf = NULL;
-
-		slurm_attr_init(&attr_agent);
-		if (pthread_attr_setdetachstate
-		    (&attr_agent, PTHREAD_CREATE_DETACHED))
-			error("pthread_attr_setdetachstate error %m");
-
-		forward_msg = &forward_struct->forward_msg[thr_count];
-		forward_msg->ret_list = forward_struct->ret_list;
+	hostlist_destroy(hl);
 
-		forward_msg->timeout = forward_struct->timeout;
+	get_reply = ((header->msg_type != REQUEST_SHUTDOWN) &&
+		     (header->msg_type != REQUEST_RECONFIGURE) &&
+		     (header->msg_type != REQUEST_REBOOT_NODES));
+	forward_struct->aggregate =
+		((header->flags & SLURM_ACCEPT_AGGREGATE) &&
+		 (header->version >= SLURM_15_08_PROTOCOL_VERSION));
 
-		if (forward_msg->timeout <= 0) {
-			/* convert secs to msec */
-			forward_msg->timeout  = slurm_get_msg_timeout() * 1000;
-		}
+	/* Count every branch before the first can complete */
+	slurm_mutex_lock(&forward_struct->forward_mutex);
+	forward_struct->branch_cnt = hl_count;
+	slurm_mutex_unlock(&forward_struct->forward_mutex);
 
-		forward_msg->notify = &forward_struct->notify;
-		forward_msg->forward_mutex = &forward_struct->forward_mutex;
-		forward_msg->buf_len = forward_struct->buf_len;
-		forward_msg->buf = forward_struct->buf;
-
-		memcpy(&forward_msg->header.orig_addr,
-		       &header->orig_addr,
-		       sizeof(slurm_addr_t));
-
-		forward_msg->header.version = header->version;
-		forward_msg->header.flags = header->flags;
-		forward_msg->header.msg_type = header->msg_type;
-		forward_msg->header.body_length = header->body_length;
-		forward_msg->header.ret_list = NULL;
-		forward_msg->header.ret_cnt = 0;
-
-		buf = hostlist_ranged_string_xmalloc(sp_hl[j]);
-		hostlist_destroy(sp_hl[j]);
-		forward_init(&forward_msg->header.forward, NULL);
-		forward_msg->header.forward.nodelist = buf;
-		while (pthread_create(&thread_agent, &attr_agent,
-				     _forward_thread,
-				     (void *)forward_msg)) {
-			error("pthread_create error %m");
-			if (++retries > MAX_RETRIES)
-				fatal("Can't create pthread");
-			usleep(100000);	/* sleep and try again */
-		}
-		slurm_attr_destroy(&attr_agent);
-		thr_count++;
+	for (j = 0; j < hl_count; j++) {
+		msg_aio_forward(aio, header, forward_struct->buf,
+				forward_struct->buf_len, sp_hl[j], get_reply,
+				forward_struct->timeout, _forward_done,
+				forward_struct);
 	}
 	xfree(sp_hl);
-	hostlist_destroy(hl);
 	return SLURM_SUCCESS;
 }
 
@@ -565,12 +357,9 @@ extern int forward_msg(forward_struct_t *forward_struct,
  */
 extern List start_msg_tree(hostlist_t hl, slurm_msg_t *msg, int timeout)
 {
-	fwd_tree_t *fwd_tree = NULL;
-	pthread_mutex_t tree_mutex;
-	pthread_cond_t notify;
+	msg_aio_t *aio;
+	fwd_tree_t fwd_tree;
 	int j = 0, count = 0;
-	List ret_list = NULL;
-	int thr_count = 0;
 	int host_count = 0;
 	hostlist_t* sp_hl;
 	int hl_count = 0;
@@ -585,77 +374,35 @@ extern List start_msg_tree(hostlist_t hl, slurm_msg_t *msg, int timeout)
 		error("unable to split forward hostlist");
 		return NULL;
 	}
-	slurm_mutex_init(&tree_mutex);
-	pthread_cond_init(&notify, NULL);
-
-	ret_list = list_create(destroy_data_info);
+	aio = _fwd_aio();
+	slurm_mutex_init(&fwd_tree.tree_mutex);
+	pthread_cond_init(&fwd_tree.notify, NULL);
+	fwd_tree.ret_list = list_create(destroy_data_info);
+	fwd_tree.branch_cnt = hl_count;
 
 	for (j = 0; j < hl_count; j++) {
-		pthread_attr_t attr_agent;
-		pthread_t thread_agent;
-		int retries = 0;
-
-		slurm_attr_init(&attr_agent);
-		if (pthread_attr_setdetachstate
-		    (&attr_agent, PTHREAD_CREATE_DETACHED))
-			error("pthread_attr_setdetachstate error %m");
-
-		fwd_tree = xmalloc(sizeof(fwd_tree_t));
-		fwd_tree->orig_msg = msg;
-		fwd_tree->ret_list = ret_list;
-		fwd_tree->timeout = timeout;
-		fwd_tree->notify = &notify;
-		fwd_tree->p_thr_count = &thr_count;
-		fwd_tree->tree_mutex = &tree_mutex;
-
-		if (fwd_tree->timeout <= 0) {
-			/* convert secs to msec */
-			fwd_tree->timeout  = slurm_get_msg_timeout() * 1000;
-		}
-
-		fwd_tree->tree_hl = sp_hl[j];
-		sp_hl[j] = NULL;
-
-		/*
-		 * Lock and increase thread counter, we need that to protect
-		 * the start_msg_tree waiting loop that was originally designed
-		 * around a "while ((count < host_count))" loop. In case where a
-		 * fwd thread was not able to get all the return codes from
-		 * children, the waiting loop was deadlocked.
-		 */
-		slurm_mutex_lock(&tree_mutex);
-		thr_count++;
-		slurm_mutex_unlock(&tree_mutex);
-
-		while (pthread_create(&thread_agent, &attr_agent,
-				      _fwd_tree_thread, (void *)fwd_tree)) {
-			error("pthread_create error %m");
-			if (++retries > MAX_RETRIES)
-				fatal("Can't create pthread");
-			usleep(100000);	/* sleep and try again */
-		}
-		slurm_attr_destroy(&attr_agent);
-
+		msg_aio_send_tree(aio, msg, sp_hl[j], timeout,
+				  _fwd_tree_done, &fwd_tree);
 	}
 	xfree(sp_hl);
 
-	slurm_mutex_lock(&tree_mutex);
+	slurm_mutex_lock(&fwd_tree.tree_mutex);
 
-	count = list_count(ret_list);
+	count = list_count(fwd_tree.ret_list);
 	debug2("Tree head got back %d looking for %d", count, host_count);
-	while (thr_count > 0) {
-		pthread_cond_wait(&notify, &tree_mutex);
-		count = list_count(ret_list);
+	while (fwd_tree.branch_cnt > 0) {
+		pthread_cond_wait(&fwd_tree.notify, &fwd_tree.tree_mutex);
+		count = list_count(fwd_tree.ret_list);
 		debug2("Tree head got back %d", count);
 	}
 	xassert(count >= host_count);	/* Tree head did not get all responses,
-					 * but no more active fwd threads!*/
-	slurm_mutex_unlock(&tree_mutex);
+					 * but no more active branches! */
+	slurm_mutex_unlock(&fwd_tree.tree_mutex);
 
-	slurm_mutex_destroy(&tree_mutex);
-	pthread_cond_destroy(&notify);
+	slurm_mutex_destroy(&fwd_tree.tree_mutex);
+	pthread_cond_destroy(&fwd_tree.notify);
 
-	return ret_list;
+	return fwd_tree.ret_list;
 }
 
 /*
@@ -683,6 +430,32 @@ extern void mark_as_failed_forward(List *ret_list, char *node_name, int err)
 	return;
 }
 
+/*
+ * ret_list_node_count - count the nodes a list of responses is from, a
+ *	RESPONSE_PING_AGGREGATE counting for each of its nodes
+ * IN: ret_list - List of ret_data_info_t
+ */
+extern int ret_list_node_count(List ret_list)
+{
+	ListIterator itr;
+	ret_data_info_t *ret_data_info;
+	int count = 0;
+
+	if (!ret_list)
+		return 0;
+	itr = list_iterator_create(ret_list);
+	while ((ret_data_info = list_next(itr))) {
+		if (ret_data_info->type == RESPONSE_PING_AGGREGATE) {
+			ping_slurmd_aggr_msg_t *aggr = ret_data_info->data;
+			count += aggr->node_cnt;
+		} else
+			count++;
+	}
+	list_iterator_destroy(itr);
+
+	return count;
+}
+
 extern void forward_wait(slurm_msg_t * msg)
 {
 	int count = 0;
@@ -696,7 +469,7 @@ extern void forward_wait(slurm_msg_t * msg)
 			count = list_count(msg->ret_list);
 
 		debug2("Got back %d", count);
-		while ((count < msg->forward_struct->fwd_cnt)) {
+		while (msg->forward_struct->branch_cnt > 0) {
 			pthread_cond_wait(&msg->forward_struct->notify,
 					  &msg->forward_struct->forward_mutex);
 
@@ -708,6 +481,8 @@ extern void forward_wait(slurm_msg_t * msg)
 		}
 		debug2("Got them all");
 		slurm_mutex_unlock(&msg->forward_struct->forward_mutex);
+		if (msg->forward_struct->aggregate && msg->ret_list)
+			_aggregate_pings(msg->ret_list);
 		destroy_forward_struct(msg->forward_struct);
 		msg->forward_struct = NULL;
 	}
@@ -738,8 +513,7 @@ void destroy_forward(forward_t *forward)
 void destroy_forward_struct(forward_struct_t *forward_struct)
 {
 	if (forward_struct) {
-		xfree(forward_struct->buf);
-		xfree(forward_struct->forward_msg);
+		buf_pool_free(forward_struct->buf);
 		slurm_mutex_destroy(&forward_struct->forward_mutex);
 		pthread_cond_destroy(&forward_struct->notify);
 		xfree(forward_struct);
@@ -113,6 +113,20 @@ extern List start_msg_tree(hostlist_t hl, slurm_msg_t *msg, int timeout);
  */
 extern void mark_as_failed_forward(List *ret_list, char *node_name, int err);
 
+/*
+ * ret_list_node_count - count the nodes a list of responses is from, a
+ *	RESPONSE_PING_AGGREGATE counting for each of its nodes
+ * IN: ret_list - List of ret_data_info_t
+ * RET: count of nodes
+ */
+extern int ret_list_node_count(List ret_list);
+
+/*
+ * forward_wait - wait for the responses of the nodes a message was
+ *	forwarded to, merging ping responses if the sender accepts
+ *	RESPONSE_PING_AGGREGATE
+ * IN: msg - slurm_msg_t * - response to the forwarded message
+ */
 extern void forward_wait(slurm_msg_t *msg);
 
 /*
@@ -1225,7 +1225,7 @@ extern int job_fits_into_cores(job_resources_t *job_resrcs_ptr,
 			       const uint16_t *bits_per_node)
 {
 	int full_node_inx = 0, full_bit_inx  = 0, job_bit_inx  = 0, i;
-	int job_node_cnt;
+	int job_node_cnt, node_bits;
 
 	if (!full_bitmap)
 		return 1;
@@ -1235,11 +1235,18 @@ extern int job_fits_into_cores(job_resources_t *job_resrcs_ptr,
 	     job_node_cnt > 0; full_node_inx++) {
 		if (bit_test(job_resrcs_ptr->node_bitmap, full_node_inx)) {
 			full_bit_inx = cr_node_cores_offset[full_node_inx];
-			for (i = 0; i < bits_per_node[full_node_inx]; i++) {
+			node_bits = bits_per_node[full_node_inx];
+			/* Word level test for any cores in use on the node */
+			if ((node_bits == 0) ||
+			    (bit_set_count_range(full_bitmap, full_bit_inx,
+						 full_bit_inx + node_bits) == 0))
+				node_bits = 0;
+			else if (job_resrcs_ptr->whole_node)
+				return 0;
+			for (i = 0; i < node_bits; i++) {
 				if (!bit_test(full_bitmap, full_bit_inx + i))
 					continue;
-				if (job_resrcs_ptr->whole_node ||
-				    bit_test(job_resrcs_ptr->core_bitmap,
+				if (bit_test(job_resrcs_ptr->core_bitmap,
 					     job_bit_inx + i)) {
 					return 0;
 				}
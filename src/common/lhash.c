@@ -0,0 +1,237 @@
+/*****************************************************************************\
+ *  lhash.c - resizable hash table of records linked through a next pointer
+ *****************************************************************************
+ *  Copyright (C) 2015 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include "src/common/lhash.h"
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+
+#define LHASH_MAGIC	0x1a5b1a5b
+
+/* Buckets are allocated in segments so growing the table never copies or
+ * rehashes it all at once */
+#define LHASH_SEG_SHIFT	10
+#define LHASH_SEG_SIZE	(1 << LHASH_SEG_SHIFT)
+#define LHASH_SEG_MASK	(LHASH_SEG_SIZE - 1)
+
+#define LHASH_NEXT(_table, _rec) \
+	(*(void **) ((char *) (_rec) + (_table)->next_offset))
+
+struct lhash {
+	uint32_t magic;
+	void ***seg;		/* segments of bucket chain heads */
+	uint32_t seg_cnt;	/* size of seg array */
+	uint32_t min_size;	/* never shrink below this many buckets */
+	uint32_t level_size;	/* buckets at the start of this doubling */
+	uint32_t split;		/* next bucket to split, buckets in use
+				 * are level_size + split */
+	uint32_t rec_cnt;
+	size_t next_offset;
+	lhash_key_f key_f;
+};
+
+static inline void **_bucket(lhash_t *table, uint32_t inx)
+{
+	return &table->seg[inx >> LHASH_SEG_SHIFT][inx & LHASH_SEG_MASK];
+}
+
+/* Buckets below the split point have already been split, so are addressed
+ * using the next doubling's mask */
+static inline uint32_t _bucket_inx(lhash_t *table, uint32_t key)
+{
+	uint32_t inx = key & (table->level_size - 1);
+
+	if (inx < table->split)
+		inx = key & ((table->level_size << 1) - 1);
+	return inx;
+}
+
+/* Split one bucket, moving records whose key maps into the next doubling
+ * to a new bucket at the end of the table */
+static void _split_bucket(lhash_t *table)
+{
+	uint32_t new_inx = table->level_size + table->split;
+	uint32_t mask = (table->level_size << 1) - 1;
+	uint32_t seg_inx = new_inx >> LHASH_SEG_SHIFT;
+	void *rec, *next, **old_tail, **new_tail;
+
+	if (table->level_size & 0x80000000)	/* can not grow further */
+		return;
+	if (seg_inx >= table->seg_cnt) {
+		table->seg_cnt *= 2;
+		xrealloc(table->seg, sizeof(void **) * table->seg_cnt);
+	}
+	if (!table->seg[seg_inx])
+		table->seg[seg_inx] = xmalloc(sizeof(void *) * LHASH_SEG_SIZE);
+
+	old_tail = _bucket(table, table->split);
+	new_tail = _bucket(table, new_inx);
+	rec = *old_tail;
+	while (rec) {
+		next = LHASH_NEXT(table, rec);
+		if ((table->key_f(rec) & mask) == new_inx) {
+			*new_tail = rec;
+			new_tail = &LHASH_NEXT(table, rec);
+		} else {
+			*old_tail = rec;
+			old_tail = &LHASH_NEXT(table, rec);
+		}
+		rec = next;
+	}
+	*old_tail = NULL;
+	*new_tail = NULL;
+
+	if (++table->split == table->level_size) {
+		table->level_size <<= 1;
+		table->split = 0;
+	}
+}
+
+/* Merge the last bucket back into the bucket it was split from */
+static void _merge_bucket(lhash_t *table)
+{
+	uint32_t old_inx;
+	void **tail, **old_bucket;
+
+	if (table->split == 0) {
+		table->level_size >>= 1;
+		table->split = table->level_size;
+	}
+	table->split--;
+	old_inx = table->level_size + table->split;
+
+	tail = _bucket(table, table->split);
+	while (*tail)
+		tail = &LHASH_NEXT(table, *tail);
+	old_bucket = _bucket(table, old_inx);
+	*tail = *old_bucket;
+	*old_bucket = NULL;
+
+	if ((old_inx & LHASH_SEG_MASK) == 0)
+		xfree(table->seg[old_inx >> LHASH_SEG_SHIFT]);
+}
+
+extern lhash_t *lhash_create(uint32_t min_size, size_t next_offset,
+			     lhash_key_f key_f)
+{
+	lhash_t *table = xmalloc(sizeof(lhash_t));
+	uint32_t size = 1, i;
+
+	while ((size < min_size) && (size < 0x80000000))
+		size <<= 1;
+	table->magic = LHASH_MAGIC;
+	table->seg_cnt = ((size - 1) >> LHASH_SEG_SHIFT) + 1;
+	table->seg = xmalloc(sizeof(void **) * table->seg_cnt);
+	for (i = 0; i < table->seg_cnt; i++)
+		table->seg[i] = xmalloc(sizeof(void *) * LHASH_SEG_SIZE);
+	table->min_size = size;
+	table->level_size = size;
+	table->next_offset = next_offset;
+	table->key_f = key_f;
+
+	return table;
+}
+
+extern void lhash_destroy(lhash_t *table)
+{
+	uint32_t i;
+
+	if (!table)
+		return;
+	xassert(table->magic == LHASH_MAGIC);
+	table->magic = 0;
+	for (i = 0; i < table->seg_cnt; i++)
+		xfree(table->seg[i]);
+	xfree(table->seg);
+	xfree(table);
+}
+
+extern void lhash_add(lhash_t *table, void *rec)
+{
+	void **bucket;
+
+	xassert(table->magic == LHASH_MAGIC);
+	bucket = _bucket(table, _bucket_inx(table, table->key_f(rec)));
+	LHASH_NEXT(table, rec) = *bucket;
+	*bucket = rec;
+
+	/* Keep the average chain length at one or less */
+	if (++table->rec_cnt > (table->level_size + table->split))
+		_split_bucket(table);
+}
+
+extern bool lhash_remove(lhash_t *table, void *rec)
+{
+	void **rec_pptr;
+	int i;
+
+	xassert(table->magic == LHASH_MAGIC);
+	rec_pptr = _bucket(table, _bucket_inx(table, table->key_f(rec)));
+	while (*rec_pptr && (*rec_pptr != rec))
+		rec_pptr = &LHASH_NEXT(table, *rec_pptr);
+	if (*rec_pptr == NULL)
+		return false;
+	*rec_pptr = LHASH_NEXT(table, rec);
+	LHASH_NEXT(table, rec) = NULL;
+
+	/* Shrink once the table is under half full, merging two buckets per
+	 * removal so the table keeps pace with the record count */
+	if (--table->rec_cnt < ((table->level_size + table->split) >> 1)) {
+		for (i = 0; i < 2; i++) {
+			if ((table->level_size + table->split) <=
+			    table->min_size)
+				break;
+			_merge_bucket(table);
+		}
+	}
+	return true;
+}
+
+extern void *lhash_first(lhash_t *table, uint32_t key)
+{
+	xassert(table->magic == LHASH_MAGIC);
+	return *_bucket(table, _bucket_inx(table, key));
+}
+
+extern uint32_t lhash_count(lhash_t *table)
+{
+	xassert(table->magic == LHASH_MAGIC);
+	return table->rec_cnt;
+}
+
+extern uint32_t lhash_size(lhash_t *table)
+{
+	xassert(table->magic == LHASH_MAGIC);
+	return table->level_size + table->split;
+}
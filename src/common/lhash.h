@@ -0,0 +1,99 @@
+/*****************************************************************************\
+ *  lhash.h - resizable hash table of records linked through a next pointer
+ *****************************************************************************
+ *  Copyright (C) 2015 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _LHASH_H
+#define _LHASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * An lhash table holds records which are chained through a "next" pointer
+ * within the record itself (e.g. job_record->job_next), so adding and
+ * removing records allocates no memory. The records are hashed by a 32-bit
+ * key, typically a job ID, and several records may share a key.
+ *
+ * The table grows and shrinks with the record count using linear hashing:
+ * each add splits at most one bucket and each remove merges at most two, so
+ * there is never a pause to rehash the whole table. Splits and merges
+ * preserve the order of the records in a chain, so a caller walking the
+ * records of one key with lhash_first() and the next pointers may add or
+ * remove other records as it goes. The table is not thread safe.
+ */
+typedef struct lhash lhash_t;
+
+/* Return the key by which a record is hashed */
+typedef uint32_t (*lhash_key_f)(void *rec);
+
+/*
+ * lhash_create - create an empty hash table
+ * IN min_size - minimum number of buckets, rounded up to a power of two
+ * IN next_offset - offset of the record's next pointer,
+ *		    e.g. offsetof(struct job_record, job_next)
+ * IN key_f - function returning a record's key
+ * RET the hash table, free with lhash_destroy()
+ */
+extern lhash_t *lhash_create(uint32_t min_size, size_t next_offset,
+			     lhash_key_f key_f);
+
+/* lhash_destroy - free a hash table, but not the records in it */
+extern void lhash_destroy(lhash_t *table);
+
+/*
+ * lhash_add - add a record to the head of its key's chain. The record's
+ *	key must not change while it is in the table.
+ */
+extern void lhash_add(lhash_t *table, void *rec);
+
+/*
+ * lhash_remove - remove a record from the table
+ * RET true if the record was found and removed
+ */
+extern bool lhash_remove(lhash_t *table, void *rec);
+
+/*
+ * lhash_first - return the first record in the chain holding the given
+ *	key, or NULL. The chain may also hold records with other keys.
+ */
+extern void *lhash_first(lhash_t *table, uint32_t key);
+
+/* Return the number of records in the table */
+extern uint32_t lhash_count(lhash_t *table);
+
+/* Return the number of buckets in the table */
+extern uint32_t lhash_size(lhash_t *table);
+
+#endif /* !_LHASH_H */
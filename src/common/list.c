@@ -70,6 +70,7 @@ strong_alias(list_transfer,	slurm_list_transfer);
 strong_alias(list_prepend,	slurm_list_prepend);
 strong_alias(list_find_first,	slurm_list_find_first);
 strong_alias(list_delete_all,	slurm_list_delete_all);
+strong_alias(list_delete_ptr,	slurm_list_delete_ptr);
 strong_alias(list_for_each,	slurm_list_for_each);
 strong_alias(list_flush,	slurm_list_flush);
 strong_alias(list_sort,		slurm_list_sort);
@@ -509,6 +510,35 @@ list_delete_all (List l, ListFindF f, void *key)
 	return n;
 }
 
+/* list_delete_ptr()
+ */
+int
+list_delete_ptr (List l, void *key)
+{
+	ListNode *pp;
+	void *v;
+	int n = 0;
+
+	assert(l != NULL);
+	assert(key != NULL);
+	list_mutex_lock(&l->mutex);
+	assert(l->magic == LIST_MAGIC);
+
+	for (pp = &l->head; *pp; pp = &(*pp)->next) {
+		if ((*pp)->data == key) {
+			if ((v = list_node_destroy(l, pp))) {
+				if (l->fDel)
+					l->fDel(v);
+				n = 1;
+			}
+			break;
+		}
+	}
+	list_mutex_unlock(&l->mutex);
+
+	return n;
+}
+
 /* list_for_each()
  */
 int
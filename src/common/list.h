@@ -205,6 +205,16 @@ int list_delete_all (List l, ListFindF f, void *key);
  *  Returns a count of the number of items removed from the list.
  */
 
+int list_delete_ptr (List l, void *key);
+/*
+ *  Removes the first item from list [l] whose data pointer is [key];
+ *    if a deletion function was specified when the list was created,
+ *    it will be called to deallocate the item.
+ *  The list is searched from its head, so items near the head are
+ *    removed quickly.
+ *  Returns 1 if the item was found and removed, otherwise 0.
+ */
+
 int list_for_each (List l, ListForF f, void *arg);
 /*
  *  For each item in list [l], invokes the function [f] with [arg].
@@ -0,0 +1,238 @@
+/*****************************************************************************\
+ *  lz4.c - compression of message data in the LZ4 block format
+ *****************************************************************************
+ *  Copyright (C) 2015 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <string.h>
+
+#include "slurm/slurm_errno.h"
+#include "src/common/lz4.h"
+
+#define LZ4_HASH_BITS		12
+#define LZ4_MIN_MATCH		4
+#define LZ4_MF_LIMIT		12	/* matches start at least this many
+					 * bytes before the end of the data */
+#define LZ4_LAST_LITERALS	5	/* and end at least this many */
+#define LZ4_MAX_OFFSET		65535
+#define LZ4_SKIP_TRIGGER	6	/* step further after each 2^6 bytes
+					 * searched without finding a match */
+
+static inline uint32_t _read32(const uint8_t *p)
+{
+	uint32_t val;
+
+	memcpy(&val, p, sizeof(val));
+	return val;
+}
+
+static inline uint64_t _read64(const uint8_t *p)
+{
+	uint64_t val;
+
+	memcpy(&val, p, sizeof(val));
+	return val;
+}
+
+static inline uint32_t _hash(const uint8_t *p)
+{
+	return (_read32(p) * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+/* Write the bytes extending a literal or match length of 15 or more */
+static inline uint8_t *_put_len(uint8_t *op, uint32_t len)
+{
+	for (len -= 15; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = (uint8_t) len;
+	return op;
+}
+
+/* Read the bytes extending a literal or match length of 15,
+ * RET SLURM_SUCCESS or SLURM_ERROR if they run past the end of the data */
+static inline int _get_len(const uint8_t **ipp, const uint8_t *ip_end,
+			   size_t *len)
+{
+	const uint8_t *ip = *ipp;
+	uint8_t b;
+
+	do {
+		if (ip >= ip_end)
+			return SLURM_ERROR;
+		b = *ip++;
+		*len += b;
+	} while (b == 255);
+	*ipp = ip;
+	return SLURM_SUCCESS;
+}
+
+extern uint32_t lz4_compress_bound(uint32_t size)
+{
+	return size + (size / 255) + 16;
+}
+
+extern uint32_t lz4_compress(const char *src, uint32_t src_len,
+			     char *dst, uint32_t dst_max)
+{
+	const uint8_t *in = (const uint8_t *) src, *in_end = in + src_len;
+	const uint8_t *ip = in, *anchor = in, *ref;
+	uint8_t *op = (uint8_t *) dst, *op_end = op + dst_max, *token;
+	uint32_t table[1 << LZ4_HASH_BITS];
+	uint32_t h, lit, len, miss = 0;
+
+	if (src_len > LZ4_MF_LIMIT) {
+		const uint8_t *mf_limit = in_end - LZ4_MF_LIMIT;
+		const uint8_t *match_limit = in_end - LZ4_LAST_LITERALS;
+
+		memset(table, 0, sizeof(table));
+		ip++;
+		while (ip <= mf_limit) {
+			h = _hash(ip);
+			ref = in + table[h];
+			table[h] = (uint32_t) (ip - in);
+			if (((ip - ref) > LZ4_MAX_OFFSET) ||
+			    (_read32(ref) != _read32(ip))) {
+				ip += 1 + (miss++ >> LZ4_SKIP_TRIGGER);
+				continue;
+			}
+			miss = 0;
+
+			while ((ip > anchor) && (ref > in) &&
+			       (ip[-1] == ref[-1])) {
+				ip--;
+				ref--;
+			}
+			len = LZ4_MIN_MATCH;
+			while ((ip + len + sizeof(uint64_t) <= match_limit) &&
+			       (_read64(ip + len) == _read64(ref + len)))
+				len += sizeof(uint64_t);
+			while ((ip + len < match_limit) && (ip[len] == ref[len]))
+				len++;
+
+			lit = (uint32_t) (ip - anchor);
+			if ((op_end - op) <
+			    ((int64_t) lit + (lit / 255) + (len / 255) + 8))
+				return 0;
+			token = op++;
+			if (lit >= 15) {
+				*token = 15 << 4;
+				op = _put_len(op, lit);
+			} else
+				*token = lit << 4;
+			memcpy(op, anchor, lit);
+			op += lit;
+			*op++ = (uint8_t) (ip - ref);
+			*op++ = (uint8_t) ((ip - ref) >> 8);
+			len -= LZ4_MIN_MATCH;
+			if (len >= 15) {
+				*token |= 15;
+				op = _put_len(op, len);
+			} else
+				*token |= len;
+
+			ip += len + LZ4_MIN_MATCH;
+			anchor = ip;
+			if (ip <= mf_limit)
+				table[_hash(ip - 2)] = (uint32_t) (ip - 2 - in);
+		}
+	}
+
+	/* The data always ends with a sequence of literals only */
+	lit = (uint32_t) (in_end - anchor);
+	if ((op_end - op) < ((int64_t) lit + (lit / 255) + 2))
+		return 0;
+	token = op++;
+	if (lit >= 15) {
+		*token = 15 << 4;
+		op = _put_len(op, lit);
+	} else
+		*token = lit << 4;
+	memcpy(op, anchor, lit);
+	op += lit;
+
+	return (uint32_t) (op - (uint8_t *) dst);
+}
+
+extern int lz4_decompress(const char *src, uint32_t src_len,
+			  char *dst, uint32_t dst_len)
+{
+	const uint8_t *ip = (const uint8_t *) src, *ip_end = ip + src_len;
+	uint8_t *op = (uint8_t *) dst, *op_end = op + dst_len, *ref;
+	size_t lit, len, offset, i;
+	uint8_t token;
+
+	while (ip < ip_end) {
+		token = *ip++;
+		lit = token >> 4;
+		if ((lit == 15) && _get_len(&ip, ip_end, &lit))
+			return SLURM_ERROR;
+		if ((lit > (size_t) (ip_end - ip)) ||
+		    (lit > (size_t) (op_end - op)))
+			return SLURM_ERROR;
+		memcpy(op, ip, lit);
+		op += lit;
+		ip += lit;
+		if (ip == ip_end)
+			break;		/* last sequence has no match */
+
+		if ((ip_end - ip) < 2)
+			return SLURM_ERROR;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if ((offset == 0) || (offset > (size_t) (op - (uint8_t *) dst)))
+			return SLURM_ERROR;
+		len = token & 15;
+		if ((len == 15) && _get_len(&ip, ip_end, &len))
+			return SLURM_ERROR;
+		len += LZ4_MIN_MATCH;
+		if (len > (size_t) (op_end - op))
+			return SLURM_ERROR;
+
+		ref = op - offset;
+		if ((offset >= sizeof(uint64_t)) &&
+		    ((size_t) (op_end - op) >= len + sizeof(uint64_t))) {
+			/* matches are short, copy words rather than calling
+			 * memcpy(), overrunning into space not yet written */
+			for (i = 0; i < len; i += sizeof(uint64_t))
+				memcpy(op + i, ref + i, sizeof(uint64_t));
+		} else {
+			/* an overlapping match repeats the last offset bytes */
+			for (i = 0; i < len; i++)
+				op[i] = ref[i];
+		}
+		op += len;
+	}
+
+	if (op != op_end)
+		return SLURM_ERROR;
+	return SLURM_SUCCESS;
+}
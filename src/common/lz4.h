@@ -0,0 +1,68 @@
+/*****************************************************************************\
+ *  lz4.h - compression of message data in the LZ4 block format
+ *****************************************************************************
+ *  Copyright (C) 2015 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _SLURM_LZ4_H
+#define _SLURM_LZ4_H
+
+#include <inttypes.h>
+
+/*
+ * A small implementation of the LZ4 block format, used to compress large
+ * messages. It favors speed over compression ratio: the data is compressed
+ * in a single pass matching 4 byte sequences found through a hash table,
+ * skipping ahead faster through data which does not compress. Blocks are
+ * compatible with other LZ4 implementations.
+ */
+
+/* Return the largest size of size bytes of data once compressed */
+extern uint32_t lz4_compress_bound(uint32_t size);
+
+/*
+ * Compress src_len bytes of src into dst, which has room for dst_max bytes.
+ * RET size of the compressed data or 0 if it does not fit in dst
+ */
+extern uint32_t lz4_compress(const char *src, uint32_t src_len,
+			     char *dst, uint32_t dst_max);
+
+/*
+ * Decompress src_len bytes of src into dst, which must be the exact size
+ * of the uncompressed data, dst_len. Malformed data is detected and never
+ * causes access outside src or dst.
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+extern int lz4_decompress(const char *src, uint32_t src_len,
+			  char *dst, uint32_t dst_len);
+
+#endif /* !_SLURM_LZ4_H */
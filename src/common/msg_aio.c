@@ -0,0 +1,936 @@
+/*****************************************************************************\
+ *  msg_aio.c - send messages to many nodes from a few threads
+ *****************************************************************************
+ *  Copyright (C) 2015 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#ifdef WITH_PTHREADS
+#  include <pthread.h>
+#endif				/* WITH_PTHREADS */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "src/common/fd.h"
+#include "src/common/forward.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/msg_aio.h"
+#include "src/common/pack.h"
+#include "src/common/read_config.h"
+#include "src/common/slurm_protocol_api.h"
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#define MSG_AIO_MAGIC	0x41494f4d
+#define MAX_MSG_SIZE	(1024*1024*1024)	/* as slurm_msg_recvfrom() */
+#define AIO_RETRY_MSEC	1000	/* delay before connecting again to a node
+				 * which refused the connection */
+#define AIO_POLL_MSEC	1000	/* longest poll() without timeout checks */
+
+typedef enum {
+	AIO_START,		/* next node to be sent to */
+	AIO_RETRY,		/* waiting to connect again after refusal */
+	AIO_CONNECT,		/* connect in progress */
+	AIO_SEND,		/* sending the message */
+	AIO_RECV,		/* reading the response */
+	AIO_DONE		/* request complete */
+} aio_state_t;
+
+typedef struct aio_req {
+	struct aio_req *next;	/* in the queue of requests not started */
+	msg_aio_done_f done;
+	void *arg;
+	slurm_msg_t msg;	/* message, with the forward list of the
+				 * node it is being sent to */
+	char *name;		/* node the message is being sent to */
+	hostlist_t hl;		/* tree requests: nodes not sent to yet */
+	header_t *header;	/* header, packed for each node with its
+				 * forward list */
+	BufChain body;		/* auth credential and body of the message,
+				 * for forward requests the rest of the
+				 * message received, not owned */
+	int pack_err;		/* errno if the message could not be packed */
+	bool forward;		/* forwarding a message received */
+	bool get_reply;
+	bool tree;
+	int timeout;		/* msec each node waits for a response */
+	List ret_list;		/* responses collected so far */
+	int rc;			/* result of requests without response */
+
+	aio_state_t state;
+	uint64_t deadline;	/* msec time by which the state must end */
+	short revents;		/* from the last poll() */
+	slurm_fd_t fd;
+	int attempt_cnt;	/* count of nodes sent to */
+	int conn_retry;		/* count of refused connections */
+	int recv_timeout;	/* msec to wait for the response */
+	BufChain chain;		/* header packed for the current node */
+	struct iovec *iov;	/* length prefix, chain and body to be sent */
+	int iov_cnt, iov_inx;
+	uint32_t len_net;	/* length prefix of the message */
+	char len_buf[4];	/* length prefix of the response */
+	size_t len_read;
+	char *buf;		/* response, from buf_pool_alloc() */
+	uint32_t msglen;
+	size_t buf_read;
+} aio_req_t;
+
+typedef struct aio_thread {
+	pthread_t tid;
+	pthread_mutex_t mutex;
+	aio_req_t *queue_head;	/* requests not started yet, protected by
+				 * mutex */
+	aio_req_t *queue_tail;
+	int load;		/* requests queued or in progress, protected
+				 * by mutex */
+	bool shutdown;		/* protected by mutex */
+	int wake_fd[2];		/* pipe to interrupt poll() */
+	int max_conn;		/* limit of active_cnt */
+	aio_req_t **active;	/* requests in progress */
+	int active_cnt, active_size;
+} aio_thread_t;
+
+struct msg_aio {
+	uint32_t magic;
+	aio_thread_t *thread;
+	int thread_cnt;
+};
+
+static int msg_timeout = -1;	/* MessageTimeout in msec */
+static int conn_retry_max = -1;	/* refused connections retried per node */
+
+static uint64_t _now_msec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return ((uint64_t) tv.tv_sec * 1000) + (tv.tv_usec / 1000);
+}
+
+/* Close the request's connection and release the data of its current
+ * node */
+static void _close_conn(aio_req_t *req)
+{
+	if (req->fd >= 0) {
+		(void) shutdown(req->fd, SHUT_RDWR);
+		(void) close(req->fd);
+		req->fd = -1;
+	}
+	if (req->chain) {
+		free_buf_chain(req->chain);
+		req->chain = NULL;
+	}
+	xfree(req->iov);
+	buf_pool_free(req->buf);
+	req->buf = NULL;
+	req->len_read = 0;
+	req->buf_read = 0;
+}
+
+/* Pick the next node to send the request to, the others of a tree
+ * request become its forward list.
+ * RET false if there is no node left */
+static bool _next_node(aio_req_t *req)
+{
+	char *name;
+
+	if (!req->tree)
+		return (req->attempt_cnt++ == 0);
+
+	while ((name = hostlist_shift(req->hl))) {
+		xfree(req->name);
+		req->name = xstrdup(name);
+		free(name);
+		if (slurm_conf_get_addr(req->name, &req->msg.address) ==
+		    SLURM_ERROR) {
+			error("msg_aio: can't find address for host %s, "
+			      "check slurm.conf", req->name);
+			mark_as_failed_forward(&req->ret_list, req->name,
+					       SLURM_UNKNOWN_FORWARD_ADDR);
+			continue;
+		}
+		xfree(req->msg.forward.nodelist);
+		req->msg.forward.cnt = hostlist_count(req->hl);
+		if (req->msg.forward.cnt) {
+			req->msg.forward.nodelist =
+				hostlist_ranged_string_xmalloc(req->hl);
+			debug3("Tree sending to %s along with %s",
+			       req->name, req->msg.forward.nodelist);
+		} else
+			debug3("Tree sending to %s", req->name);
+		req->attempt_cnt++;
+		return true;
+	}
+	return false;
+}
+
+/* Time to wait for a node's response, which includes the time for it to
+ * collect the responses of the nodes it forwards the message to
+ * (see _send_and_recv_msgs()) */
+static int _recv_timeout(aio_req_t *req)
+{
+	int steps, width, timeout = req->timeout;
+
+	if (req->msg.forward.cnt > 0) {
+		steps = req->msg.forward.cnt + 1;
+		width = slurm_get_tree_width();
+		if (width)
+			steps /= width;
+		timeout = msg_timeout * steps;
+		steps++;
+		timeout += req->timeout * steps;
+	}
+	return timeout;
+}
+
+/*
+ * Record the result of sending the message to the current node and pick
+ * what to do next, as _fwd_tree_thread() does: if the node could not
+ * forward the message, send it to the next node along with the nodes
+ * which did not respond.
+ * IN ret_list - responses, or NULL if the node could not be reached
+ * IN err - error code of the attempt
+ */
+static void _attempt_done(aio_req_t *req, List ret_list, int err)
+{
+	ret_data_info_t *ret_data_info;
+	ListIterator itr;
+	int ret_cnt;
+
+	_close_conn(req);
+	req->state = AIO_DONE;
+	if (!req->get_reply && !req->tree) {
+		req->rc = err ? err : SLURM_ERROR;
+		return;
+	}
+
+	if (!ret_list) {
+		mark_as_failed_forward(&ret_list, req->name, err);
+		err = SLURM_COMMUNICATIONS_CONNECTION_ERROR;
+	} else {
+		itr = list_iterator_create(ret_list);
+		while ((ret_data_info = list_next(itr))) {
+			if (!ret_data_info->node_name) {
+				ret_data_info->node_name =
+					xstrdup(req->name);
+			}
+		}
+		list_iterator_destroy(itr);
+	}
+	ret_cnt = ret_list_node_count(ret_list);
+
+	if (req->tree && (ret_cnt <= req->msg.forward.cnt) &&
+	    (err != SLURM_COMMUNICATIONS_CONNECTION_ERROR)) {
+		/* This is most common if a slurmd is running an older
+		 * version of Slurm than the originator of the message */
+		error("msg_aio: %s failed to forward the message, "
+		      "expecting %d ret got only %d",
+		      req->name, req->msg.forward.cnt + 1, ret_cnt);
+		if (ret_cnt > 1) {	/* not likely */
+			itr = list_iterator_create(ret_list);
+			while ((ret_data_info = list_next(itr))) {
+				if (strcmp(ret_data_info->node_name,
+					   req->name)) {
+					hostlist_delete(
+						req->hl,
+						ret_data_info->node_name);
+				}
+			}
+			list_iterator_destroy(itr);
+		}
+	}
+	list_transfer(req->ret_list, ret_list);
+	list_destroy(ret_list);
+
+	if (req->tree && ((ret_cnt <= req->msg.forward.cnt) ||
+			  (err == SLURM_COMMUNICATIONS_CONNECTION_ERROR)))
+		req->state = AIO_START;		/* try the next node */
+}
+
+/* Handle a failure to connect, connections refused by a node are retried
+ * for a while to survive slurmd restarts
+ * (see slurm_send_addr_recv_msgs()) */
+static void _conn_failed(aio_req_t *req, int err, uint64_t now)
+{
+	if (req->fd >= 0) {
+		(void) close(req->fd);
+		req->fd = -1;
+	}
+	if ((err == ECONNREFUSED) && req->get_reply &&
+	    (req->conn_retry < conn_retry_max)) {
+		if (req->conn_retry++ == 0)
+			debug3("connect refused, retrying");
+		req->state = AIO_RETRY;
+		req->deadline = now + AIO_RETRY_MSEC;
+		return;
+	}
+
+	debug2("msg_aio: connect to %s failed: %s",
+	       req->name, slurm_strerror(err));
+	_attempt_done(req, NULL, req->get_reply ?
+		      SLURM_COMMUNICATIONS_CONNECTION_ERROR : err);
+}
+
+/* Start a non-blocking connection to the current node */
+static void _connect(aio_req_t *req, uint64_t now)
+{
+	slurm_addr_t *addr = &req->msg.address;
+
+	if ((addr->sin_family == 0) || (addr->sin_port == 0)) {
+		error("Error connecting, bad data: family = %u, port = %u",
+		      addr->sin_family, addr->sin_port);
+		_conn_failed(req, SLURM_COMMUNICATIONS_CONNECTION_ERROR, now);
+		return;
+	}
+	if ((req->fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) < 0) {
+		error("msg_aio: socket: %m");
+		_conn_failed(req, errno, now);
+		return;
+	}
+	fd_set_nonblocking(req->fd);
+	fd_set_close_on_exec(req->fd);
+
+	if (connect(req->fd, (struct sockaddr *) addr, sizeof(*addr)) == 0) {
+		req->state = AIO_SEND;
+		req->deadline = now + msg_timeout;
+	} else if (errno == EINPROGRESS) {
+		/* as _slurm_connect() */
+		req->state = AIO_CONNECT;
+		req->deadline = now + (msg_timeout / 2);
+	} else
+		_conn_failed(req, errno, now);
+}
+
+/* Pack the message with a new auth credential, which is done before the
+ * request is queued so that engine threads do not wait for it */
+static void _pack_req(aio_req_t *req)
+{
+	if (req->body)
+		free_buf_chain(req->body);
+	if (!req->header)
+		req->header = xmalloc(sizeof(header_t));
+	if (!(req->body = slurm_pack_node_msg(&req->msg, req->header)))
+		req->pack_err = errno;
+}
+
+/* Tree requests without response: consider every node of the branch to
+ * have the message once its first node does */
+static void _tree_sent(aio_req_t *req)
+{
+	ret_data_info_t *ret_data_info;
+	char *name;
+
+	ret_data_info = xmalloc(sizeof(ret_data_info_t));
+	ret_data_info->node_name = xstrdup(req->name);
+	list_push(req->ret_list, ret_data_info);
+	while ((name = hostlist_shift(req->hl))) {
+		ret_data_info = xmalloc(sizeof(ret_data_info_t));
+		ret_data_info->node_name = xstrdup(name);
+		list_push(req->ret_list, ret_data_info);
+		free(name);
+	}
+}
+
+/* Pack the header for the current node and connect to it */
+static void _start_node(aio_req_t *req, uint64_t now)
+{
+	header_t header;
+	int iov_cnt;
+
+	/* A node sent to before may have forwarded the message to this one,
+	 * which would reject the same credential as replayed */
+	if (!req->forward && (req->attempt_cnt > 1))
+		_pack_req(req);
+	if (!req->body) {
+		_attempt_done(req, NULL, req->pack_err);
+		return;
+	}
+
+	memcpy(&header, req->header, sizeof(header_t));
+	header.forward = req->msg.forward;	/* not owned by header */
+	req->chain = init_buf_chain();
+	pack_header(&header, buf_chain_tail(req->chain));
+
+	req->iov = xmalloc(sizeof(struct iovec) * (req->body->seg_cnt + 2));
+	iov_cnt = buf_chain_iovec(req->chain, req->iov + 1) + 1;
+	req->iov_cnt = buf_chain_iovec(req->body, req->iov + iov_cnt) +
+		       iov_cnt;
+	req->len_net = htonl(size_buf_chain(req->chain) +
+			     size_buf_chain(req->body));
+	req->iov[0].iov_base = &req->len_net;
+	req->iov[0].iov_len = sizeof(req->len_net);
+	req->iov_inx = 0;
+	req->conn_retry = 0;
+	req->recv_timeout = _recv_timeout(req);
+	_connect(req, now);
+}
+
+/* Send what the socket accepts of the message
+ * RET 1 once it is all sent, 0 if more remains, -1 on error and sets
+ *	errno */
+static int _send(aio_req_t *req)
+{
+	struct msghdr mh;
+	struct iovec *iov;
+	ssize_t n;
+
+	while (1) {
+		while ((req->iov_inx < req->iov_cnt) &&
+		       (req->iov[req->iov_inx].iov_len == 0))
+			req->iov_inx++;
+		if (req->iov_inx >= req->iov_cnt)
+			return 1;
+
+		memset(&mh, 0, sizeof(mh));
+		mh.msg_iov = &req->iov[req->iov_inx];
+		mh.msg_iovlen = req->iov_cnt - req->iov_inx;
+		n = sendmsg(req->fd, &mh, MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				return 0;
+			return -1;
+		}
+		while (n > 0) {
+			iov = &req->iov[req->iov_inx];
+			if (n >= iov->iov_len) {
+				n -= iov->iov_len;
+				iov->iov_len = 0;
+				req->iov_inx++;
+			} else {
+				iov->iov_base = (char *) iov->iov_base + n;
+				iov->iov_len -= n;
+				n = 0;
+			}
+		}
+	}
+}
+
+/* Read what is available of the response
+ * RET 1 once it is all read, 0 if more remains, -1 on error and sets
+ *	errno */
+static int _recv(aio_req_t *req)
+{
+	ssize_t n;
+
+	while (req->len_read < sizeof(req->len_buf)) {
+		n = recv(req->fd, req->len_buf + req->len_read,
+			 sizeof(req->len_buf) - req->len_read, 0);
+		if (n == 0) {
+			slurm_seterrno(SLURM_PROTOCOL_SOCKET_ZERO_BYTES_SENT);
+			return -1;
+		} else if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				return 0;
+			return -1;
+		}
+		req->len_read += n;
+		if (req->len_read < sizeof(req->len_buf))
+			continue;
+		memcpy(&req->msglen, req->len_buf, sizeof(req->msglen));
+		req->msglen = ntohl(req->msglen);
+		if (req->msglen > MAX_MSG_SIZE) {
+			slurm_seterrno(SLURM_PROTOCOL_INSANE_MSG_LENGTH);
+			return -1;
+		}
+		req->buf = buf_pool_alloc(req->msglen);
+	}
+
+	while (req->buf_read < req->msglen) {
+		n = recv(req->fd, req->buf + req->buf_read,
+			 req->msglen - req->buf_read, 0);
+		if (n == 0) {
+			slurm_seterrno(SLURM_PROTOCOL_SOCKET_ZERO_BYTES_SENT);
+			return -1;
+		} else if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+				return 0;
+			return -1;
+		}
+		req->buf_read += n;
+	}
+	return 1;
+}
+
+/*
+ * Advance a request as far as it can go without blocking
+ * IN revents - events from poll() on the request's connection
+ * IN now - current time in msec
+ * RET true once the request is complete
+ */
+static bool _req_run(aio_req_t *req, short revents, uint64_t now)
+{
+	List ret_list;
+	socklen_t len;
+	int err, rc;
+
+	while (1) {
+		switch (req->state) {
+		case AIO_START:
+			if (!_next_node(req))
+				return true;
+			_start_node(req, now);
+			revents = 0;
+			break;
+		case AIO_RETRY:
+			if (now < req->deadline)
+				return false;
+			_connect(req, now);
+			break;
+		case AIO_CONNECT:
+			if (!revents) {
+				if (now < req->deadline)
+					return false;
+				_conn_failed(req, ETIMEDOUT, now);
+				break;
+			}
+			revents = 0;
+			err = 0;
+			len = sizeof(err);
+			if (getsockopt(req->fd, SOL_SOCKET, SO_ERROR,
+				       &err, &len) < 0)
+				err = errno;
+			if (err) {
+				_conn_failed(req, err, now);
+				break;
+			}
+			req->state = AIO_SEND;
+			req->deadline = now + msg_timeout;
+			break;
+		case AIO_SEND:
+			if ((rc = _send(req)) < 0) {
+				_attempt_done(req, NULL, errno);
+				break;
+			} else if (rc == 0) {
+				if (now < req->deadline)
+					return false;
+				_attempt_done(req, NULL,
+					      SLURM_PROTOCOL_SOCKET_IMPL_TIMEOUT);
+				break;
+			}
+			if (!req->get_reply) {
+				_close_conn(req);
+				if (req->tree)
+					_tree_sent(req);
+				else
+					req->rc = SLURM_SUCCESS;
+				return true;
+			}
+			req->state = AIO_RECV;
+			req->deadline = now + req->recv_timeout;
+			return false;
+		case AIO_RECV:
+			if ((rc = _recv(req)) < 0) {
+				_attempt_done(req, NULL, errno);
+				break;
+			} else if (rc == 0) {
+				if (now < req->deadline)
+					return false;
+				_attempt_done(req, NULL,
+					      SLURM_PROTOCOL_SOCKET_IMPL_TIMEOUT);
+				break;
+			}
+			/* slurm_unpack_received_msgs() consumes buf */
+			ret_list = slurm_unpack_received_msgs(req->fd, req->buf,
+							      req->msglen);
+			err = errno;
+			req->buf = NULL;
+			_attempt_done(req, ret_list, err);
+			break;
+		case AIO_DONE:
+			return true;
+		}
+	}
+}
+
+static void _free_req(aio_req_t *req)
+{
+	_close_conn(req);
+	xfree(req->name);
+	if (req->hl)
+		hostlist_destroy(req->hl);
+	xfree(req->header);
+	if (req->body)
+		free_buf_chain(req->body);
+	destroy_forward(&req->msg.forward);
+	if (req->ret_list)
+		list_destroy(req->ret_list);
+	xfree(req);
+}
+
+/* Report a request complete and release it */
+static void _req_complete(aio_thread_t *thd, aio_req_t *req)
+{
+	List ret_list = req->ret_list;
+
+	req->ret_list = NULL;
+	(req->done)(ret_list, req->rc, req->arg);
+	_free_req(req);
+
+	slurm_mutex_lock(&thd->mutex);
+	thd->load--;
+	slurm_mutex_unlock(&thd->mutex);
+}
+
+/* Complete a request the engine is shut down before, every node not
+ * heard from is marked as failed to communicate */
+static void _req_abort(aio_thread_t *thd, aio_req_t *req)
+{
+	char *name;
+
+	_close_conn(req);
+	if (!req->get_reply && !req->tree) {
+		req->rc = SLURM_COMMUNICATIONS_CONNECTION_ERROR;
+	} else {
+		if (req->tree ? (req->state != AIO_START) :
+				(list_count(req->ret_list) == 0)) {
+			mark_as_failed_forward(
+				&req->ret_list, req->name,
+				SLURM_COMMUNICATIONS_CONNECTION_ERROR);
+		}
+		while (req->hl && (name = hostlist_shift(req->hl))) {
+			mark_as_failed_forward(
+				&req->ret_list, name,
+				SLURM_COMMUNICATIONS_CONNECTION_ERROR);
+			free(name);
+		}
+	}
+	_req_complete(thd, req);
+}
+
+static void *_aio_thread(void *arg)
+{
+	aio_thread_t *thd = (aio_thread_t *) arg;
+	struct pollfd *pfds = NULL;
+	int pfds_size = 0, complete_cnt, nfds, timeout, i;
+	aio_req_t *req;
+	uint64_t now, wait;
+	char buf[64];
+	bool shutdown = false;
+
+	while (1) {
+		/* Start queued requests while connections are available */
+		slurm_mutex_lock(&thd->mutex);
+		shutdown = thd->shutdown;
+		while (!shutdown && thd->queue_head &&
+		       (thd->active_cnt < thd->max_conn)) {
+			req = thd->queue_head;
+			if (!(thd->queue_head = req->next))
+				thd->queue_tail = NULL;
+			req->next = NULL;
+			if (thd->active_cnt >= thd->active_size) {
+				thd->active_size += 64;
+				xrealloc(thd->active, sizeof(aio_req_t *) *
+						      thd->active_size);
+			}
+			thd->active[thd->active_cnt++] = req;
+		}
+		slurm_mutex_unlock(&thd->mutex);
+		if (shutdown)
+			break;
+
+		/* Advance requests just started, with events or timed out */
+		now = _now_msec();
+		complete_cnt = 0;
+		for (i = thd->active_cnt - 1; i >= 0; i--) {
+			req = thd->active[i];
+			if ((req->state != AIO_START) && !req->revents &&
+			    (now < req->deadline))
+				continue;
+			if (!_req_run(req, req->revents, now)) {
+				req->revents = 0;
+				continue;
+			}
+			thd->active[i] = thd->active[--thd->active_cnt];
+			_req_complete(thd, req);
+			complete_cnt++;
+		}
+		if (complete_cnt)
+			continue;	/* start queued requests */
+
+		/* Wait for events on the connections */
+		if (pfds_size < (thd->active_cnt + 1)) {
+			pfds_size = thd->active_cnt + 64;
+			xrealloc(pfds, sizeof(struct pollfd) * pfds_size);
+		}
+		timeout = -1;
+		for (nfds = 0; nfds < thd->active_cnt; nfds++) {
+			req = thd->active[nfds];
+			pfds[nfds].fd = req->fd;
+			if (req->state == AIO_RECV)
+				pfds[nfds].events = POLLIN;
+			else
+				pfds[nfds].events = POLLOUT;
+			pfds[nfds].revents = 0;
+			wait = (req->deadline > now) ? (req->deadline - now) :0;
+			if ((timeout < 0) || (wait < timeout))
+				timeout = MIN(wait, AIO_POLL_MSEC);
+		}
+		pfds[nfds].fd = thd->wake_fd[0];
+		pfds[nfds].events = POLLIN;
+		pfds[nfds].revents = 0;
+		if ((poll(pfds, nfds + 1, timeout) < 0) && (errno != EINTR))
+			error("msg_aio: poll: %m");
+		for (i = 0; i < nfds; i++)
+			thd->active[i]->revents = pfds[i].revents;
+		if (pfds[nfds].revents) {
+			while (read(thd->wake_fd[0], buf, sizeof(buf)) > 0)
+				;
+		}
+	}
+
+	/* Fail the requests left */
+	for (i = 0; i < thd->active_cnt; i++)
+		_req_abort(thd, thd->active[i]);
+	thd->active_cnt = 0;
+	slurm_mutex_lock(&thd->mutex);
+	req = thd->queue_head;
+	thd->queue_head = thd->queue_tail = NULL;
+	slurm_mutex_unlock(&thd->mutex);
+	while (req) {
+		aio_req_t *next = req->next;
+		_req_abort(thd, req);
+		req = next;
+	}
+	xfree(pfds);
+	return NULL;
+}
+
+static void _wake_thread(aio_thread_t *thd)
+{
+	char c = 0;
+
+	/* The pipe is only full if it is already readable */
+	if ((write(thd->wake_fd[1], &c, 1) < 0) && (errno != EAGAIN))
+		error("msg_aio: write: %m");
+}
+
+/* Queue a request to the least loaded thread of the engine */
+static void _queue_req(msg_aio_t *aio, aio_req_t *req)
+{
+	aio_thread_t *thd = NULL;
+	int i, load, min_load = -1;
+
+	xassert(aio->magic == MSG_AIO_MAGIC);
+	for (i = 0; i < aio->thread_cnt; i++) {
+		slurm_mutex_lock(&aio->thread[i].mutex);
+		load = aio->thread[i].load;
+		slurm_mutex_unlock(&aio->thread[i].mutex);
+		if ((min_load < 0) || (load < min_load)) {
+			min_load = load;
+			thd = &aio->thread[i];
+		}
+	}
+
+	slurm_mutex_lock(&thd->mutex);
+	if (thd->queue_tail)
+		thd->queue_tail->next = req;
+	else
+		thd->queue_head = req;
+	thd->queue_tail = req;
+	thd->load++;
+	slurm_mutex_unlock(&thd->mutex);
+	_wake_thread(thd);
+}
+
+static aio_req_t *_new_req(slurm_msg_t *msg, hostlist_t hl, bool get_reply,
+			   int timeout, msg_aio_done_f done, void *arg)
+{
+	aio_req_t *req = xmalloc(sizeof(aio_req_t));
+
+	req->done = done;
+	req->arg = arg;
+	slurm_msg_t_init(&req->msg);
+	if (msg) {
+		req->msg.msg_type = msg->msg_type;
+		req->msg.data = msg->data;
+		req->msg.flags = msg->flags;
+		req->msg.protocol_version = msg->protocol_version;
+		req->msg.address = msg->address;
+	}
+	req->get_reply = get_reply;
+	req->tree = (hl != NULL);
+	req->hl = hl;
+	req->timeout = (timeout > 0) ? timeout : msg_timeout;
+	req->msg.forward.timeout = req->timeout;
+	if (get_reply || req->tree)
+		req->ret_list = list_create(destroy_data_info);
+	req->state = AIO_START;
+	req->fd = -1;
+	return req;
+}
+
+extern msg_aio_t *msg_aio_create(int thread_cnt, int max_conn)
+{
+	msg_aio_t *aio = xmalloc(sizeof(msg_aio_t));
+	aio_thread_t *thd;
+	pthread_attr_t attr;
+	int i;
+
+	if (msg_timeout < 0) {
+		msg_timeout = slurm_get_msg_timeout() * 1000;
+		conn_retry_max = MIN(slurm_get_msg_timeout(), 10);
+	}
+
+	aio->magic = MSG_AIO_MAGIC;
+	aio->thread_cnt = MAX(thread_cnt, 1);
+	aio->thread = xmalloc(sizeof(aio_thread_t) * aio->thread_cnt);
+	for (i = 0; i < aio->thread_cnt; i++) {
+		thd = &aio->thread[i];
+		slurm_mutex_init(&thd->mutex);
+		thd->max_conn = MAX(max_conn / aio->thread_cnt, 1);
+		if (pipe(thd->wake_fd) < 0)
+			fatal("msg_aio: pipe: %m");
+		fd_set_close_on_exec(thd->wake_fd[0]);
+		fd_set_close_on_exec(thd->wake_fd[1]);
+		fd_set_nonblocking(thd->wake_fd[0]);
+		fd_set_nonblocking(thd->wake_fd[1]);
+
+		slurm_attr_init(&attr);
+		if (pthread_create(&thd->tid, &attr, _aio_thread, thd))
+			fatal("msg_aio: pthread_create: %m");
+		slurm_attr_destroy(&attr);
+	}
+	debug2("msg_aio: started %d threads for up to %d connections",
+	       aio->thread_cnt, MAX(max_conn, aio->thread_cnt));
+
+	return aio;
+}
+
+extern void msg_aio_destroy(msg_aio_t *aio)
+{
+	aio_thread_t *thd;
+	int i;
+
+	if (!aio)
+		return;
+	xassert(aio->magic == MSG_AIO_MAGIC);
+
+	for (i = 0; i < aio->thread_cnt; i++) {
+		thd = &aio->thread[i];
+		slurm_mutex_lock(&thd->mutex);
+		thd->shutdown = true;
+		slurm_mutex_unlock(&thd->mutex);
+		_wake_thread(thd);
+	}
+	for (i = 0; i < aio->thread_cnt; i++) {
+		thd = &aio->thread[i];
+		pthread_join(thd->tid, NULL);
+		(void) close(thd->wake_fd[0]);
+		(void) close(thd->wake_fd[1]);
+		slurm_mutex_destroy(&thd->mutex);
+		xfree(thd->active);
+	}
+	aio->magic = ~MSG_AIO_MAGIC;
+	xfree(aio->thread);
+	xfree(aio);
+}
+
+extern void msg_aio_fork_close(msg_aio_t *aio)
+{
+	aio_thread_t *thd;
+	int i, j;
+
+	if (!aio)
+		return;
+	xassert(aio->magic == MSG_AIO_MAGIC);
+
+	for (i = 0; i < aio->thread_cnt; i++) {
+		thd = &aio->thread[i];
+		for (j = 0; j < thd->active_cnt; j++) {
+			if (thd->active[j]->fd >= 0)
+				(void) close(thd->active[j]->fd);
+		}
+		(void) close(thd->wake_fd[0]);
+		(void) close(thd->wake_fd[1]);
+		xfree(thd->active);
+	}
+	aio->magic = ~MSG_AIO_MAGIC;
+	xfree(aio->thread);
+	xfree(aio);
+}
+
+extern void msg_aio_send_addr(msg_aio_t *aio, slurm_msg_t *msg, char *name,
+			      bool get_reply, int timeout,
+			      msg_aio_done_f done, void *arg)
+{
+	aio_req_t *req = _new_req(msg, NULL, get_reply, timeout, done, arg);
+
+	req->name = xstrdup(name);
+	_pack_req(req);
+	_queue_req(aio, req);
+}
+
+extern void msg_aio_send_tree(msg_aio_t *aio, slurm_msg_t *msg,
+			      hostlist_t hl, int timeout,
+			      msg_aio_done_f done, void *arg)
+{
+	aio_req_t *req = _new_req(msg, hl, true, timeout, done, arg);
+
+	_pack_req(req);
+	_queue_req(aio, req);
+}
+
+extern void msg_aio_forward(msg_aio_t *aio, header_t *header, char *buf,
+			    int buf_len, hostlist_t hl, bool get_reply,
+			    int timeout, msg_aio_done_f done, void *arg)
+{
+	aio_req_t *req = _new_req(NULL, hl, get_reply, timeout, done, arg);
+
+	req->header = xmalloc(sizeof(header_t));
+	memcpy(req->header, header, sizeof(header_t));
+	forward_init(&req->header->forward, NULL);
+	req->header->ret_cnt = 0;
+	req->header->ret_list = NULL;
+	req->body = init_buf_chain();
+	buf_chain_append_mem(req->body, buf, buf_len);
+	req->forward = true;
+	_queue_req(aio, req);
+}
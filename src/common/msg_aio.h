@@ -0,0 +1,146 @@
+/*****************************************************************************\
+ *  msg_aio.h - send messages to many nodes from a few threads
+ *****************************************************************************
+ *  Copyright (C) 2015 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _MSG_AIO_H
+#define _MSG_AIO_H
+
+#include "src/common/hostlist.h"
+#include "src/common/list.h"
+#include "src/common/slurm_protocol_defs.h"
+
+/*
+ * A msg_aio engine sends messages to nodes and reads their responses with
+ * non-blocking connections multiplexed by a few threads, so thousands of
+ * requests may be outstanding without a thread for each of them. Messages
+ * are packed with their auth credential by the functions queueing them,
+ * engine threads only pack the header of each node sent to.
+ */
+typedef struct msg_aio msg_aio_t;
+
+/*
+ * Function called by an engine thread once a request is complete. It is
+ * not called with any lock held, but should not block as it delays the
+ * other requests of the thread.
+ * IN ret_list - for requests with a response, the response of each node
+ *	(ret_data_info_t), as returned by slurm_send_addr_recv_msgs(), to
+ *	be destroyed by the function. NULL for requests to a single node
+ *	without a response.
+ * IN rc - for requests without a response, SLURM_SUCCESS if the message
+ *	was sent, otherwise an error code
+ * IN arg - argument given with the request
+ */
+typedef void (*msg_aio_done_f) (List ret_list, int rc, void *arg);
+
+/*
+ * Start a msg_aio engine
+ * IN thread_cnt - count of threads sending messages
+ * IN max_conn - maximum count of connections open at once, further
+ *	requests wait for one of them to complete
+ * RET the engine, to be destroyed with msg_aio_destroy()
+ */
+extern msg_aio_t *msg_aio_create(int thread_cnt, int max_conn);
+
+/* Stop an engine's threads, requests still in progress are completed as
+ * failed to communicate */
+extern void msg_aio_destroy(msg_aio_t *aio);
+
+/*
+ * Release in a child process an engine inherited from its parent, whose
+ * threads do not survive fork(). Its connections and pipes are closed.
+ * Its requests are neither completed nor freed, as the parent's threads
+ * may have held their locks at the time of the fork. Safe to call from a
+ * pthread_atfork() child handler.
+ */
+extern void msg_aio_fork_close(msg_aio_t *aio);
+
+/*
+ * Send a message to msg->address, in the manner of
+ *	slurm_send_addr_recv_msgs() or slurm_send_only_node_msg()
+ * IN aio - engine to send the message with
+ * IN msg - message to send, msg->data must stay valid until the request
+ *	is complete
+ * IN name - name of the node at msg->address, for ret_list
+ * IN get_reply - if set, wait for the node's response
+ * IN timeout - how long to wait for the response in milliseconds, 0 for
+ *	the default MessageTimeout
+ * IN done - function called once the request is complete
+ * IN arg - argument of done
+ */
+extern void msg_aio_send_addr(msg_aio_t *aio, slurm_msg_t *msg, char *name,
+			      bool get_reply, int timeout,
+			      msg_aio_done_f done, void *arg);
+
+/*
+ * Send a message to the first node of "hl" which can be reached, to be
+ *	forwarded by that node to the others, and collect the response of
+ *	every node. This is one branch of the tree built by
+ *	start_msg_tree().
+ * IN aio - engine to send the message with
+ * IN msg - message to send, msg->data must stay valid until the request
+ *	is complete
+ * IN hl - nodes to send the message to, consumed
+ * IN timeout - how long each node waits for a response in milliseconds,
+ *	0 for the default MessageTimeout
+ * IN done - function called once the request is complete
+ * IN arg - argument of done
+ */
+extern void msg_aio_send_tree(msg_aio_t *aio, slurm_msg_t *msg,
+			      hostlist_t hl, int timeout,
+			      msg_aio_done_f done, void *arg);
+
+/*
+ * Forward a message received by this node to the first node of "hl" which
+ *	can be reached, to be forwarded by that node to the others, and
+ *	collect the response of every node. This is one branch of the tree
+ *	built by forward_msg().
+ * IN aio - engine to send the message with
+ * IN header - header of the message received, its forward list is replaced
+ *	by the nodes of hl
+ * IN buf - rest of the message received (credential and body), sent as is,
+ *	must stay valid until the request is complete
+ * IN buf_len - size of buf
+ * IN hl - nodes to send the message to, consumed
+ * IN get_reply - if not set, every node of hl is considered to have the
+ *	message once it is sent to one of them
+ * IN timeout - how long each node waits for a response in milliseconds,
+ *	0 for the default MessageTimeout
+ * IN done - function called once the request is complete
+ * IN arg - argument of done
+ */
+extern void msg_aio_forward(msg_aio_t *aio, header_t *header, char *buf,
+			    int buf_len, hostlist_t hl, bool get_reply,
+			    int timeout, msg_aio_done_f done, void *arg);
+
+#endif /* !_MSG_AIO_H */
@@ -170,6 +170,12 @@ struct node_record {
 	uint16_t protocol_version;	/* Slurm version number */
 	char *version;			/* Slurm version */
 	bitstr_t *node_spec_bitmap;	/* node cpu specialization bitmap */
+	uint64_t delta_digest;		/* digest of packed node record,
+					 * no need to save/restore */
+	time_t delta_time;		/* time of last change detected in
+					 * packed node record, see
+					 * pack_all_node(), no need to
+					 * save/restore */
 };
 extern struct node_record *node_record_table_ptr;  /* ptr to node records */
 extern int node_record_count;		/* count in node_record_table_ptr */
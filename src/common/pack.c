@@ -49,10 +49,12 @@
 #include <string.h>
 #include <time.h>
 #include <inttypes.h>
+#include <pthread.h>
 
 #include "slurm/slurm_errno.h"
 
 #include "src/common/log.h"
+#include "src/common/lz4.h"
 #include "src/common/macros.h"
 #include "src/common/pack.h"
 #include "src/common/xmalloc.h"
@@ -73,6 +75,28 @@ strong_alias(free_buf,		slurm_free_buf);
 strong_alias(grow_buf,		slurm_grow_buf);
 strong_alias(init_buf,		slurm_init_buf);
 strong_alias(xfer_buf_data,	slurm_xfer_buf_data);
+strong_alias(get_buf_digest,	slurm_get_buf_digest);
+strong_alias(buf_pool_alloc,	slurm_buf_pool_alloc);
+strong_alias(buf_pool_free,	slurm_buf_pool_free);
+strong_alias(create_buf_pooled,	slurm_create_buf_pooled);
+strong_alias(init_buf_pooled,	slurm_init_buf_pooled);
+strong_alias(get_buf_pool_stats, slurm_get_buf_pool_stats);
+strong_alias(reset_buf_pool_stats, slurm_reset_buf_pool_stats);
+strong_alias(set_buf_pool_threads, slurm_set_buf_pool_threads);
+strong_alias(create_buf_shared,	slurm_create_buf_shared);
+strong_alias(hold_buf_shared,	slurm_hold_buf_shared);
+strong_alias(release_buf_shared, slurm_release_buf_shared);
+strong_alias(init_buf_chain,	slurm_init_buf_chain);
+strong_alias(free_buf_chain,	slurm_free_buf_chain);
+strong_alias(buf_chain_tail,	slurm_buf_chain_tail);
+strong_alias(buf_chain_append_mem, slurm_buf_chain_append_mem);
+strong_alias(buf_chain_append_shared, slurm_buf_chain_append_shared);
+strong_alias(buf_chain_append_chain, slurm_buf_chain_append_chain);
+strong_alias(size_buf_chain,	slurm_size_buf_chain);
+strong_alias(buf_chain_iovec,	slurm_buf_chain_iovec);
+strong_alias(pack_compressed,	slurm_pack_compressed);
+strong_alias(buf_decompress,	slurm_buf_decompress);
+strong_alias(buf_chain_compress, slurm_buf_chain_compress);
 strong_alias(pack_time,		slurm_pack_time);
 strong_alias(unpack_time,	slurm_unpack_time);
 strong_alias(packdouble,	slurm_packdouble);
@@ -99,6 +123,46 @@ strong_alias(unpackstr_array,	slurm_unpackstr_array);
 strong_alias(packmem_array,	slurm_packmem_array);
 strong_alias(unpackmem_array,	slurm_unpackmem_array);
 
+/*
+ * Make room for need more bytes at a buffer's current offset. The buffer
+ * grows by at least half its size, so packing a large message reallocates
+ * (and copies) it a logarithmic rather than linear number of times.
+ * RET SLURM_SUCCESS or SLURM_ERROR if the buffer would be too large
+ */
+static int _grow_buf_for(Buf buffer, uint32_t need, const char *caller)
+{
+	uint64_t min_size, new_size;
+
+	min_size = (uint64_t) buffer->processed + need;
+	if (min_size > MAX_BUF_SIZE) {
+		error("%s: buffer size too large", caller);
+		return SLURM_ERROR;
+	}
+	new_size = min_size + MAX(buffer->size / 2, BUF_SIZE);
+	if (new_size > MAX_BUF_SIZE)
+		new_size = MAX_BUF_SIZE;
+
+	if (buffer->pooled) {
+		char *head = buf_pool_alloc((uint32_t) new_size);
+		memcpy(head, buffer->head, buffer->processed);
+		buf_pool_free(buffer->head);
+		buffer->head = head;
+		buffer->size = xsize(head);
+		return SLURM_SUCCESS;
+	}
+
+	buffer->size = (uint32_t) new_size;
+	xrealloc_nz(buffer->head, buffer->size);
+	return SLURM_SUCCESS;
+}
+
+static inline int _expand_buf(Buf buffer, uint32_t need, const char *caller)
+{
+	if (remaining_buf(buffer) >= need)
+		return SLURM_SUCCESS;
+	return _grow_buf_for(buffer, need, caller);
+}
+
 /* Basic buffer management routines */
 /* create_buf - create a buffer with the supplied contents, contents must
  * be xalloc'ed */
@@ -117,6 +181,7 @@ Buf create_buf(char *data, int size)
 	my_buf->size = size;
 	my_buf->processed = 0;
 	my_buf->head = data;
+	my_buf->pooled = false;
 
 	return my_buf;
 }
@@ -125,7 +190,10 @@ Buf create_buf(char *data, int size)
 void free_buf(Buf my_buf)
 {
 	assert(my_buf->magic == BUF_MAGIC);
-	xfree(my_buf->head);
+	if (my_buf->pooled)
+		buf_pool_free(my_buf->head);
+	else
+		xfree(my_buf->head);
 	xfree(my_buf);
 }
 
@@ -157,6 +225,7 @@ Buf init_buf(int size)
 	my_buf->size = size;
 	my_buf->processed = 0;
 	my_buf->head = xmalloc_nz(sizeof(char)*size);
+	my_buf->pooled = false;
 	return my_buf;
 }
 
@@ -172,6 +241,448 @@ void *xfer_buf_data(Buf my_buf)
 	return data_ptr;
 }
 
+/*
+ * Return a 64-bit FNV-1a digest of the data packed in a buffer from the
+ * specified offset to its current offset. Used to detect changes in packed
+ * records, not for security.
+ */
+uint64_t get_buf_digest(Buf my_buf, uint32_t offset)
+{
+	uint64_t digest = 0xcbf29ce484222325ULL;
+	unsigned char *data;
+	uint32_t i;
+
+	assert(my_buf->magic == BUF_MAGIC);
+	data = (unsigned char *) my_buf->head;
+	for (i = offset; i < my_buf->processed; i++) {
+		digest ^= data[i];
+		digest *= 0x100000001b3ULL;
+	}
+	return digest;
+}
+
+/*
+ * Pool of message buffers. Each size class keeps a list of free buffers,
+ * linked through their first bytes, up to a limit per class so the memory
+ * retained after a burst of large messages stays bounded. Larger requests
+ * are allocated exactly and never retained.
+ *
+ * A single pool is shared by all threads rather than cached per thread, as
+ * a buffer is often released by a thread other than the one which got it:
+ * slurmctld reads requests in its event loop for RPC workers to process,
+ * and replies packed by the workers are sent and released by msg_aio.
+ */
+#define BUF_POOL_CLASSES 4
+
+static const uint32_t buf_pool_size[BUF_POOL_CLASSES] = {
+	BUF_SIZE, BUF_SIZE * 4, BUF_SIZE * 16, BUF_SIZE * 64 };
+static int buf_pool_max[BUF_POOL_CLASSES] = { 64, 16, 8, 4 };
+
+static pthread_mutex_t buf_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char *buf_pool_list[BUF_POOL_CLASSES];
+static int buf_pool_cnt[BUF_POOL_CLASSES];
+static uint64_t buf_pool_hits = 0;
+static uint64_t buf_pool_misses = 0;
+
+char *buf_pool_alloc(uint32_t size)
+{
+	char *data = NULL;
+	int i;
+
+	for (i = 0; i < BUF_POOL_CLASSES; i++) {
+		if (size <= buf_pool_size[i])
+			break;
+	}
+
+	slurm_mutex_lock(&buf_pool_mutex);
+	if ((i < BUF_POOL_CLASSES) && buf_pool_list[i]) {
+		data = buf_pool_list[i];
+		memcpy(&buf_pool_list[i], data, sizeof(char *));
+		buf_pool_cnt[i]--;
+		buf_pool_hits++;
+	} else
+		buf_pool_misses++;
+	slurm_mutex_unlock(&buf_pool_mutex);
+
+	if (data)
+		return data;
+	if (i < BUF_POOL_CLASSES)
+		size = buf_pool_size[i];
+	return xmalloc_nz(size);
+}
+
+void buf_pool_free(char *data)
+{
+	size_t size;
+	int i;
+
+	if (!data)
+		return;
+	size = xsize(data);
+	for (i = 0; i < BUF_POOL_CLASSES; i++) {
+		if (size == buf_pool_size[i])
+			break;
+	}
+	if (i < BUF_POOL_CLASSES) {
+		slurm_mutex_lock(&buf_pool_mutex);
+		if (buf_pool_cnt[i] < buf_pool_max[i]) {
+			memcpy(data, &buf_pool_list[i], sizeof(char *));
+			buf_pool_list[i] = data;
+			buf_pool_cnt[i]++;
+			data = NULL;
+		}
+		slurm_mutex_unlock(&buf_pool_mutex);
+	}
+	xfree(data);
+}
+
+Buf create_buf_pooled(char *data, uint32_t size)
+{
+	Buf my_buf;
+
+	my_buf = create_buf(data, size);
+	if (my_buf)
+		my_buf->pooled = true;
+	return my_buf;
+}
+
+Buf init_buf_pooled(uint32_t size)
+{
+	Buf my_buf;
+
+	if (size > MAX_BUF_SIZE) {
+		error("init_buf_pooled: buffer size too large");
+		return NULL;
+	}
+	if (size == 0)
+		size = BUF_SIZE;
+	my_buf = xmalloc_nz(sizeof(struct slurm_buf));
+	my_buf->magic = BUF_MAGIC;
+	my_buf->head = buf_pool_alloc(size);
+	my_buf->size = xsize(my_buf->head);
+	my_buf->processed = 0;
+	my_buf->pooled = true;
+	return my_buf;
+}
+
+void get_buf_pool_stats(uint64_t *hits, uint64_t *misses,
+			uint32_t *cnt, uint64_t *bytes)
+{
+	int i;
+
+	slurm_mutex_lock(&buf_pool_mutex);
+	*hits = buf_pool_hits;
+	*misses = buf_pool_misses;
+	*cnt = 0;
+	*bytes = 0;
+	for (i = 0; i < BUF_POOL_CLASSES; i++) {
+		*cnt += buf_pool_cnt[i];
+		*bytes += (uint64_t) buf_pool_cnt[i] * buf_pool_size[i];
+	}
+	slurm_mutex_unlock(&buf_pool_mutex);
+}
+
+void reset_buf_pool_stats(void)
+{
+	slurm_mutex_lock(&buf_pool_mutex);
+	buf_pool_hits = 0;
+	buf_pool_misses = 0;
+	slurm_mutex_unlock(&buf_pool_mutex);
+}
+
+void set_buf_pool_threads(int thread_cnt)
+{
+	int i, max_cnt;
+
+	slurm_mutex_lock(&buf_pool_mutex);
+	for (i = 0, max_cnt = thread_cnt * 2; i < BUF_POOL_CLASSES;
+	     i++, max_cnt /= 4) {
+		if (buf_pool_max[i] < max_cnt)
+			buf_pool_max[i] = max_cnt;
+	}
+	slurm_mutex_unlock(&buf_pool_mutex);
+}
+
+#define BUF_SHARED_MAGIC 0x42534852
+
+static pthread_mutex_t buf_shared_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+BufShared create_buf_shared(char *data, uint32_t size)
+{
+	BufShared shared;
+
+	shared = xmalloc(sizeof(struct slurm_buf_shared));
+	shared->magic = BUF_SHARED_MAGIC;
+	shared->ref_cnt = 1;
+	shared->data = data;
+	shared->size = size;
+	return shared;
+}
+
+BufShared hold_buf_shared(BufShared shared)
+{
+	assert(shared->magic == BUF_SHARED_MAGIC);
+	slurm_mutex_lock(&buf_shared_mutex);
+	shared->ref_cnt++;
+	slurm_mutex_unlock(&buf_shared_mutex);
+	return shared;
+}
+
+void release_buf_shared(BufShared shared)
+{
+	int ref_cnt;
+
+	assert(shared->magic == BUF_SHARED_MAGIC);
+	slurm_mutex_lock(&buf_shared_mutex);
+	ref_cnt = --shared->ref_cnt;
+	slurm_mutex_unlock(&buf_shared_mutex);
+	if (ref_cnt > 0)
+		return;
+
+	shared->magic = ~BUF_SHARED_MAGIC;
+	xfree(shared->data);
+	xfree(shared);
+}
+
+BufChain init_buf_chain(void)
+{
+	BufChain chain;
+
+	chain = xmalloc(sizeof(struct slurm_buf_chain));
+	chain->magic = BUF_CHAIN_MAGIC;
+	return chain;
+}
+
+static void _free_buf_seg(struct slurm_buf_seg *seg)
+{
+	if (seg->buf)
+		free_buf(seg->buf);
+	else if (seg->shared)
+		release_buf_shared(seg->shared);
+}
+
+void free_buf_chain(BufChain chain)
+{
+	int i;
+
+	assert(chain->magic == BUF_CHAIN_MAGIC);
+	for (i = 0; i < chain->seg_cnt; i++)
+		_free_buf_seg(&chain->seg[i]);
+	chain->magic = ~BUF_CHAIN_MAGIC;
+	xfree(chain->seg);
+	xfree(chain);
+}
+
+static struct slurm_buf_seg *_buf_chain_add(BufChain chain)
+{
+	struct slurm_buf_seg *seg;
+
+	assert(chain->magic == BUF_CHAIN_MAGIC);
+	if (chain->seg_cnt >= chain->seg_max) {
+		chain->seg_max = MAX(8, chain->seg_max * 2);
+		xrealloc(chain->seg,
+			 sizeof(struct slurm_buf_seg) * chain->seg_max);
+	}
+	seg = &chain->seg[chain->seg_cnt++];
+	memset(seg, 0, sizeof(struct slurm_buf_seg));
+	return seg;
+}
+
+Buf buf_chain_tail(BufChain chain)
+{
+	struct slurm_buf_seg *seg;
+
+	assert(chain->magic == BUF_CHAIN_MAGIC);
+	if (chain->seg_cnt && chain->seg[chain->seg_cnt - 1].buf)
+		return chain->seg[chain->seg_cnt - 1].buf;
+
+	seg = _buf_chain_add(chain);
+	seg->buf = init_buf_pooled(BUF_SIZE);
+	return seg->buf;
+}
+
+void buf_chain_append_mem(BufChain chain, char *data, uint32_t size)
+{
+	struct slurm_buf_seg *seg;
+
+	if (size == 0)
+		return;
+	seg = _buf_chain_add(chain);
+	seg->data = data;
+	seg->size = size;
+}
+
+void buf_chain_append_shared(BufChain chain, BufShared shared)
+{
+	struct slurm_buf_seg *seg;
+
+	seg = _buf_chain_add(chain);
+	seg->shared = hold_buf_shared(shared);
+	seg->data = shared->data;
+	seg->size = shared->size;
+}
+
+void buf_chain_append_chain(BufChain chain, BufChain src)
+{
+	int i;
+
+	assert(src->magic == BUF_CHAIN_MAGIC);
+	for (i = 0; i < src->seg_cnt; i++)
+		*_buf_chain_add(chain) = src->seg[i];
+	src->seg_cnt = 0;
+}
+
+uint32_t size_buf_chain(BufChain chain)
+{
+	uint32_t size = 0;
+	int i;
+
+	assert(chain->magic == BUF_CHAIN_MAGIC);
+	for (i = 0; i < chain->seg_cnt; i++) {
+		if (chain->seg[i].buf)
+			size += get_buf_offset(chain->seg[i].buf);
+		else
+			size += chain->seg[i].size;
+	}
+	return size;
+}
+
+int buf_chain_iovec(BufChain chain, struct iovec *iov)
+{
+	int i, iov_cnt = 0;
+
+	assert(chain->magic == BUF_CHAIN_MAGIC);
+	for (i = 0; i < chain->seg_cnt; i++) {
+		if (chain->seg[i].buf) {
+			iov[iov_cnt].iov_base =
+				get_buf_data(chain->seg[i].buf);
+			iov[iov_cnt].iov_len =
+				get_buf_offset(chain->seg[i].buf);
+		} else {
+			iov[iov_cnt].iov_base = chain->seg[i].data;
+			iov[iov_cnt].iov_len = chain->seg[i].size;
+		}
+		if (iov[iov_cnt].iov_len)
+			iov_cnt++;
+	}
+	return iov_cnt;
+}
+
+int pack_compressed(char *data, uint32_t size, Buf buffer)
+{
+	uint32_t offset = get_buf_offset(buffer), len;
+
+	/* Only worthwhile if it saves more than the size packed with it */
+	if (size <= 2 * sizeof(uint32_t))
+		return SLURM_ERROR;
+	pack32(size, buffer);
+	if (_expand_buf(buffer, size, "pack_compressed")) {
+		set_buf_offset(buffer, offset);
+		return SLURM_ERROR;
+	}
+	len = lz4_compress(data, size, &buffer->head[buffer->processed],
+			   size - 2 * sizeof(uint32_t));
+	if (len == 0) {
+		set_buf_offset(buffer, offset);
+		return SLURM_ERROR;
+	}
+	buffer->processed += len;
+	return SLURM_SUCCESS;
+}
+
+int buf_decompress(Buf buffer)
+{
+	uint32_t size, head_len, data_len;
+	char *head;
+
+	safe_unpack32(&size, buffer);
+	head_len = buffer->processed - sizeof(uint32_t);
+	data_len = remaining_buf(buffer);
+	/* Limit the memory a bad message can claim, each byte of
+	 * compressed data decompresses to at most 255 bytes */
+	if ((size > (uint64_t) data_len * 255) ||
+	    (size > MAX_BUF_SIZE - head_len))
+		goto unpack_error;
+
+	head = buf_pool_alloc(head_len + size);
+	memcpy(head, buffer->head, head_len);
+	if (lz4_decompress(&buffer->head[buffer->processed], data_len,
+			   head + head_len, size)) {
+		buf_pool_free(head);
+		goto unpack_error;
+	}
+	if (buffer->pooled)
+		buf_pool_free(buffer->head);
+	else
+		xfree(buffer->head);
+	buffer->head = head;
+	buffer->pooled = true;
+	buffer->size = head_len + size;
+	buffer->processed = head_len;
+	return SLURM_SUCCESS;
+
+unpack_error:
+	error("buf_decompress: invalid compressed data");
+	return SLURM_ERROR;
+}
+
+int buf_chain_compress(BufChain chain, uint32_t offset)
+{
+	uint32_t start = 0, seg_size, size, copied = 0;
+	char *data;
+	Buf out;
+	int i, j;
+
+	assert(chain->magic == BUF_CHAIN_MAGIC);
+	for (i = 0; i < chain->seg_cnt; i++) {
+		if (chain->seg[i].buf)
+			seg_size = get_buf_offset(chain->seg[i].buf);
+		else
+			seg_size = chain->seg[i].size;
+		if (offset < start + seg_size)
+			break;
+		start += seg_size;
+	}
+	if ((i >= chain->seg_cnt) || !chain->seg[i].buf)
+		return SLURM_ERROR;
+
+	/* Gather the data to compress */
+	size = size_buf_chain(chain) - offset;
+	data = buf_pool_alloc(size);
+	for (j = i; j < chain->seg_cnt; j++) {
+		char *seg_data;
+		if (chain->seg[j].buf) {
+			seg_data = get_buf_data(chain->seg[j].buf);
+			seg_size = get_buf_offset(chain->seg[j].buf);
+		} else {
+			seg_data = chain->seg[j].data;
+			seg_size = chain->seg[j].size;
+		}
+		if (j == i) {
+			seg_data += offset - start;
+			seg_size -= offset - start;
+		}
+		memcpy(data + copied, seg_data, seg_size);
+		copied += seg_size;
+	}
+
+	out = init_buf_pooled(size);
+	if (pack_compressed(data, size, out)) {
+		buf_pool_free(data);
+		free_buf(out);
+		return SLURM_ERROR;
+	}
+	buf_pool_free(data);
+
+	/* Replace the data with the compressed data */
+	set_buf_offset(chain->seg[i].buf, offset - start);
+	for (j = i + 1; j < chain->seg_cnt; j++)
+		_free_buf_seg(&chain->seg[j]);
+	chain->seg_cnt = i + 1;
+	_buf_chain_add(chain)->buf = out;
+	return SLURM_SUCCESS;
+}
+
 /*
  * Given a time_t in host byte order, promote it to int64_t, convert to
  * network byte order, store in buffer and adjust buffer acc'd'ngly
@@ -180,14 +691,8 @@ void pack_time(time_t val, Buf buffer)
 {
 	int64_t n64 = HTON_int64((int64_t) val);
 
-	if (remaining_buf(buffer) < sizeof(n64)) {
-		if (buffer->size > (MAX_BUF_SIZE - BUF_SIZE)) {
-			error("pack_time: buffer size too large");
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_expand_buf(buffer, sizeof(n64), "pack_time"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &n64, sizeof(n64));
 	buffer->processed += sizeof(n64);
@@ -224,14 +729,8 @@ void 	packdouble(double val, Buf buffer)
 	  * more than 15 decimals will mess things up, but this corrects it. */
 	uval.d =  (val * FLOAT_MULT);
 	nl =  HTON_uint64(uval.u);
-	if (remaining_buf(buffer) < sizeof(nl)) {
-		if (buffer->size > (MAX_BUF_SIZE - BUF_SIZE)) {
-			error("packdouble: buffer size too large");
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_expand_buf(buffer, sizeof(nl), "packdouble"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &nl, sizeof(nl));
 	buffer->processed += sizeof(nl);
@@ -270,14 +769,8 @@ void pack64(uint64_t val, Buf buffer)
 {
 	uint64_t nl =  HTON_uint64(val);
 
-	if (remaining_buf(buffer) < sizeof(nl)) {
-		if (buffer->size > (MAX_BUF_SIZE - BUF_SIZE)) {
-			error("pack64: buffer size too large");
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_expand_buf(buffer, sizeof(nl), "pack64"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &nl, sizeof(nl));
 	buffer->processed += sizeof(nl);
@@ -307,14 +800,8 @@ void pack32(uint32_t val, Buf buffer)
 {
 	uint32_t nl = htonl(val);
 
-	if (remaining_buf(buffer) < sizeof(nl)) {
-		if (buffer->size > (MAX_BUF_SIZE - BUF_SIZE)) {
-			error("pack32: buffer size too large");
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_expand_buf(buffer, sizeof(nl), "pack32"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &nl, sizeof(nl));
 	buffer->processed += sizeof(nl);
@@ -431,14 +918,8 @@ void pack16(uint16_t val, Buf buffer)
 {
 	uint16_t ns = htons(val);
 
-	if (remaining_buf(buffer) < sizeof(ns)) {
-		if (buffer->size > (MAX_BUF_SIZE - BUF_SIZE)) {
-			error("pack16: buffer size too large");
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_expand_buf(buffer, sizeof(ns), "pack16"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &ns, sizeof(ns));
 	buffer->processed += sizeof(ns);
@@ -467,14 +948,8 @@ int unpack16(uint16_t * valp, Buf buffer)
  */
 void pack8(uint8_t val, Buf buffer)
 {
-	if (remaining_buf(buffer) < sizeof(uint8_t)) {
-		if (buffer->size > (MAX_BUF_SIZE - BUF_SIZE)) {
-			error("pack8: buffer size too large");
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_expand_buf(buffer, sizeof(uint8_t), "pack8"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &val, sizeof(uint8_t));
 	buffer->processed += sizeof(uint8_t);
@@ -503,14 +978,8 @@ void packmem(char *valp, uint32_t size_val, Buf buffer)
 {
 	uint32_t ns = htonl(size_val);
 
-	if (remaining_buf(buffer) < (sizeof(ns) + size_val)) {
-		if (buffer->size > (MAX_BUF_SIZE -  size_val - BUF_SIZE)) {
-			error("packmem: buffer size too large");
-			return;
-		}
-		buffer->size += (size_val + BUF_SIZE);
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_expand_buf(buffer, sizeof(ns) + size_val, "packmem"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &ns, sizeof(ns));
 	buffer->processed += sizeof(ns);
@@ -666,14 +1135,8 @@ void packstr_array(char **valp, uint32_t size_val, Buf buffer)
 	int i;
 	uint32_t ns = htonl(size_val);
 
-	if (remaining_buf(buffer) < sizeof(ns)) {
-		if (buffer->size > (MAX_BUF_SIZE - BUF_SIZE)) {
-			error("packstr_array: buffer size too large");
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_expand_buf(buffer, sizeof(ns), "packstr_array"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &ns, sizeof(ns));
 	buffer->processed += sizeof(ns);
@@ -726,14 +1189,8 @@ int unpackstr_array(char ***valp, uint32_t * size_valp, Buf buffer)
  */
 void packmem_array(char *valp, uint32_t size_val, Buf buffer)
 {
-	if (remaining_buf(buffer) < size_val) {
-		if (buffer->size > (MAX_BUF_SIZE - size_val - BUF_SIZE)) {
-			error("packmem_array: buffer size too large");
-			return;
-		}
-		buffer->size += (size_val + BUF_SIZE);
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_expand_buf(buffer, size_val, "packmem_array"))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], valp, size_val);
 	buffer->processed += size_val;
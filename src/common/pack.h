@@ -55,8 +55,10 @@
 #endif  /* HAVE_CONFIG_H */
 
 #include <assert.h>
+#include <stdbool.h>
 #include <time.h>
 #include <string.h>
+#include <sys/uio.h>
 #include "src/common/bitstring.h"
 
 #define BUF_MAGIC 0x42554545
@@ -69,6 +71,7 @@ struct slurm_buf {
 	char *head;
 	uint32_t size;
 	uint32_t processed;
+	bool pooled;		/* head returned to the buffer pool on free */
 };
 
 typedef struct slurm_buf * Buf;
@@ -84,6 +87,111 @@ void	free_buf(Buf my_buf);
 Buf	init_buf(int size);
 void    grow_buf (Buf my_buf, int size);
 void	*xfer_buf_data(Buf my_buf);
+uint64_t get_buf_digest(Buf my_buf, uint32_t offset);
+
+/*
+ * Message buffers are kept in a pool of a few size classes, so that the
+ * buffers of RPCs sent and received are reused rather than allocated and
+ * released for every message. Memory from the pool is xmalloc'ed and may
+ * be released with xfree(), it is just not reused then.
+ */
+/* buf_pool_alloc - return memory of at least size bytes, RET xmalloc'ed
+ *	memory, not zeroed */
+char	*buf_pool_alloc(uint32_t size);
+/* buf_pool_free - return memory from buf_pool_alloc() to the pool */
+void	buf_pool_free(char *data);
+/* create_buf_pooled - like create_buf(), with data from buf_pool_alloc() */
+Buf	create_buf_pooled(char *data, uint32_t size);
+/* init_buf_pooled - like init_buf(), with data from the buffer pool */
+Buf	init_buf_pooled(uint32_t size);
+/* get_buf_pool_stats - report allocations satisfied from the pool (hits)
+ *	or not (misses), and the count and size of buffers retained */
+void	get_buf_pool_stats(uint64_t *hits, uint64_t *misses,
+			   uint32_t *cnt, uint64_t *bytes);
+void	reset_buf_pool_stats(void);
+/* set_buf_pool_threads - size the pool for thread_cnt threads each using a
+ *	request and a reply buffer at once, with fewer of the larger sizes.
+ *	The pool never shrinks below its default size. */
+void	set_buf_pool_threads(int thread_cnt);
+
+/*
+ * Packed data shared by reference, e.g. a cached record appended to many
+ * messages. The data is freed when the last reference is released.
+ */
+struct slurm_buf_shared {
+	uint32_t magic;
+	int ref_cnt;		/* protected by mutex in pack.c */
+	char *data;
+	uint32_t size;
+};
+
+typedef struct slurm_buf_shared * BufShared;
+
+/* create_buf_shared - take ownership of xmalloc'ed data, holding one
+ *	reference to it */
+BufShared create_buf_shared(char *data, uint32_t size);
+BufShared hold_buf_shared(BufShared shared);
+void	release_buf_shared(BufShared shared);
+
+/*
+ * A message built from a chain of segments which are sent with one
+ * writev() rather than being copied into one buffer: buffers packed
+ * with the usual pack functions, memory owned by the caller and shared
+ * data. The chain must be freed after sending it, but the caller's
+ * memory must remain valid until then.
+ */
+#define BUF_CHAIN_MAGIC 0x42434841
+
+struct slurm_buf_seg {
+	Buf buf;		/* packed buffer owned by the chain, or */
+	BufShared shared;	/* shared data referenced by the chain, or */
+	char *data;		/* memory owned by the caller */
+	uint32_t size;		/* size of data, if set */
+};
+
+struct slurm_buf_chain {
+	uint32_t magic;
+	int seg_cnt;
+	int seg_max;
+	struct slurm_buf_seg *seg;
+};
+
+typedef struct slurm_buf_chain * BufChain;
+
+BufChain init_buf_chain(void);
+void	free_buf_chain(BufChain chain);
+/* buf_chain_tail - return the buffer at the end of the chain, adding one if
+ *	the last segment is not a buffer, to pack further data into */
+Buf	buf_chain_tail(BufChain chain);
+void	buf_chain_append_mem(BufChain chain, char *data, uint32_t size);
+void	buf_chain_append_shared(BufChain chain, BufShared shared);
+/* buf_chain_append_chain - move the segments of src to the end of chain */
+void	buf_chain_append_chain(BufChain chain, BufChain src);
+uint32_t size_buf_chain(BufChain chain);
+/* buf_chain_iovec - describe the chain's data in iov[], which must have
+ *	room for the chain's seg_cnt entries, RET count of entries set */
+int	buf_chain_iovec(BufChain chain, struct iovec *iov);
+
+/*
+ * Large messages may be compressed when sent to a peer able to read them.
+ * Compressed data is packed as its uncompressed size followed by the data
+ * in the LZ4 block format.
+ */
+#define BUF_COMPRESS_MIN_SIZE	(64 * 1024)	/* don't compress less */
+
+/* pack_compressed - pack size bytes of data compressed into buffer
+ * RET SLURM_SUCCESS or SLURM_ERROR, leaving buffer unchanged, if the data
+ *	does not compress */
+int	pack_compressed(char *data, uint32_t size, Buf buffer);
+/* buf_decompress - replace the compressed data from the buffer's offset to
+ *	its end, as packed by pack_compressed(), with the uncompressed data
+ * RET SLURM_SUCCESS or SLURM_ERROR if the data is not valid */
+int	buf_decompress(Buf buffer);
+/* buf_chain_compress - replace the data of a chain from offset to its end
+ *	with the data compressed by pack_compressed(). The chain must hold a
+ *	packed buffer at offset.
+ * RET SLURM_SUCCESS or SLURM_ERROR, leaving the chain unchanged */
+int	buf_chain_compress(BufChain chain, uint32_t offset);
 
 void	pack_time(time_t val, Buf buffer);
 int	unpack_time(time_t *valp, Buf buffer);
@@ -295,9 +403,9 @@ int	unpackmem_array(char *valp, uint32_t size_valp, Buf buffer);
 
 #define packstr(str,buf) do {				\
 	uint32_t _size = 0;				\
-	if((char *)str != NULL)				\
+	if((char *)(str) != NULL)			\
 		_size = (uint32_t)strlen(str)+1;	\
-        assert(_size == 0 || str != NULL);             	\
+        assert(_size == 0 || (str) != NULL);           	\
 	assert(_size <= 0xffffffff);			\
 	assert(buf->magic == BUF_MAGIC);		\
 	packmem(str,(uint32_t)_size,buf);		\
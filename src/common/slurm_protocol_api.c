@@ -49,10 +49,13 @@
 #endif /* WITH_PTHREADS */
 
 #include <errno.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
@@ -89,11 +92,52 @@ static slurm_protocol_config_t *proto_conf = &proto_conf_default;
 /* static slurm_ctl_conf_t slurmctld_conf; */
 static int message_timeout = -1;
 
+/* Per-thread count of microseconds spent in slurm_send_node_msg() */
+static pthread_key_t send_time_key;
+static pthread_once_t send_time_once = PTHREAD_ONCE_INIT;
+
+/* Per-thread controller session request being answered, see
+ * slurm_set_session_reply() */
+typedef struct session_reply {
+	slurm_fd_t fd;		/* session connection, -1 if none */
+	uint32_t msg_id;	/* id of the request */
+	uint32_t reply_cnt;	/* replies sent to the request */
+	pthread_mutex_t *write_lock; /* serializes replies on fd */
+} session_reply_t;
+static pthread_key_t session_reply_key;
+static pthread_once_t session_reply_once = PTHREAD_ONCE_INIT;
+
+/* Controller session of this process, see slurm_open_session().
+ * session_lock protects the state, session_send_lock keeps whole requests
+ * together on the connection. The controller may answer requests in any
+ * order. One waiting thread at a time reads responses and hands each to
+ * the thread waiting for its msg_id. */
+typedef struct session_wait {
+	uint32_t msg_id;		/* request sent */
+	slurm_msg_t *resp;		/* where to put its response */
+	bool done;			/* resp is set */
+	struct session_wait *next;
+} session_wait_t;
+static pthread_mutex_t session_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t session_send_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  session_cond = PTHREAD_COND_INITIALIZER;
+static bool     session_on = false;	/* slurm_open_session() called */
+static bool     session_broken = false;	/* session_fd shut down on error */
+static int      session_break_errno = 0; /* why session_fd was shut down */
+static bool     session_reading = false; /* a thread is reading responses */
+static slurm_fd_t session_fd = -1;
+static int      session_users = 0;	/* threads with requests on fd */
+static uint32_t session_next_id = 1;	/* msg_id of next request sent */
+static session_wait_t *session_waits = NULL; /* requests not answered */
+
 /* STATIC FUNCTIONS */
 static char *_global_auth_key(void);
 static void  _remap_slurmctld_errno(void);
 static int   _unpack_msg_uid(Buf buffer);
 static bool  _is_port_ok(int, uint16_t);
+static int   _send_node_msg(slurm_fd_t fd, slurm_msg_t *msg);
+static int   _unpack_received_msg(slurm_msg_t *msg, slurm_fd_t fd,
+				  char *buf, size_t buflen, bool session);
 
 #if _DEBUG
 static void _print_data(char *data, int len);
@@ -2629,10 +2673,7 @@ int slurm_receive_msg(slurm_fd_t fd, slurm_msg_t *msg, int timeout)
 {
 	char *buf = NULL;
 	size_t buflen = 0;
-	header_t header;
 	int rc;
-	void *auth_cred = NULL;
-	Buf buffer;
 
 	xassert(fd >= 0);
 
@@ -2657,15 +2698,65 @@ int slurm_receive_msg(slurm_fd_t fd, slurm_msg_t *msg, int timeout)
 	 *  the message.
 	 */
 	if (slurm_msg_recvfrom_timeout(fd, &buf, &buflen, 0, timeout) < 0) {
-		forward_init(&header.forward, NULL);
 		rc = errno;
-		goto total_return;
+		slurm_seterrno(rc);
+		msg->auth_cred = (void *) NULL;
+		error("%s: %s", __func__, slurm_strerror(rc));
+		usleep(10000);	/* Discourage brute force attack */
+		return -1;
 	}
 
+	return slurm_unpack_received_msg(msg, fd, buf, buflen);
+}
+
+/*
+ * slurm_unpack_received_msg - unpack a message whose data has already been
+ *	read from "fd", for example by an event loop
+ * OUT msg	- a slurm_msg struct to be filled in by the function
+ * IN fd	- file descriptor the message was read from
+ * IN buf	- message data (without the length prefix), always consumed
+ * IN buflen	- size of buf
+ * RET int	- returns 0 on success, -1 on failure and sets errno
+ */
+extern int slurm_unpack_received_msg(slurm_msg_t *msg, slurm_fd_t fd,
+				     char *buf, size_t buflen)
+{
+	return _unpack_received_msg(msg, fd, buf, buflen, false);
+}
+
+/*
+ * slurm_unpack_session_msg - unpack a message read from a controller
+ *	session, which carries a msg_id in place of an auth credential.
+ *	The caller supplies the session's credential, if any.
+ * OUT msg	- a slurm_msg struct to be filled in by the function
+ * IN fd	- file descriptor the message was read from
+ * IN buf	- message data (without the length prefix), always consumed
+ * IN buflen	- size of buf
+ * RET int	- returns 0 on success, -1 on failure and sets errno
+ */
+extern int slurm_unpack_session_msg(slurm_msg_t *msg, slurm_fd_t fd,
+				    char *buf, size_t buflen)
+{
+	return _unpack_received_msg(msg, fd, buf, buflen, true);
+}
+
+static int _unpack_received_msg(slurm_msg_t *msg, slurm_fd_t fd,
+				char *buf, size_t buflen, bool session)
+{
+	header_t header;
+	int rc;
+	void *auth_cred = NULL;
+	Buf buffer;
+
+	xassert(fd >= 0);
+
+	slurm_msg_t_init(msg);
+	msg->conn_fd = fd;
+
 #if	_DEBUG
 	_print_data (buf, buflen);
 #endif
-	buffer = create_buf(buf, buflen);
+	buffer = create_buf_pooled(buf, buflen);
 
 	if (unpack_header(&header, buffer) == SLURM_ERROR) {
 		free_buf(buffer);
@@ -2708,6 +2799,19 @@ int slurm_receive_msg(slurm_fd_t fd, slurm_msg_t *msg, int timeout)
 		      "slurm_receive_msg_and_forward instead", __func__);
 	}
 
+	if (session != ((header.flags & SLURM_MSG_SESSION) != 0)) {
+		error("%s: %s %s a controller session", __func__,
+		      rpc_num2string(header.msg_type),
+		      session ? "not sent on" : "sent outside of");
+		free_buf(buffer);
+		rc = SLURM_PROTOCOL_AUTHENTICATION_ERROR;
+		goto total_return;
+	}
+	if (session) {
+		msg->msg_id = header.msg_id;
+		goto unpack_body;
+	}
+
 	if ((auth_cred = g_slurm_auth_unpack(buffer)) == NULL) {
 		error("%s: authentication: %s ", __func__,
 		       g_slurm_auth_errstr(g_slurm_auth_errno(NULL)));
@@ -2736,14 +2840,19 @@ int slurm_receive_msg(slurm_fd_t fd, slurm_msg_t *msg, int timeout)
 	/*
 	 * Unpack message body
 	 */
+unpack_body:
 	msg->protocol_version = header.version;
 	msg->msg_type = header.msg_type;
-	msg->flags = header.flags;
+	msg->flags = header.flags &
+		     ~(SLURM_MSG_COMPRESSED | SLURM_MSG_SESSION);
 
 	if ((header.body_length > remaining_buf(buffer)) ||
+	    ((header.flags & SLURM_MSG_COMPRESSED) &&
+	     buf_decompress(buffer)) ||
 	    (unpack_msg(msg, buffer) != SLURM_SUCCESS)) {
 		rc = ESLURM_PROTOCOL_INCOMPLETE_PACKET;
-		(void) g_slurm_auth_destroy(auth_cred);
+		if (auth_cred)
+			(void) g_slurm_auth_destroy(auth_cred);
 		free_buf(buffer);
 		goto total_return;
 	}
@@ -2783,20 +2892,11 @@ List slurm_receive_msgs(slurm_fd_t fd, int steps, int timeout)
 {
 	char *buf = NULL;
 	size_t buflen = 0;
-	header_t header;
-	int rc;
-	void *auth_cred = NULL;
-	slurm_msg_t msg;
-	Buf buffer;
-	ret_data_info_t *ret_data_info = NULL;
 	List ret_list = NULL;
 	int orig_timeout = timeout;
 
 	xassert(fd >= 0);
 
-	slurm_msg_t_init(&msg);
-	msg.conn_fd = fd;
-
 	if (timeout <= 0) {
 		/* convert secs to msec */
 		timeout  = slurm_get_msg_timeout() * 1000;
@@ -2835,15 +2935,49 @@ List slurm_receive_msgs(slurm_fd_t fd, int steps, int timeout)
 	 *  the message.
 	 */
 	if (slurm_msg_recvfrom_timeout(fd, &buf, &buflen, 0, timeout) < 0) {
-		forward_init(&header.forward, NULL);
-		rc = errno;
-		goto total_return;
+		int rc = errno;
+		error("slurm_receive_msgs: %s", slurm_strerror(rc));
+		usleep(10000);	/* Discourage brute force attack */
+		errno = rc;
+		return NULL;
 	}
 
+	ret_list = slurm_unpack_received_msgs(fd, buf, buflen);
+	if (errno != SLURM_SUCCESS) {
+		int rc = errno;
+		usleep(10000);	/* Discourage brute force attack */
+		errno = rc;
+	}
+	return ret_list;
+}
+
+/*
+ * slurm_unpack_received_msgs - unpack a response, and the responses it
+ *	carries from the nodes it was forwarded to, whose data has already
+ *	been read from "fd", for example by an event loop
+ * IN fd	- file descriptor the message was read from
+ * IN buf	- message data (without the length prefix), always consumed
+ * IN buflen	- size of buf
+ * RET List of ret_data_info_t, possibly NULL, and sets errno
+ */
+extern List slurm_unpack_received_msgs(slurm_fd_t fd, char *buf,
+				       size_t buflen)
+{
+	header_t header;
+	int rc;
+	void *auth_cred = NULL;
+	slurm_msg_t msg;
+	Buf buffer;
+	ret_data_info_t *ret_data_info = NULL;
+	List ret_list = NULL;
+
+	slurm_msg_t_init(&msg);
+	msg.conn_fd = fd;
+
 #if	_DEBUG
 	_print_data (buf, buflen);
 #endif
-	buffer = create_buf(buf, buflen);
+	buffer = create_buf_pooled(buf, buflen);
 
 	if (unpack_header(&header, buffer) == SLURM_ERROR) {
 		free_buf(buffer);
@@ -2915,9 +3049,11 @@ List slurm_receive_msgs(slurm_fd_t fd, int steps, int timeout)
 	 */
 	msg.protocol_version = header.version;
 	msg.msg_type = header.msg_type;
-	msg.flags = header.flags;
+	msg.flags = header.flags & ~SLURM_MSG_COMPRESSED;
 
 	if ((header.body_length > remaining_buf(buffer)) ||
+	    ((header.flags & SLURM_MSG_COMPRESSED) &&
+	     buf_decompress(buffer)) ||
 	    (unpack_msg(&msg, buffer) != SLURM_SUCCESS)) {
 		(void) g_slurm_auth_destroy(auth_cred);
 		free_buf(buffer);
@@ -2941,7 +3077,6 @@ total_return:
 			list_push(ret_list, ret_data_info);
 		}
 		error("slurm_receive_msgs: %s", slurm_strerror(rc));
-		usleep(10000);	/* Discourage brute force attack */
 	} else {
 		if (!ret_list)
 			ret_list = list_create(destroy_data_info);
@@ -3041,7 +3176,7 @@ int slurm_receive_msg_and_forward(slurm_fd_t fd, slurm_addr_t *orig_addr,
 #if	_DEBUG
 	_print_data (buf, buflen);
 #endif
-	buffer = create_buf(buf, buflen);
+	buffer = create_buf_pooled(buf, buflen);
 
 	if (unpack_header(&header, buffer) == SLURM_ERROR) {
 		free_buf(buffer);
@@ -3102,12 +3237,9 @@ int slurm_receive_msg_and_forward(slurm_fd_t fd, slurm_addr_t *orig_addr,
 		slurm_mutex_init(&msg->forward_struct->forward_mutex);
 		pthread_cond_init(&msg->forward_struct->notify, NULL);
 
-		msg->forward_struct->forward_msg =
-			xmalloc(sizeof(forward_msg_t) * header.forward.cnt);
-
 		msg->forward_struct->buf_len = remaining_buf(buffer);
 		msg->forward_struct->buf =
-			xmalloc(sizeof(char) * msg->forward_struct->buf_len);
+			buf_pool_alloc(msg->forward_struct->buf_len);
 		memcpy(msg->forward_struct->buf,
 		       &buffer->head[buffer->processed],
 		       msg->forward_struct->buf_len);
@@ -3157,9 +3289,11 @@ int slurm_receive_msg_and_forward(slurm_fd_t fd, slurm_addr_t *orig_addr,
 	 */
 	msg->protocol_version = header.version;
 	msg->msg_type = header.msg_type;
-	msg->flags = header.flags;
+	msg->flags = header.flags & ~SLURM_MSG_COMPRESSED;
 
 	if ( (header.body_length > remaining_buf(buffer)) ||
+	     ((header.flags & SLURM_MSG_COMPRESSED) &&
+	      buf_decompress(buffer)) ||
 	     (unpack_msg(msg, buffer) != SLURM_SUCCESS) ) {
 		(void) g_slurm_auth_destroy(auth_cred);
 		free_buf(buffer);
@@ -3195,20 +3329,40 @@ total_return:
 \**********************************************************************/
 
 /*
- *  Do the wonderful stuff that needs be done to pack msg
- *  and hdr into buffer
+ * Pack the body of msg at the end of chain and set the lengths in hdr
  */
 static void
-_pack_msg(slurm_msg_t *msg, header_t *hdr, Buf buffer)
+_pack_msg_body(slurm_msg_t *msg, header_t *hdr, BufChain chain)
 {
 	unsigned int tmplen, msglen;
 
-	tmplen = get_buf_offset(buffer);
-	pack_msg(msg, buffer);
-	msglen = get_buf_offset(buffer) - tmplen;
+	tmplen = size_buf_chain(chain);
+	pack_msg_chain(msg, chain);
+	msglen = size_buf_chain(chain) - tmplen;
+
+	/* Compress large message bodies for peers able to read them */
+	if ((msg->flags & SLURM_ACCEPT_COMPRESSED) &&
+	    (hdr->version >= SLURM_15_08_PROTOCOL_VERSION) &&
+	    (msglen >= BUF_COMPRESS_MIN_SIZE) &&
+	    (buf_chain_compress(chain, tmplen) == SLURM_SUCCESS)) {
+		hdr->flags |= SLURM_MSG_COMPRESSED;
+		msglen = size_buf_chain(chain) - tmplen;
+	}
 
 	/* update header with correct cred and msg lengths */
 	update_header(hdr, msglen);
+}
+
+/*
+ *  Do the wonderful stuff that needs be done to pack msg
+ *  and hdr into chain, hdr being at the start of buffer, its first buffer
+ */
+static void
+_pack_msg(slurm_msg_t *msg, header_t *hdr, BufChain chain, Buf buffer)
+{
+	unsigned int tmplen;
+
+	_pack_msg_body(msg, hdr, chain);
 
 	/* repack updated header */
 	tmplen = get_buf_offset(buffer);
@@ -3217,17 +3371,234 @@ _pack_msg(slurm_msg_t *msg, header_t *hdr, Buf buffer)
 	set_buf_offset(buffer, tmplen);
 }
 
+/*
+ * Pack msg with its header and, unless sent on a controller session, the
+ * auth credential "auth_cred" into a new chain of buffers. Large message
+ * bodies are chained after the header and sent without copying them.
+ * RET the chain or NULL on error and sets errno
+ */
+static BufChain
+_pack_node_msg(slurm_msg_t *msg, void *auth_cred, session_reply_t *reply)
+{
+	header_t header;
+	BufChain chain;
+	Buf      buffer;
+
+	init_header(&header, msg, msg->flags & ~SLURM_MSG_COMPRESSED);
+	if (header.version >= SLURM_15_08_PROTOCOL_VERSION)
+		header.flags |= SLURM_ACCEPT_COMPRESSED;
+	if (reply) {
+		header.flags |= SLURM_MSG_SESSION;
+		header.msg_id = reply->msg_id;
+	}
+
+	/*
+	 * Pack header into buffer for transmission
+	 */
+	chain = init_buf_chain();
+	buffer = buf_chain_tail(chain);
+	pack_header(&header, buffer);
+
+	/*
+	 * Pack auth credential
+	 */
+	if (auth_cred && g_slurm_auth_pack(auth_cred, buffer)) {
+		error("authentication: %s",
+		      g_slurm_auth_errstr(g_slurm_auth_errno(auth_cred)));
+		free_buf_chain(chain);
+		slurm_seterrno(SLURM_PROTOCOL_AUTHENTICATION_ERROR);
+		return NULL;
+	}
+
+	/*
+	 * Pack message into buffer
+	 */
+	_pack_msg(msg, &header, chain, buffer);
+
+#if	_DEBUG
+	_print_data (get_buf_data(buffer),get_buf_offset(buffer));
+#endif
+	return chain;
+}
+
+/*
+ * slurm_pack_node_msg - pack a message with a new auth credential, to be
+ *	sent later by an event loop (see msg_aio.h). The header is returned
+ *	separately, so that it can be packed with the forward list of each
+ *	node the message is sent to.
+ * IN msg - message to pack
+ * OUT header - header of the message, without forward list
+ * RET the auth credential and body as a chain of buffers, or NULL on error
+ *	and sets errno
+ */
+extern BufChain slurm_pack_node_msg(slurm_msg_t *msg, header_t *header)
+{
+	BufChain chain;
+	Buf buffer;
+	void *auth_cred;
+
+	if (msg->flags & SLURM_GLOBAL_AUTH_KEY)
+		auth_cred = g_slurm_auth_create(NULL, 2, _global_auth_key());
+	else
+		auth_cred = g_slurm_auth_create(NULL, 2, slurm_get_auth_info());
+	if (auth_cred == NULL) {
+		error("authentication: %s",
+		      g_slurm_auth_errstr(g_slurm_auth_errno(NULL)) );
+		slurm_seterrno(SLURM_PROTOCOL_AUTHENTICATION_ERROR);
+		return NULL;
+	}
+
+	init_header(header, msg, msg->flags & ~SLURM_MSG_COMPRESSED);
+	if (header->version >= SLURM_15_08_PROTOCOL_VERSION)
+		header->flags |= SLURM_ACCEPT_COMPRESSED;
+	forward_init(&header->forward, NULL);
+	header->ret_cnt = 0;
+	header->ret_list = NULL;
+
+	chain = init_buf_chain();
+	buffer = buf_chain_tail(chain);
+	if (g_slurm_auth_pack(auth_cred, buffer)) {
+		error("authentication: %s",
+		      g_slurm_auth_errstr(g_slurm_auth_errno(auth_cred)));
+		(void) g_slurm_auth_destroy(auth_cred);
+		free_buf_chain(chain);
+		slurm_seterrno(SLURM_PROTOCOL_AUTHENTICATION_ERROR);
+		return NULL;
+	}
+	(void) g_slurm_auth_destroy(auth_cred);
+
+	_pack_msg_body(msg, header, chain);
+	return chain;
+}
+
+static void _send_time_free(void *arg)
+{
+	xfree(arg);
+}
+
+static void _send_time_init(void)
+{
+	if (pthread_key_create(&send_time_key, _send_time_free))
+		error("%s: pthread_key_create: %m", __func__);
+}
+
+/*
+ * slurm_get_send_time - Return the total time, in microseconds, which the
+ *	calling thread has spent in slurm_send_node_msg()
+ */
+extern uint64_t slurm_get_send_time(void)
+{
+	uint64_t *send_usec;
+
+	pthread_once(&send_time_once, _send_time_init);
+	send_usec = pthread_getspecific(send_time_key);
+	if (!send_usec)
+		return 0;
+	return *send_usec;
+}
+
+static void _session_reply_init(void)
+{
+	if (pthread_key_create(&session_reply_key, _send_time_free))
+		error("%s: pthread_key_create: %m", __func__);
+}
+
+/*
+ * slurm_set_session_reply - Send the replies written to "fd" by the calling
+ *	thread as responses to request "msg_id" of a controller session,
+ *	without an auth credential
+ * IN fd - session connection, or -1 to send replies normally again
+ * IN msg_id - msg_id of the request being answered
+ * IN write_lock - held while sending each reply, as other threads may be
+ *	answering other requests of the session
+ */
+extern void slurm_set_session_reply(slurm_fd_t fd, uint32_t msg_id,
+				    pthread_mutex_t *write_lock)
+{
+	session_reply_t *reply;
+
+	pthread_once(&session_reply_once, _session_reply_init);
+	reply = pthread_getspecific(session_reply_key);
+	if (!reply) {
+		if (fd < 0)
+			return;
+		reply = xmalloc(sizeof(session_reply_t));
+		pthread_setspecific(session_reply_key, reply);
+	}
+	reply->fd = fd;
+	reply->msg_id = msg_id;
+	reply->reply_cnt = 0;
+	reply->write_lock = write_lock;
+}
+
+/*
+ * slurm_get_session_reply_cnt - Return the number of replies sent by the
+ *	calling thread since its last call to slurm_set_session_reply()
+ */
+extern uint32_t slurm_get_session_reply_cnt(void)
+{
+	session_reply_t *reply;
+
+	pthread_once(&session_reply_once, _session_reply_init);
+	reply = pthread_getspecific(session_reply_key);
+	if (!reply)
+		return 0;
+	return reply->reply_cnt;
+}
+
+/* Return the calling thread's session request if "fd" is its connection */
+static session_reply_t *_session_reply(slurm_fd_t fd)
+{
+	session_reply_t *reply;
+
+	pthread_once(&session_reply_once, _session_reply_init);
+	reply = pthread_getspecific(session_reply_key);
+	if (reply && (reply->fd >= 0) && (reply->fd == fd))
+		return reply;
+	return NULL;
+}
+
 /*
  *  Send a slurm message over an open file descriptor `fd'
  *    Returns the size of the message sent in bytes, or -1 on failure.
  */
 int slurm_send_node_msg(slurm_fd_t fd, slurm_msg_t * msg)
 {
-	header_t header;
-	Buf      buffer;
-	int      rc;
+	struct timeval tv1, tv2;
+	uint64_t *send_usec;
+	int64_t delta;
+	int rc;
+
+	gettimeofday(&tv1, NULL);
+	rc = _send_node_msg(fd, msg);
+	gettimeofday(&tv2, NULL);
+
+	delta = (tv2.tv_sec - tv1.tv_sec) * 1000000;
+	delta += tv2.tv_usec - tv1.tv_usec;
+	if (delta > 0) {
+		pthread_once(&send_time_once, _send_time_init);
+		send_usec = pthread_getspecific(send_time_key);
+		if (!send_usec) {
+			send_usec = xmalloc(sizeof(uint64_t));
+			pthread_setspecific(send_time_key, send_usec);
+		}
+		*send_usec += delta;
+	}
+
+	return rc;
+}
+
+static int _send_node_msg(slurm_fd_t fd, slurm_msg_t * msg)
+{
+	BufChain chain;
+	struct iovec *iov;
+	int      rc, iov_cnt;
 	void *   auth_cred;
 	time_t   start_time = time(NULL);
+	session_reply_t *reply = _session_reply(fd);
+	/* Messages on a controller session are sent without a credential,
+	 * the session was authenticated when it was opened */
+	bool     session = reply || (msg->flags & SLURM_MSG_SESSION);
 
 	/*
 	 * Initialize header with Auth credential and message type.
@@ -3236,7 +3607,9 @@ int slurm_send_node_msg(slurm_fd_t fd, slurm_msg_t * msg)
 	 * but we may need to generate the credential again later if we
 	 * wait too long for the incoming message.
 	 */
-	if (msg->flags & SLURM_GLOBAL_AUTH_KEY)
+	if (session)
+		auth_cred = NULL;
+	else if (msg->flags & SLURM_GLOBAL_AUTH_KEY)
 		auth_cred = g_slurm_auth_create(NULL, 2, _global_auth_key());
 	else
 		auth_cred = g_slurm_auth_create(NULL, 2, slurm_get_auth_info());
@@ -3247,7 +3620,7 @@ int slurm_send_node_msg(slurm_fd_t fd, slurm_msg_t * msg)
 	}
 	forward_wait(msg);
 
-	if (difftime(time(NULL), start_time) >= 60) {
+	if (!session && (difftime(time(NULL), start_time) >= 60)) {
 		(void) g_slurm_auth_destroy(auth_cred);
 		if (msg->flags & SLURM_GLOBAL_AUTH_KEY) {
 			auth_cred = g_slurm_auth_create(NULL, 2,
@@ -3257,49 +3630,33 @@ int slurm_send_node_msg(slurm_fd_t fd, slurm_msg_t * msg)
 							slurm_get_auth_info());
 		}
 	}
-	if (auth_cred == NULL) {
+	if ((auth_cred == NULL) && !session) {
 		error("authentication: %s",
 		      g_slurm_auth_errstr(g_slurm_auth_errno(NULL)) );
 		slurm_seterrno_ret(SLURM_PROTOCOL_AUTHENTICATION_ERROR);
 	}
 
-	init_header(&header, msg, msg->flags);
-
-	/*
-	 * Pack header into buffer for transmission
-	 */
-	buffer = init_buf(BUF_SIZE);
-	pack_header(&header, buffer);
-
-	/*
-	 * Pack auth credential
-	 */
-	rc = g_slurm_auth_pack(auth_cred, buffer);
-	(void) g_slurm_auth_destroy(auth_cred);
-	if (rc) {
-		error("authentication: %s",
-		      g_slurm_auth_errstr(g_slurm_auth_errno(auth_cred)));
-		free_buf(buffer);
-		slurm_seterrno_ret(SLURM_PROTOCOL_AUTHENTICATION_ERROR);
-	}
-
-	/*
-	 * Pack message into buffer
-	 */
-	_pack_msg(msg, &header, buffer);
+	chain = _pack_node_msg(msg, auth_cred, reply);
+	if (auth_cred)
+		(void) g_slurm_auth_destroy(auth_cred);
+	if (!chain)
+		return SLURM_ERROR;
 
-#if	_DEBUG
-	_print_data (get_buf_data(buffer),get_buf_offset(buffer));
-#endif
 	/*
 	 * Send message
 	 */
-	rc = slurm_msg_sendto( fd, get_buf_data(buffer),
-			       get_buf_offset(buffer),
-			       SLURM_PROTOCOL_NO_SEND_RECV_FLAGS );
+	iov = xmalloc(sizeof(struct iovec) * chain->seg_cnt);
+	iov_cnt = buf_chain_iovec(chain, iov);
+	if (reply && reply->write_lock)
+		slurm_mutex_lock(reply->write_lock);
+	rc = slurm_msg_sendv(fd, iov, iov_cnt,
+			     SLURM_PROTOCOL_NO_SEND_RECV_FLAGS);
+	if (reply && reply->write_lock)
+		slurm_mutex_unlock(reply->write_lock);
+	xfree(iov);
 
 	if ((rc < 0) && (errno == ENOTCONN)) {
-		debug3("slurm_msg_sendto: peer has disappeared for msg_type=%u",
+		debug3("slurm_msg_sendv: peer has disappeared for msg_type=%u",
 		       msg->msg_type);
 	} else if (rc < 0) {
 		slurm_addr_t peer_addr;
@@ -3307,19 +3664,21 @@ int slurm_send_node_msg(slurm_fd_t fd, slurm_msg_t * msg)
 		if (!slurm_get_peer_addr(fd, &peer_addr)) {
 			slurm_print_slurm_addr(
 				&peer_addr, addr_str, sizeof(addr_str));
-			error("slurm_msg_sendto: address:port=%s "
+			error("slurm_msg_sendv: address:port=%s "
 			      "msg_type=%u: %m",
 			      addr_str, msg->msg_type);
 		} else if (errno == ENOTCONN)
-			debug3("slurm_msg_sendto: peer has disappeared "
+			debug3("slurm_msg_sendv: peer has disappeared "
 			       "for msg_type=%u",
 			       msg->msg_type);
 		else
-			error("slurm_msg_sendto: msg_type=%u: %m",
+			error("slurm_msg_sendv: msg_type=%u: %m",
 			      msg->msg_type);
 	}
 
-	free_buf(buffer);
+	if (reply && (rc >= 0))
+		reply->reply_cnt++;
+	free_buf_chain(chain);
 	return rc;
 }
 
@@ -3653,6 +4012,266 @@ _send_and_recv_msgs(slurm_fd_t fd, slurm_msg_t *req, int timeout)
 }
 
 
+/* Open a connection to the controller and make it this process' session.
+ * Call with session_lock held and no session connection.
+ * RET SLURM_SUCCESS or an error code */
+static int _session_connect(void)
+{
+	slurm_msg_t req, resp;
+	slurm_addr_t ctrl_addr;
+	slurm_fd_t fd;
+	int rc;
+
+	if ((fd = slurm_open_controller_conn(&ctrl_addr)) < 0)
+		return SLURMCTLD_COMMUNICATIONS_CONNECTION_ERROR;
+
+	slurm_msg_t_init(&req);
+	req.msg_type = REQUEST_CTLD_SESSION;
+	if ((slurm_send_node_msg(fd, &req) < 0) ||
+	    (slurm_receive_msg(fd, &resp, 0) < 0)) {
+		rc = errno;
+	} else {
+		if (resp.msg_type != RESPONSE_SLURM_RC)
+			rc = SLURM_UNEXPECTED_MSG_ERROR;
+		else
+			rc = ((return_code_msg_t *) resp.data)->return_code;
+		if (resp.auth_cred)
+			g_slurm_auth_destroy(resp.auth_cred);
+		slurm_free_msg_data(resp.msg_type, resp.data);
+	}
+	if (rc != SLURM_SUCCESS) {
+		debug("%s: no controller session: %s",
+		      __func__, slurm_strerror(rc));
+		slurm_close(fd);
+		return rc;
+	}
+
+	session_fd = fd;
+	return SLURM_SUCCESS;
+}
+
+/* Shut down the session connection after error "err", waking threads
+ * waiting for responses on it. Call with session_lock held. */
+static void _session_break(int err)
+{
+	if (session_broken)
+		return;
+	session_broken = true;
+	session_break_errno = err;
+	(void) shutdown(session_fd, SHUT_RDWR);
+	pthread_cond_broadcast(&session_cond);
+}
+
+/* Stop using the session connection. It is closed once no thread is
+ * using it. Call with session_lock held. */
+static void _session_release(void)
+{
+	if (--session_users > 0)
+		return;
+	if (session_broken) {
+		slurm_close(session_fd);
+		session_fd = -1;
+		session_broken = false;
+	}
+	pthread_cond_broadcast(&session_cond);
+}
+
+/* Return true if the controller has closed an idle session connection.
+ * The controller only writes responses, so an idle connection which is
+ * readable has seen EOF or an error. */
+static bool _session_closed(slurm_fd_t fd)
+{
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	return (poll(&pfd, 1, 0) != 0);
+}
+
+/* Read one response from the session and hand it to the thread waiting
+ * for it. Call with session_lock held, which is released while reading.
+ * RET 0 on success, -1 on failure and sets errno */
+static int _session_read(slurm_fd_t fd)
+{
+	slurm_msg_t msg;
+	session_wait_t *wait;
+	char *buf = NULL;
+	size_t buflen = 0;
+	int rc;
+
+	session_reading = true;
+	slurm_mutex_unlock(&session_lock);
+	rc = slurm_msg_recvfrom_timeout(fd, &buf, &buflen, 0,
+					slurm_get_msg_timeout() * 1000);
+	if (rc >= 0)
+		rc = slurm_unpack_session_msg(&msg, fd, buf, buflen);
+	slurm_mutex_lock(&session_lock);
+	session_reading = false;
+	pthread_cond_broadcast(&session_cond);
+	if (rc < 0)
+		return -1;
+
+	for (wait = session_waits; wait; wait = wait->next) {
+		if (!wait->done && (wait->msg_id == msg.msg_id))
+			break;
+	}
+	if (!wait) {
+		error("%s: response to unknown request %u",
+		      __func__, msg.msg_id);
+		slurm_free_msg_data(msg.msg_type, msg.data);
+		slurm_seterrno(SLURM_UNEXPECTED_MSG_ERROR);
+		return -1;
+	}
+	memcpy(wait->resp, &msg, sizeof(slurm_msg_t));
+	wait->done = true;
+	return 0;
+}
+
+/* Return true if a request whose session broke with error "err" before
+ * its response was read is to be sent again on a new connection. That is
+ * when the controller closed the session, as it does with idle sessions
+ * before reading any request sent meanwhile. A request not answered in
+ * time may still be in progress, so is not sent again. */
+static bool _session_resend_ok(int err)
+{
+	return ((err == SLURM_PROTOCOL_SOCKET_ZERO_BYTES_SENT) ||
+		(err == SLURM_COMMUNICATIONS_RECEIVE_ERROR) ||
+		(err == ENOTCONN) ||
+		(err == ESLURM_IN_STANDBY_MODE));
+}
+
+/*
+ * Send a request on the controller session and wait for its response
+ * RET 0 on success, -1 on failure and sets errno, or 1 if the request is to
+ *	be sent on a new connection instead: no session is open, the session
+ *	was closed before the request was answered (the controller closes
+ *	idle sessions, see CTLD_SESSION_IDLE_TIMEOUT), or the session's
+ *	controller is in standby mode
+ */
+static int _session_send_recv(slurm_msg_t *req, slurm_msg_t *resp)
+{
+	session_wait_t wait, **wait_pp;
+	slurm_fd_t fd;
+	int rc, send_rc;
+
+	slurm_mutex_lock(&session_lock);
+	if (!session_on || session_broken) {
+		slurm_mutex_unlock(&session_lock);
+		return 1;
+	}
+	if ((session_fd >= 0) && (session_users == 0) &&
+	    _session_closed(session_fd)) {
+		debug("%s: controller closed session", __func__);
+		slurm_close(session_fd);
+		session_fd = -1;
+	}
+	if ((session_fd < 0) && (_session_connect() != SLURM_SUCCESS)) {
+		session_on = false;
+		slurm_mutex_unlock(&session_lock);
+		return 1;
+	}
+	fd = session_fd;
+	session_users++;
+	slurm_msg_t_init(resp);
+	memset(&wait, 0, sizeof(session_wait_t));
+	wait.resp = resp;
+	slurm_mutex_unlock(&session_lock);
+
+	/* Register the request before sending it, its response may be
+	 * read by another thread */
+	slurm_mutex_lock(&session_send_lock);
+	slurm_mutex_lock(&session_lock);
+	wait.msg_id = session_next_id++;
+	wait.next = session_waits;
+	session_waits = &wait;
+	slurm_mutex_unlock(&session_lock);
+	req->flags |= SLURM_MSG_SESSION;
+	req->msg_id = wait.msg_id;
+	send_rc = slurm_send_node_msg(fd, req);
+	req->flags &= ~SLURM_MSG_SESSION;
+	slurm_mutex_unlock(&session_send_lock);
+
+	slurm_mutex_lock(&session_lock);
+	if (send_rc < 0)
+		_session_break(slurm_get_errno());
+	while (!wait.done && !session_broken) {
+		if (session_reading)
+			pthread_cond_wait(&session_cond, &session_lock);
+		else if (_session_read(fd) < 0)
+			_session_break(slurm_get_errno());
+	}
+	for (wait_pp = &session_waits; *wait_pp; wait_pp = &(*wait_pp)->next) {
+		if (*wait_pp == &wait) {
+			*wait_pp = wait.next;
+			break;
+		}
+	}
+	rc = 0;
+	if (!wait.done) {
+		if ((send_rc < 0) || _session_resend_ok(session_break_errno)) {
+			debug("%s: session closed, sending %s again",
+			      __func__, rpc_num2string(req->msg_type));
+			rc = 1;
+		} else {
+			slurm_seterrno(SLURM_COMMUNICATIONS_RECEIVE_ERROR);
+			rc = -1;
+		}
+	} else if ((resp->msg_type == RESPONSE_SLURM_RC) &&
+		   (((return_code_msg_t *) resp->data)->return_code ==
+		    ESLURM_IN_STANDBY_MODE)) {
+		/* A backup controller not yet in control, leave it and let
+		 * the caller retry as for any other connection */
+		slurm_free_return_code_msg(resp->data);
+		resp->data = NULL;
+		_session_break(ESLURM_IN_STANDBY_MODE);
+		rc = 1;
+	}
+	_session_release();
+	slurm_mutex_unlock(&session_lock);
+
+	return rc;
+}
+
+/*
+ * slurm_open_session - open an authenticated connection to the controller
+ *	which is used for the requests of all threads of this process
+ * RET 0 or a slurm error code
+ */
+extern int slurm_open_session(void)
+{
+	int rc = SLURM_SUCCESS;
+
+	if (working_cluster_rec)
+		return ESLURM_NOT_SUPPORTED;
+
+	slurm_mutex_lock(&session_lock);
+	if ((session_fd < 0) && ((rc = _session_connect()) != SLURM_SUCCESS))
+		session_on = false;
+	else
+		session_on = true;
+	slurm_mutex_unlock(&session_lock);
+
+	return rc;
+}
+
+/*
+ * slurm_close_session - close the session opened by slurm_open_session()
+ *	once the requests sent on it have been answered
+ */
+extern void slurm_close_session(void)
+{
+	slurm_mutex_lock(&session_lock);
+	session_on = false;
+	while (session_users)
+		pthread_cond_wait(&session_cond, &session_lock);
+	if (session_fd >= 0) {
+		slurm_close(session_fd);
+		session_fd = -1;
+	}
+	slurm_mutex_unlock(&session_lock);
+}
+
 /*
  * slurm_send_recv_controller_msg
  * opens a connection to the controller, sends the controller a message,
@@ -3682,6 +4301,8 @@ int slurm_send_recv_controller_msg(slurm_msg_t *req, slurm_msg_t *resp)
 
 	if (working_cluster_rec)
 		req->flags |= SLURM_GLOBAL_AUTH_KEY;
+	else if ((rc = _session_send_recv(req, resp)) <= 0)
+		goto cleanup;
 
 	if ((fd = slurm_open_controller_conn(&ctrl_addr)) < 0) {
 		rc = -1;
@@ -850,6 +850,36 @@ extern int slurm_shutdown_msg_engine(slurm_fd_t open_fd);
  */
 int slurm_receive_msg(slurm_fd_t fd, slurm_msg_t *msg, int timeout);
 
+/*
+ *  Unpack a slurm message whose data has already been read from the open
+ *    slurm descriptor "fd" (e.g. by a non-blocking event loop). This
+ *    performs the header, authentication and body processing of
+ *    slurm_receive_msg().
+ *
+ * OUT msg	- a slurm_msg struct to be filled in by the function
+ * IN fd	- file descriptor the message was read from
+ * IN buf	- message data without its length prefix, always consumed
+ * IN buflen	- size of buf in bytes
+ * RET int	- returns 0 on success, -1 on failure and sets errno
+ */
+extern int slurm_unpack_received_msg(slurm_msg_t *msg, slurm_fd_t fd,
+				     char *buf, size_t buflen);
+
+/*
+ *  Unpack a message already read from a controller session connection
+ *    "fd", see slurm_open_session(). Such messages carry a msg_id, which
+ *    is set in msg, in place of an auth credential, so msg->auth_cred is
+ *    NULL on return.
+ *
+ * OUT msg	- a slurm_msg struct to be filled in by the function
+ * IN fd	- file descriptor the message was read from
+ * IN buf	- message data without its length prefix, always consumed
+ * IN buflen	- size of buf in bytes
+ * RET int	- returns 0 on success, -1 on failure and sets errno
+ */
+extern int slurm_unpack_session_msg(slurm_msg_t *msg, slurm_fd_t fd,
+				    char *buf, size_t buflen);
+
 /*
  *  Receive a slurm message on the open slurm descriptor "fd" waiting
  *    at most "timeout" seconds for the message data. If timeout is
@@ -867,6 +897,22 @@ int slurm_receive_msg(slurm_fd_t fd, slurm_msg_t *msg, int timeout);
  */
 List slurm_receive_msgs(slurm_fd_t fd, int steps, int timeout);
 
+/*
+ *  Unpack a response whose data has already been read from the open
+ *    slurm descriptor "fd" (e.g. by a non-blocking event loop), along
+ *    with the responses it carries from the nodes it was forwarded to.
+ *    This performs the processing of slurm_receive_msgs() once the
+ *    message has been read.
+ *
+ * IN fd	- file descriptor the message was read from
+ * IN buf	- message data without its length prefix, always consumed
+ * IN buflen	- size of buf in bytes
+ * RET List	- List containing type (ret_data_info_t), or NULL on failure.
+ *                errno is set to the result.
+ */
+extern List slurm_unpack_received_msgs(slurm_fd_t fd, char *buf,
+				       size_t buflen);
+
 /*
  *  Receive a slurm message on the open slurm descriptor "fd" waiting
  *    at most "timeout" seconds for the message data. This will also
@@ -899,6 +945,40 @@ int slurm_receive_msg_and_forward(slurm_fd_t fd, slurm_addr_t *orig_addr,
  */
 int slurm_send_node_msg(slurm_fd_t open_fd, slurm_msg_t *msg);
 
+/* slurm_pack_node_msg
+ * Pack a message with a new auth credential, to be sent later by a
+ * non-blocking event loop (see msg_aio.h). The header is packed for each
+ * node by the caller, with the node's forward list.
+ * IN msg		- a slurm msg struct to be packed
+ * OUT header		- the message's header, without forward list
+ * RET BufChain		- the auth credential and message body, or NULL
+ *			  on failure and sets errno
+ */
+extern BufChain slurm_pack_node_msg(slurm_msg_t *msg, header_t *header);
+
+/* slurm_get_send_time
+ * RET uint64_t	- total time, in microseconds, which the calling thread
+ *		  has spent in slurm_send_node_msg()
+ */
+extern uint64_t slurm_get_send_time(void);
+
+/* slurm_set_session_reply
+ * Make the calling thread send the messages it writes to "fd" as responses
+ * to request "msg_id" of a controller session, without an auth credential
+ * IN fd	- session connection, or -1 to send messages normally again
+ * IN msg_id	- msg_id of the request being answered
+ * IN write_lock - held while sending each response, other threads may be
+ *		  answering other requests of the session
+ */
+extern void slurm_set_session_reply(slurm_fd_t fd, uint32_t msg_id,
+				    pthread_mutex_t *write_lock);
+
+/* slurm_get_session_reply_cnt
+ * RET uint32_t	- number of responses the calling thread has sent since
+ *		  its last call to slurm_set_session_reply()
+ */
+extern uint32_t slurm_get_session_reply_cnt(void);
+
 /**********************************************************************\
  * msg connection establishment functions used by msg clients
 \**********************************************************************/
@@ -96,6 +96,15 @@
 /* used to set flags to empty */
 #define SLURM_PROTOCOL_NO_FLAGS 0
 #define SLURM_GLOBAL_AUTH_KEY   0x0001
+#define SLURM_ACCEPT_COMPRESSED 0x0002	/* sender can read compressed messages,
+					 * set from SLURM_15_08_PROTOCOL_VERSION */
+#define SLURM_MSG_COMPRESSED    0x0004	/* message body is compressed */
+#define SLURM_MSG_SESSION       0x0008	/* sent on an authenticated controller
+					 * session, carries a msg_id in place
+					 * of an auth credential */
+#define SLURM_ACCEPT_AGGREGATE  0x0010	/* sender can read responses merged
+					 * into RESPONSE_PING_AGGREGATE, set
+					 * from SLURM_15_08_PROTOCOL_VERSION */
 
 #include "src/common/slurm_protocol_socket_common.h"
 
@@ -365,7 +365,23 @@ extern void slurm_free_job_step_kill_msg(job_step_kill_msg_t * msg)
 
 extern void slurm_free_job_info_request_msg(job_info_request_msg_t *msg)
 {
-	xfree(msg);
+	if (msg) {
+		slurm_free_job_info_filter(msg->filter);
+		xfree(msg);
+	}
+}
+
+extern void slurm_free_job_info_filter(job_info_filter_t *filter)
+{
+	if (filter) {
+		xfree(filter->accounts);
+		xfree(filter->job_ids);
+		xfree(filter->partitions);
+		xfree(filter->reservations);
+		xfree(filter->states);
+		xfree(filter->user_ids);
+		xfree(filter);
+	}
 }
 
 extern void slurm_free_job_step_info_request_msg(job_step_info_request_msg_t *msg)
@@ -381,7 +397,20 @@ extern void slurm_free_front_end_info_request_msg
 
 extern void slurm_free_node_info_request_msg(node_info_request_msg_t *msg)
 {
-	xfree(msg);
+	if (msg) {
+		slurm_free_node_info_filter(msg->filter);
+		xfree(msg);
+	}
+}
+
+extern void slurm_free_node_info_filter(node_info_filter_t *filter)
+{
+	if (filter) {
+		xfree(filter->nodes);
+		xfree(filter->partitions);
+		xfree(filter->states);
+		xfree(filter);
+	}
 }
 
 extern void slurm_free_node_info_single_msg(node_info_single_msg_t *msg)
@@ -982,6 +1011,8 @@ extern void slurm_free_suspend_int_msg(suspend_int_msg_t *msg)
 
 extern void slurm_free_stats_response_msg(stats_info_response_msg_t *msg)
 {
+	int i;
+
 	if (msg) {
 		xfree(msg->rpc_type_id);
 		xfree(msg->rpc_type_cnt);
@@ -989,6 +1020,36 @@ extern void slurm_free_stats_response_msg(stats_info_response_msg_t *msg)
 		xfree(msg->rpc_user_id);
 		xfree(msg->rpc_user_cnt);
 		xfree(msg->rpc_user_time);
+		xfree(msg->rpc_queue_cnt);
+		xfree(msg->rpc_queue_wait_sum);
+		xfree(msg->rpc_queue_wait_max);
+		xfree(msg->rpc_lat_type_id);
+		xfree(msg->rpc_lat_p50);
+		xfree(msg->rpc_lat_p99);
+		xfree(msg->rpc_lat_p999);
+		xfree(msg->rpc_lat_max);
+		xfree(msg->lock_cnt);
+		xfree(msg->lock_wait_sum);
+		xfree(msg->lock_wait_p50);
+		xfree(msg->lock_wait_p99);
+		xfree(msg->lock_wait_p999);
+		xfree(msg->lock_wait_max);
+		xfree(msg->lock_hold_sum);
+		xfree(msg->lock_hold_p50);
+		xfree(msg->lock_hold_p99);
+		xfree(msg->lock_hold_p999);
+		xfree(msg->lock_hold_max);
+		if (msg->lock_site_name) {
+			for (i = 0; i < msg->lock_site_size; i++)
+				xfree(msg->lock_site_name[i]);
+			xfree(msg->lock_site_name);
+		}
+		xfree(msg->lock_site_lock);
+		xfree(msg->lock_site_cnt);
+		xfree(msg->lock_site_wait_sum);
+		xfree(msg->lock_site_wait_max);
+		xfree(msg->lock_site_hold_sum);
+		xfree(msg->lock_site_hold_max);
 		xfree(msg);
 	}
 }
@@ -1214,6 +1275,14 @@ extern void slurm_free_ping_slurmd_resp(ping_slurmd_resp_msg_t *msg)
 	xfree(msg);
 }
 
+extern void slurm_free_ping_slurmd_aggr(ping_slurmd_aggr_msg_t *msg)
+{
+	if (msg) {
+		xfree(msg->cpu_load);
+		xfree(msg);
+	}
+}
+
 extern char *preempt_mode_string(uint16_t preempt_mode)
 {
 	char *gang_str;
@@ -2365,6 +2434,7 @@ extern void slurm_free_job_info_msg(job_info_msg_t * job_buffer_ptr)
 			_free_all_job_info(job_buffer_ptr);
 			xfree(job_buffer_ptr->job_array);
 		}
+		xfree(job_buffer_ptr->removed_ids);
 		xfree(job_buffer_ptr);
 	}
 }
@@ -2478,6 +2548,7 @@ extern void slurm_free_node_info_msg(node_info_msg_t * msg)
 			_free_all_node_info(msg);
 			xfree(msg->node_array);
 		}
+		xfree(msg->delta_inx);
 		xfree(msg);
 	}
 }
@@ -3035,6 +3106,7 @@ extern int slurm_free_msg_data(slurm_msg_type_t type, void *data)
 	case ACCOUNTING_FIRST_REG:
 	case ACCOUNTING_REGISTER_CTLD:
 	case REQUEST_TOPO_INFO:
+	case REQUEST_CTLD_SESSION:
 		/* No body to free */
 		break;
 	case REQUEST_REBOOT_NODES:
@@ -3058,6 +3130,9 @@ extern int slurm_free_msg_data(slurm_msg_type_t type, void *data)
 	case RESPONSE_PING_SLURMD:
 		slurm_free_ping_slurmd_resp(data);
 		break;
+	case RESPONSE_PING_AGGREGATE:
+		slurm_free_ping_slurmd_aggr(data);
+		break;
 	case RESPONSE_JOB_ARRAY_ERRORS:
 		slurm_free_job_array_resp(data);
 		break;
@@ -3089,6 +3164,7 @@ extern uint32_t slurm_get_return_code(slurm_msg_type_t type, void *data)
 		rc = ((return_code_msg_t *)data)->return_code;
 		break;
 	case RESPONSE_PING_SLURMD:
+	case RESPONSE_PING_AGGREGATE:
 		rc = SLURM_SUCCESS;
 		break;
 	case RESPONSE_ACCT_GATHER_UPDATE:
@@ -3240,6 +3316,8 @@ rpc_num2string(uint16_t opcode)
 		return "REQUEST_LICENSE_INFO";
 	case RESPONSE_LICENSE_INFO:
 		return "RESPONSE_LICENSE_INFO";
+	case RESPONSE_PING_AGGREGATE:
+		return "RESPONSE_PING_AGGREGATE";
 	case REQUEST_BUILD_INFO:
 		return "REQUEST_BUILD_INFO";
 	case RESPONSE_BUILD_INFO:
@@ -3320,6 +3398,8 @@ rpc_num2string(uint16_t opcode)
 		return "REQUEST_JOB_USER_INFO";
 	case REQUEST_NODE_INFO_SINGLE:
 		return "REQUEST_NODE_INFO_SINGLE";
+	case REQUEST_CTLD_SESSION:
+		return "REQUEST_CTLD_SESSION";
 	case REQUEST_UPDATE_JOB:
 		return "REQUEST_UPDATE_JOB";
 	case REQUEST_UPDATE_NODE:
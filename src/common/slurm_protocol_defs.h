@@ -62,6 +62,7 @@
 #include "src/common/job_options.h"
 #include "src/common/list.h"
 #include "src/common/macros.h"
+#include "src/common/pack.h"
 #include "src/common/slurm_cred.h"
 #include "src/common/slurm_protocol_common.h"
 #include "src/common/slurm_step_layout.h"
@@ -200,6 +201,7 @@ typedef enum {
 	RESPONSE_ACCT_GATHER_ENERGY,
 	REQUEST_LICENSE_INFO,
 	RESPONSE_LICENSE_INFO,
+	RESPONSE_PING_AGGREGATE,
 
 	REQUEST_BUILD_INFO = 2001,
 	RESPONSE_BUILD_INFO,
@@ -241,6 +243,7 @@ typedef enum {
 	RESPONSE_STATS_RESET,		/* VESTIGIAL, UNUSED */
 	REQUEST_JOB_USER_INFO,
 	REQUEST_NODE_INFO_SINGLE,
+	REQUEST_CTLD_SESSION,
 
 	REQUEST_UPDATE_JOB = 3001,
 	REQUEST_UPDATE_NODE,
@@ -383,6 +386,7 @@ typedef struct slurm_protocol_header {
 	uint16_t flags;
 	uint16_t msg_type; /* really slurm_msg_type_t but needs to be
 			      uint16_t for packing purposes. */
+	uint32_t msg_id;   /* only packed with SLURM_MSG_SESSION */
 	uint32_t body_length;
 	uint16_t ret_cnt;
 	forward_t forward;
@@ -390,22 +394,15 @@ typedef struct slurm_protocol_header {
 	List ret_list;
 } header_t;
 
-typedef struct forward_message {
-	header_t header;
-	char *buf;
-	int buf_len;
-	int timeout;
-	List ret_list;
-	pthread_mutex_t *forward_mutex;
-	pthread_cond_t *notify;
-} forward_msg_t;
-
 typedef struct forward_struct {
 	int timeout;
 	uint16_t fwd_cnt;
 	pthread_mutex_t forward_mutex;
 	pthread_cond_t notify;
-	forward_msg_t *forward_msg;
+	int branch_cnt;		/* branches not yet complete, see
+				 * forward_msg() */
+	bool aggregate;		/* merge ping responses, the sender set
+				 * SLURM_ACCEPT_AGGREGATE */
 	char *buf;
 	int buf_len;
 	List ret_list;
@@ -422,7 +419,12 @@ typedef struct slurm_msg {
 	slurm_fd_t conn_fd;
 	void *data;
 	uint32_t data_size;
+	BufChain data_chain; /* DON'T PACK! Packed body of an information
+			      * response sent in place of data, see
+			      * pack_msg_chain() */
 	uint16_t flags;
+	uint32_t msg_id;   /* request id on a controller session, see
+			    * slurm_open_session() */
 	uint16_t msg_type; /* really a slurm_msg_type_t but needs to be
 			    * this way for packing purposes.  message type */
 	uint16_t protocol_version; /* DON'T PACK!  Only used if
@@ -538,6 +540,7 @@ typedef struct job_step_id_msg {
 typedef struct job_info_request_msg {
 	time_t last_update;
 	uint16_t show_flags;
+	job_info_filter_t *filter;	/* NULL for all jobs */
 } job_info_request_msg_t;
 
 typedef struct job_step_info_request_msg {
@@ -550,6 +553,7 @@ typedef struct job_step_info_request_msg {
 typedef struct node_info_request_msg {
 	time_t last_update;
 	uint16_t show_flags;
+	node_info_filter_t *filter;	/* NULL for all nodes */
 } node_info_request_msg_t;
 
 typedef struct node_info_single_msg {
@@ -1022,6 +1026,14 @@ typedef struct ping_slurmd_resp_msg {
 	uint32_t cpu_load;	/* CPU load * 100 */
 } ping_slurmd_resp_msg_t;
 
+/* RESPONSE_PING_SLURMD of many nodes merged by a forwarding slurmd. The
+ * nodes are those of the ret_data_info_t node_name hostlist expression. */
+typedef struct ping_slurmd_aggr_msg {
+	uint32_t node_cnt;	/* nodes of the hostlist expression */
+	uint32_t *cpu_load;	/* CPU load * 100 of each node, in the order
+				 * of the hostlist expression */
+} ping_slurmd_aggr_msg_t;
+
 typedef struct license_info_request_msg {
 	time_t last_update;
 	uint16_t show_flags;
@@ -1141,6 +1153,7 @@ extern void slurm_free_priority_factors_response_msg(
 	priority_factors_response_msg_t *msg);
 extern void slurm_free_forward_data_msg(forward_data_msg_t *msg);
 extern void slurm_free_ping_slurmd_resp(ping_slurmd_resp_msg_t *msg);
+extern void slurm_free_ping_slurmd_aggr(ping_slurmd_aggr_msg_t *msg);
 
 #define	slurm_free_timelimit_msg(msg) \
 	slurm_free_kill_job_msg(msg)
@@ -1160,6 +1173,8 @@ extern void slurm_free_job_info_members(job_info_t * job);
 
 extern void slurm_free_job_id_msg(job_id_msg_t * msg);
 extern void slurm_free_job_user_id_msg(job_user_id_msg_t * msg);
+extern void slurm_free_job_info_filter(job_info_filter_t *filter);
+extern void slurm_free_node_info_filter(node_info_filter_t *filter);
 extern void slurm_free_job_id_request_msg(job_id_request_msg_t * msg);
 extern void slurm_free_job_id_response_msg(job_id_response_msg_t * msg);
 
@@ -69,6 +69,7 @@
 
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdarg.h>
@@ -124,6 +125,21 @@ extern ssize_t slurm_msg_sendto ( slurm_fd_t open_fd, char *buffer ,
  * IN timeout - maximum time to wait for a message in milliseconds */
 extern ssize_t slurm_msg_sendto_timeout ( slurm_fd_t open_fd, char *buffer,
 				   size_t size, uint32_t flags, int timeout );
+/* slurm_msg_sendv
+ * Send a message made of several pieces over the given connection with
+ * one writev(), default timeout value
+ * IN open_fd - an open file descriptor
+ * IN iov - data to transmit, iov_cnt entries
+ * IN flags - communication specific flags
+ * RET number of bytes written
+ */
+extern ssize_t slurm_msg_sendv ( slurm_fd_t open_fd, struct iovec *iov,
+				 int iov_cnt, uint32_t flags ) ;
+/* slurm_msg_sendv_timeout is identical to slurm_msg_sendv except
+ * IN timeout - maximum time to wait for a message in milliseconds */
+extern ssize_t slurm_msg_sendv_timeout ( slurm_fd_t open_fd,
+					 struct iovec *iov, int iov_cnt,
+					 uint32_t flags, int timeout );
 
 /********************/
 /* stream functions */
@@ -165,6 +181,8 @@ extern int slurm_get_stream_addr ( slurm_fd_t open_fd ,
 
 extern int slurm_send_timeout ( slurm_fd_t open_fd, char *buffer ,
 				size_t size , uint32_t flags, int timeout ) ;
+extern int slurm_send_iov_timeout ( slurm_fd_t open_fd, struct iovec *iov,
+				    int iov_cnt, int timeout ) ;
 extern int slurm_recv_timeout ( slurm_fd_t open_fd, char *buffer ,
 				size_t size , uint32_t flags, int timeout ) ;
 
@@ -666,6 +666,10 @@ static void _pack_ping_slurmd_resp(ping_slurmd_resp_msg_t *msg,
 				   Buf buffer, uint16_t protocol_version);
 static int _unpack_ping_slurmd_resp(ping_slurmd_resp_msg_t **msg_ptr,
 				    Buf buffer, uint16_t protocol_version);
+static void _pack_ping_slurmd_aggr(ping_slurmd_aggr_msg_t *msg,
+				   Buf buffer, uint16_t protocol_version);
+static int _unpack_ping_slurmd_aggr(ping_slurmd_aggr_msg_t **msg_ptr,
+				    Buf buffer, uint16_t protocol_version);
 
 static void _pack_license_info_request_msg(license_info_request_msg_t *msg,
                                            Buf buffer,
@@ -700,6 +704,8 @@ pack_header(header_t * header, Buf buffer)
 	pack16((uint16_t)header->version, buffer);
 	pack16((uint16_t)header->flags, buffer);
 	pack16((uint16_t)header->msg_type, buffer);
+	if (header->flags & SLURM_MSG_SESSION)
+		pack32(header->msg_id, buffer);
 	pack32((uint32_t)header->body_length, buffer);
 	pack16((uint16_t)header->forward.cnt, buffer);
 	if (header->forward.cnt > 0) {
@@ -732,6 +738,8 @@ unpack_header(header_t * header, Buf buffer)
 	safe_unpack16(&header->version, buffer);
 	safe_unpack16(&header->flags, buffer);
 	safe_unpack16(&header->msg_type, buffer);
+	if (header->flags & SLURM_MSG_SESSION)
+		safe_unpack32(&header->msg_id, buffer);
 	safe_unpack32(&header->body_length, buffer);
 	safe_unpack16(&header->forward.cnt, buffer);
 	if (header->forward.cnt > 0) {
@@ -761,6 +769,39 @@ unpack_error:
 }
 
 
+/* pack_msg_chain
+ * packs a generic slurm protocol message body onto the end of a chain.
+ * Bodies which are already packed (job, node, partition, etc. information
+ * responses) are referenced rather than copied, so msg->data must remain
+ * valid until the chain is sent, and segments of msg->data_chain are moved
+ * to the chain.
+ * IN msg - the body structure to pack (note: includes message type)
+ * IN/OUT chain - destination of the pack
+ * RET 0 or error code
+ */
+int
+pack_msg_chain(slurm_msg_t const *msg, BufChain chain)
+{
+	switch (msg->msg_type) {
+	case RESPONSE_JOB_INFO:
+	case RESPONSE_PARTITION_INFO:
+	case RESPONSE_NODE_INFO:
+	case RESPONSE_RESERVATION_INFO:
+	case RESPONSE_JOB_STEP_INFO:
+	case RESPONSE_BLOCK_INFO:
+	case RESPONSE_FRONT_END_INFO:
+	case RESPONSE_STATS_INFO:
+	case RESPONSE_LICENSE_INFO:
+		if (msg->data_chain)
+			buf_chain_append_chain(chain, msg->data_chain);
+		else
+			buf_chain_append_mem(chain, msg->data, msg->data_size);
+		return SLURM_SUCCESS;
+	default:
+		return pack_msg(msg, buf_chain_tail(chain));
+	}
+}
+
 /* pack_msg
  * packs a generic slurm protocol message body
  * IN msg - the body structure to pack (note: includes message type)
@@ -860,6 +901,7 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 	case ACCOUNTING_FIRST_REG:
 	case ACCOUNTING_REGISTER_CTLD:
 	case REQUEST_TOPO_INFO:
+	case REQUEST_CTLD_SESSION:
 		/* Message contains no body/information */
 		break;
 	case REQUEST_ACCT_GATHER_ENERGY:
@@ -1324,6 +1366,10 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 		_pack_ping_slurmd_resp((ping_slurmd_resp_msg_t *)msg->data,
 				       buffer, msg->protocol_version);
 		break;
+	case RESPONSE_PING_AGGREGATE:
+		_pack_ping_slurmd_aggr((ping_slurmd_aggr_msg_t *)msg->data,
+				       buffer, msg->protocol_version);
+		break;
 	case REQUEST_LICENSE_INFO:
 		 _pack_license_info_request_msg((license_info_request_msg_t *)
 		                                msg->data,
@@ -1456,6 +1502,7 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 	case ACCOUNTING_FIRST_REG:
 	case ACCOUNTING_REGISTER_CTLD:
 	case REQUEST_TOPO_INFO:
+	case REQUEST_CTLD_SESSION:
 		/* Message contains no body/information */
 		break;
 	case REQUEST_ACCT_GATHER_ENERGY:
@@ -1964,6 +2011,11 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 					      &msg->data, buffer,
 					      msg->protocol_version);
 		break;
+	case RESPONSE_PING_AGGREGATE:
+		rc = _unpack_ping_slurmd_aggr((ping_slurmd_aggr_msg_t **)
+					      &msg->data, buffer,
+					      msg->protocol_version);
+		break;
 	case RESPONSE_LICENSE_INFO:
 		rc = _unpack_license_info_msg((license_info_msg_t **)&(msg->data),
 		                              buffer,
@@ -3203,6 +3255,7 @@ _unpack_node_info_msg(node_info_msg_t ** msg, Buf buffer,
 		      uint16_t protocol_version)
 {
 	int i;
+	uint32_t uint32_tmp;
 	node_info_t *node = NULL;
 
 	xassert(msg != NULL);
@@ -3230,6 +3283,17 @@ _unpack_node_info_msg(node_info_msg_t ** msg, Buf buffer,
 						      protocol_version))
 				goto unpack_error;
 		}
+
+		if (protocol_version >= SLURM_15_08_PROTOCOL_VERSION) {
+			safe_unpack16(&((*msg)->delta), buffer);
+			if ((*msg)->delta) {
+				safe_unpack32(&((*msg)->node_cnt), buffer);
+				safe_unpack32_array(&((*msg)->delta_inx),
+						    &uint32_tmp, buffer);
+				if (uint32_tmp != (*msg)->record_count)
+					goto unpack_error;
+			}
+		}
 	} else {
 		error("_unpack_node_info_msg: protocol_version "
 		      "%hu not supported", protocol_version);
@@ -4314,8 +4378,20 @@ unpack_error:
 static void
 _pack_buffer_msg(slurm_msg_t * msg, Buf buffer)
 {
+	struct iovec *iov;
+	int i, iov_cnt;
+
 	xassert(msg != NULL);
-	packmem_array(msg->data, msg->data_size, buffer);
+	if (!msg->data_chain) {
+		packmem_array(msg->data, msg->data_size, buffer);
+		return;
+	}
+
+	iov = xmalloc(sizeof(struct iovec) * msg->data_chain->seg_cnt);
+	iov_cnt = buf_chain_iovec(msg->data_chain, iov);
+	for (i = 0; i < iov_cnt; i++)
+		packmem_array(iov[i].iov_base, iov[i].iov_len, buffer);
+	xfree(iov);
 }
 
 static int
@@ -4348,6 +4424,15 @@ _unpack_job_info_msg(job_info_msg_t ** msg, Buf buffer,
 						     protocol_version))
 				goto unpack_error;
 		}
+
+		if (protocol_version >= SLURM_15_08_PROTOCOL_VERSION) {
+			safe_unpack16(&((*msg)->delta), buffer);
+			if ((*msg)->delta) {
+				safe_unpack32_array(&((*msg)->removed_ids),
+						    &((*msg)->removed_cnt),
+						    buffer);
+			}
+		}
 	} else {
 		error("_unpack_job_info_msg: protocol_version "
 		      "%hu not supported", protocol_version);
@@ -8256,8 +8341,24 @@ static void
 _pack_job_info_request_msg(job_info_request_msg_t * msg, Buf buffer,
 			   uint16_t protocol_version)
 {
+	job_info_filter_t *filter = msg->filter;
+
 	pack_time(msg->last_update, buffer);
 	pack16((uint16_t)msg->show_flags, buffer);
+	if (protocol_version >= SLURM_15_08_PROTOCOL_VERSION) {
+		if (!filter) {
+			pack8((uint8_t) 0, buffer);
+			return;
+		}
+		pack8((uint8_t) 1, buffer);
+		packstr(filter->accounts, buffer);
+		pack32(filter->field_mask, buffer);
+		pack32_array(filter->job_ids, filter->job_id_cnt, buffer);
+		packstr(filter->partitions, buffer);
+		packstr(filter->reservations, buffer);
+		pack16_array(filter->states, filter->state_cnt, buffer);
+		pack32_array(filter->user_ids, filter->user_id_cnt, buffer);
+	}
 }
 
 static int
@@ -8266,12 +8367,35 @@ _unpack_job_info_request_msg(job_info_request_msg_t** msg,
 			     uint16_t protocol_version)
 {
 	job_info_request_msg_t*job_info;
+	job_info_filter_t *filter;
+	uint8_t has_filter;
+	uint32_t uint32_tmp;
 
-	job_info = xmalloc(sizeof(job_step_info_request_msg_t));
+	job_info = xmalloc(sizeof(job_info_request_msg_t));
 	*msg = job_info;
 
 	safe_unpack_time(&job_info->last_update, buffer);
 	safe_unpack16(&job_info->show_flags, buffer);
+	if (protocol_version >= SLURM_15_08_PROTOCOL_VERSION) {
+		safe_unpack8(&has_filter, buffer);
+		if (has_filter) {
+			filter = xmalloc(sizeof(job_info_filter_t));
+			job_info->filter = filter;
+			safe_unpackstr_xmalloc(&filter->accounts, &uint32_tmp,
+					       buffer);
+			safe_unpack32(&filter->field_mask, buffer);
+			safe_unpack32_array(&filter->job_ids,
+					    &filter->job_id_cnt, buffer);
+			safe_unpackstr_xmalloc(&filter->partitions,
+					       &uint32_tmp, buffer);
+			safe_unpackstr_xmalloc(&filter->reservations,
+					       &uint32_tmp, buffer);
+			safe_unpack16_array(&filter->states,
+					    &filter->state_cnt, buffer);
+			safe_unpack32_array(&filter->user_ids,
+					    &filter->user_id_cnt, buffer);
+		}
+	}
 	return SLURM_SUCCESS;
 
 unpack_error:
@@ -8637,8 +8761,21 @@ static void
 _pack_node_info_request_msg(node_info_request_msg_t * msg, Buf buffer,
 			    uint16_t protocol_version)
 {
+	node_info_filter_t *filter = msg->filter;
+
 	pack_time(msg->last_update, buffer);
 	pack16(msg->show_flags, buffer);
+	if (protocol_version >= SLURM_15_08_PROTOCOL_VERSION) {
+		if (!filter) {
+			pack8((uint8_t) 0, buffer);
+			return;
+		}
+		pack8((uint8_t) 1, buffer);
+		pack32(filter->field_mask, buffer);
+		packstr(filter->nodes, buffer);
+		packstr(filter->partitions, buffer);
+		pack32_array(filter->states, filter->state_cnt, buffer);
+	}
 }
 
 static int
@@ -8646,12 +8783,29 @@ _unpack_node_info_request_msg(node_info_request_msg_t ** msg, Buf buffer,
 			      uint16_t protocol_version)
 {
 	node_info_request_msg_t* node_info;
+	node_info_filter_t *filter;
+	uint8_t has_filter;
+	uint32_t uint32_tmp;
 
 	node_info = xmalloc(sizeof(node_info_request_msg_t));
 	*msg = node_info;
 
 	safe_unpack_time(&node_info->last_update, buffer);
 	safe_unpack16(&node_info->show_flags, buffer);
+	if (protocol_version >= SLURM_15_08_PROTOCOL_VERSION) {
+		safe_unpack8(&has_filter, buffer);
+		if (has_filter) {
+			filter = xmalloc(sizeof(node_info_filter_t));
+			node_info->filter = filter;
+			safe_unpack32(&filter->field_mask, buffer);
+			safe_unpackstr_xmalloc(&filter->nodes, &uint32_tmp,
+					       buffer);
+			safe_unpackstr_xmalloc(&filter->partitions,
+					       &uint32_tmp, buffer);
+			safe_unpack32_array(&filter->states,
+					    &filter->state_cnt, buffer);
+		}
+	}
 	return SLURM_SUCCESS;
 
 unpack_error:
@@ -9653,6 +9807,32 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+static void _pack_ping_slurmd_aggr(ping_slurmd_aggr_msg_t *msg,
+				   Buf buffer, uint16_t protocol_version)
+{
+	xassert (msg != NULL);
+
+	pack32_array(msg->cpu_load, msg->node_cnt, buffer);
+}
+
+static int _unpack_ping_slurmd_aggr(ping_slurmd_aggr_msg_t **msg_ptr,
+				    Buf buffer, uint16_t protocol_version)
+{
+	ping_slurmd_aggr_msg_t *msg;
+
+	xassert (msg_ptr != NULL);
+	msg = xmalloc(sizeof(ping_slurmd_aggr_msg_t));
+	*msg_ptr = msg;
+	safe_unpack32_array(&msg->cpu_load, &msg->node_cnt, buffer);
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_ping_slurmd_aggr(msg);
+	*msg_ptr = NULL;
+	return SLURM_ERROR;
+}
+
 static void
 _pack_checkpoint_msg(checkpoint_msg_t *msg, Buf buffer,
 		     uint16_t protocol_version)
@@ -10654,17 +10834,184 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+/* Unpack the slurmctld lock statistics of a stats_info_response_msg_t */
+static int _unpack_lock_stats(stats_info_response_msg_t *msg, Buf buffer)
+{
+	uint32_t i, uint32_tmp;
+
+	safe_unpack32(&msg->lock_stat_size, buffer);
+	safe_unpack32_array(&msg->lock_cnt, &uint32_tmp, buffer);
+	if (uint32_tmp != msg->lock_stat_size)
+		goto unpack_error;
+	safe_unpack64_array(&msg->lock_wait_sum, &uint32_tmp, buffer);
+	if (uint32_tmp != msg->lock_stat_size)
+		goto unpack_error;
+	safe_unpack32_array(&msg->lock_wait_p50, &uint32_tmp, buffer);
+	if (uint32_tmp != msg->lock_stat_size)
+		goto unpack_error;
+	safe_unpack32_array(&msg->lock_wait_p99, &uint32_tmp, buffer);
+	if (uint32_tmp != msg->lock_stat_size)
+		goto unpack_error;
+	safe_unpack32_array(&msg->lock_wait_p999, &uint32_tmp, buffer);
+	if (uint32_tmp != msg->lock_stat_size)
+		goto unpack_error;
+	safe_unpack32_array(&msg->lock_wait_max, &uint32_tmp, buffer);
+	if (uint32_tmp != msg->lock_stat_size)
+		goto unpack_error;
+	safe_unpack64_array(&msg->lock_hold_sum, &uint32_tmp, buffer);
+	if (uint32_tmp != msg->lock_stat_size)
+		goto unpack_error;
+	safe_unpack32_array(&msg->lock_hold_p50, &uint32_tmp, buffer);
+	if (uint32_tmp != msg->lock_stat_size)
+		goto unpack_error;
+	safe_unpack32_array(&msg->lock_hold_p99, &uint32_tmp, buffer);
+	if (uint32_tmp != msg->lock_stat_size)
+		goto unpack_error;
+	safe_unpack32_array(&msg->lock_hold_p999, &uint32_tmp, buffer);
+	if (uint32_tmp != msg->lock_stat_size)
+		goto unpack_error;
+	safe_unpack32_array(&msg->lock_hold_max, &uint32_tmp, buffer);
+	if (uint32_tmp != msg->lock_stat_size)
+		goto unpack_error;
+
+	safe_unpack32(&msg->lock_site_size, buffer);
+	if (msg->lock_site_size > remaining_buf(buffer))
+		goto unpack_error;
+	msg->lock_site_name     = xmalloc(sizeof(char *) *
+					  msg->lock_site_size);
+	msg->lock_site_lock     = xmalloc(sizeof(uint16_t) *
+					  msg->lock_site_size);
+	msg->lock_site_cnt      = xmalloc(sizeof(uint32_t) *
+					  msg->lock_site_size);
+	msg->lock_site_wait_sum = xmalloc(sizeof(uint64_t) *
+					  msg->lock_site_size);
+	msg->lock_site_wait_max = xmalloc(sizeof(uint32_t) *
+					  msg->lock_site_size);
+	msg->lock_site_hold_sum = xmalloc(sizeof(uint64_t) *
+					  msg->lock_site_size);
+	msg->lock_site_hold_max = xmalloc(sizeof(uint32_t) *
+					  msg->lock_site_size);
+	for (i = 0; i < msg->lock_site_size; i++) {
+		safe_unpackstr_xmalloc(&msg->lock_site_name[i], &uint32_tmp,
+				       buffer);
+		safe_unpack16(&msg->lock_site_lock[i], buffer);
+		if (msg->lock_site_lock[i] >= msg->lock_stat_size)
+			goto unpack_error;
+		safe_unpack32(&msg->lock_site_cnt[i], buffer);
+		safe_unpack64(&msg->lock_site_wait_sum[i], buffer);
+		safe_unpack32(&msg->lock_site_wait_max[i], buffer);
+		safe_unpack64(&msg->lock_site_hold_sum[i], buffer);
+		safe_unpack32(&msg->lock_site_hold_max[i], buffer);
+	}
+	return SLURM_SUCCESS;
+
+unpack_error:
+	return SLURM_ERROR;
+}
+
 static int  _unpack_stats_response_msg(stats_info_response_msg_t **msg_ptr,
 				       Buf buffer, uint16_t protocol_version)
 {
-	uint32_t uint32_tmp;
+	uint32_t uint32_tmp, lat_cnt;
 	stats_info_response_msg_t * msg;
 	xassert ( msg_ptr != NULL );
 
 	msg = xmalloc ( sizeof (stats_info_response_msg_t) );
 	*msg_ptr = msg ;
 
-	if (protocol_version >= SLURM_14_11_PROTOCOL_VERSION) {
+	if (protocol_version >= SLURM_15_08_PROTOCOL_VERSION) {
+		safe_unpack32(&msg->parts_packed,	buffer);
+		if (msg->parts_packed) {
+			safe_unpack_time(&msg->req_time,	buffer);
+			safe_unpack_time(&msg->req_time_start,	buffer);
+			safe_unpack32(&msg->server_thread_count,buffer);
+			safe_unpack32(&msg->agent_queue_size,	buffer);
+			safe_unpack32(&msg->jobs_submitted,	buffer);
+			safe_unpack32(&msg->jobs_started,	buffer);
+			safe_unpack32(&msg->jobs_completed,	buffer);
+			safe_unpack32(&msg->jobs_canceled,	buffer);
+			safe_unpack32(&msg->jobs_failed,	buffer);
+
+			safe_unpack32(&msg->schedule_cycle_max,	buffer);
+			safe_unpack32(&msg->schedule_cycle_last,buffer);
+			safe_unpack32(&msg->schedule_cycle_sum,	buffer);
+			safe_unpack32(&msg->schedule_cycle_counter, buffer);
+			safe_unpack32(&msg->schedule_cycle_depth, buffer);
+			safe_unpack32(&msg->schedule_queue_len,	buffer);
+
+			safe_unpack32(&msg->bf_backfilled_jobs,	buffer);
+			safe_unpack32(&msg->bf_last_backfilled_jobs, buffer);
+			safe_unpack32(&msg->bf_cycle_counter,	buffer);
+			safe_unpack32(&msg->bf_cycle_sum,	buffer);
+			safe_unpack32(&msg->bf_cycle_last,	buffer);
+			safe_unpack32(&msg->bf_last_depth,	buffer);
+			safe_unpack32(&msg->bf_last_depth_try,	buffer);
+
+			safe_unpack32(&msg->bf_queue_len,	buffer);
+			safe_unpack32(&msg->bf_cycle_max,	buffer);
+			safe_unpack_time(&msg->bf_when_last_cycle, buffer);
+			safe_unpack32(&msg->bf_depth_sum,	buffer);
+			safe_unpack32(&msg->bf_depth_try_sum,	buffer);
+			safe_unpack32(&msg->bf_queue_len_sum,	buffer);
+			safe_unpack32(&msg->bf_active,		buffer);
+
+			safe_unpack32(&msg->rpc_worker_cnt,	buffer);
+			safe_unpack32(&msg->rpc_worker_busy,	buffer);
+			safe_unpack32(&msg->rpc_queue_depth,	buffer);
+			safe_unpack32(&msg->rpc_queue_depth_max, buffer);
+			safe_unpack32(&msg->rpc_queue_limit,	buffer);
+			safe_unpack32(&msg->rpc_queue_class_cnt, buffer);
+			safe_unpack32_array(&msg->rpc_queue_cnt,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->rpc_queue_class_cnt)
+				goto unpack_error;
+			safe_unpack64_array(&msg->rpc_queue_wait_sum,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->rpc_queue_class_cnt)
+				goto unpack_error;
+			safe_unpack32_array(&msg->rpc_queue_wait_max,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->rpc_queue_class_cnt)
+				goto unpack_error;
+
+			if (_unpack_lock_stats(msg, buffer))
+				goto unpack_error;
+
+			safe_unpack64(&msg->buf_pool_hits,	buffer);
+			safe_unpack64(&msg->buf_pool_misses,	buffer);
+			safe_unpack32(&msg->buf_pool_cnt,	buffer);
+			safe_unpack64(&msg->buf_pool_bytes,	buffer);
+		}
+
+		safe_unpack32(&msg->rpc_type_size,		buffer);
+		safe_unpack16_array(&msg->rpc_type_id,   &uint32_tmp, buffer);
+		safe_unpack32_array(&msg->rpc_type_cnt,  &uint32_tmp, buffer);
+		safe_unpack64_array(&msg->rpc_type_time, &uint32_tmp, buffer);
+
+		safe_unpack32(&msg->rpc_user_size,		buffer);
+		safe_unpack32_array(&msg->rpc_user_id,   &uint32_tmp, buffer);
+		safe_unpack32_array(&msg->rpc_user_cnt,  &uint32_tmp, buffer);
+		safe_unpack64_array(&msg->rpc_user_time, &uint32_tmp, buffer);
+
+		safe_unpack32(&msg->rpc_lat_size,		buffer);
+		safe_unpack16_array(&msg->rpc_lat_type_id, &uint32_tmp, buffer);
+		if (uint32_tmp != msg->rpc_lat_size)
+			goto unpack_error;
+		safe_unpack32(&msg->rpc_lat_phase_cnt,		buffer);
+		lat_cnt = msg->rpc_lat_size * msg->rpc_lat_phase_cnt;
+		safe_unpack32_array(&msg->rpc_lat_p50,  &uint32_tmp, buffer);
+		if (uint32_tmp != lat_cnt)
+			goto unpack_error;
+		safe_unpack32_array(&msg->rpc_lat_p99,  &uint32_tmp, buffer);
+		if (uint32_tmp != lat_cnt)
+			goto unpack_error;
+		safe_unpack32_array(&msg->rpc_lat_p999, &uint32_tmp, buffer);
+		if (uint32_tmp != lat_cnt)
+			goto unpack_error;
+		safe_unpack32_array(&msg->rpc_lat_max,  &uint32_tmp, buffer);
+		if (uint32_tmp != lat_cnt)
+			goto unpack_error;
+	} else if (protocol_version >= SLURM_14_11_PROTOCOL_VERSION) {
 		safe_unpack32(&msg->parts_packed,	buffer);
 		if (msg->parts_packed) {
 			safe_unpack_time(&msg->req_time,	buffer);
@@ -91,6 +91,15 @@ extern int unpack_header ( header_t * header , Buf buffer );
  */
 extern int pack_msg ( slurm_msg_t const * msg , Buf buffer );
 
+/* pack_msg_chain
+ * packs a generic slurm protocol message body onto the end of a chain,
+ * referencing rather than copying bodies which are already packed
+ * IN msg - the body structure to pack (note: includes message type)
+ * IN/OUT chain - destination of the pack
+ * RET 0 or error code
+ */
+extern int pack_msg_chain ( slurm_msg_t const * msg , BufChain chain );
+
 /* unpack_msg
  * unpacks a generic slurm protocol message body
  * OUT msg - the body structure to unpack (note: includes message type)
@@ -52,6 +52,8 @@
 #include <sys/poll.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <limits.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdarg.h>
@@ -91,6 +93,11 @@
 #define MAX_MSG_SIZE     (1024*1024*1024)
 
 
+/* Most iovec entries passed to one writev() */
+#ifndef IOV_MAX
+#  define IOV_MAX 1024
+#endif
+
 /* Static functions */
 static int _slurm_connect (int __fd, struct sockaddr const * __addr,
 			   socklen_t __len);
@@ -174,10 +181,10 @@ extern ssize_t slurm_msg_recvfrom_timeout(slurm_fd_t fd, char **pbuf,
 	/*
 	 *  Allocate memory on heap for message
 	 */
-	*pbuf = xmalloc_nz(msglen);
+	*pbuf = buf_pool_alloc(msglen);
 
 	if (slurm_recv_timeout(fd, *pbuf, msglen, 0, tmout) != msglen) {
-		xfree(*pbuf);
+		buf_pool_free(*pbuf);
 		*pbuf = NULL;
 		return SLURM_ERROR;
 	}
@@ -197,8 +204,27 @@ extern ssize_t slurm_msg_sendto(slurm_fd_t fd, char *buffer, size_t size,
 ssize_t slurm_msg_sendto_timeout(slurm_fd_t fd, char *buffer, size_t size,
 				 uint32_t flags, int timeout)
 {
-	int   len;
+	struct iovec iov;
+
+	iov.iov_base = buffer;
+	iov.iov_len  = size;
+	return slurm_msg_sendv_timeout(fd, &iov, 1, flags, timeout);
+}
+
+extern ssize_t slurm_msg_sendv(slurm_fd_t fd, struct iovec *iov, int iov_cnt,
+			       uint32_t flags)
+{
+	return slurm_msg_sendv_timeout(fd, iov, iov_cnt, flags,
+				       (slurm_get_msg_timeout() * 1000));
+}
+
+ssize_t slurm_msg_sendv_timeout(slurm_fd_t fd, struct iovec *iov, int iov_cnt,
+				uint32_t flags, int timeout)
+{
+	struct iovec *send_iov;
+	size_t size = 0;
 	uint32_t usize;
+	int   i, len;
 	SigFunc *ohandler;
 
 	/*
@@ -207,22 +233,136 @@ ssize_t slurm_msg_sendto_timeout(slurm_fd_t fd, char *buffer, size_t size,
 	 */
 	ohandler = xsignal(SIGPIPE, SIG_IGN);
 
+	/* Send the length prefix and message in one writev() */
+	send_iov = xmalloc(sizeof(struct iovec) * (iov_cnt + 1));
+	for (i = 0; i < iov_cnt; i++) {
+		send_iov[i + 1] = iov[i];
+		size += iov[i].iov_len;
+	}
 	usize = htonl(size);
+	send_iov[0].iov_base = &usize;
+	send_iov[0].iov_len  = sizeof(usize);
 
-	if ((len = slurm_send_timeout(
-				fd, (char *)&usize, sizeof(usize), 0,
-				timeout)) < 0)
-		goto done;
+	len = slurm_send_iov_timeout(fd, send_iov, iov_cnt + 1, timeout);
+	if (len >= 0)
+		len -= sizeof(usize);
+	xfree(send_iov);
 
-	if ((len = slurm_send_timeout(fd, buffer, size, 0, timeout)) < 0)
-		goto done;
-
-
-     done:
 	xsignal(SIGPIPE, ohandler);
 	return len;
 }
 
+/* Send the data described by iov[] with timeout, iov[] is modified
+ * RET bytes sent (total of iov lengths) or SLURM_ERROR on error */
+extern int slurm_send_iov_timeout(slurm_fd_t fd, struct iovec *iov,
+				  int iov_cnt, int timeout)
+{
+	int rc;
+	int sent = 0, size = 0;
+	int fd_flags, i;
+	struct pollfd ufds;
+	struct timeval tstart;
+	int timeleft = timeout;
+	char temp[2];
+
+	for (i = 0; i < iov_cnt; i++)
+		size += iov[i].iov_len;
+	i = 0;
+
+	ufds.fd     = fd;
+	ufds.events = POLLOUT;
+
+	fd_flags = _slurm_fcntl(fd, F_GETFL);
+	fd_set_nonblocking(fd);
+
+	gettimeofday(&tstart, NULL);
+
+	while (sent < size) {
+		timeleft = timeout - _tot_wait(&tstart);
+		if (timeleft <= 0) {
+			debug("slurm_send_iov_timeout at %d of %d, timeout",
+				sent, size);
+			slurm_seterrno(SLURM_PROTOCOL_SOCKET_IMPL_TIMEOUT);
+			sent = SLURM_ERROR;
+			goto done;
+		}
+
+		if ((rc = poll(&ufds, 1, timeleft)) <= 0) {
+			if ((rc == 0) || (errno == EINTR) || (errno == EAGAIN))
+ 				continue;
+			else {
+				debug("slurm_send_iov_timeout at %d of %d, "
+					"poll error: %s",
+					sent, size, strerror(errno));
+				slurm_seterrno(SLURM_COMMUNICATIONS_SEND_ERROR);
+				sent = SLURM_ERROR;
+				goto done;
+			}
+		}
+
+		/* See slurm_send_timeout() */
+		if (ufds.revents & POLLERR) {
+			debug("slurm_send_iov_timeout: Socket POLLERR");
+			slurm_seterrno(ENOTCONN);
+			sent = SLURM_ERROR;
+			goto done;
+		}
+		if ((ufds.revents & POLLHUP) || (ufds.revents & POLLNVAL) ||
+		    (_slurm_recv(fd, &temp, 1, MSG_PEEK) == 0)) {
+			debug2("slurm_send_iov_timeout: Socket no longer there");
+			slurm_seterrno(ENOTCONN);
+			sent = SLURM_ERROR;
+			goto done;
+		}
+		if ((ufds.revents & POLLOUT) != POLLOUT) {
+			error("slurm_send_iov_timeout: Poll failure, revents:%d",
+			      ufds.revents);
+		}
+
+		rc = writev(fd, &iov[i], MIN(iov_cnt - i, IOV_MAX));
+		if (rc < 0) {
+ 			if (errno == EINTR)
+				continue;
+			debug("slurm_send_iov_timeout at %d of %d, "
+				"send error: %s",
+				sent, size, strerror(errno));
+ 			if (errno == EAGAIN) {	/* poll() lied to us */
+				usleep(10000);
+				continue;
+			}
+ 			slurm_seterrno(SLURM_COMMUNICATIONS_SEND_ERROR);
+			sent = SLURM_ERROR;
+			goto done;
+		}
+		if (rc == 0) {
+			debug("slurm_send_iov_timeout at %d of %d, "
+				"sent zero bytes", sent, size);
+			slurm_seterrno(SLURM_PROTOCOL_SOCKET_ZERO_BYTES_SENT);
+			sent = SLURM_ERROR;
+			goto done;
+		}
+
+		sent += rc;
+		/* Skip what was sent, a partial write ends mid-segment */
+		while ((i < iov_cnt) && (rc >= (int) iov[i].iov_len))
+			rc -= iov[i++].iov_len;
+		if (rc) {
+			iov[i].iov_base = (char *) iov[i].iov_base + rc;
+			iov[i].iov_len -= rc;
+		}
+	}
+
+    done:
+	/* Reset fd flags to prior state, preserve errno */
+	if (fd_flags != SLURM_PROTOCOL_ERROR) {
+		int slurm_err = slurm_get_errno();
+		_slurm_fcntl(fd , F_SETFL , fd_flags);
+		slurm_seterrno(slurm_err);
+	}
+
+	return sent;
+}
+
 /* Send slurm message with timeout
  * RET message size (as specified in argument) or SLURM_ERROR on error */
 extern int slurm_send_timeout(slurm_fd_t fd, char *buf, size_t size,
@@ -272,7 +412,9 @@ extern int slurm_send_timeout(slurm_fd_t fd, char *buf, size_t size,
 		 * If not then exit out and notify the sender.  This
  		 * is here since a write doesn't always tell you the
 		 * socket is gone, but getting 0 back from a
-		 * nonblocking read means just that.
+		 * nonblocking read means just that. Only peek, the
+		 * peer may already be sending on a connection kept
+		 * open as a controller session.
 		 */
 		if (ufds.revents & POLLERR) {
 			debug("slurm_send_timeout: Socket POLLERR");
@@ -281,7 +423,7 @@ extern int slurm_send_timeout(slurm_fd_t fd, char *buf, size_t size,
 			goto done;
 		}
 		if ((ufds.revents & POLLHUP) || (ufds.revents & POLLNVAL) ||
-		    (_slurm_recv(fd, &temp, 1, flags) == 0)) {
+		    (_slurm_recv(fd, &temp, 1, flags | MSG_PEEK) == 0)) {
 			debug2("slurm_send_timeout: Socket no longer there");
 			slurm_seterrno(ENOTCONN);
 			sent = SLURM_ERROR;
@@ -131,6 +131,7 @@ void init_header(header_t *header, slurm_msg_t *msg, uint16_t flags)
 
 	header->flags = flags;
 	header->msg_type = msg->msg_type;
+	header->msg_id = msg->msg_id;
 	header->body_length = 0;	/* over-written later */
 	header->forward = msg->forward;
 	if (msg->ret_list)
@@ -88,10 +88,13 @@
 #define	bit_clear_all		slurm_bit_clear_all
 #define	bit_ffc			slurm_bit_ffc
 #define	bit_ffs			slurm_bit_ffs
+#define	bit_ffc_from_bit	slurm_bit_ffc_from_bit
+#define	bit_ffs_from_bit	slurm_bit_ffs_from_bit
 #define	bit_free		slurm_bit_free
 #define	bit_realloc		slurm_bit_realloc
 #define	bit_size		slurm_bit_size
 #define	bit_and			slurm_bit_and
+#define	bit_and_not		slurm_bit_and_not
 #define	bit_not			slurm_bit_not
 #define	bit_or			slurm_bit_or
 #define	bit_set_count		slurm_bit_set_count
@@ -178,6 +181,7 @@
 #define	list_prepend		slurm_list_prepend
 #define	list_find_first		slurm_list_find_first
 #define	list_delete_all		slurm_list_delete_all
+#define	list_delete_ptr		slurm_list_delete_ptr
 #define	list_for_each		slurm_list_for_each
 #define	list_sort		slurm_list_sort
 #define	list_push		slurm_list_push
@@ -236,6 +240,28 @@
 #define grow_buf		slurm_grow_buf
 #define	init_buf		slurm_init_buf
 #define	xfer_buf_data		slurm_xfer_buf_data
+#define	get_buf_digest		slurm_get_buf_digest
+#define	buf_pool_alloc		slurm_buf_pool_alloc
+#define	buf_pool_free		slurm_buf_pool_free
+#define	create_buf_pooled	slurm_create_buf_pooled
+#define	init_buf_pooled		slurm_init_buf_pooled
+#define	get_buf_pool_stats	slurm_get_buf_pool_stats
+#define	reset_buf_pool_stats	slurm_reset_buf_pool_stats
+#define	set_buf_pool_threads	slurm_set_buf_pool_threads
+#define	create_buf_shared	slurm_create_buf_shared
+#define	hold_buf_shared		slurm_hold_buf_shared
+#define	release_buf_shared	slurm_release_buf_shared
+#define	init_buf_chain		slurm_init_buf_chain
+#define	free_buf_chain		slurm_free_buf_chain
+#define	buf_chain_tail		slurm_buf_chain_tail
+#define	buf_chain_append_mem	slurm_buf_chain_append_mem
+#define	buf_chain_append_shared	slurm_buf_chain_append_shared
+#define	buf_chain_append_chain	slurm_buf_chain_append_chain
+#define	size_buf_chain		slurm_size_buf_chain
+#define	buf_chain_iovec		slurm_buf_chain_iovec
+#define	pack_compressed		slurm_pack_compressed
+#define	buf_decompress		slurm_buf_decompress
+#define	buf_chain_compress	slurm_buf_chain_compress
 #define	pack_time		slurm_pack_time
 #define	unpack_time		slurm_unpack_time
 #define	packdouble		slurm_packdouble
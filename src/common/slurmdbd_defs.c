@@ -134,6 +134,7 @@ static void   _shutdown_agent(void);
 static void   _slurmdbd_packstr(void *str, uint16_t rpc_version, Buf buffer);
 static int    _slurmdbd_unpackstr(void **str, uint16_t rpc_version, Buf buffer);
 static int    _tot_wait (struct timeval *start_time);
+static int    _uncompress_msg(Buf buffer);
 
 /****************************************************************************
  * Socket open/close/read/write functions
@@ -659,6 +660,25 @@ extern Buf pack_slurmdbd_msg(slurmdbd_msg_t *req, uint16_t rpc_version)
 	return buffer;
 }
 
+extern Buf slurmdbd_compress_msg(Buf buffer, uint16_t rpc_version)
+{
+	Buf out;
+
+	if ((rpc_version < SLURM_15_08_PROTOCOL_VERSION) ||
+	    (get_buf_offset(buffer) < BUF_COMPRESS_MIN_SIZE))
+		return buffer;
+
+	out = init_buf_pooled(get_buf_offset(buffer));
+	pack16((uint16_t) DBD_COMPRESSED, out);
+	if (pack_compressed(get_buf_data(buffer), get_buf_offset(buffer),
+			    out) != SLURM_SUCCESS) {
+		free_buf(out);
+		return buffer;
+	}
+	free_buf(buffer);
+	return out;
+}
+
 extern int unpack_slurmdbd_msg(slurmdbd_msg_t *resp,
 			       uint16_t rpc_version, Buf buffer)
 {
@@ -1501,6 +1521,12 @@ extern char *slurmdbd_msg_type_2_str(slurmdbd_msg_type_t msg_type, int get_enum)
 		} else
 			return "Got Multiple Message Returns";
 		break;
+	case DBD_COMPRESSED:
+		if (get_enum) {
+			return "DBD_COMPRESSED";
+		} else
+			return "Compressed Message";
+		break;
 	default:
 		return "Unknown";
 		break;
@@ -1859,9 +1885,32 @@ static Buf _recv_msg(int read_timeout)
 	}
 
 	buffer = create_buf(msg, msg_size);
+	if (_uncompress_msg(buffer) != SLURM_SUCCESS) {
+		free_buf(buffer);
+		return NULL;
+	}
 	return buffer;
 }
 
+/* If the buffer holds a DBD_COMPRESSED message, replace its content with
+ * the message it holds, leaving the offset at the start of that message */
+static int _uncompress_msg(Buf buffer)
+{
+	uint16_t msg_type;
+
+	if (unpack16(&msg_type, buffer) != SLURM_SUCCESS)
+		return SLURM_ERROR;
+	if (msg_type != DBD_COMPRESSED) {
+		set_buf_offset(buffer, 0);
+		return SLURM_SUCCESS;
+	}
+	if (buf_decompress(buffer) != SLURM_SUCCESS) {
+		error("slurmdbd: Invalid compressed message");
+		return SLURM_ERROR;
+	}
+	return SLURM_SUCCESS;
+}
+
 /* Return time in msec since "start time" */
 static int _tot_wait (struct timeval *start_time)
 {
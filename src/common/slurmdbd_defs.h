@@ -178,6 +178,9 @@ typedef enum {
 	DBD_ADD_CLUS_RES,    	/* Add cluster using a resource    	*/
 	DBD_REMOVE_CLUS_RES,   	/* Remove existing cluster resource    	*/
 	DBD_MODIFY_CLUS_RES,   	/* Modify existing cluster resource   	*/
+	DBD_COMPRESSED,		/* Compressed response, holding another
+				 * message, for SLURM_15_08_PROTOCOL_VERSION
+				 * and later clients */
 } slurmdbd_msg_type_t;
 
 /*****************************************************************************\
@@ -452,6 +455,9 @@ extern int slurm_send_slurmdbd_recv_rc_msg(uint16_t rpc_version,
 extern Buf pack_slurmdbd_msg(slurmdbd_msg_t *req, uint16_t rpc_version);
 extern int unpack_slurmdbd_msg(slurmdbd_msg_t *resp,
 			       uint16_t rpc_version, Buf buffer);
+/* Compress a large message packed for a client at rpc_version by replacing
+ * it with a DBD_COMPRESSED message, RET the message to send */
+extern Buf slurmdbd_compress_msg(Buf buffer, uint16_t rpc_version);
 
 extern slurmdbd_msg_type_t str_2_slurmdbd_msg_type(char *msg_type);
 extern char *slurmdbd_msg_type_2_str(slurmdbd_msg_type_t msg_type,
@@ -95,7 +95,7 @@ static void _ft_decay_apply_new_usage(struct job_record *job, time_t *start)
 		return;
 
 	set_priority_factors(*start, job);
-	last_job_update = time(NULL);
+	job_changed(job, time(NULL));
 }
 
 
@@ -1127,7 +1127,7 @@ static void _ticket_based_decay(List job_list, time_t start_time)
 			continue;
 
 		job_ptr->priority = _get_priority_internal(start_time, job_ptr);
-		last_job_update = time(NULL);
+		job_changed(job_ptr, time(NULL));
 		debug2("priority for job %u is now %u",
 		       job_ptr->job_id, job_ptr->priority);
 	}
@@ -1881,7 +1881,7 @@ extern void decay_apply_weighted_factors(struct job_record *job_ptr,
 		return;
 
 	job_ptr->priority = _get_priority_internal(*start_time_ptr, job_ptr);
-	last_job_update = time(NULL);
+	job_changed(job_ptr, time(NULL));
 	debug2("priority for job %u is now %u",
 	       job_ptr->job_id, job_ptr->priority);
 
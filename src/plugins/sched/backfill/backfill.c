@@ -68,6 +68,7 @@
 #include "slurm/slurm.h"
 #include "slurm/slurm_errno.h"
 
+#include "src/common/lhash.h"
 #include "src/common/list.h"
 #include "src/common/macros.h"
 #include "src/common/node_select.h"
@@ -89,23 +90,102 @@
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/srun_comm.h"
 #include "backfill.h"
+#include "bf_delta.h"
+#include "node_space.h"
 
 #define BACKFILL_INTERVAL	30
 #define BACKFILL_RESOLUTION	60
 #define BACKFILL_WINDOW		(24 * 60 * 60)
 #define BF_MAX_USERS		1000
 #define BF_MAX_JOB_ARRAY_RESV	20
+#define BF_MAX_THREADS		64
+#define BF_EVAL_LOOKAHEAD	4	/* queue records examined per thread */
+#define BF_PLAN_MAX_AGE		600	/* seconds before plan is rebuilt */
+#define BF_PLAN_MAX_DELTAS	1000	/* changes before plan is rebuilt */
 
 #define SLURMCTLD_THREAD_LIMIT	5
 #define SCHED_TIMEOUT		2000000	/* time in micro-seconds */
 #define YIELD_SLEEP		500000;	/* time in micro-seconds */
 
-typedef struct node_space_map {
-	time_t begin_time;
-	time_t end_time;
-	bitstr_t *avail_bitmap;
-	int next;	/* next record, by time, zero termination */
-} node_space_map_t;
+/* Result of a _try_sched() call made speculatively by a bf_threads worker.
+ * The result is used only if the backfill scheduler later tests the same
+ * job with the same limits and nodes available to the speculative test, or
+ * a subset of them if the test failed, and no job has been started on any
+ * of those nodes. See _bf_eval_find(). */
+typedef struct bf_eval {
+	struct job_record *job_ptr;
+	struct part_record *part_ptr;
+	uint32_t min_nodes;
+	uint32_t max_nodes;
+	uint32_t req_nodes;
+	uint32_t time_limit;		/* job time limit used by the test */
+	bitstr_t *test_bitmap;		/* nodes available to the test */
+	bitstr_t *exc_core_bitmap;	/* cores not available to the test */
+	bitstr_t *avail_bitmap;		/* nodes selected by the test */
+	int rc;				/* _try_sched() return code */
+	time_t start_time;		/* job fields set by the test */
+	uint32_t total_cpus;
+	bool best_switch;
+	struct part_record *save_part_ptr;	/* job fields to restore */
+	uint32_t save_time_limit;
+	time_t save_start_time;
+	uint32_t save_total_cpus;
+	bool save_best_switch;
+} bf_eval_t;
+
+/* A set of bf_eval_t records tested concurrently */
+typedef struct bf_eval_batch {
+	bf_eval_t **eval;
+	int eval_cnt;
+	int next_eval;			/* next record to test */
+	int active;			/* records being tested by workers */
+} bf_eval_batch_t;
+
+/* Reservation made by the previous backfill cycle. With bf_continue
+ * configured the plan is kept from one cycle to the next and a job's
+ * reservation is reused unless some change in resources could move it.
+ * See _bf_plan_reuse(). */
+typedef struct bf_plan_rec {
+	uint32_t job_id;
+	struct part_record *part_ptr;
+	uint16_t occurrence;		/* reservation count for job/partition,
+					 * job arrays may hold several */
+	bool done;			/* reused, retested or released */
+	uint32_t position;		/* order in which reserved */
+	uint64_t shape;			/* job_shape() when reserved */
+	uint32_t time_limit;
+	uint32_t min_nodes;
+	uint32_t max_nodes;
+	uint32_t req_nodes;
+	time_t job_start;		/* job's expected start time */
+	time_t start_time;		/* reserved period, rounded down to */
+	time_t end_time;		/* backfill resolution */
+	bitstr_t *node_bitmap;		/* reserved nodes */
+	struct bf_plan_rec *next;	/* lhash chain */
+} bf_plan_rec_t;
+
+typedef struct bf_plan {
+	bf_plan_rec_t **rec;		/* in order reserved */
+	uint32_t rec_cnt;
+	uint32_t rec_size;
+	lhash_t *hash;			/* records by job ID */
+} bf_plan_t;
+
+/* Outcome of testing a job in the current backfill cycle, which bounds the
+ * outcome for later jobs of the same shape: they can not start earlier
+ * as resources are only consumed until the backfill scheduler yields its
+ * locks. Not used with preemption, where a job's priority also decides
+ * which resources it may have. See _bf_shape_find(). */
+typedef struct bf_shape {
+	uint64_t shape;			/* job_shape() */
+	struct part_record *part_ptr;
+	uint32_t time_limit;
+	uint32_t min_nodes;
+	uint32_t max_nodes;
+	uint32_t req_nodes;
+	time_t start_time;		/* earliest start, zero if not runable */
+	struct bf_shape *next;		/* lhash chain */
+} bf_shape_t;
 
 /* Diag statistics */
 extern diag_stats_t slurmctld_diag_stats;
@@ -130,27 +210,107 @@ static bool backfill_continue = false;
 static int defer_rpc_cnt = 0;
 static int sched_timeout = SCHED_TIMEOUT;
 static int yield_sleep   = YIELD_SLEEP;
+static int bf_threads = 1;
+
+/* Speculative _try_sched() results for the current backfill cycle */
+static bf_eval_t **bf_eval = NULL;
+static int bf_eval_cnt = 0;
+static uint32_t bf_eval_hits = 0, bf_eval_misses = 0;
+static uint32_t bf_eval_usec = 0;
+
+/* Worker threads which test the records of each batch with the backfill
+ * thread, started and stopped by _bf_eval_pool_set(). bf_eval_mutex
+ * protects bf_eval_batch and bf_eval_stop. */
+static pthread_t bf_eval_tid[BF_MAX_THREADS];
+static int bf_eval_tid_cnt = 0;
+static pthread_mutex_t bf_eval_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bf_eval_work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t bf_eval_done_cond = PTHREAD_COND_INITIALIZER;
+static bf_eval_batch_t *bf_eval_batch = NULL;
+static bool bf_eval_stop = false;
+
+/* Outcomes of this cycle's tests by job shape */
+static lhash_t *bf_shape_hash = NULL;
+static List bf_shape_list = NULL;
+static uint32_t bf_shape_hits = 0;
+static bool bf_shape_reuse = true;
+
+/* Plan kept across cycles with bf_continue, see _bf_plan_begin().
+ * bf_plan_mutex protects bf_plan_events and bf_plan_overflow, which are
+ * updated by other threads. Everything else is used only by the backfill
+ * thread. */
+static pthread_t bf_thread;
+static pthread_mutex_t bf_plan_mutex = PTHREAD_MUTEX_INITIALIZER;
+static List bf_plan_events = NULL;	/* allocations by other threads */
+static bool bf_plan_overflow = false;
+static bf_plan_t bf_plan_old = { NULL, 0, 0, NULL };	/* previous cycle */
+static bf_plan_t bf_plan_new = { NULL, 0, 0, NULL };	/* this cycle */
+static bf_plan_rec_t *bf_plan_retest = NULL;	/* old rec of job in test */
+static uint32_t bf_plan_next = 0;	/* first old rec not yet reached */
+static uint32_t bf_plan_reused = 0;
+static List bf_deltas = NULL;		/* changes since bf_plan_old made */
+static List bf_deltas_next = NULL;	/* changes since bf_plan_new begun */
+static bitstr_t *bf_plan_nodes = NULL;	/* usable nodes when last seen */
+static bf_job_ends_t *bf_job_ends = NULL; /* running jobs when last seen */
+static uint32_t bf_job_end_changes = 0;
+static time_t bf_plan_time = 0;		/* when bf_plan_old was begun */
+static time_t bf_plan_config = 0, bf_plan_part = 0, bf_plan_resv = 0;
 
 /*********************** local functions *********************/
-static void _add_reservation(uint32_t start_time, uint32_t end_reserve,
-			     bitstr_t *res_bitmap,
-			     node_space_map_t *node_space,
-			     int *node_space_recs);
 static int  _attempt_backfill(void);
+static void _bf_plan_add(struct job_record *job_ptr,
+			 struct part_record *part_ptr, uint64_t shape,
+			 uint32_t time_limit,
+			 uint32_t min_nodes, uint32_t max_nodes,
+			 uint32_t req_nodes, time_t start_time,
+			 time_t end_time, bitstr_t *node_bitmap);
+static void _bf_plan_begin(time_t now);
+static void _bf_plan_end(void);
+static void _bf_plan_fini(void);
+static void _bf_plan_resolve(void);
+static bf_plan_rec_t *_bf_plan_reuse(struct job_record *job_ptr,
+				     struct part_record *part_ptr,
+				     uint64_t shape,
+				     uint32_t time_limit, uint32_t min_nodes,
+				     uint32_t max_nodes, uint32_t req_nodes,
+				     time_t now, node_space_t *node_space);
+static void _bf_plan_started(struct job_record *job_ptr, time_t now);
+static void _bf_plan_sync(time_t now);
+static void _bf_eval_pool_set(int thread_cnt);
+static void _bf_eval_purge(bitstr_t *node_bitmap);
+static int  _bf_try_sched(struct job_record *job_ptr, bitstr_t **avail_bitmap,
+			  uint32_t min_nodes, uint32_t max_nodes,
+			  uint32_t req_nodes, bitstr_t *exc_core_bitmap,
+			  List job_queue, time_t now,
+			  node_space_t *node_space,
+			  bitstr_t *non_cg_bitmap);
 static void _clear_job_start_times(void);
 static int  _delta_tv(struct timeval *tv);
+static time_t _job_avail_nodes(struct job_record *job_ptr,
+			       struct part_record *part_ptr,
+			       bitstr_t *avail_bitmap, bitstr_t *non_cg_bitmap,
+			       node_space_t *node_space,
+			       time_t start_res, time_t end_time,
+			       uint32_t min_nodes, uint32_t duration);
 static bool _job_is_completing(void);
+static bool _job_node_limits(struct job_record *job_ptr,
+			     struct part_record *part_ptr,
+			     uint32_t *min_nodes, uint32_t *max_nodes,
+			     uint32_t *req_nodes);
+static bool _job_nodes_usable(struct job_record *job_ptr,
+			      bitstr_t *avail_bitmap, uint32_t min_nodes);
+static bool _job_test_time_limit(struct job_record *job_ptr,
+				 struct part_record *part_ptr,
+				 uint32_t *time_limit,
+				 uint32_t *comp_time_limit);
 static void _load_config(void);
 static bool _many_pending_rpcs(void);
 static bool _more_work(time_t last_backfill_time);
 static void _my_sleep(int usec);
 static int  _num_feature_count(struct job_record *job_ptr);
 static void _reset_job_time_limit(struct job_record *job_ptr, time_t now,
-				  node_space_map_t *node_space);
+				  node_space_t *node_space);
 static int  _start_job(struct job_record *job_ptr, bitstr_t *avail_bitmap);
-static bool _test_resv_overlap(node_space_map_t *node_space,
-			       bitstr_t *use_bitmap, uint32_t start_time,
-			       uint32_t end_reserve);
 static int  _try_sched(struct job_record *job_ptr, bitstr_t **avail_bitmap,
 		       uint32_t min_nodes, uint32_t max_nodes,
 		       uint32_t req_nodes, bitstr_t *exc_core_bitmap);
@@ -184,25 +344,24 @@ static void _dump_job_test(struct job_record *job_ptr, bitstr_t *avail_bitmap,
 	xfree(node_list);
 }
 
-/* Log resource allocate table */
-static void _dump_node_space_table(node_space_map_t *node_space_ptr)
+static int _dump_node_space_slice(time_t begin_time, time_t end_time,
+				  bitstr_t *avail_bitmap, void *arg)
 {
-	int i = 0;
 	char begin_buf[32], end_buf[32], *node_list;
 
+	slurm_make_time_str(&begin_time, begin_buf, sizeof(begin_buf));
+	slurm_make_time_str(&end_time, end_buf, sizeof(end_buf));
+	node_list = bitmap2node_name(avail_bitmap);
+	info("Begin:%s End:%s Nodes:%s", begin_buf, end_buf, node_list);
+	xfree(node_list);
+	return 0;
+}
+
+/* Log resource allocate table */
+static void _dump_node_space_table(node_space_t *node_space)
+{
 	info("=========================================");
-	while (1) {
-		slurm_make_time_str(&node_space_ptr[i].begin_time,
-				    begin_buf, sizeof(begin_buf));
-		slurm_make_time_str(&node_space_ptr[i].end_time,
-				    end_buf, sizeof(end_buf));
-		node_list = bitmap2node_name(node_space_ptr[i].avail_bitmap);
-		info("Begin:%s End:%s Nodes:%s",
-		     begin_buf, end_buf, node_list);
-		xfree(node_list);
-		if ((i = node_space_ptr[i].next) == 0)
-			break;
-	}
+	(void) node_space_walk(node_space, _dump_node_space_slice, NULL);
 	info("=========================================");
 }
 
@@ -272,7 +431,9 @@ static int _num_feature_count(struct job_record *job_ptr)
 	return rc;
 }
 
-/* Attempt to schedule a specific job on specific available nodes
+/* Attempt to schedule a specific job on specific available nodes. With
+ * bf_threads configured, different jobs are tested concurrently, so only the
+ * job's own record may be changed here.
  * IN job_ptr - job to schedule
  * IN/OUT avail_bitmap - nodes available/selected to use
  * IN exc_core_bitmap - cores which can not be used
@@ -396,6 +557,1020 @@ static int  _try_sched(struct job_record *job_ptr, bitstr_t **avail_bitmap,
 
 }
 
+/* Determine the minimum, maximum and requested node counts with which to
+ * test a job in a partition.
+ * RET false if the job's node count can not be satisfied */
+static bool _job_node_limits(struct job_record *job_ptr,
+			     struct part_record *part_ptr,
+			     uint32_t *min_nodes, uint32_t *max_nodes,
+			     uint32_t *req_nodes)
+{
+	*min_nodes = MAX(job_ptr->details->min_nodes, part_ptr->min_nodes);
+	if (job_ptr->details->max_nodes == 0)
+		*max_nodes = part_ptr->max_nodes;
+	else
+		*max_nodes = MIN(job_ptr->details->max_nodes,
+				 part_ptr->max_nodes);
+	*max_nodes = MIN(*max_nodes, 500000);	/* prevent overflows */
+	if (job_ptr->details->max_nodes)
+		*req_nodes = *max_nodes;
+	else
+		*req_nodes = *min_nodes;
+	if (*min_nodes > *max_nodes)
+		return false;
+	return true;
+}
+
+/* Determine the time limit, in minutes, with which to test a job in a
+ * partition and the job's time limit if it is started.
+ * RET true if the job's time limit should be set to time_limit for the test */
+static bool _job_test_time_limit(struct job_record *job_ptr,
+				 struct part_record *part_ptr,
+				 uint32_t *time_limit,
+				 uint32_t *comp_time_limit)
+{
+	slurmdb_qos_rec_t *qos_ptr = job_ptr->qos_ptr;
+	uint32_t part_time_limit;
+
+	if (part_ptr->max_time == INFINITE)
+		part_time_limit = 365 * 24 * 60; /* one year */
+	else
+		part_time_limit = part_ptr->max_time;
+	if (job_ptr->time_limit == NO_VAL) {
+		*time_limit = part_time_limit;
+	} else {
+		if (part_ptr->max_time == INFINITE)
+			*time_limit = job_ptr->time_limit;
+		else
+			*time_limit = MIN(job_ptr->time_limit,
+					  part_time_limit);
+	}
+	*comp_time_limit = *time_limit;
+	if (qos_ptr && (qos_ptr->flags & QOS_FLAG_NO_RESERVE) &&
+	    slurm_get_preempt_mode()) {
+		*time_limit = 1;
+		return true;
+	}
+	if (job_ptr->time_min && (job_ptr->time_min < *time_limit)) {
+		*time_limit = job_ptr->time_min;
+		return true;
+	}
+	return false;
+}
+
+/* Clear from avail_bitmap the nodes which are not usable by a job between
+ * start_res and end_time: nodes outside of its partition, DOWN, COMPLETING,
+ * excluded by the job or reserved for higher priority pending jobs.
+ * RET the next time after start_res when at least min_nodes of the job's
+ *     nodes not reserved for pending jobs will be free for duration seconds,
+ *     or zero if none. Zero is also returned if min_nodes is NO_VAL */
+static time_t _job_avail_nodes(struct job_record *job_ptr,
+			       struct part_record *part_ptr,
+			       bitstr_t *avail_bitmap, bitstr_t *non_cg_bitmap,
+			       node_space_t *node_space,
+			       time_t start_res, time_t end_time,
+			       uint32_t min_nodes, uint32_t duration)
+{
+	bitstr_t *fit_bitmap;
+	time_t later_start = 0;
+
+	fit_bitmap = bit_copy(part_ptr->node_bitmap);
+	bit_and(fit_bitmap, up_node_bitmap);
+	bit_and(fit_bitmap, non_cg_bitmap);
+	if (job_ptr->details->exc_node_bitmap) {
+		bit_and_not(fit_bitmap, job_ptr->details->exc_node_bitmap);
+	}
+	bit_and(avail_bitmap, fit_bitmap);
+
+	/* Nodes in advanced reservations now are not excluded from the later
+	 * window, the job's reservation is tested again at that time */
+	if (min_nodes != NO_VAL) {
+		later_start = node_space_next_window(node_space, fit_bitmap,
+						     min_nodes, start_res,
+						     duration);
+	}
+	FREE_NULL_BITMAP(fit_bitmap);
+	node_space_avail(node_space, avail_bitmap, start_res, end_time);
+
+	return later_start;
+}
+
+/* Test if insufficient nodes remain OR
+ *	required nodes missing OR
+ *	nodes lack features
+ * Nodes lacking features are cleared from avail_bitmap.
+ * RET true if the job could use the nodes in avail_bitmap */
+static bool _job_nodes_usable(struct job_record *job_ptr,
+			      bitstr_t *avail_bitmap, uint32_t min_nodes)
+{
+	if ((bit_set_count(avail_bitmap) < min_nodes) ||
+	    ((job_ptr->details->req_node_bitmap) &&
+	     (!bit_super_set(job_ptr->details->req_node_bitmap,
+			     avail_bitmap))) ||
+	    (job_req_node_filter(job_ptr, avail_bitmap)))
+		return false;
+	return true;
+}
+
+static void _bf_eval_free(bf_eval_t *eval)
+{
+	FREE_NULL_BITMAP(eval->test_bitmap);
+	FREE_NULL_BITMAP(eval->exc_core_bitmap);
+	FREE_NULL_BITMAP(eval->avail_bitmap);
+	xfree(eval);
+}
+
+/* Save the job fields which a test may change */
+static void _bf_eval_save(bf_eval_t *eval)
+{
+	struct job_record *job_ptr = eval->job_ptr;
+
+	eval->save_part_ptr   = job_ptr->part_ptr;
+	eval->save_time_limit = job_ptr->time_limit;
+	eval->save_start_time = job_ptr->start_time;
+	eval->save_total_cpus = job_ptr->total_cpus;
+	eval->save_best_switch = job_ptr->best_switch;
+}
+
+static void _bf_eval_restore(bf_eval_t *eval)
+{
+	struct job_record *job_ptr = eval->job_ptr;
+
+	job_ptr->part_ptr    = eval->save_part_ptr;
+	job_ptr->time_limit  = eval->save_time_limit;
+	job_ptr->start_time  = eval->save_start_time;
+	job_ptr->total_cpus  = eval->save_total_cpus;
+	job_ptr->best_switch = eval->save_best_switch;
+}
+
+/* Prepare a speculative test of a queued job with the nodes which
+ * _attempt_backfill() would first test it with. The job's partition and time
+ * limit are set for the test and reset by _bf_eval_restore().
+ * RET false if the job would not be tested now */
+static bool _bf_eval_prep(bf_eval_t *eval, job_queue_rec_t *job_queue_rec,
+			  time_t now, node_space_t *node_space,
+			  bitstr_t *non_cg_bitmap)
+{
+	struct job_record *job_ptr = job_queue_rec->job_ptr;
+	struct part_record *part_ptr = job_queue_rec->part_ptr;
+	uint32_t time_limit, comp_time_limit;
+	time_t start_res = now, end_time;
+	bool resv_overlap = false;
+
+	if ((job_ptr->magic  != JOB_MAGIC) ||
+	    (job_ptr->job_id != job_queue_rec->job_id) ||
+	    !IS_JOB_PENDING(job_ptr) || job_ptr->preempt_in_progress ||
+	    job_ptr->resv_name ||
+	    ((part_ptr->state_up & PARTITION_SCHED) == 0) ||
+	    (part_ptr->node_bitmap == NULL) ||
+	    !_job_node_limits(job_ptr, part_ptr, &eval->min_nodes,
+			      &eval->max_nodes, &eval->req_nodes))
+		return false;
+
+	eval->job_ptr  = job_ptr;
+	eval->part_ptr = part_ptr;
+	_bf_eval_save(eval);
+	job_ptr->part_ptr = part_ptr;
+	if (_job_test_time_limit(job_ptr, part_ptr, &time_limit,
+				 &comp_time_limit))
+		job_ptr->time_limit = time_limit;
+	eval->time_limit = job_ptr->time_limit;
+
+	if (job_test_resv(job_ptr, &start_res, true, &eval->test_bitmap,
+			  &eval->exc_core_bitmap, &resv_overlap) !=
+	    SLURM_SUCCESS)
+		goto fail;
+	if (start_res > now)
+		end_time = (time_limit * 60) + start_res;
+	else
+		end_time = (time_limit * 60) + now;
+	(void) _job_avail_nodes(job_ptr, part_ptr, eval->test_bitmap,
+				non_cg_bitmap, node_space, start_res, end_time,
+				NO_VAL, 0);
+	if (!_job_nodes_usable(job_ptr, eval->test_bitmap, eval->min_nodes))
+		goto fail;
+	return true;
+
+fail:	_bf_eval_restore(eval);
+	FREE_NULL_BITMAP(eval->test_bitmap);
+	FREE_NULL_BITMAP(eval->exc_core_bitmap);
+	return false;
+}
+
+/* Test one job of a bf_eval_batch_t */
+static void _bf_eval_test(bf_eval_t *eval)
+{
+	struct job_record *job_ptr = eval->job_ptr;
+
+	eval->avail_bitmap = bit_copy(eval->test_bitmap);
+	eval->rc = _try_sched(job_ptr, &eval->avail_bitmap, eval->min_nodes,
+			      eval->max_nodes, eval->req_nodes,
+			      eval->exc_core_bitmap);
+	eval->start_time  = job_ptr->start_time;
+	eval->total_cpus  = job_ptr->total_cpus;
+	eval->best_switch = job_ptr->best_switch;
+}
+
+/* Worker thread, tests jobs of each batch run by _bf_eval_run() until
+ * stopped by _bf_eval_pool_set() */
+static void *_bf_eval_thread(void *arg)
+{
+	bf_eval_t *eval;
+
+	slurm_mutex_lock(&bf_eval_mutex);
+	while (!bf_eval_stop) {
+		if (!bf_eval_batch ||
+		    (bf_eval_batch->next_eval >= bf_eval_batch->eval_cnt)) {
+			pthread_cond_wait(&bf_eval_work_cond, &bf_eval_mutex);
+			continue;
+		}
+		eval = bf_eval_batch->eval[bf_eval_batch->next_eval++];
+		bf_eval_batch->active++;
+		slurm_mutex_unlock(&bf_eval_mutex);
+
+		_bf_eval_test(eval);
+
+		slurm_mutex_lock(&bf_eval_mutex);
+		if (--bf_eval_batch->active == 0)
+			pthread_cond_signal(&bf_eval_done_cond);
+	}
+	slurm_mutex_unlock(&bf_eval_mutex);
+
+	return NULL;
+}
+
+/* Start or stop worker threads so that thread_cnt threads, including the
+ * backfill thread, test jobs. Called only by the backfill thread, never
+ * while a batch is being run. */
+static void _bf_eval_pool_set(int thread_cnt)
+{
+	pthread_attr_t thread_attr;
+	int i;
+
+	if (bf_eval_tid_cnt == (thread_cnt - 1))
+		return;
+
+	if (bf_eval_tid_cnt) {
+		slurm_mutex_lock(&bf_eval_mutex);
+		bf_eval_stop = true;
+		pthread_cond_broadcast(&bf_eval_work_cond);
+		slurm_mutex_unlock(&bf_eval_mutex);
+		for (i = 0; i < bf_eval_tid_cnt; i++)
+			pthread_join(bf_eval_tid[i], NULL);
+		bf_eval_tid_cnt = 0;
+		bf_eval_stop = false;
+	}
+
+	slurm_attr_init(&thread_attr);
+	for (i = 1; i < thread_cnt; i++) {
+		if (pthread_create(&bf_eval_tid[bf_eval_tid_cnt], &thread_attr,
+				   _bf_eval_thread, NULL)) {
+			error("backfill: pthread_create error %m");
+			break;
+		}
+		bf_eval_tid_cnt++;
+	}
+	slurm_attr_destroy(&thread_attr);
+}
+
+/* Test a set of different jobs concurrently with the worker threads. The
+ * calling thread holds the slurmctld locks and tests jobs too. The select
+ * plugin's node usage data is only read by these tests, which _load_config()
+ * permits only with a select plugin whose WILL_RUN tests are reentrant. */
+static void _bf_eval_run(bf_eval_t **eval, int eval_cnt)
+{
+	bf_eval_batch_t batch;
+	bf_eval_t *next;
+	DEF_TIMERS;
+
+	START_TIMER;
+	batch.eval = eval;
+	batch.eval_cnt = eval_cnt;
+	batch.next_eval = 0;
+	batch.active = 0;
+
+	slurm_mutex_lock(&bf_eval_mutex);
+	bf_eval_batch = &batch;
+	pthread_cond_broadcast(&bf_eval_work_cond);
+	while (batch.next_eval < batch.eval_cnt) {
+		next = eval[batch.next_eval++];
+		slurm_mutex_unlock(&bf_eval_mutex);
+		_bf_eval_test(next);
+		slurm_mutex_lock(&bf_eval_mutex);
+	}
+	while (batch.active)
+		pthread_cond_wait(&bf_eval_done_cond, &bf_eval_mutex);
+	bf_eval_batch = NULL;
+	slurm_mutex_unlock(&bf_eval_mutex);
+	END_TIMER;
+	bf_eval_usec += DELTA_TIMER;
+}
+
+/* Discard saved test results which may be changed by a job being started
+ * on the nodes in node_bitmap, or all results if node_bitmap is NULL */
+static void _bf_eval_purge(bitstr_t *node_bitmap)
+{
+	int i, j = 0;
+
+	for (i = 0; i < bf_eval_cnt; i++) {
+		if (!node_bitmap ||
+		    bit_overlap_any(bf_eval[i]->test_bitmap, node_bitmap))
+			_bf_eval_free(bf_eval[i]);
+		else
+			bf_eval[j++] = bf_eval[i];
+	}
+	bf_eval_cnt = j;
+	if (bf_eval_cnt == 0)
+		xfree(bf_eval);
+}
+
+/* Remove and return a saved result of testing a job which is also the result
+ * of testing it with the given input, or NULL if none. Other saved results
+ * for the job in its current partition are discarded as no longer useful.
+ *
+ * Nodes reserved for higher priority jobs since the speculative test was
+ * made are removed from avail_bitmap, so it is often a subset of the nodes
+ * tested. A job which could not run on the nodes tested can not run on a
+ * subset of them, so a failed test is used for any subset. A successful
+ * test is used only with the same nodes, as a new test on a subset might
+ * select other nodes, and nodes are selected as with bf_threads=1. */
+static bf_eval_t *_bf_eval_find(struct job_record *job_ptr,
+				bitstr_t *avail_bitmap, uint32_t min_nodes,
+				uint32_t max_nodes, uint32_t req_nodes,
+				bitstr_t *exc_core_bitmap)
+{
+	bf_eval_t *eval, *match = NULL;
+	int i, j = 0;
+
+	for (i = 0; i < bf_eval_cnt; i++) {
+		eval = bf_eval[i];
+		if ((eval->job_ptr != job_ptr) ||
+		    (eval->part_ptr != job_ptr->part_ptr)) {
+			bf_eval[j++] = eval;
+			continue;
+		}
+		if (!match &&
+		    (eval->time_limit == job_ptr->time_limit) &&
+		    (eval->min_nodes == min_nodes) &&
+		    (eval->max_nodes == max_nodes) &&
+		    (eval->req_nodes == req_nodes) &&
+		    bit_super_set(avail_bitmap, eval->test_bitmap) &&
+		    ((eval->rc != SLURM_SUCCESS) ||
+		     bit_equal(avail_bitmap, eval->test_bitmap)) &&
+		    ((!eval->exc_core_bitmap && !exc_core_bitmap) ||
+		     (eval->exc_core_bitmap && exc_core_bitmap &&
+		      bit_equal(eval->exc_core_bitmap, exc_core_bitmap))))
+			match = eval;
+		else
+			_bf_eval_free(eval);
+	}
+	bf_eval_cnt = j;
+
+	return match;
+}
+
+/* Return true if the job is already being tested or has a saved result */
+static bool _bf_eval_dup(job_queue_rec_t *job_queue_rec, bf_eval_t **batch,
+			 int batch_cnt)
+{
+	int i;
+
+	for (i = 0; i < batch_cnt; i++) {
+		if (batch[i]->job_ptr == job_queue_rec->job_ptr)
+			return true;
+	}
+	for (i = 0; i < bf_eval_cnt; i++) {
+		if ((bf_eval[i]->job_ptr  == job_queue_rec->job_ptr) &&
+		    (bf_eval[i]->part_ptr == job_queue_rec->part_ptr))
+			return true;
+	}
+	return false;
+}
+
+/* Attempt to schedule a specific job on specific available nodes, see
+ * _try_sched(). With bf_threads configured, the jobs which follow it in
+ * job_queue are tested at the same time by other threads, with the nodes
+ * they would be tested with now, and the results are saved until the job is
+ * reached. A saved result is used only if it is also the result of testing
+ * the job then, see _bf_eval_find(), so jobs are still scheduled in priority
+ * order at the same times. */
+static int _bf_try_sched(struct job_record *job_ptr, bitstr_t **avail_bitmap,
+			 uint32_t min_nodes, uint32_t max_nodes,
+			 uint32_t req_nodes, bitstr_t *exc_core_bitmap,
+			 List job_queue, time_t now,
+			 node_space_t *node_space, bitstr_t *non_cg_bitmap)
+{
+	bf_eval_t *eval, **batch;
+	job_queue_rec_t *job_queue_rec;
+	ListIterator job_iterator;
+	int batch_cnt = 0, peek_cnt = 0, i, j, rc;
+
+	if (bf_threads < 2) {
+		return _try_sched(job_ptr, avail_bitmap, min_nodes, max_nodes,
+				  req_nodes, exc_core_bitmap);
+	}
+
+	eval = _bf_eval_find(job_ptr, *avail_bitmap, min_nodes, max_nodes,
+			     req_nodes, exc_core_bitmap);
+	if (eval) {
+		bf_eval_hits++;
+	} else {
+		bf_eval_misses++;
+		batch = xmalloc(sizeof(bf_eval_t *) * bf_threads);
+		eval = xmalloc(sizeof(bf_eval_t));
+		eval->job_ptr    = job_ptr;
+		eval->part_ptr   = job_ptr->part_ptr;
+		eval->min_nodes  = min_nodes;
+		eval->max_nodes  = max_nodes;
+		eval->req_nodes  = req_nodes;
+		eval->time_limit = job_ptr->time_limit;
+		eval->test_bitmap = bit_copy(*avail_bitmap);
+		if (exc_core_bitmap)
+			eval->exc_core_bitmap = bit_copy(exc_core_bitmap);
+		_bf_eval_save(eval);
+		batch[batch_cnt++] = eval;
+
+		job_iterator = list_iterator_create(job_queue);
+		while ((batch_cnt < bf_threads) &&
+		       (peek_cnt++ < (bf_threads * BF_EVAL_LOOKAHEAD)) &&
+		       (job_queue_rec = list_next(job_iterator))) {
+			if (_bf_eval_dup(job_queue_rec, batch, batch_cnt))
+				continue;
+			batch[batch_cnt] = xmalloc(sizeof(bf_eval_t));
+			if (_bf_eval_prep(batch[batch_cnt], job_queue_rec, now,
+					  node_space, non_cg_bitmap))
+				batch_cnt++;
+			else
+				xfree(batch[batch_cnt]);
+		}
+		list_iterator_destroy(job_iterator);
+
+		_bf_eval_run(batch, batch_cnt);
+		for (i = 0; i < batch_cnt; i++)
+			_bf_eval_restore(batch[i]);
+
+		/* Save results for the following jobs, discarding the oldest
+		 * results for jobs which were not tested as expected */
+		if (batch_cnt > 1) {
+			xrealloc(bf_eval, sizeof(bf_eval_t *) *
+				 (bf_eval_cnt + batch_cnt - 1));
+			for (i = 1; i < batch_cnt; i++)
+				bf_eval[bf_eval_cnt++] = batch[i];
+			i = bf_eval_cnt - (bf_threads * BF_EVAL_LOOKAHEAD);
+			if (i > 0) {
+				for (j = 0; j < i; j++)
+					_bf_eval_free(bf_eval[j]);
+				bf_eval_cnt -= i;
+				memmove(bf_eval, bf_eval + i,
+					sizeof(bf_eval_t *) * bf_eval_cnt);
+			}
+		}
+		xfree(batch);
+	}
+
+	FREE_NULL_BITMAP(*avail_bitmap);
+	*avail_bitmap = eval->avail_bitmap;
+	eval->avail_bitmap = NULL;
+	job_ptr->start_time  = eval->start_time;
+	job_ptr->total_cpus  = eval->total_cpus;
+	job_ptr->best_switch = eval->best_switch;
+	rc = eval->rc;
+	_bf_eval_free(eval);
+
+	return rc;
+}
+
+static uint32_t _bf_shape_key(void *rec)
+{
+	return (uint32_t) ((bf_shape_t *) rec)->shape;
+}
+
+static void _bf_shape_free(void *x)
+{
+	xfree(x);
+}
+
+/* Forget the outcomes of tests, as resources may have been freed */
+static void _bf_shape_purge(void)
+{
+	if (bf_shape_hash) {
+		lhash_destroy(bf_shape_hash);
+		bf_shape_hash = NULL;
+	}
+	FREE_NULL_LIST(bf_shape_list);
+}
+
+/* Return the outcome of testing a job of the same shape with the same
+ * limits earlier in this cycle, or NULL if none */
+static bf_shape_t *_bf_shape_find(uint64_t shape,
+				  struct part_record *part_ptr,
+				  uint32_t time_limit, uint32_t min_nodes,
+				  uint32_t max_nodes, uint32_t req_nodes)
+{
+	bf_shape_t *shape_ptr;
+
+	if (!bf_shape_hash)	/* None saved or preemption enabled */
+		return NULL;
+	for (shape_ptr = lhash_first(bf_shape_hash, (uint32_t) shape);
+	     shape_ptr; shape_ptr = shape_ptr->next) {
+		if ((shape_ptr->shape      == shape)      &&
+		    (shape_ptr->part_ptr   == part_ptr)   &&
+		    (shape_ptr->time_limit == time_limit) &&
+		    (shape_ptr->min_nodes  == min_nodes)  &&
+		    (shape_ptr->max_nodes  == max_nodes)  &&
+		    (shape_ptr->req_nodes  == req_nodes))
+			return shape_ptr;
+	}
+	return NULL;
+}
+
+/* Save the outcome of testing a job, start_time is zero if not runable */
+static void _bf_shape_save(uint64_t shape, struct part_record *part_ptr,
+			   uint32_t time_limit, uint32_t min_nodes,
+			   uint32_t max_nodes, uint32_t req_nodes,
+			   time_t start_time)
+{
+	bf_shape_t *shape_ptr;
+
+	if (!bf_shape_reuse)
+		return;
+	shape_ptr = _bf_shape_find(shape, part_ptr, time_limit, min_nodes,
+				   max_nodes, req_nodes);
+	if (shape_ptr) {
+		shape_ptr->start_time = start_time;
+		return;
+	}
+	if (!bf_shape_hash) {
+		bf_shape_hash = lhash_create(64, offsetof(bf_shape_t, next),
+					     _bf_shape_key);
+		bf_shape_list = list_create(_bf_shape_free);
+	}
+	shape_ptr = xmalloc(sizeof(bf_shape_t));
+	shape_ptr->shape      = shape;
+	shape_ptr->part_ptr   = part_ptr;
+	shape_ptr->time_limit = time_limit;
+	shape_ptr->min_nodes  = min_nodes;
+	shape_ptr->max_nodes  = max_nodes;
+	shape_ptr->req_nodes  = req_nodes;
+	shape_ptr->start_time = start_time;
+	list_append(bf_shape_list, shape_ptr);
+	lhash_add(bf_shape_hash, shape_ptr);
+}
+
+static uint32_t _bf_plan_key(void *rec)
+{
+	return ((bf_plan_rec_t *) rec)->job_id;
+}
+
+/* Record a change in resources made by a thread other than the backfill
+ * scheduler, for use by its next cycle */
+static void _bf_plan_event(bool freed, uint32_t job_id, time_t begin_time,
+			   time_t end_time, bitstr_t *node_bitmap)
+{
+	pthread_mutex_lock(&bf_plan_mutex);
+	if (!bf_plan_events)
+		;	/* No plan kept */
+	else if (list_count(bf_plan_events) >= BF_PLAN_MAX_DELTAS)
+		bf_plan_overflow = true;
+	else
+		bf_delta_add(bf_plan_events, freed, job_id, begin_time,
+			     end_time, node_bitmap);
+	pthread_mutex_unlock(&bf_plan_mutex);
+}
+
+static void _bf_plan_purge(bf_plan_t *plan)
+{
+	uint32_t i;
+
+	for (i = 0; i < plan->rec_cnt; i++) {
+		FREE_NULL_BITMAP(plan->rec[i]->node_bitmap);
+		xfree(plan->rec[i]);
+	}
+	xfree(plan->rec);
+	plan->rec_cnt = 0;
+	plan->rec_size = 0;
+	if (plan->hash) {
+		lhash_destroy(plan->hash);
+		plan->hash = NULL;
+	}
+}
+
+/* Stop keeping a plan across cycles and free its records */
+static void _bf_plan_fini(void)
+{
+	pthread_mutex_lock(&bf_plan_mutex);
+	FREE_NULL_LIST(bf_plan_events);
+	bf_plan_overflow = false;
+	pthread_mutex_unlock(&bf_plan_mutex);
+
+	_bf_plan_purge(&bf_plan_old);
+	_bf_plan_purge(&bf_plan_new);
+	FREE_NULL_LIST(bf_deltas);
+	FREE_NULL_LIST(bf_deltas_next);
+	FREE_NULL_BITMAP(bf_plan_nodes);
+	bf_job_ends_destroy(bf_job_ends);
+	bf_job_ends = NULL;
+	bf_plan_retest = NULL;
+}
+
+/* Return the reservation with the given occurrence number for a job in a
+ * partition, or NULL if none */
+static bf_plan_rec_t *_bf_plan_find(bf_plan_t *plan, uint32_t job_id,
+				    struct part_record *part_ptr,
+				    uint16_t occurrence)
+{
+	bf_plan_rec_t *rec;
+
+	if (!plan->hash)
+		return NULL;
+	for (rec = lhash_first(plan->hash, job_id); rec; rec = rec->next) {
+		if ((rec->job_id == job_id) && (rec->part_ptr == part_ptr) &&
+		    (rec->occurrence == occurrence))
+			return rec;
+	}
+	return NULL;
+}
+
+/* Return the count of reservations for a job in a partition */
+static uint16_t _bf_plan_count(bf_plan_t *plan, uint32_t job_id,
+			       struct part_record *part_ptr)
+{
+	bf_plan_rec_t *rec;
+	uint16_t count = 0;
+
+	if (!plan->hash)
+		return 0;
+	for (rec = lhash_first(plan->hash, job_id); rec; rec = rec->next) {
+		if ((rec->job_id == job_id) && (rec->part_ptr == part_ptr))
+			count++;
+	}
+	return count;
+}
+
+/* Release an old reservation. Any job reserved later might use its nodes. */
+static void _bf_plan_release(bf_plan_rec_t *rec)
+{
+	rec->done = true;
+	bf_delta_add(bf_deltas, true, 0, rec->start_time, 0,
+		     rec->node_bitmap);
+}
+
+/* Release the old reservations preceding the given one which this cycle
+ * has not reached, as their jobs have ended, changed priority or been
+ * skipped */
+static void _bf_plan_advance(uint32_t position)
+{
+	for ( ; bf_plan_next < position; bf_plan_next++) {
+		if (!bf_plan_old.rec[bf_plan_next]->done)
+			_bf_plan_release(bf_plan_old.rec[bf_plan_next]);
+	}
+	if (bf_plan_next == position)
+		bf_plan_next++;
+}
+
+/* Record nodes allocated to a job from begin_time to end_time. If the job
+ * had an old reservation, only the difference between the two is
+ * recorded. */
+static void _bf_plan_alloc(bf_plan_rec_t *rec, uint32_t job_id,
+			   bitstr_t *alloc_bitmap, time_t begin_time,
+			   time_t end_time)
+{
+	bitstr_t *tmp_bitmap;
+
+	if (!rec) {
+		bf_delta_add(bf_deltas, false, job_id, begin_time, end_time,
+			     alloc_bitmap);
+		return;
+	}
+	rec->done = true;
+
+	/* Nodes allocated, but not reserved */
+	tmp_bitmap = bit_copy(alloc_bitmap);
+	bit_and_not(tmp_bitmap, rec->node_bitmap);
+	bf_delta_add(bf_deltas, false, job_id, begin_time, end_time,
+		     tmp_bitmap);
+
+	/* Nodes allocated and reserved, but for a different period */
+	bit_copybits(tmp_bitmap, alloc_bitmap);
+	bit_and(tmp_bitmap, rec->node_bitmap);
+	bf_delta_add(bf_deltas, false, job_id, begin_time, rec->start_time,
+		     tmp_bitmap);
+	bf_delta_add(bf_deltas, false, job_id, rec->end_time, end_time,
+		     tmp_bitmap);
+	if (end_time < rec->end_time) {
+		bf_delta_add(bf_deltas, true, 0, end_time, 0,
+			     tmp_bitmap);
+	}
+
+	/* Nodes reserved, but not allocated */
+	bit_copybits(tmp_bitmap, rec->node_bitmap);
+	bit_and_not(tmp_bitmap, alloc_bitmap);
+	bf_delta_add(bf_deltas, true, 0, rec->start_time, 0, tmp_bitmap);
+	FREE_NULL_BITMAP(tmp_bitmap);
+}
+
+/* Return changes in resources made by other threads, to node state, or to
+ * the end time or suspend state of running jobs, since last seen */
+static List _bf_plan_changes(time_t now, bool *overflow)
+{
+	bitstr_t *usable_bitmap, *tmp_bitmap;
+	List events;
+
+	pthread_mutex_lock(&bf_plan_mutex);
+	if (!bf_plan_events)
+		events = list_create(bf_delta_free);
+	else
+		events = bf_plan_events;
+	bf_plan_events = list_create(bf_delta_free);
+	*overflow = bf_plan_overflow;
+	bf_plan_overflow = false;
+	pthread_mutex_unlock(&bf_plan_mutex);
+
+	usable_bitmap = bit_copy(avail_node_bitmap);
+	bit_and(usable_bitmap, up_node_bitmap);
+	if (bf_plan_nodes) {
+		tmp_bitmap = bit_copy(usable_bitmap);
+		bit_and_not(tmp_bitmap, bf_plan_nodes);
+		bf_delta_add(events, true, 0, now, 0, tmp_bitmap);
+		bit_copybits(tmp_bitmap, bf_plan_nodes);
+		bit_and_not(tmp_bitmap, usable_bitmap);
+		bf_delta_add(events, false, 0, now, (time_t) INFINITE,
+			     tmp_bitmap);
+		FREE_NULL_BITMAP(tmp_bitmap);
+		FREE_NULL_BITMAP(bf_plan_nodes);
+	}
+	bf_plan_nodes = usable_bitmap;
+
+	if (!bf_job_ends)
+		bf_job_ends = bf_job_ends_create();
+	bf_job_end_changes += bf_job_ends_scan(bf_job_ends, job_list, events,
+					       now);
+
+	return events;
+}
+
+/* Add changes made while the backfill scheduler yielded its locks. They
+ * apply to the reservations made both before and after the yield, so are
+ * also kept for the next cycle. */
+static void _bf_plan_sync(time_t now)
+{
+	ListIterator iter;
+	bf_delta_t *delta;
+	List events;
+	bool overflow;
+
+	if (!bf_deltas)
+		return;
+	events = _bf_plan_changes(now, &overflow);
+	if (overflow) {		/* Rebuild next plan */
+		pthread_mutex_lock(&bf_plan_mutex);
+		bf_plan_overflow = true;
+		pthread_mutex_unlock(&bf_plan_mutex);
+	}
+	iter = list_iterator_create(events);
+	while ((delta = (bf_delta_t *) list_next(iter))) {
+		bf_delta_add(bf_deltas_next, delta->freed, delta->job_id,
+			     delta->begin_time, delta->end_time,
+			     delta->node_bitmap);
+	}
+	list_iterator_destroy(iter);
+	list_transfer(bf_deltas, events);
+	FREE_NULL_LIST(events);
+}
+
+/* Prepare to reuse the reservations made by the previous cycle, or discard
+ * them if they may no longer be valid */
+static void _bf_plan_begin(time_t now)
+{
+	bf_plan_rec_t *rec, *alloc_rec;
+	bf_delta_t *delta;
+	char *reason = NULL;
+	List events;
+	bool overflow;
+
+	if (!backfill_continue) {
+		if (bf_deltas)
+			_bf_plan_fini();
+		return;
+	}
+	if (!bf_deltas) {
+		bf_deltas = list_create(bf_delta_free);
+		bf_deltas_next = list_create(bf_delta_free);
+	}
+
+	events = _bf_plan_changes(now, &overflow);
+	list_transfer(bf_deltas_next, events);
+	FREE_NULL_LIST(events);
+	events = bf_deltas_next;
+	bf_deltas_next = list_create(bf_delta_free);
+
+	if (bf_plan_old.rec_cnt == 0)
+		;
+	else if ((bf_plan_config != slurmctld_conf.last_update) ||
+		 (bf_plan_part   != last_part_update) ||
+		 (bf_plan_resv   != last_resv_update))
+		reason = "configuration change";
+	else if (overflow || (list_count(events) > BF_PLAN_MAX_DELTAS))
+		reason = "too many changes";
+	else if (now >= (bf_plan_time + BF_PLAN_MAX_AGE))
+		reason = "plan expiration";
+	if (reason) {
+		if (debug_flags & DEBUG_FLAG_BACKFILL)
+			info("backfill: rebuilding plan due to %s", reason);
+		_bf_plan_purge(&bf_plan_old);
+	}
+
+	/* A job started as planned moves no other reservation, so only the
+	 * difference between its allocation and reservation is a change */
+	while ((delta = (bf_delta_t *) list_pop(events))) {
+		if ((bf_plan_old.rec_cnt == 0) ||
+		    delta->freed || (delta->job_id == 0)) {
+			list_append(bf_deltas, delta);
+			continue;
+		}
+		alloc_rec = NULL;
+		for (rec = lhash_first(bf_plan_old.hash, delta->job_id); rec;
+		     rec = rec->next) {
+			if ((rec->job_id != delta->job_id) || rec->done)
+				continue;
+			if (!alloc_rec)
+				alloc_rec = rec;
+			else	/* Reservation in another partition */
+				_bf_plan_release(rec);
+		}
+		_bf_plan_alloc(alloc_rec, delta->job_id, delta->node_bitmap,
+			       delta->begin_time, delta->end_time);
+		bf_delta_free(delta);
+	}
+	FREE_NULL_LIST(events);
+	if (bf_plan_old.rec_cnt == 0)
+		list_flush(bf_deltas);
+
+	bf_plan_config = slurmctld_conf.last_update;
+	bf_plan_part   = last_part_update;
+	bf_plan_resv   = last_resv_update;
+	if (reason || (bf_plan_old.rec_cnt == 0))
+		bf_plan_time = now;
+	bf_plan_next   = 0;
+	bf_plan_reused = 0;
+	bf_plan_retest = NULL;
+	bf_plan_new.hash = lhash_create(64, offsetof(bf_plan_rec_t, next),
+					_bf_plan_key);
+}
+
+/* Keep the reservations made by this cycle for the next one */
+static void _bf_plan_end(void)
+{
+	if (!bf_deltas)
+		return;
+	_bf_plan_resolve();
+	if ((debug_flags & DEBUG_FLAG_BACKFILL) && bf_plan_old.rec_cnt) {
+		info("backfill: reused %u of %u reservations from previous "
+		     "cycle, %u job end time or suspend changes",
+		     bf_plan_reused, bf_plan_old.rec_cnt, bf_job_end_changes);
+	}
+	bf_job_end_changes = 0;
+	_bf_plan_purge(&bf_plan_old);
+	bf_plan_old = bf_plan_new;
+	memset(&bf_plan_new, 0, sizeof(bf_plan_t));
+	list_flush(bf_deltas);
+}
+
+/* The job being tested, if it had an old reservation, was neither started
+ * nor given a new reservation, so release the old one */
+static void _bf_plan_resolve(void)
+{
+	if (bf_plan_retest) {
+		_bf_plan_release(bf_plan_retest);
+		bf_plan_retest = NULL;
+	}
+}
+
+/*
+ * Return the job's reservation from the previous cycle if it can be used
+ * without testing the job again, otherwise NULL. The old reservation must
+ * be for the same request, still in the future, free of any reservation
+ * made by this cycle, and not affected by any change in resources since
+ * the previous cycle.
+ */
+static bf_plan_rec_t *_bf_plan_reuse(struct job_record *job_ptr,
+				     struct part_record *part_ptr,
+				     uint64_t shape,
+				     uint32_t time_limit, uint32_t min_nodes,
+				     uint32_t max_nodes, uint32_t req_nodes,
+				     time_t now, node_space_t *node_space)
+{
+	bf_plan_rec_t *rec;
+	uint16_t occurrence;
+
+	if (!bf_deltas)
+		return NULL;
+	_bf_plan_resolve();
+	occurrence = _bf_plan_count(&bf_plan_new, job_ptr->job_id, part_ptr);
+	rec = _bf_plan_find(&bf_plan_old, job_ptr->job_id, part_ptr,
+			    occurrence);
+	if (!rec || rec->done)
+		return NULL;
+	_bf_plan_advance(rec->position);
+	rec->done = true;
+	bf_plan_retest = rec;
+
+	if ((rec->shape      != shape) ||
+	    (rec->time_limit != time_limit) ||
+	    (rec->min_nodes  != min_nodes)  ||
+	    (rec->max_nodes  != max_nodes)  ||
+	    (rec->req_nodes  != req_nodes)  ||
+	    (rec->job_start  <= now) ||
+	    bf_delta_affects(bf_deltas, rec->job_start, rec->start_time,
+			     rec->end_time, rec->node_bitmap) ||
+	    node_space_overlap(node_space, rec->node_bitmap,
+			       rec->start_time, rec->end_time))
+		return NULL;
+
+	bf_plan_retest = NULL;
+	bf_plan_reused++;
+	return rec;
+}
+
+/* Record a job started by this cycle */
+static void _bf_plan_started(struct job_record *job_ptr, time_t now)
+{
+	if (!bf_deltas)
+		return;
+	_bf_plan_alloc(bf_plan_retest, job_ptr->job_id, job_ptr->node_bitmap,
+		       now, job_ptr->end_time);
+	bf_plan_retest = NULL;
+}
+
+/* Record a reservation made by this cycle. The job's old reservation, if
+ * any and different, is released. */
+static void _bf_plan_add(struct job_record *job_ptr,
+			 struct part_record *part_ptr, uint64_t shape,
+			 uint32_t time_limit,
+			 uint32_t min_nodes, uint32_t max_nodes,
+			 uint32_t req_nodes, time_t start_time,
+			 time_t end_time, bitstr_t *node_bitmap)
+{
+	bf_plan_rec_t *rec, *old_rec = bf_plan_retest;
+
+	if (!bf_deltas)
+		return;
+	rec = xmalloc(sizeof(bf_plan_rec_t));
+	rec->job_id      = job_ptr->job_id;
+	rec->part_ptr    = part_ptr;
+	rec->occurrence  = _bf_plan_count(&bf_plan_new, job_ptr->job_id,
+					  part_ptr);
+	rec->position    = bf_plan_new.rec_cnt;
+	rec->shape       = shape;
+	rec->time_limit  = time_limit;
+	rec->min_nodes   = min_nodes;
+	rec->max_nodes   = max_nodes;
+	rec->req_nodes   = req_nodes;
+	rec->job_start   = job_ptr->start_time;
+	rec->start_time  = start_time;
+	rec->end_time    = end_time;
+	rec->node_bitmap = bit_copy(node_bitmap);
+	if (bf_plan_new.rec_cnt >= bf_plan_new.rec_size) {
+		bf_plan_new.rec_size = MAX(64, bf_plan_new.rec_size * 2);
+		xrealloc(bf_plan_new.rec,
+			 sizeof(bf_plan_rec_t *) * bf_plan_new.rec_size);
+	}
+	bf_plan_new.rec[bf_plan_new.rec_cnt++] = rec;
+	lhash_add(bf_plan_new.hash, rec);
+
+	bf_plan_retest = NULL;
+	if (old_rec &&
+	    ((old_rec->start_time != start_time) ||
+	     (old_rec->end_time   != end_time) ||
+	     !bit_equal(old_rec->node_bitmap, node_bitmap)))
+		_bf_plan_release(old_rec);
+}
+
+/* Note that a job was allocated resources other than by backfill */
+extern void backfill_job_alloc(struct job_record *job_ptr)
+{
+	if (!job_ptr->node_bitmap || pthread_equal(pthread_self(), bf_thread))
+		return;
+	_bf_plan_event(false, job_ptr->job_id, time(NULL), job_ptr->end_time,
+		       job_ptr->node_bitmap);
+}
+
+/* Note that a job's resources were released */
+extern void backfill_job_free(struct job_record *job_ptr)
+{
+	time_t now = time(NULL);
+
+	if (!job_ptr->node_bitmap || pthread_equal(pthread_self(), bf_thread))
+		return;
+	/* Plans assume a job runs to its time limit */
+	if ((job_ptr->time_limit != INFINITE) &&
+	    (job_ptr->time_limit != NO_VAL) &&
+	    (now >= (job_ptr->start_time + job_ptr->tot_sus_time +
+		     (job_ptr->time_limit * 60))))
+		return;
+	_bf_plan_event(true, 0, now, 0, job_ptr->node_bitmap);
+}
+
 /* Terminate backfill_agent */
 extern void stop_backfill_agent(void)
 {
@@ -440,7 +1615,7 @@ static void _my_sleep(int usec)
 
 static void _load_config(void)
 {
-	char *sched_params, *tmp_ptr;
+	char *sched_params, *select_type, *tmp_ptr;
 
 	sched_params = slurm_get_sched_params();
 	debug_flags  = slurm_get_debug_flags();
@@ -536,6 +1711,23 @@ static void _load_config(void)
 		yield_sleep = YIELD_SLEEP;
 	}
 
+	if (sched_params && (tmp_ptr=strstr(sched_params, "bf_threads=")))
+		bf_threads = atoi(tmp_ptr + 11);
+	if ((bf_threads < 1) || (bf_threads > BF_MAX_THREADS)) {
+		error("Invalid SchedulerParameters bf_threads: %d",
+		      bf_threads);
+		bf_threads = 1;
+	}
+	select_type = slurm_get_select_type();
+	if ((bf_threads > 1) && xstrcmp(select_type, "select/cons_res")) {
+		/* Only cons_res is known to permit concurrent WILL_RUN tests
+		 * with the slurmctld locks held, see _bf_eval_run() */
+		info("backfill: bf_threads not supported with SelectType=%s",
+		     select_type);
+		bf_threads = 1;
+	}
+	xfree(select_type);
+
 	if (sched_params && (tmp_ptr=strstr(sched_params, "max_rpc_cnt=")))
 		defer_rpc_cnt = atoi(tmp_ptr + 12);
 	if (defer_rpc_cnt < 0) {
@@ -597,7 +1789,9 @@ extern void *backfill_agent(void *args)
 		      __func__, "slurm_backfill");
 	}
 #endif
+	bf_thread = pthread_self();
 	_load_config();
+	_bf_eval_pool_set(bf_threads);
 	last_backfill_time = time(NULL);
 	while (!stop_backfill) {
 		_my_sleep(backfill_interval * 1000000);
@@ -606,6 +1800,7 @@ extern void *backfill_agent(void *args)
 		if (config_flag) {
 			config_flag = false;
 			_load_config();
+			_bf_eval_pool_set(bf_threads);
 		}
 		now = time(NULL);
 		wait_time = difftime(now, last_backfill_time);
@@ -619,6 +1814,8 @@ extern void *backfill_agent(void *args)
 		last_backfill_time = time(NULL);
 		unlock_slurmctld(all_locks);
 	}
+	_bf_eval_pool_set(1);
+	_bf_plan_fini();
 	return NULL;
 }
 
@@ -646,6 +1843,8 @@ static int _yield_locks(int usec)
 		READ_LOCK, WRITE_LOCK, WRITE_LOCK, READ_LOCK };
 	time_t job_update, node_update, part_update;
 
+	_bf_eval_purge(NULL);	/* State may change while unlocked */
+	_bf_shape_purge();
 	job_update  = last_job_update;
 	node_update = last_node_update;
 	part_update = last_part_update;
@@ -654,6 +1853,7 @@ static int _yield_locks(int usec)
 	bf_last_yields++;
 	_my_sleep(usec);
 	lock_slurmctld(all_locks);
+	_bf_plan_sync(time(NULL));
 
 	if ((last_job_update  == job_update)  &&
 	    (last_node_update == node_update) &&
@@ -671,17 +1871,18 @@ static int _attempt_backfill(void)
 	List job_queue;
 	job_queue_rec_t *job_queue_rec;
 	slurmdb_qos_rec_t *qos_ptr = NULL;
-	int i, j, node_space_recs;
+	int i, j;
 	struct job_record *job_ptr;
 	struct part_record *part_ptr, **bf_part_ptr = NULL;
 	uint32_t end_time, end_reserve;
-	uint32_t time_limit, comp_time_limit, orig_time_limit, part_time_limit;
+	uint32_t time_limit, comp_time_limit, orig_time_limit;
 	uint32_t min_nodes, max_nodes, req_nodes;
 	bitstr_t *avail_bitmap = NULL, *resv_bitmap = NULL;
 	bitstr_t *exc_core_bitmap = NULL, *non_cg_bitmap = NULL;
+	char *sched_nodes;
 	time_t now, sched_start, later_start, start_res, resv_end, window_end;
 	time_t orig_start_time = (time_t) 0;
-	node_space_map_t *node_space;
+	node_space_t *node_space;
 	struct timeval bf_time1, bf_time2;
 	int rc = 0;
 	int job_test_count = 0;
@@ -697,8 +1898,16 @@ static int _attempt_backfill(void)
 	uint32_t test_array_job_id = 0;
 	uint32_t test_array_count = 0;
 	bool resv_overlap = false;
+	bf_plan_rec_t *plan_rec;
+	bf_shape_t *shape_ptr;
+	uint64_t shape;
 
 	bf_last_yields = 0;
+	bf_shape_hits = 0;
+	bf_shape_reuse = !slurm_preemption_enabled();
+	bf_eval_hits = 0;
+	bf_eval_misses = 0;
+	bf_eval_usec = 0;
 #ifdef HAVE_ALPS_CRAY
 	/*
 	 * Run a Basil Inventory immediately before setting up the schedule
@@ -756,16 +1965,12 @@ static int _attempt_backfill(void)
 	slurmctld_diag_stats.bf_when_last_cycle = now;
 	slurmctld_diag_stats.bf_active = 1;
 
-	node_space = xmalloc(sizeof(node_space_map_t) *
-			     (max_backfill_job_cnt * 2 + 1));
-	node_space[0].begin_time = sched_start;
 	window_end = sched_start + backfill_window;
-	node_space[0].end_time = window_end;
-	node_space[0].avail_bitmap = bit_copy(avail_node_bitmap);
-	node_space[0].next = 0;
-	node_space_recs = 1;
+	node_space = node_space_create(sched_start, window_end,
+				       backfill_resolution, avail_node_bitmap);
 	if (debug_flags & DEBUG_FLAG_BACKFILL_MAP)
 		_dump_node_space_table(node_space);
+	_bf_plan_begin(sched_start);
 
 	if (max_backfill_job_per_part) {
 		ListIterator part_iterator;
@@ -845,6 +2050,7 @@ static int _attempt_backfill(void)
 		xfree(job_queue_rec);
 
 next_task:
+		_bf_plan_resolve();
 		job_test_count++;
 		slurmctld_diag_stats.bf_last_depth++;
 		already_counted = false;
@@ -958,19 +2164,8 @@ next_task:
 		}
 
 		/* Determine minimum and maximum node counts */
-		min_nodes = MAX(job_ptr->details->min_nodes,
-				part_ptr->min_nodes);
-		if (job_ptr->details->max_nodes == 0)
-			max_nodes = part_ptr->max_nodes;
-		else
-			max_nodes = MIN(job_ptr->details->max_nodes,
-					part_ptr->max_nodes);
-		max_nodes = MIN(max_nodes, 500000);     /* prevent overflows */
-		if (job_ptr->details->max_nodes)
-			req_nodes = max_nodes;
-		else
-			req_nodes = min_nodes;
-		if (min_nodes > max_nodes) {
+		if (!_job_node_limits(job_ptr, part_ptr, &min_nodes,
+				      &max_nodes, &req_nodes)) {
 			if (debug_flags & DEBUG_FLAG_BACKFILL)
 				info("backfill: job %u node count too high",
 				     job_ptr->job_id);
@@ -978,29 +2173,64 @@ next_task:
 		}
 
 		/* Determine job's expected completion time */
-		if (part_ptr->max_time == INFINITE)
-			part_time_limit = 365 * 24 * 60; /* one year */
-		else
-			part_time_limit = part_ptr->max_time;
-		if (job_ptr->time_limit == NO_VAL) {
-			time_limit = part_time_limit;
-		} else {
-			if (part_ptr->max_time == INFINITE)
-				time_limit = job_ptr->time_limit;
-			else
-				time_limit = MIN(job_ptr->time_limit,
-						 part_time_limit);
-		}
-		comp_time_limit = time_limit;
+		if (_job_test_time_limit(job_ptr, part_ptr, &time_limit,
+					 &comp_time_limit))
+			job_ptr->time_limit = time_limit;
 		qos_ptr = job_ptr->qos_ptr;
-		if (qos_ptr && (qos_ptr->flags & QOS_FLAG_NO_RESERVE) &&
-		    slurm_get_preempt_mode())
-			time_limit = job_ptr->time_limit = 1;
-		else if (job_ptr->time_min && (job_ptr->time_min < time_limit))
-			time_limit = job_ptr->time_limit = job_ptr->time_min;
 
-		/* Determine impact of any resource reservations */
+		/* Use the previous cycle's reservation if nothing moved it */
+		shape = job_shape(job_ptr);
+		plan_rec = _bf_plan_reuse(job_ptr, part_ptr, shape, time_limit,
+					  min_nodes, max_nodes, req_nodes,
+					  now, node_space);
+		if (plan_rec) {
+			if (debug_flags & DEBUG_FLAG_BACKFILL)
+				info("backfill: job %u reservation unchanged",
+				     job_ptr->job_id);
+			FREE_NULL_BITMAP(avail_bitmap);
+			avail_bitmap = bit_copy(plan_rec->node_bitmap);
+			job_ptr->start_time = plan_rec->job_start;
+			if (job_ptr->start_time != orig_start_time)
+				job_changed(job_ptr, now);
+			start_res = plan_rec->job_start;
+			later_start = 0;
+			goto PLAN_REUSED;
+		}
+
+		/* A job of the same shape tested earlier in this cycle can
+		 * start no later than this one */
 		later_start = now;
+		shape_ptr = _bf_shape_find(shape, part_ptr, time_limit,
+					   min_nodes, max_nodes, req_nodes);
+		if (shape_ptr) {
+			bf_shape_hits++;
+			if (shape_ptr->start_time == 0) {
+				if (debug_flags & DEBUG_FLAG_BACKFILL)
+					info("backfill: job %u not runable, "
+					     "same request as earlier job",
+					     job_ptr->job_id);
+				job_ptr->time_limit = orig_time_limit;
+				job_ptr->start_time = orig_start_time;
+				continue;
+			}
+			if (shape_ptr->start_time >
+			    (sched_start + backfill_window)) {
+				/* Can not start until too far in future */
+				job_ptr->time_limit = orig_time_limit;
+				job_ptr->start_time = sched_start +
+						      backfill_window;
+				if ((orig_start_time != 0) &&
+				    (orig_start_time < job_ptr->start_time))
+					job_ptr->start_time = orig_start_time;
+				if (job_ptr->start_time != orig_start_time)
+					job_changed(job_ptr, now);
+				continue;
+			}
+			if (shape_ptr->start_time > now)
+				later_start = shape_ptr->start_time;
+		}
+
+		/* Determine impact of any resource reservations */
  TRY_LATER:
 		if (slurmctld_config.shutdown_time)
 			break;
@@ -1072,51 +2302,25 @@ next_task:
 			end_time = (time_limit * 60) + now;
 		resv_end = find_resv_end(start_res);
 		/* Identify usable nodes for this job */
-		bit_and(avail_bitmap, part_ptr->node_bitmap);
-		bit_and(avail_bitmap, up_node_bitmap);
-		bit_and(avail_bitmap, non_cg_bitmap);
-		for (j=0; ; ) {
-			if ((node_space[j].end_time > start_res) &&
-			     node_space[j].next && (later_start == 0))
-				later_start = node_space[j].end_time;
-			if (node_space[j].end_time <= start_res)
-				;
-			else if (node_space[j].begin_time <= end_time) {
-				bit_and(avail_bitmap,
-					node_space[j].avail_bitmap);
-			} else
-				break;
-			if ((j = node_space[j].next) == 0)
-				break;
-		}
+		later_start = _job_avail_nodes(job_ptr, part_ptr, avail_bitmap,
+					       non_cg_bitmap, node_space,
+					       start_res, end_time, min_nodes,
+					       time_limit * 60);
 		if (resv_end && (++resv_end < window_end) &&
 		    ((later_start == 0) || (resv_end < later_start))) {
 			later_start = resv_end;
 		}
 
-		if (job_ptr->details->exc_node_bitmap) {
-			bit_not(job_ptr->details->exc_node_bitmap);
-			bit_and(avail_bitmap,
-				job_ptr->details->exc_node_bitmap);
-			bit_not(job_ptr->details->exc_node_bitmap);
-		}
-
-		/* Test if insufficient nodes remain OR
-		 *	required nodes missing OR
-		 *	nodes lack features OR
-		 *	no change since previously tested nodes (only changes
-		 *	in other partition nodes) */
-		if ((bit_set_count(avail_bitmap) < min_nodes) ||
-		    ((job_ptr->details->req_node_bitmap) &&
-		     (!bit_super_set(job_ptr->details->req_node_bitmap,
-				     avail_bitmap))) ||
-		    (job_req_node_filter(job_ptr, avail_bitmap))) {
+		if (!_job_nodes_usable(job_ptr, avail_bitmap, min_nodes)) {
 			if (later_start) {
 				job_ptr->start_time = 0;
 				goto TRY_LATER;
 			}
 
 			/* Job can not start until too far in the future */
+			_bf_shape_save(shape, part_ptr, time_limit, min_nodes,
+				       max_nodes, req_nodes,
+				       sched_start + backfill_window + 1);
 			job_ptr->time_limit = orig_time_limit;
 			job_ptr->start_time = sched_start + backfill_window;
 			if ((orig_start_time != 0) &&
@@ -1124,6 +2328,8 @@ next_task:
 				/* Can start earlier in different partition */
 				job_ptr->start_time = orig_start_time;
 			}
+			if (job_ptr->start_time != orig_start_time)
+				job_changed(job_ptr, now);
 			continue;
 		}
 
@@ -1143,11 +2349,14 @@ next_task:
 
 		if (debug_flags & DEBUG_FLAG_BACKFILL_MAP)
 			_dump_job_test(job_ptr, avail_bitmap, start_res);
-		j = _try_sched(job_ptr, &avail_bitmap, min_nodes, max_nodes,
-			       req_nodes, exc_core_bitmap);
+		j = _bf_try_sched(job_ptr, &avail_bitmap, min_nodes, max_nodes,
+				  req_nodes, exc_core_bitmap, job_queue, now,
+				  node_space, non_cg_bitmap);
 
 		now = time(NULL);
 		if (j != SLURM_SUCCESS) {
+			_bf_shape_save(shape, part_ptr, time_limit, min_nodes,
+				       max_nodes, req_nodes, 0);
 			job_ptr->time_limit = orig_time_limit;
 			if (orig_start_time != 0)  /* Can start in other part */
 				job_ptr->start_time = orig_start_time;
@@ -1156,15 +2365,20 @@ next_task:
 			continue;	/* not runable in this partition */
 		}
 
+ PLAN_REUSED:
 		if (start_res > job_ptr->start_time) {
 			job_ptr->start_time = start_res;
-			last_job_update = now;
+			job_changed(job_ptr, now);
 		}
 		if (job_ptr->start_time <= now) {	/* Can start now */
 			uint32_t save_time_limit = job_ptr->time_limit;
 			uint32_t hard_limit;
 			bool reset_time = false;
 			int rc = _start_job(job_ptr, resv_bitmap);
+			if (rc == SLURM_SUCCESS)
+				_bf_eval_purge(job_ptr->node_bitmap);
+			else
+				_bf_eval_purge(NULL);
 			if (qos_ptr && (qos_ptr->flags & QOS_FLAG_NO_RESERVE)) {
 				if (orig_time_limit == NO_VAL) {
 					acct_policy_alter_job(
@@ -1222,6 +2436,7 @@ next_task:
 				later_start = 0;
 			} else {
 				/* Started this job, move to next one */
+				_bf_plan_started(job_ptr, now);
 				reject_array_job_id = 0;
 				reject_array_part   = NULL;
 
@@ -1269,6 +2484,9 @@ next_task:
 
 		if (job_ptr->start_time > (sched_start + backfill_window)) {
 			/* Starts too far in the future to worry about */
+			_bf_shape_save(shape, part_ptr, time_limit, min_nodes,
+				       max_nodes, req_nodes,
+				       job_ptr->start_time);
 			if (debug_flags & DEBUG_FLAG_BACKFILL)
 				_dump_job_sched(job_ptr, end_reserve,
 						avail_bitmap);
@@ -1277,10 +2495,12 @@ next_task:
 				/* Can start earlier in different partition */
 				job_ptr->start_time = orig_start_time;
 			}
+			if (job_ptr->start_time != orig_start_time)
+				job_changed(job_ptr, now);
 			continue;
 		}
 
-		if (node_space_recs >= max_backfill_job_cnt) {
+		if (node_space_recs(node_space) >= max_backfill_job_cnt) {
 			if (debug_flags & DEBUG_FLAG_BACKFILL) {
 				info("backfill: table size limit of %u reached",
 				     max_backfill_job_cnt);
@@ -1289,7 +2509,7 @@ next_task:
 		}
 
 		if ((job_ptr->start_time > now) &&
-		    _test_resv_overlap(node_space, avail_bitmap,
+		    node_space_overlap(node_space, avail_bitmap,
 				       start_time, end_reserve)) {
 			/* This job overlaps with an existing reservation for
 			 * job to be backfill scheduled, which the sched
@@ -1308,11 +2528,19 @@ next_task:
 			continue;
 		reject_array_job_id = 0;
 		reject_array_part   = NULL;
+		sched_nodes = bitmap2node_name(avail_bitmap);
+		if (xstrcmp(sched_nodes, job_ptr->sched_nodes))
+			job_changed(job_ptr, now);
 		xfree(job_ptr->sched_nodes);
-		job_ptr->sched_nodes = bitmap2node_name(avail_bitmap);
+		job_ptr->sched_nodes = sched_nodes;
+		_bf_shape_save(shape, part_ptr, time_limit, min_nodes,
+			       max_nodes, req_nodes, job_ptr->start_time);
+		_bf_plan_add(job_ptr, part_ptr, shape, time_limit, min_nodes,
+			     max_nodes, req_nodes, start_time, end_reserve,
+			     avail_bitmap);
 		bit_not(avail_bitmap);
-		_add_reservation(start_time, end_reserve,
-				 avail_bitmap, node_space, &node_space_recs);
+		node_space_reserve(node_space, start_time, end_reserve,
+				   avail_bitmap);
 		if (debug_flags & DEBUG_FLAG_BACKFILL_MAP)
 			_dump_node_space_table(node_space);
 		if ((orig_start_time != 0) &&
@@ -1341,13 +2569,11 @@ next_task:
 	FREE_NULL_BITMAP(exc_core_bitmap);
 	FREE_NULL_BITMAP(resv_bitmap);
 	FREE_NULL_BITMAP(non_cg_bitmap);
+	_bf_eval_purge(NULL);
+	_bf_shape_purge();
+	_bf_plan_end();
 
-	for (i=0; ; ) {
-		FREE_NULL_BITMAP(node_space[i].avail_bitmap);
-		if ((i = node_space[i].next) == 0)
-			break;
-	}
-	xfree(node_space);
+	node_space_destroy(node_space);
 	list_destroy(job_queue);
 	gettimeofday(&bf_time2, NULL);
 	_do_diag_stats(&bf_time1, &bf_time2, yield_sleep);
@@ -1356,6 +2582,16 @@ next_task:
 		info("backfill: completed testing %u(%d) jobs, %s",
 		     slurmctld_diag_stats.bf_last_depth,
 		     job_test_count, TIME_STR);
+		if (bf_shape_hits) {
+			info("backfill: %u jobs bounded by earlier test of "
+			     "same request", bf_shape_hits);
+		}
+		if (bf_threads > 1) {
+			info("backfill: used %u of %u tests made by %d "
+			     "threads in usec=%u", bf_eval_hits,
+			     bf_eval_hits + bf_eval_misses, bf_threads,
+			     bf_eval_usec);
+		}
 	}
 	return rc;
 }
@@ -1381,7 +2617,7 @@ static int _start_job(struct job_record *job_ptr, bitstr_t *resv_bitmap)
 		FREE_NULL_BITMAP(orig_exc_nodes);
 	if (rc == SLURM_SUCCESS) {
 		/* job initiated */
-		last_job_update = time(NULL);
+		job_changed(job_ptr, time(NULL));
 		if (job_ptr->array_task_id == NO_VAL) {
 			info("backfill: Started JobId=%u on %s",
 			     job_ptr->job_id, job_ptr->nodes);
@@ -1426,25 +2662,21 @@ static int _start_job(struct job_record *job_ptr, bitstr_t *resv_bitmap)
  *	Avoid using resources reserved for pending jobs or in resource
  *	reservations */
 static void _reset_job_time_limit(struct job_record *job_ptr, time_t now,
-				  node_space_map_t *node_space)
+				  node_space_t *node_space)
 {
-	int32_t j, resv_delay;
+	int32_t resv_delay;
 	uint32_t orig_time_limit = job_ptr->time_limit;
 	uint32_t new_time_limit;
-
-	for (j=0; ; ) {
-		if ((node_space[j].begin_time != now) &&
-		    (node_space[j].begin_time < job_ptr->end_time) &&
-		    (!bit_super_set(job_ptr->node_bitmap,
-				    node_space[j].avail_bitmap))) {
-			/* Job overlaps pending job's resource reservation */
-			resv_delay = difftime(node_space[j].begin_time, now);
-			resv_delay /= 60;	/* seconds to minutes */
-			if (resv_delay < job_ptr->time_limit)
-				job_ptr->time_limit = resv_delay;
-		}
-		if ((j = node_space[j].next) == 0)
-			break;
+	time_t resv_time;
+
+	resv_time = node_space_conflict(node_space, job_ptr->node_bitmap, now,
+					job_ptr->end_time);
+	if (resv_time) {
+		/* Job overlaps pending job's resource reservation */
+		resv_delay = difftime(resv_time, now);
+		resv_delay /= 60;	/* seconds to minutes */
+		if (resv_delay < job_ptr->time_limit)
+			job_ptr->time_limit = resv_delay;
 	}
 	new_time_limit = MAX(job_ptr->time_min, job_ptr->time_limit);
 	acct_policy_alter_job(job_ptr, new_time_limit);
@@ -1473,123 +2705,3 @@ static bool _more_work (time_t last_backfill_time)
 	pthread_mutex_unlock( &thread_flag_mutex );
 	return rc;
 }
-
-/* Create a reservation for a job in the future */
-static void _add_reservation(uint32_t start_time, uint32_t end_reserve,
-			     bitstr_t *res_bitmap,
-			     node_space_map_t *node_space,
-			     int *node_space_recs)
-{
-	bool placed = false;
-	int i, j;
-
-#if 0	
-	info("add job start:%u end:%u", start_time, end_reserve);
-	for (j = 0; ; ) {
-		info("node start:%u end:%u",
-		     (uint32_t) node_space[j].begin_time,
-		     (uint32_t) node_space[j].end_time);
-		if ((j = node_space[j].next) == 0)
-			break;
-	}
-#endif
-
-	start_time = MAX(start_time, node_space[0].begin_time);
-	for (j = 0; ; ) {
-		if (node_space[j].end_time > start_time) {
-			/* insert start entry record */
-			i = *node_space_recs;
-			node_space[i].begin_time = start_time;
-			node_space[i].end_time = node_space[j].end_time;
-			node_space[j].end_time = start_time;
-			node_space[i].avail_bitmap =
-				bit_copy(node_space[j].avail_bitmap);
-			node_space[i].next = node_space[j].next;
-			node_space[j].next = i;
-			(*node_space_recs)++;
-			placed = true;
-		}
-		if (node_space[j].end_time == start_time) {
-			/* no need to insert new start entry record */
-			placed = true;
-		}
-		if (placed == true) {
-			while ((j = node_space[j].next)) {
-				if (end_reserve < node_space[j].end_time) {
-					/* insert end entry record */
-					i = *node_space_recs;
-					node_space[i].begin_time = end_reserve;
-					node_space[i].end_time = node_space[j].
-								 end_time;
-					node_space[j].end_time = end_reserve;
-					node_space[i].avail_bitmap =
-						bit_copy(node_space[j].
-							 avail_bitmap);
-					node_space[i].next = node_space[j].next;
-					node_space[j].next = i;
-					(*node_space_recs)++;
-					break;
-				}
-				if (end_reserve == node_space[j].end_time) {
-					break;
-				}
-			}
-			break;
-		}
-		if ((j = node_space[j].next) == 0)
-			break;
-	}
-
-	for (j = 0; ; ) {
-		if ((node_space[j].begin_time >= start_time) &&
-		    (node_space[j].end_time <= end_reserve))
-			bit_and(node_space[j].avail_bitmap, res_bitmap);
-		if ((node_space[j].begin_time >= end_reserve) ||
-		    ((j = node_space[j].next) == 0))
-			break;
-	}
-
-	/* Drop records with identical bitmaps (up to one record).
-	 * This can significantly improve performance of the backfill tests. */
-	for (i = 0; ; ) {
-		if ((j = node_space[i].next) == 0)
-			break;
-		if (!bit_equal(node_space[i].avail_bitmap,
-			       node_space[j].avail_bitmap)) {
-			i = j;
-			continue;
-		}
-		node_space[i].end_time = node_space[j].end_time;
-		node_space[i].next = node_space[j].next;
-		FREE_NULL_BITMAP(node_space[j].avail_bitmap);
-		break;
-	}
-}
-
-/*
- * Determine if the resource specification for a new job overlaps with a
- *	reservation that the backfill scheduler has made for a job to be
- *	started in the future.
- * IN use_bitmap - nodes to be allocated
- * IN start_time - start time of job
- * IN end_reserve - end time of job
- */
-static bool _test_resv_overlap(node_space_map_t *node_space,
-			       bitstr_t *use_bitmap, uint32_t start_time,
-			       uint32_t end_reserve)
-{
-	bool overlap = false;
-	int j;
-
-	for (j=0; ; ) {
-		if ((node_space[j].end_time   > start_time) &&
-		    (node_space[j].begin_time < end_reserve) &&
-		    (!bit_super_set(use_bitmap, node_space[j].avail_bitmap))) {
-			overlap = true;
-			break;
-		}
-		if ((j = node_space[j].next) == 0)
-			break;
-	}
-	return overlap;
-}
@@ -50,4 +50,10 @@ extern void stop_backfill_agent(void);
 /* Note that slurm.conf has changed */
 extern void backfill_reconfig(void);
 
+/* Note that a job was allocated resources other than by backfill */
+extern void backfill_job_alloc(struct job_record *job_ptr);
+
+/* Note that a job's resources were released */
+extern void backfill_job_free(struct job_record *job_ptr);
+
 #endif	/* _SLURM_BACKFILL_H */
@@ -132,6 +132,7 @@ slurm_sched_p_schedule( void )
 int
 slurm_sched_p_newalloc( struct job_record *job_ptr )
 {
+	backfill_job_alloc(job_ptr);
 	return SLURM_SUCCESS;
 }
 
@@ -141,6 +142,7 @@ slurm_sched_p_newalloc( struct job_record *job_ptr )
 int
 slurm_sched_p_freealloc( struct job_record *job_ptr )
 {
+	backfill_job_free(job_ptr);
 	return SLURM_SUCCESS;
 }
 
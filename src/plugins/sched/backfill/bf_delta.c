@@ -0,0 +1,211 @@
+/*****************************************************************************\
+ *  bf_delta.c - changes in resources since a backfill plan was made
+ *****************************************************************************
+ *  Copyright (C) 2015 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <stddef.h>
+
+#include "src/common/lhash.h"
+#include "src/common/macros.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmctld/slurmctld.h"
+#include "bf_delta.h"
+
+typedef struct bf_job_end {
+	uint32_t job_id;
+	time_t end_time;
+	bool suspended;
+	struct bf_job_end *next;	/* lhash chain */
+} bf_job_end_t;
+
+struct bf_job_ends {
+	bf_job_end_t *rec;		/* running jobs when last scanned */
+	uint32_t rec_cnt;
+	uint32_t rec_size;
+	lhash_t *hash;			/* records by job ID */
+};
+
+extern void bf_delta_free(void *x)
+{
+	bf_delta_t *delta = (bf_delta_t *) x;
+
+	FREE_NULL_BITMAP(delta->node_bitmap);
+	xfree(delta);
+}
+
+extern void bf_delta_add(List deltas, bool freed, uint32_t job_id,
+			 time_t begin_time, time_t end_time,
+			 bitstr_t *node_bitmap)
+{
+	bf_delta_t *delta;
+
+	if (!deltas || !node_bitmap || (bit_ffs(node_bitmap) == -1) ||
+	    (!freed && (end_time <= begin_time)))
+		return;
+	delta = xmalloc(sizeof(bf_delta_t));
+	delta->freed = freed;
+	delta->job_id = job_id;
+	delta->begin_time = begin_time;
+	delta->end_time = end_time;
+	delta->node_bitmap = bit_copy(node_bitmap);
+	list_append(deltas, delta);
+}
+
+extern bool bf_delta_affects(List deltas, time_t job_start,
+			     time_t start_time, time_t end_time,
+			     bitstr_t *node_bitmap)
+{
+	ListIterator iter;
+	bf_delta_t *delta;
+	bool affected = false;
+
+	iter = list_iterator_create(deltas);
+	while ((delta = (bf_delta_t *) list_next(iter))) {
+		if (delta->freed) {
+			/* The job might start earlier */
+			affected = (delta->begin_time < job_start);
+		} else {
+			/* Reserved nodes might be busy */
+			affected = (delta->begin_time < end_time) &&
+				   (delta->end_time > start_time);
+		}
+		if (affected &&
+		    bit_overlap_any(delta->node_bitmap, node_bitmap))
+			break;
+		affected = false;
+	}
+	list_iterator_destroy(iter);
+
+	return affected;
+}
+
+static uint32_t _job_end_key(void *rec)
+{
+	return ((bf_job_end_t *) rec)->job_id;
+}
+
+static bf_job_end_t *_job_end_find(bf_job_ends_t *ends, uint32_t job_id)
+{
+	bf_job_end_t *rec;
+
+	for (rec = lhash_first(ends->hash, job_id); rec; rec = rec->next) {
+		if (rec->job_id == job_id)
+			return rec;
+	}
+	return NULL;
+}
+
+extern bf_job_ends_t *bf_job_ends_create(void)
+{
+	bf_job_ends_t *ends = xmalloc(sizeof(bf_job_ends_t));
+
+	ends->hash = lhash_create(64, offsetof(bf_job_end_t, next),
+				  _job_end_key);
+	return ends;
+}
+
+extern void bf_job_ends_destroy(bf_job_ends_t *ends)
+{
+	if (!ends)
+		return;
+	lhash_destroy(ends->hash);
+	xfree(ends->rec);
+	xfree(ends);
+}
+
+extern int bf_job_ends_scan(bf_job_ends_t *ends, List jobs, List deltas,
+			    time_t now)
+{
+	ListIterator iter;
+	struct job_record *job_ptr;
+	bf_job_end_t *rec = NULL, *old;
+	uint32_t i, rec_cnt = 0, rec_size = ends->rec_size;
+	int change_cnt = 0;
+
+	if (rec_size)
+		rec = xmalloc(sizeof(bf_job_end_t) * rec_size);
+	iter = list_iterator_create(jobs);
+	while ((job_ptr = (struct job_record *) list_next(iter))) {
+		if ((!IS_JOB_RUNNING(job_ptr) && !IS_JOB_SUSPENDED(job_ptr)) ||
+		    !job_ptr->node_bitmap)
+			continue;
+		if (rec_cnt >= rec_size) {
+			rec_size = MAX(64, rec_size * 2);
+			xrealloc(rec, sizeof(bf_job_end_t) * rec_size);
+		}
+		rec[rec_cnt].job_id    = job_ptr->job_id;
+		rec[rec_cnt].end_time  = job_ptr->end_time;
+		rec[rec_cnt].suspended = IS_JOB_SUSPENDED(job_ptr);
+		rec[rec_cnt].next      = NULL;
+
+		old = _job_end_find(ends, job_ptr->job_id);
+		if (!old) {
+			;	/* Started since, recorded as an allocation */
+		} else if (rec[rec_cnt].suspended != old->suspended) {
+			if (rec[rec_cnt].suspended) {
+				bf_delta_add(deltas, true, 0, now, 0,
+					     job_ptr->node_bitmap);
+			} else {
+				bf_delta_add(deltas, false, 0, now,
+					     job_ptr->end_time,
+					     job_ptr->node_bitmap);
+			}
+			change_cnt++;
+		} else if (rec[rec_cnt].suspended ||
+			   (job_ptr->end_time == old->end_time)) {
+			;	/* No change */
+		} else if (job_ptr->end_time < old->end_time) {
+			bf_delta_add(deltas, true, 0, job_ptr->end_time, 0,
+				     job_ptr->node_bitmap);
+			change_cnt++;
+		} else {
+			bf_delta_add(deltas, false, 0, old->end_time,
+				     job_ptr->end_time, job_ptr->node_bitmap);
+			change_cnt++;
+		}
+		rec_cnt++;
+	}
+	list_iterator_destroy(iter);
+
+	lhash_destroy(ends->hash);
+	xfree(ends->rec);
+	ends->rec = rec;
+	ends->rec_cnt = rec_cnt;
+	ends->rec_size = rec_size;
+	ends->hash = lhash_create(MAX(64, rec_cnt),
+				  offsetof(bf_job_end_t, next), _job_end_key);
+	for (i = 0; i < rec_cnt; i++)
+		lhash_add(ends->hash, &rec[i]);
+
+	return change_cnt;
+}
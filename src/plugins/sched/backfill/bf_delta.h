@@ -0,0 +1,104 @@
+/*****************************************************************************\
+ *  bf_delta.h - changes in resources since a backfill plan was made
+ *****************************************************************************
+ *  Copyright (C) 2015 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _SLURM_BACKFILL_BF_DELTA_H
+#define _SLURM_BACKFILL_BF_DELTA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "src/common/bitstring.h"
+#include "src/common/list.h"
+
+/* Change in resources made after a backfill plan was built, either nodes
+ * freed from begin_time onward or nodes consumed from begin_time to
+ * end_time */
+typedef struct bf_delta {
+	bool freed;
+	uint32_t job_id;		/* job allocated nodes, zero if none */
+	time_t begin_time;
+	time_t end_time;
+	bitstr_t *node_bitmap;
+} bf_delta_t;
+
+/* End time and suspend state of running jobs, see bf_job_ends_scan() */
+typedef struct bf_job_ends bf_job_ends_t;
+
+/* bf_delta_free - free a bf_delta_t, for use as a ListDelF */
+extern void bf_delta_free(void *x);
+
+/*
+ * bf_delta_add - add a change in resources to a list, unless it holds no
+ *	nodes or time
+ * IN node_bitmap - nodes freed or consumed, copied
+ */
+extern void bf_delta_add(List deltas, bool freed, uint32_t job_id,
+			 time_t begin_time, time_t end_time,
+			 bitstr_t *node_bitmap);
+
+/*
+ * bf_delta_affects - test if any change in a list could move a reservation
+ *	of the nodes in node_bitmap from start_time to end_time for a job
+ *	expected to start at job_start: some of its nodes consumed during the
+ *	reservation or freed before the job starts. Nodes freed elsewhere are
+ *	not tested, the job keeps its reservation until the plan is rebuilt.
+ */
+extern bool bf_delta_affects(List deltas, time_t job_start,
+			     time_t start_time, time_t end_time,
+			     bitstr_t *node_bitmap);
+
+/*
+ * bf_job_ends_create - create an empty record of running jobs
+ * RET the record, release using bf_job_ends_destroy()
+ */
+extern bf_job_ends_t *bf_job_ends_create(void);
+
+/* bf_job_ends_destroy - release a record created by bf_job_ends_create() */
+extern void bf_job_ends_destroy(bf_job_ends_t *ends);
+
+/*
+ * bf_job_ends_scan - add to deltas the changes in end time and suspend state
+ *	of running and suspended jobs since the previous scan, which are not
+ *	recorded as an allocation or release of resources. A job suspended or
+ *	ending earlier frees its nodes, a job resumed or ending later
+ *	consumes them. Jobs not seen by the previous scan are skipped.
+ * IN jobs - list of struct job_record
+ * RET the number of changes found
+ */
+extern int bf_job_ends_scan(bf_job_ends_t *ends, List jobs, List deltas,
+			    time_t now);
+
+#endif	/* _SLURM_BACKFILL_BF_DELTA_H */
@@ -0,0 +1,407 @@
+/*****************************************************************************\
+ *  node_space.c - map of nodes available to backfill scheduled jobs over time
+ *****************************************************************************
+ *  Copyright (C) 2015 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <string.h>
+
+#include "src/common/macros.h"
+#include "src/common/xmalloc.h"
+#include "node_space.h"
+
+struct node_space {
+	time_t begin_time;	/* start of the first slice */
+	time_t base_time;	/* begin_time rounded down to resolution */
+	time_t end_time;	/* end of the last slice */
+	uint32_t resolution;
+	int cell_cnt;		/* resolution sized cells in the map */
+	int leaf_cnt;		/* cell_cnt rounded up to a power of two */
+	bitstr_t *init_bitmap;	/* nodes available for the entire map */
+	bitstr_t **avail;	/* per tree node, nodes available for all of its
+				 * cells, NULL if init_bitmap. The root is one,
+				 * the children of i are 2i and 2i+1 and the
+				 * cells are leaf_cnt onward */
+	bitstr_t **pend;	/* per tree node, nodes to clear from its
+				 * children's avail, NULL if none */
+	int *bound;		/* sorted cells beginning a slice, except 0 */
+	int bound_cnt;
+	int bound_size;
+	int *release;		/* sorted cells at which nodes are released */
+	int release_cnt;
+	int release_size;
+};
+
+static int _cell(node_space_t *node_space, time_t when)
+{
+	if (when <= node_space->base_time)
+		return 0;
+	return (when - node_space->base_time) / node_space->resolution;
+}
+
+static time_t _cell_time(node_space_t *node_space, int cell)
+{
+	if (cell == 0)
+		return node_space->begin_time;
+	return node_space->base_time +
+	       ((time_t) cell * node_space->resolution);
+}
+
+/* Add a cell to a sorted array of cells, unless already present */
+static void _cell_add(int **array, int *cnt, int *size, int cell)
+{
+	int lo = 0, hi = *cnt, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if ((*array)[mid] < cell)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if ((lo < *cnt) && ((*array)[lo] == cell))
+		return;
+	if (*cnt >= *size) {
+		*size = MAX(*size * 2, 64);
+		xrealloc(*array, sizeof(int) * *size);
+	}
+	memmove(*array + lo + 1, *array + lo, sizeof(int) * (*cnt - lo));
+	(*array)[lo] = cell;
+	(*cnt)++;
+}
+
+static bitstr_t *_avail(node_space_t *node_space, int inx)
+{
+	if (node_space->avail[inx])
+		return node_space->avail[inx];
+	return node_space->init_bitmap;
+}
+
+/* Return a tree node's bitmap for modification, copying the shared one */
+static bitstr_t *_avail_write(node_space_t *node_space, int inx)
+{
+	if (!node_space->avail[inx])
+		node_space->avail[inx] = bit_copy(node_space->init_bitmap);
+	return node_space->avail[inx];
+}
+
+/* Clear nodes not in res_bitmap from all cells under a tree node */
+static void _and_node(node_space_t *node_space, int inx, bitstr_t *res_bitmap)
+{
+	bit_and(_avail_write(node_space, inx), res_bitmap);
+	if (inx >= node_space->leaf_cnt)
+		return;
+	if (node_space->pend[inx])
+		bit_and(node_space->pend[inx], res_bitmap);
+	else
+		node_space->pend[inx] = bit_copy(res_bitmap);
+}
+
+/* Apply a tree node's pending changes to its children */
+static void _push(node_space_t *node_space, int inx)
+{
+	if (!node_space->pend[inx])
+		return;
+	_and_node(node_space, inx * 2, node_space->pend[inx]);
+	_and_node(node_space, inx * 2 + 1, node_space->pend[inx]);
+	FREE_NULL_BITMAP(node_space->pend[inx]);
+}
+
+/* Clear nodes not in res_bitmap from cells first through last, inclusive,
+ * of the tree node inx which covers cells lo through hi */
+static void _reserve(node_space_t *node_space, int inx, int lo, int hi,
+		     int first, int last, bitstr_t *res_bitmap)
+{
+	int mid;
+	bitstr_t *avail_bitmap;
+
+	if ((last < lo) || (hi < first))
+		return;
+	if ((first <= lo) && (hi <= last)) {
+		_and_node(node_space, inx, res_bitmap);
+		return;
+	}
+	_push(node_space, inx);
+	mid = (lo + hi) / 2;
+	_reserve(node_space, inx * 2, lo, mid, first, last, res_bitmap);
+	_reserve(node_space, inx * 2 + 1, mid + 1, hi, first, last,
+		 res_bitmap);
+	avail_bitmap = _avail_write(node_space, inx);
+	bit_copybits(avail_bitmap, _avail(node_space, inx * 2));
+	bit_and(avail_bitmap, _avail(node_space, inx * 2 + 1));
+}
+
+/* Clear from avail_bitmap nodes not available in cells first through last */
+static void _avail_range(node_space_t *node_space, int inx, int lo, int hi,
+			 int first, int last, bitstr_t *avail_bitmap)
+{
+	int mid;
+
+	if ((last < lo) || (hi < first))
+		return;
+	if ((first <= lo) && (hi <= last)) {
+		bit_and(avail_bitmap, _avail(node_space, inx));
+		return;
+	}
+	/* Changes pending for the children apply to any cell below */
+	if (node_space->pend[inx])
+		bit_and(avail_bitmap, node_space->pend[inx]);
+	mid = (lo + hi) / 2;
+	_avail_range(node_space, inx * 2, lo, mid, first, last, avail_bitmap);
+	_avail_range(node_space, inx * 2 + 1, mid + 1, hi, first, last,
+		     avail_bitmap);
+}
+
+/* Return the first of cells first through last in which some node of
+ * use_bitmap is not available, or -1 if none */
+static int _conflict(node_space_t *node_space, int inx, int lo, int hi,
+		     int first, int last, bitstr_t *use_bitmap)
+{
+	int mid, cell;
+
+	if ((last < lo) || (hi < first))
+		return -1;
+	if (bit_super_set(use_bitmap, _avail(node_space, inx)))
+		return -1;
+	if (inx >= node_space->leaf_cnt)
+		return lo;
+	if (node_space->pend[inx] &&
+	    !bit_super_set(use_bitmap, node_space->pend[inx]))
+		return MAX(first, lo);
+	mid = (lo + hi) / 2;
+	cell = _conflict(node_space, inx * 2, lo, mid, first, last,
+			 use_bitmap);
+	if (cell == -1) {
+		cell = _conflict(node_space, inx * 2 + 1, mid + 1, hi,
+				 first, last, use_bitmap);
+	}
+	return cell;
+}
+
+extern node_space_t *node_space_create(time_t begin_time, time_t end_time,
+				       uint32_t resolution,
+				       bitstr_t *avail_bitmap)
+{
+	node_space_t *node_space = xmalloc(sizeof(node_space_t));
+
+	if (resolution == 0)
+		resolution = 1;
+	if (end_time <= begin_time)
+		end_time = begin_time + 1;
+	node_space->begin_time = begin_time;
+	node_space->base_time = (begin_time / resolution) * resolution;
+	node_space->end_time = end_time;
+	node_space->resolution = resolution;
+	node_space->cell_cnt = (end_time - node_space->base_time +
+				resolution - 1) / resolution;
+	node_space->leaf_cnt = 1;
+	while (node_space->leaf_cnt < node_space->cell_cnt)
+		node_space->leaf_cnt *= 2;
+	node_space->init_bitmap = bit_copy(avail_bitmap);
+	node_space->avail = xmalloc(sizeof(bitstr_t *) *
+				    node_space->leaf_cnt * 2);
+	node_space->pend  = xmalloc(sizeof(bitstr_t *) *
+				    node_space->leaf_cnt);
+
+	return node_space;
+}
+
+extern void node_space_destroy(node_space_t *node_space)
+{
+	int i;
+
+	if (!node_space)
+		return;
+	for (i = 0; i < node_space->leaf_cnt * 2; i++)
+		FREE_NULL_BITMAP(node_space->avail[i]);
+	for (i = 0; i < node_space->leaf_cnt; i++)
+		FREE_NULL_BITMAP(node_space->pend[i]);
+	xfree(node_space->avail);
+	xfree(node_space->pend);
+	xfree(node_space->bound);
+	xfree(node_space->release);
+	FREE_NULL_BITMAP(node_space->init_bitmap);
+	xfree(node_space);
+}
+
+extern void node_space_reserve(node_space_t *node_space, time_t start_time,
+			       time_t end_time, bitstr_t *res_bitmap)
+{
+	int first, last;
+
+	first = _cell(node_space, start_time);
+	if (first >= node_space->cell_cnt)
+		return;
+	if (end_time > start_time)
+		last = MAX(first, _cell(node_space, end_time - 1));
+	else
+		last = first;
+	last = MIN(last, node_space->cell_cnt - 1);
+
+	_reserve(node_space, 1, 0, node_space->leaf_cnt - 1, first, last,
+		 res_bitmap);
+	if (first > 0) {
+		_cell_add(&node_space->bound, &node_space->bound_cnt,
+			  &node_space->bound_size, first);
+	}
+	if (++last < node_space->cell_cnt) {
+		_cell_add(&node_space->bound, &node_space->bound_cnt,
+			  &node_space->bound_size, last);
+		_cell_add(&node_space->release, &node_space->release_cnt,
+			  &node_space->release_size, last);
+	}
+}
+
+extern void node_space_avail(node_space_t *node_space, bitstr_t *avail_bitmap,
+			     time_t start_time, time_t end_time)
+{
+	int first, last;
+
+	first = _cell(node_space, start_time);
+	last = MIN(_cell(node_space, end_time), node_space->cell_cnt - 1);
+	_avail_range(node_space, 1, 0, node_space->leaf_cnt - 1, first, last,
+		     avail_bitmap);
+}
+
+extern time_t node_space_next_window(node_space_t *node_space,
+				     bitstr_t *avail_bitmap, uint32_t node_cnt,
+				     time_t start_time, uint32_t duration)
+{
+	bitstr_t *test_bitmap;
+	time_t test_time, found_time = 0;
+	int i, first, last;
+
+	if (node_space->release_cnt == 0)
+		return found_time;
+	first = _cell(node_space, start_time) + 1;
+	/* Binary search for the first release after start_time */
+	for (i = 0, last = node_space->release_cnt; i < last; ) {
+		int mid = (i + last) / 2;
+		if (node_space->release[mid] < first)
+			i = mid + 1;
+		else
+			last = mid;
+	}
+
+	test_bitmap = bit_alloc(bit_size(avail_bitmap));
+	for ( ; i < node_space->release_cnt; i++) {
+		first = node_space->release[i];
+		test_time = _cell_time(node_space, first);
+		last = MIN(_cell(node_space, test_time + duration),
+			   node_space->cell_cnt - 1);
+		bit_copybits(test_bitmap, avail_bitmap);
+		_avail_range(node_space, 1, 0, node_space->leaf_cnt - 1,
+			     first, last, test_bitmap);
+		if (bit_set_count(test_bitmap) >= (int32_t) node_cnt) {
+			found_time = test_time;
+			break;
+		}
+	}
+	FREE_NULL_BITMAP(test_bitmap);
+
+	return found_time;
+}
+
+extern bool node_space_overlap(node_space_t *node_space, bitstr_t *use_bitmap,
+			       time_t start_time, time_t end_time)
+{
+	int first, last;
+
+	first = _cell(node_space, start_time);
+	if (first >= node_space->cell_cnt)
+		return false;
+	if (end_time > start_time)
+		last = MAX(first, _cell(node_space, end_time - 1));
+	else
+		last = first;
+	last = MIN(last, node_space->cell_cnt - 1);
+
+	return (_conflict(node_space, 1, 0, node_space->leaf_cnt - 1,
+			  first, last, use_bitmap) != -1);
+}
+
+extern time_t node_space_conflict(node_space_t *node_space,
+				  bitstr_t *use_bitmap, time_t start_time,
+				  time_t end_time)
+{
+	int first, last, cell;
+
+	if (end_time <= node_space->base_time)
+		return (time_t) 0;
+	first = _cell(node_space, start_time) + 1;
+	last = MIN(_cell(node_space, end_time - 1), node_space->cell_cnt - 1);
+	cell = _conflict(node_space, 1, 0, node_space->leaf_cnt - 1,
+			 first, last, use_bitmap);
+	if (cell == -1)
+		return (time_t) 0;
+	return _cell_time(node_space, cell);
+}
+
+extern int node_space_recs(node_space_t *node_space)
+{
+	return node_space->bound_cnt + 1;
+}
+
+extern int node_space_walk(node_space_t *node_space,
+			   int (*func)(time_t begin_time, time_t end_time,
+				       bitstr_t *avail_bitmap, void *arg),
+			   void *arg)
+{
+	bitstr_t *slice_bitmap, *cell_bitmap;
+	time_t begin_time;
+	int i, rc = 0;
+
+	slice_bitmap = bit_copy(node_space->init_bitmap);
+	cell_bitmap = bit_alloc(bit_size(node_space->init_bitmap));
+	_avail_range(node_space, 1, 0, node_space->leaf_cnt - 1, 0, 0,
+		     slice_bitmap);
+	begin_time = node_space->begin_time;
+	for (i = 1; (i < node_space->cell_cnt) && (rc == 0); i++) {
+		bit_copybits(cell_bitmap, node_space->init_bitmap);
+		_avail_range(node_space, 1, 0, node_space->leaf_cnt - 1, i, i,
+			     cell_bitmap);
+		if (bit_equal(cell_bitmap, slice_bitmap))
+			continue;
+		rc = (*func)(begin_time, _cell_time(node_space, i),
+			     slice_bitmap, arg);
+		bit_copybits(slice_bitmap, cell_bitmap);
+		begin_time = _cell_time(node_space, i);
+	}
+	if (rc == 0) {
+		rc = (*func)(begin_time, node_space->end_time, slice_bitmap,
+			     arg);
+	}
+	FREE_NULL_BITMAP(slice_bitmap);
+	FREE_NULL_BITMAP(cell_bitmap);
+
+	return rc;
+}
@@ -0,0 +1,130 @@
+/*****************************************************************************\
+ *  node_space.h - map of nodes available to backfill scheduled jobs over time
+ *****************************************************************************
+ *  Copyright (C) 2015 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _SLURM_BACKFILL_NODE_SPACE_H
+#define _SLURM_BACKFILL_NODE_SPACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "src/common/bitstring.h"
+
+/* The node_space map records which nodes are available at each time within
+ * the backfill window. Time is divided into cells of the scheduling
+ * resolution, which are the leaves of a balanced binary tree. Each tree node
+ * holds the nodes available throughout all of its cells, so the nodes
+ * available over any time range are found with a logarithmic number of bitmap
+ * operations rather than by scanning every reservation. Tree nodes share the
+ * initial bitmap until a reservation first changes them.
+ *
+ * The functions which only read the map may be called from several threads
+ * at once. */
+typedef struct node_space node_space_t;
+
+/*
+ * node_space_create - create a node_space map
+ * IN begin_time - start of the map, normally the start of scheduling
+ * IN end_time - end of the map, the end of the backfill window
+ * IN resolution - time resolution of reservations in seconds
+ * IN avail_bitmap - nodes available for the entire map, copied
+ * RET the map, release using node_space_destroy()
+ */
+extern node_space_t *node_space_create(time_t begin_time, time_t end_time,
+				       uint32_t resolution,
+				       bitstr_t *avail_bitmap);
+
+/* node_space_destroy - release a map created by node_space_create() */
+extern void node_space_destroy(node_space_t *node_space);
+
+/*
+ * node_space_reserve - reserve nodes for a job to be started in the future
+ * IN start_time - start of the reservation, moved to the start of the map if
+ *	earlier. Reservations shorter than the map's resolution still hold
+ *	their nodes for one full resolution period
+ * IN end_time - end of the reservation
+ * IN res_bitmap - nodes which remain available, all others are reserved
+ */
+extern void node_space_reserve(node_space_t *node_space, time_t start_time,
+			       time_t end_time, bitstr_t *res_bitmap);
+
+/*
+ * node_space_avail - clear from avail_bitmap the nodes reserved at any time
+ *	between start_time and end_time, inclusive
+ */
+extern void node_space_avail(node_space_t *node_space, bitstr_t *avail_bitmap,
+			     time_t start_time, time_t end_time);
+
+/*
+ * node_space_next_window - find the earliest time after start_time at which
+ *	node_cnt of the nodes in avail_bitmap are available for duration
+ *	seconds. Only times at which reserved nodes are released are tested.
+ * RET the time found or zero if none within the map
+ */
+extern time_t node_space_next_window(node_space_t *node_space,
+				     bitstr_t *avail_bitmap, uint32_t node_cnt,
+				     time_t start_time, uint32_t duration);
+
+/*
+ * node_space_overlap - test if any of the nodes in use_bitmap are reserved at
+ *	any time from start_time up to end_time
+ */
+extern bool node_space_overlap(node_space_t *node_space, bitstr_t *use_bitmap,
+			       time_t start_time, time_t end_time);
+
+/*
+ * node_space_conflict - find the first time after start_time and before
+ *	end_time at which any node in use_bitmap is reserved
+ * RET the time found or zero if none
+ */
+extern time_t node_space_conflict(node_space_t *node_space,
+				  bitstr_t *use_bitmap, time_t start_time,
+				  time_t end_time);
+
+/* node_space_recs - number of time slices in the map, counting a slice at
+ *	each time at which a reservation begins or ends */
+extern int node_space_recs(node_space_t *node_space);
+
+/*
+ * node_space_walk - call func for each time slice in the map, in time order.
+ *	Adjacent slices have different available nodes.
+ * RET the first non-zero value returned by func, or zero
+ */
+extern int node_space_walk(node_space_t *node_space,
+			   int (*func)(time_t begin_time, time_t end_time,
+				       bitstr_t *avail_bitmap, void *arg),
+			   void *arg);
+
+#endif	/* _SLURM_BACKFILL_NODE_SPACE_H */
@@ -215,7 +215,7 @@ static void _compute_start_times(void)
 				       preemptee_candidates, NULL,
 				       exc_core_bitmap);
 		if (rc == SLURM_SUCCESS) {
-			last_job_update = now;
+			job_changed(job_ptr, now);
 			if (job_ptr->time_limit == INFINITE)
 				time_limit = 365 * 24 * 60 * 60;
 			else if (job_ptr->time_limit != NO_VAL)
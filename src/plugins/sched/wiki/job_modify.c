@@ -96,7 +96,8 @@ static int	_job_modify(uint32_t jobid, char *bank_ptr,
 		job_ptr->end_time = job_ptr->end_time +
 				((job_ptr->time_limit -
 				  old_time) * 60);
-		last_job_update = time(NULL);
+		job_changed(job_ptr, time(NULL));
+		queue_job_time_check(job_ptr);
 	}
 
 	if (bank_ptr) {
@@ -182,7 +183,7 @@ host_fini:	if (rc) {
 		xfree(job_ptr->partition);
 		job_ptr->partition = xstrdup(part_name_ptr);
 		job_ptr->part_ptr = part_ptr;
-		last_job_update = time(NULL);
+		job_changed(job_ptr, time(NULL));
 		update_accounting = true;
 	}
 	if (new_node_cnt) {
@@ -193,7 +194,7 @@ host_fini:	if (rc) {
 				job_ptr->details->max_nodes = new_node_cnt;
 			info("wiki: change job %u min_nodes to %u",
 				jobid, new_node_cnt);
-			last_job_update = time(NULL);
+			job_changed(job_ptr, time(NULL));
 			update_accounting = true;
 		} else {
 			error("wiki: MODIFYJOB node count of non-pending "
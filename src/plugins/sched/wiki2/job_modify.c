@@ -85,7 +85,7 @@ static int	_job_modify(uint32_t jobid, char *bank_ptr,
 		info("wiki: change job %u comment %s", jobid, comment_ptr);
 		xfree(job_ptr->comment);
 		job_ptr->comment = xstrdup(comment_ptr);
-		last_job_update = now;
+		job_changed(job_ptr, now);
 	}
 
 	if (depend_ptr) {
@@ -191,7 +191,8 @@ static int	_job_modify(uint32_t jobid, char *bank_ptr,
 		job_ptr->end_time = job_ptr->end_time +
 				((job_ptr->time_limit -
 				  old_time) * 60);
-		last_job_update = now;
+		job_changed(job_ptr, now);
+		queue_job_time_check(job_ptr);
 	}
 
 	if (bank_ptr &&
@@ -204,7 +205,7 @@ static int	_job_modify(uint32_t jobid, char *bank_ptr,
 			info("wiki: change job %u features to %s",
 				jobid, feature_ptr);
 			job_ptr->details->features = xstrdup(feature_ptr);
-			last_job_update = now;
+			job_changed(job_ptr, now);
 		} else {
 			error("wiki: MODIFYJOB features of non-pending "
 				"job %u", jobid);
@@ -219,7 +220,7 @@ static int	_job_modify(uint32_t jobid, char *bank_ptr,
 			info("wiki: change job %u begin time to %u",
 				jobid, begin_time);
 			job_ptr->details->begin_time = begin_time;
-			last_job_update = now;
+			job_changed(job_ptr, now);
 			update_accounting = true;
 		} else {
 			error("wiki: MODIFYJOB begin_time of non-pending "
@@ -233,7 +234,7 @@ static int	_job_modify(uint32_t jobid, char *bank_ptr,
 			info("wiki: change job %u name %s", jobid, name_ptr);
 			xfree(job_ptr->name);
 			job_ptr->name = xstrdup(name_ptr);
-			last_job_update = now;
+			job_changed(job_ptr, now);
 			update_accounting = true;
 		} else {
 			error("wiki: MODIFYJOB name of non-pending job %u",
@@ -318,7 +319,7 @@ host_fini:	if (rc) {
 		xfree(job_ptr->partition);
 		job_ptr->partition = xstrdup(part_name_ptr);
 		job_ptr->part_ptr = part_ptr;
-		last_job_update = now;
+		job_changed(job_ptr, now);
 		update_accounting = true;
 	}
 
@@ -372,7 +373,7 @@ host_fini:	if (rc) {
 					    SELECT_JOBDATA_GEOMETRY,
 					    geometry);
 #endif
-		last_job_update = now;
+		job_changed(job_ptr, now);
 		update_accounting = true;
 	}
 
@@ -161,7 +161,7 @@ static void _sync_agent(bg_action_t *bg_action_ptr, bg_record_t *bg_record)
 	if (bg_record->state == BG_BLOCK_INITED) {
 		int sync_user_rc;
 		job_ptr->job_state &= (~JOB_CONFIGURING);
-		last_job_update = time(NULL);
+		job_changed(job_ptr, time(NULL));
 		/* Just in case reset the boot flags */
 		bg_record->boot_state = 0;
 		bg_record->boot_count = 0;
@@ -570,7 +570,7 @@ no_reboot:
 			NO_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK };
 		lock_slurmctld(job_write_lock);
 		bg_action_ptr->job_ptr->job_state &= (~JOB_CONFIGURING);
-		last_job_update = time(NULL);
+		job_changed(bg_action_ptr->job_ptr, time(NULL));
 		unlock_slurmctld(job_write_lock);
 	}
 
@@ -296,7 +296,7 @@ extern int select_nodeinfo_set_all(void)
 	last_set_all = last_bg_update;
 
 	/* set this here so we know things have changed */
-	last_node_update = time(NULL);
+	all_nodes_changed(time(NULL));
 
 	slurm_mutex_lock(&block_state_mutex);
 	for (i=0; i<node_record_count; i++) {
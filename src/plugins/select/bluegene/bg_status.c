@@ -234,7 +234,7 @@ nochange_state:
 				       bg_record->bg_block_id);
 				bg_record->job_ptr->job_state |=
 					JOB_CONFIGURING;
-				last_job_update = time(NULL);
+				job_changed(bg_record->job_ptr, time(NULL));
 			} else if (bg_record->job_list
 				   && list_count(bg_record->job_list)) {
 				struct job_record *job_ptr;
@@ -254,7 +254,7 @@ nochange_state:
 					job_ptr->job_state |= JOB_CONFIGURING;
 				}
 				list_iterator_destroy(job_itr);
-				last_job_update = time(NULL);
+				all_jobs_changed(time(NULL));
 			}
 			break;
 		case BG_BLOCK_FREE:
@@ -300,7 +300,7 @@ nochange_state:
 			    && IS_JOB_CONFIGURING(bg_record->job_ptr)) {
 				bg_record->job_ptr->job_state &=
 					(~JOB_CONFIGURING);
-				last_job_update = time(NULL);
+				job_changed(bg_record->job_ptr, time(NULL));
 			} else if (bg_record->job_list
 				   && list_count(bg_record->job_list)) {
 				struct job_record *job_ptr;
@@ -321,7 +321,7 @@ nochange_state:
 						(~JOB_CONFIGURING);
 				}
 				list_iterator_destroy(job_itr);
-				last_job_update = time(NULL);
+				all_jobs_changed(time(NULL));
 			}
 
 			bg_record->boot_state = 0;
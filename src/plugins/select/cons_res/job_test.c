@@ -100,6 +100,7 @@
 #    include <inttypes.h>
 #  endif
 #endif
+#include <string.h>
 #include <time.h>
 
 #include "dist_tasks.h"
@@ -1565,7 +1566,7 @@ static int _eval_nodes_topo(struct job_record *job_ptr, bitstr_t *bitmap,
 		bit_or(avail_nodes_bitmap, switches_bitmap[i]);
 		switches_node_cnt[i] = bit_set_count(switches_bitmap[i]);
 		if (req_nodes_bitmap &&
-		    bit_overlap(req_nodes_bitmap, switches_bitmap[i])) {
+		    bit_overlap_any(req_nodes_bitmap, switches_bitmap[i])) {
 			switches_required[i] = 1;
 		}
 	}
@@ -2206,7 +2207,8 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 	int32_t build_cnt;
 	job_resources_t *job_res;
 	struct job_details *details_ptr;
-	struct part_res_record *p_ptr, *jp_ptr;
+	struct part_res_record *p_ptr, *jp_ptr, sort_part;
+	struct part_row_data *sort_rows = NULL;
 	uint16_t *cpu_count;
 
 	if (gang_mode == -1) {
@@ -2371,9 +2373,7 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 		bit_fmt(str, (sizeof(str) - 1), exc_core_bitmap);
 		debug2("excluding cores reserved: %s", str);
 #endif
-		bit_not(exc_core_bitmap);
-		bit_and(free_cores, exc_core_bitmap);
-		bit_not(exc_core_bitmap);
+		bit_and_not(free_cores, exc_core_bitmap);
 	}
 
 	/* remove all existing allocations from free_cores */
@@ -2436,9 +2436,7 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 	bit_copybits(free_cores, avail_cores);
 
 	if (exc_core_bitmap) {
-		bit_not(exc_core_bitmap);
-		bit_and(free_cores, exc_core_bitmap);
-		bit_not(exc_core_bitmap);
+		bit_and_not(free_cores, exc_core_bitmap);
 	}
 
 	for (jp_ptr = cr_part_ptr; jp_ptr; jp_ptr = jp_ptr->next) {
@@ -2569,6 +2567,18 @@ extern int cr_job_test(struct job_record *job_ptr, bitstr_t *node_bitmap,
 		goto alloc_job;
 	}
 
+	if (mode == SELECT_MODE_WILL_RUN) {
+		/* The backfill scheduler may run WILL_RUN tests of different
+		 * jobs concurrently with the live partition records, so sort
+		 * a copy of the row array rather than the rows themselves */
+		sort_part = *jp_ptr;
+		sort_rows = xmalloc(sizeof(struct part_row_data) *
+				    jp_ptr->num_rows);
+		memcpy(sort_rows, jp_ptr->row,
+		       sizeof(struct part_row_data) * jp_ptr->num_rows);
+		sort_part.row = sort_rows;
+		jp_ptr = &sort_part;
+	}
 	cr_sort_part_rows(jp_ptr);
 	c = jp_ptr->num_rows;
 	if (job_node_req != NODE_CR_AVAILABLE)
@@ -2642,6 +2652,7 @@ alloc_job:
 	FREE_NULL_BITMAP(avail_cores);
 	FREE_NULL_BITMAP(tmpcore);
 	FREE_NULL_BITMAP(part_core_map);
+	xfree(sort_rows);
 	if ((!cpu_count) || (!job_ptr->best_switch)) {
 		/* we were sent here to cleanup and exit */
 		FREE_NULL_BITMAP(free_cores);
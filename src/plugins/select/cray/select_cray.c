@@ -1943,7 +1943,7 @@ extern int select_p_select_nodeinfo_set_all(void)
 	last_set_all = last_npc_update;
 
 	/* set this here so we know things have changed */
-	last_node_update = time(NULL);
+	all_nodes_changed(time(NULL));
 
 	slurm_mutex_lock(&blade_mutex);
 	/* clear all marks */
@@ -182,8 +182,48 @@ static void
 _load_job_records (void)
 {
 	int error_code;
+	job_info_filter_t filter;
+	uint16_t states[] = { JOB_PENDING, JOB_RUNNING, JOB_SUSPENDED };
+	int i;
+
+	/* Let slurmctld discard jobs which can not be cancelled. If job IDs
+	 * are specified, the other options are applied locally so that
+	 * _filter_job_records() can still identify partial job arrays. */
+	slurm_init_job_info_filter(&filter);
+	filter.field_mask = 0;	/* No optional fields are used */
+	if (opt.job_cnt) {
+		filter.job_id_cnt = opt.job_cnt;
+		filter.job_ids = xmalloc(sizeof(uint32_t) * opt.job_cnt);
+		for (i = 0; i < opt.job_cnt; i++)
+			filter.job_ids[i] = opt.job_id[i];
+	} else {
+		filter.accounts = xstrdup(opt.account);
+		filter.partitions = xstrdup(opt.partition);
+		filter.reservations = xstrdup(opt.reservation);
+		if (opt.user_name) {
+			filter.user_id_cnt = 1;
+			filter.user_ids = xmalloc(sizeof(uint32_t));
+			filter.user_ids[0] = opt.user_id;
+		}
+		if (opt.state != JOB_END) {
+			filter.state_cnt = 1;
+			filter.states = xmalloc(sizeof(uint16_t));
+			filter.states[0] = opt.state;
+		} else {
+			filter.state_cnt = sizeof(states) / sizeof(uint16_t);
+			filter.states = xmalloc(sizeof(states));
+			memcpy(filter.states, states, sizeof(states));
+		}
+	}
 
-	error_code = slurm_load_jobs ((time_t) NULL, &job_buffer_ptr, 1);
+	error_code = slurm_load_jobs_filter((time_t) NULL, &job_buffer_ptr, 1,
+					    &filter);
+	xfree(filter.accounts);
+	xfree(filter.job_ids);
+	xfree(filter.partitions);
+	xfree(filter.reservations);
+	xfree(filter.states);
+	xfree(filter.user_ids);
 
 	if (error_code) {
 		slurm_perror ("slurm_load_jobs error");
@@ -230,9 +270,9 @@ _verify_job_ids (void)
 				break;
 		}
 		jp = &job_ptr[i];
-		if (((IS_JOB_FINISHED(jp)) ||
-		     (i >= job_buffer_ptr->record_count)) &&
-		     (job_ptr[i].array_task_id == NO_VAL) &&
+		if (((i >= job_buffer_ptr->record_count) ||
+		     ((IS_JOB_FINISHED(jp)) &&
+		      (jp->array_task_id == NO_VAL))) &&
 		     (opt.verbose >= 0)) {
 			if (opt.step_id[j] == SLURM_BATCH_SCRIPT)
 				error("Kill job error on job id %u: %s",
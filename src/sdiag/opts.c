@@ -74,6 +74,7 @@ extern void parse_command_line(int argc, char *argv[])
 	static struct option long_options[] = {
 		{"all",		no_argument,	0,	'a'},
 		{"help",	no_argument,	0,	'h'},
+		{"log-locks",	no_argument,	0,	'l'},
 		{"reset",	no_argument,	0,	'r'},
 		{"sort-by-id",	no_argument,	0,	'i'},
 		{"sort-by-time",no_argument,	0,	't'},
@@ -83,7 +84,7 @@ extern void parse_command_line(int argc, char *argv[])
 		{NULL,		0,		0,	0}
 	};
 
-	while ((opt_char = getopt_long(argc, argv, "ahirtTV", long_options,
+	while ((opt_char = getopt_long(argc, argv, "ahilrtTV", long_options,
 				       &option_index)) != -1) {
 		switch (opt_char) {
 			case (int)'a':
@@ -96,6 +97,9 @@ extern void parse_command_line(int argc, char *argv[])
 			case (int)'i':
 				sort_by_id = true;
 				break;
+			case (int)'l':
+				sdiag_param = STAT_COMMAND_LOG_LOCKS;
+				break;
 			case (int)'r':
 				sdiag_param = STAT_COMMAND_RESET;
 				break;
@@ -120,7 +124,7 @@ extern void parse_command_line(int argc, char *argv[])
 
 static void _usage( void )
 {
-	printf("\nUsage: sdiag [-ar] \n");
+	printf("\nUsage: sdiag [-alr] \n");
 }
 
 static void _help( void )
@@ -128,6 +132,7 @@ static void _help( void )
 	printf ("\
 Usage: sdiag [OPTIONS]\n\
   -a              all statistics\n\
+  -l              write lock statistics to the slurmctld log\n\
   -r              reset statistics\n\
 \nHelp options:\n\
   --help          show this help message\n\
@@ -50,6 +50,8 @@
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
+#define LOCK_SITE_PRINT_MAX 20	/* lock call sites reported */
+
 /********************
  * Global Variables *
  ********************/
@@ -62,6 +64,9 @@ stats_info_response_msg_t *buf;
 uint32_t *rpc_type_ave_time = NULL, *rpc_user_ave_time = NULL;
 
 static int  _print_stats(void);
+static char *_lock_type_str(int lock_type);
+static char *_rpc_class_str(int rpc_class);
+static char *_rpc_phase_str(int phase);
 static void _sort_rpc(void);
 
 stats_info_request_msg_t req;
@@ -75,7 +80,14 @@ int main(int argc, char *argv[])
 	slurm_conf_init(NULL);
 	parse_command_line(argc, argv);
 
-	if (sdiag_param == STAT_COMMAND_RESET) {
+	if (sdiag_param == STAT_COMMAND_LOG_LOCKS) {
+		req.command_id = STAT_COMMAND_LOG_LOCKS;
+		rc = slurm_reset_statistics((stats_info_request_msg_t *)&req);
+		if (rc == SLURM_SUCCESS)
+			printf("Lock statistics written to slurmctld log\n");
+		else
+			slurm_perror("slurm_reset_statistics");
+	} else if (sdiag_param == STAT_COMMAND_RESET) {
 		req.command_id = STAT_COMMAND_RESET;
 		rc = slurm_reset_statistics((stats_info_request_msg_t *)&req);
 		if (rc == SLURM_SUCCESS)
@@ -104,7 +116,7 @@ int main(int argc, char *argv[])
 
 static int _print_stats(void)
 {
-	int i;
+	int i, j, k;
 
 	if (!buf) {
 		printf("No data available. Probably slurmctld is not working\n");
@@ -172,6 +184,74 @@ static int _print_stats(void)
 		       buf->bf_queue_len_sum / buf->bf_cycle_counter);
 	}
 
+	if (buf->rpc_worker_cnt) {
+		printf("\nRPC queue statistics (microseconds)\n");
+		printf("\tWorker threads:  %u (busy: %u)\n",
+		       buf->rpc_worker_cnt, buf->rpc_worker_busy);
+		printf("\tQueue depth:     %u (max: %u, limit: %u)\n",
+		       buf->rpc_queue_depth, buf->rpc_queue_depth_max,
+		       buf->rpc_queue_limit);
+		for (i = 0; i < buf->rpc_queue_class_cnt; i++) {
+			uint32_t ave_wait = 0;
+			if (buf->rpc_queue_cnt[i]) {
+				ave_wait = buf->rpc_queue_wait_sum[i] /
+					   buf->rpc_queue_cnt[i];
+			}
+			printf("\t%-8s priority count:%-8u "
+			       "ave_wait:%-8u max_wait:%u\n",
+			       _rpc_class_str(i), buf->rpc_queue_cnt[i],
+			       ave_wait, buf->rpc_queue_wait_max[i]);
+		}
+	}
+
+	if (buf->lock_stat_size) {
+		printf("\nLock statistics (microseconds)\n");
+		for (i = 0; i < buf->lock_stat_size; i++) {
+			if (buf->lock_cnt[i] == 0)
+				continue;
+			printf("\t%-9s %-5s count:%u\n",
+			       _lock_type_str(i / 2), (i % 2) ? "write" : "read",
+			       buf->lock_cnt[i]);
+			printf("\t\twait total:%-12"PRIu64" p50:%-8u p99:%-8u "
+			       "p999:%-8u max:%u\n",
+			       buf->lock_wait_sum[i], buf->lock_wait_p50[i],
+			       buf->lock_wait_p99[i], buf->lock_wait_p999[i],
+			       buf->lock_wait_max[i]);
+			printf("\t\thold total:%-12"PRIu64" p50:%-8u p99:%-8u "
+			       "p999:%-8u max:%u\n",
+			       buf->lock_hold_sum[i], buf->lock_hold_p50[i],
+			       buf->lock_hold_p99[i], buf->lock_hold_p999[i],
+			       buf->lock_hold_max[i]);
+		}
+	}
+	if (buf->lock_site_size) {
+		/* Sites are sorted by total wait time */
+		printf("\nLock statistics by call site (top %d by wait time)\n",
+		       LOCK_SITE_PRINT_MAX);
+	}
+	for (i = 0; (i < buf->lock_site_size) && (i < LOCK_SITE_PRINT_MAX);
+	     i++) {
+		j = buf->lock_site_lock[i];
+		printf("\t%-32s %-9s %-5s count:%-8u "
+		       "wait_total:%-12"PRIu64" wait_max:%-8u "
+		       "hold_total:%-12"PRIu64" hold_max:%u\n",
+		       buf->lock_site_name[i], _lock_type_str(j / 2),
+		       (j % 2) ? "write" : "read", buf->lock_site_cnt[i],
+		       buf->lock_site_wait_sum[i], buf->lock_site_wait_max[i],
+		       buf->lock_site_hold_sum[i], buf->lock_site_hold_max[i]);
+	}
+
+	if (buf->buf_pool_hits || buf->buf_pool_misses || buf->buf_pool_cnt) {
+		uint64_t allocs = buf->buf_pool_hits + buf->buf_pool_misses;
+		printf("\nMessage buffer pool\n");
+		printf("\tHits:           %"PRIu64"\n", buf->buf_pool_hits);
+		printf("\tMisses:         %"PRIu64"\n", buf->buf_pool_misses);
+		printf("\tHit rate:       %.1f%%\n", allocs ?
+		       (100.0 * buf->buf_pool_hits / allocs) : 0.0);
+		printf("\tBuffers:        %u\n", buf->buf_pool_cnt);
+		printf("\tBytes retained: %"PRIu64"\n", buf->buf_pool_bytes);
+	}
+
 	printf("\nRemote Procedure Call statistics by message type\n");
 	for (i = 0; i < buf->rpc_type_size; i++) {
 		printf("\t%-40s(%5u) count:%-6u "
@@ -181,6 +261,24 @@ static int _print_stats(void)
 		       rpc_type_ave_time[i], buf->rpc_type_time[i]);
 	}
 
+	if (buf->rpc_lat_size) {
+		printf("\nRemote Procedure Call latency by message type "
+		       "(microseconds)\n");
+	}
+	for (i = 0; i < buf->rpc_lat_size; i++) {
+		printf("\t%-40s(%5u)\n",
+		       rpc_num2string(buf->rpc_lat_type_id[i]),
+		       buf->rpc_lat_type_id[i]);
+		for (j = 0; j < buf->rpc_lat_phase_cnt; j++) {
+			k = (i * buf->rpc_lat_phase_cnt) + j;
+			printf("\t\t%-10s p50:%-8u p99:%-8u "
+			       "p999:%-8u max:%u\n",
+			       _rpc_phase_str(j), buf->rpc_lat_p50[k],
+			       buf->rpc_lat_p99[k], buf->rpc_lat_p999[k],
+			       buf->rpc_lat_max[k]);
+		}
+	}
+
 	printf("\nRemote Procedure Call statistics by user\n");
 	for (i = 0; i < buf->rpc_user_size; i++) {
 		if (i == 0)
@@ -195,6 +293,50 @@ static int _print_stats(void)
 	return 0;
 }
 
+/* Names of the slurmctld RPC queue priority classes, in priority order */
+static char *_rpc_class_str(int rpc_class)
+{
+	switch (rpc_class) {
+	case 0:
+		return "High";
+	case 1:
+		return "Normal";
+	case 2:
+		return "Low";
+	}
+	return "Unknown";
+}
+
+/* Names of the slurmctld locks, in the order reported */
+static char *_lock_type_str(int lock_type)
+{
+	switch (lock_type) {
+	case 0:
+		return "Config";
+	case 1:
+		return "Job";
+	case 2:
+		return "Node";
+	case 3:
+		return "Partition";
+	}
+	return "Unknown";
+}
+
+/* Names of the phases in which slurmctld RPC latency is recorded */
+static char *_rpc_phase_str(int phase)
+{
+	switch (phase) {
+	case 0:
+		return "lock_wait";
+	case 1:
+		return "process";
+	case 2:
+		return "send";
+	}
+	return "unknown";
+}
+
 static void _sort_rpc(void)
 {
 	int i, j;
@@ -86,6 +86,7 @@ static bool _match_node_data(sinfo_data_t *sinfo_ptr,
 static bool _match_part_data(sinfo_data_t *sinfo_ptr,
 			     partition_info_t* part_ptr);
 static int  _multi_cluster(List clusters);
+static node_info_filter_t *_build_node_filter(void);
 static int  _query_server(partition_info_msg_t ** part_pptr,
 			  node_info_msg_t ** node_pptr,
 			  block_info_msg_t ** block_pptr,
@@ -116,6 +117,10 @@ int main(int argc, char *argv[])
 		log_alter(opts, SYSLOG_FACILITY_USER, NULL);
 	}
 
+	/* Keep one connection to the controller between iterations */
+	if (params.iterate && !params.clusters)
+		(void) slurm_open_session();
+
 	while (1) {
 		if ((!params.no_header) &&
 		    (params.iterate || params.verbose || params.long_output))
@@ -236,6 +241,46 @@ static int _reservation_report(reserve_info_msg_t *resv_ptr)
 	return SLURM_SUCCESS;
 }
 
+/*
+ * _build_node_filter - build a filter so that the controller only returns
+ *	fields which may be reported and names only for nodes which may be
+ *	reported. Node states are matched locally, see _filter_out().
+ */
+static node_info_filter_t *_build_node_filter(void)
+{
+	static node_info_filter_t *filter = NULL;
+
+	if (filter)
+		return filter;
+
+	filter = xmalloc(sizeof(node_info_filter_t));
+	slurm_init_node_info_filter(filter);
+	if (params.nodes)
+		filter->nodes = xstrdup(params.nodes);
+	if (params.partition)
+		filter->partitions = xstrdup(params.partition);
+
+	/* User specified sort order may use any field */
+	if (params.sort)
+		return filter;
+
+	filter->field_mask = 0;
+	if (params.match_flags.features_flag)
+		filter->field_mask |= NODE_FIELD_FEATURES;
+	if (params.match_flags.gres_flag)
+		filter->field_mask |= NODE_FIELD_GRES;
+	if (params.match_flags.hostnames_flag)
+		filter->field_mask |= NODE_FIELD_HOSTNAME;
+	if (params.match_flags.node_addr_flag)
+		filter->field_mask |= NODE_FIELD_NODE_ADDR;
+	if (params.match_flags.reason_flag)
+		filter->field_mask |= NODE_FIELD_REASON;
+	if (params.match_flags.version_flag)
+		filter->field_mask |= NODE_FIELD_VERSION;
+
+	return filter;
+}
+
 /*
  * _query_server - download the current server state
  * part_pptr IN/OUT - partition information message
@@ -296,8 +341,10 @@ _query_server(partition_info_msg_t ** part_pptr,
 							    params.nodes,
 							    show_flags);
 		} else {
-			error_code = slurm_load_node(old_node_ptr->last_update,
-						     &new_node_ptr, show_flags);
+			error_code = slurm_load_node_filter(
+						old_node_ptr->last_update,
+						&new_node_ptr, show_flags,
+						_build_node_filter());
 		}
 		if (error_code == SLURM_SUCCESS)
 			slurm_free_node_info_msg(old_node_ptr);
@@ -309,8 +356,9 @@ _query_server(partition_info_msg_t ** part_pptr,
 		error_code = slurm_load_node_single(&new_node_ptr, params.nodes,
 						    show_flags);
 	} else {
-		error_code = slurm_load_node((time_t) NULL, &new_node_ptr,
-					     show_flags);
+		error_code = slurm_load_node_filter((time_t) NULL,
+						    &new_node_ptr, show_flags,
+						    _build_node_filter());
 	}
 
 	if (error_code) {
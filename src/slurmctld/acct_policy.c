@@ -2171,7 +2171,7 @@ extern int acct_policy_update_pending_job(struct job_record *job_ptr)
 	}
 
 	if (update_accounting) {
-		last_job_update = time(NULL);
+		job_changed(job_ptr, time(NULL));
 		debug("limits changed for job %u: updating accounting",
 		      job_ptr->job_id);
 		if (details_ptr->begin_time) {
@@ -2232,7 +2232,7 @@ extern bool acct_policy_job_time_out(struct job_record *job_ptr)
 
 		if ((qos->grp_cpu_mins != (uint64_t)INFINITE)
 		    && (usage_mins >= qos->grp_cpu_mins)) {
-			last_job_update = now;
+			job_changed(job_ptr, now);
 			info("Job %u timed out, "
 			     "the job is at or exceeds QOS %s's "
 			     "group max cpu minutes of %"PRIu64" "
@@ -2247,7 +2247,7 @@ extern bool acct_policy_job_time_out(struct job_record *job_ptr)
 
 		if ((qos->grp_wall != INFINITE)
 		    && (wall_mins >= qos->grp_wall)) {
-			last_job_update = now;
+			job_changed(job_ptr, now);
 			info("Job %u timed out, "
 			     "the job is at or exceeds QOS %s's "
 			     "group wall limit of %u with %u",
@@ -2260,7 +2260,7 @@ extern bool acct_policy_job_time_out(struct job_record *job_ptr)
 
 		if ((qos->max_cpu_mins_pj != (uint64_t)INFINITE)
 		    && (job_cpu_usage_mins >= qos->max_cpu_mins_pj)) {
-			last_job_update = now;
+			job_changed(job_ptr, now);
 			info("Job %u timed out, "
 			     "the job is at or exceeds QOS %s's "
 			     "max cpu minutes of %"PRIu64" "
@@ -2336,3 +2336,82 @@ job_failed:
 
 	return false;
 }
+
+/* Return when a job running for run_secs already, on the given count of
+ * CPUs, reaches cpu_mins, zero if never */
+static time_t _cpu_mins_due(time_t now, time_t run_secs, uint32_t cpus,
+			    uint64_t cpu_mins)
+{
+	uint64_t limit_secs;
+
+	if ((cpu_mins == (uint64_t) INFINITE) || (cpus == 0))
+		return (time_t) 0;
+	/* acct_policy_job_time_out() counts whole minutes of run time */
+	limit_secs = ((cpu_mins + cpus - 1) / cpus) * 60;
+	if (limit_secs <= run_secs)
+		return now;
+	return now + (limit_secs - run_secs);
+}
+
+/*
+ * acct_policy_job_time_out_due - Return when acct_policy_job_time_out()
+ *	next needs to test a running job, zero if never. Group usage and
+ *	wall time only change when the priority plugin updates usage, each
+ *	PriorityCalcPeriod.
+ */
+extern time_t acct_policy_job_time_out_due(struct job_record *job_ptr,
+					   time_t now)
+{
+	slurmdb_qos_rec_t *qos = NULL;
+	slurmdb_assoc_rec_t *assoc = NULL;
+	assoc_mgr_lock_t locks = { READ_LOCK, NO_LOCK,
+				   READ_LOCK, NO_LOCK, NO_LOCK };
+	time_t due = 0, run_secs, limit_due;
+	bool grp_limit = false;
+
+	if (!(accounting_enforce & ACCOUNTING_ENFORCE_LIMITS)
+	    || (accounting_enforce & ACCOUNTING_ENFORCE_SAFE))
+		return (time_t) 0;
+
+	run_secs = now - job_ptr->start_time - job_ptr->tot_sus_time;
+
+	assoc_mgr_lock(&locks);
+	qos = (slurmdb_qos_rec_t *)job_ptr->qos_ptr;
+	assoc =	(slurmdb_assoc_rec_t *)job_ptr->assoc_ptr;
+
+	/* Same precedence of QOS over association limits as
+	 * acct_policy_job_time_out() */
+	if (qos) {
+		if ((qos->grp_cpu_mins != (uint64_t)INFINITE) ||
+		    (qos->grp_wall != INFINITE))
+			grp_limit = true;
+		due = _cpu_mins_due(now, run_secs, job_ptr->total_cpus,
+				    qos->max_cpu_mins_pj);
+	}
+	while (assoc && qos) {
+		if (((qos->grp_cpu_mins == INFINITE) &&
+		     (assoc->grp_cpu_mins != (uint64_t)INFINITE)) ||
+		    ((qos->grp_wall == INFINITE) &&
+		     (assoc->grp_wall != INFINITE)))
+			grp_limit = true;
+		if (qos->max_cpu_mins_pj == INFINITE) {
+			limit_due = _cpu_mins_due(now, run_secs,
+						  job_ptr->total_cpus,
+						  assoc->max_cpu_mins_pj);
+			if (limit_due && (!due || (limit_due < due)))
+				due = limit_due;
+		}
+		assoc = assoc->usage->parent_assoc_ptr;
+		/* these limits don't apply to the root assoc */
+		if (assoc == assoc_mgr_root_assoc)
+			break;
+	}
+	assoc_mgr_unlock(&locks);
+
+	if (grp_limit) {
+		limit_due = now + MAX(slurmctld_conf.priority_calc_period, 1);
+		if (!due || (limit_due < due))
+			due = limit_due;
+	}
+	return due;
+}
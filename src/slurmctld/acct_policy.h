@@ -140,4 +140,11 @@ extern int acct_policy_update_pending_job(struct job_record *job_ptr);
  */
 extern bool acct_policy_job_time_out(struct job_record *job_ptr);
 
+/*
+ * acct_policy_job_time_out_due - Return when acct_policy_job_time_out()
+ *	next needs to test the specified running job, zero if never
+ */
+extern time_t acct_policy_job_time_out_due(struct job_record *job_ptr,
+					   time_t now);
+
 #endif /* !_HAVE_ACCT_POLICY_H */
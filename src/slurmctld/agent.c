@@ -50,15 +50,17 @@
  *  be possible to execute the agent as an pthread, process, or even a daemon
  *  on some other computer.
  *
- *  The main agent thread creates a separate thread for each node to be
- *  communicated with up to AGENT_THREAD_COUNT. A special watchdog thread
- *  sends SIGLARM to any threads that have been active (in DSH_ACTIVE state)
- *  for more than COMMAND_TIMEOUT seconds.
- *  The agent responds to slurmctld via a function call or an RPC as required.
- *  For example, informing slurmctld that some node is not responding.
+ *  The main agent thread splits the nodes to be communicated with into
+ *  tasks and hands them all to a message engine shared by every agent
+ *  (see src/common/msg_aio.h). A few engine threads multiplex the
+ *  non-blocking connections to all nodes, bounded by agent_max_conn, and
+ *  time out each message on its own. As each task completes, the agent
+ *  thread processes its responses and once all are done responds to
+ *  slurmctld via a function call or an RPC as required. For example,
+ *  informing slurmctld that some node is not responding.
  *
- *  All the state for each thread is maintained in thd_t struct, which is
- *  used by the watchdog thread as well as the communication threads.
+ *  All the state for each task is maintained in thd_t struct, which is
+ *  updated by the engine threads and read by the agent thread.
 \*****************************************************************************/
 
 #ifdef HAVE_CONFIG_H
@@ -72,7 +74,6 @@
 #include <errno.h>
 #include <pthread.h>
 #include <pwd.h>
-#include <signal.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
@@ -84,12 +85,13 @@
 #include "src/common/list.h"
 #include "src/common/log.h"
 #include "src/common/macros.h"
+#include "src/common/msg_aio.h"
 #include "src/common/node_select.h"
 #include "src/common/parse_time.h"
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_protocol_interface.h"
+#include "src/common/slurm_route.h"
 #include "src/common/uid.h"
-#include "src/common/xsignal.h"
 #include "src/common/xassert.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
@@ -121,8 +123,6 @@ typedef struct thd_complete {
 } thd_complete_t;
 
 typedef struct thd {
-	pthread_t thread;		/* thread ID */
-	pthread_attr_t attr;		/* thread attributes */
 	state_t state;			/* thread state */
 	time_t start_time;		/* start time */
 	time_t end_time;		/* end time or delta time
@@ -131,32 +131,28 @@ typedef struct thd {
 					 * will not do nodelist if set */
 	char *nodelist;			/* list of nodes to send to */
 	List ret_list;
+	int rc;				/* result if no reply expected */
+	int branch_cnt;			/* engine requests outstanding */
 } thd_t;
 
 typedef struct agent_info {
 	pthread_mutex_t thread_mutex;	/* agent specific mutex */
 	pthread_cond_t thread_cond;	/* agent specific condition */
 	uint32_t thread_count;		/* number of threads records */
-	uint32_t threads_active;	/* currently active threads */
+	uint32_t threads_active;	/* tasks not yet processed */
 	uint16_t retry;			/* if set, keep trying */
 	thd_t *thread_struct;		/* thread structures */
 	bool get_reply;			/* flag if reply expected */
 	slurm_msg_type_t msg_type;	/* RPC to be issued */
 	void **msg_args_pptr;		/* RPC data to be used */
 	uint16_t protocol_version;	/* if set, use this version */
+	int *done_inx;			/* completed tasks, in order */
+	uint32_t done_cnt;		/* count of done_inx records */
 } agent_info_t;
 
 typedef struct task_info {
-	pthread_mutex_t *thread_mutex_ptr; /* pointer to agent specific
-					    * mutex */
-	pthread_cond_t *thread_cond_ptr;/* pointer to agent specific
-					 * condition */
-	uint32_t *threads_active_ptr;	/* currently active thread ptr */
-	thd_t *thread_struct_ptr;	/* thread structures ptr */
-	bool get_reply;			/* flag if reply expected */
-	slurm_msg_type_t msg_type;	/* RPC to be issued */
-	void *msg_args_ptr;		/* ptr to RPC data to be used */
-	uint16_t protocol_version;	/* if set, use this version */
+	agent_info_t *agent_info_ptr;	/* agent the task belongs to */
+	int inx;			/* index of task's thd_t */
 } task_info_t;
 
 typedef struct queued_request {
@@ -171,12 +167,12 @@ typedef struct mail_info {
 	char *message;
 } mail_info_t;
 
-static void _sig_handler(int dummy);
 static int  _batch_launch_defer(queued_request_t *queued_req_ptr);
 static inline int _comm_err(char *node_name, slurm_msg_type_t msg_type);
 static void _list_delete_retry(void *retry_entry);
 static agent_info_t *_make_agent_info(agent_arg_t *agent_arg_ptr);
 static task_info_t *_make_task_data(agent_info_t *agent_info_ptr, int inx);
+static void _agent_complete(agent_info_t *agent_ptr);
 static void _notify_slurmctld_jobs(agent_info_t *agent_ptr);
 static void _notify_slurmctld_nodes(agent_info_t *agent_ptr,
 		int no_resp_cnt, int retry_cnt);
@@ -185,9 +181,10 @@ static void _queue_agent_retry(agent_info_t * agent_info_ptr, int count);
 static int _setup_requeue(agent_arg_t *agent_arg_ptr, thd_t *thread_ptr,
 			  int count, int *spot);
 static void _spawn_retry_agent(agent_arg_t * agent_arg_ptr);
-static void *_thread_per_group_rpc(void *args);
+static void _process_task(agent_info_t *agent_ptr, thd_t *thread_ptr);
+static void _start_task(agent_info_t *agent_ptr, int inx);
+static void _task_done(List ret_list, int rc, void *arg);
 static int   _valid_agent_arg(agent_arg_t *agent_arg_ptr);
-static void *_wdog(void *args);
 
 static mail_info_t *_mail_alloc(void);
 static void  _mail_free(void *arg);
@@ -202,11 +199,54 @@ static List mail_list = NULL;		/* pending e-mail requests */
 static pthread_mutex_t agent_cnt_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  agent_cnt_cond  = PTHREAD_COND_INITIALIZER;
 static int agent_cnt = 0;
+static msg_aio_t *agent_aio = NULL;	/* protected by agent_cnt_mutex */
+
+static pthread_once_t agent_params_once = PTHREAD_ONCE_INIT;
+static int agent_io_threads = AGENT_IO_THREADS;
+static int agent_max_conn   = AGENT_MAX_CONN;
+static int max_agent_cnt    = MAX_AGENT_CNT;
 
 static bool run_scheduler    = false;
 static bool wiki2_sched      = false;
 static bool wiki2_sched_test = false;
 
+/* Read the agent's limits from SchedulerParameters, as of the first agent
+ * started. Changes take effect when slurmctld restarts. */
+static void _load_agent_params(void)
+{
+	char *sched_params, *tmp_ptr;
+
+	sched_params = slurm_get_sched_params();
+	if (sched_params &&
+	    (tmp_ptr = strstr(sched_params, "agent_io_threads="))) {
+		agent_io_threads = atoi(tmp_ptr + 17);
+		if (agent_io_threads < 1) {
+			error("Invalid SchedulerParameters agent_io_threads: "
+			      "%d", agent_io_threads);
+			agent_io_threads = AGENT_IO_THREADS;
+		}
+	}
+	if (sched_params &&
+	    (tmp_ptr = strstr(sched_params, "agent_max_conn="))) {
+		agent_max_conn = atoi(tmp_ptr + 15);
+		if (agent_max_conn < 1) {
+			error("Invalid SchedulerParameters agent_max_conn: %d",
+			      agent_max_conn);
+			agent_max_conn = AGENT_MAX_CONN;
+		}
+	}
+	if (sched_params &&
+	    (tmp_ptr = strstr(sched_params, "max_agent_cnt="))) {
+		max_agent_cnt = atoi(tmp_ptr + 14);
+		if (max_agent_cnt < 1) {
+			error("Invalid SchedulerParameters max_agent_cnt: %d",
+			      max_agent_cnt);
+			max_agent_cnt = MAX_AGENT_CNT;
+		}
+	}
+	xfree(sched_params);
+}
+
 /*
  * agent - party responsible for transmitting an common RPC in parallel
  *	across a set of nodes. Use agent_queue_request() if immediate
@@ -217,13 +257,10 @@ static bool wiki2_sched_test = false;
  */
 void *agent(void *args)
 {
-	int i, delay, rc, retries = 0;
-	pthread_attr_t attr_wdog;
-	pthread_t thread_wdog = 0;
+	int i, delay, processed = 0;
 	agent_arg_t *agent_arg_ptr = args;
 	agent_info_t *agent_info_ptr = NULL;
 	thd_t *thread_ptr;
-	task_info_t *task_specific_ptr;
 	time_t begin_time;
 
 #if HAVE_SYS_PRCTL_H
@@ -233,9 +270,10 @@ void *agent(void *args)
 	}
 #endif
 
+	pthread_once(&agent_params_once, _load_agent_params);
 #if 0
 	info("Agent_cnt is %d of %d with msg_type %d",
-	     agent_cnt, MAX_AGENT_CNT, agent_arg_ptr->msg_type);
+	     agent_cnt, max_agent_cnt, agent_arg_ptr->msg_type);
 #endif
 	slurm_mutex_lock(&agent_cnt_mutex);
 	if (!wiki2_sched_test) {
@@ -248,13 +286,15 @@ void *agent(void *args)
 
 	while (1) {
 		if (slurmctld_config.shutdown_time ||
-		    (agent_cnt < MAX_AGENT_CNT)) {
+		    (agent_cnt < max_agent_cnt)) {
 			agent_cnt++;
 			break;
 		} else {	/* wait for state change and retry */
 			pthread_cond_wait(&agent_cnt_cond, &agent_cnt_mutex);
 		}
 	}
+	if (!agent_aio && !slurmctld_config.shutdown_time)
+		agent_aio = msg_aio_create(agent_io_threads, agent_max_conn);
 	slurm_mutex_unlock(&agent_cnt_mutex);
 	if (slurmctld_config.shutdown_time)
 		goto cleanup;
@@ -268,94 +308,44 @@ void *agent(void *args)
 	agent_info_ptr = _make_agent_info(agent_arg_ptr);
 	thread_ptr = agent_info_ptr->thread_struct;
 
-	/* start the watchdog thread */
-	if (getenv("SLURM_NO_WDOG")) {
-		/* Test purposes only. Do not want threads to be interrupted
-		 * by SIGUSR1. Breaks normal operation */
-		error("%s: Watchdog thread disabled", __func__);
-	} else {
-		slurm_attr_init(&attr_wdog);
-		if (pthread_attr_setdetachstate
-		    (&attr_wdog, PTHREAD_CREATE_JOINABLE))
-			error("pthread_attr_setdetachstate error %m");
-		while (pthread_create(&thread_wdog, &attr_wdog, _wdog,
-				      (void *) agent_info_ptr)) {
-			error("pthread_create error %m");
-			if (++retries > MAX_RETRIES)
-				fatal("Can't create pthread");
-			usleep(10000);	/* sleep and retry */
-		}
-		slurm_attr_destroy(&attr_wdog);
-	}
-#if 	AGENT_THREAD_COUNT < 1
-	fatal("AGENT_THREAD_COUNT value is invalid");
-#endif
 	debug2("got %d threads to send out",agent_info_ptr->thread_count);
-	/* start all the other threads (up to AGENT_THREAD_COUNT active) */
-	for (i = 0; i < agent_info_ptr->thread_count; i++) {
+	/* hand every task to the message engine */
+	agent_info_ptr->threads_active = agent_info_ptr->thread_count;
+	for (i = 0; i < agent_info_ptr->thread_count; i++)
+		_start_task(agent_info_ptr, i);
 
-		/* wait until "room" for another thread */
-		slurm_mutex_lock(&agent_info_ptr->thread_mutex);
-		while (agent_info_ptr->threads_active >=
-		       AGENT_THREAD_COUNT) {
+	/* process the responses of each task as it completes */
+	slurm_mutex_lock(&agent_info_ptr->thread_mutex);
+	while (processed < agent_info_ptr->thread_count) {
+		while (agent_info_ptr->done_cnt == processed) {
 			pthread_cond_wait(&agent_info_ptr->thread_cond,
 					  &agent_info_ptr->thread_mutex);
 		}
+		i = agent_info_ptr->done_inx[processed++];
+		slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
 
-		/* create thread specific data, NOTE: freed from
-		 *      _thread_per_group_rpc() */
-		task_specific_ptr = _make_task_data(agent_info_ptr, i);
+		_process_task(agent_info_ptr, &thread_ptr[i]);
 
-		slurm_attr_init(&thread_ptr[i].attr);
-		if (pthread_attr_setdetachstate(&thread_ptr[i].attr,
-						PTHREAD_CREATE_DETACHED))
-			error("pthread_attr_setdetachstate error %m");
-		while ((rc = pthread_create(&thread_ptr[i].thread,
-					    &thread_ptr[i].attr,
-					    _thread_per_group_rpc,
-					    (void *) task_specific_ptr))) {
-			error("pthread_create error %m");
-			if (agent_info_ptr->threads_active)
-				pthread_cond_wait(&agent_info_ptr->
-						  thread_cond,
-						  &agent_info_ptr->
-						  thread_mutex);
-			else {
-				slurm_mutex_unlock(&agent_info_ptr->
-						     thread_mutex);
-				usleep(10000);	/* sleep and retry */
-				slurm_mutex_lock(&agent_info_ptr->
-						   thread_mutex);
-			}
-		}
-		slurm_attr_destroy(&thread_ptr[i].attr);
-		agent_info_ptr->threads_active++;
-		slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
+		slurm_mutex_lock(&agent_info_ptr->thread_mutex);
+		agent_info_ptr->threads_active--;
 	}
+	slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
 
-	/* Wait for termination of remaining threads */
-	if (!getenv("SLURM_NO_WDOG")) {
-		/* Test purposes only. Do not want threads to be interrupted
-		 * by SIGUSR1 */
-		pthread_join(thread_wdog, NULL);
-	}
+	_agent_complete(agent_info_ptr);
 
 	delay = (int) difftime(time(NULL), begin_time);
 	if (delay > (slurm_get_msg_timeout() * 2)) {
 		info("agent msg_type=%u ran for %d seconds",
 			agent_arg_ptr->msg_type,  delay);
 	}
-	slurm_mutex_lock(&agent_info_ptr->thread_mutex);
-	while (agent_info_ptr->threads_active != 0) {
-		pthread_cond_wait(&agent_info_ptr->thread_cond,
-				&agent_info_ptr->thread_mutex);
-	}
-	slurm_mutex_unlock(&agent_info_ptr->thread_mutex);
 
       cleanup:
 	_purge_agent_args(agent_arg_ptr);
 
 	if (agent_info_ptr) {
+		slurm_mutex_destroy(&agent_info_ptr->thread_mutex);
+		pthread_cond_destroy(&agent_info_ptr->thread_cond);
+		xfree(agent_info_ptr->done_inx);
 		xfree(agent_info_ptr->thread_struct);
 		xfree(agent_info_ptr);
 	}
@@ -368,7 +358,7 @@ void *agent(void *args)
 		agent_cnt = 0;
 	}
 
-	if (agent_cnt && agent_cnt < MAX_AGENT_CNT)
+	if (agent_cnt && agent_cnt < max_agent_cnt)
 		agent_retry(RPC_RETRY_INTERVAL, true);
 
 	pthread_cond_broadcast(&agent_cnt_cond);
@@ -416,6 +406,8 @@ static agent_info_t *_make_agent_info(agent_arg_t *agent_arg_ptr)
 	thread_ptr = xmalloc(agent_info_ptr->thread_count * sizeof(thd_t));
 	memset(thread_ptr, 0, (agent_info_ptr->thread_count * sizeof(thd_t)));
 	agent_info_ptr->thread_struct  = thread_ptr;
+	agent_info_ptr->done_inx = xmalloc(agent_info_ptr->thread_count *
+					   sizeof(int));
 	agent_info_ptr->msg_type       = agent_arg_ptr->msg_type;
 	agent_info_ptr->msg_args_pptr  = &agent_arg_ptr->msg_args;
 	agent_info_ptr->protocol_version = agent_arg_ptr->protocol_version;
@@ -494,34 +486,117 @@ static task_info_t *_make_task_data(agent_info_t *agent_info_ptr, int inx)
 	task_info_t *task_info_ptr;
 	task_info_ptr = xmalloc(sizeof(task_info_t));
 
-	task_info_ptr->thread_mutex_ptr  = &agent_info_ptr->thread_mutex;
-	task_info_ptr->thread_cond_ptr   = &agent_info_ptr->thread_cond;
-	task_info_ptr->threads_active_ptr= &agent_info_ptr->threads_active;
-	task_info_ptr->thread_struct_ptr = &agent_info_ptr->thread_struct[inx];
-	task_info_ptr->get_reply         = agent_info_ptr->get_reply;
-	task_info_ptr->msg_type          = agent_info_ptr->msg_type;
-	task_info_ptr->msg_args_ptr      = *agent_info_ptr->msg_args_pptr;
-	task_info_ptr->protocol_version  = agent_info_ptr->protocol_version;
+	task_info_ptr->agent_info_ptr = agent_info_ptr;
+	task_info_ptr->inx            = inx;
 
 	return task_info_ptr;
 }
 
-static void _update_wdog_state(thd_t *thread_ptr,
+/*
+ * _start_task - hand the RPC for a group of nodes to the message engine,
+ *	sending it out to one and forwarding it to others if necessary.
+ *	_task_done() is called as the engine completes each branch.
+ */
+static void _start_task(agent_info_t *agent_ptr, int inx)
+{
+	thd_t *thread_ptr = &agent_ptr->thread_struct[inx];
+	task_info_t *task_ptr = _make_task_data(agent_ptr, inx);
+	hostlist_t hl, *sp_hl = NULL;
+	int hl_count = 0, j;
+	slurm_msg_t msg;
+
+	slurm_msg_t_init(&msg);
+	if (agent_ptr->protocol_version)
+		msg.protocol_version = agent_ptr->protocol_version;
+	msg.msg_type = agent_ptr->msg_type;
+	msg.data     = *agent_ptr->msg_args_pptr;
+
+	thread_ptr->start_time = time(NULL);
+	thread_ptr->state = DSH_ACTIVE;
+	thread_ptr->rc = SLURM_SUCCESS;
+	thread_ptr->branch_cnt = 1;
+#if 0
+ 	info("sending message type %u to %s", msg.msg_type,
+	     thread_ptr->nodelist);
+#endif
+	if (agent_ptr->get_reply && !thread_ptr->addr) {
+		/* Pings come back merged by the forwarding slurmd */
+		msg.flags |= SLURM_ACCEPT_AGGREGATE;
+		hl = hostlist_create(thread_ptr->nodelist);
+		hostlist_uniq(hl);
+		if (route_g_split_hostlist(hl, &sp_hl, &hl_count) ||
+		    (hl_count == 0)) {
+			error("_start_task: unable to split forward hostlist");
+			hostlist_destroy(hl);
+			xfree(sp_hl);
+			_task_done(NULL, SLURM_ERROR, task_ptr);
+			return;
+		}
+		hostlist_destroy(hl);
+		thread_ptr->branch_cnt = hl_count;
+		for (j = 0; j < hl_count; j++) {
+			msg_aio_send_tree(agent_aio, &msg, sp_hl[j], 0,
+					  _task_done, task_ptr);
+		}
+		xfree(sp_hl);
+	} else if (agent_ptr->get_reply) {
+		msg.address = *thread_ptr->addr;
+		msg_aio_send_addr(agent_aio, &msg, thread_ptr->nodelist, true,
+				  0, _task_done, task_ptr);
+	} else {
+		if (thread_ptr->addr) {
+			msg.address = *thread_ptr->addr;
+		} else if (slurm_conf_get_addr(thread_ptr->nodelist,
+					       &msg.address) == SLURM_ERROR) {
+			error("_start_task: "
+			      "can't find address for host %s, "
+			      "check slurm.conf",
+			      thread_ptr->nodelist);
+			_task_done(NULL, SLURM_UNKNOWN_FORWARD_ADDR, task_ptr);
+			return;
+		}
+		msg_aio_send_addr(agent_aio, &msg, thread_ptr->nodelist, false,
+				  0, _task_done, task_ptr);
+	}
+}
+
+/*
+ * _task_done - note the completion of one branch of a task by the message
+ *	engine, the task is queued for processing by the agent thread once
+ *	all its branches are complete. Called by an engine thread.
+ * IN ret_list - responses, NULL if no reply was expected
+ * IN rc - result if no reply was expected
+ * IN arg - pointer to task_info_t, xfree'd once all branches complete
+ */
+static void _task_done(List ret_list, int rc, void *arg)
+{
+	task_info_t *task_ptr = (task_info_t *) arg;
+	agent_info_t *agent_ptr = task_ptr->agent_info_ptr;
+	thd_t *thread_ptr = &agent_ptr->thread_struct[task_ptr->inx];
+
+	slurm_mutex_lock(&agent_ptr->thread_mutex);
+	if (ret_list) {
+		if (thread_ptr->ret_list) {
+			list_transfer(thread_ptr->ret_list, ret_list);
+			list_destroy(ret_list);
+		} else
+			thread_ptr->ret_list = ret_list;
+	} else if (rc != SLURM_SUCCESS)
+		thread_ptr->rc = rc;
+	if (--thread_ptr->branch_cnt == 0) {
+		agent_ptr->done_inx[agent_ptr->done_cnt++] = task_ptr->inx;
+		pthread_cond_signal(&agent_ptr->thread_cond);
+		xfree(task_ptr);
+	}
+	slurm_mutex_unlock(&agent_ptr->thread_mutex);
+}
+
+static void _update_thd_state(thd_t *thread_ptr,
 			       state_t *state,
 			       thd_complete_t *thd_comp)
 {
 	switch(*state) {
 	case DSH_ACTIVE:
-		thd_comp->work_done = false;
-		if (thread_ptr->end_time <= thd_comp->now) {
-			debug3("agent thread %lu timed out",
-			       (unsigned long) thread_ptr->thread);
-			if (pthread_kill(thread_ptr->thread, SIGUSR1) == ESRCH)
-				*state = DSH_NO_RESP;
-			else
-				thread_ptr->end_time += COMMAND_TIMEOUT;
-		}
-		break;
 	case DSH_NEW:
 		thd_comp->work_done = false;
 		break;
@@ -540,18 +615,15 @@ static void _update_wdog_state(thd_t *thread_ptr,
 }
 
 /*
- * _wdog - Watchdog thread. Send SIGUSR1 to threads which have been active
- *	for too long.
- * IN args - pointer to agent_info_t with info on threads to watch
- * Sleep between polls with exponential times (from 0.125 to 1.0 second)
+ * _agent_complete - Tally the results of an agent's tasks once all are
+ *	processed, notify slurmctld and queue failed RPCs for retry.
+ * IN agent_ptr - pointer to agent_info_t with info on completed tasks
  */
-static void *_wdog(void *args)
+static void _agent_complete(agent_info_t *agent_ptr)
 {
 	bool srun_agent = false;
 	int i;
-	agent_info_t *agent_ptr = (agent_info_t *) args;
 	thd_t *thread_ptr = agent_ptr->thread_struct;
-	unsigned long usec = 5000;
 	ListIterator itr;
 	thd_complete_t thd_comp;
 	ret_data_info_t *ret_data_info = NULL;
@@ -568,41 +640,32 @@ static void *_wdog(void *args)
 	     (agent_ptr->msg_type == RESPONSE_RESOURCE_ALLOCATION) )
 		srun_agent = true;
 
-	thd_comp.max_delay = 0;
+	thd_comp.max_delay   = 0;
+	thd_comp.work_done   = true;
+	thd_comp.fail_cnt    = 0;
+	thd_comp.no_resp_cnt = 0;
+	thd_comp.retry_cnt   = 0;
+	thd_comp.now         = time(NULL);
 
-	while (1) {
-		thd_comp.work_done   = true;/* assume all threads complete */
-		thd_comp.fail_cnt    = 0;   /* assume no threads failures */
-		thd_comp.no_resp_cnt = 0;   /* assume all threads respond */
-		thd_comp.retry_cnt   = 0;   /* assume no required retries */
-		thd_comp.now         = time(NULL);
-
-		usleep(usec);
-		usec = MIN((usec * 2), 1000000);
-
-		slurm_mutex_lock(&agent_ptr->thread_mutex);
-		for (i = 0; i < agent_ptr->thread_count; i++) {
-			//info("thread name %s",thread_ptr[i].node_name);
-			if (!thread_ptr[i].ret_list) {
-				_update_wdog_state(&thread_ptr[i],
-						   &thread_ptr[i].state,
+	slurm_mutex_lock(&agent_ptr->thread_mutex);
+	for (i = 0; i < agent_ptr->thread_count; i++) {
+		if (!thread_ptr[i].ret_list) {
+			_update_thd_state(&thread_ptr[i],
+					   &thread_ptr[i].state,
+					   &thd_comp);
+		} else {
+			itr = list_iterator_create(thread_ptr[i].ret_list);
+			while ((ret_data_info = list_next(itr))) {
+				_update_thd_state(&thread_ptr[i],
+						   &ret_data_info->err,
 						   &thd_comp);
-			} else {
-				itr = list_iterator_create(
-					thread_ptr[i].ret_list);
-				while((ret_data_info = list_next(itr))) {
-					_update_wdog_state(&thread_ptr[i],
-							   &ret_data_info->err,
-							   &thd_comp);
-				}
-				list_iterator_destroy(itr);
 			}
+			list_iterator_destroy(itr);
 		}
-		if (thd_comp.work_done)
-			break;
-
-		slurm_mutex_unlock(&agent_ptr->thread_mutex);
 	}
+	if (!thd_comp.work_done)
+		error("_agent_complete: tasks of msg_type %u still active",
+		      agent_ptr->msg_type);
 
 	if (srun_agent) {
 		_notify_slurmctld_jobs(agent_ptr);
@@ -622,7 +685,6 @@ static void *_wdog(void *args)
 		debug2("agent maximum delay %d seconds", thd_comp.max_delay);
 
 	slurm_mutex_unlock(&agent_ptr->thread_mutex);
-	return (void *) NULL;
 }
 
 static void _notify_slurmctld_jobs(agent_info_t *agent_ptr)
@@ -738,7 +800,21 @@ static void _notify_slurmctld_nodes(agent_info_t *agent_ptr,
 				      node_names, down_msg);
 				break;
 			case DSH_DONE:
-				node_did_resp(node_names);
+				if (!is_ret_list) {
+					node_did_resp(node_names);
+				} else if (resp_type ==
+					   RESPONSE_PING_AGGREGATE) {
+					node_did_resp_aggr(node_names,
+							   ret_data_info->data);
+				} else {
+					if (resp_type == RESPONSE_PING_SLURMD) {
+						ping_slurmd_resp_msg_t *ping;
+						ping = ret_data_info->data;
+						reset_node_load(node_names,
+								ping->cpu_load);
+					}
+					node_did_resp(node_names);
+				}
 				break;
 			default:
 				error("unknown state returned for %s",
@@ -800,32 +876,20 @@ static int _wif_status(void)
 }
 
 /*
- * _thread_per_group_rpc - thread to issue an RPC for a group of nodes
- *                         sending message out to one and forwarding it to
- *                         others if necessary.
- * IN/OUT args - pointer to task_info_t, xfree'd on completion
+ * _process_task - process the responses to the RPC for a group of nodes
+ *	once the message engine has completed it
+ * IN agent_ptr - pointer to agent_info_t the task belongs to
+ * IN/OUT thread_ptr - the task's state
  */
-static void *_thread_per_group_rpc(void *args)
+static void _process_task(agent_info_t *agent_ptr, thd_t *thread_ptr)
 {
 	int rc = SLURM_SUCCESS;
-	slurm_msg_t msg;
-	task_info_t *task_ptr = (task_info_t *) args;
-	/* we cache some pointers from task_info_t because we need
-	 * to xfree args before being finished with their use. xfree
-	 * is required for timely termination of this pthread because
-	 * xfree could lock it at the end, preventing a timely
-	 * thread_exit */
-	pthread_mutex_t *thread_mutex_ptr   = task_ptr->thread_mutex_ptr;
-	pthread_cond_t  *thread_cond_ptr    = task_ptr->thread_cond_ptr;
-	uint32_t        *threads_active_ptr = task_ptr->threads_active_ptr;
-	thd_t           *thread_ptr         = task_ptr->thread_struct_ptr;
 	state_t thread_state = DSH_NO_RESP;
-	slurm_msg_type_t msg_type = task_ptr->msg_type;
+	slurm_msg_type_t msg_type = agent_ptr->msg_type;
 	bool is_kill_msg, srun_agent;
-	List ret_list = NULL;
+	List ret_list = thread_ptr->ret_list;
 	ListIterator itr;
 	ret_data_info_t *ret_data_info = NULL;
-	int sig_array[2] = {SIGUSR1, 0};
 	/* Locks: Write job, write node */
 	slurmctld_lock_t job_write_lock = {
 		NO_LOCK, WRITE_LOCK, WRITE_LOCK, NO_LOCK };
@@ -836,9 +900,6 @@ static void *_thread_per_group_rpc(void *args)
 	slurmctld_lock_t node_write_lock = {
 		NO_LOCK, NO_LOCK, WRITE_LOCK, NO_LOCK };
 
-	xassert(args != NULL);
-	xsignal(SIGUSR1, _sig_handler);
-	xsignal_unblock(sig_array);
 	is_kill_msg = (	(msg_type == REQUEST_KILL_TIMELIMIT)	||
 			(msg_type == REQUEST_KILL_PREEMPTED)	||
 			(msg_type == REQUEST_TERMINATE_JOB) );
@@ -852,94 +913,35 @@ static void *_thread_per_group_rpc(void *args)
 			(msg_type == RESPONSE_RESOURCE_ALLOCATION) ||
 			(msg_type == SRUN_NODE_FAIL) );
 
-	thread_ptr->start_time = time(NULL);
-
-	slurm_mutex_lock(thread_mutex_ptr);
-	thread_ptr->state = DSH_ACTIVE;
-	thread_ptr->end_time = thread_ptr->start_time + COMMAND_TIMEOUT;
-	slurm_mutex_unlock(thread_mutex_ptr);
-
-	/* send request message */
-	slurm_msg_t_init(&msg);
-
-	if (task_ptr->protocol_version)
-		msg.protocol_version = task_ptr->protocol_version;
-
-	msg.msg_type = msg_type;
-	msg.data     = task_ptr->msg_args_ptr;
-#if 0
- 	info("sending message type %u to %s", msg_type, thread_ptr->nodelist);
-#endif
-	if (task_ptr->get_reply) {
-		if (thread_ptr->addr) {
-			msg.address = *thread_ptr->addr;
-
-			if (!(ret_list = slurm_send_addr_recv_msgs(
-				     &msg, thread_ptr->nodelist, 0))) {
-				error("_thread_per_group_rpc: "
-				      "no ret_list given");
-				goto cleanup;
-			}
-
-
-		} else {
-			if (!(ret_list = slurm_send_recv_msgs(
-				     thread_ptr->nodelist,
-				     &msg, 0, true))) {
-				error("_thread_per_group_rpc: "
-				      "no ret_list given");
-				goto cleanup;
-			}
-		}
-	} else {
-		if (thread_ptr->addr) {
-			//info("got the address");
-			msg.address = *thread_ptr->addr;
-		} else {
-			//info("no address given");
-			if (slurm_conf_get_addr(thread_ptr->nodelist,
-					       &msg.address) == SLURM_ERROR) {
-				error("_thread_per_group_rpc: "
-				      "can't find address for host %s, "
-				      "check slurm.conf",
-				      thread_ptr->nodelist);
-				goto cleanup;
-			}
-		}
-		//info("sending %u to %s", msg_type, thread_ptr->nodelist);
-		if (slurm_send_only_node_msg(&msg) == SLURM_SUCCESS) {
+	if (!agent_ptr->get_reply) {
+		if (thread_ptr->rc == SLURM_SUCCESS) {
 			thread_state = DSH_DONE;
-		} else {
-			if (!srun_agent) {
-				lock_slurmctld(node_read_lock);
-				_comm_err(thread_ptr->nodelist, msg_type);
-				unlock_slurmctld(node_read_lock);
-			}
+		} else if (!srun_agent &&
+			   (thread_ptr->rc != SLURM_UNKNOWN_FORWARD_ADDR)) {
+			errno = thread_ptr->rc;
+			lock_slurmctld(node_read_lock);
+			_comm_err(thread_ptr->nodelist, msg_type);
+			unlock_slurmctld(node_read_lock);
 		}
 		goto cleanup;
 	}
+	if (!ret_list) {
+		error("_process_task: no ret_list given");
+		goto cleanup;
+	}
 
 	//info("got %d messages back", list_count(ret_list));
 	itr = list_iterator_create(ret_list);
 	while ((ret_data_info = list_next(itr)) != NULL) {
 		rc = slurm_get_return_code(ret_data_info->type,
 					   ret_data_info->data);
-		/* SPECIAL CASE: Record node's CPU load */
-		if (ret_data_info->type == RESPONSE_PING_SLURMD) {
-			ping_slurmd_resp_msg_t *ping_resp;
-			ping_resp = (ping_slurmd_resp_msg_t *)
-				    ret_data_info->data;
-			lock_slurmctld(node_write_lock);
-			reset_node_load(ret_data_info->node_name,
-					ping_resp->cpu_load);
-			unlock_slurmctld(node_write_lock);
-		}
+		/* Node's CPU load is recorded by _notify_slurmctld_nodes() */
 		/* SPECIAL CASE: Mark node as IDLE if job already complete */
 		if (is_kill_msg &&
 		    (rc == ESLURMD_KILL_JOB_ALREADY_COMPLETE)) {
 			kill_job_msg_t *kill_job;
 			kill_job = (kill_job_msg_t *)
-				task_ptr->msg_args_ptr;
+				*agent_ptr->msg_args_pptr;
 			rc = SLURM_SUCCESS;
 			lock_slurmctld(job_write_lock);
 			if (job_epilog_complete(kill_job->job_id,
@@ -964,7 +966,7 @@ static void *_thread_per_group_rpc(void *args)
 		    (rc != SLURM_SUCCESS) && (rc != ESLURMD_PROLOG_FAILED) &&
 		    (ret_data_info->type != RESPONSE_FORWARD_FAILED)) {
 			batch_job_launch_msg_t *launch_msg_ptr =
-				task_ptr->msg_args_ptr;
+				*agent_ptr->msg_args_pptr;
 			uint32_t job_id = launch_msg_ptr->job_id;
 			info("Killing non-startable batch job %u: %s",
 			     job_id, slurm_strerror(rc));
@@ -1046,28 +1048,11 @@ static void *_thread_per_group_rpc(void *args)
 	list_iterator_destroy(itr);
 
 cleanup:
-	xfree(args);
-
-	/* handled at end of thread just in case resend is needed */
-	destroy_forward(&msg.forward);
-	slurm_mutex_lock(thread_mutex_ptr);
-	thread_ptr->ret_list = ret_list;
+	slurm_mutex_lock(&agent_ptr->thread_mutex);
 	thread_ptr->state = thread_state;
 	thread_ptr->end_time = (time_t) difftime(time(NULL),
 						 thread_ptr->start_time);
-	/* Signal completion so another thread can replace us */
-	(*threads_active_ptr)--;
-	pthread_cond_signal(thread_cond_ptr);
-	slurm_mutex_unlock(thread_mutex_ptr);
-	return (void *) NULL;
-}
-
-/*
- * Signal handler.  We are really interested in interrupting hung communictions
- * and causing them to return EINTR. Multiple interupts might be required.
- */
-static void _sig_handler(int dummy)
-{
+	slurm_mutex_unlock(&agent_ptr->thread_mutex);
 }
 
 static int _setup_requeue(agent_arg_t *agent_arg_ptr, thd_t *thread_ptr,
@@ -1201,7 +1186,7 @@ extern int agent_retry (int min_wait, bool mail_too)
 		static time_t last_msg_time = (time_t) 0;
 		uint32_t msg_type[5] = {0, 0, 0, 0, 0}, i = 0;
 		list_size = list_count(retry_list);
-		if ((list_size > MAX_AGENT_CNT) &&
+		if ((list_size > max_agent_cnt) &&
 		    (difftime(now, last_msg_time) > 300)) {
 			/* Note sizable backlog of work */
 			info("WARNING: agent retry_list size is %d",
@@ -1221,7 +1206,7 @@ extern int agent_retry (int min_wait, bool mail_too)
 			last_msg_time = now;
 		}
 	}
-	if (agent_cnt >= MAX_AGENT_CNT) {	/* too much work already */
+	if (agent_cnt >= max_agent_cnt) {	/* too much work already */
 		slurm_mutex_unlock(&retry_mutex);
 		return list_size;
 	}
@@ -1406,6 +1391,12 @@ void agent_purge(void)
 		mail_list = NULL;
 		slurm_mutex_unlock(&mail_mutex);
 	}
+	slurm_mutex_lock(&agent_cnt_mutex);
+	if (agent_aio && (agent_cnt == 0)) {
+		msg_aio_destroy(agent_aio);
+		agent_aio = NULL;
+	}
+	slurm_mutex_unlock(&agent_cnt_mutex);
 }
 extern int get_agent_count(void)
 {
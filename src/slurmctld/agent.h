@@ -44,13 +44,13 @@
 
 #include "src/slurmctld/slurmctld.h"
 
-#define AGENT_THREAD_COUNT	10	/* maximum active threads per agent */
-#define COMMAND_TIMEOUT 	30	/* command requeue or error, seconds */
-#define MAX_AGENT_CNT		(MAX_SERVER_THREADS / (AGENT_THREAD_COUNT + 2))
-					/* maximum simultaneous agents, note
-					 *   total thread count is product of
-					 *   MAX_AGENT_CNT and
-					 *   (AGENT_THREAD_COUNT + 2) */
+#define AGENT_IO_THREADS	2	/* default threads of the message
+					 * engine shared by all agents */
+#define AGENT_MAX_CONN		1024	/* default maximum connections open
+					 * by the message engine */
+#define MAX_AGENT_CNT		(MAX_SERVER_THREADS / 2)
+					/* default maximum simultaneous
+					 * agents, each uses one thread */
 
 typedef struct agent_arg {
 	uint32_t	node_count;	/* number of nodes to communicate
@@ -52,6 +52,7 @@
 
 #include <grp.h>
 #include <errno.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -105,6 +106,7 @@
 #include "src/slurmctld/proc_req.h"
 #include "src/slurmctld/read_config.h"
 #include "src/slurmctld/reservation.h"
+#include "src/slurmctld/rpc_queue.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/slurmctld_plugstack.h"
 #include "src/slurmctld/sched_plugin.h"
@@ -123,6 +125,8 @@
 #define MIN_CHECKIN_TIME  3	/* Nodes have this number of seconds to
 				 * check-in before we ping them */
 #define SHUTDOWN_WAIT     2	/* Time to wait for backup server shutdown */
+#define MAX_MSG_SIZE      (1024*1024*1024)	/* Largest RPC accepted, as
+						 * slurm_msg_recvfrom_timeout() */
 
 #if (0)
 /* If defined and FastSchedule=0 in slurm.conf, then report the CPU count that a
@@ -195,10 +199,41 @@ static int	new_nice = 0;
 static char	node_name[MAX_SLURM_NAME];
 static int	recover   = DEFAULT_RECOVER;
 static pthread_mutex_t sched_cnt_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t server_thread_cond = PTHREAD_COND_INITIALIZER;
 static pid_t	slurmctld_pid;
 static char *	slurm_conf_filename;
 
+/* A connection accepted by _slurmctld_rpc_mgr() whose message is still
+ * being read */
+typedef struct pending_conn {
+	connection_arg_t *conn;
+	char len_buf[sizeof(uint32_t)];	/* message length prefix */
+	size_t len_read;		/* bytes of len_buf read */
+	uint32_t msglen;		/* message length in host order */
+	char *buf;			/* message data */
+	size_t buf_read;		/* bytes of buf read */
+	time_t start_time;		/* when the connection was accepted, or
+					 * when an idle session began a
+					 * message */
+} pending_conn_t;
+
+/* A connection kept open by REQUEST_CTLD_SESSION. _slurmctld_rpc_mgr()
+ * keeps reading its requests, which the RPC workers process concurrently
+ * and answer in any order. */
+typedef struct ctld_session {
+	void *cred;			/* auth credential of the session */
+	slurm_fd_t fd;
+	int ref_cnt;			/* reader plus requests in progress,
+					 * protected by session_mutex */
+	pthread_mutex_t write_lock;	/* serializes responses */
+} ctld_session_t;
+
+/* New sessions handed to _slurmctld_rpc_mgr() by the RPC workers, see
+ * _start_session() */
+static pthread_mutex_t session_mutex = PTHREAD_MUTEX_INITIALIZER;
+static connection_arg_t **session_new = NULL;
+static int	session_new_cnt = 0, session_new_size = 0;
+static int	session_pipe[2] = { -1, -1 };
+
 /*
  * Static list of signals to block in this process
  * *Must be zero-terminated*
@@ -225,7 +260,7 @@ static void         _remove_qos(slurmdb_qos_rec_t *rec);
 static void         _update_assoc(slurmdb_assoc_rec_t *rec);
 static void         _update_qos(slurmdb_qos_rec_t *rec);
 inline static int   _report_locks_set(void);
-static void *       _service_connection(void *arg);
+static void         _service_connection(rpc_queue_rec_t *rec);
 static void         _set_work_dir(void);
 static int          _shutdown_backup_controller(int wait_time);
 static void *       _slurmctld_background(void *no_data);
@@ -236,7 +271,6 @@ inline static void  _update_cred_key(void);
 static void         _update_nice(void);
 inline static void  _usage(char *prog_name);
 static bool         _valid_controller(void);
-static bool         _wait_for_server_thread(void);
 
 /* main - slurmctld main function, start various threads and process RPCs */
 int main(int argc, char *argv[])
@@ -249,6 +283,7 @@ int main(int argc, char *argv[])
 		WRITE_LOCK, WRITE_LOCK, WRITE_LOCK, WRITE_LOCK };
 	slurm_trigger_callbacks_t callbacks;
 	char *dir_name;
+	DEF_TIMERS;
 
 	/*
 	 * Make sure we have no extra open files which
@@ -447,7 +482,11 @@ int main(int argc, char *argv[])
 		} else if (_valid_controller()) {
 			(void) _shutdown_backup_controller(SHUTDOWN_WAIT);
 			trigger_primary_ctld_res_ctrl();
+			START_TIMER;
 			ctld_assoc_mgr_init(&callbacks);
+			END_TIMER;
+			info("Association state recovered %s", TIME_STR);
+			START_TIMER;
 			if (slurm_acct_storage_init(NULL) != SLURM_SUCCESS )
 				fatal("failed to initialize "
 				      "accounting_storage plugin");
@@ -463,6 +502,8 @@ int main(int argc, char *argv[])
 			}
 			unlock_slurmctld(config_write_lock);
 			select_g_select_nodeinfo_set_all();
+			END_TIMER;
+			info("Controller state recovered %s", TIME_STR);
 
 			if (recover == 0) {
 				slurmctld_init_db = 1;
@@ -642,6 +683,7 @@ int main(int argc, char *argv[])
 
 	/* Purge our local data structures */
 	job_fini();
+	sched_queue_fini();
 	part_fini();	/* part_fini() must preceed node_fini() */
 	node_fini();
 	purge_front_end_state();
@@ -875,7 +917,238 @@ static void _sig_handler(int signal)
 {
 }
 
-/* _slurmctld_rpc_mgr - Read incoming RPCs and create pthread for each */
+/* Read as much of a pending connection's message as is available.
+ * RET 0 if more data is needed, 1 if the message is complete, -1 on error
+ *	or if the connection was closed by the peer */
+static int _read_pending_conn(pending_conn_t *pend)
+{
+	slurm_fd_t fd = pend->conn->newsockfd;
+	uint32_t msglen;
+	ssize_t n;
+
+	/* An idle session is only timed once its next message begins */
+	if (pend->conn->session && (pend->len_read == 0))
+		pend->start_time = time(NULL);
+
+	while (pend->len_read < sizeof(pend->len_buf)) {
+		n = recv(fd, pend->len_buf + pend->len_read,
+			 sizeof(pend->len_buf) - pend->len_read, 0);
+		if (n == 0)
+			return -1;
+		if (n < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN) ||
+			    (errno == EWOULDBLOCK))
+				return 0;
+			debug("%s: recv: %m", __func__);
+			return -1;
+		}
+		pend->len_read += n;
+		if (pend->len_read < sizeof(pend->len_buf))
+			continue;
+		memcpy(&msglen, pend->len_buf, sizeof(msglen));
+		pend->msglen = ntohl(msglen);
+		if ((pend->msglen == 0) || (pend->msglen > MAX_MSG_SIZE)) {
+			error("%s: %s", __func__,
+			      slurm_strerror(SLURM_PROTOCOL_INSANE_MSG_LENGTH));
+			return -1;
+		}
+		pend->buf = buf_pool_alloc(pend->msglen);
+	}
+
+	while (pend->buf_read < pend->msglen) {
+		n = recv(fd, pend->buf + pend->buf_read,
+			 pend->msglen - pend->buf_read, 0);
+		if (n == 0)
+			return -1;
+		if (n < 0) {
+			if ((errno == EINTR) || (errno == EAGAIN) ||
+			    (errno == EWOULDBLOCK))
+				return 0;
+			debug("%s: recv: %m", __func__);
+			return -1;
+		}
+		pend->buf_read += n;
+	}
+
+	return 1;
+}
+
+/* Release a reference to a session, closing it with the last one */
+static void _unref_session(ctld_session_t *session)
+{
+	slurm_mutex_lock(&session_mutex);
+	if (--session->ref_cnt > 0) {
+		slurm_mutex_unlock(&session_mutex);
+		return;
+	}
+	slurm_mutex_unlock(&session_mutex);
+
+	debug2("%s: closing session on fd %d", __func__, session->fd);
+	if (slurm_close(session->fd) < 0)
+		error("close(%d): %m", session->fd);
+	(void) g_slurm_auth_destroy(session->cred);
+	slurm_mutex_destroy(&session->write_lock);
+	xfree(session);
+
+	slurm_mutex_lock(&slurmctld_config.thread_count_lock);
+	slurmctld_config.session_count--;
+	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
+}
+
+/* Make a connection whose REQUEST_CTLD_SESSION was accepted a session and
+ * hand it to _slurmctld_rpc_mgr() to read its requests, called by an RPC
+ * worker thread */
+static void _start_session(connection_arg_t *conn)
+{
+	ctld_session_t *session = xmalloc(sizeof(ctld_session_t));
+	char c = 0;
+
+	session->cred = conn->session_cred;
+	session->fd = conn->newsockfd;
+	session->ref_cnt = 1;
+	slurm_mutex_init(&session->write_lock);
+	conn->session = session;
+	fd_set_nonblocking(conn->newsockfd);
+
+	slurm_mutex_lock(&session_mutex);
+	if (session_new_cnt >= session_new_size) {
+		session_new_size += 64;
+		xrealloc(session_new,
+			 sizeof(connection_arg_t *) * session_new_size);
+	}
+	session_new[session_new_cnt++] = conn;
+	slurm_mutex_unlock(&session_mutex);
+
+	/* Wake up poll(), the pipe is only full if it is already readable */
+	if ((write(session_pipe[1], &c, 1) < 0) && (errno != EAGAIN))
+		error("%s: write: %m", __func__);
+}
+
+/* Test if more requests may be read from sessions. While the RPC queue is
+ * full or max_server_threads RPCs are in progress, requests are left in the
+ * sessions' sockets, so clients are held back as when connections are not
+ * accepted. */
+static bool _session_read_ok(void)
+{
+	bool read_ok;
+
+	slurm_mutex_lock(&slurmctld_config.thread_count_lock);
+	read_ok = (slurmctld_config.server_thread_count <
+		   (int) max_server_threads);
+	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
+
+	return (read_ok && !rpc_queue_full());
+}
+
+/* Test if a session is idle: between requests and with none in progress */
+static bool _session_idle(pending_conn_t *pend)
+{
+	ctld_session_t *session = pend->conn->session;
+	bool idle;
+
+	if (pend->len_read)
+		return false;
+	slurm_mutex_lock(&session_mutex);
+	idle = (session->ref_cnt == 1);
+	slurm_mutex_unlock(&session_mutex);
+
+	return idle;
+}
+
+/* Queue a request read from a session, which stays in the array of
+ * connections being read */
+static void _enqueue_session_msg(pending_conn_t *pend)
+{
+	ctld_session_t *session = pend->conn->session;
+	connection_arg_t *conn = xmalloc(sizeof(connection_arg_t));
+
+	memcpy(conn, pend->conn, sizeof(connection_arg_t));
+	slurm_mutex_lock(&session_mutex);
+	session->ref_cnt++;
+	slurm_mutex_unlock(&session_mutex);
+
+	slurm_mutex_lock(&slurmctld_config.thread_count_lock);
+	slurmctld_config.server_thread_count++;
+	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
+
+	rpc_queue_enqueue(conn, pend->buf, pend->msglen);
+	pend->buf = NULL;
+	pend->len_read = 0;
+	pend->buf_read = 0;
+	pend->msglen = 0;
+}
+
+/* Close a connection whose message could not be read and release it.
+ * Sessions are not counted in server_thread_count, their requests in
+ * progress are. */
+static void _abort_pending_conn(pending_conn_t *pend)
+{
+	buf_pool_free(pend->buf);
+	if (pend->conn->session) {
+		/* Responses still being sent are discarded */
+		(void) shutdown(pend->conn->newsockfd, SHUT_RDWR);
+		_unref_session(pend->conn->session);
+		xfree(pend->conn);
+		xfree(pend);
+		return;
+	}
+	if (slurm_close(pend->conn->newsockfd) < 0)
+		error("close(%d): %m", pend->conn->newsockfd);
+	xfree(pend->conn);
+	xfree(pend);
+	_free_server_thread();
+}
+
+/* Add a connection to the array of those being read */
+static void _add_pending_conn(pending_conn_t ***pend, int *pend_cnt,
+			      int *pend_size, connection_arg_t *conn,
+			      time_t now)
+{
+	pending_conn_t *pend_ptr = xmalloc(sizeof(pending_conn_t));
+
+	pend_ptr->conn = conn;
+	pend_ptr->start_time = now;
+	if (*pend_cnt >= *pend_size) {
+		*pend_size += 64;
+		xrealloc(*pend, sizeof(pending_conn_t *) * *pend_size);
+	}
+	(*pend)[(*pend_cnt)++] = pend_ptr;
+}
+
+/* Parse the RPC worker pool size and queue depth from SchedulerParameters */
+static void _get_rpc_queue_params(int *worker_cnt, int *queue_depth)
+{
+	char *sched_params, *tmp_ptr;
+
+	*worker_cnt  = RPC_WORKER_THREADS;
+	*queue_depth = RPC_QUEUE_DEPTH;
+
+	sched_params = slurm_get_sched_params();
+	if (sched_params &&
+	    (tmp_ptr = strstr(sched_params, "rpc_workers="))) {
+		*worker_cnt = atoi(tmp_ptr + 12);
+		/* REQUEST_CONTROL holds a worker while the others drain */
+		if (*worker_cnt < 2) {
+			error("Invalid SchedulerParameters rpc_workers: %d",
+			      *worker_cnt);
+			*worker_cnt = RPC_WORKER_THREADS;
+		}
+	}
+	if (sched_params &&
+	    (tmp_ptr = strstr(sched_params, "rpc_queue_depth="))) {
+		*queue_depth = atoi(tmp_ptr + 16);
+		if (*queue_depth < 1) {
+			error("Invalid SchedulerParameters rpc_queue_depth: %d",
+			      *queue_depth);
+			*queue_depth = RPC_QUEUE_DEPTH;
+		}
+	}
+	xfree(sched_params);
+}
+
+/* _slurmctld_rpc_mgr - Accept incoming RPC connections and read their
+ * messages without blocking, then queue each complete message for
+ * processing by the RPC worker threads (see rpc_queue.c) */
 static void *_slurmctld_rpc_mgr(void *no_data)
 {
 	slurm_fd_t newsockfd;
@@ -883,11 +1156,15 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	slurm_addr_t cli_addr, srv_addr;
 	uint16_t port;
 	char ip[32];
-	pthread_t thread_id_rpc_req;
-	pthread_attr_t thread_attr_rpc_req;
-	int no_thread;
-	int fd_next = 0, i, nports;
-	fd_set rfds;
+	int fd_next = 0, i, j, nports, nfds, rc, timeout;
+	int worker_cnt, queue_depth, msg_timeout;
+	pending_conn_t **pend = NULL, *pend_ptr;
+	int pend_cnt = 0, pend_polled, pend_size = 0, pfds_size = 0;
+	int idle_cnt;
+	char pipe_buf[64];
+	struct pollfd *pfds = NULL;
+	bool accept_ok, session_read_ok;
+	time_t now;
 	connection_arg_t *conn_arg = NULL;
 	/* Locks: Read config */
 	slurmctld_lock_t config_read_lock = {
@@ -906,12 +1183,6 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	(void) pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 	debug3("_slurmctld_rpc_mgr pid = %u", getpid());
 
-	/* threads to process individual RPC's are detached */
-	slurm_attr_init(&thread_attr_rpc_req);
-	if (pthread_attr_setdetachstate
-	    (&thread_attr_rpc_req, PTHREAD_CREATE_DETACHED))
-		fatal("pthread_attr_setdetachstate %m");
-
 	/* set node_addr to bind to (NULL means any) */
 	if (slurmctld_conf.backup_controller && slurmctld_conf.backup_addr &&
 	    (strcmp(node_name, slurmctld_conf.backup_controller) == 0) &&
@@ -946,9 +1217,23 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 		slurm_get_ip_str(&srv_addr, &port, ip, sizeof(ip));
 		debug2("slurmctld listening on %s:%d", ip, ntohs(port));
 	}
+	msg_timeout = slurmctld_conf.msg_timeout;
 	unlock_slurmctld(config_read_lock);
 
-	/* Prepare to catch SIGUSR1 to interrupt accept().
+	if (pipe(session_pipe) < 0) {
+		fatal("%s: pipe: %m", __func__);
+		return NULL;	/* Fix CLANG false positive */
+	}
+	fd_set_close_on_exec(session_pipe[0]);
+	fd_set_close_on_exec(session_pipe[1]);
+	fd_set_nonblocking(session_pipe[0]);
+	fd_set_nonblocking(session_pipe[1]);
+
+	_get_rpc_queue_params(&worker_cnt, &queue_depth);
+	rpc_queue_init(worker_cnt, queue_depth, _service_connection);
+	set_buf_pool_threads(worker_cnt);
+
+	/* Prepare to catch SIGUSR1 to interrupt poll().
 	 * This signal is generated by the slurmctld signal
 	 * handler thread upon receipt of SIGABRT, SIGINT,
 	 * or SIGTERM. That thread does all processing of
@@ -959,105 +1244,242 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	/*
 	 * Process incoming RPCs until told to shutdown
 	 */
-	while (_wait_for_server_thread()) {
-		int max_fd = -1;
-		FD_ZERO(&rfds);
-		for (i=0; i<nports; i++) {
-			FD_SET(sockfd[i], &rfds);
-			max_fd = MAX(sockfd[i], max_fd);
+	while (slurmctld_config.shutdown_time == 0) {
+		/* Stop accepting connections while the RPC queue is full or
+		 * too many messages are being read. This is just a delay and
+		 * not an error. This can happen when the epilog completes on
+		 * a bunch of nodes at the same time, which can easily happen
+		 * for highly parallel jobs. Idle sessions are not counted. */
+		for (i = 0, idle_cnt = 0; i < pend_cnt; i++) {
+			if (pend[i]->conn->session && (pend[i]->len_read == 0))
+				idle_cnt++;
 		}
-		if (select(max_fd+1, &rfds, NULL, NULL, NULL) == -1) {
-			if (errno != EINTR)
-				error("slurm_accept_msg_conn select: %m");
-			_free_server_thread();
-			continue;
+		accept_ok = ((pend_cnt - idle_cnt) < (int) max_server_threads) &&
+			    !rpc_queue_full();
+		session_read_ok = _session_read_ok();
+		if (!accept_ok) {
+			static time_t last_print_time = 0;
+			now = time(NULL);
+			if (difftime(now, last_print_time) > 2) {
+				verbose("server_thread_count over limit "
+					"(%d), waiting",
+					slurmctld_config.server_thread_count);
+				last_print_time = now;
+			}
 		}
-		/* find one to process */
-		for (i=0; i<nports; i++) {
-			if (FD_ISSET(sockfd[(fd_next+i) % nports], &rfds)) {
-				i = (fd_next + i) % nports;
-				break;
+
+		if (pfds_size < (pend_cnt + nports + 1)) {
+			pfds_size = pend_cnt + nports + 64;
+			xrealloc(pfds, sizeof(struct pollfd) * pfds_size);
+		}
+		pend_polled = pend_cnt;
+		nfds = 0;
+		for (i = 0; i < pend_cnt; i++, nfds++) {
+			/* poll() ignores negative descriptors */
+			if (pend[i]->conn->session && !session_read_ok)
+				pfds[nfds].fd = -1;
+			else
+				pfds[nfds].fd = pend[i]->conn->newsockfd;
+			pfds[nfds].events = POLLIN;
+			pfds[nfds].revents = 0;
+		}
+		pfds[nfds].fd = session_pipe[0];
+		pfds[nfds].events = POLLIN;
+		pfds[nfds].revents = 0;
+		nfds++;
+		if (accept_ok) {
+			for (i = 0; i < nports; i++, nfds++) {
+				pfds[nfds].fd = sockfd[i];
+				pfds[nfds].events = POLLIN;
+				pfds[nfds].revents = 0;
 			}
 		}
-		fd_next = (i + 1) % nports;
+		/* Check again soon for room to read held back messages */
+		if (accept_ok && session_read_ok)
+			timeout = 1000;
+		else
+			timeout = 100;
 
-		/*
-		 * accept needed for stream implementation is a no-op in
-		 * message implementation that just passes sockfd to newsockfd
-		 */
-		if ((newsockfd = slurm_accept_msg_conn(sockfd[i],
-						       &cli_addr)) ==
-		    SLURM_SOCKET_ERROR) {
+		rc = poll(pfds, nfds, timeout);
+		if (rc == -1) {
 			if (errno != EINTR)
-				error("slurm_accept_msg_conn: %m");
-			_free_server_thread();
+				error("%s: poll: %m", __func__);
 			continue;
 		}
-		fd_set_close_on_exec(newsockfd);
-		conn_arg = xmalloc(sizeof(connection_arg_t));
-		conn_arg->newsockfd = newsockfd;
-		memcpy(&conn_arg->cli_addr, &cli_addr, sizeof(slurm_addr_t));
-
-		if (slurmctld_conf.debug_flags & DEBUG_FLAG_PROTOCOL) {
-			char inetbuf[64];
-
-			slurm_print_slurm_addr(&cli_addr,
-						inetbuf,
-						sizeof(inetbuf));
-			info("%s: accept() connection from %s", __func__, inetbuf);
+
+		/* Service connections being read. Work backwards through the
+		 * array so that a completed entry can be replaced by the
+		 * last entry, which has already been processed. */
+		now = time(NULL);
+		for (i = pend_cnt - 1; i >= 0; i--) {
+			pend_ptr = pend[i];
+			if (pfds[i].revents)
+				rc = _read_pending_conn(pend_ptr);
+			else if (pend_ptr->conn->session && !session_read_ok) {
+				/* Not read, so not timed */
+				pend_ptr->start_time = now;
+				rc = 0;
+			} else if (pend_ptr->conn->session &&
+				   (pend_ptr->len_read == 0)) {
+				if ((difftime(now, pend_ptr->start_time) >
+				     CTLD_SESSION_IDLE_TIMEOUT) &&
+				    _session_idle(pend_ptr)) {
+					debug2("%s: closing idle session on "
+					       "fd %d", __func__,
+					       pend_ptr->conn->newsockfd);
+					rc = -1;
+				} else
+					rc = 0;
+			} else if (difftime(now, pend_ptr->start_time) >
+				   msg_timeout) {
+				debug("%s: timeout reading message on fd %d",
+				      __func__, pend_ptr->conn->newsockfd);
+				rc = -1;
+			} else
+				rc = 0;
+			/* Queue the requests a session has sent, until the
+			 * RPC queue or thread count reaches its limit */
+			while ((rc == 1) && pend_ptr->conn->session) {
+				_enqueue_session_msg(pend_ptr);
+				if (!(session_read_ok = _session_read_ok()))
+					rc = 0;
+				else
+					rc = _read_pending_conn(pend_ptr);
+			}
+			if (rc == 0)
+				continue;
+
+			if (rc == 1) {
+				fd_set_blocking(pend_ptr->conn->newsockfd);
+				rpc_queue_enqueue(pend_ptr->conn, pend_ptr->buf,
+						  pend_ptr->msglen);
+				xfree(pend_ptr);
+			} else
+				_abort_pending_conn(pend_ptr);
+			pend[i] = pend[--pend_cnt];
 		}
 
-		if (slurmctld_config.shutdown_time)
-			no_thread = 1;
-		else if (pthread_create(&thread_id_rpc_req,
-					&thread_attr_rpc_req,
-					_service_connection,
-					(void *) conn_arg)) {
-			error("pthread_create: %m");
-			no_thread = 1;
-		} else
-			no_thread = 0;
+		/* Read the requests of new sessions */
+		if (pfds[pend_polled].revents) {
+			while (read(session_pipe[0], pipe_buf,
+				    sizeof(pipe_buf)) > 0)
+				;
+			slurm_mutex_lock(&session_mutex);
+			for (i = 0; i < session_new_cnt; i++) {
+				_add_pending_conn(&pend, &pend_cnt, &pend_size,
+						  session_new[i], now);
+			}
+			session_new_cnt = 0;
+			slurm_mutex_unlock(&session_mutex);
+		}
+		if (!accept_ok)
+			continue;
+
+		/* Accept new connections, starting with a different port
+		 * each time through the loop */
+		for (j = 0; j < nports; j++) {
+			i = (fd_next + j) % nports;
+			if (!(pfds[pend_polled + 1 + i].revents & POLLIN) ||
+			    ((pend_cnt - idle_cnt) >= (int) max_server_threads))
+				continue;
+			/*
+			 * accept needed for stream implementation is a no-op
+			 * in message implementation that just passes sockfd
+			 * to newsockfd
+			 */
+			if ((newsockfd = slurm_accept_msg_conn(sockfd[i],
+							       &cli_addr)) ==
+			    SLURM_SOCKET_ERROR) {
+				if (errno != EINTR)
+					error("slurm_accept_msg_conn: %m");
+				continue;
+			}
+			fd_set_close_on_exec(newsockfd);
+			fd_set_nonblocking(newsockfd);
+			conn_arg = xmalloc(sizeof(connection_arg_t));
+			conn_arg->newsockfd = newsockfd;
+			memcpy(&conn_arg->cli_addr, &cli_addr,
+			       sizeof(slurm_addr_t));
+
+			if (slurmctld_conf.debug_flags & DEBUG_FLAG_PROTOCOL) {
+				char inetbuf[64];
+
+				slurm_print_slurm_addr(&cli_addr,
+							inetbuf,
+							sizeof(inetbuf));
+				info("%s: accept() connection from %s",
+				     __func__, inetbuf);
+			}
 
-		if (no_thread) {
-			slurmctld_diag_stats.proc_req_raw++;
-		       	_service_connection((void *) conn_arg);
-	       	}
+			slurm_mutex_lock(&slurmctld_config.thread_count_lock);
+			slurmctld_config.server_thread_count++;
+			slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
+
+			_add_pending_conn(&pend, &pend_cnt, &pend_size,
+					  conn_arg, now);
+		}
+		fd_next = (fd_next + 1) % nports;
 	}
 
 	debug3("_slurmctld_rpc_mgr shutting down");
-	slurm_attr_destroy(&thread_attr_rpc_req);
 	for (i=0; i<nports; i++)
 		(void) slurm_shutdown_msg_engine(sockfd[i]);
 	xfree(sockfd);
+	for (i = 0; i < pend_cnt; i++)
+		_abort_pending_conn(pend[i]);
+	xfree(pend);
+	xfree(pfds);
 	_free_server_thread();
+	/* Let the workers finish RPCs already read, including any
+	 * REQUEST_CONTROL waiting for the server thread count to drop */
+	rpc_queue_fini();
+	for (i = 0; i < session_new_cnt; i++) {
+		_unref_session(session_new[i]->session);
+		xfree(session_new[i]);
+	}
+	session_new_cnt = 0;
+	(void) close(session_pipe[0]);
+	(void) close(session_pipe[1]);
+	session_pipe[0] = session_pipe[1] = -1;
 	pthread_exit((void *) 0);
 	return NULL;
 }
 
 /*
- * _service_connection - service the RPC
- * IN/OUT arg - really just the connection's file descriptor, freed
+ * _service_connection - service an RPC read by _slurmctld_rpc_mgr(),
+ *	called by an RPC worker thread
+ * IN/OUT rec - the queued RPC, its connection and message data are freed
  *	upon completion
- * RET - NULL
  */
-static void *_service_connection(void *arg)
+static void _service_connection(rpc_queue_rec_t *rec)
 {
-	connection_arg_t *conn = (connection_arg_t *) arg;
-	void *return_code = NULL;
+	connection_arg_t *conn = rec->conn;
+	ctld_session_t *session = conn->session;
 	slurm_msg_t *msg = xmalloc(sizeof(slurm_msg_t));
+	uint32_t reply_cnt = 1;
 
-#if HAVE_SYS_PRCTL_H
-	if (prctl(PR_SET_NAME, "slurmctld_srvcn", NULL, NULL, NULL) < 0) {
-		error("%s: cannot set my name to %s %m",
-		      __func__, "slurmctld_srvcn");
-	}
-#endif
 	slurm_msg_t_init(msg);
 	/*
-	 * slurm_receive_msg sets msg connection fd to accepted fd. This allows
-	 * possibility for slurmctld_req() to close accepted connection.
+	 * A session's requests carry no credential, its replies are sent
+	 * with the request's msg_id and without a credential.
 	 */
-	if (slurm_receive_msg(conn->newsockfd, msg, 0) != 0) {
+	if (session) {
+		if (slurm_unpack_session_msg(msg, conn->newsockfd, rec->buf,
+					     rec->buflen) != 0) {
+			error("slurm_unpack_session_msg: %m");
+			reply_cnt = 0;
+			goto cleanup;
+		}
+		msg->auth_cred = session->cred;
+		slurm_set_session_reply(conn->newsockfd, msg->msg_id,
+					&session->write_lock);
+	/*
+	 * slurm_unpack_received_msg sets msg connection fd to accepted fd.
+	 * This allows possibility for slurmctld_req() to close accepted
+	 * connection.
+	 */
+	} else if (slurm_unpack_received_msg(msg, conn->newsockfd, rec->buf,
+					     rec->buflen) != 0) {
 		error("slurm_receive_msg: %m");
 		/* close the new socket */
 		slurm_close(conn->newsockfd);
@@ -1073,58 +1495,30 @@ static void *_service_connection(void *arg)
 		/* process the request */
 		slurmctld_req(msg, conn);
 	}
-	if ((conn->newsockfd >= 0)
-	    && slurm_close(conn->newsockfd) < 0)
+
+	if (session) {
+		reply_cnt = slurm_get_session_reply_cnt();
+		slurm_set_session_reply(-1, 0, NULL);
+		msg->auth_cred = NULL;	/* kept by the session */
+	} else if (conn->session_cred) {
+		msg->auth_cred = NULL;	/* kept by the new session */
+		_start_session(conn);
+		conn = NULL;
+	} else if ((conn->newsockfd >= 0)
+		   && slurm_close(conn->newsockfd) < 0)
 		error ("close(%d): %m",  conn->newsockfd);
 
 cleanup:
 	slurm_free_msg(msg);
-	xfree(arg);
+	if (session) {
+		/* The client waits for exactly one response to each
+		 * request, so end the session if that was not sent */
+		if (reply_cnt != 1)
+			(void) shutdown(session->fd, SHUT_RDWR);
+		_unref_session(session);
+	}
+	xfree(conn);
 	_free_server_thread();
-	return return_code;
-}
-
-/* Increment slurmctld_config.server_thread_count and don't return
- * until its value is no larger than MAX_SERVER_THREADS,
- * RET true unless shutdown in progress */
-static bool _wait_for_server_thread(void)
-{
-	bool print_it = true;
-	bool rc = true;
-
-	slurm_mutex_lock(&slurmctld_config.thread_count_lock);
-	while (1) {
-		if (slurmctld_config.shutdown_time) {
-			rc = false;
-			break;
-		}
-		if (slurmctld_config.server_thread_count < max_server_threads) {
-			slurmctld_config.server_thread_count++;
-			break;
-		} else {
-			/* wait for state change and retry,
-			 * just a delay and not an error.
-			 * This can happen when the epilog completes
-			 * on a bunch of nodes at the same time, which
-			 * can easily happen for highly parallel jobs. */
-			if (print_it) {
-				static time_t last_print_time = 0;
-				time_t now = time(NULL);
-				if (difftime(now, last_print_time) > 2) {
-					verbose("server_thread_count over "
-						"limit (%d), waiting",
-						slurmctld_config.
-						server_thread_count);
-					last_print_time = now;
-				}
-				print_it = false;
-			}
-			pthread_cond_wait(&server_thread_cond,
-					  &slurmctld_config.thread_count_lock);
-		}
-	}
-	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
-	return rc;
 }
 
 static void _free_server_thread(void)
@@ -1134,7 +1528,6 @@ static void _free_server_thread(void)
 		slurmctld_config.server_thread_count--;
 	else
 		error("slurmctld_config.server_thread_count underflow");
-	pthread_cond_broadcast(&server_thread_cond);
 	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
 }
 
@@ -1243,15 +1636,41 @@ static void _update_assoc(slurmdb_assoc_rec_t *rec)
 {
 	ListIterator job_iterator;
 	struct job_record *job_ptr;
+	slurmdb_assoc_rec_t *assoc_ptr;
+	List run_job_list;
 	/* Write lock on jobs */
 	slurmctld_lock_t job_write_lock =
 		{ NO_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK };
+	assoc_mgr_lock_t locks = { READ_LOCK, NO_LOCK,
+				   NO_LOCK, NO_LOCK, NO_LOCK };
 
 	if (!job_list || !accounting_enforce
 	    || !(accounting_enforce & ACCOUNTING_ENFORCE_LIMITS))
 		return;
 
 	lock_slurmctld(job_write_lock);
+	/* Limits of parent associations apply to running jobs, whose time
+	 * limit checks are queued once the association lock is released */
+	run_job_list = list_create(NULL);
+	assoc_mgr_lock(&locks);
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = list_next(job_iterator))) {
+		if (!IS_JOB_RUNNING(job_ptr))
+			continue;
+		for (assoc_ptr = job_ptr->assoc_ptr; assoc_ptr;
+		     assoc_ptr = assoc_ptr->usage->parent_assoc_ptr) {
+			if (assoc_ptr == rec) {
+				list_append(run_job_list, job_ptr);
+				break;
+			}
+		}
+	}
+	list_iterator_destroy(job_iterator);
+	assoc_mgr_unlock(&locks);
+	while ((job_ptr = list_pop(run_job_list)))
+		queue_job_time_check(job_ptr);
+	list_destroy(run_job_list);
+
 	job_iterator = list_iterator_create(job_list);
 	while ((job_ptr = list_next(job_iterator))) {
 		if ((rec != job_ptr->assoc_ptr) || (!IS_JOB_PENDING(job_ptr)))
@@ -1278,7 +1697,13 @@ static void _update_qos(slurmdb_qos_rec_t *rec)
 	lock_slurmctld(job_write_lock);
 	job_iterator = list_iterator_create(job_list);
 	while ((job_ptr = list_next(job_iterator))) {
-		if ((rec != job_ptr->qos_ptr) || (!IS_JOB_PENDING(job_ptr)))
+		if (rec != job_ptr->qos_ptr)
+			continue;
+		if (IS_JOB_RUNNING(job_ptr)) {
+			queue_job_time_check(job_ptr);
+			continue;
+		}
+		if (!IS_JOB_PENDING(job_ptr))
 			continue;
 
 		acct_policy_update_pending_job(job_ptr);
@@ -1343,6 +1768,7 @@ static void _queue_reboot_msg(void)
 		bit_clear(avail_node_bitmap, i);
 		bit_clear(idle_node_bitmap, i);
 		node_ptr->last_response = now;
+		node_changed(node_ptr, now);
 	}
 	if (reboot_agent_args != NULL) {
 		hostlist_uniq(reboot_agent_args->hostlist);
@@ -68,6 +68,7 @@
 #include "src/common/forward.h"
 #include "src/common/gres.h"
 #include "src/common/hostlist.h"
+#include "src/common/lhash.h"
 #include "src/common/node_select.h"
 #include "src/common/parse_time.h"
 #include "src/common/slurm_accounting_storage.h"
@@ -103,15 +104,32 @@
 #define STEP_FLAG 0xbbbb
 #define TOP_PRIORITY 0xffff0000	/* large, but leave headroom for higher */
 
-#define JOB_HASH_INX(_job_id)	(_job_id % hash_table_size)
-#define JOB_ARRAY_HASH_INX(_job_id, _task_id) \
-	((_job_id + _task_id) % hash_table_size)
+#define JOB_HASH_MIN_SIZE	1024	/* initial buckets in job hash tables */
 
 /* No need to change we always pack SLURM_PROTOCOL_VERSION */
 #define JOB_STATE_VERSION       "PROTOCOL_VERSION"
 
 #define JOB_CKPT_VERSION      "PROTOCOL_VERSION"
 
+/* The job state snapshot and journal, see dump_all_job_state() */
+#define JOB_SNAPSHOT_VERSION	"JOB_SNAPSHOT_VERSION"
+#define JOB_JOURNAL_VERSION	"JOB_JOURNAL_VERSION"
+#define JOB_JOURNAL_MIN_SIZE	(1024 * 1024)	/* bytes before compaction */
+#define JOB_JOURNAL_UPDATE	1	/* job state record follows */
+#define JOB_JOURNAL_DELETE	2	/* job purged */
+#define JOB_JOURNAL_SEQUENCE	3	/* new value of job_id_sequence */
+/* Bytes before the record type: record length and digest */
+#define JOB_JOURNAL_FRAME_SIZE	(sizeof(uint32_t) + sizeof(uint64_t))
+
+/* Recovered job records are unpacked by up to JOB_RECOVER_THREADS threads,
+ * each with at least JOB_RECOVER_PER_THREAD records to unpack */
+#define JOB_RECOVER_THREADS	8
+#define JOB_RECOVER_PER_THREAD	1000
+#define JOB_RECOVER_CHUNK	64	/* records taken by a thread at once */
+
+/* Seconds for which the IDs of purged jobs are kept for delta job info */
+#define JOB_TOMBSTONE_AGE	600
+
 typedef struct {
 	int resp_array_cnt;
 	int resp_array_size;
@@ -119,6 +137,48 @@ typedef struct {
 	bitstr_t **resp_array_task_id;
 } resp_array_struct_t;
 
+typedef struct {
+	uint32_t job_id;
+	time_t purge_time;
+} job_tombstone_t;
+
+typedef struct {
+	uint32_t job_id;
+	uint16_t type;		/* JOB_JOURNAL_UPDATE or JOB_JOURNAL_DELETE */
+	uint32_t offset;	/* offset of job state record in journal */
+	uint32_t order;		/* position of record in journal */
+} job_journal_rec_t;
+
+/* Job due for a time limit or purge check. Entries are not removed when a
+ * job is queued again or purged, but ignored once they no longer match the
+ * job's time_check or purge_check. */
+typedef struct {
+	time_t due;
+	uint32_t job_id;
+} job_time_rec_t;
+
+typedef struct {
+	job_time_rec_t *rec;	/* binary min-heap ordered by due time */
+	uint32_t rec_cnt;
+	uint32_t rec_size;
+} job_time_heap_t;
+
+typedef struct {
+	Buf buffer;		/* snapshot or journal contents */
+	uint32_t offset;	/* offset of job state record in buffer */
+	uint16_t protocol_version;
+	struct job_record *job_ptr;	/* job unpacked by a thread */
+	int rc;
+} job_recover_rec_t;
+
+typedef struct {
+	job_recover_rec_t *rec;
+	uint32_t rec_cnt;
+	uint32_t rec_size;
+	uint32_t next_rec;	/* next record for a thread to unpack */
+	pthread_mutex_t mutex;
+} job_recover_t;
+
 /* Global variables */
 List   job_list = NULL;		/* job_record list */
 time_t last_job_update;		/* time of last update to job records */
@@ -126,18 +186,30 @@ time_t last_job_update;		/* time of last update to job records */
 /* Local variables */
 static uint32_t highest_prio = 0;
 static uint32_t lowest_prio  = TOP_PRIORITY;
-static int      hash_table_size = 0;
 static int      job_count = 0;		/* job's in the system */
 static uint32_t job_id_sequence = 0;	/* first job_id to assign new job */
-static struct   job_record **job_hash = NULL;
-static struct   job_record **job_array_hash_j = NULL;
-static struct   job_record **job_array_hash_t = NULL;
+static lhash_t  *job_hash = NULL;		/* by job_id */
+static lhash_t  *job_array_hash_j = NULL;	/* by array_job_id */
+static lhash_t  *job_array_hash_t = NULL;	/* by array job and task ID */
+static job_time_heap_t job_time_heap;	/* running jobs by next time check */
+static job_time_heap_t job_purge_heap;	/* finished jobs by purge time */
 static time_t   last_file_write_time = (time_t) 0;
 static uint32_t max_array_size = NO_VAL;
 static int	select_serial = -1;
 static bool     wiki_sched = false;
 static bool     wiki2_sched = false;
 static bool     wiki_sched_test = false;
+static pthread_mutex_t job_pack_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t job_all_change_cnt = 0;	/* count of changes to the
+					 * information of any job */
+static List	job_tombstone_list = NULL;
+static time_t	job_tombstone_horizon = (time_t) 0;
+static pthread_mutex_t job_journal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static List	job_journal_purge_list = NULL;	/* IDs of purged jobs */
+static bool	job_snapshot_needed = true;
+static uint32_t job_snapshot_size = 0, job_journal_size = 0;
+static uint32_t job_journal_sequence = 0;
+static uint32_t job_snapshot_seq = 0;	/* count of snapshots written */
 static uint32_t num_exit;
 static int32_t  *requeue_exit;
 static uint32_t num_hold;
@@ -146,6 +218,8 @@ static int32_t  *requeue_exit_hold;
 /* Local functions */
 static void _add_job_hash(struct job_record *job_ptr);
 static void _add_job_array_hash(struct job_record *job_ptr);
+static void _add_job_journal_purge(uint32_t job_id);
+static void _add_job_tombstone(uint32_t job_id);
 static int  _checkpoint_job_record (struct job_record *job_ptr,
 				    char *image_dir);
 static int  _copy_job_desc_files(uint32_t job_id_src, uint32_t job_id_dest);
@@ -159,9 +233,11 @@ static int _copy_job_file(const char *src, const char *dst);
 static job_desc_msg_t * _copy_job_record_to_job_desc(
 				struct job_record *job_ptr);
 static char *_copy_nodelist_no_dup(char *node_list);
+static struct job_record *_alloc_job_record(void);
 static struct job_record *_create_job_record(int *error_code,
 					     uint32_t num_jobs);
 static void _del_batch_list_rec(void *x);
+static void _del_job_tombstone(void *x);
 static void _delete_job_desc_files(uint32_t job_id);
 static slurmdb_qos_rec_t *_determine_and_validate_qos(
 	char *resv_name, slurmdb_assoc_rec_t *assoc_ptr,
@@ -169,6 +245,7 @@ static slurmdb_qos_rec_t *_determine_and_validate_qos(
 static void _dump_job_details(struct job_details *detail_ptr,
 			      Buf buffer);
 static void _dump_job_state(struct job_record *dump_job_ptr, Buf buffer);
+static void _free_job_record(struct job_record *job_ptr);
 static int  _find_batch_dir(void *x, void *key);
 static void _get_batch_job_dir_ids(List batch_dirs);
 static time_t _get_last_state_write_time(void);
@@ -178,11 +255,19 @@ static int  _job_create(job_desc_msg_t * job_specs, int allocate, int will_run,
 			struct job_record **job_rec_ptr, uid_t submit_uid,
 			char **err_msg);
 static void _list_delete_job(void *job_entry);
+static void _free_job_pack_cache(struct job_record *job_ptr);
 static int  _list_find_job_id(void *job_entry, void *key);
 static int  _list_find_job_old(void *job_entry, void *key);
 static int  _load_job_details(struct job_record *job_ptr, Buf buffer,
 			      uint16_t protocol_version);
-static int  _load_job_state(Buf buffer,	uint16_t protocol_version);
+static void _load_job_finish(struct job_record *job_ptr);
+static struct job_record *_load_job_record(uint32_t job_id,
+					   uint32_t array_job_id,
+					   uint32_t array_task_id,
+					   bool detached);
+static int  _load_job_state(Buf buffer,	uint16_t protocol_version,
+			    struct job_record **job_pptr);
+static int  _recover_job_recs(job_recover_t *recover, int *job_cnt);
 static int32_t *_make_requeue_array(char *conf_buf, uint32_t *num);
 static uint32_t _max_switch_wait(uint32_t input_wait);
 static void _notify_srun_missing_step(struct job_record *job_ptr, int node_inx,
@@ -190,10 +275,10 @@ static void _notify_srun_missing_step(struct job_record *job_ptr, int node_inx,
 static int  _open_job_state_file(char **state_file);
 static void _pack_job_for_ckpt (struct job_record *job_ptr, Buf buffer);
 static void _pack_default_job_details(struct job_record *job_ptr,
-				      Buf buffer,
+				      uint32_t field_mask, Buf buffer,
 				      uint16_t protocol_version);
 static void _pack_pending_job_details(struct job_details *detail_ptr,
-				      Buf buffer,
+				      uint32_t field_mask, Buf buffer,
 				      uint16_t protocol_version);
 static bool _parse_array_tok(char *tok, bitstr_t *array_bitmap, uint32_t max);
 static int  _purge_job_record(uint32_t job_id);
@@ -434,7 +519,6 @@ static job_array_resp_msg_t *_resp_array_xlate(resp_array_struct_t *resp,
 static struct job_record *_create_job_record(int *error_code, uint32_t num_jobs)
 {
 	struct job_record  *job_ptr;
-	struct job_details *detail_ptr;
 
 	if ((job_count + num_jobs) >= slurmctld_conf.max_job_cnt) {
 		error("_create_job_record: MaxJobCount reached (%u)",
@@ -443,7 +527,22 @@ static struct job_record *_create_job_record(int *error_code, uint32_t num_jobs)
 
 	job_count += num_jobs;
 	*error_code = 0;
-	last_job_update = time(NULL);
+
+	job_ptr = _alloc_job_record();
+	job_changed(job_ptr, time(NULL));
+	(void) list_append(job_list, job_ptr);
+
+	return job_ptr;
+}
+
+/*
+ * _alloc_job_record - allocate a job record and its job_details, which are
+ *	not yet added to the job list or counted
+ */
+static struct job_record *_alloc_job_record(void)
+{
+	struct job_record  *job_ptr;
+	struct job_details *detail_ptr;
 
 	job_ptr    = (struct job_record *) xmalloc(sizeof(struct job_record));
 	detail_ptr = (struct job_details *)xmalloc(sizeof(struct job_details));
@@ -458,7 +557,40 @@ static struct job_record *_create_job_record(int *error_code, uint32_t num_jobs)
 	detail_ptr->submit_time = time(NULL);
 	job_ptr->requid = -1; /* force to -1 for sacct to know this
 			       * hasn't been set yet  */
-	(void) list_append(job_list, job_ptr);
+
+	return job_ptr;
+}
+
+/*
+ * _load_job_record - find or create the record of a job being loaded from
+ *	state save
+ * IN detached - create a record which is not yet in the job list or hash
+ *	tables, used when recovering jobs in parallel. The record is counted
+ *	and stamped as changed by _recover_job_recs().
+ * RET job record
+ * NOTE: Jobs are recovered even beyond MaxJobCount, which is checked once
+ *	all are loaded, see _check_max_job_cnt()
+ */
+static struct job_record *_load_job_record(uint32_t job_id,
+					   uint32_t array_job_id,
+					   uint32_t array_task_id,
+					   bool detached)
+{
+	struct job_record *job_ptr;
+
+	if (detached) {
+		job_ptr = _alloc_job_record();
+	} else if ((job_ptr = find_job_record(job_id))) {
+		return job_ptr;
+	} else {
+		job_ptr = _alloc_job_record();
+		job_count++;
+		job_changed(job_ptr, time(NULL));
+		(void) list_append(job_list, job_ptr);
+	}
+	job_ptr->job_id = job_id;
+	job_ptr->array_job_id = array_job_id;
+	job_ptr->array_task_id = array_task_id;
 
 	return job_ptr;
 }
@@ -641,85 +773,270 @@ static slurmdb_qos_rec_t *_determine_and_validate_qos(
 	return qos_ptr;
 }
 
-/*
- * dump_all_job_state - save the state of all jobs to file for checkpoint
- *	Changes here should be reflected in load_last_job_id() and
- *	load_all_job_state().
- * RET 0 or error code */
-int dump_all_job_state(void)
+/* Return true if a job is ready for purging and needs no state saved */
+static bool _job_purge_ready(struct job_record *job_ptr, time_t min_age)
+{
+	if ((min_age > 0) && (job_ptr->end_time < min_age) &&
+	    (! IS_JOB_COMPLETING(job_ptr)) && IS_JOB_FINISHED(job_ptr))
+		return true;
+	return false;
+}
+
+/* Pack the start of a job state snapshot or journal record. The record's
+ * length and digest are filled in by _pack_journal_rec_end().
+ * RET offset of the record in the buffer */
+static uint32_t _pack_journal_rec_start(uint16_t type, uint32_t id,
+					Buf buffer)
+{
+	uint32_t offset = get_buf_offset(buffer);
+
+	pack32((uint32_t) 0, buffer);	/* record length */
+	pack64((uint64_t) 0, buffer);	/* record digest */
+	pack16(type, buffer);
+	pack32(id, buffer);
+
+	return offset;
+}
+
+/* Complete the record started at offset by _pack_journal_rec_start()
+ * RET digest of the record */
+static uint64_t _pack_journal_rec_end(uint32_t offset, Buf buffer)
+{
+	uint32_t end = get_buf_offset(buffer);
+	uint32_t start = offset + JOB_JOURNAL_FRAME_SIZE;
+	uint64_t digest = get_buf_digest(buffer, start);
+
+	set_buf_offset(buffer, offset);
+	pack32(end - start, buffer);
+	pack64(digest, buffer);
+	set_buf_offset(buffer, end);
+
+	return digest;
+}
+
+/* Unpack the start of a job state snapshot or journal record. A record
+ * which is truncated or fails its digest check is rejected.
+ * OUT type - JOB_JOURNAL_* record type
+ * OUT id - job ID or job_id_sequence, depending upon type
+ * OUT rec_end - offset of the next record in the buffer
+ * RET SLURM_SUCCESS or SLURM_ERROR */
+static int _unpack_journal_rec(Buf buffer, uint16_t *type, uint32_t *id,
+			       uint32_t *rec_end)
+{
+	uint32_t rec_len, start;
+	uint64_t digest;
+
+	safe_unpack32(&rec_len, buffer);
+	safe_unpack64(&digest, buffer);
+	start = get_buf_offset(buffer);
+	if (rec_len > remaining_buf(buffer))
+		goto unpack_error;
+	set_buf_offset(buffer, start + rec_len);
+	if (get_buf_digest(buffer, start) != digest)
+		goto unpack_error;
+	set_buf_offset(buffer, start);
+	safe_unpack16(type, buffer);
+	safe_unpack32(id, buffer);
+	*rec_end = start + rec_len;
+	if (get_buf_offset(buffer) > *rec_end)
+		goto unpack_error;
+	return SLURM_SUCCESS;
+
+unpack_error:
+	return SLURM_ERROR;
+}
+
+/* Pack a job's state as a snapshot or journal record and note the digest
+ * of the job's state saved */
+static void _pack_job_rec(struct job_record *job_ptr, Buf buffer)
+{
+	uint32_t offset;
+
+	offset = _pack_journal_rec_start(JOB_JOURNAL_UPDATE, job_ptr->job_id,
+					 buffer);
+	_dump_job_state(job_ptr, buffer);
+	job_ptr->save_digest = _pack_journal_rec_end(offset, buffer);
+}
+
+/* Pack a snapshot of all job state, which replaces the job state journal.
+ * Call with job read lock and job_journal_mutex set. */
+static Buf _pack_job_snapshot(time_t now, time_t min_age)
 {
 	/* Save high-water mark to avoid buffer growth with copies */
 	static int high_buffer_size = (1024 * 1024);
-	int error_code = SLURM_SUCCESS, log_fd;
-	char *old_file, *new_file, *reg_file;
-	struct stat stat_buf;
-	/* Locks: Read config and job */
-	slurmctld_lock_t job_read_lock =
-		{ READ_LOCK, READ_LOCK, NO_LOCK, NO_LOCK };
 	ListIterator job_iterator;
 	struct job_record *job_ptr;
 	Buf buffer = init_buf(high_buffer_size);
-	time_t min_age = 0, now = time(NULL);
-	time_t last_state_file_time;
-	DEF_TIMERS;
-
-	START_TIMER;
-	/* Check that last state file was written at expected time.
-	 * This is a check for two slurmctld daemons running at the same
-	 * time in primary mode (a split-brain problem). */
-	last_state_file_time = _get_last_state_write_time();
-	if (last_file_write_time && last_state_file_time &&
-	    (last_file_write_time != last_state_file_time)) {
-		error("Bad job state save file time. We wrote it at time %u, "
-		      "but the file contains a time stamp of %u.",
-		      (uint32_t) last_file_write_time,
-		      (uint32_t) last_state_file_time);
-		if (slurmctld_primary == 0) {
-			fatal("Two slurmctld daemons are running as primary. "
-			      "Shutting down this daemon to avoid inconsistent "
-			      "state due to split brain.");
-		}
-	}
 
 	/* write header: version, time */
-	packstr(JOB_STATE_VERSION, buffer);
+	packstr(JOB_SNAPSHOT_VERSION, buffer);
 	pack16(SLURM_PROTOCOL_VERSION, buffer);
 	pack_time(now, buffer);
 
-	if (slurmctld_conf.min_job_age > 0)
-		min_age = now  - slurmctld_conf.min_job_age;
-
 	/*
 	 * write header: job id
 	 * This is needed so that the job id remains persistent even after
 	 * slurmctld is restarted.
 	 */
 	pack32( job_id_sequence, buffer);
+	job_journal_sequence = job_id_sequence;
+
+	/* write header: snapshot sequence number, matched by the journal */
+	pack32(job_snapshot_seq + 1, buffer);
 
 	debug3("Writing job id %u to header record of job_state file",
 	       job_id_sequence);
 
 	/* write individual job records */
-	lock_slurmctld(job_read_lock);
 	job_iterator = list_iterator_create(job_list);
 	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
 		xassert (job_ptr->magic == JOB_MAGIC);
-		if ((min_age > 0) && (job_ptr->end_time < min_age) &&
-		    (! IS_JOB_COMPLETING(job_ptr)) && IS_JOB_FINISHED(job_ptr))
+		if (_job_purge_ready(job_ptr, min_age)) {
+			job_ptr->save_digest = 0;
 			continue;	/* job ready for purging, don't dump */
+		}
+		_pack_job_rec(job_ptr, buffer);
+	}
+	list_iterator_destroy(job_iterator);
+	if (job_journal_purge_list)
+		list_flush(job_journal_purge_list);
+
+	high_buffer_size = MAX(get_buf_offset(buffer), high_buffer_size);
+	return buffer;
+}
+
+/* Pack journal records for the jobs created, modified or purged since the
+ * last snapshot or journal write. Each job's state is packed, but kept only
+ * if it differs from the state last written for the job, so no change to
+ * the job can be missed.
+ * Call with job read lock and job_journal_mutex set. */
+static Buf _pack_job_journal(time_t min_age)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	uint32_t *job_id_ptr, offset;
+	uint64_t save_digest;
+	Buf buffer = init_buf(BUF_SIZE);
+
+	if (job_journal_purge_list) {
+		while ((job_id_ptr = list_pop(job_journal_purge_list))) {
+			offset = _pack_journal_rec_start(JOB_JOURNAL_DELETE,
+							 *job_id_ptr, buffer);
+			(void) _pack_journal_rec_end(offset, buffer);
+			xfree(job_id_ptr);
+		}
+	}
 
-		_dump_job_state(job_ptr, buffer);
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		xassert (job_ptr->magic == JOB_MAGIC);
+		if (_job_purge_ready(job_ptr, min_age)) {
+			if (job_ptr->save_digest) {
+				offset = _pack_journal_rec_start(
+					JOB_JOURNAL_DELETE, job_ptr->job_id,
+					buffer);
+				(void) _pack_journal_rec_end(offset, buffer);
+				job_ptr->save_digest = 0;
+			}
+			continue;
+		}
+		offset = get_buf_offset(buffer);
+		save_digest = job_ptr->save_digest;
+		_pack_job_rec(job_ptr, buffer);
+		if (job_ptr->save_digest == save_digest)
+			set_buf_offset(buffer, offset);	/* state unchanged */
 	}
 	list_iterator_destroy(job_iterator);
 
-	/* write the buffer to file */
-	old_file = xstrdup(slurmctld_conf.state_save_location);
+	if (job_journal_sequence != job_id_sequence) {
+		offset = _pack_journal_rec_start(JOB_JOURNAL_SEQUENCE,
+						 job_id_sequence, buffer);
+		(void) _pack_journal_rec_end(offset, buffer);
+		job_journal_sequence = job_id_sequence;
+	}
+
+	return buffer;
+}
+
+/* Write a buffer's contents to a state save file
+ * RET 0 or error code */
+static int _write_state_buf(int fd, char *file_name, Buf buffer)
+{
+	int pos = 0, nwrite, amount;
+	char *data;
+
+	nwrite = get_buf_offset(buffer);
+	data = (char *)get_buf_data(buffer);
+	while (nwrite > 0) {
+		amount = write(fd, &data[pos], nwrite);
+		if ((amount < 0) && (errno != EINTR)) {
+			error("Error writing file %s, %m", file_name);
+			return errno;
+		}
+		if (amount < 0)
+			continue;
+		nwrite -= amount;
+		pos    += amount;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+/* Create an empty job state journal following the job state snapshot with
+ * the given time stamp and sequence number.
+ * Call with job_journal_mutex and state files locked.
+ * RET 0 or error code */
+static int _create_job_journal(char *state_dir, time_t snapshot_time,
+			       uint32_t snapshot_seq)
+{
+	int error_code, log_fd, rc;
+	char *journal_file;
+	Buf buffer = init_buf(BUF_SIZE);
+
+	/* write header: version, time and sequence number of snapshot
+	 * replayed onto */
+	packstr(JOB_JOURNAL_VERSION, buffer);
+	pack16(SLURM_PROTOCOL_VERSION, buffer);
+	pack_time(snapshot_time, buffer);
+	pack32(snapshot_seq, buffer);
+
+	journal_file = xstrdup(state_dir);
+	xstrcat(journal_file, "/job_state.journal");
+	log_fd = creat(journal_file, 0600);
+	if (log_fd < 0) {
+		error("Can't save state, create file %s error %m",
+		      journal_file);
+		error_code = errno;
+	} else {
+		fd_set_close_on_exec(log_fd);
+		error_code = _write_state_buf(log_fd, journal_file, buffer);
+		rc = fsync_and_close(log_fd, "job journal");
+		if (rc && !error_code)
+			error_code = rc;
+	}
+	if (!error_code)
+		job_journal_size = get_buf_offset(buffer);
+	xfree(journal_file);
+	free_buf(buffer);
+
+	return error_code;
+}
+
+/* Write a job state snapshot and start a new journal following it.
+ * Call with job_journal_mutex set.
+ * RET 0 or error code */
+static int _write_job_snapshot(Buf buffer, time_t now, char *state_dir)
+{
+	int error_code = SLURM_SUCCESS, log_fd, rc;
+	char *old_file, *new_file, *reg_file;
+	struct stat stat_buf;
+
+	old_file = xstrdup(state_dir);
 	xstrcat(old_file, "/job_state.old");
-	reg_file = xstrdup(slurmctld_conf.state_save_location);
+	reg_file = xstrdup(state_dir);
 	xstrcat(reg_file, "/job_state");
-	new_file = xstrdup(slurmctld_conf.state_save_location);
+	new_file = xstrdup(state_dir);
 	xstrcat(new_file, "/job_state.new");
-	unlock_slurmctld(job_read_lock);
 
 	if (stat(reg_file, &stat_buf) == 0) {
 		static time_t last_mtime = (time_t) 0;
@@ -743,24 +1060,8 @@ int dump_all_job_state(void)
 		      new_file);
 		error_code = errno;
 	} else {
-		int pos = 0, nwrite, amount, rc;
-		char *data;
-
 		fd_set_close_on_exec(log_fd);
-		nwrite = get_buf_offset(buffer);
-		data = (char *)get_buf_data(buffer);
-		high_buffer_size = MAX(nwrite, high_buffer_size);
-		while (nwrite > 0) {
-			amount = write(log_fd, &data[pos], nwrite);
-			if ((amount < 0) && (errno != EINTR)) {
-				error("Error writing file %s, %m", new_file);
-				error_code = errno;
-				break;
-			}
-			nwrite -= amount;
-			pos    += amount;
-		}
-
+		error_code = _write_state_buf(log_fd, new_file, buffer);
 		rc = fsync_and_close(log_fd, "job");
 		if (rc && !error_code)
 			error_code = rc;
@@ -778,12 +1079,140 @@ int dump_all_job_state(void)
 			       new_file, reg_file);
 		(void) unlink(new_file);
 		last_file_write_time = now;
+		job_snapshot_seq++;
+
+		/* A journal left from an older snapshot is ignored on
+		 * recovery, so a failure here loses nothing written */
+		error_code = _create_job_journal(state_dir, now,
+						 job_snapshot_seq);
+	}
+	if (!error_code) {
+		job_snapshot_needed = false;
+		job_snapshot_size = get_buf_offset(buffer);
 	}
 	xfree(old_file);
 	xfree(reg_file);
 	xfree(new_file);
 	unlock_state_files();
 
+	return error_code;
+}
+
+/* Append records to the job state journal with a single write and fsync.
+ * Call with job_journal_mutex set.
+ * RET 0 or error code */
+static int _write_job_journal(Buf buffer, char *state_dir)
+{
+	int error_code = SLURM_SUCCESS, log_fd, rc;
+	char *journal_file;
+	struct stat stat_buf;
+
+	journal_file = xstrdup(state_dir);
+	xstrcat(journal_file, "/job_state.journal");
+
+	lock_state_files();
+	log_fd = open(journal_file, O_WRONLY | O_APPEND);
+	if (log_fd < 0) {
+		error("Can't save state, open file %s error %m",
+		      journal_file);
+		error_code = errno;
+	} else if ((fstat(log_fd, &stat_buf) == 0) &&
+		   (stat_buf.st_size != job_journal_size)) {
+		/* Another slurmctld wrote to the journal (split brain) */
+		error("Bad job state journal size. We wrote %u bytes, "
+		      "but the file contains %u bytes.",
+		      job_journal_size, (uint32_t) stat_buf.st_size);
+		if (slurmctld_primary == 0) {
+			fatal("Two slurmctld daemons are running as primary. "
+			      "Shutting down this daemon to avoid inconsistent "
+			      "state due to split brain.");
+		}
+		(void) close(log_fd);
+		error_code = EIO;
+	} else {
+		fd_set_close_on_exec(log_fd);
+		error_code = _write_state_buf(log_fd, journal_file, buffer);
+		rc = fsync_and_close(log_fd, "job journal");
+		if (rc && !error_code)
+			error_code = rc;
+	}
+	unlock_state_files();
+
+	/* A partially written record would end replay of the journal, so
+	 * replace the journal with a new snapshot on the next save */
+	if (error_code)
+		job_snapshot_needed = true;
+	else
+		job_journal_size += get_buf_offset(buffer);
+	xfree(journal_file);
+
+	return error_code;
+}
+
+/*
+ * dump_all_job_state - save the state of all jobs to file for checkpoint.
+ *	Records of jobs created, modified or purged since the last save are
+ *	appended to the job_state.journal file. Once the journal grows larger
+ *	than the last snapshot, a complete snapshot is written to job_state
+ *	and the journal emptied.
+ *	Changes here should be reflected in load_last_job_id() and
+ *	load_all_job_state().
+ * RET 0 or error code */
+int dump_all_job_state(void)
+{
+	int error_code = SLURM_SUCCESS;
+	char *state_dir;
+	/* Locks: Read config and job */
+	slurmctld_lock_t job_read_lock =
+		{ READ_LOCK, READ_LOCK, NO_LOCK, NO_LOCK };
+	Buf buffer;
+	bool snapshot;
+	time_t min_age = 0, now = time(NULL);
+	time_t last_state_file_time;
+	DEF_TIMERS;
+
+	START_TIMER;
+	/* Check that last state file was written at expected time.
+	 * This is a check for two slurmctld daemons running at the same
+	 * time in primary mode (a split-brain problem). The journal's
+	 * size is checked likewise by _write_job_journal(). */
+	last_state_file_time = _get_last_state_write_time();
+	if (last_file_write_time && last_state_file_time &&
+	    (last_file_write_time != last_state_file_time)) {
+		error("Bad job state save file time. We wrote it at time %u, "
+		      "but the file contains a time stamp of %u.",
+		      (uint32_t) last_file_write_time,
+		      (uint32_t) last_state_file_time);
+		if (slurmctld_primary == 0) {
+			fatal("Two slurmctld daemons are running as primary. "
+			      "Shutting down this daemon to avoid inconsistent "
+			      "state due to split brain.");
+		}
+	}
+
+	if (slurmctld_conf.min_job_age > 0)
+		min_age = now  - slurmctld_conf.min_job_age;
+
+	lock_slurmctld(job_read_lock);
+	/* Records must reach the journal in the order packed */
+	slurm_mutex_lock(&job_journal_mutex);
+	snapshot = job_snapshot_needed ||
+		   (job_journal_size > MAX(job_snapshot_size,
+					   JOB_JOURNAL_MIN_SIZE));
+	if (snapshot)
+		buffer = _pack_job_snapshot(now, min_age);
+	else
+		buffer = _pack_job_journal(min_age);
+	state_dir = xstrdup(slurmctld_conf.state_save_location);
+	unlock_slurmctld(job_read_lock);
+
+	if (snapshot)
+		error_code = _write_job_snapshot(buffer, now, state_dir);
+	else if (get_buf_offset(buffer))
+		error_code = _write_job_journal(buffer, state_dir);
+	slurm_mutex_unlock(&job_journal_mutex);
+
+	xfree(state_dir);
 	free_buf(buffer);
 	END_TIMER2("dump_all_job_state");
 	return error_code;
@@ -823,6 +1252,9 @@ static int _open_job_state_file(char **state_file)
 extern void backup_slurmctld_restart(void)
 {
 	last_file_write_time = (time_t) 0;
+	slurm_mutex_lock(&job_journal_mutex);
+	job_snapshot_needed = true;
+	slurm_mutex_unlock(&job_journal_mutex);
 }
 
 /* Return the time stamp in the current job state save file */
@@ -871,7 +1303,8 @@ static time_t _get_last_state_write_time(void)
 
 	buffer = create_buf(data, data_size);
 	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
-	if (ver_str && !strcmp(ver_str, JOB_STATE_VERSION))
+	if (ver_str && (!strcmp(ver_str, JOB_STATE_VERSION) ||
+			!strcmp(ver_str, JOB_SNAPSHOT_VERSION)))
 		safe_unpack16(&protocol_version, buffer);
 	safe_unpack_time(&buf_time, buffer);
 
@@ -881,9 +1314,330 @@ unpack_error:
 	return buf_time;
 }
 
+/* Sort job state journal records by job ID, then position in journal */
+static int _journal_rec_job_cmp(const void *x, const void *y)
+{
+	const job_journal_rec_t *rec1 = x, *rec2 = y;
+
+	if (rec1->job_id != rec2->job_id)
+		return (rec1->job_id < rec2->job_id) ? -1 : 1;
+	if (rec1->order != rec2->order)
+		return (rec1->order < rec2->order) ? -1 : 1;
+	return 0;
+}
+
+/* Find a job state journal record by job ID */
+static int _journal_rec_id_cmp(const void *x, const void *y)
+{
+	const job_journal_rec_t *rec1 = x, *rec2 = y;
+
+	if (rec1->job_id != rec2->job_id)
+		return (rec1->job_id < rec2->job_id) ? -1 : 1;
+	return 0;
+}
+
+/* Sort job state journal records by position in journal */
+static int _journal_rec_order_cmp(const void *x, const void *y)
+{
+	const job_journal_rec_t *rec1 = x, *rec2 = y;
+
+	if (rec1->order != rec2->order)
+		return (rec1->order < rec2->order) ? -1 : 1;
+	return 0;
+}
+
+/* Read the complete contents of a state save file
+ * RET file's data, NULL if not found, free with xfree() */
+static char *_read_state_file(char *state_file, uint32_t *data_size)
+{
+	int data_allocated, data_read, state_fd;
+	char *data;
+
+	*data_size = 0;
+	state_fd = open(state_file, O_RDONLY);
+	if (state_fd < 0)
+		return NULL;
+
+	data_allocated = BUF_SIZE;
+	data = xmalloc(data_allocated);
+	while (1) {
+		data_read = read(state_fd, &data[*data_size], BUF_SIZE);
+		if (data_read < 0) {
+			if (errno == EINTR)
+				continue;
+			else {
+				error("Read error on %s: %m", state_file);
+				break;
+			}
+		} else if (data_read == 0)	/* eof */
+			break;
+		*data_size     += data_read;
+		data_allocated += data_read;
+		xrealloc(data, data_allocated);
+	}
+	close(state_fd);
+
+	return data;
+}
+
+/*
+ * _read_job_journal - read the job state journal following the job state
+ *	snapshot with the given time stamp. Reading stops at the first
+ *	truncated or corrupt record.
+ * IN snapshot_time - time stamp in the job state snapshot header
+ * IN snapshot_seq - sequence number in the job state snapshot header
+ * OUT buffer_ptr - journal contents or NULL, free with free_buf()
+ * OUT protocol_version - protocol version of the journal's job records
+ * OUT rec_pptr - the journal's job update and delete records, sorted by job
+ *	ID then position in journal, free with xfree(). All but the last
+ *	record of each job have their type cleared.
+ * OUT rec_cnt - count of records in rec_pptr
+ * IN/OUT job_id_seq - raised to the last job_id_sequence in the journal
+ */
+static void _read_job_journal(time_t snapshot_time, uint32_t snapshot_seq,
+			      Buf *buffer_ptr,
+			      uint16_t *protocol_version,
+			      job_journal_rec_t **rec_pptr, uint32_t *rec_cnt,
+			      uint32_t *job_id_seq)
+{
+	char *data, *journal_file, *ver_str = NULL;
+	uint32_t data_size = 0, ver_str_len, frame_cnt = 0;
+	uint32_t id, rec_end, rec_size = 0, i, buf_seq;
+	uint16_t type;
+	time_t buf_time;
+	job_journal_rec_t *rec_ptr = NULL;
+	Buf buffer;
+
+	*buffer_ptr = NULL;
+	*rec_pptr = NULL;
+	*rec_cnt = 0;
+
+	journal_file = slurm_get_state_save_location();
+	xstrcat(journal_file, "/job_state.journal");
+	lock_state_files();
+	data = _read_state_file(journal_file, &data_size);
+	unlock_state_files();
+	if (!data) {
+		debug("No job state journal (%s) to recover", journal_file);
+		xfree(journal_file);
+		return;
+	}
+
+	buffer = create_buf(data, data_size);
+	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
+	if (!ver_str || strcmp(ver_str, JOB_JOURNAL_VERSION))
+		goto unpack_error;
+	safe_unpack16(protocol_version, buffer);
+	safe_unpack_time(&buf_time, buffer);
+	safe_unpack32(&buf_seq, buffer);
+	if ((buf_time != snapshot_time) || (buf_seq != snapshot_seq)) {
+		info("Job state journal %s predates job state file, ignored",
+		     journal_file);
+		goto fini;
+	}
+
+	while (remaining_buf(buffer) > 0) {
+		if (_unpack_journal_rec(buffer, &type, &id, &rec_end) !=
+		    SLURM_SUCCESS) {
+			error("Job state journal %s truncated after %u records",
+			      journal_file, frame_cnt);
+			break;
+		}
+		frame_cnt++;
+		if (type == JOB_JOURNAL_SEQUENCE) {
+			*job_id_seq = MAX(*job_id_seq, id);
+		} else if ((type == JOB_JOURNAL_UPDATE) ||
+			   (type == JOB_JOURNAL_DELETE)) {
+			if (*rec_cnt >= rec_size) {
+				rec_size = MAX(rec_size * 2, 1024);
+				xrealloc(rec_ptr,
+					 sizeof(job_journal_rec_t) * rec_size);
+			}
+			rec_ptr[*rec_cnt].job_id = id;
+			rec_ptr[*rec_cnt].type   = type;
+			rec_ptr[*rec_cnt].offset = get_buf_offset(buffer);
+			rec_ptr[*rec_cnt].order  = *rec_cnt;
+			(*rec_cnt)++;
+		}
+		set_buf_offset(buffer, rec_end);
+	}
+	debug3("Read %u records from job state journal", frame_cnt);
+
+	/* Only the last record of each job is applied */
+	if (*rec_cnt) {
+		qsort(rec_ptr, *rec_cnt, sizeof(job_journal_rec_t),
+		      _journal_rec_job_cmp);
+		for (i = 1; i < *rec_cnt; i++) {
+			if (rec_ptr[i].job_id == rec_ptr[i-1].job_id)
+				rec_ptr[i-1].type = 0;
+		}
+	}
+
+	xfree(ver_str);
+	xfree(journal_file);
+	*buffer_ptr = buffer;
+	*rec_pptr = rec_ptr;
+	return;
+
+unpack_error:
+	error("Invalid job state journal %s, ignored", journal_file);
+fini:
+	xfree(ver_str);
+	xfree(journal_file);
+	free_buf(buffer);
+}
+
+/* Add the job state record at a buffer's current offset to those to be
+ * loaded by _recover_job_recs() */
+static void _add_job_recover_rec(job_recover_t *recover, Buf buffer,
+				 uint16_t protocol_version)
+{
+	job_recover_rec_t *rec_ptr;
+
+	if (recover->rec_cnt >= recover->rec_size) {
+		recover->rec_size = MAX(recover->rec_size * 2, 1024);
+		xrealloc(recover->rec,
+			 sizeof(job_recover_rec_t) * recover->rec_size);
+	}
+	rec_ptr = &recover->rec[recover->rec_cnt++];
+	rec_ptr->buffer = buffer;
+	rec_ptr->offset = get_buf_offset(buffer);
+	rec_ptr->protocol_version = protocol_version;
+	rec_ptr->job_ptr = NULL;
+	rec_ptr->rc = SLURM_SUCCESS;
+}
+
+/* Thread to unpack job state records into job records which are not yet in
+ * the job list or hash tables, see _recover_job_recs() */
+static void *_recover_job_thread(void *arg)
+{
+	job_recover_t *recover = (job_recover_t *) arg;
+	job_recover_rec_t *rec_ptr;
+	struct slurm_buf buffer;
+	uint32_t i, end;
+
+	while (1) {
+		slurm_mutex_lock(&recover->mutex);
+		i = recover->next_rec;
+		end = MIN(i + JOB_RECOVER_CHUNK, recover->rec_cnt);
+		recover->next_rec = end;
+		slurm_mutex_unlock(&recover->mutex);
+		if (i >= end)
+			break;
+
+		for ( ; i < end; i++) {
+			rec_ptr = &recover->rec[i];
+			/* Each thread unpacks using its own buffer offset */
+			memcpy(&buffer, rec_ptr->buffer, sizeof(buffer));
+			buffer.processed = rec_ptr->offset;
+			rec_ptr->rc = _load_job_state(&buffer,
+						      rec_ptr->protocol_version,
+						      &rec_ptr->job_ptr);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * _recover_job_recs - load the job state records gathered by
+ *	_add_job_recover_rec(), in order. Loading stops at the first invalid
+ *	record.
+ *	When recovering many jobs into an empty job list, the records are
+ *	unpacked by multiple threads. The jobs are then added to the job list
+ *	and hash tables in bulk, and matched with their associations and QOS.
+ * OUT job_cnt - incremented by the count of jobs recovered
+ * RET SLURM_SUCCESS or SLURM_FAILURE if an invalid record was found
+ */
+static int _recover_job_recs(job_recover_t *recover, int *job_cnt)
+{
+	pthread_attr_t thread_attr;
+	pthread_t *thread_id;
+	job_recover_rec_t *rec_ptr;
+	int error_code = SLURM_SUCCESS, i, thread_cnt;
+	long cpu_cnt;
+	uint32_t j;
+	DEF_TIMERS;
+
+	START_TIMER;
+	thread_cnt = MIN(JOB_RECOVER_THREADS,
+			 recover->rec_cnt / JOB_RECOVER_PER_THREAD);
+	cpu_cnt = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpu_cnt > 0)
+		thread_cnt = MIN(thread_cnt, cpu_cnt);
+	if ((thread_cnt < 2) || (list_count(job_list) != 0)) {
+		for (j = 0; j < recover->rec_cnt; j++) {
+			rec_ptr = &recover->rec[j];
+			set_buf_offset(rec_ptr->buffer, rec_ptr->offset);
+			if (_load_job_state(rec_ptr->buffer,
+					    rec_ptr->protocol_version, NULL) !=
+			    SLURM_SUCCESS)
+				return SLURM_FAILURE;
+			(*job_cnt)++;
+		}
+		return SLURM_SUCCESS;
+	}
+
+	slurm_mutex_init(&recover->mutex);
+	recover->next_rec = 0;
+	thread_id = xmalloc(sizeof(pthread_t) * thread_cnt);
+	slurm_attr_init(&thread_attr);
+	for (i = 0; i < thread_cnt; i++) {
+		while (pthread_create(&thread_id[i], &thread_attr,
+				      _recover_job_thread, recover)) {
+			error("pthread_create error %m");
+			sleep(1);
+		}
+	}
+	slurm_attr_destroy(&thread_attr);
+	for (i = 0; i < thread_cnt; i++)
+		pthread_join(thread_id[i], NULL);
+	xfree(thread_id);
+	slurm_mutex_destroy(&recover->mutex);
+	END_TIMER;
+	info("Unpacked %u job records with %d threads %s",
+	     recover->rec_cnt, thread_cnt, TIME_STR);
+
+	for (j = 0; j < recover->rec_cnt; j++) {
+		rec_ptr = &recover->rec[j];
+		if (error_code || (rec_ptr->rc != SLURM_SUCCESS)) {
+			/* Discard everything after an invalid record */
+			if (rec_ptr->job_ptr)
+				_free_job_record(rec_ptr->job_ptr);
+			error_code = SLURM_FAILURE;
+			continue;
+		}
+		if (find_job_record(rec_ptr->job_ptr->job_id)) {
+			error("Duplicate record for job %u discarded",
+			      rec_ptr->job_ptr->job_id);
+			_free_job_record(rec_ptr->job_ptr);
+			continue;
+		}
+		job_count++;
+		(void) list_append(job_list, rec_ptr->job_ptr);
+		_load_job_finish(rec_ptr->job_ptr);
+		(*job_cnt)++;
+	}
+	/* Once all threads are joined, as recovered records are not stamped */
+	all_jobs_changed(time(NULL));
+
+	return error_code;
+}
+
+/* Log if the jobs recovered reach MaxJobCount, in which case no more jobs
+ * can be submitted until enough of them are purged */
+static void _check_max_job_cnt(void)
+{
+	if (job_count >= slurmctld_conf.max_job_cnt) {
+		error("MaxJobCount reached (%u) with %d jobs recovered",
+		      slurmctld_conf.max_job_cnt, job_count);
+	}
+}
+
 /*
  * load_all_job_state - load the job state from file, recover from last
- *	checkpoint. Execute this after loading the configuration file data.
+ *	checkpoint. The job state journal is replayed over the snapshot.
+ *	Execute this after loading the configuration file data.
  *	Changes here should be reflected in load_last_job_id().
  * RET 0 or error code
  */
@@ -899,6 +1653,18 @@ extern int load_all_job_state(void)
 	char *ver_str = NULL;
 	uint32_t ver_str_len;
 	uint16_t protocol_version = (uint16_t)NO_VAL;
+	bool snapshot = false;
+	Buf journal_buf = NULL;
+	uint16_t journal_version = (uint16_t)NO_VAL, rec_type;
+	job_journal_rec_t *journal_rec = NULL, key_rec;
+	uint32_t journal_cnt = 0, rec_end = 0, i, snapshot_seq;
+	job_recover_t recover;
+
+	/* Recovered jobs have no saved digest, so start with a
+	 * snapshot */
+	slurm_mutex_lock(&job_journal_mutex);
+	job_snapshot_needed = true;
+	slurm_mutex_unlock(&job_journal_mutex);
 
 	/* read the file */
 	lock_state_files();
@@ -938,7 +1704,9 @@ extern int load_all_job_state(void)
 	buffer = create_buf(data, data_size);
 	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
 	debug3("Version string in job_state header is %s", ver_str);
-	if (ver_str && !strcmp(ver_str, JOB_STATE_VERSION))
+	if (ver_str && !strcmp(ver_str, JOB_SNAPSHOT_VERSION))
+		snapshot = true;
+	if (ver_str && (snapshot || !strcmp(ver_str, JOB_STATE_VERSION)))
 		safe_unpack16(&protocol_version, buffer);
 
 	if (protocol_version == (uint16_t)NO_VAL) {
@@ -953,25 +1721,85 @@ extern int load_all_job_state(void)
 
 	safe_unpack_time(&buf_time, buffer);
 	safe_unpack32( &saved_job_id, buffer);
-	job_id_sequence = MAX(saved_job_id, job_id_sequence);
 	debug3("Job id in job_state header is %u", saved_job_id);
+	if (snapshot) {
+		safe_unpack32(&snapshot_seq, buffer);
+		job_snapshot_seq = snapshot_seq;
+		_read_job_journal(buf_time, snapshot_seq, &journal_buf,
+				  &journal_version, &journal_rec, &journal_cnt,
+				  &saved_job_id);
+	}
+	job_id_sequence = MAX(saved_job_id, job_id_sequence);
 
-	while (remaining_buf(buffer) > 0) {
-		error_code = _load_job_state(buffer, protocol_version);
-		if (error_code != SLURM_SUCCESS)
+	if (!snapshot) {
+		while (remaining_buf(buffer) > 0) {
+			error_code = _load_job_state(buffer, protocol_version,
+						     NULL);
+			if (error_code != SLURM_SUCCESS)
+				goto unpack_error;
+			job_cnt++;
+		}
+	} else {
+		memset(&recover, 0, sizeof(job_recover_t));
+		while (remaining_buf(buffer) > 0) {
+			if (_unpack_journal_rec(buffer, &rec_type,
+						&key_rec.job_id, &rec_end) !=
+			    SLURM_SUCCESS) {
+				error_code = SLURM_FAILURE;
+				break;
+			}
+			if ((rec_type == JOB_JOURNAL_UPDATE) &&
+			    (!journal_cnt ||
+			     !bsearch(&key_rec, journal_rec, journal_cnt,
+				      sizeof(job_journal_rec_t),
+				      _journal_rec_id_cmp))) {
+				_add_job_recover_rec(&recover, buffer,
+						     protocol_version);
+			}	/* else superseded by journal */
+			set_buf_offset(buffer, rec_end);
+		}
+
+		/* Replay the journal in the order written */
+		if (journal_cnt && !error_code) {
+			qsort(journal_rec, journal_cnt,
+			      sizeof(job_journal_rec_t),
+			      _journal_rec_order_cmp);
+			for (i = 0; i < journal_cnt; i++) {
+				if (journal_rec[i].type != JOB_JOURNAL_UPDATE)
+					continue;
+				set_buf_offset(journal_buf,
+					       journal_rec[i].offset);
+				_add_job_recover_rec(&recover, journal_buf,
+						     journal_version);
+			}
+			info("Replaying %u job state journal records",
+			     journal_cnt);
+		}
+
+		if (_recover_job_recs(&recover, &job_cnt) != SLURM_SUCCESS)
+			error_code = SLURM_FAILURE;
+		xfree(recover.rec);
+		if (error_code)
 			goto unpack_error;
-		job_cnt++;
 	}
 	debug3("Set job_id_sequence to %u", job_id_sequence);
 
 	free_buf(buffer);
+	if (journal_buf)
+		free_buf(journal_buf);
+	xfree(journal_rec);
 	info("Recovered information about %d jobs", job_cnt);
+	_check_max_job_cnt();
 	return error_code;
 
 unpack_error:
 	error("Incomplete job data checkpoint file");
 	info("Recovered information about %d jobs", job_cnt);
+	_check_max_job_cnt();
 	free_buf(buffer);
+	if (journal_buf)
+		free_buf(journal_buf);
+	xfree(journal_rec);
 	return SLURM_FAILURE;
 }
 
@@ -991,6 +1819,11 @@ extern int load_last_job_id( void )
 	char *ver_str = NULL;
 	uint32_t ver_str_len;
 	uint16_t protocol_version = (uint16_t)NO_VAL;
+	bool snapshot = false;
+	Buf journal_buf = NULL;
+	uint16_t journal_version;
+	job_journal_rec_t *journal_rec = NULL;
+	uint32_t journal_cnt = 0, snapshot_seq;
 
 	/* read the file */
 	state_file = slurm_get_state_save_location();
@@ -1031,7 +1864,9 @@ extern int load_last_job_id( void )
 	buffer = create_buf(data, data_size);
 	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
 	debug3("Version string in job_state header is %s", ver_str);
-	if (ver_str && !strcmp(ver_str, JOB_STATE_VERSION))
+	if (ver_str && !strcmp(ver_str, JOB_SNAPSHOT_VERSION))
+		snapshot = true;
+	if (ver_str && (snapshot || !strcmp(ver_str, JOB_STATE_VERSION)))
 		safe_unpack16(&protocol_version, buffer);
 	xfree(ver_str);
 
@@ -1046,6 +1881,15 @@ extern int load_last_job_id( void )
 	safe_unpack_time(&buf_time, buffer);
 	safe_unpack32( &job_id_sequence, buffer);
 	debug3("Job ID in job_state header is %u", job_id_sequence);
+	if (snapshot) {
+		safe_unpack32(&snapshot_seq, buffer);
+		_read_job_journal(buf_time, snapshot_seq, &journal_buf,
+				  &journal_version, &journal_rec, &journal_cnt,
+				  &job_id_sequence);
+		if (journal_buf)
+			free_buf(journal_buf);
+		xfree(journal_rec);
+	}
 
 	/* Ignore the state for individual jobs stored here */
 
@@ -1209,7 +2053,8 @@ static void _dump_job_state(struct job_record *dump_job_ptr, Buf buffer)
 }
 
 /* Unpack a job's state information from a buffer */
-static int _load_job_state(Buf buffer, uint16_t protocol_version)
+static int _load_job_state(Buf buffer, uint16_t protocol_version,
+			   struct job_record **job_pptr)
 {
 	uint32_t job_id, user_id, group_id, time_limit, priority, alloc_sid;
 	uint32_t exit_code, assoc_id, db_index, name_len, time_min;
@@ -1246,14 +2091,10 @@ static int _load_job_state(Buf buffer, uint16_t protocol_version)
 	List gres_list = NULL, part_ptr_list = NULL;
 	struct job_record *job_ptr = NULL;
 	struct part_record *part_ptr;
-	int error_code, i, qos_error;
+	int error_code, i;
 	dynamic_plugin_data_t *select_jobinfo = NULL;
 	job_resources_t *job_resources = NULL;
 	check_jobinfo_t check_job = NULL;
-	slurmdb_assoc_rec_t assoc_rec;
-	slurmdb_qos_rec_t qos_rec;
-	bool job_finished = false;
-	char jbuf[JBUFSIZ];
 
 	if (protocol_version >= SLURM_15_08_PROTOCOL_VERSION) {
 		safe_unpack32(&array_job_id, buffer);
@@ -1280,18 +2121,10 @@ static int _load_job_state(Buf buffer, uint16_t protocol_version)
 			goto unpack_error;
 		}
 
-		job_ptr = find_job_record(job_id);
-		if (job_ptr == NULL) {
-			job_ptr = _create_job_record(&error_code, 1);
-			if (error_code) {
-				error("Create job entry failed for job_id %u",
-				      job_id);
-				goto unpack_error;
-			}
-			job_ptr->job_id = job_id;
-			job_ptr->array_job_id = array_job_id;
-			job_ptr->array_task_id = array_task_id;
-		}
+		job_ptr = _load_job_record(job_id, array_job_id,
+					   array_task_id, (job_pptr != NULL));
+		if (job_ptr == NULL)
+			goto unpack_error;
 
 		safe_unpack32(&user_id, buffer);
 		safe_unpack32(&group_id, buffer);
@@ -1456,18 +2289,10 @@ static int _load_job_state(Buf buffer, uint16_t protocol_version)
 			goto unpack_error;
 		}
 
-		job_ptr = find_job_record(job_id);
-		if (job_ptr == NULL) {
-			job_ptr = _create_job_record(&error_code, 1);
-			if (error_code) {
-				error("Create job entry failed for job_id %u",
-				      job_id);
-				goto unpack_error;
-			}
-			job_ptr->job_id = job_id;
-			job_ptr->array_job_id = array_job_id;
-			job_ptr->array_task_id = array_task_id;
-		}
+		job_ptr = _load_job_record(job_id, array_job_id,
+					   array_task_id, (job_pptr != NULL));
+		if (job_ptr == NULL)
+			goto unpack_error;
 
 		safe_unpack32(&user_id, buffer);
 		safe_unpack32(&group_id, buffer);
@@ -1618,18 +2443,10 @@ static int _load_job_state(Buf buffer, uint16_t protocol_version)
 			goto unpack_error;
 		}
 
-		job_ptr = find_job_record(job_id);
-		if (job_ptr == NULL) {
-			job_ptr = _create_job_record(&error_code, 1);
-			if (error_code) {
-				error("Create job entry failed for job_id %u",
-				      job_id);
-				goto unpack_error;
-			}
-			job_ptr->job_id = job_id;
-			job_ptr->array_job_id = array_job_id;
-			job_ptr->array_task_id = array_task_id;
-		}
+		job_ptr = _load_job_record(job_id, array_job_id,
+					   array_task_id, (job_pptr != NULL));
+		if (job_ptr == NULL)
+			goto unpack_error;
 
 		safe_unpack32(&user_id, buffer);
 		safe_unpack32(&group_id, buffer);
@@ -1785,13 +2602,6 @@ static int _load_job_state(Buf buffer, uint16_t protocol_version)
 		goto unpack_error;
 	}
 
-	if ((priority > 1) && (direct_set_prio == 0)) {
-		highest_prio = MAX(highest_prio, priority);
-		lowest_prio  = MIN(lowest_prio,  priority);
-	}
-	if (job_id_sequence <= job_id)
-		job_id_sequence = job_id + 1;
-
 	xfree(job_ptr->account);
 	job_ptr->account = account;
 	xstrtolower(job_ptr->account);
@@ -1903,47 +2713,112 @@ static int _load_job_state(Buf buffer, uint16_t protocol_version)
 		job_ptr->array_recs->task_cnt =
 			bit_set_count(job_ptr->array_recs->task_id_bitmap);
 
-		if (job_ptr->array_recs->task_cnt > 1)
-			job_count += (job_ptr->array_recs->task_cnt - 1);
+		job_ptr->array_recs->array_flags    = array_flags;
+		job_ptr->array_recs->max_run_tasks  = max_run_tasks;
+		job_ptr->array_recs->tot_run_tasks  = tot_run_tasks;
+		job_ptr->array_recs->min_exit_code  = min_exit_code;
+		job_ptr->array_recs->max_exit_code  = max_exit_code;
+		job_ptr->array_recs->tot_comp_tasks = tot_comp_tasks;
+	}
+	job_ptr->time_last_active = now;
+	job_ptr->time_limit   = time_limit;
+	job_ptr->time_min     = time_min;
+	job_ptr->total_cpus   = total_cpus;
+	job_ptr->total_nodes  = total_nodes;
+	job_ptr->cpu_cnt      = cpu_cnt;
+	job_ptr->tot_sus_time = tot_sus_time;
+	job_ptr->preempt_time = preempt_time;
+	job_ptr->user_id      = user_id;
+	select_g_select_jobinfo_set(job_ptr->select_jobinfo,
+				    SELECT_JOBDATA_USER_NAME, &user_id);
+	job_ptr->wait_all_nodes = wait_all_nodes;
+	job_ptr->warn_flags   = warn_flags;
+	job_ptr->warn_signal  = warn_signal;
+	job_ptr->warn_time    = warn_time;
+	job_ptr->limit_set_max_cpus  = limit_set_max_cpus;
+	job_ptr->limit_set_max_nodes = limit_set_max_nodes;
+	job_ptr->limit_set_min_cpus  = limit_set_min_cpus;
+	job_ptr->limit_set_min_nodes = limit_set_min_nodes;
+	job_ptr->limit_set_pn_min_memory = limit_set_pn_min_memory;
+	job_ptr->limit_set_time      = limit_set_time;
+	job_ptr->limit_set_qos       = limit_set_qos;
+	job_ptr->req_switch      = req_switch;
+	job_ptr->wait4switch     = wait4switch;
+	job_ptr->profile         = profile;
+	/* This needs to always to initialized to "true".  The select
+	   plugin will deal with it every time it goes through the
+	   logic if req_switch or wait4switch are set.
+	*/
+	job_ptr->best_switch     = true;
+	job_ptr->start_protocol_ver = start_protocol_ver;
+
+	if (job_pptr) {
+		/* Finished by _recover_job_recs() */
+		*job_pptr = job_ptr;
+		return SLURM_SUCCESS;
+	}
+	_load_job_finish(job_ptr);
+	return SLURM_SUCCESS;
+
+unpack_error:
+	error("Incomplete job record");
+	xfree(alloc_node);
+	xfree(account);
+	xfree(batch_host);
+	xfree(burst_buffer);
+	xfree(comment);
+	xfree(gres);
+	xfree(gres_alloc);
+	xfree(gres_req);
+	xfree(gres_used);
+	xfree(resp_host);
+	xfree(licenses);
+	xfree(mail_user);
+	xfree(name);
+	xfree(nodes);
+	xfree(nodes_completing);
+	xfree(partition);
+	FREE_NULL_LIST(part_ptr_list);
+	xfree(resv_name);
+	for (i=0; i<spank_job_env_size; i++)
+		xfree(spank_job_env[i]);
+	xfree(spank_job_env);
+	xfree(state_desc);
+	xfree(task_id_str);
+	xfree(wckey);
+	select_g_select_jobinfo_free(select_jobinfo);
+	checkpoint_free_jobinfo(check_job);
+	if (job_ptr && job_pptr) {
+		_free_job_record(job_ptr);
+	} else if (job_ptr) {
+		if (job_ptr->job_id == 0)
+			job_ptr->job_id = NO_VAL;
+		_purge_job_record(job_ptr->job_id);
+	}
+	return SLURM_FAILURE;
+}
+
+/*
+ * _load_job_finish - add a job loaded from state save to the job hash tables
+ *	and associate it with its association and QOS. Also update the
+ *	accounting records and the global job counters.
+ */
+static void _load_job_finish(struct job_record *job_ptr)
+{
+	int qos_error;
+	slurmdb_assoc_rec_t assoc_rec;
+	slurmdb_qos_rec_t qos_rec;
+	bool job_finished = false;
+	char jbuf[JBUFSIZ];
 
-		job_ptr->array_recs->array_flags    = array_flags;
-		job_ptr->array_recs->max_run_tasks  = max_run_tasks;
-		job_ptr->array_recs->tot_run_tasks  = tot_run_tasks;
-		job_ptr->array_recs->min_exit_code  = min_exit_code;
-		job_ptr->array_recs->max_exit_code  = max_exit_code;
-		job_ptr->array_recs->tot_comp_tasks = tot_comp_tasks;
+	if ((job_ptr->priority > 1) && (job_ptr->direct_set_prio == 0)) {
+		highest_prio = MAX(highest_prio, job_ptr->priority);
+		lowest_prio  = MIN(lowest_prio,  job_ptr->priority);
 	}
-	job_ptr->time_last_active = now;
-	job_ptr->time_limit   = time_limit;
-	job_ptr->time_min     = time_min;
-	job_ptr->total_cpus   = total_cpus;
-	job_ptr->total_nodes  = total_nodes;
-	job_ptr->cpu_cnt      = cpu_cnt;
-	job_ptr->tot_sus_time = tot_sus_time;
-	job_ptr->preempt_time = preempt_time;
-	job_ptr->user_id      = user_id;
-	select_g_select_jobinfo_set(job_ptr->select_jobinfo,
-				    SELECT_JOBDATA_USER_NAME, &user_id);
-	job_ptr->wait_all_nodes = wait_all_nodes;
-	job_ptr->warn_flags   = warn_flags;
-	job_ptr->warn_signal  = warn_signal;
-	job_ptr->warn_time    = warn_time;
-	job_ptr->limit_set_max_cpus  = limit_set_max_cpus;
-	job_ptr->limit_set_max_nodes = limit_set_max_nodes;
-	job_ptr->limit_set_min_cpus  = limit_set_min_cpus;
-	job_ptr->limit_set_min_nodes = limit_set_min_nodes;
-	job_ptr->limit_set_pn_min_memory = limit_set_pn_min_memory;
-	job_ptr->limit_set_time      = limit_set_time;
-	job_ptr->limit_set_qos       = limit_set_qos;
-	job_ptr->req_switch      = req_switch;
-	job_ptr->wait4switch     = wait4switch;
-	job_ptr->profile         = profile;
-	/* This needs to always to initialized to "true".  The select
-	   plugin will deal with it every time it goes through the
-	   logic if req_switch or wait4switch are set.
-	*/
-	job_ptr->best_switch     = true;
-	job_ptr->start_protocol_ver = start_protocol_ver;
+	if (job_id_sequence <= job_ptr->job_id)
+		job_id_sequence = job_ptr->job_id + 1;
+	if (job_ptr->array_recs && (job_ptr->array_recs->task_cnt > 1))
+		job_count += (job_ptr->array_recs->task_cnt - 1);
 
 	_add_job_hash(job_ptr);
 	_add_job_array_hash(job_ptr);
@@ -1970,7 +2845,8 @@ static int _load_job_state(Buf buffer, uint16_t protocol_version)
 				    &job_ptr->assoc_ptr, false) &&
 	    (accounting_enforce & ACCOUNTING_ENFORCE_ASSOCS)
 	    && (!IS_JOB_FINISHED(job_ptr))) {
-		info("Holding job %u with invalid association", job_id);
+		info("Holding job %u with invalid association",
+		     job_ptr->job_id);
 		xfree(job_ptr->state_desc);
 		job_ptr->state_reason = FAIL_ACCOUNT;
 	} else {
@@ -2010,49 +2886,16 @@ static int _load_job_state(Buf buffer, uint16_t protocol_version)
 			job_ptr->limit_set_qos, &qos_rec,
 			&qos_error);
 		if ((qos_error != SLURM_SUCCESS) && !job_ptr->limit_set_qos) {
-			info("Holding job %u with invalid qos", job_id);
+			info("Holding job %u with invalid qos",
+			     job_ptr->job_id);
 			xfree(job_ptr->state_desc);
 			job_ptr->state_reason = FAIL_QOS;
 		}
 		job_ptr->qos_id = qos_rec.id;
 	}
 	build_node_details(job_ptr, false);	/* set node_addr */
-	return SLURM_SUCCESS;
-
-unpack_error:
-	error("Incomplete job record");
-	xfree(alloc_node);
-	xfree(account);
-	xfree(batch_host);
-	xfree(burst_buffer);
-	xfree(comment);
-	xfree(gres);
-	xfree(gres_alloc);
-	xfree(gres_req);
-	xfree(gres_used);
-	xfree(resp_host);
-	xfree(licenses);
-	xfree(mail_user);
-	xfree(name);
-	xfree(nodes);
-	xfree(nodes_completing);
-	xfree(partition);
-	FREE_NULL_LIST(part_ptr_list);
-	xfree(resv_name);
-	for (i=0; i<spank_job_env_size; i++)
-		xfree(spank_job_env[i]);
-	xfree(spank_job_env);
-	xfree(state_desc);
-	xfree(task_id_str);
-	xfree(wckey);
-	select_g_select_jobinfo_free(select_jobinfo);
-	checkpoint_free_jobinfo(check_job);
-	if (job_ptr) {
-		if (job_ptr->job_id == 0)
-			job_ptr->job_id = NO_VAL;
-		_purge_job_record(job_ptr->job_id);
-	}
-	return SLURM_FAILURE;
+	queue_job_time_check(job_ptr);
+	queue_job_purge_check(job_ptr);
 }
 
 /*
@@ -2323,11 +3166,7 @@ unpack_error:
  */
 static void _add_job_hash(struct job_record *job_ptr)
 {
-	int inx;
-
-	inx = JOB_HASH_INX(job_ptr->job_id);
-	job_ptr->job_next = job_hash[inx];
-	job_hash[inx] = job_ptr;
+	lhash_add(job_hash, job_ptr);
 }
 
 /* _remove_job_hash - remove a job hash entry for given job record, job_id must
@@ -2337,19 +3176,8 @@ static void _add_job_hash(struct job_record *job_ptr)
  */
 static void _remove_job_hash(struct job_record *job_entry)
 {
-	struct job_record *job_ptr, **job_pptr;
-
-        job_pptr = &job_hash[JOB_HASH_INX(job_entry->job_id)];
-        while ((job_pptr != NULL) &&
-               ((job_ptr = *job_pptr) != job_entry)) {
-                job_pptr = &job_ptr->job_next;
-        }
-        if (job_pptr == NULL) {
-                fatal("job hash error");
-                return; /* Fix CLANG false positive error */
-        }
-        job_entry->job_next = NULL;
-
+	if (!lhash_remove(job_hash, job_entry))
+		fatal("job hash error");
 }
 
 /* _add_job_array_hash - add a job hash entry for given job record,
@@ -2359,18 +3187,11 @@ static void _remove_job_hash(struct job_record *job_entry)
  */
 void _add_job_array_hash(struct job_record *job_ptr)
 {
-	int inx;
-
 	if (job_ptr->array_task_id == NO_VAL)
 		return;	/* Not a job array */
 
-	inx = JOB_HASH_INX(job_ptr->array_job_id);
-	job_ptr->job_array_next_j = job_array_hash_j[inx];
-	job_array_hash_j[inx] = job_ptr;
-
-	inx = JOB_ARRAY_HASH_INX(job_ptr->array_job_id,job_ptr->array_task_id);
-	job_ptr->job_array_next_t = job_array_hash_t[inx];
-	job_array_hash_t[inx] = job_ptr;
+	lhash_add(job_array_hash_j, job_ptr);
+	lhash_add(job_array_hash_t, job_ptr);
 }
 
 /* For the job array data structure, build the string representation of the
@@ -2390,13 +3211,13 @@ extern void build_array_str(struct job_record *job_ptr)
 	 * this could happen many times instead of just ever so often.
 	 */
 	job_ptr->db_index = 0;
+	job_changed(job_ptr, time(NULL));
 }
 
 /* Return true if ALL tasks of specific array job ID are complete */
 extern bool test_job_array_complete(uint32_t array_job_id)
 {
 	struct job_record *job_ptr;
-	int inx;
 
 	job_ptr = find_job_record(array_job_id);
 	if (job_ptr) {
@@ -2409,8 +3230,7 @@ extern bool test_job_array_complete(uint32_t array_job_id)
 	}
 
 	/* Need to test individual job array records */
-	inx = JOB_HASH_INX(array_job_id);
-	job_ptr = job_array_hash_j[inx];
+	job_ptr = lhash_first(job_array_hash_j, array_job_id);
 	while (job_ptr) {
 		if (job_ptr->array_job_id == array_job_id) {
 			if (!IS_JOB_COMPLETE(job_ptr))
@@ -2425,7 +3245,6 @@ extern bool test_job_array_complete(uint32_t array_job_id)
 extern bool test_job_array_completed(uint32_t array_job_id)
 {
 	struct job_record *job_ptr;
-	int inx;
 
 	job_ptr = find_job_record(array_job_id);
 	if (job_ptr) {
@@ -2436,8 +3255,7 @@ extern bool test_job_array_completed(uint32_t array_job_id)
 	}
 
 	/* Need to test individual job array records */
-	inx = JOB_HASH_INX(array_job_id);
-	job_ptr = job_array_hash_j[inx];
+	job_ptr = lhash_first(job_array_hash_j, array_job_id);
 	while (job_ptr) {
 		if (job_ptr->array_job_id == array_job_id) {
 			if (!IS_JOB_COMPLETED(job_ptr))
@@ -2452,7 +3270,6 @@ extern bool test_job_array_completed(uint32_t array_job_id)
 extern bool test_job_array_pending(uint32_t array_job_id)
 {
 	struct job_record *job_ptr;
-	int inx;
 
 	job_ptr = find_job_record(array_job_id);
 	if (job_ptr) {
@@ -2463,8 +3280,7 @@ extern bool test_job_array_pending(uint32_t array_job_id)
 	}
 
 	/* Need to test individual job array records */
-	inx = JOB_HASH_INX(array_job_id);
-	job_ptr = job_array_hash_j[inx];
+	job_ptr = lhash_first(job_array_hash_j, array_job_id);
 	while (job_ptr) {
 		if (job_ptr->array_job_id == array_job_id) {
 			if (IS_JOB_PENDING(job_ptr))
@@ -2494,8 +3310,7 @@ extern struct job_record *find_job_array_rec(uint32_t array_job_id,
 		return find_job_record(array_job_id);
 
 	if (array_task_id == INFINITE) {	/* find by job ID */
-		inx = JOB_HASH_INX(array_job_id);
-		job_ptr = job_array_hash_j[inx];
+		job_ptr = lhash_first(job_array_hash_j, array_job_id);
 		while (job_ptr) {
 			if (job_ptr->array_job_id == array_job_id) {
 				match_job_ptr = job_ptr;
@@ -2515,8 +3330,8 @@ extern struct job_record *find_job_array_rec(uint32_t array_job_id,
 			return job_ptr;
 		return match_job_ptr;
 	} else {		/* Find specific task ID */
-		inx = JOB_ARRAY_HASH_INX(array_job_id, array_task_id);
-		job_ptr = job_array_hash_t[inx];
+		job_ptr = lhash_first(job_array_hash_t,
+				      array_job_id + array_task_id);
 		while (job_ptr) {
 			if ((job_ptr->array_job_id == array_job_id) &&
 			    (job_ptr->array_task_id == array_task_id)) {
@@ -2548,7 +3363,7 @@ struct job_record *find_job_record(uint32_t job_id)
 {
 	struct job_record *job_ptr;
 
-	job_ptr = job_hash[JOB_HASH_INX(job_id)];
+	job_ptr = lhash_first(job_hash, job_id);
 	while (job_ptr) {
 		if (job_ptr->job_id == job_id)
 			return job_ptr;
@@ -2588,7 +3403,7 @@ static void _rebuild_part_name_list(struct job_record  *job_ptr)
 		xstrcat(job_ptr->partition, part_ptr->name);
 	}
 	list_iterator_destroy(part_iterator);
-	last_job_update = time(NULL);
+	job_changed(job_ptr, time(NULL));
 }
 
 /*
@@ -2688,7 +3503,7 @@ extern int kill_job_by_part_name(char *part_name)
 	list_iterator_destroy(job_iterator);
 
 	if (kill_job_cnt)
-		last_job_update = now;
+		all_jobs_changed(now);
 	return kill_job_cnt;
 }
 
@@ -2746,6 +3561,7 @@ extern int kill_job_by_front_end_name(char *node_name)
 				if (job_ptr->node_cnt == 0) {
 					delete_step_records(job_ptr);
 					job_ptr->job_state &= (~JOB_COMPLETING);
+					notify_job_dependents(job_ptr);
 					slurm_sched_g_schedule();
 				}
 				node_ptr = &node_record_table_ptr[i];
@@ -2821,6 +3637,7 @@ extern int kill_job_by_front_end_name(char *node_name)
 				 * removes the submit we need to add it
 				 * again. */
 				acct_policy_add_job_submit(job_ptr);
+				sched_queue_job_update(job_ptr);
 
 				if (!job_ptr->node_bitmap_cg ||
 				    bit_set_count(job_ptr->node_bitmap_cg) == 0)
@@ -2852,7 +3669,7 @@ extern int kill_job_by_front_end_name(char *node_name)
 	list_iterator_destroy(job_iterator);
 
 	if (kill_job_cnt)
-		last_job_update = now;
+		all_jobs_changed(now);
 	return kill_job_cnt;
 #else
 	return 0;
@@ -2976,6 +3793,7 @@ extern int kill_running_job_by_node_name(char *node_name)
 			if (job_ptr->node_cnt == 0) {
 				delete_step_records(job_ptr);
 				job_ptr->job_state &= (~JOB_COMPLETING);
+				notify_job_dependents(job_ptr);
 				slurm_sched_g_schedule();
 			}
 			if (node_ptr->comp_job_cnt)
@@ -3058,6 +3876,7 @@ extern int kill_running_job_by_node_name(char *node_name)
 				 * removes the submit we need to add it
 				 * again. */
 				acct_policy_add_job_submit(job_ptr);
+				sched_queue_job_update(job_ptr);
 
 				if (!job_ptr->node_bitmap_cg ||
 				    bit_set_count(job_ptr->node_bitmap_cg) == 0)
@@ -3089,7 +3908,7 @@ extern int kill_running_job_by_node_name(char *node_name)
 	}
 	list_iterator_destroy(job_iterator);
 	if (kill_job_cnt)
-		last_job_update = now;
+		all_jobs_changed(now);
 
 	return kill_job_cnt;
 }
@@ -3341,31 +4160,46 @@ int init_job_conf(void)
 		job_list = list_create(_list_delete_job);
 	}
 
-	last_job_update = time(NULL);
+	all_jobs_changed(time(NULL));
+	if (job_tombstone_horizon == 0)
+		job_tombstone_horizon = last_job_update;
 	return SLURM_SUCCESS;
 }
 
+static uint32_t _job_hash_key(void *rec)
+{
+	return ((struct job_record *) rec)->job_id;
+}
+
+static uint32_t _job_array_hash_j_key(void *rec)
+{
+	return ((struct job_record *) rec)->array_job_id;
+}
+
+static uint32_t _job_array_hash_t_key(void *rec)
+{
+	struct job_record *job_ptr = (struct job_record *) rec;
+
+	return job_ptr->array_job_id + job_ptr->array_task_id;
+}
+
 /*
- * rehash_jobs - Create or rebuild the job hash table.
+ * rehash_jobs - Create the job hash tables. They grow and shrink with the
+ *	job count, independent of MaxJobCount.
  * NOTE: run lock_slurmctld before entry: Read config, write job
  */
 extern void rehash_jobs(void)
 {
 	if (job_hash == NULL) {
-		hash_table_size = slurmctld_conf.max_job_cnt;
-		job_hash = (struct job_record **)
-			xmalloc(hash_table_size * sizeof(struct job_record *));
-		job_array_hash_j = (struct job_record **)
-			xmalloc(hash_table_size * sizeof(struct job_record *));
-		job_array_hash_t = (struct job_record **)
-			xmalloc(hash_table_size * sizeof(struct job_record *));
-	} else if (hash_table_size < (slurmctld_conf.max_job_cnt / 2)) {
-		/* If the MaxJobCount grows by too much, the hash table will
-		 * be ineffective without rebuilding. We don't presently bother
-		 * to rebuild the hash table, but cut MaxJobCount back as
-		 * needed. */
-		error ("MaxJobCount reset too high, restart slurmctld");
-		slurmctld_conf.max_job_cnt = hash_table_size;
+		job_hash = lhash_create(JOB_HASH_MIN_SIZE,
+					offsetof(struct job_record, job_next),
+					_job_hash_key);
+		job_array_hash_j = lhash_create(JOB_HASH_MIN_SIZE,
+				offsetof(struct job_record, job_array_next_j),
+				_job_array_hash_j_key);
+		job_array_hash_t = lhash_create(JOB_HASH_MIN_SIZE,
+				offsetof(struct job_record, job_array_next_t),
+				_job_array_hash_t_key);
 	}
 }
 
@@ -3412,6 +4246,11 @@ struct job_record *_job_rec_copy(struct job_record *job_ptr)
 
 	job_ptr_pend->job_id   = save_job_id;
 	job_ptr_pend->job_next = save_job_next;
+	job_ptr_pend->pack_cache = NULL;
+	memset(&job_ptr_pend->delta, 0, sizeof(struct job_delta_stamp));
+	job_ptr_pend->save_digest = 0;
+	job_ptr_pend->time_check = 0;
+	job_ptr_pend->purge_check = 0;
 	job_ptr_pend->details  = save_details;
 	job_ptr_pend->prio_factors = save_prio_factors;
 	job_ptr_pend->step_list = save_step_list;
@@ -3507,6 +4346,7 @@ struct job_record *_job_rec_copy(struct job_record *job_ptr)
 	details_new->cpu_bind = xstrdup(job_details->cpu_bind);
 	details_new->cpu_bind_type = job_details->cpu_bind_type;
 	details_new->depend_list = depended_list_copy(job_details->depend_list);
+	details_new->depend_time = 0;
 	details_new->dependency = xstrdup(job_details->dependency);
 	details_new->orig_dependency = xstrdup(job_details->orig_dependency);
 	if (job_details->env_cnt) {
@@ -3779,7 +4619,7 @@ extern int job_allocate(job_desc_msg_t * job_specs, int immediate,
 		   (!top_prio) || (!independent) || !avail_front_end(job_ptr);
 	error_code = _select_nodes_parts(job_ptr, no_alloc, NULL, err_msg);
 	if (!test_only) {
-		last_job_update = now;
+		job_changed(job_ptr, now);
 		slurm_sched_g_schedule();	/* work for external scheduler */
 	}
 
@@ -3804,6 +4644,7 @@ extern int job_allocate(job_desc_msg_t * job_specs, int immediate,
 			job_completion_logger(job_ptr, false);
 		} else {	/* job remains queued */
 			_create_job_array(job_ptr, job_specs);
+			sched_queue_job_update(job_ptr);
 			if ((error_code == ESLURM_NODES_BUSY) ||
 			    (error_code == ESLURM_RESERVATION_BUSY) ||
 			    (error_code == ESLURM_ACCOUNTING_POLICY)) {
@@ -3836,6 +4677,7 @@ extern int job_allocate(job_desc_msg_t * job_specs, int immediate,
 		debug2("sched: JobId=%u allocated resources: NodeList=%s",
 		       job_ptr->job_id, job_ptr->nodes);
 		rebuild_job_part_list(job_ptr);
+		sched_queue_job_update(job_ptr);	/* if batch job pending */
 	}
 
 	return SLURM_SUCCESS;
@@ -3881,7 +4723,7 @@ extern int job_fail(uint32_t job_id, uint16_t job_state)
 				difftime(now, job_ptr->suspend_time);
 		} else
 			job_ptr->end_time       = now;
-		last_job_update                 = now;
+		job_changed(job_ptr, now);
 		job_ptr->job_state = job_state | JOB_COMPLETING;
 		job_ptr->exit_code = 1;
 		job_ptr->state_reason = FAIL_LAUNCH;
@@ -3933,11 +4775,12 @@ static int _job_signal(struct job_record *job_ptr, uint16_t signal,
 	}
 
 	if (IS_JOB_PENDING(job_ptr) && (signal == SIGKILL)) {
-		last_job_update		= now;
+		job_changed(job_ptr, now);
 		job_ptr->job_state	= JOB_CANCELLED;
 		job_ptr->start_time	= now;
 		job_ptr->end_time	= now;
 		srun_allocate_abort(job_ptr);
+		sched_queue_job_update(job_ptr);
 		job_completion_logger(job_ptr, false);
 		verbose("%s: of pending %s successful",
 			__func__, jobid2str(job_ptr, jbuf));
@@ -3949,7 +4792,7 @@ static int _job_signal(struct job_record *job_ptr, uint16_t signal,
 	else
 		job_term_state = JOB_CANCELLED;
 	if (IS_JOB_SUSPENDED(job_ptr) &&  (signal == SIGKILL)) {
-		last_job_update         = now;
+		job_changed(job_ptr, now);
 		job_ptr->end_time       = job_ptr->suspend_time;
 		job_ptr->tot_sus_time  += difftime(now, job_ptr->suspend_time);
 		job_ptr->job_state      = job_term_state | JOB_COMPLETING;
@@ -3970,7 +4813,7 @@ static int _job_signal(struct job_record *job_ptr, uint16_t signal,
 			 */
 			job_ptr->time_last_active	= now;
 			job_ptr->end_time		= now;
-			last_job_update			= now;
+			job_changed(job_ptr, now);
 			job_ptr->job_state = job_term_state | JOB_COMPLETING;
 			build_cg_bitmap(job_ptr);
 			job_completion_logger(job_ptr, false);
@@ -4123,7 +4966,7 @@ extern int job_str_signal(char *job_id_str, uint16_t signal, uint16_t flags,
 		}
 
 		/* Signal all tasks of this job array */
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
+		job_ptr = lhash_first(job_array_hash_j, job_id);
 		if (!job_ptr && !job_ptr_done) {
 			info("%s: 2 invalid job id %u", __func__, job_id);
 			return ESLURM_INVALID_JOB_ID;
@@ -4171,7 +5014,7 @@ extern int job_str_signal(char *job_id_str, uint16_t signal, uint16_t flags,
 	/* Find some job record and validate the user cancelling the job */
 	job_ptr = find_job_record(job_id);
 	if (job_ptr == NULL) {
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
+		job_ptr = lhash_first(job_array_hash_j, job_id);
 		while (job_ptr) {
 			if (job_ptr->array_job_id == job_id)
 				break;
@@ -4228,8 +5071,8 @@ extern int job_str_signal(char *job_id_str, uint16_t signal, uint16_t flags,
 						       task_id_bitmap);
 			job_ptr->array_recs->task_cnt = new_task_count;
 			job_count -= (orig_task_cnt - new_task_count);
+			job_changed(job_ptr, now);
 			if (job_ptr->array_recs->task_cnt == 0) {
-				last_job_update		= now;
 				job_ptr->job_state	= JOB_CANCELLED;
 				job_ptr->start_time	= now;
 				job_ptr->end_time	= now;
@@ -4483,6 +5326,7 @@ extern int job_complete(uint32_t job_id, uid_t uid, bool requeue,
 			job_ptr->batch_flag = 1;
 			job_ptr->priority = 0;
 		}
+		sched_queue_job_update(job_ptr);
 	} else if (IS_JOB_PENDING(job_ptr) && job_ptr->details &&
 		   job_ptr->batch_flag) {
 		/* Possible failure mode with DOWN node and job requeue.
@@ -4530,7 +5374,7 @@ extern int job_complete(uint32_t job_id, uid_t uid, bool requeue,
 		job_completion_logger(job_ptr, false);
 	}
 
-	last_job_update = now;
+	job_changed(job_ptr, now);
 	job_ptr->time_last_active = now;   /* Timer for resending kill RPC */
 	if (job_comp_flag) {	/* job was running */
 		build_cg_bitmap(job_ptr);
@@ -6587,176 +7431,334 @@ static bool _valid_pn_min_mem(job_desc_msg_t * job_desc_msg,
 	return false;
 }
 
-/*
- * job_time_limit - terminate jobs which have exceeded their time limit
- * global: job_list - pointer global job list
- *	last_job_update - time of last job table update
- * NOTE: READ lock_slurmctld config before entry
- */
-void job_time_limit(void)
+static void _job_time_heap_push(job_time_heap_t *heap, time_t due,
+				uint32_t job_id)
 {
-	ListIterator job_iterator;
-	struct job_record *job_ptr;
-	time_t now = time(NULL);
-	time_t old = now - ((slurmctld_conf.inactive_limit * 4 / 3) +
-			    slurmctld_conf.msg_timeout + 1);
-	time_t over_run;
-	int resv_status = 0;
+	job_time_rec_t rec = { due, job_id };
+	uint32_t i, parent;
 
-	if (slurmctld_conf.over_time_limit == (uint16_t) INFINITE)
-		over_run = now - (365 * 24 * 60 * 60);	/* one year */
-	else
-		over_run = now - (slurmctld_conf.over_time_limit  * 60);
+	if (heap->rec_cnt >= heap->rec_size) {
+		heap->rec_size = MAX(heap->rec_size * 2, 1024);
+		xrealloc(heap->rec, sizeof(job_time_rec_t) * heap->rec_size);
+	}
+	for (i = heap->rec_cnt++; i > 0; i = parent) {
+		parent = (i - 1) / 2;
+		if (heap->rec[parent].due <= due)
+			break;
+		heap->rec[i] = heap->rec[parent];
+	}
+	heap->rec[i] = rec;
+}
 
-	begin_job_resv_check();
-	job_iterator = list_iterator_create(job_list);
-	while ((job_ptr =(struct job_record *) list_next(job_iterator))) {
-		xassert (job_ptr->magic == JOB_MAGIC);
+/* Remove the heap's earliest entry if it is due by the given time */
+static bool _job_time_heap_pop(job_time_heap_t *heap, time_t now,
+			       job_time_rec_t *rec_ptr)
+{
+	job_time_rec_t last;
+	uint32_t i, child;
 
-		if (IS_JOB_CONFIGURING(job_ptr)) {
-			if (!IS_JOB_RUNNING(job_ptr) ||
-			    (bit_overlap(job_ptr->node_bitmap,
-					 power_node_bitmap) == 0)) {
-				debug("%s: Configuration for job %u is complete",
-				      __func__, job_ptr->job_id);
-				job_ptr->job_state &= (~JOB_CONFIGURING);
-			}
-		}
+	if ((heap->rec_cnt == 0) || (heap->rec[0].due > now))
+		return false;
 
-		/* This needs to be near the top of the loop, checks every
-		 * running, suspended and pending job */
-		resv_status = job_resv_check(job_ptr);
+	*rec_ptr = heap->rec[0];
+	last = heap->rec[--heap->rec_cnt];
+	for (i = 0; (child = (i * 2) + 1) < heap->rec_cnt; i = child) {
+		if (((child + 1) < heap->rec_cnt) &&
+		    (heap->rec[child + 1].due < heap->rec[child].due))
+			child++;
+		if (last.due <= heap->rec[child].due)
+			break;
+		heap->rec[i] = heap->rec[child];
+	}
+	heap->rec[i] = last;
+	return true;
+}
 
-		if (job_ptr->preempt_time &&
-		    (IS_JOB_RUNNING(job_ptr) || IS_JOB_SUSPENDED(job_ptr))) {
-			if ((job_ptr->warn_time) &&
-			    (job_ptr->warn_time + PERIODIC_TIMEOUT + now >=
-			     job_ptr->end_time)) {
-				debug("%s: preempt warning signal %u to job %u ",
-				      __func__, job_ptr->warn_signal,
-				      job_ptr->job_id);
-				(void) job_signal(job_ptr->job_id,
-						  job_ptr->warn_signal,
-						  job_ptr->warn_flags, 0,
-						  false);
-				job_ptr->warn_signal = 0;
-				job_ptr->warn_time = 0;
-			}
-			if (job_ptr->end_time <= now) {
-				last_job_update = now;
-				info("%s: Preemption GraceTime reached JobId=%u",
-				     __func__, job_ptr->job_id);
-				_job_timed_out(job_ptr);
-				job_ptr->job_state = JOB_PREEMPTED |
-						     JOB_COMPLETING;
-				xfree(job_ptr->state_desc);
-			}
-			continue;
+/* Return the earlier of two due times, either of which may be zero for
+ * never */
+static time_t _earlier_due(time_t due1, time_t due2)
+{
+	if ((due1 == 0) || ((due2 != 0) && (due2 < due1)))
+		return due2;
+	return due1;
+}
+
+/* Return when job_time_limit() next needs to test a job, zero if never.
+ * Each test in _job_time_limit_check() contributes the time it can next
+ * become true. A due time in the past is tested on every pass. */
+static time_t _job_time_check_due(struct job_record *job_ptr, time_t now)
+{
+	time_t due = 0, lead;
+
+	if (!IS_JOB_RUNNING(job_ptr) && !IS_JOB_SUSPENDED(job_ptr) &&
+	    !IS_JOB_CONFIGURING(job_ptr))
+		return (time_t) 0;
+
+	/* Tested on every pass until the job's nodes are booted */
+	if (IS_JOB_CONFIGURING(job_ptr))
+		return now;
+
+	/* The job is counted against its reservation on every pass once the
+	 * reservation ends, see job_resv_check() */
+	if (job_ptr->resv_name && job_ptr->resv_ptr)
+		due = job_ptr->resv_ptr->end_time;
+
+	if (job_ptr->preempt_time) {
+		lead = 0;
+		if (job_ptr->warn_time)
+			lead = job_ptr->warn_time + PERIODIC_TIMEOUT;
+		return _earlier_due(due, job_ptr->end_time - lead);
+	}
+	if (!IS_JOB_RUNNING(job_ptr))
+		return due;	/* Queued again on resume */
+
+	if (slurmctld_conf.inactive_limit && (job_ptr->batch_flag == 0) &&
+	    job_ptr->other_port && job_ptr->part_ptr &&
+	    !(job_ptr->part_ptr->flags & PART_FLAG_ROOT_ONLY)) {
+		due = _earlier_due(due, job_ptr->time_last_active +
+				   (slurmctld_conf.inactive_limit * 4 / 3) +
+				   slurmctld_conf.msg_timeout + 1);
+	}
+	due = _earlier_due(due, job_step_time_limit_due(job_ptr));
+	due = _earlier_due(due, acct_policy_job_time_out_due(job_ptr, now));
+
+	if (job_ptr->time_limit == INFINITE)
+		return due;
+
+	/* Earliest warning, mail or srun notice before the end time */
+	lead = PERIODIC_TIMEOUT * 2;
+	if (job_ptr->warn_time)
+		lead = MAX(lead, job_ptr->warn_time + PERIODIC_TIMEOUT);
+	if (job_ptr->mail_type & MAIL_JOB_TIME50)
+		lead = MAX(lead, job_ptr->time_limit * 60 * 0.5);
+	else if (job_ptr->mail_type & MAIL_JOB_TIME80)
+		lead = MAX(lead, job_ptr->time_limit * 60 * 0.2);
+	else if (job_ptr->mail_type & MAIL_JOB_TIME90)
+		lead = MAX(lead, job_ptr->time_limit * 60 * 0.1);
+	return _earlier_due(due, job_ptr->end_time - lead);
+}
+
+extern void queue_job_time_check(struct job_record *job_ptr)
+{
+	time_t now = time(NULL), due;
+
+	due = _job_time_check_due(job_ptr, now);
+	if (due == 0)
+		return;
+	/* Never due again in the job_time_limit() pass now running */
+	due = MAX(due, now + 1);
+	if (job_ptr->time_check && (job_ptr->time_check <= due))
+		return;		/* Already queued for earlier */
+	job_ptr->time_check = due;
+	_job_time_heap_push(&job_time_heap, due, job_ptr->job_id);
+}
+
+/* Return when purge_old_job() next needs to test a job, zero if never */
+static time_t _job_purge_check_due(struct job_record *job_ptr, time_t now)
+{
+	if (IS_JOB_COMPLETING(job_ptr) || job_ptr->epilog_running)
+		return now;	/* Tested on every pass */
+	if (!IS_JOB_FINISHED(job_ptr) || (slurmctld_conf.min_job_age == 0))
+		return (time_t) 0;
+	return job_ptr->end_time + slurmctld_conf.min_job_age;
+}
+
+extern void queue_job_purge_check(struct job_record *job_ptr)
+{
+	time_t now = time(NULL), due;
+
+	due = _job_purge_check_due(job_ptr, now);
+	if (due == 0)
+		return;
+	due = MAX(due, now + 1);
+	if (job_ptr->purge_check && (job_ptr->purge_check <= due))
+		return;
+	job_ptr->purge_check = due;
+	_job_time_heap_push(&job_purge_heap, due, job_ptr->job_id);
+}
+
+/* Test one job queued by queue_job_time_check() for having exceeded its
+ * time limit or for other time related events */
+static void _job_time_limit_check(struct job_record *job_ptr, time_t now,
+				  time_t old, time_t over_run)
+{
+	int resv_status = 0;
+
+	xassert (job_ptr->magic == JOB_MAGIC);
+
+	if (IS_JOB_CONFIGURING(job_ptr)) {
+		if (!IS_JOB_RUNNING(job_ptr) ||
+		    (bit_overlap(job_ptr->node_bitmap,
+				 power_node_bitmap) == 0)) {
+			debug("%s: Configuration for job %u is complete",
+			      __func__, job_ptr->job_id);
+			job_ptr->job_state &= (~JOB_CONFIGURING);
 		}
+	}
 
-		if (!IS_JOB_RUNNING(job_ptr))
-			continue;
+	/* This needs to be near the top, checks every running and
+	 * suspended job */
+	resv_status = job_resv_check(job_ptr);
 
-		if (slurmctld_conf.inactive_limit &&
-		    (job_ptr->batch_flag == 0)    &&
-		    (job_ptr->time_last_active <= old) &&
-		    (job_ptr->other_port) &&
-		    (job_ptr->part_ptr) &&
-		    (!(job_ptr->part_ptr->flags & PART_FLAG_ROOT_ONLY))) {
-			/* job inactive, kill it */
-			info("%s: inactivity time limit reached for JobId=%u",
+	if (job_ptr->preempt_time &&
+	    (IS_JOB_RUNNING(job_ptr) || IS_JOB_SUSPENDED(job_ptr))) {
+		if ((job_ptr->warn_time) &&
+		    (job_ptr->warn_time + PERIODIC_TIMEOUT + now >=
+		     job_ptr->end_time)) {
+			debug("%s: preempt warning signal %u to job %u ",
+			      __func__, job_ptr->warn_signal,
+			      job_ptr->job_id);
+			(void) job_signal(job_ptr->job_id,
+					  job_ptr->warn_signal,
+					  job_ptr->warn_flags, 0,
+					  false);
+			job_ptr->warn_signal = 0;
+			job_ptr->warn_time = 0;
+		}
+		if (job_ptr->end_time <= now) {
+			job_changed(job_ptr, now);
+			info("%s: Preemption GraceTime reached JobId=%u",
 			     __func__, job_ptr->job_id);
 			_job_timed_out(job_ptr);
-			job_ptr->state_reason = FAIL_INACTIVE_LIMIT;
+			job_ptr->job_state = JOB_PREEMPTED |
+					     JOB_COMPLETING;
 			xfree(job_ptr->state_desc);
-			continue;
 		}
-		if (job_ptr->time_limit != INFINITE) {
-			if ((job_ptr->warn_time) &&
-			    (job_ptr->warn_time + PERIODIC_TIMEOUT + now >=
-			     job_ptr->end_time)) {
+		return;
+	}
 
-				/* If --signal B option was not specified,
-				 * signal only the steps but not the batch step.
-				 */
-				if (job_ptr->warn_flags == 0)
-					job_ptr->warn_flags = KILL_STEPS_ONLY;
+	if (!IS_JOB_RUNNING(job_ptr))
+		return;
 
-				debug("%s: warning signal %u to job %u ",
-				      __func__, job_ptr->warn_signal,
-				      job_ptr->job_id);
+	if (slurmctld_conf.inactive_limit &&
+	    (job_ptr->batch_flag == 0)    &&
+	    (job_ptr->time_last_active <= old) &&
+	    (job_ptr->other_port) &&
+	    (job_ptr->part_ptr) &&
+	    (!(job_ptr->part_ptr->flags & PART_FLAG_ROOT_ONLY))) {
+		/* job inactive, kill it */
+		info("%s: inactivity time limit reached for JobId=%u",
+		     __func__, job_ptr->job_id);
+		_job_timed_out(job_ptr);
+		job_ptr->state_reason = FAIL_INACTIVE_LIMIT;
+		xfree(job_ptr->state_desc);
+		return;
+	}
+	if (job_ptr->time_limit != INFINITE) {
+		if ((job_ptr->warn_time) &&
+		    (job_ptr->warn_time + PERIODIC_TIMEOUT + now >=
+		     job_ptr->end_time)) {
 
-				(void) job_signal(job_ptr->job_id,
-						  job_ptr->warn_signal,
-						  job_ptr->warn_flags, 0,
-						  false);
-				job_ptr->warn_signal = 0;
-				job_ptr->warn_time = 0;
-			}
-			if ((job_ptr->mail_type & MAIL_JOB_TIME100) &&
-			    (now >= job_ptr->end_time)) {
-				job_ptr->mail_type &= (~MAIL_JOB_TIME100);
-				mail_job_info(job_ptr, MAIL_JOB_TIME100);
-			}
-			if ((job_ptr->mail_type & MAIL_JOB_TIME90) &&
-			    (now + (job_ptr->time_limit * 60 * 0.1) >=
-			     job_ptr->end_time)) {
-				job_ptr->mail_type &= (~MAIL_JOB_TIME90);
-				mail_job_info(job_ptr, MAIL_JOB_TIME90);
-			}
-			if ((job_ptr->mail_type & MAIL_JOB_TIME80) &&
-			    (now + (job_ptr->time_limit * 60 * 0.2) >=
-			     job_ptr->end_time)) {
-				job_ptr->mail_type &= (~MAIL_JOB_TIME80);
-				mail_job_info(job_ptr, MAIL_JOB_TIME80);
-			}
-			if ((job_ptr->mail_type & MAIL_JOB_TIME50) &&
-			    (now + (job_ptr->time_limit * 60 * 0.5) >=
-			     job_ptr->end_time)) {
-				job_ptr->mail_type &= (~MAIL_JOB_TIME50);
-				mail_job_info(job_ptr, MAIL_JOB_TIME50);
-			}
-			if (job_ptr->end_time <= over_run) {
-				last_job_update = now;
-				info("Time limit exhausted for JobId=%u",
-				     job_ptr->job_id);
-				_job_timed_out(job_ptr);
-				job_ptr->state_reason = FAIL_TIMEOUT;
-				xfree(job_ptr->state_desc);
-				continue;
-			}
-		}
+			/* If --signal B option was not specified,
+			 * signal only the steps but not the batch step.
+			 */
+			if (job_ptr->warn_flags == 0)
+				job_ptr->warn_flags = KILL_STEPS_ONLY;
+
+			debug("%s: warning signal %u to job %u ",
+			      __func__, job_ptr->warn_signal,
+			      job_ptr->job_id);
 
-		if (resv_status != SLURM_SUCCESS) {
-			last_job_update = now;
-			info("Reservation ended for JobId=%u",
+			(void) job_signal(job_ptr->job_id,
+					  job_ptr->warn_signal,
+					  job_ptr->warn_flags, 0,
+					  false);
+			job_ptr->warn_signal = 0;
+			job_ptr->warn_time = 0;
+		}
+		if ((job_ptr->mail_type & MAIL_JOB_TIME100) &&
+		    (now >= job_ptr->end_time)) {
+			job_ptr->mail_type &= (~MAIL_JOB_TIME100);
+			mail_job_info(job_ptr, MAIL_JOB_TIME100);
+		}
+		if ((job_ptr->mail_type & MAIL_JOB_TIME90) &&
+		    (now + (job_ptr->time_limit * 60 * 0.1) >=
+		     job_ptr->end_time)) {
+			job_ptr->mail_type &= (~MAIL_JOB_TIME90);
+			mail_job_info(job_ptr, MAIL_JOB_TIME90);
+		}
+		if ((job_ptr->mail_type & MAIL_JOB_TIME80) &&
+		    (now + (job_ptr->time_limit * 60 * 0.2) >=
+		     job_ptr->end_time)) {
+			job_ptr->mail_type &= (~MAIL_JOB_TIME80);
+			mail_job_info(job_ptr, MAIL_JOB_TIME80);
+		}
+		if ((job_ptr->mail_type & MAIL_JOB_TIME50) &&
+		    (now + (job_ptr->time_limit * 60 * 0.5) >=
+		     job_ptr->end_time)) {
+			job_ptr->mail_type &= (~MAIL_JOB_TIME50);
+			mail_job_info(job_ptr, MAIL_JOB_TIME50);
+		}
+		if (job_ptr->end_time <= over_run) {
+			job_changed(job_ptr, now);
+			info("Time limit exhausted for JobId=%u",
 			     job_ptr->job_id);
 			_job_timed_out(job_ptr);
 			job_ptr->state_reason = FAIL_TIMEOUT;
 			xfree(job_ptr->state_desc);
-			continue;
+			return;
 		}
+	}
 
-		/* check if any individual job steps have exceeded
-		 * their time limit */
-		if (job_ptr->step_list &&
-		    (list_count(job_ptr->step_list) > 0))
-			check_job_step_time_limit(job_ptr, now);
+	if (resv_status != SLURM_SUCCESS) {
+		job_changed(job_ptr, now);
+		info("Reservation ended for JobId=%u",
+		     job_ptr->job_id);
+		_job_timed_out(job_ptr);
+		job_ptr->state_reason = FAIL_TIMEOUT;
+		xfree(job_ptr->state_desc);
+		return;
+	}
 
-		acct_policy_job_time_out(job_ptr);
+	/* check if any individual job steps have exceeded
+	 * their time limit */
+	if (job_ptr->step_list &&
+	    (list_count(job_ptr->step_list) > 0))
+		check_job_step_time_limit(job_ptr, now);
 
-		if (job_ptr->state_reason == FAIL_TIMEOUT) {
-			last_job_update = now;
-			_job_timed_out(job_ptr);
-			xfree(job_ptr->state_desc);
-			continue;
-		}
+	acct_policy_job_time_out(job_ptr);
 
-		/* Give srun command warning message about pending timeout */
-		if (job_ptr->end_time <= (now + PERIODIC_TIMEOUT * 2))
-			srun_timeout (job_ptr);
+	if (job_ptr->state_reason == FAIL_TIMEOUT) {
+		job_changed(job_ptr, now);
+		_job_timed_out(job_ptr);
+		xfree(job_ptr->state_desc);
+		return;
+	}
+
+	/* Give srun command warning message about pending timeout */
+	if (job_ptr->end_time <= (now + PERIODIC_TIMEOUT * 2))
+		srun_timeout (job_ptr);
+}
+
+/*
+ * job_time_limit - terminate jobs which have exceeded their time limit
+ * global: job_list - pointer global job list
+ *	last_job_update - time of last job table update
+ * NOTE: READ lock_slurmctld config before entry
+ */
+void job_time_limit(void)
+{
+	struct job_record *job_ptr;
+	job_time_rec_t time_rec;
+	time_t now = time(NULL);
+	time_t old = now - ((slurmctld_conf.inactive_limit * 4 / 3) +
+			    slurmctld_conf.msg_timeout + 1);
+	time_t over_run;
+
+	if (slurmctld_conf.over_time_limit == (uint16_t) INFINITE)
+		over_run = now - (365 * 24 * 60 * 60);	/* one year */
+	else
+		over_run = now - (slurmctld_conf.over_time_limit  * 60);
+
+	begin_job_resv_check();
+	while (_job_time_heap_pop(&job_time_heap, now, &time_rec)) {
+		job_ptr = find_job_record(time_rec.job_id);
+		if (!job_ptr || (job_ptr->time_check != time_rec.due))
+			continue;	/* Superseded by a later entry */
+		job_ptr->time_check = 0;
+		_job_time_limit_check(job_ptr, now, old, over_run);
+		queue_job_time_check(job_ptr);
 	}
-	list_iterator_destroy(job_iterator);
 	fini_job_resv_check();
 }
 
@@ -6952,24 +7954,23 @@ _validate_min_mem_partition(job_desc_msg_t *job_desc_msg,
 static void _list_delete_job(void *job_entry)
 {
 	struct job_record *job_ptr = (struct job_record *) job_entry;
-	struct job_record **job_pptr, *tmp_ptr;
-	int job_array_size, i;
+	int job_array_size;
 
 	xassert(job_entry);
 	xassert (job_ptr->magic == JOB_MAGIC);
 	job_ptr->magic = 0;	/* make sure we don't delete record twice */
-
-	/* Remove the record from job hash table */
-	job_pptr = &job_hash[JOB_HASH_INX(job_ptr->job_id)];
-	while ((job_pptr != NULL) && (*job_pptr != NULL) &&
-	       ((tmp_ptr = *job_pptr) != (struct job_record *) job_entry)) {
-		xassert(tmp_ptr->magic == JOB_MAGIC);
-		job_pptr = &tmp_ptr->job_next;
+	_add_job_tombstone(job_ptr->job_id);
+	if (job_ptr->save_digest)
+		_add_job_journal_purge(job_ptr->job_id);
+
+	/* Remove the record from job hash tables, if it was added */
+	(void) lhash_remove(job_hash, job_ptr);
+	sched_queue_job_remove(job_ptr);
+	notify_job_dependents(job_ptr);
+	if (job_ptr->array_task_id != NO_VAL) {
+		(void) lhash_remove(job_array_hash_j, job_ptr);
+		(void) lhash_remove(job_array_hash_t, job_ptr);
 	}
-	if (job_pptr == NULL)
-		error("job hash error");
-	else
-		*job_pptr = job_ptr->job_next;
 
 	if (job_ptr->array_recs) {
 		job_array_size = MAX(1, job_ptr->array_recs->task_cnt);
@@ -6977,35 +7978,22 @@ static void _list_delete_job(void *job_entry)
 		job_array_size = 1;
 	}
 
-	/* Remove the record from job array hash tables, if applicable */
-	if (job_ptr->array_task_id != NO_VAL) {
-		job_pptr = &job_array_hash_j[
-			JOB_HASH_INX(job_ptr->array_job_id)];
-		while ((job_pptr != NULL) && (*job_pptr != NULL) &&
-		       ((tmp_ptr = *job_pptr) !=
-			(struct job_record *) job_entry)) {
-			xassert(tmp_ptr->magic == JOB_MAGIC);
-			job_pptr = &tmp_ptr->job_array_next_j;
-		}
-		if (job_pptr == NULL)
-			error("job array hash error");
-		else
-			*job_pptr = job_ptr->job_array_next_j;
-
-		job_pptr = &job_array_hash_t[
-			JOB_ARRAY_HASH_INX(job_ptr->array_job_id,
-					   job_ptr->array_task_id)];
-		while ((job_pptr != NULL) && (*job_pptr != NULL) &&
-		       ((tmp_ptr = *job_pptr) !=
-			(struct job_record *) job_entry)) {
-			xassert(tmp_ptr->magic == JOB_MAGIC);
-			job_pptr = &tmp_ptr->job_array_next_t;
-		}
-		if (job_pptr == NULL)
-			error("job array, task ID hash error");
-		else
-			*job_pptr = job_ptr->job_array_next_t;
+	if (job_array_size > job_count) {
+		error("job_count underflow");
+		job_count = 0;
+	} else {
+		job_count -= job_array_size;
 	}
+	_free_job_record(job_ptr);
+}
+
+/*
+ * _free_job_record - free a job record and its job_details, which must
+ *	already be removed from the job hash tables
+ */
+static void _free_job_record(struct job_record *job_ptr)
+{
+	int i;
 
 	delete_job_details(job_ptr);
 	xfree(job_ptr->account);
@@ -7035,6 +8023,7 @@ static void _list_delete_job(void *job_entry)
 	FREE_NULL_BITMAP(job_ptr->node_bitmap_cg);
 	xfree(job_ptr->nodes);
 	xfree(job_ptr->nodes_completing);
+	_free_job_pack_cache(job_ptr);
 	xfree(job_ptr->partition);
 	FREE_NULL_LIST(job_ptr->part_ptr_list);
 	xfree(job_ptr->priority_array);
@@ -7049,12 +8038,6 @@ static void _list_delete_job(void *job_entry)
 	step_list_purge(job_ptr);
 	select_g_select_jobinfo_free(job_ptr->select_jobinfo);
 	xfree(job_ptr->wckey);
-	if (job_array_size > job_count) {
-		error("job_count underflow");
-		job_count = 0;
-	} else {
-		job_count -= job_array_size;
-	}
 	xfree(job_ptr);
 }
 
@@ -7176,33 +8159,578 @@ static bool _hide_job(struct job_record *job_ptr, uid_t uid)
 	return false;
 }
 
+/* Return true if the token of length len is an element of the comma
+ * separated list */
+static bool _in_name_list(char *list, char *token, int len, bool ignore_case)
+{
+	char *sep;
+	int tok_len;
+
+	while (list) {
+		sep = strchr(list, ',');
+		tok_len = sep ? (sep - list) : strlen(list);
+		if ((tok_len == len) &&
+		    ((ignore_case && !strncasecmp(list, token, len)) ||
+		     (!ignore_case && !strncmp(list, token, len))))
+			return true;
+		list = sep ? (sep + 1) : NULL;
+	}
+	return false;
+}
+
+/* Return true if any element of the comma separated list names is an
+ * element of the comma separated list filter */
+static bool _match_name_list(char *filter, char *names, bool ignore_case)
+{
+	char *sep;
+	int len;
+
+	while (names) {
+		sep = strchr(names, ',');
+		len = sep ? (sep - names) : strlen(names);
+		if (_in_name_list(filter, names, len, ignore_case))
+			return true;
+		names = sep ? (sep + 1) : NULL;
+	}
+	return false;
+}
+
+static int _cmp_uint32(const void *a, const void *b)
+{
+	uint32_t val_a = *(uint32_t *) a, val_b = *(uint32_t *) b;
+
+	if (val_a < val_b)
+		return -1;
+	if (val_a > val_b)
+		return 1;
+	return 0;
+}
+
+/* Sort a job filter's ID arrays for use by _match_job_filter() */
+static void _sort_job_filter(job_info_filter_t *filter)
+{
+	if (filter->job_id_cnt > 1) {
+		qsort(filter->job_ids, filter->job_id_cnt, sizeof(uint32_t),
+		      _cmp_uint32);
+	}
+	if (filter->user_id_cnt > 1) {
+		qsort(filter->user_ids, filter->user_id_cnt, sizeof(uint32_t),
+		      _cmp_uint32);
+	}
+}
+
+/* Determine if a job matches a filter, sorted by _sort_job_filter() */
+static bool _match_job_filter(struct job_record *job_ptr,
+			      job_info_filter_t *filter)
+{
+	char *part_name;
+	uint16_t state;
+	int i;
+
+	if (filter->user_id_cnt &&
+	    !bsearch(&job_ptr->user_id, filter->user_ids, filter->user_id_cnt,
+		     sizeof(uint32_t), _cmp_uint32))
+		return false;
+
+	if (filter->job_id_cnt &&
+	    !bsearch(&job_ptr->job_id, filter->job_ids, filter->job_id_cnt,
+		     sizeof(uint32_t), _cmp_uint32) &&
+	    (!job_ptr->array_job_id ||
+	     !bsearch(&job_ptr->array_job_id, filter->job_ids,
+		      filter->job_id_cnt, sizeof(uint32_t), _cmp_uint32)))
+		return false;
+
+	if (filter->state_cnt) {
+		for (i = 0; i < filter->state_cnt; i++) {
+			state = filter->states[i];
+			if (state & JOB_STATE_FLAGS) {
+				if (job_ptr->job_state & state)
+					break;
+			} else if ((job_ptr->job_state & JOB_STATE_BASE) ==
+				   state)
+				break;
+		}
+		if (i >= filter->state_cnt)
+			return false;
+	}
+
+	if (filter->accounts &&
+	    !_match_name_list(filter->accounts, job_ptr->account, true))
+		return false;
+
+	if (filter->partitions) {
+		/* Same partition name as reported by pack_job() */
+		if (!IS_JOB_PENDING(job_ptr) && job_ptr->part_ptr)
+			part_name = job_ptr->part_ptr->name;
+		else
+			part_name = job_ptr->partition;
+		if (!_match_name_list(filter->partitions, part_name, false))
+			return false;
+	}
+
+	if (filter->reservations &&
+	    !_match_name_list(filter->reservations, job_ptr->resv_name, false))
+		return false;
+
+	return true;
+}
+
+/* Release the packed job records cached by _pack_job_cached() */
+static void _free_job_pack_cache(struct job_record *job_ptr)
+{
+	int i;
+
+	if (!job_ptr->pack_cache)
+		return;
+	for (i = 0; i < JOB_PACK_CACHE_CNT; i++) {
+		if (job_ptr->pack_cache[i].data)
+			release_buf_shared(job_ptr->pack_cache[i].data);
+	}
+	xfree(job_ptr->pack_cache);
+}
+
+/*
+ * job_changed - Record that a job's information, as reported by job
+ *	information RPCs, changed. Sets last_job_update, so clients which
+ *	loaded job information earlier load it again. Cached packed records
+ *	of jobs are checked against the job itself, see _job_pack_gen().
+ * IN job_ptr - the job changed
+ * IN now - time of the change
+ * NOTE: Call while holding the job write lock
+ */
+extern void job_changed(struct job_record *job_ptr, time_t now)
+{
+	last_job_update = now;
+}
+
+/*
+ * all_jobs_changed - Record that the information of any job may have changed,
+ *	as job_changed() would for every job. Sets last_job_update.
+ * IN now - time of the change
+ * NOTE: Call while holding the job write lock
+ */
+extern void all_jobs_changed(time_t now)
+{
+	job_all_change_cnt++;
+	last_job_update = now;
+}
+
+/* Mix a block of memory into a job fingerprint */
+static uint64_t _fp_mem(uint64_t fp, const void *data, size_t len)
+{
+	const unsigned char *ptr = data;
+	uint64_t word;
+
+	for ( ; len >= sizeof(word); len -= sizeof(word)) {
+		memcpy(&word, ptr, sizeof(word));
+		ptr += sizeof(word);
+		fp = (fp ^ word) * 0x100000001b3ULL;
+		fp ^= fp >> 32;
+	}
+	while (len--)
+		fp = (fp ^ *ptr++) * 0x100000001b3ULL;
+	return fp;
+}
+
+static uint64_t _fp_str(uint64_t fp, const char *str)
+{
+	if (!str)
+		return (fp ^ 0xff) * 0x100000001b3ULL;
+	return _fp_mem(fp, str, strlen(str) + 1);
+}
+
+static uint64_t _fp_bitmap(uint64_t fp, bitstr_t *bitmap)
+{
+	bitoff_t words;
+
+	if (!bitmap)
+		return _fp_str(fp, NULL);
+	words = (bit_size(bitmap) + BITSTR_MAXPOS) / (BITSTR_MAXPOS + 1);
+	return _fp_mem(fp, bitmap, (words + BITSTR_OVERHEAD) *
+			  sizeof(bitstr_t));
+}
+
+/*
+ * _job_pack_fingerprint - Return a digest of the job information read by
+ *	pack_job(): every field of the job and its details (less those only
+ *	used internally which change often), the strings and bitmaps packed
+ *	and the resources in use. Changes to a job are identified even if not
+ *	reported by job_changed(), at the cost of an occasional needless
+ *	repack when some other field changes.
+ * NOTE: Add here any data referenced by the job which pack_job() reads
+ *	and which can change without replacing its pointer
+ */
+static uint64_t _job_pack_fingerprint(struct job_record *job_ptr)
+{
+	struct job_record job_rec;
+	struct job_details details;
+	job_array_struct_t array_recs;
+	job_resources_t *job_resrcs_ptr = job_ptr->job_resrcs;
+	struct job_details *detail_ptr = job_ptr->details;
+	uint64_t fp = 0xcbf29ce484222325ULL;
+	int i;
+
+	memcpy(&job_rec, job_ptr, sizeof(job_rec));
+	job_rec.gres_used = NULL;
+	job_rec.job_array_next_j = NULL;
+	job_rec.job_array_next_t = NULL;
+	job_rec.job_next = NULL;
+	job_rec.next_step_id = 0;
+	job_rec.pack_cache = NULL;
+	memset(&job_rec.delta, 0, sizeof(job_rec.delta));
+	job_rec.save_digest = 0;
+	job_rec.time_check = 0;
+	job_rec.purge_check = 0;
+	job_rec.preempt_in_progress = false;
+	job_rec.time_last_active = 0;
+	job_rec.tot_sus_time = 0;
+	job_rec.wait4switch_start = 0;
+	fp = _fp_mem(fp, &job_rec, sizeof(job_rec));
+
+	fp = _fp_str(fp, job_ptr->account);
+	fp = _fp_str(fp, job_ptr->alloc_node);
+	fp = _fp_str(fp, job_ptr->batch_host);
+	fp = _fp_str(fp, job_ptr->burst_buffer);
+	fp = _fp_str(fp, job_ptr->comment);
+	fp = _fp_str(fp, job_ptr->gres);
+	fp = _fp_str(fp, job_ptr->licenses);
+	fp = _fp_str(fp, job_ptr->name);
+	fp = _fp_str(fp, job_ptr->network);
+	fp = _fp_str(fp, job_ptr->nodes);
+	fp = _fp_str(fp, job_ptr->partition);
+	fp = _fp_str(fp, job_ptr->resv_name);
+	fp = _fp_str(fp, job_ptr->sched_nodes);
+	fp = _fp_str(fp, job_ptr->state_desc);
+	fp = _fp_str(fp, job_ptr->wckey);
+	fp = _fp_bitmap(fp, job_ptr->node_bitmap);
+	fp = _fp_bitmap(fp, job_ptr->node_bitmap_cg);
+
+	if (job_ptr->array_recs) {
+		/* task_id_str is built from task_id_bitmap by pack_job() */
+		memcpy(&array_recs, job_ptr->array_recs, sizeof(array_recs));
+		array_recs.task_id_str = NULL;
+		fp = _fp_mem(fp, &array_recs, sizeof(array_recs));
+		fp = _fp_bitmap(fp, array_recs.task_id_bitmap);
+	}
+
+	if (detail_ptr) {
+		memcpy(&details, detail_ptr, sizeof(details));
+		details.depend_rc = 0;
+		details.depend_time = 0;
+		details.usable_nodes = 0;
+		fp = _fp_mem(fp, &details, sizeof(details));
+		for (i = 0; i < detail_ptr->argc; i++)
+			fp = _fp_str(fp, detail_ptr->argv[i]);
+		fp = _fp_str(fp, detail_ptr->dependency);
+		fp = _fp_str(fp, detail_ptr->exc_nodes);
+		fp = _fp_str(fp, detail_ptr->features);
+		fp = _fp_str(fp, detail_ptr->req_nodes);
+		fp = _fp_str(fp, detail_ptr->std_err);
+		fp = _fp_str(fp, detail_ptr->std_in);
+		fp = _fp_str(fp, detail_ptr->std_out);
+		fp = _fp_str(fp, detail_ptr->work_dir);
+		fp = _fp_bitmap(fp, detail_ptr->exc_node_bitmap);
+		fp = _fp_bitmap(fp, detail_ptr->req_node_bitmap);
+		if (detail_ptr->mc_ptr) {
+			fp = _fp_mem(fp, detail_ptr->mc_ptr,
+				     sizeof(multi_core_data_t));
+		}
+	}
+
+	if (job_resrcs_ptr) {
+		/* Allocated resources are set once, those used by steps
+		 * change in place */
+		fp = _fp_mem(fp, job_resrcs_ptr, sizeof(job_resources_t));
+		fp = _fp_bitmap(fp, job_resrcs_ptr->core_bitmap_used);
+		if (job_resrcs_ptr->cpus_used) {
+			fp = _fp_mem(fp, job_resrcs_ptr->cpus_used,
+				     sizeof(uint16_t) * job_resrcs_ptr->nhosts);
+		}
+		if (job_resrcs_ptr->memory_used) {
+			fp = _fp_mem(fp, job_resrcs_ptr->memory_used,
+				     sizeof(uint32_t) * job_resrcs_ptr->nhosts);
+		}
+	}
+
+	return fp;
+}
+
+/*
+ * _job_pack_gen - Return a value which changes whenever a job's packed
+ *	information may have changed, see _job_pack_fingerprint(). Changes
+ *	reported by all_jobs_changed() and reconfiguration may change any
+ *	job, as may partition changes, which are identified by
+ *	last_part_update as job information RPCs hold the partition write
+ *	lock just to hide partitions, see _pack_job_cached().
+ *	Call while holding the job read lock.
+ */
+static uint64_t _job_pack_gen(struct job_record *job_ptr)
+{
+	uint64_t gen[3];
+
+	gen[0] = job_all_change_cnt;
+	gen[1] = get_write_unlock_cnt(CONFIG_LOCK);
+	gen[2] = last_part_update;
+	return _fp_mem(_job_pack_fingerprint(job_ptr), gen, sizeof(gen));
+}
+
+/*
+ * _pack_job_cached - Pack a job's information as done by pack_job(),
+ *	reusing the job's previously packed record if still valid. A
+ *	cached record, new or reused, is referenced by the chain rather
+ *	than copied.
+ * IN now - time of this request
+ */
+static void _pack_job_cached(struct job_record *job_ptr, uint16_t show_flags,
+			     uint32_t field_mask, BufChain chain,
+			     uint16_t protocol_version, uid_t uid, time_t now)
+{
+	struct job_pack_cache *cache_ptr, *use_ptr = NULL;
+	Buf buffer;
+	uint32_t size, size_hint = JOB_PACK_BUF_SIZE;
+	char *data;
+	BufShared shared;
+	time_t expire = 0;
+	uint64_t pack_gen = _job_pack_gen(job_ptr);
+	int i;
+
+	/* Batch script is included based upon the requesting user */
+	if (show_flags & SHOW_DETAIL2) {
+		pack_job(job_ptr, show_flags, field_mask,
+			 buf_chain_tail(chain), protocol_version, uid);
+		return;
+	}
+
+	/* Multiple RPCs may pack this job concurrently under read locks */
+	slurm_mutex_lock(&job_pack_cache_mutex);
+	if (job_ptr->pack_cache) {
+		for (i = 0; i < JOB_PACK_CACHE_CNT; i++) {
+			cache_ptr = &job_ptr->pack_cache[i];
+			if (cache_ptr->data) {
+				size_hint = MAX(size_hint,
+						cache_ptr->data->size + 256);
+			}
+			if (!cache_ptr->data ||
+			    (cache_ptr->protocol_version != protocol_version) ||
+			    (cache_ptr->show_flags != show_flags) ||
+			    (cache_ptr->field_mask != field_mask) ||
+			    (cache_ptr->pack_gen != pack_gen))
+				continue;
+			if (cache_ptr->expire && (now >= cache_ptr->expire))
+				continue;
+			buf_chain_append_shared(chain, cache_ptr->data);
+			slurm_mutex_unlock(&job_pack_cache_mutex);
+			return;
+		}
+	}
+	slurm_mutex_unlock(&job_pack_cache_mutex);
+
+	/* A second partition update within this second would not change
+	 * last_part_update, so don't cache until it has passed */
+	if (last_part_update >= now) {
+		pack_job(job_ptr, show_flags, field_mask,
+			 buf_chain_tail(chain), protocol_version, uid);
+		return;
+	}
+
+	/* Pending job start time is reported as its begin time until then */
+	if ((job_ptr->start_time == 0) && job_ptr->details &&
+	    (job_ptr->details->begin_time > now))
+		expire = job_ptr->details->begin_time;
+
+	/* Pack into a buffer of its own, sized from any earlier record of
+	 * the job, whose data the cache and this message then share */
+	buffer = init_buf(size_hint);
+	pack_job(job_ptr, show_flags, field_mask, buffer, protocol_version,
+		 uid);
+	size = get_buf_offset(buffer);
+	data = xfer_buf_data(buffer);
+	if (size < xsize(data))
+		xrealloc_nz(data, size);
+	shared = create_buf_shared(data, size);
+	buf_chain_append_shared(chain, shared);
+
+	slurm_mutex_lock(&job_pack_cache_mutex);
+	if (!job_ptr->pack_cache) {
+		job_ptr->pack_cache = xmalloc(sizeof(struct job_pack_cache) *
+					      JOB_PACK_CACHE_CNT);
+	}
+	/* Replace a record with the same format, else an unused or stale
+	 * record, else the last one */
+	for (i = 0; i < JOB_PACK_CACHE_CNT; i++) {
+		cache_ptr = &job_ptr->pack_cache[i];
+		if ((cache_ptr->protocol_version == protocol_version) &&
+		    (cache_ptr->show_flags == show_flags) &&
+		    (cache_ptr->field_mask == field_mask)) {
+			use_ptr = cache_ptr;
+			break;
+		}
+		if (!use_ptr &&
+		    (!cache_ptr->data || (cache_ptr->pack_gen != pack_gen)))
+			use_ptr = cache_ptr;
+	}
+	if (!use_ptr)
+		use_ptr = &job_ptr->pack_cache[JOB_PACK_CACHE_CNT - 1];
+	if (use_ptr->data)
+		release_buf_shared(use_ptr->data);
+	use_ptr->data = shared;
+	use_ptr->protocol_version = protocol_version;
+	use_ptr->show_flags = show_flags;
+	use_ptr->field_mask = field_mask;
+	use_ptr->pack_gen = pack_gen;
+	use_ptr->expire = expire;
+	slurm_mutex_unlock(&job_pack_cache_mutex);
+}
+
+static void _del_job_tombstone(void *x)
+{
+	xfree(x);
+}
+
+/* Record the ID of a purged job for the job state journal, see
+ * dump_all_job_state() */
+static void _add_job_journal_purge(uint32_t job_id)
+{
+	uint32_t *job_id_ptr;
+
+	if (!job_journal_purge_list)
+		job_journal_purge_list = list_create(slurm_destroy_uint32_ptr);
+	job_id_ptr = xmalloc(sizeof(uint32_t));
+	*job_id_ptr = job_id;
+	list_append(job_journal_purge_list, job_id_ptr);
+}
+
+/* Record the ID of a purged job for delta job info, see pack_all_jobs().
+ * IDs are kept for JOB_TOMBSTONE_AGE seconds. */
+static void _add_job_tombstone(uint32_t job_id)
+{
+	job_tombstone_t *tomb_ptr;
+	ListIterator tomb_iterator;
+	time_t now = time(NULL);
+
+	if (!job_tombstone_list)
+		job_tombstone_list = list_create(_del_job_tombstone);
+
+	/* Records are in order of purge time */
+	tomb_iterator = list_iterator_create(job_tombstone_list);
+	while ((tomb_ptr = (job_tombstone_t *) list_next(tomb_iterator))) {
+		if ((tomb_ptr->purge_time + JOB_TOMBSTONE_AGE) > now)
+			break;
+		job_tombstone_horizon = tomb_ptr->purge_time;
+		list_delete_item(tomb_iterator);
+	}
+	list_iterator_destroy(tomb_iterator);
+
+	tomb_ptr = xmalloc(sizeof(job_tombstone_t));
+	tomb_ptr->job_id = job_id;
+	tomb_ptr->purge_time = now;
+	list_append(job_tombstone_list, tomb_ptr);
+}
+
+/*
+ * _job_delta_time - Return the time at which a change to a job's
+ *	information was last detected. Rather than time stamping the job
+ *	wherever it is modified, a digest of its packed record is compared
+ *	with that computed for the previous request. The job is not packed
+ *	again while _job_pack_gen() is unchanged.
+ * IN buffer - scratch buffer
+ */
+static time_t _job_delta_time(struct job_record *job_ptr, time_t now,
+			      Buf buffer)
+{
+	struct job_delta_stamp *delta_ptr = &job_ptr->delta;
+	time_t change_time, expire = 0;
+	uint64_t digest, pack_gen = _job_pack_gen(job_ptr);
+
+	slurm_mutex_lock(&job_pack_cache_mutex);
+	if (delta_ptr->change_time && (delta_ptr->pack_gen == pack_gen) &&
+	    (!delta_ptr->expire || (now < delta_ptr->expire))) {
+		change_time = delta_ptr->change_time;
+		slurm_mutex_unlock(&job_pack_cache_mutex);
+		return change_time;
+	}
+	slurm_mutex_unlock(&job_pack_cache_mutex);
+
+	set_buf_offset(buffer, 0);
+	pack_job(job_ptr, SHOW_DETAIL, JOB_FIELD_ALL, buffer,
+		 SLURM_PROTOCOL_VERSION, 0);
+	digest = get_buf_digest(buffer, 0);
+
+	/* Pending job start time is reported as its begin time until then */
+	if ((job_ptr->start_time == 0) && job_ptr->details &&
+	    (job_ptr->details->begin_time > now))
+		expire = job_ptr->details->begin_time;
+
+	slurm_mutex_lock(&job_pack_cache_mutex);
+	if (!delta_ptr->change_time || (delta_ptr->digest != digest)) {
+		delta_ptr->digest = digest;
+		delta_ptr->change_time = now;
+	}
+	delta_ptr->pack_gen = pack_gen;
+	delta_ptr->expire = expire;
+	change_time = delta_ptr->change_time;
+	slurm_mutex_unlock(&job_pack_cache_mutex);
+
+	return change_time;
+}
+
+/* Return true if changes to job information since update_time can be
+ * reported as a delta rather than all records */
+static bool _job_delta_valid(time_t update_time)
+{
+	if ((update_time <= job_tombstone_horizon) ||
+	    (update_time <= last_part_update) ||
+	    (update_time <= slurmctld_conf.last_update))
+		return false;
+	return true;
+}
+
+/* Add a job ID to an xmalloc'ed array */
+static void _add_removed_job(uint32_t **removed_ids, uint32_t *removed_cnt,
+			     uint32_t *removed_size, uint32_t job_id)
+{
+	if (*removed_cnt >= *removed_size) {
+		*removed_size = MAX(64, *removed_size * 2);
+		xrealloc(*removed_ids, sizeof(uint32_t) * *removed_size);
+	}
+	(*removed_ids)[(*removed_cnt)++] = job_id;
+}
+
 /*
  * pack_all_jobs - dump all job information for all jobs in
  *	machine independent form (for network transmission)
- * OUT buffer_ptr - the pointer is set to the allocated buffer.
- * OUT buffer_size - set to size of the buffer in bytes
+ * OUT chain_ptr - set to the packed information, which references cached
+ *	job records rather than copying them
  * IN show_flags - job filtering options
  * IN uid - uid of user making request (for partition filtering)
  * IN filter_uid - pack only jobs belonging to this user if not NO_VAL
+ * IN filter - pack only jobs and fields matching this filter, NULL for all
+ * IN update_time - with SHOW_DELTA, pack only jobs changed since this time
+ *	and the IDs of jobs removed since this time, if possible
  * global: job_list - global list of job records
- * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
+ * NOTE: the chain at *chain_ptr must be freed by the caller with
+ *	free_buf_chain()
  * NOTE: change _unpack_job_desc_msg() in common/slurm_protocol_pack.c
  *	whenever the data format changes
  */
-extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
-			  uint16_t show_flags, uid_t uid, uint32_t filter_uid,
+extern void pack_all_jobs(BufChain *chain_ptr, uint16_t show_flags,
+			  uid_t uid, uint32_t filter_uid,
+			  job_info_filter_t *filter, time_t update_time,
 			  uint16_t protocol_version)
 {
 	ListIterator job_iterator;
 	struct job_record *job_ptr;
+	job_tombstone_t *tomb_ptr;
 	uint32_t jobs_packed = 0, tmp_offset;
-	Buf buffer;
+	uint32_t *removed_ids = NULL, removed_cnt = 0, removed_size = 0;
+	BufChain chain;
+	Buf buffer, delta_buffer = NULL;
 	time_t min_age = 0, now = time(NULL);
+	uint32_t field_mask = JOB_FIELD_ALL;
+	bool delta = false, purge, skip;
 
-	buffer_ptr[0] = NULL;
-	*buffer_size = 0;
-
-	buffer = init_buf(BUF_SIZE);
+	chain = init_buf_chain();
+	buffer = buf_chain_tail(chain);
 
 	/* write message body header : size and time */
 	/* put in a place holder job record count of 0 for now */
@@ -7212,78 +8740,136 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 	if (slurmctld_conf.min_job_age > 0)
 		min_age = now  - slurmctld_conf.min_job_age;
 
+	if (filter) {
+		_sort_job_filter(filter);
+		field_mask = filter->field_mask;
+	}
+
+	if ((show_flags & SHOW_DELTA) && update_time &&
+	    (protocol_version >= SLURM_15_08_PROTOCOL_VERSION) &&
+	    _job_delta_valid(update_time)) {
+		delta = true;
+		delta_buffer = init_buf(BUF_SIZE);
+	}
+
 	/* write individual job records */
 	part_filter_set(uid);
 	job_iterator = list_iterator_create(job_list);
 	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
 		xassert (job_ptr->magic == JOB_MAGIC);
 
+		purge = false;
 		if (((show_flags & SHOW_ALL) == 0) && (uid != 0) &&
 		    _all_parts_hidden(job_ptr))
+			skip = true;
+		else if (_hide_job(job_ptr, uid))
+			skip = true;
+		else if ((min_age > 0) && (job_ptr->end_time < min_age) &&
+			 (! IS_JOB_COMPLETING(job_ptr)) &&
+			 IS_JOB_FINISHED(job_ptr))
+			skip = purge = true; /* job ready for purging */
+		else if ((filter_uid != NO_VAL) &&
+			 (filter_uid != job_ptr->user_id))
+			skip = true;
+		else if (filter && !_match_job_filter(job_ptr, filter))
+			skip = true;
+		else
+			skip = false;
+
+		/* A job which changed since update_time, but is no longer
+		 * reported, is reported as removed */
+		if (delta) {
+			if ((_job_delta_time(job_ptr, now, delta_buffer) <
+			     update_time) &&
+			    (!purge ||
+			     ((job_ptr->end_time + slurmctld_conf.min_job_age) <
+			      update_time)))
+				continue;
+			if (skip) {
+				_add_removed_job(&removed_ids, &removed_cnt,
+						 &removed_size,
+						 job_ptr->job_id);
+				continue;
+			}
+		} else if (skip)
 			continue;
 
-		if (_hide_job(job_ptr, uid))
-			continue;
-
-		if ((min_age > 0) && (job_ptr->end_time < min_age) &&
-		    (! IS_JOB_COMPLETING(job_ptr)) && IS_JOB_FINISHED(job_ptr))
-			continue;	/* job ready for purging, don't dump */
-
-		if ((filter_uid != NO_VAL) && (filter_uid != job_ptr->user_id))
-			continue;
-
-		pack_job(job_ptr, show_flags, buffer, protocol_version, uid);
+		_pack_job_cached(job_ptr, show_flags, field_mask, chain,
+				 protocol_version, uid, now);
 		jobs_packed++;
 	}
 	part_filter_clear();
 	list_iterator_destroy(job_iterator);
 
+	if (protocol_version >= SLURM_15_08_PROTOCOL_VERSION) {
+		pack16((uint16_t) delta, buf_chain_tail(chain));
+		if (delta && job_tombstone_list) {
+			job_iterator = list_iterator_create(job_tombstone_list);
+			while ((tomb_ptr = (job_tombstone_t *)
+					   list_next(job_iterator))) {
+				if (tomb_ptr->purge_time < update_time)
+					continue;
+				_add_removed_job(&removed_ids, &removed_cnt,
+						 &removed_size,
+						 tomb_ptr->job_id);
+			}
+			list_iterator_destroy(job_iterator);
+		}
+		if (delta) {
+			pack32_array(removed_ids, removed_cnt,
+				     buf_chain_tail(chain));
+		}
+	}
+	xfree(removed_ids);
+	if (delta_buffer)
+		free_buf(delta_buffer);
+
 	/* put the real record count in the message body header */
 	tmp_offset = get_buf_offset(buffer);
 	set_buf_offset(buffer, 0);
 	pack32(jobs_packed, buffer);
 	set_buf_offset(buffer, tmp_offset);
 
-	*buffer_size = get_buf_offset(buffer);
-	buffer_ptr[0] = xfer_buf_data(buffer);
+	*chain_ptr = chain;
 }
 
 /*
  * pack_one_job - dump information for one jobs in
  *	machine independent form (for network transmission)
- * OUT buffer_ptr - the pointer is set to the allocated buffer.
- * OUT buffer_size - set to size of the buffer in bytes
+ * OUT chain_ptr - set to the packed information, see pack_all_jobs()
  * IN job_id - ID of job that we want info for
  * IN show_flags - job filtering options
  * IN uid - uid of user making request (for partition filtering)
- * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
+ * NOTE: the chain at *chain_ptr must be freed by the caller with
+ *	free_buf_chain()
  * NOTE: change _unpack_job_desc_msg() in common/slurm_protocol_pack.c
  *	whenever the data format changes
  */
-extern int pack_one_job(char **buffer_ptr, int *buffer_size,
-			uint32_t job_id, uint16_t show_flags, uid_t uid,
+extern int pack_one_job(BufChain *chain_ptr, uint32_t job_id,
+			uint16_t show_flags, uid_t uid,
 			uint16_t protocol_version)
 {
 	struct job_record *job_ptr;
 	uint32_t jobs_packed = 0, tmp_offset;
+	BufChain chain;
 	Buf buffer;
+	time_t now = time(NULL);
 
-	buffer_ptr[0] = NULL;
-	*buffer_size = 0;
-
-	buffer = init_buf(BUF_SIZE);
+	*chain_ptr = NULL;
+	chain = init_buf_chain();
+	buffer = buf_chain_tail(chain);
 
 	/* write message body header : size and time */
 	/* put in a place holder job record count of 0 for now */
 	pack32(jobs_packed, buffer);
-	pack_time(time(NULL), buffer);
+	pack_time(now, buffer);
 
 	job_ptr = find_job_record(job_id);
 	if (job_ptr && (job_ptr->array_task_id == NO_VAL) &&
 	    !job_ptr->array_recs) {
 		if (!_hide_job(job_ptr, uid)) {
-			pack_job(job_ptr, show_flags, buffer, protocol_version,
-				 uid);
+			_pack_job_cached(job_ptr, show_flags, JOB_FIELD_ALL,
+					 chain, protocol_version, uid, now);
 			jobs_packed++;
 		}
 	} else {
@@ -7293,21 +8879,23 @@ extern int pack_one_job(char **buffer_ptr, int *buffer_size,
 		if (job_ptr) {
 			packed_head = true;
 			if (!_hide_job(job_ptr, uid)) {
-				pack_job(job_ptr, show_flags, buffer,
-					 protocol_version, uid);
+				_pack_job_cached(job_ptr, show_flags,
+						 JOB_FIELD_ALL, chain,
+						 protocol_version, uid, now);
 				jobs_packed++;
 			}
 		}
 
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
+		job_ptr = lhash_first(job_array_hash_j, job_id);
 		while (job_ptr) {
 			if ((job_ptr->job_id == job_id) && packed_head) {
 				;	/* Already packed */
 			} else if (job_ptr->array_job_id == job_id) {
 				if (_hide_job(job_ptr, uid))
 					break;
-				pack_job(job_ptr, show_flags, buffer,
-					 protocol_version, uid);
+				_pack_job_cached(job_ptr, show_flags,
+						 JOB_FIELD_ALL, chain,
+						 protocol_version, uid, now);
 				jobs_packed++;
 			}
 			job_ptr = job_ptr->job_array_next_j;
@@ -7315,18 +8903,20 @@ extern int pack_one_job(char **buffer_ptr, int *buffer_size,
 	}
 
 	if (jobs_packed == 0) {
-		free_buf(buffer);
+		free_buf_chain(chain);
 		return ESLURM_INVALID_JOB_ID;
 	}
 
+	if (protocol_version >= SLURM_15_08_PROTOCOL_VERSION)
+		pack16((uint16_t) 0, buf_chain_tail(chain));	/* not a delta */
+
 	/* put the real record count in the message body header */
 	tmp_offset = get_buf_offset(buffer);
 	set_buf_offset(buffer, 0);
 	pack32(jobs_packed, buffer);
 	set_buf_offset(buffer, tmp_offset);
 
-	*buffer_size = get_buf_offset(buffer);
-	buffer_ptr[0] = xfer_buf_data(buffer);
+	*chain_ptr = chain;
 
 	return SLURM_SUCCESS;
 }
@@ -7341,9 +8931,12 @@ extern int pack_one_job(char **buffer_ptr, int *buffer_size,
  * IN uid - user requesting the data
  * NOTE: change _unpack_job_info_members() in common/slurm_protocol_pack.c
  *	  whenever the data format changes
+ * NOTE: change _job_pack_fingerprint() whenever data referenced by the job
+ *	  record is added
  */
-void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags, Buf buffer,
-	      uint16_t protocol_version, uid_t uid)
+void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags,
+	      uint32_t field_mask, Buf buffer, uint16_t protocol_version,
+	      uid_t uid)
 {
 	struct job_details *detail_ptr;
 	time_t begin_time = 0;
@@ -7426,10 +9019,22 @@ void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags, Buf buffer,
 		else
 			packstr(dump_job_ptr->partition, buffer);
 		packstr(dump_job_ptr->account, buffer);
-		packstr(dump_job_ptr->network, buffer);
-		packstr(dump_job_ptr->comment, buffer);
-		packstr(dump_job_ptr->gres, buffer);
-		packstr(dump_job_ptr->batch_host, buffer);
+		if (field_mask & JOB_FIELD_NETWORK)
+			packstr(dump_job_ptr->network, buffer);
+		else
+			packnull(buffer);
+		if (field_mask & JOB_FIELD_COMMENT)
+			packstr(dump_job_ptr->comment, buffer);
+		else
+			packnull(buffer);
+		if (field_mask & JOB_FIELD_GRES)
+			packstr(dump_job_ptr->gres, buffer);
+		else
+			packnull(buffer);
+		if (field_mask & JOB_FIELD_BATCH_HOST)
+			packstr(dump_job_ptr->batch_host, buffer);
+		else
+			packnull(buffer);
 		if (!IS_JOB_COMPLETED(dump_job_ptr) &&
 		    (show_flags & SHOW_DETAIL2) &&
 		    ((dump_job_ptr->user_id == (uint32_t) uid) ||
@@ -7450,8 +9055,14 @@ void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags, Buf buffer,
 			packnull(buffer);
 		assoc_mgr_unlock(&locks);
 
-		packstr(dump_job_ptr->licenses, buffer);
-		packstr(dump_job_ptr->state_desc, buffer);
+		if (field_mask & JOB_FIELD_LICENSES)
+			packstr(dump_job_ptr->licenses, buffer);
+		else
+			packnull(buffer);
+		if (field_mask & JOB_FIELD_STATE_DESC)
+			packstr(dump_job_ptr->state_desc, buffer);
+		else
+			packnull(buffer);
 		packstr(dump_job_ptr->resv_name, buffer);
 
 		pack32(dump_job_ptr->exit_code, buffer);
@@ -7471,7 +9082,9 @@ void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags, Buf buffer,
 		pack32(dump_job_ptr->wait4switch, buffer);
 
 		packstr(dump_job_ptr->alloc_node, buffer);
-		if (!IS_JOB_COMPLETING(dump_job_ptr))
+		if (!(field_mask & JOB_FIELD_NODE_INX))
+			packnull(buffer);
+		else if (!IS_JOB_COMPLETING(dump_job_ptr))
 			pack_bit_fmt(dump_job_ptr->node_bitmap, buffer);
 		else
 			pack_bit_fmt(dump_job_ptr->node_bitmap_cg, buffer);
@@ -7480,16 +9093,19 @@ void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags, Buf buffer,
 					     buffer, protocol_version);
 
 		/* A few details are always dumped here */
-		_pack_default_job_details(dump_job_ptr, buffer,
+		_pack_default_job_details(dump_job_ptr, field_mask,
+					  buffer,
 					  protocol_version);
 
 		/* other job details are only dumped until the job starts
 		 * running (at which time they become meaningless) */
 		if (detail_ptr)
-			_pack_pending_job_details(detail_ptr, buffer,
+			_pack_pending_job_details(detail_ptr, field_mask,
+						  buffer,
 						  protocol_version);
 		else
-			_pack_pending_job_details(NULL, buffer,
+			_pack_pending_job_details(NULL, field_mask,
+						  buffer,
 						  protocol_version);
 	} else if (protocol_version >= SLURM_14_11_PROTOCOL_VERSION) {
 		detail_ptr = dump_job_ptr->details;
@@ -7619,16 +9235,19 @@ void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags, Buf buffer,
 					     buffer, protocol_version);
 
 		/* A few details are always dumped here */
-		_pack_default_job_details(dump_job_ptr, buffer,
+		_pack_default_job_details(dump_job_ptr, field_mask,
+					  buffer,
 					  protocol_version);
 
 		/* other job details are only dumped until the job starts
 		 * running (at which time they become meaningless) */
 		if (detail_ptr)
-			_pack_pending_job_details(detail_ptr, buffer,
+			_pack_pending_job_details(detail_ptr, field_mask,
+						  buffer,
 						  protocol_version);
 		else
-			_pack_pending_job_details(NULL, buffer,
+			_pack_pending_job_details(NULL, field_mask,
+						  buffer,
 						  protocol_version);
 	} else if (protocol_version >= SLURM_14_03_PROTOCOL_VERSION) {
 		detail_ptr = dump_job_ptr->details;
@@ -7747,16 +9366,19 @@ void pack_job(struct job_record *dump_job_ptr, uint16_t show_flags, Buf buffer,
 					     buffer, protocol_version);
 
 		/* A few details are always dumped here */
-		_pack_default_job_details(dump_job_ptr, buffer,
+		_pack_default_job_details(dump_job_ptr, field_mask,
+					  buffer,
 					  protocol_version);
 
 		/* other job details are only dumped until the job starts
 		 * running (at which time they become meaningless) */
 		if (detail_ptr)
-			_pack_pending_job_details(detail_ptr, buffer,
+			_pack_pending_job_details(detail_ptr, field_mask,
+						  buffer,
 						  protocol_version);
 		else
-			_pack_pending_job_details(NULL, buffer,
+			_pack_pending_job_details(NULL, field_mask,
+						  buffer,
 						  protocol_version);
 	} else {
 		error("pack_job: protocol_version "
@@ -7792,7 +9414,8 @@ static void _find_node_config(int *cpu_cnt_ptr, int *core_cnt_ptr)
 
 /* pack default job details for "get_job_info" RPC */
 static void _pack_default_job_details(struct job_record *job_ptr,
-				      Buf buffer, uint16_t protocol_version)
+				      uint32_t field_mask, Buf buffer,
+				      uint16_t protocol_version)
 {
 	static int max_cpu_cnt = -1, max_core_cnt = -1;
 	int i;
@@ -7826,11 +9449,21 @@ static void _pack_default_job_details(struct job_record *job_ptr,
 
 	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		if (detail_ptr) {
-			packstr(detail_ptr->features,   buffer);
-			packstr(detail_ptr->work_dir,   buffer);
-			packstr(detail_ptr->dependency, buffer);
+			if (field_mask & JOB_FIELD_FEATURES)
+				packstr(detail_ptr->features, buffer);
+			else
+				packnull(buffer);
+			if (field_mask & JOB_FIELD_WORK_DIR)
+				packstr(detail_ptr->work_dir, buffer);
+			else
+				packnull(buffer);
+			if (field_mask & JOB_FIELD_DEPENDENCY)
+				packstr(detail_ptr->dependency, buffer);
+			else
+				packnull(buffer);
 
-			if (detail_ptr->argv) {
+			if (detail_ptr->argv &&
+			    (field_mask & JOB_FIELD_COMMAND)) {
 				/* Determine size needed for a string
 				 * containing all arguments */
 				for (i=0; detail_ptr->argv[i]; i++) {
@@ -7956,7 +9589,8 @@ static void _pack_default_job_details(struct job_record *job_ptr,
 
 /* pack pending job details for "get_job_info" RPC */
 static void _pack_pending_job_details(struct job_details *detail_ptr,
-				      Buf buffer, uint16_t protocol_version)
+				      uint32_t field_mask, Buf buffer,
+				      uint16_t protocol_version)
 {
 	if (protocol_version >= SLURM_14_03_PROTOCOL_VERSION) {
 		if (detail_ptr) {
@@ -7968,15 +9602,30 @@ static void _pack_pending_job_details(struct job_details *detail_ptr,
 			pack32(detail_ptr->pn_min_memory, buffer);
 			pack32(detail_ptr->pn_min_tmp_disk, buffer);
 
-			packstr(detail_ptr->req_nodes, buffer);
-			pack_bit_fmt(detail_ptr->req_node_bitmap, buffer);
-			/* detail_ptr->req_node_layout is not packed */
-			packstr(detail_ptr->exc_nodes, buffer);
-			pack_bit_fmt(detail_ptr->exc_node_bitmap, buffer);
+			if (field_mask & JOB_FIELD_REQ_NODES) {
+				packstr(detail_ptr->req_nodes, buffer);
+				pack_bit_fmt(detail_ptr->req_node_bitmap,
+					     buffer);
+				/* detail_ptr->req_node_layout is not packed */
+				packstr(detail_ptr->exc_nodes, buffer);
+				pack_bit_fmt(detail_ptr->exc_node_bitmap,
+					     buffer);
+			} else {
+				packnull(buffer);
+				packnull(buffer);
+				packnull(buffer);
+				packnull(buffer);
+			}
 
-			packstr(detail_ptr->std_err, buffer);
-			packstr(detail_ptr->std_in, buffer);
-			packstr(detail_ptr->std_out, buffer);
+			if (field_mask & JOB_FIELD_STD_IO) {
+				packstr(detail_ptr->std_err, buffer);
+				packstr(detail_ptr->std_in, buffer);
+				packstr(detail_ptr->std_out, buffer);
+			} else {
+				packnull(buffer);
+				packnull(buffer);
+				packnull(buffer);
+			}
 
 			pack_multi_core_data(detail_ptr->mc_ptr, buffer,
 					     protocol_version);
@@ -8017,12 +9666,18 @@ void purge_old_job(void)
 {
 	ListIterator job_iterator;
 	struct job_record  *job_ptr;
-	int i;
+	job_time_rec_t time_rec;
+	time_t now = time(NULL);
+	int purge_cnt = 0;
 
 	job_iterator = list_iterator_create(job_list);
 	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
-		if (!IS_JOB_PENDING(job_ptr))
+		if (!IS_JOB_PENDING(job_ptr)) {
+			/* In case the job was not queued when it finished */
+			if (!job_ptr->purge_check)
+				queue_job_purge_check(job_ptr);
 			continue;
+		}
 		if (test_job_dependency(job_ptr) == 2) {
 			char jbuf[JBUFSIZ];
 
@@ -8034,9 +9689,21 @@ void purge_old_job(void)
 	}
 	list_iterator_destroy(job_iterator);
 
-	i = list_delete_all(job_list, &_list_find_job_old, "");
-	if (i) {
-		debug2("purge_old_job: purged %d old job records", i);
+	while (_job_time_heap_pop(&job_purge_heap, now, &time_rec)) {
+		job_ptr = find_job_record(time_rec.job_id);
+		if (!job_ptr || (job_ptr->purge_check != time_rec.due))
+			continue;	/* Superseded by a later entry */
+		job_ptr->purge_check = 0;
+		/* job_list is in submission order, so finished jobs are
+		 * usually found near its head */
+		if (_list_find_job_old(job_ptr, NULL))
+			purge_cnt += list_delete_ptr(job_list, job_ptr);
+		else
+			queue_job_purge_check(job_ptr);
+	}
+
+	if (purge_cnt) {
+		debug2("purge_old_job: purged %d old job records", purge_cnt);
 /*		last_job_update = now;		don't worry about state save */
 	}
 }
@@ -8201,7 +9868,7 @@ void reset_job_bitmaps(void)
 	}
 	list_iterator_destroy(job_iterator);
 
-	last_job_update = now;
+	all_jobs_changed(now);
 }
 
 static int _reset_detail_bitmaps(struct job_record *job_ptr)
@@ -8575,7 +10242,7 @@ static int _update_job(struct job_record *job_ptr, job_desc_msg_t * job_specs,
 	detail_ptr = job_ptr->details;
 	if (detail_ptr)
 		mc_ptr = detail_ptr->mc_ptr;
-	last_job_update = now;
+	job_changed(job_ptr, now);
 
 	if (job_specs->account
 	    && !xstrcmp(job_specs->account, job_ptr->account)) {
@@ -9989,6 +11656,7 @@ static int _update_job(struct job_record *job_ptr, job_desc_msg_t * job_specs,
 			job_ptr->state_reason = fail_reason;
 			xfree(job_ptr->state_desc);
 		}
+		sched_queue_job_update(job_ptr);
 		return error_code;
 	} else if ((job_ptr->state_reason != WAIT_HELD)
 		   && (job_ptr->state_reason != WAIT_HELD_USER)
@@ -10235,6 +11903,10 @@ fini:
 	    strcmp(slurmctld_conf.priority_type, "priority/basic"))
 		set_job_prio(job_ptr);
 
+	/* The job's end time, mail or reservation may have changed */
+	queue_job_time_check(job_ptr);
+	sched_queue_job_update(job_ptr);
+
 	return error_code;
 }
 
@@ -10328,7 +12000,7 @@ extern int update_job_str(slurm_msg_t *msg, uid_t uid)
 		}
 
 		/* Update all tasks of this job array */
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
+		job_ptr = lhash_first(job_array_hash_j, job_id);
 		if (!job_ptr && !job_ptr_done) {
 			info("update_job_str: invalid job id %u", job_id);
 			rc = ESLURM_INVALID_JOB_ID;
@@ -10412,6 +12084,8 @@ extern int update_job_str(slurm_msg_t *msg, uid_t uid)
 				} else {
 					/* The array_recs structure is moved
 					 * to the new job record copy */
+					sched_queue_job_update(job_ptr);
+					sched_queue_job_update(new_job_ptr);
 					job_ptr = new_job_ptr;
 				}
 			}
@@ -10626,6 +12300,8 @@ validate_jobs_on_node(slurm_node_registration_status_msg_t *reg_msg)
 	}
 
 	if (reg_msg->up_time <= now) {
+		if (node_ptr->slurmd_start_time != reg_msg->slurmd_start_time)
+			node_changed(node_ptr, now);	/* slurmd restarted */
 		node_ptr->up_time = reg_msg->up_time;
 		node_ptr->boot_time = now - reg_msg->up_time;
 		node_ptr->slurmd_start_time = reg_msg->slurmd_start_time;
@@ -11302,6 +12978,7 @@ extern bool job_epilog_complete(uint32_t job_id, char *node_name,
 	step_epilog_complete(job_ptr, node_name);
 	/* nodes_completing is out of date, rebuild when next saved */
 	xfree(job_ptr->nodes_completing);
+	job_changed(job_ptr, time(NULL));
 	if (!IS_JOB_COMPLETING(job_ptr)) {	/* COMPLETED */
 		batch_requeue_fini(job_ptr);
 		return true;
@@ -11318,6 +12995,7 @@ void batch_requeue_fini(struct job_record  *job_ptr)
 		return;
 
 	info("requeue batch job %u", job_ptr->job_id);
+	job_changed(job_ptr, time(NULL));
 
 	/* Clear everything so this appears to be a new job and then restart
 	 * it in accounting. */
@@ -11373,9 +13051,18 @@ void job_fini (void)
 		list_destroy(job_list);
 		job_list = NULL;
 	}
-	xfree(job_hash);
-	xfree(job_array_hash_j);
-	xfree(job_array_hash_t);
+	FREE_NULL_LIST(job_tombstone_list);
+	FREE_NULL_LIST(job_journal_purge_list);
+	xfree(job_time_heap.rec);
+	memset(&job_time_heap, 0, sizeof(job_time_heap_t));
+	xfree(job_purge_heap.rec);
+	memset(&job_purge_heap, 0, sizeof(job_time_heap_t));
+	lhash_destroy(job_hash);
+	job_hash = NULL;
+	lhash_destroy(job_array_hash_j);
+	job_array_hash_j = NULL;
+	lhash_destroy(job_array_hash_t);
+	job_array_hash_t = NULL;
 }
 
 /* Record the start of one job array task */
@@ -11465,6 +13152,7 @@ extern void job_completion_logger(struct job_record *job_ptr, bool requeue)
 		free_job_resources(&job_ptr->job_resrcs);
 #endif
 	acct_policy_remove_job_submit(job_ptr);
+	notify_job_dependents(job_ptr);
 
 	if (!IS_JOB_RESIZING(job_ptr)) {
 		/* Remove configuring state just to make sure it isn't there
@@ -11491,6 +13179,7 @@ extern void job_completion_logger(struct job_record *job_ptr, bool requeue)
 	}
 
 	_job_array_comp(job_ptr);
+	queue_job_purge_check(job_ptr);
 
 	g_slurm_jobcomp_write(job_ptr);
 
@@ -11856,8 +13545,9 @@ static int _suspend_job_nodes(struct job_record *job_ptr, bool indf_susp)
 			node_ptr->node_state = NODE_STATE_IDLE | node_flags;
 			node_ptr->last_idle  = now;
 		}
+		node_changed(node_ptr, now);
 	}
-	last_job_update = last_node_update = now;
+	job_changed(job_ptr, now);
 	return rc;
 }
 
@@ -11872,6 +13562,7 @@ static int _resume_job_nodes(struct job_record *job_ptr, bool indf_susp)
 	int i, rc = SLURM_SUCCESS;
 	struct node_record *node_ptr = node_record_table_ptr;
 	uint32_t node_flags;
+	time_t now = time(NULL);
 
 	if ((rc = select_g_job_resume(job_ptr, indf_susp)) != SLURM_SUCCESS)
 		return rc;
@@ -11904,8 +13595,9 @@ static int _resume_job_nodes(struct job_record *job_ptr, bool indf_susp)
 		bit_clear(idle_node_bitmap, i);
 		node_flags = node_ptr->node_state & NODE_STATE_FLAGS;
 		node_ptr->node_state = NODE_STATE_ALLOCATED | node_flags;
+		node_changed(node_ptr, now);
 	}
-	last_job_update = last_node_update = time(NULL);
+	job_changed(job_ptr, now);
 	return rc;
 }
 
@@ -12039,6 +13731,7 @@ static int _job_suspend(struct job_record *job_ptr, uint16_t op, bool indf_susp)
 				- job_ptr->pre_sus_time;
 		}
 		resume_job_step(job_ptr);
+		queue_job_time_check(job_ptr);
 	}
 
 	job_ptr->time_last_active = now;
@@ -12194,7 +13887,7 @@ extern int job_suspend2(suspend_msg_t *sus_ptr, uid_t uid,
 		}
 
 		/* Suspend all tasks of this job array */
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
+		job_ptr = lhash_first(job_array_hash_j, job_id);
 		if (!job_ptr && !job_ptr_done) {
 			rc = ESLURM_INVALID_JOB_ID;
 			goto reply;
@@ -12316,6 +14009,7 @@ static int _job_requeue(uid_t uid, struct job_record *job_ptr, bool preempt,
 		uint32_t flags;
 		flags = job_ptr->job_state & JOB_STATE_FLAGS;
 		job_ptr->job_state = JOB_PENDING | flags;
+		sched_queue_job_update(job_ptr);
 		return SLURM_SUCCESS;
 	}
 
@@ -12331,7 +14025,7 @@ static int _job_requeue(uid_t uid, struct job_record *job_ptr, bool preempt,
 	}
 
 	slurm_sched_g_requeue(job_ptr, "Job requeued by user/admin");
-	last_job_update = now;
+	job_changed(job_ptr, now);
 
 	if (IS_JOB_SUSPENDED(job_ptr)) {
 		enum job_states suspend_job_state = job_ptr->job_state;
@@ -12401,6 +14095,8 @@ static int _job_requeue(uid_t uid, struct job_record *job_ptr, bool preempt,
 		job_ptr->state_reason = WAIT_HELD_USER;
 		job_ptr->priority = 0;
 	}
+	sched_queue_job_update(job_ptr);
+	notify_job_dependents(job_ptr);
 
 	debug("%s: job %u state 0x%x reason %u priority %d", __func__,
 	      job_ptr->job_id, job_ptr->job_state,
@@ -12512,7 +14208,7 @@ extern int job_requeue2(uid_t uid, requeue_msg_t *req_ptr,
 		}
 
 		/* Requeue all tasks of this job array */
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
+		job_ptr = lhash_first(job_array_hash_j, job_id);
 		if (!job_ptr && !job_ptr_done) {
 			rc = ESLURM_INVALID_JOB_ID;
 			goto reply;
@@ -12822,7 +14518,7 @@ extern int update_job_account(char *module, struct job_record *job_ptr,
 	}
 	job_ptr->assoc_id = assoc_rec.id;
 
-	last_job_update = time(NULL);
+	job_changed(job_ptr, time(NULL));
 
 	return SLURM_SUCCESS;
 }
@@ -12886,7 +14582,7 @@ extern int update_job_wckey(char *module, struct job_record *job_ptr,
 		     module, job_ptr->job_id);
 	}
 
-	last_job_update = time(NULL);
+	job_changed(job_ptr, time(NULL));
 
 	return SLURM_SUCCESS;
 }
@@ -13014,7 +14710,7 @@ extern int job_checkpoint(checkpoint_msg_t *ckpt_ptr, uid_t uid,
 				   &resp_data.error_msg);
 		info("checkpoint_op %u of %u.%u complete, rc=%d",
 		     ckpt_ptr->op, ckpt_ptr->job_id, ckpt_ptr->step_id, rc);
-		last_job_update = time(NULL);
+		job_changed(job_ptr, time(NULL));
 	} else {		/* operate on all of a job's steps */
 		int update_rc = -2;
 		ListIterator step_iterator;
@@ -13048,7 +14744,7 @@ extern int job_checkpoint(checkpoint_msg_t *ckpt_ptr, uid_t uid,
 			xfree(image_dir);
 		}
 		if (update_rc != -2)	/* some work done */
-			last_job_update = time(NULL);
+			job_changed(job_ptr, time(NULL));
 		list_iterator_destroy (step_iterator);
 	}
 
@@ -13466,7 +15162,7 @@ extern int job_restart(checkpoint_msg_t *ckpt_ptr, uid_t uid, slurm_fd_t conn_fd
 		job_ptr->details->restart_dir = image_dir;
 		image_dir = NULL;	/* Nothing left to xfree */
 
-		last_job_update = time(NULL);
+		job_changed(job_ptr, time(NULL));
 	}
 
  unpack_error:
@@ -13536,12 +15232,15 @@ extern void build_cg_bitmap(struct job_record *job_ptr)
 	FREE_NULL_BITMAP(job_ptr->node_bitmap_cg);
 	if (job_ptr->node_bitmap) {
 		job_ptr->node_bitmap_cg = bit_copy(job_ptr->node_bitmap);
-		if (bit_set_count(job_ptr->node_bitmap_cg) == 0)
+		if (bit_set_count(job_ptr->node_bitmap_cg) == 0) {
 			job_ptr->job_state &= (~JOB_COMPLETING);
+			notify_job_dependents(job_ptr);
+		}
 	} else {
 		error("build_cg_bitmap: node_bitmap is NULL");
 		job_ptr->node_bitmap_cg = bit_alloc(node_record_count);
 		job_ptr->job_state &= (~JOB_COMPLETING);
+		notify_job_dependents(job_ptr);
 	}
 }
 
@@ -13600,6 +15299,8 @@ extern void job_hold_requeue(struct job_record *job_ptr)
 	}
 
 	job_ptr->job_state &= ~JOB_REQUEUE;
+	sched_queue_job_update(job_ptr);
+	notify_job_dependents(job_ptr);
 
 	debug("%s: job %u state 0x%x reason %u priority %d", __func__,
 	      job_ptr->job_id, job_ptr->job_state,
@@ -13710,6 +15411,7 @@ _set_job_requeue_exit_value(struct job_record *job_ptr)
 			debug2("%s: job %d exit code %d state JOB_SPECIAL_EXIT",
 			       __func__, job_ptr->job_id, exit_code);
 			job_ptr->job_state |= JOB_SPECIAL_EXIT;
+			notify_job_dependents(job_ptr);
 			return;
 		}
 	}
@@ -13728,6 +15430,7 @@ extern void job_end_time_reset(struct job_record  *job_ptr)
 		job_ptr->end_time = job_ptr->start_time +
 				    (job_ptr->time_limit * 60);	/* secs */
 	}
+	queue_job_time_check(job_ptr);
 }
 
 /*
@@ -13816,6 +15519,7 @@ extern void job_array_post_sched(struct job_record *job_ptr)
 		if (new_job_ptr) {
 			new_job_ptr->job_state = JOB_PENDING;
 			new_job_ptr->start_time = (time_t) 0;
+			sched_queue_job_update(new_job_ptr);
 			/* Do NOT clear db_index here, it is handled when
 			 * task_id_str is created elsewhere */
 		}
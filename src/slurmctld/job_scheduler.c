@@ -57,6 +57,7 @@
 #include "src/common/assoc_mgr.h"
 #include "src/common/env.h"
 #include "src/common/gres.h"
+#include "src/common/lhash.h"
 #include "src/common/list.h"
 #include "src/common/macros.h"
 #include "src/common/node_select.h"
@@ -85,6 +86,8 @@
 #define BUILD_TIMEOUT 2000000	/* Max build_job_queue() run time in usec */
 #define MAX_FAILED_RESV 10
 #define MAX_RETRIES 10
+#define SCHED_QUEUE_REBUILD_TIME 60	/* Max age of scheduling queue order */
+#define DEPEND_RETEST_TIME 300	/* Max age of a dependency test result */
 
 typedef struct epilog_arg {
 	char *epilog_slurmctld;
@@ -179,8 +182,12 @@ static bool _job_runnable_test1(struct job_record *job_ptr, bool clear_start)
 	if (cleaning) {
 		/* Job's been requeued and the
 		 * previous run hasn't finished yet */
-		job_ptr->state_reason = WAIT_CLEANING;
-		xfree(job_ptr->state_desc);
+		if ((job_ptr->state_reason != WAIT_CLEANING) ||
+		    job_ptr->state_desc) {
+			job_ptr->state_reason = WAIT_CLEANING;
+			xfree(job_ptr->state_desc);
+			job_changed(job_ptr, time(NULL));
+		}
 		debug3("sched: JobId=%u. State=PENDING. "
 		       "Reason=Cleaning.",
 		       job_ptr->job_id);
@@ -192,7 +199,7 @@ static bool _job_runnable_test1(struct job_record *job_ptr, bool clear_start)
 	if (job_ptr->state_reason == WAIT_FRONT_END) {
 		job_ptr->state_reason = WAIT_NO_REASON;
 		xfree(job_ptr->state_desc);
-		last_job_update = time(NULL);
+		job_changed(job_ptr, time(NULL));
 	}
 #endif
 
@@ -206,7 +213,7 @@ static bool _job_runnable_test1(struct job_record *job_ptr, bool clear_start)
 		    && job_ptr->state_reason != WAIT_MAX_REQUEUE) {
 			job_ptr->state_reason = WAIT_HELD;
 			xfree(job_ptr->state_desc);
-			last_job_update = time(NULL);
+			job_changed(job_ptr, time(NULL));
 		}
 		debug3("sched: JobId=%u. State=%s. Reason=%s. Priority=%u.",
 		       job_ptr->job_id,
@@ -222,6 +229,7 @@ static bool _job_runnable_test1(struct job_record *job_ptr, bool clear_start)
 		/* released behind active dependency? */
 		job_ptr->state_reason = WAIT_DEPENDENCY;
 		xfree(job_ptr->state_desc);
+		job_changed(job_ptr, time(NULL));
 	}
 
 	if (!job_indepen)	/* can not run now */
@@ -245,6 +253,7 @@ static bool _job_runnable_test2(struct job_record *job_ptr, bool check_min_time)
 	     (!part_policy_job_runnable_state(job_ptr)))) {
 		job_ptr->state_reason = reason;
 		xfree(job_ptr->state_desc);
+		job_changed(job_ptr, time(NULL));
 	}
 	if (reason != WAIT_NO_REASON)
 		return false;
@@ -317,6 +326,7 @@ extern List build_job_queue(bool clear_start, bool backfill)
 				    (!part_policy_job_runnable_state(job_ptr))){
 					job_ptr->state_reason = reason;
 					xfree(job_ptr->state_desc);
+					job_changed(job_ptr, time(NULL));
 				}
 				/* priority_array index matches part_ptr_list
 				 * position: increment inx */
@@ -392,6 +402,86 @@ extern bool job_is_completing(void)
 	return completing;
 }
 
+/* FNV-1a hash of some data, added to shape */
+static uint64_t _shape_add(uint64_t shape, const void *data, size_t len)
+{
+	const uint8_t *ptr = (const uint8_t *) data;
+
+	while (len--) {
+		shape ^= *ptr++;
+		shape *= 1099511628211ULL;
+	}
+	return shape;
+}
+
+static uint64_t _shape_add_str(uint64_t shape, const char *str)
+{
+	static const uint8_t null_str = 0xff;
+
+	if (!str)
+		return _shape_add(shape, &null_str, 1);
+	return _shape_add(shape, str, strlen(str) + 1);
+}
+
+/*
+ * job_shape - return a hash of the parts of a pending job's request which
+ *	determine where and when it can start: its node, CPU, memory and
+ *	GRES counts, features, required and excluded nodes, licenses, QOS,
+ *	reservation and time limit. Jobs with the same shape in the same
+ *	partition get the same answer from select_g_job_test().
+ */
+extern uint64_t job_shape(struct job_record *job_ptr)
+{
+	struct job_details *detail_ptr = job_ptr->details;
+	multi_core_data_t *mc_ptr;
+	uint64_t shape = 14695981039346656037ULL;
+
+#define _SHAPE_ADD(field) shape = _shape_add(shape, &(field), sizeof(field))
+	_SHAPE_ADD(job_ptr->time_limit);
+	_SHAPE_ADD(job_ptr->qos_ptr);
+	_SHAPE_ADD(job_ptr->resv_ptr);
+	_SHAPE_ADD(job_ptr->req_switch);
+	_SHAPE_ADD(job_ptr->wait4switch);
+	shape = _shape_add_str(shape, job_ptr->gres);
+	shape = _shape_add_str(shape, job_ptr->licenses);
+	shape = _shape_add_str(shape, job_ptr->network);
+	if (!detail_ptr)
+		return shape;
+	_SHAPE_ADD(detail_ptr->min_nodes);
+	_SHAPE_ADD(detail_ptr->max_nodes);
+	_SHAPE_ADD(detail_ptr->min_cpus);
+	_SHAPE_ADD(detail_ptr->max_cpus);
+	_SHAPE_ADD(detail_ptr->pn_min_cpus);
+	_SHAPE_ADD(detail_ptr->pn_min_memory);
+	_SHAPE_ADD(detail_ptr->pn_min_tmp_disk);
+	_SHAPE_ADD(detail_ptr->cpus_per_task);
+	_SHAPE_ADD(detail_ptr->ntasks_per_node);
+	_SHAPE_ADD(detail_ptr->num_tasks);
+	_SHAPE_ADD(detail_ptr->contiguous);
+	_SHAPE_ADD(detail_ptr->core_spec);
+	_SHAPE_ADD(detail_ptr->share_res);
+	_SHAPE_ADD(detail_ptr->whole_node);
+	_SHAPE_ADD(detail_ptr->overcommit);
+	_SHAPE_ADD(detail_ptr->task_dist);
+	_SHAPE_ADD(detail_ptr->plane_size);
+	shape = _shape_add_str(shape, detail_ptr->features);
+	shape = _shape_add_str(shape, detail_ptr->req_nodes);
+	shape = _shape_add_str(shape, detail_ptr->exc_nodes);
+	if ((mc_ptr = detail_ptr->mc_ptr)) {
+		_SHAPE_ADD(mc_ptr->boards_per_node);
+		_SHAPE_ADD(mc_ptr->sockets_per_board);
+		_SHAPE_ADD(mc_ptr->sockets_per_node);
+		_SHAPE_ADD(mc_ptr->cores_per_socket);
+		_SHAPE_ADD(mc_ptr->threads_per_core);
+		_SHAPE_ADD(mc_ptr->ntasks_per_board);
+		_SHAPE_ADD(mc_ptr->ntasks_per_socket);
+		_SHAPE_ADD(mc_ptr->ntasks_per_core);
+	}
+#undef _SHAPE_ADD
+
+	return shape;
+}
+
 /*
  * set_job_elig_time - set the eligible time for pending jobs once their
  *      dependencies are lifted (in job->details->begin_time)
@@ -466,6 +556,502 @@ static bool _failed_partition(struct part_record *part_ptr,
 	return false;
 }
 
+/* Result of select_nodes() for a job which could not start, used for later
+ * jobs of the same shape and partition in the same scheduling pass. Without
+ * preemption, jobs started in a pass only consume resources and any freed
+ * by job ends are not seen until the next pass, so the result holds until
+ * the pass ends. With preemption a job's priority also decides whether it
+ * can start, so results are not reused. */
+typedef struct sched_shape {
+	uint64_t shape;
+	struct part_record *part_ptr;
+	int error_code;
+	uint16_t state_reason;
+	struct sched_shape *next;	/* lhash chain */
+} sched_shape_t;
+
+static uint32_t _shape_key(void *x)
+{
+	return (uint32_t) ((sched_shape_t *) x)->shape;
+}
+
+static void _shape_free(void *x)
+{
+	xfree(x);
+}
+
+static sched_shape_t *_shape_find(lhash_t *shape_hash, uint64_t shape,
+				  struct part_record *part_ptr)
+{
+	sched_shape_t *shape_ptr;
+
+	for (shape_ptr = lhash_first(shape_hash, (uint32_t) shape); shape_ptr;
+	     shape_ptr = shape_ptr->next) {
+		if ((shape_ptr->shape == shape) &&
+		    (shape_ptr->part_ptr == part_ptr))
+			return shape_ptr;
+	}
+	return NULL;
+}
+
+/* Save the result of select_nodes() for a job if it depends only upon the
+ * job's shape and the state of its partition's nodes */
+static void _shape_save(lhash_t *shape_hash, List shape_list,
+			uint64_t shape, struct job_record *job_ptr,
+			int error_code)
+{
+	sched_shape_t *shape_ptr;
+
+	if ((error_code != ESLURM_NODES_BUSY) &&
+	    (error_code != ESLURM_NODE_NOT_AVAIL) &&
+	    (error_code != ESLURM_REQUESTED_NODE_CONFIG_UNAVAILABLE) &&
+	    (error_code != ESLURM_REQUESTED_PART_CONFIG_UNAVAILABLE))
+		return;
+	if (job_ptr->preempt_in_progress)
+		return;		/* Other jobs may preempt more */
+
+	shape_ptr = xmalloc(sizeof(sched_shape_t));
+	shape_ptr->shape = shape;
+	shape_ptr->part_ptr = job_ptr->part_ptr;
+	shape_ptr->error_code = error_code;
+	shape_ptr->state_reason = job_ptr->state_reason;
+	list_append(shape_list, shape_ptr);
+	lhash_add(shape_hash, shape_ptr);
+}
+
+/*
+ * The scheduling queue holds a record for each pending job and partition in
+ * which it may run, kept in a binary heap ordered by sort_job_queue2(). It
+ * persists between calls to schedule(), which takes records from the top of
+ * the heap and returns them at the end of the pass, rather than building and
+ * sorting a new queue each time. Records are added or moved as jobs are
+ * submitted, updated, held, released or requeued. A record whose job
+ * priority has changed without notice (e.g. by priority decay) is moved when
+ * it reaches the top of the heap, and the heap is rebuilt when partitions,
+ * reservations or the configuration change, and every
+ * SCHED_QUEUE_REBUILD_TIME seconds. Callers hold the job write lock.
+ */
+typedef struct sched_queue_rec {
+	job_queue_rec_t job_queue_rec;	/* Must be first */
+	uint32_t heap_inx;		/* Position in heap, NO_VAL if taken */
+	int part_inx;			/* Position in job's part_ptr_list */
+	uint32_t pass;			/* Pass in which record was taken */
+	bool blocked;			/* Held, or not runnable when last
+					 * taken, see queue_blocked_cnt */
+	struct sched_queue_rec *next;	/* lhash chain */
+} sched_queue_rec_t;
+
+static sched_queue_rec_t **queue_heap = NULL;
+static uint32_t	queue_cnt = 0, queue_size = 0;
+static sched_queue_rec_t **queue_taken = NULL;
+static uint32_t	taken_cnt = 0, taken_size = 0;
+static uint32_t	queue_blocked_cnt = 0;	/* Records with blocked set */
+static lhash_t *queue_hash = NULL;
+static bool	queue_valid = false;
+static uint32_t	queue_pass = 0;
+static time_t	queue_build_time = 0;
+static time_t	queue_config_update = 0;
+static time_t	queue_part_update = 0;
+static time_t	queue_resv_update = 0;
+
+/* Records are hashed by job record address, since a job array's meta record
+ * changes its job ID when a task is split from it */
+static uint32_t _queue_key_job(struct job_record *job_ptr)
+{
+	return (uint32_t) (((uintptr_t) job_ptr) >> 4);
+}
+
+static uint32_t _queue_key(void *x)
+{
+	return _queue_key_job(((sched_queue_rec_t *) x)->job_queue_rec.job_ptr);
+}
+
+/* Return the job's current priority in the record's partition */
+static uint32_t _queue_prio(sched_queue_rec_t *rec)
+{
+	struct job_record *job_ptr = rec->job_queue_rec.job_ptr;
+
+	if (job_ptr->part_ptr_list && job_ptr->priority_array &&
+	    (rec->part_inx >= 0) &&
+	    (rec->part_inx < list_count(job_ptr->part_ptr_list)))
+		return job_ptr->priority_array[rec->part_inx];
+	return job_ptr->priority;
+}
+
+static bool _queue_before(sched_queue_rec_t *rec1, sched_queue_rec_t *rec2)
+{
+	job_queue_rec_t *job_rec1 = &rec1->job_queue_rec;
+	job_queue_rec_t *job_rec2 = &rec2->job_queue_rec;
+
+	return (sort_job_queue2(&job_rec1, &job_rec2) < 0);
+}
+
+static void _queue_set(uint32_t inx, sched_queue_rec_t *rec)
+{
+	queue_heap[inx] = rec;
+	rec->heap_inx = inx;
+}
+
+static void _queue_sift_up(uint32_t inx)
+{
+	sched_queue_rec_t *rec = queue_heap[inx];
+	uint32_t parent;
+
+	while (inx > 0) {
+		parent = (inx - 1) / 2;
+		if (!_queue_before(rec, queue_heap[parent]))
+			break;
+		_queue_set(inx, queue_heap[parent]);
+		inx = parent;
+	}
+	_queue_set(inx, rec);
+}
+
+static void _queue_sift_down(uint32_t inx)
+{
+	sched_queue_rec_t *rec = queue_heap[inx];
+	uint32_t child;
+
+	while ((child = (inx * 2) + 1) < queue_cnt) {
+		if (((child + 1) < queue_cnt) &&
+		    _queue_before(queue_heap[child + 1], queue_heap[child]))
+			child++;
+		if (!_queue_before(queue_heap[child], rec))
+			break;
+		_queue_set(inx, queue_heap[child]);
+		inx = child;
+	}
+	_queue_set(inx, rec);
+}
+
+static void _queue_push(sched_queue_rec_t *rec, bool sift)
+{
+	if (queue_cnt >= queue_size) {
+		queue_size = MAX(1024, queue_size * 2);
+		xrealloc(queue_heap, sizeof(sched_queue_rec_t *) * queue_size);
+	}
+	_queue_set(queue_cnt++, rec);
+	if (sift)
+		_queue_sift_up(rec->heap_inx);
+}
+
+/* Remove a record from the heap, but not from the hash table */
+static void _queue_delete(sched_queue_rec_t *rec)
+{
+	uint32_t inx = rec->heap_inx;
+	sched_queue_rec_t *last = queue_heap[--queue_cnt];
+
+	rec->heap_inx = NO_VAL;
+	if (last == rec)
+		return;
+	_queue_set(inx, last);
+	_queue_sift_up(inx);
+	_queue_sift_down(last->heap_inx);
+}
+
+/* Set whether a record's job can not run now, as found when it was taken */
+static void _queue_rec_block(sched_queue_rec_t *rec, bool blocked)
+{
+	if (rec->blocked == blocked)
+		return;
+	rec->blocked = blocked;
+	if (blocked)
+		queue_blocked_cnt++;
+	else
+		queue_blocked_cnt--;
+}
+
+static void _queue_rec_free(sched_queue_rec_t *rec)
+{
+	_queue_rec_block(rec, false);
+	xfree(rec);
+}
+
+static void _queue_rec_add(struct job_record *job_ptr,
+			   struct part_record *part_ptr, int part_inx,
+			   uint32_t priority, bool sift)
+{
+	sched_queue_rec_t *rec = xmalloc(sizeof(sched_queue_rec_t));
+
+	rec->job_queue_rec.job_id   = job_ptr->job_id;
+	rec->job_queue_rec.job_ptr  = job_ptr;
+	rec->job_queue_rec.part_ptr = part_ptr;
+	rec->job_queue_rec.priority = priority;
+	rec->part_inx = part_inx;
+	_queue_rec_block(rec, (job_ptr->priority == 0));
+	lhash_add(queue_hash, rec);
+	_queue_push(rec, sift);
+}
+
+/* Add a record for each partition in which a pending job may run */
+static void _queue_job_add(struct job_record *job_ptr, bool sift)
+{
+	ListIterator part_iterator;
+	struct part_record *part_ptr;
+	int inx = 0;
+
+	if (!IS_JOB_PENDING(job_ptr))
+		return;
+
+	if (job_ptr->part_ptr_list) {
+		part_iterator = list_iterator_create(job_ptr->part_ptr_list);
+		while ((part_ptr = (struct part_record *)
+				   list_next(part_iterator))) {
+			_queue_rec_add(job_ptr, part_ptr, inx,
+				       job_ptr->priority_array ?
+				       job_ptr->priority_array[inx] :
+				       job_ptr->priority, sift);
+			inx++;
+		}
+		list_iterator_destroy(part_iterator);
+	} else {
+		part_ptr = job_ptr->part_ptr;
+		if (!part_ptr)
+			part_ptr = find_part_record(job_ptr->partition);
+		if (part_ptr)
+			_queue_rec_add(job_ptr, part_ptr, -1,
+				       job_ptr->priority, sift);
+	}
+}
+
+static sched_queue_rec_t *_queue_job_find(struct job_record *job_ptr)
+{
+	sched_queue_rec_t *rec;
+
+	for (rec = lhash_first(queue_hash, _queue_key_job(job_ptr)); rec;
+	     rec = rec->next) {
+		if (rec->job_queue_rec.job_ptr == job_ptr)
+			return rec;
+	}
+	return NULL;
+}
+
+/* Remove a job's records. Records taken by the current pass are only
+ * marked, they are freed when the pass ends. */
+static void _queue_job_del(struct job_record *job_ptr)
+{
+	sched_queue_rec_t *rec;
+
+	while ((rec = _queue_job_find(job_ptr))) {
+		(void) lhash_remove(queue_hash, rec);
+		if (rec->heap_inx != NO_VAL) {
+			_queue_delete(rec);
+			_queue_rec_free(rec);
+		} else {
+			_queue_rec_block(rec, false);
+			rec->job_queue_rec.job_ptr = NULL;
+		}
+	}
+}
+
+/* Test if some record of a job was taken by the current pass */
+static bool _queue_job_taken(struct job_record *job_ptr)
+{
+	sched_queue_rec_t *rec;
+
+	for (rec = lhash_first(queue_hash, _queue_key_job(job_ptr)); rec;
+	     rec = rec->next) {
+		if ((rec->job_queue_rec.job_ptr == job_ptr) &&
+		    (rec->heap_inx == NO_VAL) && (rec->pass == queue_pass))
+			return true;
+	}
+	return false;
+}
+
+/* Free every record, leaving the queue to be rebuilt by the next pass */
+static void _queue_clear(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < queue_cnt; i++)
+		xfree(queue_heap[i]);
+	queue_cnt = 0;
+	for (i = 0; i < taken_cnt; i++)
+		xfree(queue_taken[i]);
+	taken_cnt = 0;
+	queue_blocked_cnt = 0;
+	if (queue_hash) {
+		lhash_destroy(queue_hash);
+		queue_hash = NULL;
+	}
+	queue_valid = false;
+}
+
+/* Test if the heap order may have changed in ways not reported to it.
+ * Partition records may also have been freed. */
+static bool _queue_stale(void)
+{
+	return ((queue_part_update   != last_part_update) ||
+		(queue_resv_update   != last_resv_update) ||
+		(queue_config_update != slurmctld_conf.last_update));
+}
+
+static void _queue_build(time_t now)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+	uint32_t i;
+
+	_queue_clear();
+	queue_hash = lhash_create(1024, offsetof(sched_queue_rec_t, next),
+				  _queue_key);
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator)))
+		_queue_job_add(job_ptr, false);
+	list_iterator_destroy(job_iterator);
+	for (i = queue_cnt / 2; i > 0; i--)
+		_queue_sift_down(i - 1);
+
+	queue_build_time    = now;
+	queue_config_update = slurmctld_conf.last_update;
+	queue_part_update   = last_part_update;
+	queue_resv_update   = last_resv_update;
+	queue_valid = true;
+}
+
+/* Begin a scheduling pass, building the heap if needed */
+static void _queue_begin(time_t now)
+{
+	static time_t config_update = 0;
+	static bool rebuild_each_pass = false;
+
+	/* Job priority based preemption compares live job state, so the
+	 * order can not be kept between passes */
+	if (config_update != slurmctld_conf.last_update) {
+		rebuild_each_pass = !xstrcmp(slurmctld_conf.preempt_type,
+					     "preempt/job_prio");
+		config_update = slurmctld_conf.last_update;
+	}
+	if (!queue_valid || rebuild_each_pass || _queue_stale() ||
+	    (now >= (queue_build_time + SCHED_QUEUE_REBUILD_TIME)))
+		_queue_build(now);
+	queue_pass++;
+}
+
+/* Take the next record of a pending job from the top of the heap */
+static job_queue_rec_t *_queue_next(void)
+{
+	sched_queue_rec_t *rec;
+	struct job_record *job_ptr;
+	uint32_t priority;
+
+	if (!queue_valid)
+		return NULL;
+	while (queue_cnt) {
+		rec = queue_heap[0];
+		job_ptr = rec->job_queue_rec.job_ptr;
+		_queue_delete(rec);
+		if (!IS_JOB_PENDING(job_ptr)) {
+			(void) lhash_remove(queue_hash, rec);
+			_queue_rec_free(rec);
+			continue;
+		}
+		priority = _queue_prio(rec);
+		if (priority != rec->job_queue_rec.priority) {
+			rec->job_queue_rec.priority = priority;
+			_queue_push(rec, true);
+			continue;
+		}
+		/* Initialize on the job's first record in this pass */
+		if (!_queue_job_taken(job_ptr))
+			job_ptr->preempt_in_progress = false;
+		rec->pass = queue_pass;
+		if (taken_cnt >= taken_size) {
+			taken_size = MAX(128, taken_size * 2);
+			xrealloc(queue_taken,
+				 sizeof(sched_queue_rec_t *) * taken_size);
+		}
+		queue_taken[taken_cnt++] = rec;
+		return &rec->job_queue_rec;
+	}
+	return NULL;
+}
+
+/* Record whether the job of a record taken by this pass passed the tests of
+ * its ability to run now */
+static void _queue_runnable(job_queue_rec_t *job_queue_rec, bool runnable)
+{
+	_queue_rec_block((sched_queue_rec_t *) job_queue_rec, !runnable);
+}
+
+/* Return the number of records in the queue, less those of held jobs and of
+ * jobs which were not runnable when last taken (e.g. waiting on a dependency
+ * or partition limit). Jobs are only tested when taken, so this can include
+ * jobs below the depth reached by recent passes which can not run. */
+static uint32_t _queue_runnable_cnt(void)
+{
+	if (!queue_valid)
+		return 0;
+	return queue_cnt + taken_cnt - queue_blocked_cnt;
+}
+
+/* End a scheduling pass, returning the records of jobs still pending */
+static void _queue_end(void)
+{
+	sched_queue_rec_t *rec;
+	struct job_record *job_ptr;
+	uint32_t i;
+
+	if (!queue_valid || _queue_stale()) {
+		_queue_clear();
+		return;
+	}
+	for (i = 0; i < taken_cnt; i++) {
+		rec = queue_taken[i];
+		job_ptr = rec->job_queue_rec.job_ptr;
+		if (!job_ptr) {
+			_queue_rec_free(rec);
+		} else if (!IS_JOB_PENDING(job_ptr)) {
+			(void) lhash_remove(queue_hash, rec);
+			_queue_rec_free(rec);
+		} else {
+			rec->job_queue_rec.job_id   = job_ptr->job_id;
+			rec->job_queue_rec.priority = _queue_prio(rec);
+			_queue_push(rec, true);
+		}
+	}
+	taken_cnt = 0;
+}
+
+/*
+ * sched_queue_job_update - add, move or remove a job's records in the
+ *	scheduling queue after a change in its state, priority, partitions,
+ *	QOS or reservation
+ */
+extern void sched_queue_job_update(struct job_record *job_ptr)
+{
+	if (!queue_valid)
+		return;
+	if (_queue_stale()) {
+		_queue_clear();
+		return;
+	}
+	_queue_job_del(job_ptr);
+	_queue_job_add(job_ptr, true);
+}
+
+/* sched_queue_job_remove - remove a job's records before it is purged */
+extern void sched_queue_job_remove(struct job_record *job_ptr)
+{
+	if (!queue_valid)
+		return;
+	if (_queue_stale()) {
+		_queue_clear();
+		return;
+	}
+	_queue_job_del(job_ptr);
+}
+
+/* sched_queue_fini - free the scheduling queue */
+extern void sched_queue_fini(void)
+{
+	_queue_clear();
+	xfree(queue_heap);
+	queue_size = 0;
+	xfree(queue_taken);
+	taken_size = 0;
+}
+
 static void _do_diag_stats(long delta_t)
 {
 	if (delta_t > slurmctld_diag_stats.schedule_cycle_max)
@@ -591,7 +1177,7 @@ next_part:		part_ptr = (struct part_record *)
 				job_ptr->state_reason = WAIT_NO_REASON;
 				xfree(job_ptr->state_desc);
 				job_ptr->assoc_id = assoc_rec.id;
-				last_job_update = now;
+				job_changed(job_ptr, now);
 			} else {
 				continue;
 			}
@@ -607,12 +1193,12 @@ next_part:		part_ptr = (struct part_record *)
 					job_ptr->job_id);
 				xfree(job_ptr->state_desc);
 				job_ptr->state_reason = FAIL_QOS;
-				last_job_update = now;
+				job_changed(job_ptr, now);
 				continue;
 			} else if (job_ptr->state_reason == FAIL_QOS) {
 				xfree(job_ptr->state_desc);
 				job_ptr->state_reason = WAIT_NO_REASON;
-				last_job_update = now;
+				job_changed(job_ptr, now);
 			}
 		}
 
@@ -622,7 +1208,7 @@ next_part:		part_ptr = (struct part_record *)
 		    || (job_ptr->state_reason == WAIT_QOS_TIME_LIMIT)) {
 			job_ptr->state_reason = WAIT_NO_REASON;
 			xfree(job_ptr->state_desc);
-			last_job_update = now;
+			job_changed(job_ptr, now);
 		}
 
 		if ((job_ptr->state_reason == WAIT_NODE_NOT_AVAIL) &&
@@ -641,7 +1227,7 @@ next_part:		part_ptr = (struct part_record *)
 		if (license_job_test(job_ptr, now) != SLURM_SUCCESS) {
 			job_ptr->state_reason = WAIT_LICENSES;
 			xfree(job_ptr->state_desc);
-			last_job_update = now;
+			job_changed(job_ptr, now);
 			continue;
 		}
 
@@ -654,7 +1240,7 @@ next_part:		part_ptr = (struct part_record *)
 			 * very rare. */
 			info("sched: JobId=%u has invalid account",
 			     job_ptr->job_id);
-			last_job_update = now;
+			job_changed(job_ptr, now);
 			job_ptr->state_reason = FAIL_ACCOUNT;
 			xfree(job_ptr->state_desc);
 			continue;
@@ -685,7 +1271,7 @@ next_part:		part_ptr = (struct part_record *)
 		bit_free(job_ptr->details->exc_node_bitmap);
 		job_ptr->details->exc_node_bitmap = orig_exc_bitmap;
 		if (error_code == SLURM_SUCCESS) {
-			last_job_update = now;
+			job_changed(job_ptr, now);
 			info("sched: Allocate JobId=%u NodeList=%s #CPUs=%u",
 			     job_ptr->job_id, job_ptr->nodes,
 			     job_ptr->total_cpus);
@@ -759,7 +1345,6 @@ static bool _all_partition_priorities_same(void)
 extern int schedule(uint32_t job_limit)
 {
 	ListIterator job_iterator = NULL, part_iterator = NULL;
-	List job_queue = NULL;
 	int failed_part_cnt = 0, failed_resv_cnt = 0, job_cnt = 0;
 	int error_code, i, j, part_cnt, time_limit;
 	uint32_t job_depth = 0;
@@ -771,6 +1356,12 @@ extern int schedule(uint32_t job_limit)
 	bitstr_t *save_avail_node_bitmap;
 	struct part_record **sched_part_ptr = NULL;
 	int *sched_part_jobs = NULL;
+	lhash_t *shape_hash = NULL;
+	List shape_list = NULL;
+	sched_shape_t *shape_ptr;
+	uint64_t shape;
+	uint32_t shape_hits = 0;
+	bool shape_reuse;
 	/* Locks: Read config, write job, write node, read partition */
 	slurmctld_lock_t job_write_lock =
 	    { READ_LOCK, WRITE_LOCK, WRITE_LOCK, READ_LOCK };
@@ -946,6 +1537,7 @@ extern int schedule(uint32_t job_limit)
 			    (job_ptr->state_reason != WAIT_NODE_NOT_AVAIL))
 				continue;
 			job_ptr->state_reason = WAIT_FRONT_END;
+			job_changed(job_ptr, now);
 		}
 		list_iterator_destroy(job_iterator);
 
@@ -980,6 +1572,10 @@ extern int schedule(uint32_t job_limit)
 	failed_parts = xmalloc(sizeof(struct part_record *) * part_cnt);
 	failed_resv = xmalloc(sizeof(struct slurmctld_resv*) * MAX_FAILED_RESV);
 	save_avail_node_bitmap = bit_copy(avail_node_bitmap);
+	shape_hash = lhash_create(64, offsetof(sched_shape_t, next),
+				  _shape_key);
+	shape_list = list_create(_shape_free);
+	shape_reuse = !slurm_preemption_enabled();
 
 	if (max_jobs_per_part) {
 		ListIterator part_iterator;
@@ -1009,9 +1605,8 @@ extern int schedule(uint32_t job_limit)
 		slurmctld_diag_stats.schedule_queue_len = list_count(job_list);
 		job_iterator = list_iterator_create(job_list);
 	} else {
-		job_queue = build_job_queue(false, false);
-		slurmctld_diag_stats.schedule_queue_len = list_count(job_queue);
-		sort_job_queue(job_queue);
+		_queue_begin(now);
+		slurmctld_diag_stats.schedule_queue_len = _queue_runnable_cnt();
 	}
 	while (1) {
 		if (fifo_sched) {
@@ -1024,7 +1619,7 @@ extern int schedule(uint32_t job_limit)
 			if (!avail_front_end(job_ptr)) {
 				job_ptr->state_reason = WAIT_FRONT_END;
 				xfree(job_ptr->state_desc);
-				last_job_update = now;
+				job_changed(job_ptr, now);
 				continue;
 			}
 			if (!_job_runnable_test1(job_ptr, false))
@@ -1049,21 +1644,40 @@ next_part:			part_ptr = (struct part_record *)
 					continue;
 			}
 		} else {
-			job_queue_rec = list_pop(job_queue);
+			job_queue_rec = _queue_next();
 			if (!job_queue_rec)
 				break;
 			job_ptr  = job_queue_rec->job_ptr;
 			part_ptr = job_queue_rec->part_ptr;
-			xfree(job_queue_rec);
 			if (!avail_front_end(job_ptr)) {
 				job_ptr->state_reason = WAIT_FRONT_END;
 				xfree(job_ptr->state_desc);
-				last_job_update = now;
+				job_changed(job_ptr, now);
+				continue;
+			}
+			if (!_job_runnable_test1(job_ptr, false)) {
+				_queue_runnable(job_queue_rec, false);
 				continue;
 			}
-			if (!IS_JOB_PENDING(job_ptr))
-				continue;  /* started in another partition */
 			job_ptr->part_ptr = part_ptr;
+			if (job_ptr->part_ptr_list) {
+				i = job_limits_check(&job_ptr, false);
+				if ((i != WAIT_NO_REASON) &&
+				    (i != job_ptr->state_reason) &&
+				    (!part_policy_job_runnable_state(job_ptr))){
+					job_ptr->state_reason = i;
+					xfree(job_ptr->state_desc);
+					job_changed(job_ptr, now);
+				}
+				if (i != WAIT_NO_REASON) {
+					_queue_runnable(job_queue_rec, false);
+					continue;
+				}
+			} else if (!_job_runnable_test2(job_ptr, false)) {
+				_queue_runnable(job_queue_rec, false);
+				continue;
+			}
+			_queue_runnable(job_queue_rec, true);
 		}
 		if (job_ptr->preempt_in_progress)
 			continue;	/* scheduled in another partition */
@@ -1077,8 +1691,14 @@ next_task:
 		if ((job_ptr->array_task_id != NO_VAL) || job_ptr->array_recs) {
 			if ((reject_array_job_id == job_ptr->array_job_id) &&
 			    (reject_array_part   == job_ptr->part_ptr)) {
-				xfree(job_ptr->state_desc);
-				job_ptr->state_reason = reject_state_reason;
+				if ((job_ptr->state_reason !=
+				     reject_state_reason) ||
+				    job_ptr->state_desc) {
+					xfree(job_ptr->state_desc);
+					job_ptr->state_reason =
+						reject_state_reason;
+					job_changed(job_ptr, now);
+				}
 				continue;  /* already rejected array element */
 			}
 
@@ -1109,6 +1729,7 @@ next_task:
 				if (job_ptr->state_reason == WAIT_NO_REASON) {
 					xfree(job_ptr->state_desc);
 					job_ptr->state_reason = WAIT_PRIORITY;
+					job_changed(job_ptr, now);
 				}
 				skip_part_ptr = job_ptr->part_ptr;
 				continue;
@@ -1139,6 +1760,7 @@ next_task:
 				if (job_ptr->state_reason == WAIT_NO_REASON) {
 					job_ptr->state_reason = WAIT_PRIORITY;
 					xfree(job_ptr->state_desc);
+					job_changed(job_ptr, now);
 				}
 				debug3("sched: JobId=%u. State=PENDING. "
 				       "Reason=%s(Priority). Priority=%u, "
@@ -1154,7 +1776,7 @@ next_task:
 			    (job_ptr->state_reason == WAIT_NO_REASON)) {
 				job_ptr->state_reason = WAIT_PRIORITY;
 				xfree(job_ptr->state_desc);
-				last_job_update = now;
+				job_changed(job_ptr, now);
 			}
 			debug("sched: JobId=%u. State=PENDING. "
 			       "Reason=%s(Priority), Priority=%u, "
@@ -1182,7 +1804,7 @@ next_task:
 				job_ptr->state_reason = WAIT_NO_REASON;
 				xfree(job_ptr->state_desc);
 				job_ptr->assoc_id = assoc_rec.id;
-				last_job_update = now;
+				job_changed(job_ptr, now);
 			} else {
 				debug("sched: JobId=%u has invalid association",
 				      job_ptr->job_id);
@@ -1203,12 +1825,12 @@ next_task:
 				      job_ptr->job_id);
 				xfree(job_ptr->state_desc);
 				job_ptr->state_reason = FAIL_QOS;
-				last_job_update = now;
+				job_changed(job_ptr, now);
 				continue;
 			} else if (job_ptr->state_reason == FAIL_QOS) {
 				xfree(job_ptr->state_desc);
 				job_ptr->state_reason = WAIT_NO_REASON;
-				last_job_update = now;
+				job_changed(job_ptr, now);
 			}
 		}
 
@@ -1233,7 +1855,7 @@ next_task:
 			 * reserved for jobs in higher priority partition */
 			job_ptr->state_reason = WAIT_RESOURCES;
 			xfree(job_ptr->state_desc);
-			last_job_update = now;
+			job_changed(job_ptr, now);
 			debug3("sched: JobId=%u. State=%s. Reason=%s. "
 			       "Priority=%u. Partition=%s.",
 			       job_ptr->job_id,
@@ -1246,7 +1868,7 @@ next_task:
 		if (license_job_test(job_ptr, time(NULL)) != SLURM_SUCCESS) {
 			job_ptr->state_reason = WAIT_LICENSES;
 			xfree(job_ptr->state_desc);
-			last_job_update = now;
+			job_changed(job_ptr, now);
 			debug3("sched: JobId=%u. State=%s. Reason=%s. "
 			       "Priority=%u.",
 			       job_ptr->job_id,
@@ -1265,13 +1887,35 @@ next_task:
 			 * very rare. */
 			info("sched: JobId=%u has invalid account",
 			     job_ptr->job_id);
-			last_job_update = now;
+			job_changed(job_ptr, now);
 			job_ptr->state_reason = FAIL_ACCOUNT;
 			xfree(job_ptr->state_desc);
 			continue;
 		}
 
-		error_code = select_nodes(job_ptr, false, NULL, NULL);
+		if (shape_reuse) {
+			shape = job_shape(job_ptr);
+			shape_ptr = _shape_find(shape_hash, shape,
+						job_ptr->part_ptr);
+		} else
+			shape_ptr = NULL;
+		if (shape_ptr) {
+			/* Same request as a job which could not start */
+			error_code = shape_ptr->error_code;
+			if (job_ptr->state_reason != shape_ptr->state_reason) {
+				job_ptr->state_reason =
+					shape_ptr->state_reason;
+				xfree(job_ptr->state_desc);
+				job_changed(job_ptr, now);
+			}
+			shape_hits++;
+		} else {
+			error_code = select_nodes(job_ptr, false, NULL, NULL);
+			if (shape_reuse) {
+				_shape_save(shape_hash, shape_list, shape,
+					    job_ptr, error_code);
+			}
+		}
 		if (error_code == ESLURM_NODES_BUSY) {
 			debug3("sched: JobId=%u. State=%s. Reason=%s. "
 			       "Priority=%u. Partition=%s.",
@@ -1356,7 +2000,7 @@ next_task:
 		} else if (error_code == SLURM_SUCCESS) {
 			/* job initiated */
 			debug3("sched: JobId=%u initiated", job_ptr->job_id);
-			last_job_update = now;
+			job_changed(job_ptr, now);
 			reject_array_job_id = 0;
 			reject_array_part   = NULL;
 #ifdef HAVE_BG
@@ -1421,7 +2065,7 @@ next_task:
 			info("sched: schedule: JobId=%u non-runnable: %s",
 			     job_ptr->job_id, slurm_strerror(error_code));
 			if (!wiki_sched) {
-				last_job_update = now;
+				job_changed(job_ptr, now);
 				job_ptr->job_state = JOB_PENDING;
 				job_ptr->state_reason = FAIL_BAD_CONSTRAINTS;
 				xfree(job_ptr->state_desc);
@@ -1443,13 +2087,19 @@ next_task:
 	avail_node_bitmap = save_avail_node_bitmap;
 	xfree(failed_parts);
 	xfree(failed_resv);
+	lhash_destroy(shape_hash);
+	FREE_NULL_LIST(shape_list);
+	if (shape_hits) {
+		debug2("sched: skipped testing %u jobs with the same request "
+		       "as a job which could not start", shape_hits);
+	}
 	if (fifo_sched) {
 		if (job_iterator)
 			list_iterator_destroy(job_iterator);
 		if (part_iterator)
 			list_iterator_destroy(part_iterator);
-	} else if (job_queue) {
-		FREE_NULL_LIST(job_queue);
+	} else {
+		_queue_end();
 	}
 	xfree(sched_part_ptr);
 	xfree(sched_part_jobs);
@@ -1517,20 +2167,10 @@ extern int sort_job_queue2(void *x, void *y)
 			return -1;
 	}
 
-	if (job_rec1->job_ptr->part_ptr_list &&
-	    job_rec1->job_ptr->priority_array)
-		p1 = job_rec1->priority;
-	else
-		p1 = job_rec1->job_ptr->priority;
-
-
-	if (job_rec2->job_ptr->part_ptr_list &&
-	    job_rec2->job_ptr->priority_array)
-		p2 = job_rec2->priority;
-	else
-		p2 = job_rec2->job_ptr->priority;
-
-
+	/* Use the priority saved in the record, which keeps the order
+	 * stable while records are held in the scheduling queue */
+	p1 = job_rec1->priority;
+	p2 = job_rec2->priority;
 	if (p1 < p2)
 		return 1;
 	if (p1 > p2)
@@ -1745,8 +2385,67 @@ extern int make_batch_job_cred(batch_job_launch_msg_t *launch_msg_ptr,
 	return SLURM_ERROR;
 }
 
+/*
+ * Reverse dependency index: the depend_spec records of all jobs, hashed by
+ * the job ID they name. When a job starts, ends, finishes completing or is
+ * purged, the jobs depending upon it are found here and their saved
+ * test_job_dependency() result is discarded, so other jobs' dependencies
+ * need not be tested again on every scheduling pass. Records are added when
+ * a job's dependencies are first tested and removed when freed.
+ */
+static lhash_t *depend_hash = NULL;
+
+static uint32_t _depend_key(void *x)
+{
+	return ((struct depend_spec *) x)->job_id;
+}
+
+static void _depend_index_add(struct job_record *job_ptr,
+			      struct depend_spec *dep_ptr)
+{
+	if (dep_ptr->depend_job_ptr == job_ptr)
+		return;
+	if (!depend_hash) {
+		depend_hash = lhash_create(1024,
+					   offsetof(struct depend_spec,
+						    depend_next),
+					   _depend_key);
+	}
+	dep_ptr->depend_job_ptr = job_ptr;
+	lhash_add(depend_hash, dep_ptr);
+}
+
+static void _depend_notify(uint32_t job_id)
+{
+	struct depend_spec *dep_ptr;
+
+	for (dep_ptr = lhash_first(depend_hash, job_id); dep_ptr;
+	     dep_ptr = dep_ptr->depend_next) {
+		if ((dep_ptr->job_id == job_id) &&
+		    dep_ptr->depend_job_ptr->details)
+			dep_ptr->depend_job_ptr->details->depend_time = 0;
+	}
+}
+
+/*
+ * notify_job_dependents - a job has started, ended, finished completing
+ *	or is being purged, so test the dependencies of jobs naming it (or
+ *	its job array) again
+ */
+extern void notify_job_dependents(struct job_record *job_ptr)
+{
+	if (!depend_hash)
+		return;
+	_depend_notify(job_ptr->job_id);
+	if ((job_ptr->array_task_id != NO_VAL) &&
+	    (job_ptr->array_job_id != job_ptr->job_id))
+		_depend_notify(job_ptr->array_job_id);
+}
+
 static void _depend_list_del(void *dep_ptr)
 {
+	if (((struct depend_spec *) dep_ptr)->depend_job_ptr)
+		(void) lhash_remove(depend_hash, dep_ptr);
 	xfree(dep_ptr);
 }
 
@@ -1769,6 +2468,8 @@ extern List depended_list_copy(List depend_list_src)
 	while ((dep_src = (struct depend_spec *) list_next(iter))) {
 		dep_dest = xmalloc(sizeof(struct depend_spec));
 		memcpy(dep_dest, dep_src, sizeof(struct depend_spec));
+		dep_dest->depend_job_ptr = NULL;	/* not indexed */
+		dep_dest->depend_next = NULL;
 		list_append(depend_list_dest, dep_dest);
 	}
 	list_iterator_destroy(iter);
@@ -1882,7 +2583,7 @@ extern int test_job_dependency(struct job_record *job_ptr)
 	ListIterator depend_iter, job_iterator;
 	struct depend_spec *dep_ptr;
 	bool failure = false, depends = false, rebuild_str = false;
-	bool or_satisfied = false;
+	bool or_satisfied = false, save_rc = true;
  	List job_queue = NULL;
  	bool run_now;
 	int results = 0;
@@ -1900,6 +2601,12 @@ extern int test_job_dependency(struct job_record *job_ptr)
 	    (list_count(job_ptr->details->depend_list) == 0))
 		return 0;
 
+	/* The result holds until a job named by the dependencies changes,
+	 * see notify_job_dependents() */
+	if (job_ptr->details->depend_time &&
+	    ((now - job_ptr->details->depend_time) < DEPEND_RETEST_TIME))
+		return job_ptr->details->depend_rc;
+
 	if ((job_ptr->array_task_id != NO_VAL) &&
 	    (cache_time == now) &&
 	    (cache_job_ptr->magic == JOB_MAGIC) &&
@@ -1916,6 +2623,10 @@ extern int test_job_dependency(struct job_record *job_ptr)
 	depend_iter = list_iterator_create(job_ptr->details->depend_list);
 	while ((dep_ptr = list_next(depend_iter))) {
 		bool clear_dep = false;
+		_depend_index_add(job_ptr, dep_ptr);
+		if ((dep_ptr->depend_type == SLURM_DEPEND_SINGLETON) ||
+		    (dep_ptr->depend_type == SLURM_DEPEND_EXPAND))
+			save_rc = false;  /* depends upon other job state */
 		if (dep_ptr->array_task_id == INFINITE) {
 			dep_ptr->job_ptr = find_job_record(dep_ptr->job_id);
 		} else if (dep_ptr->array_task_id != NO_VAL) {
@@ -2068,6 +2779,11 @@ extern int test_job_dependency(struct job_record *job_ptr)
 		results = 2;
 	else if (depends)
 		results = 1;
+	if (save_rc) {
+		job_ptr->details->depend_time = now;
+		job_ptr->details->depend_rc = results;
+	} else
+		job_ptr->details->depend_time = 0;
 
 	if ((job_ptr->array_task_id != NO_VAL) &&
 	    (job_ptr->array_recs == NULL)) {
@@ -2316,6 +3032,7 @@ extern int update_job_dependency(struct job_record *job_ptr, char *new_depend)
 		if (job_ptr->details->depend_list)
 			list_destroy(job_ptr->details->depend_list);
 		job_ptr->details->depend_list = new_depend_list;
+		job_ptr->details->depend_time = 0;
 		_depend_list2str(job_ptr, or_flag);
 #if _DEBUG
 		print_job_dependency(job_ptr);
@@ -3368,6 +4085,7 @@ cleanup_completing(struct job_record *job_ptr)
 
 	delete_step_records(job_ptr);
 	job_ptr->job_state &= (~JOB_COMPLETING);
+	notify_job_dependents(job_ptr);
 	job_hold_requeue(job_ptr);
 
 	slurm_sched_g_schedule();
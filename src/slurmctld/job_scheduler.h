@@ -90,6 +90,15 @@ extern int epilog_slurmctld(struct job_record *job_ptr);
  */
 extern bool job_is_completing(void);
 
+/*
+ * job_shape - return a hash of the parts of a pending job's request which
+ *	determine where and when it can start: its node, CPU, memory and
+ *	GRES counts, features, required and excluded nodes, licenses, QOS,
+ *	reservation and time limit. Jobs with the same shape in the same
+ *	partition get the same answer from select_g_job_test().
+ */
+extern uint64_t job_shape(struct job_record *job_ptr);
+
 /* Determine if a pending job will run using only the specified nodes
  * (in job_desc_msg->req_nodes), build response message and return
  * SLURM_SUCCESS on success. Otherwise return an error code. Caller
@@ -114,6 +123,13 @@ extern int make_batch_job_cred(batch_job_launch_msg_t *launch_msg_ptr,
 			       struct job_record *job_ptr,
 			       uint16_t protocol_version);
 
+/*
+ * notify_job_dependents - a job has started, ended, finished completing
+ *	or is being purged, so test the dependencies of jobs naming it (or
+ *	its job array) again
+ */
+extern void notify_job_dependents(struct job_record *job_ptr);
+
 /* Print a job's dependency information based upon job_ptr->depend_list */
 extern void print_job_dependency(struct job_record *job_ptr);
 
@@ -146,6 +162,21 @@ extern void rebuild_job_part_list(struct job_record *job_ptr);
  */
 extern bool replace_batch_job(slurm_msg_t * msg, void *fini_job);
 
+/* sched_queue_fini - free the scheduling queue used by schedule() */
+extern void sched_queue_fini(void);
+
+/* sched_queue_job_remove - remove a job from the scheduling queue before its
+ *	record is purged */
+extern void sched_queue_job_remove(struct job_record *job_ptr);
+
+/*
+ * sched_queue_job_update - add, move or remove a job's records in the
+ *	scheduling queue used by schedule(). Call after a job is submitted or
+ *	requeued, or after a change in its state, priority, partitions, QOS
+ *	or reservation.
+ */
+extern void sched_queue_job_update(struct job_record *job_ptr);
+
 /*
  * schedule - attempt to schedule all pending jobs
  *	pending jobs for each partition will be scheduled in priority
@@ -154,10 +185,9 @@ extern bool replace_batch_job(slurm_msg_t * msg, void *fini_job);
  *		  queue on every job submit (0 means to use the system default,
  *		  SchedulerParameters for default_queue_depth)
  * RET count of jobs scheduled
- * Note: We re-build the queue every time. Jobs can not only be added
- *	or removed from the queue, but have their priority or partition
- *	changed with the update_job RPC. In general nodes will be in priority
- *	order (by submit time), so the sorting should be pretty fast.
+ * Note: Unless jobs are scheduled in FIFO order, pending jobs are kept in a
+ *	priority ordered queue between calls, see sched_queue_job_update().
+ *	Jobs are tested in order from the top of the queue.
  */
 extern int schedule(uint32_t job_limit);
 
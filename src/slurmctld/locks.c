@@ -46,22 +46,117 @@
 #endif
 
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 #include <sys/types.h>
 
+#include "src/common/pack.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
 #include "src/slurmctld/locks.h"
 #include "src/slurmctld/slurmctld.h"
 
+/* The functions are defined here for callers built without the macros */
+#undef lock_slurmctld
+#undef try_lock_slurmctld
+
 static pthread_mutex_t locks_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t locks_cond = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t state_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static slurmctld_lock_flags_t slurmctld_locks;
 static int kill_thread = 0;
+static uint32_t write_unlock_cnt[ENTITY_COUNT];
+
+/*
+ * Lock wait and hold time statistics. These are kept for each lock type
+ * and mode (read or write) and, with less detail, for each call site. A call
+ * site is identified by the tag passed to lock_slurmctld_tag(), normally the
+ * calling function's name. All statistics are protected by locks_mutex.
+ */
+#define LOCK_MODE_CNT	2		/* read and write */
+#define LOCK_STAT_CNT	(ENTITY_COUNT * LOCK_MODE_CNT)
+#define LOCK_SITE_CNT	512		/* must be a power of two */
+
+#define lock_stat_inx(datatype, mode) ((datatype) * LOCK_MODE_CNT + (mode))
+
+typedef struct lock_stat {
+	uint32_t cnt;			/* locks issued */
+	uint64_t wait_sum;		/* total wait time, usec */
+	uint32_t wait_max;		/* maximum wait time, usec */
+	uint64_t hold_sum;		/* total hold time, usec */
+	uint32_t hold_max;		/* maximum hold time, usec */
+	uint32_t wait_hist[STAT_HIST_BUCKETS];
+	uint32_t hold_hist[STAT_HIST_BUCKETS];
+} lock_stat_t;
+
+typedef struct lock_site {
+	char *tag;			/* call site name, NULL if unused */
+	uint32_t cnt[LOCK_STAT_CNT];
+	uint64_t wait_sum[LOCK_STAT_CNT];
+	uint32_t wait_max[LOCK_STAT_CNT];
+	uint64_t hold_sum[LOCK_STAT_CNT];
+	uint32_t hold_max[LOCK_STAT_CNT];
+} lock_site_t;
+
+/* Statistics of one call site for one lock type and mode, as reported */
+typedef struct lock_site_rec {
+	const char *tag;
+	int inx;			/* lock_stats index */
+	uint32_t cnt;
+	uint64_t wait_sum;
+	uint32_t wait_max;
+	uint64_t hold_sum;
+	uint32_t hold_max;
+} lock_site_rec_t;
+
+/* A thread's current lock request */
+typedef struct lock_thread {
+	const char *tag;		/* call site of current lock request */
+	int site;			/* lock_sites index of tag, -1 if not
+					 * yet found */
+	uint64_t wait_usec;		/* total lock wait time */
+} lock_thread_t;
 
-static bool _wr_rdlock(lock_datatype_t datatype, bool wait_lock);
+/* Current hold of a lock, used to compute hold times. A lock is held from
+ * when it is granted while free until it is free again, whichever thread
+ * releases it. Read locks held at the same time count as one hold, by the
+ * call site which locked first. */
+typedef struct lock_hold {
+	int site;			/* lock_sites index of first lock */
+	int mode;			/* 0=read, 1=write */
+	struct timeval start;
+} lock_hold_t;
+
+static lock_stat_t lock_stats[LOCK_STAT_CNT];
+static lock_site_t lock_sites[LOCK_SITE_CNT];
+static int lock_site_used = 0;
+static lock_hold_t lock_holds[ENTITY_COUNT];
+
+static pthread_key_t lock_thread_key;
+static pthread_once_t lock_thread_once = PTHREAD_ONCE_INIT;
+
+static char *lock_type_names[ENTITY_COUNT] = {
+	"config", "job", "node", "partition" };
+static char *lock_mode_names[LOCK_MODE_CNT] = { "read", "write" };
+
+static uint32_t _delta_usec(struct timeval *start, struct timeval *end);
+static lock_site_rec_t *_copy_lock_stats(lock_stat_t **stats,
+					 uint32_t *rec_cnt);
+static int  _find_lock_site(const char *tag);
+static lock_thread_t *_get_lock_thread(const char *tag);
+static void _lock_thread_free(void *arg);
+static void _lock_thread_init(void);
+static void _record_lock_hold(lock_datatype_t datatype, struct timeval *now);
+static void _record_lock_wait(lock_datatype_t datatype, int mode,
+			      lock_thread_t *thr, struct timeval *start);
+static int  _sort_site_by_wait(const void *x, const void *y);
+static bool _wr_rdlock(lock_datatype_t datatype, bool wait_lock,
+		       lock_thread_t *thr);
 static void _wr_rdunlock(lock_datatype_t datatype);
-static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock);
+static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock,
+		       lock_thread_t *thr);
 static void _wr_wrunlock(lock_datatype_t datatype);
 
 /* init_locks - create locks used for slurmctld data structure access
@@ -72,47 +167,224 @@ void init_locks(void)
 	memset((void *) &slurmctld_locks, 0, sizeof(slurmctld_locks));
 }
 
-/* lock_slurmctld - Issue the required lock requests in a well defined order */
+static void _lock_thread_free(void *arg)
+{
+	xfree(arg);
+}
+
+static void _lock_thread_init(void)
+{
+	if (pthread_key_create(&lock_thread_key, _lock_thread_free))
+		error("%s: pthread_key_create: %m", __func__);
+}
+
+/* Return the calling thread's lock record, creating it if needed, and note
+ * the call site of its new lock request (tag) */
+static lock_thread_t *_get_lock_thread(const char *tag)
+{
+	lock_thread_t *thr;
+
+	pthread_once(&lock_thread_once, _lock_thread_init);
+	thr = pthread_getspecific(lock_thread_key);
+	if (!thr) {
+		thr = xmalloc(sizeof(lock_thread_t));
+		pthread_setspecific(lock_thread_key, thr);
+	}
+	thr->tag = tag;
+	thr->site = -1;
+	return thr;
+}
+
+static uint32_t _delta_usec(struct timeval *start, struct timeval *end)
+{
+	int64_t delta;
+
+	delta = (end->tv_sec - start->tv_sec) * 1000000;
+	delta += end->tv_usec - start->tv_usec;
+	if (delta <= 0)
+		return 0;
+	if (delta > NO_VAL)
+		return NO_VAL;
+	return (uint32_t) delta;
+}
+
+/* Return the lock_sites index for a call site, adding it if needed.
+ * Sites beyond the table's capacity are combined in a single entry.
+ * locks_mutex must be locked by the caller. */
+static int _find_lock_site(const char *tag)
+{
+	static const char *other_tag = "other";
+	const unsigned char *c;
+	uint32_t hash = 5381;
+	int i, inx;
+
+	if (!tag)
+		tag = other_tag;
+	for (c = (const unsigned char *) tag; *c; c++)
+		hash = (hash * 33) + *c;
+
+	for (i = 0; i < LOCK_SITE_CNT; i++) {
+		inx = (hash + i) & (LOCK_SITE_CNT - 1);
+		if (lock_sites[inx].tag == NULL) {
+			if ((lock_site_used >= (LOCK_SITE_CNT - 1)) &&
+			    (tag != other_tag))
+				break;	/* keep a slot for other_tag */
+			/* Copy, the tag may belong to an unloaded plugin */
+			lock_sites[inx].tag = xstrdup(tag);
+			lock_site_used++;
+			return inx;
+		}
+		if (!strcmp(lock_sites[inx].tag, tag))
+			return inx;
+	}
+
+	/* Table full, use the overflow entry */
+	if (tag != other_tag)
+		return _find_lock_site(other_tag);
+	return 0;
+}
+
+/* Record the time spent waiting for a lock which was just granted and note
+ * the start of its hold time if the lock was free. locks_mutex must be
+ * locked by the caller. */
+static void _record_lock_wait(lock_datatype_t datatype, int mode,
+			      lock_thread_t *thr, struct timeval *start)
+{
+	struct timeval now;
+	lock_stat_t *stat;
+	lock_site_t *site_ptr;
+	uint32_t wait_usec;
+	int inx = lock_stat_inx(datatype, mode);
+
+	gettimeofday(&now, NULL);
+	wait_usec = _delta_usec(start, &now);
+	thr->wait_usec += wait_usec;
+	if (thr->site < 0)
+		thr->site = _find_lock_site(thr->tag);
+
+	stat = &lock_stats[inx];
+	stat->cnt++;
+	stat->wait_sum += wait_usec;
+	if (wait_usec > stat->wait_max)
+		stat->wait_max = wait_usec;
+	stat->wait_hist[stat_hist_bucket(wait_usec)]++;
+
+	site_ptr = &lock_sites[thr->site];
+	site_ptr->cnt[inx]++;
+	site_ptr->wait_sum[inx] += wait_usec;
+	if (wait_usec > site_ptr->wait_max[inx])
+		site_ptr->wait_max[inx] = wait_usec;
+
+	if ((slurmctld_locks.entity[read_lock(datatype)] +
+	     slurmctld_locks.entity[write_lock(datatype)]) == 1) {
+		lock_holds[datatype].site = thr->site;
+		lock_holds[datatype].mode = mode;
+		lock_holds[datatype].start = now;
+	}
+}
+
+/* Record the hold time of a lock just released, once it is free.
+ * locks_mutex must be locked by the caller. */
+static void _record_lock_hold(lock_datatype_t datatype, struct timeval *now)
+{
+	lock_hold_t *hold = &lock_holds[datatype];
+	lock_stat_t *stat;
+	lock_site_t *site_ptr;
+	uint32_t hold_usec;
+	int inx;
+
+	if (slurmctld_locks.entity[read_lock(datatype)] ||
+	    slurmctld_locks.entity[write_lock(datatype)])
+		return;
+
+	hold_usec = _delta_usec(&hold->start, now);
+	inx = lock_stat_inx(datatype, hold->mode);
+
+	stat = &lock_stats[inx];
+	stat->hold_sum += hold_usec;
+	if (hold_usec > stat->hold_max)
+		stat->hold_max = hold_usec;
+	stat->hold_hist[stat_hist_bucket(hold_usec)]++;
+
+	site_ptr = &lock_sites[hold->site];
+	site_ptr->hold_sum[inx] += hold_usec;
+	if (hold_usec > site_ptr->hold_max[inx])
+		site_ptr->hold_max[inx] = hold_usec;
+}
+
+/* get_lock_wait_time - Return the total time, in microseconds, which the
+ *	calling thread has spent waiting in lock_slurmctld() */
+extern uint64_t get_lock_wait_time(void)
+{
+	lock_thread_t *thr;
+
+	pthread_once(&lock_thread_once, _lock_thread_init);
+	thr = pthread_getspecific(lock_thread_key);
+	if (!thr)
+		return 0;
+	return thr->wait_usec;
+}
+
+/* lock_slurmctld - Issue the required lock requests in a well defined order
+ *	Lock wait and hold times are recorded for the calling function */
 extern void lock_slurmctld(slurmctld_lock_t lock_levels)
 {
+	lock_slurmctld_tag(lock_levels, __func__);
+}
+
+/* lock_slurmctld_tag - Issue the required lock requests in a well defined
+ *	order, recording wait and hold times against the call site "tag" */
+extern void lock_slurmctld_tag(slurmctld_lock_t lock_levels, const char *tag)
+{
+	lock_thread_t *thr = _get_lock_thread(tag);
+
 	if (lock_levels.config == READ_LOCK)
-		(void) _wr_rdlock(CONFIG_LOCK, true);
+		(void) _wr_rdlock(CONFIG_LOCK, true, thr);
 	else if (lock_levels.config == WRITE_LOCK)
-		(void) _wr_wrlock(CONFIG_LOCK, true);
+		(void) _wr_wrlock(CONFIG_LOCK, true, thr);
 
 	if (lock_levels.job == READ_LOCK)
-		(void) _wr_rdlock(JOB_LOCK, true);
+		(void) _wr_rdlock(JOB_LOCK, true, thr);
 	else if (lock_levels.job == WRITE_LOCK)
-		(void) _wr_wrlock(JOB_LOCK, true);
+		(void) _wr_wrlock(JOB_LOCK, true, thr);
 
 	if (lock_levels.node == READ_LOCK)
-		(void) _wr_rdlock(NODE_LOCK, true);
+		(void) _wr_rdlock(NODE_LOCK, true, thr);
 	else if (lock_levels.node == WRITE_LOCK)
-		(void) _wr_wrlock(NODE_LOCK, true);
+		(void) _wr_wrlock(NODE_LOCK, true, thr);
 
 	if (lock_levels.partition == READ_LOCK)
-		(void) _wr_rdlock(PART_LOCK, true);
+		(void) _wr_rdlock(PART_LOCK, true, thr);
 	else if (lock_levels.partition == WRITE_LOCK)
-		(void) _wr_wrlock(PART_LOCK, true);
+		(void) _wr_wrlock(PART_LOCK, true, thr);
+}
+
+/* try_lock_slurmctld - equivalent to lock_slurmctld() except
+ * RET 0 on success or -1 if the locks are currently not available */
+extern int try_lock_slurmctld(slurmctld_lock_t lock_levels)
+{
+	return try_lock_slurmctld_tag(lock_levels, __func__);
 }
 
-/* try_lock_slurmctld - equivalent to lock_slurmctld() except 
+/* try_lock_slurmctld_tag - equivalent to lock_slurmctld_tag() except
  * RET 0 on success or -1 if the locks are currently not available */
-extern int try_lock_slurmctld (slurmctld_lock_t lock_levels)
+extern int try_lock_slurmctld_tag(slurmctld_lock_t lock_levels,
+				  const char *tag)
 {
+	lock_thread_t *thr = _get_lock_thread(tag);
 	bool success = true;
 
 	if (lock_levels.config == READ_LOCK)
-		success = _wr_rdlock(CONFIG_LOCK, false);
+		success = _wr_rdlock(CONFIG_LOCK, false, thr);
 	else if (lock_levels.config == WRITE_LOCK)
-		success = _wr_wrlock(CONFIG_LOCK, false);
+		success = _wr_wrlock(CONFIG_LOCK, false, thr);
 	if (!success)
 		return -1;
 		
 	if (lock_levels.job == READ_LOCK)
-		success = _wr_rdlock(JOB_LOCK, false);
+		success = _wr_rdlock(JOB_LOCK, false, thr);
 	else if (lock_levels.job == WRITE_LOCK)
-		success = _wr_wrlock(JOB_LOCK, false);
+		success = _wr_wrlock(JOB_LOCK, false, thr);
 	if (!success) {
 		if (lock_levels.config == READ_LOCK)
 			_wr_rdunlock(CONFIG_LOCK);
@@ -122,9 +394,9 @@ extern int try_lock_slurmctld (slurmctld_lock_t lock_levels)
 	}
 
 	if (lock_levels.node == READ_LOCK)
-		success = _wr_rdlock(NODE_LOCK, false);
+		success = _wr_rdlock(NODE_LOCK, false, thr);
 	else if (lock_levels.node == WRITE_LOCK)
-		success = _wr_wrlock(NODE_LOCK, false);
+		success = _wr_wrlock(NODE_LOCK, false, thr);
 	if (!success) {
 		if (lock_levels.job == READ_LOCK)
 			_wr_rdunlock(JOB_LOCK);
@@ -138,9 +410,9 @@ extern int try_lock_slurmctld (slurmctld_lock_t lock_levels)
 	}
 
 	if (lock_levels.partition == READ_LOCK)
-		success = _wr_rdlock(PART_LOCK, false);
+		success = _wr_rdlock(PART_LOCK, false, thr);
 	else if (lock_levels.partition == WRITE_LOCK)
-		success = _wr_wrlock(PART_LOCK, false);
+		success = _wr_wrlock(PART_LOCK, false, thr);
 	if (!success) {
 		if (lock_levels.node == READ_LOCK)
 			_wr_rdunlock(NODE_LOCK);
@@ -193,10 +465,13 @@ extern void unlock_slurmctld(slurmctld_lock_t lock_levels)
  *	read locks. To prevent this, read locks were permitted to be satisified
  *	after 10 consecutive write locks. This prevented starvation, but
  *	deadlock has been observed with some values for the count. */
-static bool _wr_rdlock(lock_datatype_t datatype, bool wait_lock)
+static bool _wr_rdlock(lock_datatype_t datatype, bool wait_lock,
+		       lock_thread_t *thr)
 {
+	struct timeval start;
 	bool success = true;
 
+	gettimeofday(&start, NULL);
 	slurm_mutex_lock(&locks_mutex);
 	while (1) {
 #if 1
@@ -210,6 +485,7 @@ static bool _wr_rdlock(lock_datatype_t datatype, bool wait_lock)
 #endif
 			slurmctld_locks.entity[read_lock(datatype)]++;
 			slurmctld_locks.entity[write_cnt_lock(datatype)] = 0;
+			_record_lock_wait(datatype, 0, thr, &start);
 			break;
 		} else if (!wait_lock) {
 			success = false;
@@ -227,17 +503,24 @@ static bool _wr_rdlock(lock_datatype_t datatype, bool wait_lock)
 /* _wr_rdunlock - Issue a read unlock on the specified data type */
 static void _wr_rdunlock(lock_datatype_t datatype)
 {
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
 	slurm_mutex_lock(&locks_mutex);
 	slurmctld_locks.entity[read_lock(datatype)]--;
+	_record_lock_hold(datatype, &now);
 	pthread_cond_broadcast(&locks_cond);
 	slurm_mutex_unlock(&locks_mutex);
 }
 
 /* _wr_wrlock - Issue a write lock on the specified data type */
-static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock)
+static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock,
+		       lock_thread_t *thr)
 {
+	struct timeval start;
 	bool success = true;
 
+	gettimeofday(&start, NULL);
 	slurm_mutex_lock(&locks_mutex);
 	slurmctld_locks.entity[write_wait_lock(datatype)]++;
 
@@ -247,6 +530,7 @@ static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock)
 			slurmctld_locks.entity[write_lock(datatype)]++;
 			slurmctld_locks.entity[write_wait_lock(datatype)]--;
 			slurmctld_locks.entity[write_cnt_lock(datatype)]++;
+			_record_lock_wait(datatype, 1, thr, &start);
 			break;
 		} else if (!wait_lock) {
 			slurmctld_locks.entity[write_wait_lock(datatype)]--;
@@ -265,8 +549,13 @@ static bool _wr_wrlock(lock_datatype_t datatype, bool wait_lock)
 /* _wr_wrunlock - Issue a write unlock on the specified data type */
 static void _wr_wrunlock(lock_datatype_t datatype)
 {
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
 	slurm_mutex_lock(&locks_mutex);
 	slurmctld_locks.entity[write_lock(datatype)]--;
+	write_unlock_cnt[datatype]++;
+	_record_lock_hold(datatype, &now);
 	pthread_cond_broadcast(&locks_cond);
 	slurm_mutex_unlock(&locks_mutex);
 }
@@ -280,6 +569,19 @@ void get_lock_values(slurmctld_lock_flags_t * lock_flags)
 	       sizeof(slurmctld_locks));
 }
 
+/* get_write_unlock_cnt - Return the number of times the write lock on the
+ *	specified data type has been released. Data protected by the lock
+ *	can only have changed if this value changes. */
+extern uint32_t get_write_unlock_cnt(lock_datatype_t datatype)
+{
+	uint32_t cnt;
+
+	slurm_mutex_lock(&locks_mutex);
+	cnt = write_unlock_cnt[datatype];
+	slurm_mutex_unlock(&locks_mutex);
+	return cnt;
+}
+
 /* kill_locked_threads - Kill all threads waiting on semaphores */
 extern void kill_locked_threads(void)
 {
@@ -296,3 +598,183 @@ extern void unlock_state_files(void)
 {
 	slurm_mutex_unlock(&state_mutex);
 }
+
+/* reset_lock_stats - Clear lock wait and hold time statistics */
+extern void reset_lock_stats(void)
+{
+	char *tag;
+	int i;
+
+	slurm_mutex_lock(&locks_mutex);
+	memset(lock_stats, 0, sizeof(lock_stats));
+	for (i = 0; i < LOCK_SITE_CNT; i++) {
+		/* Keep call site names, threads may hold their index */
+		tag = lock_sites[i].tag;
+		memset(&lock_sites[i], 0, sizeof(lock_site_t));
+		lock_sites[i].tag = tag;
+	}
+	slurm_mutex_unlock(&locks_mutex);
+}
+
+/* Sort lock call site records by total wait time, descending */
+static int _sort_site_by_wait(const void *x, const void *y)
+{
+	const lock_site_rec_t *rec1 = (const lock_site_rec_t *) x;
+	const lock_site_rec_t *rec2 = (const lock_site_rec_t *) y;
+
+	if (rec1->wait_sum > rec2->wait_sum)
+		return -1;
+	if (rec1->wait_sum < rec2->wait_sum)
+		return 1;
+	return 0;
+}
+
+/* Copy the lock statistics and build a record for each call site and lock
+ * with activity, sorted by total wait time. Statistics are copied so they
+ * can be reported without holding locks_mutex.
+ * OUT stats - copy of lock_stats, LOCK_STAT_CNT records
+ * OUT rec_cnt - count of records returned
+ * RET call site records, caller must xfree stats and the return value */
+static lock_site_rec_t *_copy_lock_stats(lock_stat_t **stats,
+					 uint32_t *rec_cnt)
+{
+	lock_site_rec_t *recs;
+	lock_site_t *site;
+	int i, j;
+
+	*stats = xmalloc(sizeof(lock_stats));
+	*rec_cnt = 0;
+
+	slurm_mutex_lock(&locks_mutex);
+	memcpy(*stats, lock_stats, sizeof(lock_stats));
+	recs = xmalloc(sizeof(lock_site_rec_t) * lock_site_used *
+		       LOCK_STAT_CNT + 1);
+	for (i = 0; i < LOCK_SITE_CNT; i++) {
+		site = &lock_sites[i];
+		if (!site->tag)
+			continue;
+		for (j = 0; j < LOCK_STAT_CNT; j++) {
+			if (site->cnt[j] == 0)
+				continue;
+			recs[*rec_cnt].tag      = site->tag;
+			recs[*rec_cnt].inx      = j;
+			recs[*rec_cnt].cnt      = site->cnt[j];
+			recs[*rec_cnt].wait_sum = site->wait_sum[j];
+			recs[*rec_cnt].wait_max = site->wait_max[j];
+			recs[*rec_cnt].hold_sum = site->hold_sum[j];
+			recs[*rec_cnt].hold_max = site->hold_max[j];
+			(*rec_cnt)++;
+		}
+	}
+	slurm_mutex_unlock(&locks_mutex);
+
+	qsort(recs, *rec_cnt, sizeof(lock_site_rec_t), _sort_site_by_wait);
+	return recs;
+}
+
+/* pack_lock_stats - Pack lock wait and hold time statistics for sdiag */
+extern void pack_lock_stats(Buf buffer, uint16_t protocol_version)
+{
+	uint32_t wait_p50[LOCK_STAT_CNT], wait_p99[LOCK_STAT_CNT];
+	uint32_t wait_p999[LOCK_STAT_CNT], wait_max[LOCK_STAT_CNT];
+	uint32_t hold_p50[LOCK_STAT_CNT], hold_p99[LOCK_STAT_CNT];
+	uint32_t hold_p999[LOCK_STAT_CNT], hold_max[LOCK_STAT_CNT];
+	uint32_t cnt[LOCK_STAT_CNT];
+	uint64_t wait_sum[LOCK_STAT_CNT], hold_sum[LOCK_STAT_CNT];
+	uint32_t i, rec_cnt;
+	lock_site_rec_t *recs;
+	lock_stat_t *stats, *stat;
+
+	if (protocol_version < SLURM_15_08_PROTOCOL_VERSION)
+		return;
+
+	recs = _copy_lock_stats(&stats, &rec_cnt);
+	for (i = 0; i < LOCK_STAT_CNT; i++) {
+		stat = &stats[i];
+		cnt[i]       = stat->cnt;
+		wait_sum[i]  = stat->wait_sum;
+		wait_max[i]  = stat->wait_max;
+		wait_p50[i]  = stat_hist_percentile(stat->wait_hist,
+						    stat->wait_max, 500);
+		wait_p99[i]  = stat_hist_percentile(stat->wait_hist,
+						    stat->wait_max, 990);
+		wait_p999[i] = stat_hist_percentile(stat->wait_hist,
+						    stat->wait_max, 999);
+		hold_sum[i]  = stat->hold_sum;
+		hold_max[i]  = stat->hold_max;
+		hold_p50[i]  = stat_hist_percentile(stat->hold_hist,
+						    stat->hold_max, 500);
+		hold_p99[i]  = stat_hist_percentile(stat->hold_hist,
+						    stat->hold_max, 990);
+		hold_p999[i] = stat_hist_percentile(stat->hold_hist,
+						    stat->hold_max, 999);
+	}
+
+	pack32(LOCK_STAT_CNT, buffer);
+	pack32_array(cnt,       LOCK_STAT_CNT, buffer);
+	pack64_array(wait_sum,  LOCK_STAT_CNT, buffer);
+	pack32_array(wait_p50,  LOCK_STAT_CNT, buffer);
+	pack32_array(wait_p99,  LOCK_STAT_CNT, buffer);
+	pack32_array(wait_p999, LOCK_STAT_CNT, buffer);
+	pack32_array(wait_max,  LOCK_STAT_CNT, buffer);
+	pack64_array(hold_sum,  LOCK_STAT_CNT, buffer);
+	pack32_array(hold_p50,  LOCK_STAT_CNT, buffer);
+	pack32_array(hold_p99,  LOCK_STAT_CNT, buffer);
+	pack32_array(hold_p999, LOCK_STAT_CNT, buffer);
+	pack32_array(hold_max,  LOCK_STAT_CNT, buffer);
+
+	pack32(rec_cnt, buffer);
+	for (i = 0; i < rec_cnt; i++) {
+		packstr((char *) recs[i].tag, buffer);
+		pack16((uint16_t) recs[i].inx, buffer);
+		pack32(recs[i].cnt, buffer);
+		pack64(recs[i].wait_sum, buffer);
+		pack32(recs[i].wait_max, buffer);
+		pack64(recs[i].hold_sum, buffer);
+		pack32(recs[i].hold_max, buffer);
+	}
+	xfree(stats);
+	xfree(recs);
+}
+
+/* log_lock_stats - Write lock wait and hold time statistics to the log */
+extern void log_lock_stats(void)
+{
+	uint32_t i, rec_cnt;
+	lock_site_rec_t *recs;
+	lock_stat_t *stats, *stat;
+
+	recs = _copy_lock_stats(&stats, &rec_cnt);
+	info("Lock statistics (microseconds):");
+	for (i = 0; i < LOCK_STAT_CNT; i++) {
+		stat = &stats[i];
+		if (stat->cnt == 0)
+			continue;
+		info("  %s %s count:%u wait(total:%"PRIu64" p50:%u p99:%u "
+		     "p999:%u max:%u) hold(total:%"PRIu64" p50:%u p99:%u "
+		     "p999:%u max:%u)",
+		     lock_type_names[i / LOCK_MODE_CNT],
+		     lock_mode_names[i % LOCK_MODE_CNT], stat->cnt,
+		     stat->wait_sum,
+		     stat_hist_percentile(stat->wait_hist, stat->wait_max, 500),
+		     stat_hist_percentile(stat->wait_hist, stat->wait_max, 990),
+		     stat_hist_percentile(stat->wait_hist, stat->wait_max, 999),
+		     stat->wait_max, stat->hold_sum,
+		     stat_hist_percentile(stat->hold_hist, stat->hold_max, 500),
+		     stat_hist_percentile(stat->hold_hist, stat->hold_max, 990),
+		     stat_hist_percentile(stat->hold_hist, stat->hold_max, 999),
+		     stat->hold_max);
+	}
+
+	info("Lock statistics by call site, by total wait time:");
+	for (i = 0; i < rec_cnt; i++) {
+		info("  %s %s %s count:%u wait(total:%"PRIu64" max:%u) "
+		     "hold(total:%"PRIu64" max:%u)",
+		     recs[i].tag, lock_type_names[recs[i].inx / LOCK_MODE_CNT],
+		     lock_mode_names[recs[i].inx % LOCK_MODE_CNT], recs[i].cnt,
+		     recs[i].wait_sum, recs[i].wait_max, recs[i].hold_sum,
+		     recs[i].hold_max);
+	}
+	xfree(stats);
+	xfree(recs);
+}
@@ -87,6 +87,19 @@
 #ifndef _SLURMCTLD_LOCKS_H
 #define _SLURMCTLD_LOCKS_H
 
+#if HAVE_CONFIG_H
+#  include "config.h"
+#  if HAVE_INTTYPES_H
+#    include <inttypes.h>
+#  else
+#    if HAVE_STDINT_H
+#      include <stdint.h>
+#    endif
+#  endif			/* HAVE_INTTYPES_H */
+#endif
+
+#include "src/common/pack.h"
+
 /* levels of locking required for each data structure */
 typedef enum {
 	NO_LOCK,
@@ -129,10 +142,19 @@ typedef struct {
 }	slurmctld_lock_flags_t;
 
 
+/* get_lock_wait_time - Return the total time, in microseconds, which the
+ *	calling thread has spent waiting in lock_slurmctld() */
+extern uint64_t get_lock_wait_time (void);
+
 /* get_lock_values - Get the current value of all locks
  * OUT lock_flags - a copy of the current lock values */
 extern void get_lock_values (slurmctld_lock_flags_t *lock_flags);
 
+/* get_write_unlock_cnt - Return the number of times the write lock on the
+ *	specified data type has been released. Data protected by the lock
+ *	can only have changed if this value changes. */
+extern uint32_t get_write_unlock_cnt (lock_datatype_t datatype);
+
 /* init_locks - create locks used for slurmctld data structure access
  *	control */
 extern void init_locks ( void );
@@ -140,12 +162,36 @@ extern void init_locks ( void );
 /* kill_locked_threads - Kill all threads waiting on semaphores */
 extern void kill_locked_threads ( void );
 
-/* lock_slurmctld - Issue the required lock requests in a well defined order */
+/* lock_slurmctld - Issue the required lock requests in a well defined order
+ *	Lock wait and hold times are recorded for the calling function */
 extern void lock_slurmctld (slurmctld_lock_t lock_levels);
+#define lock_slurmctld(lock_levels) \
+	lock_slurmctld_tag(lock_levels, __func__)
+
+/* lock_slurmctld_tag - Issue the required lock requests in a well defined
+ *	order, recording wait and hold times against the call site "tag" */
+extern void lock_slurmctld_tag (slurmctld_lock_t lock_levels,
+				const char *tag);
+
+/* log_lock_stats - Write lock wait and hold time statistics to the log */
+extern void log_lock_stats (void);
+
+/* pack_lock_stats - Pack lock wait and hold time statistics for sdiag */
+extern void pack_lock_stats (Buf buffer, uint16_t protocol_version);
+
+/* reset_lock_stats - Clear lock wait and hold time statistics */
+extern void reset_lock_stats (void);
 
 /* try_lock_slurmctld - equivalent to lock_slurmctld() except 
  * RET 0 on success or -1 if the locks are currently not available */
 extern int try_lock_slurmctld (slurmctld_lock_t lock_levels);
+#define try_lock_slurmctld(lock_levels) \
+	try_lock_slurmctld_tag(lock_levels, __func__)
+
+/* try_lock_slurmctld_tag - equivalent to lock_slurmctld_tag() except
+ * RET 0 on success or -1 if the locks are currently not available */
+extern int try_lock_slurmctld_tag (slurmctld_lock_t lock_levels,
+				   const char *tag);
 
 /* unlock_slurmctld - Issue the required unlock requests in a well
  *	defined order */
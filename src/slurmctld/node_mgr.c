@@ -102,10 +102,17 @@ static front_end_record_t * _front_end_reg(
 static bool	_is_cloud_hidden(struct node_record *node_ptr);
 static void 	_make_node_down(struct node_record *node_ptr,
 				time_t event_time);
+static time_t	_node_delta_time(struct node_record *node_ptr, time_t now,
+				 Buf buffer);
 static bool	_node_is_hidden(struct node_record *node_ptr);
+static bitstr_t *_node_filter_bitmap(node_info_filter_t *filter);
+static bool	_node_state_match(struct node_record *node_ptr,
+				  node_info_filter_t *filter);
 static int	_open_node_state_file(char **state_file);
 static void 	_pack_node(struct node_record *dump_node_ptr, Buf buffer,
-			   uint16_t protocol_version, uint16_t show_flags);
+			   uint16_t protocol_version, uint16_t show_flags,
+			   uint32_t field_mask,
+			   dynamic_plugin_data_t *stub_nodeinfo);
 static void	_sync_bitmaps(struct node_record *node_ptr, int job_count);
 static void	_update_config_ptr(bitstr_t *bitmap,
 				struct config_record *config_ptr);
@@ -679,6 +686,98 @@ static bool _node_is_hidden(struct node_record *node_ptr)
 	return true;
 }
 
+/* Build a bitmap of the nodes matching a filter's node names and partitions,
+ * return NULL if the filter includes all nodes. Free using FREE_NULL_BITMAP */
+static bitstr_t *_node_filter_bitmap(node_info_filter_t *filter)
+{
+	bitstr_t *node_bitmap = NULL, *part_bitmap = NULL;
+	struct part_record *part_ptr;
+	char *tmp_name, *tok, *save_ptr = NULL;
+
+	if (filter->nodes)
+		(void) node_name2bitmap(filter->nodes, true, &node_bitmap);
+
+	if (filter->partitions) {
+		part_bitmap = bit_alloc(node_record_count);
+		tmp_name = xstrdup(filter->partitions);
+		tok = strtok_r(tmp_name, ",", &save_ptr);
+		while (tok) {
+			part_ptr = find_part_record(tok);
+			if (part_ptr && part_ptr->node_bitmap)
+				bit_or(part_bitmap, part_ptr->node_bitmap);
+			tok = strtok_r(NULL, ",", &save_ptr);
+		}
+		xfree(tmp_name);
+		if (node_bitmap) {
+			bit_and(node_bitmap, part_bitmap);
+			FREE_NULL_BITMAP(part_bitmap);
+		} else
+			node_bitmap = part_bitmap;
+	}
+
+	return node_bitmap;
+}
+
+/*
+ * node_changed - Record that a node's information has changed
+ */
+extern void node_changed(struct node_record *node_ptr, time_t now)
+{
+	last_node_update = now;
+}
+
+/*
+ * all_nodes_changed - Record that any node's information may have changed
+ */
+extern void all_nodes_changed(time_t now)
+{
+	last_node_update = now;
+}
+
+/*
+ * _node_delta_time - Return the time at which a change to a node's
+ *	information was last detected, by comparing a digest of its packed
+ *	record with that computed for the previous request.
+ * IN buffer - scratch buffer
+ * NOTE: WRITE lock_slurmctld node before entry
+ */
+static time_t _node_delta_time(struct node_record *node_ptr, time_t now,
+			       Buf buffer)
+{
+	uint64_t digest;
+
+	set_buf_offset(buffer, 0);
+	_pack_node(node_ptr, buffer, SLURM_PROTOCOL_VERSION, SHOW_DETAIL,
+		   NODE_FIELD_ALL, NULL);
+	digest = get_buf_digest(buffer, 0);
+	if (!node_ptr->delta_time || (node_ptr->delta_digest != digest)) {
+		node_ptr->delta_digest = digest;
+		node_ptr->delta_time = now;
+	}
+	return node_ptr->delta_time;
+}
+
+/* Determine if a node's state matches a filter */
+static bool _node_state_match(struct node_record *node_ptr,
+			      node_info_filter_t *filter)
+{
+	uint32_t state;
+	int i;
+
+	if (filter->state_cnt == 0)
+		return true;
+
+	for (i = 0; i < filter->state_cnt; i++) {
+		state = filter->states[i];
+		if (state & NODE_STATE_FLAGS) {
+			if (node_ptr->node_state & state)
+				return true;
+		} else if ((node_ptr->node_state & NODE_STATE_BASE) == state)
+			return true;
+	}
+	return false;
+}
+
 /*
  * pack_all_node - dump all configuration and node information for all nodes
  *	in machine independent form (for network transmission)
@@ -686,22 +785,30 @@ static bool _node_is_hidden(struct node_record *node_ptr)
  * OUT buffer_size - set to size of the buffer in bytes
  * IN show_flags - node filtering options
  * IN uid - uid of user making request (for partition filtering)
+ * IN filter - nodes not matching this filter are packed without a name,
+ *	NULL for all
+ * IN update_time - with SHOW_DELTA, pack only nodes changed since this time,
+ *	if possible
  * IN protocol_version - slurm protocol version of client
  * global: node_record_table_ptr - pointer to global node table
  * NOTE: the caller must xfree the buffer at *buffer_ptr
  * NOTE: change slurm_load_node() in api/node_info.c when data format changes
- * NOTE: READ lock_slurmctld config before entry
+ * NOTE: READ lock_slurmctld config and partition before entry
  */
 extern void pack_all_node (char **buffer_ptr, int *buffer_size,
 			   uint16_t show_flags, uid_t uid,
+			   node_info_filter_t *filter, time_t update_time,
 			   uint16_t protocol_version)
 {
 	int inx;
 	uint32_t nodes_packed, tmp_offset, node_scaling;
-	Buf buffer;
+	uint32_t field_mask = NODE_FIELD_ALL, *delta_inx = NULL;
+	Buf buffer, delta_buffer = NULL;
 	time_t now = time(NULL);
 	struct node_record *node_ptr = node_record_table_ptr;
-	bool hidden;
+	bitstr_t *filter_bitmap = NULL;
+	dynamic_plugin_data_t *stub_nodeinfo = NULL;
+	bool hidden, filtered;
 
 	buffer_ptr[0] = NULL;
 	*buffer_size = 0;
@@ -718,6 +825,21 @@ extern void pack_all_node (char **buffer_ptr, int *buffer_size,
 
 		pack_time(now, buffer);
 
+		if (filter) {
+			filter_bitmap = _node_filter_bitmap(filter);
+			field_mask = filter->field_mask;
+		}
+
+		/* Node table and hidden partitions must be unchanged */
+		if ((show_flags & SHOW_DELTA) && update_time &&
+		    (protocol_version >= SLURM_15_08_PROTOCOL_VERSION) &&
+		    (update_time > last_part_update) &&
+		    (update_time > slurmctld_conf.last_update)) {
+			delta_buffer = init_buf(BUF_SIZE);
+			delta_inx = xmalloc(sizeof(uint32_t) *
+					    node_record_count);
+		}
+
 		/* write node records */
 		part_filter_set(uid);
 		for (inx = 0; inx < node_record_count; inx++, node_ptr++) {
@@ -725,6 +847,11 @@ extern void pack_all_node (char **buffer_ptr, int *buffer_size,
 			xassert (node_ptr->config_ptr->magic ==
 				 CONFIG_MAGIC);
 
+			if (delta_buffer &&
+			    (_node_delta_time(node_ptr, now, delta_buffer) <
+			     update_time))
+				continue;
+
 			/* We can't avoid packing node records without breaking
 			 * the node index pointers. So pack a node
 			 * with a name of NULL and let the caller deal
@@ -741,19 +868,48 @@ extern void pack_all_node (char **buffer_ptr, int *buffer_size,
 				 (node_ptr->name[0] == '\0'))
 				hidden = true;
 
-			if (hidden) {
+			/* Nodes not matching the filter are packed like
+			 * hidden nodes, but without optional fields */
+			filtered = false;
+			if (!hidden && filter &&
+			    ((filter_bitmap && !bit_test(filter_bitmap, inx)) ||
+			     !_node_state_match(node_ptr, filter)))
+				filtered = true;
+
+			if (filtered && !stub_nodeinfo)
+				stub_nodeinfo = select_g_select_nodeinfo_alloc();
+			if (hidden || filtered) {
 				char *orig_name = node_ptr->name;
 				node_ptr->name = NULL;
 				_pack_node(node_ptr, buffer, protocol_version,
-				           show_flags);
+					   show_flags,
+					   filtered ? 0 : NODE_FIELD_ALL,
+					   filtered ? stub_nodeinfo : NULL);
 				node_ptr->name = orig_name;
 			} else {
 				_pack_node(node_ptr, buffer, protocol_version,
-					   show_flags);
+					   show_flags, field_mask, NULL);
 			}
+			if (delta_inx)
+				delta_inx[nodes_packed] = inx;
 			nodes_packed++;
 		}
 		part_filter_clear();
+		FREE_NULL_BITMAP(filter_bitmap);
+		if (stub_nodeinfo)
+			select_g_select_nodeinfo_free(stub_nodeinfo);
+
+		if (protocol_version >= SLURM_15_08_PROTOCOL_VERSION) {
+			if (delta_inx) {
+				pack16((uint16_t) 1, buffer);
+				pack32((uint32_t) node_record_count, buffer);
+				pack32_array(delta_inx, nodes_packed, buffer);
+			} else
+				pack16((uint16_t) 0, buffer);
+		}
+		xfree(delta_inx);
+		if (delta_buffer)
+			free_buf(delta_buffer);
 	} else {
 		error("select_g_select_jobinfo_pack: protocol_version "
 		      "%hu not supported", protocol_version);
@@ -829,11 +985,13 @@ extern void pack_one_node (char **buffer_ptr, int *buffer_size,
 
 			if (!hidden) {
 				_pack_node(node_ptr, buffer, protocol_version,
-					   show_flags);
+					   show_flags, NODE_FIELD_ALL, NULL);
 				nodes_packed++;
 			}
 		}
 		part_filter_clear();
+		if (protocol_version >= SLURM_15_08_PROTOCOL_VERSION)
+			pack16((uint16_t) 0, buffer);	/* not a delta */
 	} else {
 		error("select_g_select_jobinfo_pack: protocol_version "
 		      "%hu not supported", protocol_version);
@@ -855,21 +1013,44 @@ extern void pack_one_node (char **buffer_ptr, int *buffer_size,
  * IN/OUT buffer - buffer where data is placed, pointers automatically updated
  * IN protocol_version - slurm protocol version of client
  * IN show_flags -
+ * IN field_mask - NODE_FIELD_* values to pack, others are packed as NULL
+ * IN stub_nodeinfo - if set, pack this in place of the node's select
+ *	information and omit its energy and sensor data
  * NOTE: if you make any changes here be sure to make the corresponding
  *	changes to load_node_config in api/node_info.c
  * NOTE: READ lock_slurmctld config before entry
  */
 static void _pack_node (struct node_record *dump_node_ptr, Buf buffer,
-			uint16_t protocol_version, uint16_t show_flags)
+			uint16_t protocol_version, uint16_t show_flags,
+			uint32_t field_mask,
+			dynamic_plugin_data_t *stub_nodeinfo)
 {
-	char *gres_drain = NULL, *gres_used = NULL;
+	char *gres_drain = NULL, *gres_used = NULL, *gres;
+	dynamic_plugin_data_t *nodeinfo = dump_node_ptr->select_nodeinfo;
+	acct_gather_energy_t *energy = dump_node_ptr->energy;
+	ext_sensors_data_t *ext_sensors = dump_node_ptr->ext_sensors;
+
+	if (stub_nodeinfo) {
+		nodeinfo = stub_nodeinfo;
+		energy = NULL;
+		ext_sensors = NULL;
+	}
 
 	if (protocol_version >= SLURM_14_11_PROTOCOL_VERSION) {
 		packstr (dump_node_ptr->name, buffer);
-		packstr (dump_node_ptr->node_hostname, buffer);
-		packstr (dump_node_ptr->comm_name, buffer);
+		if (field_mask & NODE_FIELD_HOSTNAME)
+			packstr (dump_node_ptr->node_hostname, buffer);
+		else
+			packnull(buffer);
+		if (field_mask & NODE_FIELD_NODE_ADDR)
+			packstr (dump_node_ptr->comm_name, buffer);
+		else
+			packnull(buffer);
 		pack32(dump_node_ptr->node_state, buffer);
-		packstr (dump_node_ptr->version, buffer);
+		if (field_mask & NODE_FIELD_VERSION)
+			packstr (dump_node_ptr->version, buffer);
+		else
+			packnull(buffer);
 		/* On a bluegene system always use the regular node
 		* infomation not what is in the config_ptr. */
 #ifndef HAVE_BG
@@ -897,7 +1078,10 @@ static void _pack_node (struct node_record *dump_node_ptr, Buf buffer,
 #endif
 		pack16(dump_node_ptr->core_spec_cnt, buffer);
 		pack32(dump_node_ptr->mem_spec_limit, buffer);
-		packstr(dump_node_ptr->cpu_spec_list, buffer);
+		if (field_mask & NODE_FIELD_CPU_SPEC)
+			packstr(dump_node_ptr->cpu_spec_list, buffer);
+		else
+			packnull(buffer);
 
 		pack32(dump_node_ptr->cpu_load, buffer);
 		pack32(dump_node_ptr->config_ptr->weight, buffer);
@@ -907,18 +1091,28 @@ static void _pack_node (struct node_record *dump_node_ptr, Buf buffer,
 		pack_time(dump_node_ptr->reason_time, buffer);
 		pack_time(dump_node_ptr->slurmd_start_time, buffer);
 
-		select_g_select_nodeinfo_pack(dump_node_ptr->select_nodeinfo,
-					      buffer, protocol_version);
+		select_g_select_nodeinfo_pack(nodeinfo, buffer,
+					      protocol_version);
 
-		packstr(dump_node_ptr->arch, buffer);
-		packstr(dump_node_ptr->features, buffer);
-		if (dump_node_ptr->gres)
-			packstr(dump_node_ptr->gres, buffer);
+		if (field_mask & NODE_FIELD_ARCH)
+			packstr(dump_node_ptr->arch, buffer);
 		else
-			packstr(dump_node_ptr->config_ptr->gres, buffer);
+			packnull(buffer);
+		if (field_mask & NODE_FIELD_FEATURES)
+			packstr(dump_node_ptr->features, buffer);
+		else
+			packnull(buffer);
+		if (!(field_mask & NODE_FIELD_GRES))
+			gres = NULL;
+		else if (dump_node_ptr->gres)
+			gres = dump_node_ptr->gres;
+		else
+			gres = dump_node_ptr->config_ptr->gres;
+		packstr(gres, buffer);
 
 		/* Gathering GRES deails is slow, so don't by default */
-		if (show_flags & SHOW_DETAIL) {
+		if ((show_flags & SHOW_DETAIL) &&
+		    (field_mask & NODE_FIELD_GRES)) {
 			gres_drain =
 				gres_get_node_drain(dump_node_ptr->gres_list);
 			gres_used  =
@@ -929,11 +1123,17 @@ static void _pack_node (struct node_record *dump_node_ptr, Buf buffer,
 		xfree(gres_drain);
 		xfree(gres_used);
 
-		packstr(dump_node_ptr->os, buffer);
-		packstr(dump_node_ptr->reason, buffer);
-		acct_gather_energy_pack(dump_node_ptr->energy, buffer,
+		if (field_mask & NODE_FIELD_OS)
+			packstr(dump_node_ptr->os, buffer);
+		else
+			packnull(buffer);
+		if (field_mask & NODE_FIELD_REASON)
+			packstr(dump_node_ptr->reason, buffer);
+		else
+			packnull(buffer);
+		acct_gather_energy_pack(energy, buffer,
 					protocol_version);
-		ext_sensors_data_pack(dump_node_ptr->ext_sensors, buffer,
+		ext_sensors_data_pack(ext_sensors, buffer,
 					protocol_version);
 	} else if (protocol_version >= SLURM_14_03_PROTOCOL_VERSION) {
 		packstr (dump_node_ptr->name, buffer);
@@ -975,8 +1175,8 @@ static void _pack_node (struct node_record *dump_node_ptr, Buf buffer,
 		pack_time(dump_node_ptr->reason_time, buffer);
 		pack_time(dump_node_ptr->slurmd_start_time, buffer);
 
-		select_g_select_nodeinfo_pack(dump_node_ptr->select_nodeinfo,
-					      buffer, protocol_version);
+		select_g_select_nodeinfo_pack(nodeinfo, buffer,
+					      protocol_version);
 
 		packstr(dump_node_ptr->arch, buffer);
 		packstr(dump_node_ptr->features, buffer);
@@ -986,9 +1186,9 @@ static void _pack_node (struct node_record *dump_node_ptr, Buf buffer,
 			packstr(dump_node_ptr->config_ptr->gres, buffer);
 		packstr(dump_node_ptr->os, buffer);
 		packstr(dump_node_ptr->reason, buffer);
-		acct_gather_energy_pack(dump_node_ptr->energy, buffer,
+		acct_gather_energy_pack(energy, buffer,
 					protocol_version);
-		ext_sensors_data_pack(dump_node_ptr->ext_sensors, buffer,
+		ext_sensors_data_pack(ext_sensors, buffer,
 					protocol_version);
 	} else {
 		error("_pack_node: protocol_version "
@@ -1375,7 +1575,7 @@ int update_node ( update_node_msg_t * update_node_msg )
 	FREE_NULL_HOSTLIST(host_list);
 	FREE_NULL_HOSTLIST(hostaddr_list);
 	FREE_NULL_HOSTLIST(hostname_list);
-	last_node_update = now;
+	all_nodes_changed(now);
 
 	if ((error_code == 0) && (update_node_msg->features)) {
 		error_code = _update_node_features(update_node_msg->node_names,
@@ -1788,7 +1988,7 @@ extern int drain_nodes ( char *nodes, char *reason, uint32_t reason_uid )
 
 		free (this_node_name);
 	}
-	last_node_update = time (NULL);
+	all_nodes_changed(time(NULL));
 
 	hostlist_destroy (host_list);
 	return error_code;
@@ -2098,13 +2298,13 @@ extern int validate_node_specs(slurm_node_registration_status_msg_t *reg_msg,
 	if (node_ptr->cpu_load != reg_msg->cpu_load) {
 		node_ptr->cpu_load = reg_msg->cpu_load;
 		node_ptr->cpu_load_time = now;
-		last_node_update = now;
+		node_changed(node_ptr, now);
 	}
 
 	if (IS_NODE_NO_RESPOND(node_ptr)) {
 		node_ptr->node_state &= (~NODE_STATE_NO_RESPOND);
 		node_ptr->node_state &= (~NODE_STATE_POWER_UP);
-		last_node_update = time (NULL);
+		node_changed(node_ptr, time(NULL));
 	}
 
 	node_flags = node_ptr->node_state & NODE_STATE_FLAGS;
@@ -2119,14 +2319,14 @@ extern int validate_node_specs(slurm_node_registration_status_msg_t *reg_msg,
 						reason_down,
 						slurmctld_conf.slurm_user_id);
 		}
-		last_node_update = time (NULL);
+		node_changed(node_ptr, time(NULL));
 	} else if (reg_msg->status == ESLURMD_PROLOG_FAILED) {
 		if (!IS_NODE_DRAIN(node_ptr) && !IS_NODE_FAIL(node_ptr)) {
 			error("Prolog failure on node %s, draining the node",
 			      reg_msg->node_name);
 			drain_nodes(reg_msg->node_name, "Prolog error",
 				    slurm_get_slurm_user_id());
-			last_node_update = time (NULL);
+			node_changed(node_ptr, time(NULL));
 		}
 	} else {
 		if (IS_NODE_UNKNOWN(node_ptr) || IS_NODE_FUTURE(node_ptr)) {
@@ -2150,7 +2350,7 @@ extern int validate_node_specs(slurm_node_registration_status_msg_t *reg_msg,
 					node_flags;
 				node_ptr->last_idle = now;
 			}
-			last_node_update = now;
+			node_changed(node_ptr, now);
 
 			/* don't send this on a slurmctld unless needed */
 			if (unknown && slurmctld_init_db
@@ -2178,7 +2378,7 @@ extern int validate_node_specs(slurm_node_registration_status_msg_t *reg_msg,
 			info("node %s returned to service",
 			     reg_msg->node_name);
 			trigger_node_up(node_ptr);
-			last_node_update = now;
+			node_changed(node_ptr, now);
 			if (!IS_NODE_DRAIN(node_ptr)
 			    && !IS_NODE_FAIL(node_ptr)) {
 				/* reason information is handled in
@@ -2201,17 +2401,17 @@ extern int validate_node_specs(slurm_node_registration_status_msg_t *reg_msg,
 			     reg_msg->node_name);
 			_make_node_down(node_ptr, now);
 			kill_running_job_by_node_name(reg_msg->node_name);
-			last_node_update = now;
+			node_changed(node_ptr, now);
 			reg_msg->job_count = 0;
 		} else if (IS_NODE_ALLOCATED(node_ptr) &&
 			   (reg_msg->job_count == 0)) {	/* job vanished */
 			node_ptr->node_state = NODE_STATE_IDLE | node_flags;
 			node_ptr->last_idle = now;
-			last_node_update = now;
+			node_changed(node_ptr, now);
 		} else if (IS_NODE_COMPLETING(node_ptr) &&
 			   (reg_msg->job_count == 0)) {	/* job already done */
 			node_ptr->node_state &= (~NODE_STATE_COMPLETING);
-			last_node_update = now;
+			node_changed(node_ptr, now);
 			bit_clear(cg_node_bitmap, node_inx);
 		} else if (IS_NODE_IDLE(node_ptr) &&
 			   (reg_msg->job_count != 0)) {
@@ -2231,7 +2431,7 @@ extern int validate_node_specs(slurm_node_registration_status_msg_t *reg_msg,
 				node_ptr->node_state |= NODE_STATE_COMPLETING;
 				bit_set(cg_node_bitmap, node_inx);
 			}
-			last_node_update = now;
+			node_changed(node_ptr, now);
 		}
 
 		select_g_update_node_config(node_inx);
@@ -2472,7 +2672,7 @@ extern int validate_nodes_via_front_end(
 				      node_ptr->name);
 			}
 			set_node_down(node_ptr->name, reason_down);
-			last_node_update = now;
+			node_changed(node_ptr, now);
 		}
 		xfree(reason_down);
 		gres_plugin_node_state_log(node_ptr->gres_list, node_ptr->name);
@@ -2595,7 +2795,7 @@ extern int validate_nodes_via_front_end(
 	}
 
 	if (update_node_state)
-		last_node_update = time (NULL);
+		all_nodes_changed(time(NULL));
 	return error_code;
 }
 
@@ -2675,7 +2875,7 @@ static void _node_did_resp(struct node_record *node_ptr)
 		node_ptr->node_state &= (~NODE_STATE_POWER_UP);
 		if (!is_node_in_maint_reservation(node_inx))
 			node_ptr->node_state &= (~NODE_STATE_MAINT);
-		last_node_update = now;
+		node_changed(node_ptr, now);
 	}
 	node_flags = node_ptr->node_state & NODE_STATE_FLAGS;
 	if (IS_NODE_UNKNOWN(node_ptr)) {
@@ -2685,7 +2885,7 @@ static void _node_did_resp(struct node_record *node_ptr)
 					       node_flags;
 		} else
 			node_ptr->node_state = NODE_STATE_IDLE | node_flags;
-		last_node_update = now;
+		node_changed(node_ptr, now);
 		if (!IS_NODE_DRAIN(node_ptr) && !IS_NODE_FAIL(node_ptr)) {
 			clusteracct_storage_g_node_up(acct_db_conn,
 						      node_ptr, now);
@@ -2701,7 +2901,7 @@ static void _node_did_resp(struct node_record *node_ptr)
 		info("node_did_resp: node %s returned to service",
 		     node_ptr->name);
 		trigger_node_up(node_ptr);
-		last_node_update = now;
+		node_changed(node_ptr, now);
 		if (!IS_NODE_DRAIN(node_ptr) && !IS_NODE_FAIL(node_ptr)) {
 			/* reason information is handled in
 			   clusteracct_storage_g_node_up()
@@ -2749,6 +2949,56 @@ void node_did_resp (char *name)
 	debug2("node_did_resp %s",name);
 }
 
+/*
+ * node_did_resp_aggr - record that the nodes of an aggregated ping
+ *	response are responding, along with their CPU load
+ * IN node_list - hostlist expression of the nodes
+ * IN aggr - their CPU load in the order of node_list
+ * NOTE: READ lock_slurmctld config and WRITE node before entry
+ */
+extern void node_did_resp_aggr(char *node_list, ping_slurmd_aggr_msg_t *aggr)
+{
+#ifdef HAVE_FRONT_END
+	front_end_record_t *node_ptr;
+#else
+	struct node_record *node_ptr;
+	time_t now = time(NULL);
+#endif
+	hostlist_t hl;
+	char *name;
+	uint32_t i;
+
+	hl = hostlist_create(node_list);
+	if (hostlist_count(hl) != aggr->node_cnt) {
+		error("node_did_resp_aggr: %u loads for nodes %s",
+		      aggr->node_cnt, node_list);
+		hostlist_destroy(hl);
+		return;
+	}
+	for (i = 0; (name = hostlist_shift(hl)); i++) {
+#ifdef HAVE_FRONT_END
+		node_ptr = find_front_end_record(name);
+#else
+		node_ptr = find_node_record(name);
+#endif
+		if (node_ptr == NULL) {
+			error("node_did_resp_aggr unable to find node %s",
+			      name);
+			free(name);
+			continue;
+		}
+		free(name);
+#ifndef HAVE_FRONT_END
+		node_ptr->cpu_load = aggr->cpu_load[i];
+		node_ptr->cpu_load_time = now;
+		node_changed(node_ptr, now);
+#endif
+		_node_did_resp(node_ptr);
+	}
+	hostlist_destroy(hl);
+	debug2("node_did_resp %s", node_list);
+}
+
 /*
  * node_not_resp - record that the specified node is not responding
  * IN name - name of the node
@@ -2799,7 +3049,7 @@ void node_not_resp (char *name, time_t msg_time, slurm_msg_type_t resp_type)
 #ifdef HAVE_FRONT_END
 	last_front_end_update = time(NULL);
 #else
-	last_node_update = time(NULL);
+	node_changed(node_ptr, time(NULL));
 	bit_clear (avail_node_bitmap, (node_ptr - node_record_table_ptr));
 #endif
 	return;
@@ -3031,7 +3281,7 @@ extern void make_node_alloc(struct node_record *node_ptr,
 	node_ptr->reason_time = 0;
 	node_ptr->reason_uid = NO_VAL;
 
-	last_node_update = time (NULL);
+	node_changed(node_ptr, time(NULL));
 }
 
 /* make_node_comp - flag specified node as completing a job
@@ -3100,7 +3350,7 @@ extern void make_node_comp(struct node_record *node_ptr,
 		node_ptr->node_state = NODE_STATE_IDLE | node_flags;
 		node_ptr->last_idle = now;
 	}
-	last_node_update = now;
+	node_changed(node_ptr, now);
 }
 
 /* _make_node_down - flag specified node as down */
@@ -3120,7 +3370,7 @@ static void _make_node_down(struct node_record *node_ptr, time_t event_time)
 	bit_clear (up_node_bitmap,    inx);
 	select_g_update_node_state(node_ptr);
 	trigger_node_down(node_ptr);
-	last_node_update = time (NULL);
+	node_changed(node_ptr, time(NULL));
 	clusteracct_storage_g_node_down(acct_db_conn,
 					node_ptr, event_time, NULL,
 					node_ptr->reason_uid);
@@ -3150,9 +3400,10 @@ void make_node_idle(struct node_record *node_ptr,
 	trace_job(job_ptr, __func__, "enter");
 
 	xassert(node_ptr);
+	node_changed(node_ptr, now);
 	if (node_bitmap && (bit_test(node_bitmap, inx))) {
 		/* Not a replay */
-		last_job_update = now;
+		job_changed(job_ptr, now);
 		bit_clear(node_bitmap, inx);
 
 		job_update_cpu_cnt(job_ptr, inx);
@@ -3245,7 +3496,6 @@ void make_node_idle(struct node_record *node_ptr,
 			bit_set(idle_node_bitmap, inx);
 		node_ptr->last_idle = now;
 	}
-	last_node_update = now;
 }
 
 extern int send_nodes_to_accounting(time_t event_time)
@@ -3349,7 +3599,7 @@ extern void reset_node_load(char *node_name, uint32_t cpu_load)
 		time_t now = time(NULL);
 		node_ptr->cpu_load = cpu_load;
 		node_ptr->cpu_load_time = now;
-		last_node_update = now;
+		node_changed(node_ptr, now);
 	} else
 		error("is_node_resp unable to find node %s", node_name);
 #endif
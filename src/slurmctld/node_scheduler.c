@@ -593,6 +593,7 @@ extern void deallocate_nodes(struct job_record *job_ptr, bool timeout,
 	if ((agent_args->node_count - down_node_cnt) == 0) {
 		delete_step_records(job_ptr);
 		job_ptr->job_state &= (~JOB_COMPLETING);
+		notify_job_dependents(job_ptr);
 		slurm_sched_g_schedule();
 	}
 
@@ -1585,7 +1586,7 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 		     job_ptr->part_ptr, qos_ptr)) != SLURM_SUCCESS) {
 		xfree(job_ptr->state_desc);
 		job_ptr->state_reason = WAIT_QOS;
-		last_job_update = now;
+		job_changed(job_ptr, now);
 		return ESLURM_REQUESTED_PART_CONFIG_UNAVAILABLE;
 	}
 
@@ -1597,7 +1598,7 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 	    != SLURM_SUCCESS) {
 		xfree(job_ptr->state_desc);
 		job_ptr->state_reason = WAIT_ACCOUNT;
-		last_job_update = now;
+		job_changed(job_ptr, now);
 		return ESLURM_REQUESTED_PART_CONFIG_UNAVAILABLE;
 	}
 
@@ -1745,7 +1746,7 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 			       job_ptr->job_id);
 			job_ptr->state_reason = WAIT_PART_NODE_LIMIT;
 			xfree(job_ptr->state_desc);
-			last_job_update = now;
+			job_changed(job_ptr, now);
 
 		/* Non-fatal errors for job below */
 		} else if (error_code == ESLURM_NODE_NOT_AVAIL) {
@@ -1754,7 +1755,7 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 			       job_ptr->job_id);
 			job_ptr->state_reason = WAIT_NODE_NOT_AVAIL;
 			xfree(job_ptr->state_desc);
-			last_job_update = now;
+			job_changed(job_ptr, now);
 		} else if ((error_code == ESLURM_RESERVATION_NOT_USABLE) ||
 			   (error_code == ESLURM_RESERVATION_BUSY)) {
 			job_ptr->state_reason = WAIT_RESERVATION;
@@ -1835,12 +1836,14 @@ extern int select_nodes(struct job_record *job_ptr, bool test_only,
 	configuring = IS_JOB_CONFIGURING(job_ptr);
 
 	job_ptr->job_state = JOB_RUNNING;
+	notify_job_dependents(job_ptr);
 	if (nonstop_ops.job_begin)
 		(nonstop_ops.job_begin)(job_ptr);
 
 	if (configuring
 	    || bit_overlap(job_ptr->node_bitmap, power_node_bitmap))
 		job_ptr->job_state |= JOB_CONFIGURING;
+	queue_job_time_check(job_ptr);
 	/* Clear any vestigial GRES in case job was requeued */
 	gres_plugin_job_clear(job_ptr->gres_list);
 	if (select_g_select_nodeinfo_set(job_ptr) != SLURM_SUCCESS) {
@@ -2863,12 +2866,13 @@ extern void re_kill_job(struct job_record *job_ptr)
 					(node_ptr->comp_job_cnt)--;
 				if ((job_ptr->node_cnt > 0) &&
 				    ((--job_ptr->node_cnt) == 0)) {
-					last_node_update = time(NULL);
+					node_changed(node_ptr, time(NULL));
 					delete_step_records(job_ptr);
 					job_ptr->job_state &= (~JOB_COMPLETING);
+					notify_job_dependents(job_ptr);
 					slurm_sched_g_schedule();
 					batch_requeue_fini(job_ptr);
-					last_node_update = time(NULL);
+					node_changed(node_ptr, time(NULL));
 				}
 			}
 		} else if (!IS_NODE_NO_RESPOND(front_end_ptr)) {
@@ -2895,9 +2899,10 @@ extern void re_kill_job(struct job_record *job_ptr)
 			    ((--job_ptr->node_cnt) == 0)) {
 				delete_step_records(job_ptr);
 				job_ptr->job_state &= (~JOB_COMPLETING);
+				notify_job_dependents(job_ptr);
 				slurm_sched_g_schedule();
 				batch_requeue_fini(job_ptr);
-				last_node_update = time(NULL);
+				node_changed(node_ptr, time(NULL));
 			}
 		} else if (!IS_NODE_NO_RESPOND(node_ptr)) {
 			(void)hostlist_push_host(kill_hostlist, node_ptr->name);
@@ -103,10 +103,20 @@ static uint32_t *rpc_user_id = NULL;
 static uint32_t *rpc_user_cnt = NULL;
 static uint64_t *rpc_user_time = NULL;
 
+/* Latency histograms by RPC type and phase */
+#define RPC_PHASE_LOCK		0	/* waiting for slurmctld locks */
+#define RPC_PHASE_PROC		1	/* processing the request */
+#define RPC_PHASE_SEND		2	/* sending the response */
+#define RPC_PHASE_CNT		3
+static uint32_t *rpc_type_hist = NULL;	/* STAT_HIST_BUCKETS per type/phase */
+static uint32_t *rpc_type_max = NULL;	/* RPC_PHASE_CNT per type */
+
 static pthread_mutex_t throttle_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t throttle_cond = PTHREAD_COND_INITIALIZER;
 
 static void         _fill_ctld_conf(slurm_ctl_conf_t * build_ptr);
+static void         _record_rpc_latency(int rpc_type_index,
+					uint64_t *phase_usec);
 static void         _kill_job_on_msg_fail(uint32_t job_id);
 static int          _is_prolog_finished(uint32_t job_id);
 static int 	    _launch_batch_step(job_desc_msg_t *job_desc_msg,
@@ -157,6 +167,8 @@ inline static void  _slurm_rpc_block_info(slurm_msg_t * msg);
 inline static void  _slurm_rpc_job_alloc_info(slurm_msg_t * msg);
 inline static void  _slurm_rpc_job_alloc_info_lite(slurm_msg_t * msg);
 inline static void  _slurm_rpc_ping(slurm_msg_t * msg);
+inline static void  _slurm_rpc_ctld_session(slurm_msg_t * msg,
+					    connection_arg_t *arg);
 inline static void  _slurm_rpc_reboot_nodes(slurm_msg_t * msg);
 inline static void  _slurm_rpc_reconfigure_controller(slurm_msg_t * msg);
 inline static void  _slurm_rpc_resv_create(slurm_msg_t * msg);
@@ -200,6 +212,7 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 	DEF_TIMERS;
 	int i, rpc_type_index = -1, rpc_user_index = -1;
 	uint32_t rpc_uid;
+	uint64_t lock_usec, send_usec, phase_usec[RPC_PHASE_CNT];
 
 	/* Just to validate the cred */
 	rpc_uid = (uint32_t) g_slurm_auth_get_uid(msg->auth_cred, NULL);
@@ -216,6 +229,10 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 		rpc_type_id   = xmalloc(sizeof(uint16_t) * rpc_type_size);
 		rpc_type_cnt  = xmalloc(sizeof(uint32_t) * rpc_type_size);
 		rpc_type_time = xmalloc(sizeof(uint64_t) * rpc_type_size);
+		rpc_type_hist = xmalloc(sizeof(uint32_t) * rpc_type_size *
+					RPC_PHASE_CNT * STAT_HIST_BUCKETS);
+		rpc_type_max  = xmalloc(sizeof(uint32_t) * rpc_type_size *
+					RPC_PHASE_CNT);
 	}
 	for (i = 0; i < rpc_type_size; i++) {
 		if (rpc_type_id[i] == 0)
@@ -240,6 +257,8 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 		break;
 	}
 	slurm_mutex_unlock(&rpc_mutex);
+	lock_usec = get_lock_wait_time();
+	send_usec = slurm_get_send_time();
 
 	/* Debug the protocol layer.
 	 */
@@ -356,6 +375,10 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 		_slurm_rpc_ping(msg);
 		/* No body to free */
 		break;
+	case REQUEST_CTLD_SESSION:
+		_slurm_rpc_ctld_session(msg, arg);
+		/* No body to free */
+		break;
 	case REQUEST_RECONFIGURE:
 		_slurm_rpc_reconfigure_controller(msg);
 		/* No body to free */
@@ -541,10 +564,20 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 	}
 
 	END_TIMER;
+	phase_usec[RPC_PHASE_LOCK] = get_lock_wait_time() - lock_usec;
+	phase_usec[RPC_PHASE_SEND] = slurm_get_send_time() - send_usec;
+	if (DELTA_TIMER > (phase_usec[RPC_PHASE_LOCK] +
+			   phase_usec[RPC_PHASE_SEND])) {
+		phase_usec[RPC_PHASE_PROC] = DELTA_TIMER -
+					     phase_usec[RPC_PHASE_LOCK] -
+					     phase_usec[RPC_PHASE_SEND];
+	} else
+		phase_usec[RPC_PHASE_PROC] = 0;
 	slurm_mutex_lock(&rpc_mutex);
 	if (rpc_type_index >= 0) {
 		rpc_type_cnt[rpc_type_index]++;
 		rpc_type_time[rpc_type_index] += DELTA_TIMER;
+		_record_rpc_latency(rpc_type_index, phase_usec);
 	}
 	if (rpc_user_index >= 0) {
 		rpc_user_cnt[rpc_user_index]++;
@@ -553,6 +586,26 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 	slurm_mutex_unlock(&rpc_mutex);
 }
 
+/* Add one RPC's lock wait, processing and send times to the latency
+ * histograms for its type. rpc_mutex must be locked by the caller. */
+static void _record_rpc_latency(int rpc_type_index, uint64_t *phase_usec)
+{
+	uint32_t *hist;
+	int phase, inx;
+
+	for (phase = 0; phase < RPC_PHASE_CNT; phase++) {
+		inx = (rpc_type_index * RPC_PHASE_CNT) + phase;
+		hist = rpc_type_hist + (inx * STAT_HIST_BUCKETS);
+		hist[stat_hist_bucket(phase_usec[phase])]++;
+		if (phase_usec[phase] > rpc_type_max[inx]) {
+			if (phase_usec[phase] > NO_VAL)
+				rpc_type_max[inx] = NO_VAL;
+			else
+				rpc_type_max[inx] = phase_usec[phase];
+		}
+	}
+}
+
 /* These functions prevent certain RPCs from keeping the slurmctld write locks
  * constantly set, which can prevent other RPCs and system functions from being
  * processed. For example, a steady stream of batch submissions can prevent
@@ -1155,8 +1208,7 @@ static void _slurm_rpc_dump_conf(slurm_msg_t * msg)
 static void _slurm_rpc_dump_jobs(slurm_msg_t * msg)
 {
 	DEF_TIMERS;
-	char *dump;
-	int dump_size;
+	BufChain dump;
 	slurm_msg_t response_msg;
 	job_info_request_msg_t *job_info_request_msg =
 		(job_info_request_msg_t *) msg->data;
@@ -1174,14 +1226,16 @@ static void _slurm_rpc_dump_jobs(slurm_msg_t * msg)
 		debug3("_slurm_rpc_dump_jobs, no change");
 		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
 	} else {
-		pack_all_jobs(&dump, &dump_size,
-			      job_info_request_msg->show_flags,
+		pack_all_jobs(&dump, job_info_request_msg->show_flags,
 			      g_slurm_auth_get_uid(msg->auth_cred, NULL),
-			      NO_VAL, msg->protocol_version);
+			      NO_VAL, job_info_request_msg->filter,
+			      job_info_request_msg->last_update,
+			      msg->protocol_version);
 		unlock_slurmctld(job_read_lock);
 		END_TIMER2("_slurm_rpc_dump_jobs");
 #if 0
-		info("_slurm_rpc_dump_jobs, size=%d %s", dump_size, TIME_STR);
+		info("_slurm_rpc_dump_jobs, size=%u %s", size_buf_chain(dump),
+		     TIME_STR);
 #endif
 
 		/* init response_msg structure */
@@ -1190,12 +1244,11 @@ static void _slurm_rpc_dump_jobs(slurm_msg_t * msg)
 		response_msg.protocol_version = msg->protocol_version;
 		response_msg.address = msg->address;
 		response_msg.msg_type = RESPONSE_JOB_INFO;
-		response_msg.data = dump;
-		response_msg.data_size = dump_size;
+		response_msg.data_chain = dump;
 
 		/* send message */
 		slurm_send_node_msg(msg->conn_fd, &response_msg);
-		xfree(dump);
+		free_buf_chain(dump);
 	}
 }
 
@@ -1203,8 +1256,7 @@ static void _slurm_rpc_dump_jobs(slurm_msg_t * msg)
 static void _slurm_rpc_dump_jobs_user(slurm_msg_t * msg)
 {
 	DEF_TIMERS;
-	char *dump;
-	int dump_size;
+	BufChain dump;
 	slurm_msg_t response_msg;
 	job_user_id_msg_t *job_info_request_msg =
 		(job_user_id_msg_t *) msg->data;
@@ -1216,14 +1268,15 @@ static void _slurm_rpc_dump_jobs_user(slurm_msg_t * msg)
 	START_TIMER;
 	debug3("Processing RPC: REQUEST_JOB_USER_INFO from uid=%d", uid);
 	lock_slurmctld(job_read_lock);
-	pack_all_jobs(&dump, &dump_size,
-		      job_info_request_msg->show_flags,
+	pack_all_jobs(&dump, job_info_request_msg->show_flags,
 		      g_slurm_auth_get_uid(msg->auth_cred, NULL),
-		      job_info_request_msg->user_id, msg->protocol_version);
+		      job_info_request_msg->user_id, NULL, (time_t) 0,
+		      msg->protocol_version);
 	unlock_slurmctld(job_read_lock);
 	END_TIMER2("_slurm_rpc_dump_job_user");
 #if 0
-	info("_slurm_rpc_dump_user_jobs, size=%d %s", dump_size, TIME_STR);
+	info("_slurm_rpc_dump_user_jobs, size=%u %s", size_buf_chain(dump),
+	     TIME_STR);
 #endif
 
 	/* init response_msg structure */
@@ -1232,20 +1285,19 @@ static void _slurm_rpc_dump_jobs_user(slurm_msg_t * msg)
 	response_msg.protocol_version = msg->protocol_version;
 	response_msg.address = msg->address;
 	response_msg.msg_type = RESPONSE_JOB_INFO;
-	response_msg.data = dump;
-	response_msg.data_size = dump_size;
+	response_msg.data_chain = dump;
 
 	/* send message */
 	slurm_send_node_msg(msg->conn_fd, &response_msg);
-	xfree(dump);
+	free_buf_chain(dump);
 }
 
 /* _slurm_rpc_dump_job_single - process RPC for one job's state information */
 static void _slurm_rpc_dump_job_single(slurm_msg_t * msg)
 {
 	DEF_TIMERS;
-	char *dump = NULL;
-	int dump_size, rc;
+	BufChain dump = NULL;
+	int rc;
 	slurm_msg_t response_msg;
 	job_id_msg_t *job_id_msg = (job_id_msg_t *) msg->data;
 	/* Locks: Read config, job, and node info */
@@ -1257,14 +1309,15 @@ static void _slurm_rpc_dump_job_single(slurm_msg_t * msg)
 	debug3("Processing RPC: REQUEST_JOB_INFO_SINGLE from uid=%d", uid);
 	lock_slurmctld(job_read_lock);
 
-	rc = pack_one_job(&dump, &dump_size, job_id_msg->job_id,
+	rc = pack_one_job(&dump, job_id_msg->job_id,
 			  job_id_msg->show_flags,
 			  g_slurm_auth_get_uid(msg->auth_cred, NULL),
 			  msg->protocol_version);
 	unlock_slurmctld(job_read_lock);
 	END_TIMER2("_slurm_rpc_dump_job_single");
 #if 0
-	info("_slurm_rpc_dump_job_single, size=%d %s", dump_size, TIME_STR);
+	info("_slurm_rpc_dump_job_single, size=%u %s",
+	     dump ? size_buf_chain(dump) : 0, TIME_STR);
 #endif
 
 	/* init response_msg structure */
@@ -1276,11 +1329,11 @@ static void _slurm_rpc_dump_job_single(slurm_msg_t * msg)
 		response_msg.protocol_version = msg->protocol_version;
 		response_msg.address = msg->address;
 		response_msg.msg_type = RESPONSE_JOB_INFO;
-		response_msg.data = dump;
-		response_msg.data_size = dump_size;
+		response_msg.data_chain = dump;
 		slurm_send_node_msg(msg->conn_fd, &response_msg);
 	}
-	xfree(dump);
+	if (dump)
+		free_buf_chain(dump);
 }
 
 static void  _slurm_rpc_get_shares(slurm_msg_t *msg)
@@ -1429,9 +1482,9 @@ static void _slurm_rpc_dump_nodes(slurm_msg_t * msg)
 	node_info_request_msg_t *node_req_msg =
 		(node_info_request_msg_t *) msg->data;
 	/* Locks: Read config, write node (reset allocated CPU count in some
-	 * select plugins) */
+	 * select plugins), read partition (for filtering) */
 	slurmctld_lock_t node_write_lock = {
-		READ_LOCK, NO_LOCK, WRITE_LOCK, NO_LOCK };
+		READ_LOCK, NO_LOCK, WRITE_LOCK, READ_LOCK };
 	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
 
 	START_TIMER;
@@ -1455,7 +1508,8 @@ static void _slurm_rpc_dump_nodes(slurm_msg_t * msg)
 		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
 	} else {
 		pack_all_node(&dump, &dump_size, node_req_msg->show_flags,
-			      uid, msg->protocol_version);
+			      uid, node_req_msg->filter,
+			      node_req_msg->last_update, msg->protocol_version);
 		unlock_slurmctld(node_write_lock);
 		END_TIMER2("_slurm_rpc_dump_nodes");
 #if 0
@@ -2725,6 +2779,36 @@ static void _slurm_rpc_ping(slurm_msg_t * msg)
 	slurm_send_rc_msg(msg, SLURM_SUCCESS);
 }
 
+/* _slurm_rpc_ctld_session - process RPC to keep the connection open as a
+ *	session. Its later requests carry no auth credential and are
+ *	processed as coming from the user who opened it. The connection is
+ *	returned to _slurmctld_rpc_mgr() after each request. */
+static void _slurm_rpc_ctld_session(slurm_msg_t * msg, connection_arg_t *arg)
+{
+	int rc = SLURM_SUCCESS;
+	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred, NULL);
+
+	slurm_mutex_lock(&slurmctld_config.thread_count_lock);
+	if (arg->session_cred)
+		rc = ESLURM_NOT_SUPPORTED;	/* already a session */
+	else if (slurmctld_config.session_count >= MAX_CTLD_SESSIONS)
+		rc = EAGAIN;
+	else
+		slurmctld_config.session_count++;
+	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
+
+	if (rc == SLURM_SUCCESS) {
+		debug2("Processing RPC: REQUEST_CTLD_SESSION from uid=%d on "
+		       "fd %d", uid, arg->newsockfd);
+		/* released by the controller when the session ends */
+		arg->session_cred = msg->auth_cred;
+	} else {
+		debug("REQUEST_CTLD_SESSION from uid=%d: %s",
+		      uid, slurm_strerror(rc));
+	}
+	slurm_send_rc_msg(msg, rc);
+}
+
 
 /* _slurm_rpc_reconfigure_controller - process RPC to re-initialize
  *	slurmctld from configuration file
@@ -4860,6 +4944,12 @@ static void _clear_rpc_stats(void)
 		rpc_type_id[i] = 0;
 		rpc_type_time[i] = 0;
 	}
+	if (rpc_type_size) {
+		memset(rpc_type_hist, 0, sizeof(uint32_t) * rpc_type_size *
+					 RPC_PHASE_CNT * STAT_HIST_BUCKETS);
+		memset(rpc_type_max, 0, sizeof(uint32_t) * rpc_type_size *
+					RPC_PHASE_CNT);
+	}
 	for (i = 0; i < rpc_user_size; i++) {
 		rpc_user_cnt[i] = 0;
 		rpc_user_id[i] = 0;
@@ -4868,10 +4958,40 @@ static void _clear_rpc_stats(void)
 	slurm_mutex_unlock(&rpc_mutex);
 }
 
+/* Pack the p50, p99 and p999 latencies plus the maximum latency of each
+ * phase for the first type_cnt RPC types */
+static void _pack_rpc_latency(uint32_t type_cnt, Buf buffer)
+{
+	uint32_t inx, lat_cnt = type_cnt * RPC_PHASE_CNT;
+	uint32_t *p50, *p99, *p999;
+	uint32_t *hist;
+
+	p50  = xmalloc(sizeof(uint32_t) * (lat_cnt + 1));
+	p99  = xmalloc(sizeof(uint32_t) * (lat_cnt + 1));
+	p999 = xmalloc(sizeof(uint32_t) * (lat_cnt + 1));
+	for (inx = 0; inx < lat_cnt; inx++) {
+		hist = rpc_type_hist + (inx * STAT_HIST_BUCKETS);
+		p50[inx]  = stat_hist_percentile(hist, rpc_type_max[inx], 500);
+		p99[inx]  = stat_hist_percentile(hist, rpc_type_max[inx], 990);
+		p999[inx] = stat_hist_percentile(hist, rpc_type_max[inx], 999);
+	}
+
+	pack32(type_cnt, buffer);
+	pack16_array(rpc_type_id, type_cnt, buffer);
+	pack32(RPC_PHASE_CNT, buffer);
+	pack32_array(p50,  lat_cnt, buffer);
+	pack32_array(p99,  lat_cnt, buffer);
+	pack32_array(p999, lat_cnt, buffer);
+	pack32_array(rpc_type_max, lat_cnt, buffer);
+	xfree(p50);
+	xfree(p99);
+	xfree(p999);
+}
+
 static void _pack_rpc_stats(int resp, char **buffer_ptr, int *buffer_size,
 			    uint16_t protocol_version)
 {
-	uint32_t i;
+	uint32_t i, type_cnt;
 	Buf buffer;
 
 	if (protocol_version < SLURM_14_11_PROTOCOL_VERSION)
@@ -4884,6 +5004,7 @@ static void _pack_rpc_stats(int resp, char **buffer_ptr, int *buffer_size,
 		if (rpc_type_id[i] == 0)
 			break;
 	}
+	type_cnt = i;
 	pack32(i, buffer);
 	pack16_array(rpc_type_id,   i, buffer);
 	pack32_array(rpc_type_cnt,  i, buffer);
@@ -4897,6 +5018,9 @@ static void _pack_rpc_stats(int resp, char **buffer_ptr, int *buffer_size,
 	pack32_array(rpc_user_id,   i, buffer);
 	pack32_array(rpc_user_cnt,  i, buffer);
 	pack64_array(rpc_user_time, i, buffer);
+
+	if (protocol_version >= SLURM_15_08_PROTOCOL_VERSION)
+		_pack_rpc_latency(type_cnt, buffer);
 	slurm_mutex_unlock(&rpc_mutex);
 
 	*buffer_size = get_buf_offset(buffer);
@@ -4921,10 +5045,23 @@ inline static void _slurm_rpc_dump_stats(slurm_msg_t * msg)
 		slurm_send_rc_msg(msg, ESLURM_ACCESS_DENIED);
 		return;
 	}
+	if ((request_msg->command_id == STAT_COMMAND_LOG_LOCKS) &&
+	    !validate_slurm_user(uid)) {
+		error("Security violation: REQUEST_STATS_INFO log locks "
+		      "from uid=%d", uid);
+		slurm_send_rc_msg(msg, ESLURM_ACCESS_DENIED);
+		return;
+	}
 
 	debug2("Processing RPC: REQUEST_STATS_INFO (command: %u)",
 	       request_msg->command_id);
 
+	if (request_msg->command_id == STAT_COMMAND_LOG_LOCKS) {
+		log_lock_stats();
+		slurm_send_rc_msg(msg, SLURM_SUCCESS);
+		return;
+	}
+
 	slurm_msg_t_init(&response_msg);
 	response_msg.protocol_version = msg->protocol_version;
 	response_msg.address = msg->address;
@@ -5008,6 +5145,8 @@ extern void free_rpc_stats(void)
 	xfree(rpc_type_cnt);
 	xfree(rpc_type_id);
 	xfree(rpc_type_time);
+	xfree(rpc_type_hist);
+	xfree(rpc_type_max);
 	rpc_type_size = 0;
 
 	xfree(rpc_user_cnt);
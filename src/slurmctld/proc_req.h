@@ -49,6 +49,10 @@
 typedef struct connection_arg {
 	int newsockfd;
 	slurm_addr_t cli_addr;
+	void *session_cred;	/* auth credential of a connection kept open
+				 * by REQUEST_CTLD_SESSION, NULL otherwise */
+	void *session;		/* the session of a request read from such a
+				 * connection, see controller.c */
 } connection_arg_t;
 
 /* Free memory used to track RPC usage by type and user */
@@ -99,6 +99,8 @@ static void _acct_restore_active_jobs(void);
 static int  _build_bitmaps(void);
 static void _build_bitmaps_pre_select(void);
 static void _gres_reconfig(bool reconfig);
+static void _log_phase_time(struct timeval *phase_tv, char *phase,
+			    bool reconfig);
 static int  _init_all_slurm_conf(void);
 static int  _preserve_select_type_param(slurm_ctl_conf_t * ctl_conf_ptr,
 					uint16_t old_select_type_p);
@@ -858,9 +860,11 @@ int read_slurm_conf(int recover, bool reconfig)
 	char *state_save_dir      = xstrdup(slurmctld_conf.state_save_location);
 	char *mpi_params;
 	uint16_t old_select_type_p = slurmctld_conf.select_type_param;
+	struct timeval phase_tv;
 
 	/* initialization */
 	START_TIMER;
+	gettimeofday(&phase_tv, NULL);
 
 	if (reconfig) {
 		/* in order to re-use job state information,
@@ -972,6 +976,7 @@ int read_slurm_conf(int recover, bool reconfig)
 	 */
 	if (!reconfig && (slurm_layouts_load_config() != SLURM_SUCCESS))
 		fatal("Failed to load the layouts framework configuration");
+	_log_phase_time(&phase_tv, "configuration", reconfig);
 
 	if (reconfig) {		/* Preserve state from memory */
 		if (old_node_table_ptr) {
@@ -998,6 +1003,7 @@ int read_slurm_conf(int recover, bool reconfig)
 		load_last_job_id();
 		reset_first_job_id();
 		(void) slurm_sched_g_reconfig();
+		_log_phase_time(&phase_tv, "state restore", reconfig);
 	} else if (recover == 0) {	/* Build everything from slurm.conf */
 		load_last_job_id();
 		reset_first_job_id();
@@ -1005,14 +1011,19 @@ int read_slurm_conf(int recover, bool reconfig)
 	} else if (recover == 1) {	/* Load job & node state files */
 		(void) load_all_node_state(true);
 		(void) load_all_front_end_state(true);
+		_log_phase_time(&phase_tv, "node state", reconfig);
 		load_job_ret = load_all_job_state();
 		sync_job_priorities();
+		_log_phase_time(&phase_tv, "job state", reconfig);
 	} else if (recover > 1) {	/* Load node, part & job state files */
 		(void) load_all_node_state(false);
 		(void) load_all_front_end_state(false);
+		_log_phase_time(&phase_tv, "node state", reconfig);
 		(void) load_all_part_state();
+		_log_phase_time(&phase_tv, "partition state", reconfig);
 		load_job_ret = load_all_job_state();
 		sync_job_priorities();
+		_log_phase_time(&phase_tv, "job state", reconfig);
 	}
 
 	_sync_part_prio();
@@ -1028,6 +1039,7 @@ int read_slurm_conf(int recover, bool reconfig)
 	xfree(state_save_dir);
 	_gres_reconfig(reconfig);
 	reset_job_bitmaps();		/* must follow select_g_job_init() */
+	_log_phase_time(&phase_tv, "select plugin", reconfig);
 
 	(void) _sync_nodes_to_jobs();
 	(void) sync_job_files();
@@ -1051,6 +1063,7 @@ int read_slurm_conf(int recover, bool reconfig)
 #endif
 	(void) _sync_nodes_to_comp_job();/* must follow select_g_node_init() */
 	load_part_uid_allow_list(1);
+	_log_phase_time(&phase_tv, "job and node sync", reconfig);
 
 	if (reconfig) {
 		load_all_resv_state(0);
@@ -1061,6 +1074,7 @@ int read_slurm_conf(int recover, bool reconfig)
 			(void) slurm_sched_g_reconfig();
 		}
 	}
+	_log_phase_time(&phase_tv, "reservation and trigger state", reconfig);
 
 	/* sort config_list by weight for scheduling */
 	list_sort(config_list, &list_compare_config);
@@ -1098,12 +1112,32 @@ int read_slurm_conf(int recover, bool reconfig)
 
 	/* Sync select plugin with synchronized job/node/part data */
 	select_g_reconfigure();
+	_log_phase_time(&phase_tv, "plugin update", reconfig);
 
 	slurmctld_conf.last_update = time(NULL);
 	END_TIMER2("read_slurm_conf");
 	return error_code;
 }
 
+/* Log the time spent in a phase of read_slurm_conf() so that changes in
+ * slurmctld start up time can be tracked, then start timing the next phase */
+static void _log_phase_time(struct timeval *phase_tv, char *phase,
+			    bool reconfig)
+{
+	struct timeval now;
+	char tv_str[20] = "";
+	long delta_t;
+
+	gettimeofday(&now, NULL);
+	slurm_diff_tv_str(phase_tv, &now, tv_str, sizeof(tv_str), NULL, 0,
+			  &delta_t);
+	if (reconfig)
+		debug("read_slurm_conf: %s phase %s", phase, tv_str);
+	else
+		info("read_slurm_conf: %s phase %s", phase, tv_str);
+	*phase_tv = now;
+}
+
 static void _gres_reconfig(bool reconfig)
 {
 	struct node_record *node_ptr;
@@ -141,6 +141,7 @@ static int  _post_resv_create(slurmctld_resv_t *resv_ptr);
 static int  _post_resv_delete(slurmctld_resv_t *resv_ptr);
 static int  _post_resv_update(slurmctld_resv_t *resv_ptr,
 			      slurmctld_resv_t *old_resv_ptr);
+static void _queue_resv_job_time_check(slurmctld_resv_t *resv_ptr);
 static int  _resize_resv(slurmctld_resv_t *resv_ptr, uint32_t node_cnt);
 static void _restore_resv(slurmctld_resv_t *dest_resv,
 			  slurmctld_resv_t *src_resv);
@@ -221,8 +222,8 @@ static slurmctld_resv_t *_copy_resv(slurmctld_resv_t *resv_orig_ptr)
 	}
 	resv_copy_ptr->assoc_list = xstrdup(resv_orig_ptr->assoc_list);
 	if (resv_orig_ptr->core_bitmap) {
-		resv_copy_ptr->core_bitmap = bit_copy(resv_orig_ptr->
-						      core_bitmap);
+		resv_copy_ptr->core_bitmap = bit_rle_copy(resv_orig_ptr->
+							  core_bitmap);
 	}
 	resv_copy_ptr->cpu_cnt = resv_orig_ptr->cpu_cnt;
 	resv_copy_ptr->duration = resv_orig_ptr->duration;
@@ -285,7 +286,7 @@ static void _restore_resv(slurmctld_resv_t *dest_resv,
 	dest_resv->assoc_list = src_resv->assoc_list;
 	src_resv->assoc_list = NULL;
 
-	FREE_NULL_BITMAP(dest_resv->core_bitmap);
+	FREE_NULL_BITRLE(dest_resv->core_bitmap);
 	dest_resv->core_bitmap = src_resv->core_bitmap;
 	src_resv->core_bitmap = NULL;
 
@@ -361,7 +362,7 @@ static void _del_resv_rec(void *x)
 			xfree(resv_ptr->account_list[i]);
 		xfree(resv_ptr->account_list);
 		xfree(resv_ptr->assoc_list);
-		FREE_NULL_BITMAP(resv_ptr->core_bitmap);
+		FREE_NULL_BITRLE(resv_ptr->core_bitmap);
 		xfree(resv_ptr->features);
 		if (resv_ptr->license_list)
 			list_destroy(resv_ptr->license_list);
@@ -1361,12 +1362,16 @@ static void _pack_resv(slurmctld_resv_t *resv_ptr, Buf buffer,
 
 		if (internal) {
 			uint32_t core_cnt = 0;
+			char *core_str = NULL;
 			pack8(resv_ptr->account_not,	buffer);
 			packstr(resv_ptr->assoc_list,	buffer);
-			if (resv_ptr->core_bitmap)
-				core_cnt = bit_size(resv_ptr->core_bitmap);
+			if (resv_ptr->core_bitmap) {
+				core_cnt = bit_rle_size(resv_ptr->core_bitmap);
+				core_str = bit_rle_fmt(resv_ptr->core_bitmap);
+			}
 			pack32(core_cnt,		buffer);
-			pack_bit_fmt(resv_ptr->core_bitmap, buffer);
+			packstr(core_str,		buffer);
+			xfree(core_str);
 			pack32(resv_ptr->duration,	buffer);
 			pack8(resv_ptr->full_nodes,	buffer);
 			pack32(resv_ptr->resv_id,	buffer);
@@ -1420,8 +1425,14 @@ slurmctld_resv_t *_load_reservation_state(Buf buffer,
 			     resv_ptr->name);
 #endif
 		} else {
-			resv_ptr->core_bitmap = bit_alloc(core_cnt);
-			bit_unfmt(resv_ptr->core_bitmap, core_inx_str);
+			resv_ptr->core_bitmap = bit_rle_unfmt(core_cnt,
+							      core_inx_str);
+			if (resv_ptr->core_bitmap == NULL) {
+				error("Reservation %s has invalid core_bitmap "
+				      "%s", resv_ptr->name, core_inx_str);
+				xfree(core_inx_str);
+				goto unpack_error;
+			}
 			info("Reservation %s has core_bitmap %s on node %s",
 			     resv_ptr->name, core_inx_str,
 			     resv_ptr->node_list);
@@ -1959,7 +1970,10 @@ extern int create_resv(resv_desc_msg_t *resv_desc_ptr)
 	resv_ptr->node_list	= resv_desc_ptr->node_list;
 	resv_desc_ptr->node_list = NULL;	/* Nothing left to free */
 	resv_ptr->node_bitmap	= node_bitmap;	/* May be unset */
-	resv_ptr->core_bitmap	= core_bitmap;	/* May be unset */
+	if (core_bitmap) {			/* May be unset */
+		resv_ptr->core_bitmap = bit_rle_from_bitstr(core_bitmap);
+		FREE_NULL_BITMAP(core_bitmap);
+	}
 	resv_ptr->partition	= resv_desc_ptr->partition;
 	resv_desc_ptr->partition = NULL;	/* Nothing left to free */
 	resv_ptr->part_ptr	= part_ptr;
@@ -1980,7 +1994,7 @@ extern int create_resv(resv_desc_msg_t *resv_desc_ptr)
 		_set_cpu_cnt(resv_ptr);
 		resv_ptr->full_nodes = 1;
 	} else {
-		resv_ptr->cpu_cnt = bit_set_count(resv_ptr->core_bitmap);
+		resv_ptr->cpu_cnt = bit_rle_set_count(resv_ptr->core_bitmap);
 #if _DEBUG
 		info("reservation using partial nodes: core count %u",
 		     resv_ptr->cpu_cnt);
@@ -2255,7 +2269,7 @@ extern int update_resv(resv_desc_msg_t *resv_desc_ptr)
 		xfree(resv_desc_ptr->node_list);
 		xfree(resv_ptr->node_list);
 		FREE_NULL_BITMAP(resv_ptr->node_bitmap);
-		FREE_NULL_BITMAP(resv_ptr->core_bitmap);
+		FREE_NULL_BITRLE(resv_ptr->core_bitmap);
 		resv_ptr->node_bitmap = bit_alloc(node_record_count);
 		if ((resv_desc_ptr->node_cnt == NULL) ||
 		    (resv_desc_ptr->node_cnt[0] == 0)) {
@@ -2297,7 +2311,7 @@ extern int update_resv(resv_desc_msg_t *resv_desc_ptr)
 		}
 		resv_desc_ptr->node_list = NULL;  /* Nothing left to free */
 		FREE_NULL_BITMAP(resv_ptr->node_bitmap);
-		FREE_NULL_BITMAP(resv_ptr->core_bitmap);
+		FREE_NULL_BITRLE(resv_ptr->core_bitmap);
 		resv_ptr->node_bitmap = node_bitmap;
 		resv_ptr->node_cnt = bit_set_count(resv_ptr->node_bitmap);
 	}
@@ -2366,6 +2380,8 @@ extern int update_resv(resv_desc_msg_t *resv_desc_ptr)
 	     resv_ptr->name, name1, val1, name2, val2,
 	     resv_ptr->node_list, resv_ptr->licenses, start_time, end_time);
 
+	if (resv_ptr->end_time < resv_backup->end_time)
+		_queue_resv_job_time_check(resv_ptr);
 	_post_resv_update(resv_ptr, resv_backup);
 	_del_resv_rec(resv_backup);
 	(void) set_node_maint_mode(true);
@@ -2400,6 +2416,21 @@ static bool _is_resv_used(slurmctld_resv_t *resv_ptr)
 	return match;
 }
 
+/* Queue the running jobs of a reservation which now ends earlier to be
+ * tested by job_time_limit() at its new end time */
+static void _queue_resv_job_time_check(slurmctld_resv_t *resv_ptr)
+{
+	ListIterator job_iterator;
+	struct job_record *job_ptr;
+
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = (struct job_record *) list_next(job_iterator))) {
+		if (job_ptr->resv_ptr == resv_ptr)
+			queue_job_time_check(job_ptr);
+	}
+	list_iterator_destroy(job_iterator);
+}
+
 /* Clear the reservation points for jobs referencing a defunct reservation */
 static void _clear_job_resv(slurmctld_resv_t *resv_ptr)
 {
@@ -2912,8 +2943,10 @@ static void _validate_node_choice(slurmctld_resv_t *resv_ptr)
 		bit_and(resv_ptr->node_bitmap, avail_node_bitmap);
 		bit_or(resv_ptr->node_bitmap, tmp_bitmap);
 		FREE_NULL_BITMAP(tmp_bitmap);
-		FREE_NULL_BITMAP(resv_ptr->core_bitmap);
-		resv_ptr->core_bitmap = core_bitmap;
+		FREE_NULL_BITRLE(resv_ptr->core_bitmap);
+		resv_ptr->core_bitmap = core_bitmap ?
+					bit_rle_from_bitstr(core_bitmap) : NULL;
+		FREE_NULL_BITMAP(core_bitmap);
 		xfree(resv_ptr->node_list);
 		resv_ptr->node_list = bitmap2node_name(resv_ptr->node_bitmap);
 		info("modified reservation %s due to unusable nodes, "
@@ -3169,8 +3202,10 @@ static int  _resize_resv(slurmctld_resv_t *resv_ptr, uint32_t node_cnt)
 	if (i == SLURM_SUCCESS) {
 		bit_or(resv_ptr->node_bitmap, tmp1_bitmap);
 		FREE_NULL_BITMAP(tmp1_bitmap);
-		FREE_NULL_BITMAP(resv_ptr->core_bitmap);
-		resv_ptr->core_bitmap = core_bitmap;
+		FREE_NULL_BITRLE(resv_ptr->core_bitmap);
+		resv_ptr->core_bitmap = core_bitmap ?
+					bit_rle_from_bitstr(core_bitmap) : NULL;
+		FREE_NULL_BITMAP(core_bitmap);
 		xfree(resv_ptr->node_list);
 		resv_ptr->node_list = bitmap2node_name(resv_ptr->node_bitmap);
 		resv_ptr->node_cnt = node_cnt;
@@ -3259,7 +3294,7 @@ static int  _select_nodes(resv_desc_msg_t *resv_desc_ptr,
 					*core_bitmap =
 						cr_create_cluster_core_bitmap(
 							core_mult);
-				bit_or(*core_bitmap, resv_ptr->core_bitmap);
+				bit_rle_or(*core_bitmap, resv_ptr->core_bitmap);
 			}
 		}
 		list_iterator_destroy(iter);
@@ -4028,7 +4063,8 @@ extern int job_test_resv(struct job_record *job_ptr, time_t *when,
 		/* if reservation is using just partial nodes, this returns
 		 * coremap to exclude */
 		if (resv_ptr->core_bitmap && exc_core_bitmap) {
-			*exc_core_bitmap = bit_copy(resv_ptr->core_bitmap);
+			*exc_core_bitmap =
+				bit_rle_to_bitstr(resv_ptr->core_bitmap);
 			bit_not(*exc_core_bitmap);
 		}
 
@@ -4124,11 +4160,11 @@ extern int job_test_resv(struct job_record *job_ptr, time_t *when,
 				     "partial nodes", resv_ptr->name);
 #endif
 				if (*exc_core_bitmap == NULL) {
-					*exc_core_bitmap =
-						bit_copy(resv_ptr->core_bitmap);
+					*exc_core_bitmap = bit_rle_to_bitstr(
+						resv_ptr->core_bitmap);
 				} else {
-					bit_or(*exc_core_bitmap,
-					       resv_ptr->core_bitmap);
+					bit_rle_or(*exc_core_bitmap,
+						   resv_ptr->core_bitmap);
 				}
 			}
 		}
@@ -4599,6 +4635,7 @@ static void _set_nodes_flags(slurmctld_resv_t *resv_ptr, time_t now,
 			node_ptr->node_state |= flags;
 		else
 			node_ptr->node_state &= (~flags);
+		node_changed(node_ptr, now);
 		/* mark that this node is now down and in maint mode
 		 * or was removed from maint mode */
 		if (IS_NODE_DOWN(node_ptr) || IS_NODE_DRAIN(node_ptr) ||
@@ -0,0 +1,367 @@
+/*****************************************************************************\
+ *  rpc_queue.c - Prioritized queue and worker thread pool for slurmctld RPCs
+ *****************************************************************************
+ *  Copyright (C) 2015 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#if HAVE_SYS_PRCTL_H
+#  include <sys/prctl.h>
+#endif
+
+#ifdef WITH_PTHREADS
+#  include <pthread.h>
+#endif				/* WITH_PTHREADS */
+
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmctld/rpc_queue.h"
+#include "src/slurmctld/slurmctld.h"
+
+/* An RPC queued for longer than this many microseconds is serviced ahead of
+ * higher priority RPCs so that no class can be starved indefinitely */
+#ifndef RPC_QUEUE_MAX_WAIT
+#define RPC_QUEUE_MAX_WAIT 1000000
+#endif
+
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  queue_cond  = PTHREAD_COND_INITIALIZER;
+static List queue[RPC_PRIO_CNT];
+static int queue_cnt = 0;		/* RPCs currently queued */
+static int queue_limit = 0;		/* configured queue depth */
+static int busy_cnt[RPC_PRIO_CNT];	/* workers busy per class */
+static int busy_limit = 0;		/* maximum busy workers per class */
+static int worker_cnt = 0;
+static pthread_t *worker_tid = NULL;
+static bool queue_shutdown = false;
+static void (*rpc_handler)(rpc_queue_rec_t *rec) = NULL;
+
+/* Statistics, protected by queue_mutex */
+static uint32_t stat_depth_max = 0;
+static uint32_t stat_cnt[RPC_PRIO_CNT];
+static uint64_t stat_wait_sum[RPC_PRIO_CNT];
+static uint32_t stat_wait_max[RPC_PRIO_CNT];
+
+/* Determine the priority class of an RPC from its message type */
+static int _rpc_prio(uint16_t msg_type)
+{
+	switch (msg_type) {
+	/* Requests which release resources or report state from slurmd
+	 * and slurmstepd, plus controller management */
+	case MESSAGE_EPILOG_COMPLETE:
+	case MESSAGE_NODE_REGISTRATION_STATUS:
+	case REQUEST_COMPLETE_BATCH_JOB:
+	case REQUEST_COMPLETE_BATCH_SCRIPT:
+	case REQUEST_COMPLETE_JOB_ALLOCATION:
+	case REQUEST_COMPLETE_PROLOG:
+	case REQUEST_STEP_COMPLETE:
+	case REQUEST_CONTROL:
+	case REQUEST_SHUTDOWN:
+	case REQUEST_SHUTDOWN_IMMEDIATE:
+	case REQUEST_TAKEOVER:
+	case REQUEST_PING:
+	case ACCOUNTING_UPDATE_MSG:
+	case ACCOUNTING_FIRST_REG:
+	case ACCOUNTING_REGISTER_CTLD:
+		return RPC_PRIO_HIGH;
+	/* Read-only information requests, typically from polling clients */
+	case REQUEST_BLOCK_INFO:
+	case REQUEST_BUILD_INFO:
+	case REQUEST_FRONT_END_INFO:
+	case REQUEST_JOB_INFO:
+	case REQUEST_JOB_INFO_SINGLE:
+	case REQUEST_JOB_STEP_INFO:
+	case REQUEST_JOB_USER_INFO:
+	case REQUEST_LICENSE_INFO:
+	case REQUEST_NODE_INFO:
+	case REQUEST_NODE_INFO_SINGLE:
+	case REQUEST_PARTITION_INFO:
+	case REQUEST_PRIORITY_FACTORS:
+	case REQUEST_RESERVATION_INFO:
+	case REQUEST_SHARE_INFO:
+	case REQUEST_TOPO_INFO:
+	case REQUEST_TRIGGER_GET:
+		return RPC_PRIO_LOW;
+	default:
+		return RPC_PRIO_NORMAL;
+	}
+}
+
+/* Read the message type from a received message's header without
+ * consuming the data */
+static uint16_t _peek_msg_type(char *buf, size_t buflen)
+{
+	uint16_t version, flags, msg_type = 0;
+	Buf buffer;
+
+	if (!(buffer = create_buf(buf, buflen)))
+		return msg_type;
+	if (unpack16(&version, buffer) ||
+	    unpack16(&flags, buffer) ||
+	    unpack16(&msg_type, buffer))
+		msg_type = 0;
+	(void) xfer_buf_data(buffer);	/* release Buf, not the data */
+
+	return msg_type;
+}
+
+static uint32_t _wait_usec(struct timeval *start, struct timeval *now)
+{
+	int64_t delta;
+
+	delta  = (int64_t) (now->tv_sec - start->tv_sec) * 1000000;
+	delta += now->tv_usec - start->tv_usec;
+	if (delta < 0)
+		return 0;
+	if (delta > 0xffffffff)
+		return 0xffffffff;
+	return (uint32_t) delta;
+}
+
+/* Select the class of the next RPC to process. This is the highest priority
+ * class with work, unless an RPC of another class has waited longer than
+ * RPC_QUEUE_MAX_WAIT. Classes which already occupy busy_limit workers are
+ * skipped so that a burst of one type of RPC (e.g. serialized job
+ * submissions) can not monopolize all workers.
+ * Call with queue_mutex locked.
+ * RET class to process or -1 if nothing is eligible */
+static int _pick_class(void)
+{
+	struct timeval now;
+	rpc_queue_rec_t *rec;
+	uint32_t wait, oldest_wait = 0;
+	int i, first = -1, oldest = -1;
+
+	if (queue_cnt == 0)
+		return -1;
+
+	gettimeofday(&now, NULL);
+	for (i = 0; i < RPC_PRIO_CNT; i++) {
+		if (busy_cnt[i] >= busy_limit)
+			continue;
+		if (!(rec = list_peek(queue[i])))
+			continue;
+		if (first == -1)
+			first = i;
+		wait = _wait_usec(&rec->queue_time, &now);
+		if ((wait > RPC_QUEUE_MAX_WAIT) && (wait > oldest_wait)) {
+			oldest_wait = wait;
+			oldest = i;
+		}
+	}
+	if (oldest != -1)
+		return oldest;
+	return first;
+}
+
+static void *_rpc_worker(void *no_data)
+{
+	rpc_queue_rec_t *rec;
+	struct timeval now;
+	uint32_t wait;
+	int prio;
+
+#if HAVE_SYS_PRCTL_H
+	if (prctl(PR_SET_NAME, "slurmctld_rpcwk", NULL, NULL, NULL) < 0) {
+		error("%s: cannot set my name to %s %m",
+		      __func__, "slurmctld_rpcwk");
+	}
+#endif
+
+	slurm_mutex_lock(&queue_mutex);
+	while (1) {
+		prio = _pick_class();
+		if (prio < 0) {
+			if (queue_shutdown && (queue_cnt == 0))
+				break;
+			pthread_cond_wait(&queue_cond, &queue_mutex);
+			continue;
+		}
+		rec = list_dequeue(queue[prio]);
+		queue_cnt--;
+		busy_cnt[prio]++;
+
+		gettimeofday(&now, NULL);
+		wait = _wait_usec(&rec->queue_time, &now);
+		stat_cnt[prio]++;
+		stat_wait_sum[prio] += wait;
+		if (wait > stat_wait_max[prio])
+			stat_wait_max[prio] = wait;
+		slurm_mutex_unlock(&queue_mutex);
+
+		(*rpc_handler)(rec);
+		xfree(rec);
+
+		slurm_mutex_lock(&queue_mutex);
+		busy_cnt[prio]--;
+		/* Workers may be waiting on busy_limit for this class */
+		pthread_cond_broadcast(&queue_cond);
+	}
+	slurm_mutex_unlock(&queue_mutex);
+
+	return NULL;
+}
+
+extern void rpc_queue_init(int workers, int queue_depth,
+			   void (*handler)(rpc_queue_rec_t *rec))
+{
+	pthread_attr_t thread_attr;
+	int i;
+
+	slurm_mutex_lock(&queue_mutex);
+	xassert(worker_tid == NULL);
+	for (i = 0; i < RPC_PRIO_CNT; i++) {
+		queue[i] = list_create(NULL);
+		busy_cnt[i] = 0;
+	}
+	queue_cnt = 0;
+	queue_limit = MAX(queue_depth, 1);
+	worker_cnt = MAX(workers, 1);
+	/* Leave at least one quarter of the workers for other classes */
+	busy_limit = MAX((worker_cnt * 3) / 4, 1);
+	queue_shutdown = false;
+	rpc_handler = handler;
+	worker_tid = xmalloc(sizeof(pthread_t) * worker_cnt);
+
+	slurm_attr_init(&thread_attr);
+	for (i = 0; i < worker_cnt; i++) {
+		while (pthread_create(&worker_tid[i], &thread_attr,
+				      _rpc_worker, NULL)) {
+			error("pthread_create error %m");
+			sleep(1);
+		}
+	}
+	slurm_attr_destroy(&thread_attr);
+	slurm_mutex_unlock(&queue_mutex);
+
+	debug("%s: %d worker threads, queue depth %d",
+	      __func__, worker_cnt, queue_limit);
+}
+
+extern void rpc_queue_fini(void)
+{
+	int i;
+
+	slurm_mutex_lock(&queue_mutex);
+	if (!worker_tid) {
+		slurm_mutex_unlock(&queue_mutex);
+		return;
+	}
+	queue_shutdown = true;
+	pthread_cond_broadcast(&queue_cond);
+	slurm_mutex_unlock(&queue_mutex);
+
+	for (i = 0; i < worker_cnt; i++)
+		pthread_join(worker_tid[i], NULL);
+
+	slurm_mutex_lock(&queue_mutex);
+	xfree(worker_tid);
+	worker_cnt = 0;
+	for (i = 0; i < RPC_PRIO_CNT; i++) {
+		list_destroy(queue[i]);
+		queue[i] = NULL;
+	}
+	slurm_mutex_unlock(&queue_mutex);
+}
+
+extern bool rpc_queue_full(void)
+{
+	bool full;
+
+	slurm_mutex_lock(&queue_mutex);
+	full = (queue_cnt >= queue_limit);
+	slurm_mutex_unlock(&queue_mutex);
+
+	return full;
+}
+
+extern void rpc_queue_enqueue(connection_arg_t *conn, char *buf,
+			      size_t buflen)
+{
+	rpc_queue_rec_t *rec = xmalloc(sizeof(rpc_queue_rec_t));
+
+	rec->conn     = conn;
+	rec->buf      = buf;
+	rec->buflen   = buflen;
+	rec->msg_type = _peek_msg_type(buf, buflen);
+	rec->prio     = _rpc_prio(rec->msg_type);
+	gettimeofday(&rec->queue_time, NULL);
+
+	slurm_mutex_lock(&queue_mutex);
+	list_enqueue(queue[rec->prio], rec);
+	queue_cnt++;
+	if (queue_cnt > stat_depth_max)
+		stat_depth_max = queue_cnt;
+	pthread_cond_signal(&queue_cond);
+	slurm_mutex_unlock(&queue_mutex);
+}
+
+extern void rpc_queue_pack_stats(Buf buffer, uint16_t protocol_version)
+{
+	uint32_t busy = 0;
+	int i;
+
+	slurm_mutex_lock(&queue_mutex);
+	for (i = 0; i < RPC_PRIO_CNT; i++)
+		busy += busy_cnt[i];
+	pack32((uint32_t) worker_cnt, buffer);
+	pack32(busy, buffer);
+	pack32((uint32_t) queue_cnt, buffer);
+	pack32(stat_depth_max, buffer);
+	pack32((uint32_t) queue_limit, buffer);
+
+	pack32((uint32_t) RPC_PRIO_CNT, buffer);
+	pack32_array(stat_cnt, RPC_PRIO_CNT, buffer);
+	pack64_array(stat_wait_sum, RPC_PRIO_CNT, buffer);
+	pack32_array(stat_wait_max, RPC_PRIO_CNT, buffer);
+	slurm_mutex_unlock(&queue_mutex);
+}
+
+extern void rpc_queue_reset_stats(void)
+{
+	int i;
+
+	slurm_mutex_lock(&queue_mutex);
+	stat_depth_max = queue_cnt;
+	for (i = 0; i < RPC_PRIO_CNT; i++) {
+		stat_cnt[i] = 0;
+		stat_wait_sum[i] = 0;
+		stat_wait_max[i] = 0;
+	}
+	slurm_mutex_unlock(&queue_mutex);
+}
@@ -0,0 +1,94 @@
+/*****************************************************************************\
+ *  rpc_queue.h - Prioritized queue and worker thread pool for slurmctld RPCs
+ *****************************************************************************
+ *  Copyright (C) 2015 SchedMD LLC.
+ *
+ *  This file is part of SLURM, a resource management program.
+ *  For details, see <http://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  SLURM is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  SLURM is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with SLURM; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _SLURMCTLD_RPC_QUEUE_H
+#define _SLURMCTLD_RPC_QUEUE_H
+
+#include <sys/time.h>
+
+#include "src/common/pack.h"
+#include "src/slurmctld/proc_req.h"
+
+/* Priority classes of queued RPCs, a lower value is serviced first */
+#define RPC_PRIO_HIGH		0	/* slurmd/slurmstepd state changes */
+#define RPC_PRIO_NORMAL		1	/* job submission, updates, etc. */
+#define RPC_PRIO_LOW		2	/* read-only information requests */
+#define RPC_PRIO_CNT		3
+
+/* An RPC which has been completely read from its connection and is waiting
+ * for a worker thread to process it */
+typedef struct rpc_queue_rec {
+	connection_arg_t *conn;	/* connection the RPC arrived on */
+	char *buf;		/* message data, without its length prefix */
+	size_t buflen;		/* size of buf */
+	uint16_t msg_type;	/* message type from the header, for stats */
+	int prio;		/* RPC_PRIO_* */
+	struct timeval queue_time;	/* when the RPC was queued */
+} rpc_queue_rec_t;
+
+/*
+ * Start the RPC worker threads
+ * worker_cnt IN - count of worker threads to start
+ * queue_depth IN - maximum count of RPCs which can be queued
+ * handler IN - function to process an RPC, must free the record's conn and
+ *	buf (normally through slurm_unpack_received_msg()), but not the
+ *	record itself
+ */
+extern void rpc_queue_init(int worker_cnt, int queue_depth,
+			   void (*handler)(rpc_queue_rec_t *rec));
+
+/* Stop the RPC worker threads once any queued RPCs have been processed */
+extern void rpc_queue_fini(void);
+
+/* Return true if the RPC queue is at its configured depth. Further
+ * connections should not be accepted until this returns false. */
+extern bool rpc_queue_full(void);
+
+/*
+ * Queue a fully read RPC for processing by a worker thread
+ * conn IN - the connection, ownership passes to the queue
+ * buf IN - message data, ownership passes to the queue
+ * buflen IN - size of buf
+ */
+extern void rpc_queue_enqueue(connection_arg_t *conn, char *buf,
+			      size_t buflen);
+
+/* Pack RPC queue statistics for sdiag */
+extern void rpc_queue_pack_stats(Buf buffer, uint16_t protocol_version);
+
+/* Reset RPC queue statistics (counters, not current queue depth) */
+extern void rpc_queue_reset_stats(void);
+
+#endif	/* !_SLURMCTLD_RPC_QUEUE_H */
@@ -66,6 +66,7 @@
 
 #include "slurm/slurm.h"
 
+#include "src/common/bitrle.h"
 #include "src/common/bitstring.h"
 #include "src/common/checkpoint.h"
 #include "src/common/list.h"
@@ -90,13 +91,40 @@
 #define MAX_JOB_ARRAY_VALUE 1000
 #endif
 
-/* Maximum parallel threads to service incoming RPCs.
- * Since some systems schedule pthread on a First-In-Last-Out basis,
- * increasing this value is strongly discouraged. */
+/* Maximum count of incoming RPC connections whose messages are being read
+ * at one time. Further connections are not accepted until one completes. */
 #ifndef MAX_SERVER_THREADS
 #define MAX_SERVER_THREADS 256
 #endif
 
+/* Maximum count of connections kept open as sessions by clients, see
+ * slurm_open_session(). Idle sessions do not count against
+ * MAX_SERVER_THREADS. */
+#ifndef MAX_CTLD_SESSIONS
+#define MAX_CTLD_SESSIONS 512
+#endif
+
+/* Seconds after which a session with no request being read or processed is
+ * closed, so that idle clients do not hold MAX_CTLD_SESSIONS. The client
+ * opens a new one when it next sends a request. */
+#ifndef CTLD_SESSION_IDLE_TIMEOUT
+#define CTLD_SESSION_IDLE_TIMEOUT 300
+#endif
+
+/* Default count of threads processing RPCs once they have been read.
+ * Configure with SchedulerParameters=rpc_workers=#.
+ * Since some systems schedule pthread on a First-In-Last-Out basis,
+ * large values are discouraged. */
+#ifndef RPC_WORKER_THREADS
+#define RPC_WORKER_THREADS 64
+#endif
+
+/* Default maximum count of RPCs read and waiting for a worker thread.
+ * Configure with SchedulerParameters=rpc_queue_depth=#. */
+#ifndef RPC_QUEUE_DEPTH
+#define RPC_QUEUE_DEPTH 1024
+#endif
+
 /* Perform full slurmctld's state every PERIODIC_CHECKPOINT seconds */
 #ifndef PERIODIC_CHECKPOINT
 #define	PERIODIC_CHECKPOINT	300
@@ -155,6 +183,8 @@ typedef struct slurmctld_config {
 	time_t	boot_time;
 	time_t	shutdown_time;
 	int	server_thread_count;
+	int	session_count;	/* connections kept open as sessions,
+				 * protected by thread_count_lock */
 
 	slurm_cred_ctx_t cred_ctx;
 #ifdef WITH_PTHREADS
@@ -208,6 +238,13 @@ typedef struct diag_stats {
 	uint32_t bf_active;
 } diag_stats_t;
 
+/* Latency histograms kept for slurmctld statistics. Each power of two range
+ * of microseconds is split into STAT_HIST_SUB buckets, so a percentile
+ * reported from a histogram is within 25% of the true value. */
+#define STAT_HIST_SUB_BITS	2
+#define STAT_HIST_SUB		(1 << STAT_HIST_SUB_BITS)
+#define STAT_HIST_BUCKETS	(STAT_HIST_SUB * 31)
+
 extern time_t	last_proc_req_start;
 extern diag_stats_t slurmctld_diag_stats;
 extern slurmctld_config_t slurmctld_config;
@@ -372,7 +409,7 @@ typedef struct slurmctld_resv {
 	bool account_not;	/* account_list users NOT permitted to use */
 	char *assoc_list;	/* list of associations			*/
 	uint32_t cpu_cnt;	/* number of reserved CPUs		*/
-	bitstr_t *core_bitmap;	/* bitmap of reserved cores		*/
+	bitrle_t *core_bitmap;	/* bitmap of reserved cores		*/
 	uint32_t duration;	/* time in seconds for this
 				 * reservation to last                  */
 	time_t end_time;	/* end time of reservation		*/
@@ -453,6 +490,9 @@ struct job_details {
 	uint16_t cpus_per_task;		/* number of processors required for
 					 * each task */
 	List depend_list;		/* list of job_ptr:state pairs */
+	time_t depend_time;		/* time depend_list was last tested,
+					 * 0 after a job it names changes */
+	int depend_rc;			/* test_job_dependency() result */
 	char *dependency;		/* wait for other jobs */
 	char *orig_dependency;		/* original value (for archiving) */
 	uint16_t env_cnt;		/* size of env_sup (see below) */
@@ -525,6 +565,32 @@ typedef struct job_array_struct {
 	uint32_t tot_comp_tasks;	/* Completed task count */
 } job_array_struct_t;
 
+/* Job information packed by pack_job() for one protocol version,
+ * show_flags and field_mask value. Valid until the job is next changed,
+ * see _job_pack_gen() in job_mgr.c */
+#define JOB_PACK_CACHE_CNT 2
+#define JOB_PACK_BUF_SIZE 2048	/* initial buffer for a record to cache */
+struct job_pack_cache {
+	uint16_t protocol_version;
+	uint16_t show_flags;
+	uint32_t field_mask;
+	uint64_t pack_gen;		/* _job_pack_gen() of job when packed */
+	time_t expire;			/* data is time dependent, invalid
+					 * after this time, zero if none */
+	BufShared data;			/* packed record, referenced by
+					 * responses being sent */
+};
+
+/* Detection of changes to a job's packed information for delta job info
+ * responses, see _job_delta_time() in job_mgr.c */
+struct job_delta_stamp {
+	uint64_t digest;		/* digest of job's packed record */
+	uint64_t pack_gen;		/* _job_pack_gen() when digest made */
+	time_t expire;			/* digest is time dependent, invalid
+					 * after this time, zero if none */
+	time_t change_time;		/* time change last detected */
+};
+
 struct job_record {
 	char    *account;		/* account number to charge */
 	char	*alias_list;		/* node name to address aliases */
@@ -626,6 +692,22 @@ struct job_record {
 					 * for this job, used to insure
 					 * epilog is not re-run for job */
 	uint16_t other_port;		/* port for client communications */
+	struct job_pack_cache *pack_cache; /* cached pack_job() output,
+					 * JOB_PACK_CACHE_CNT records,
+					 * (Internal use only, don't save) */
+	struct job_delta_stamp delta;	/* change detection for delta job
+					 * info (Internal use only,
+					 * don't save) */
+	uint64_t save_digest;		/* digest of job's last record
+					 * written to job state snapshot or
+					 * journal, zero if none (Internal use
+					 * only, don't save) */
+	time_t time_check;		/* due time of job's queued
+					 * job_time_limit() check, zero if none
+					 * (Internal use only, don't save) */
+	time_t purge_check;		/* due time of job's queued
+					 * purge_old_job() check, zero if none
+					 * (Internal use only, don't save) */
 	char *partition;		/* name of job partition(s) */
 	List part_ptr_list;		/* list of pointers to partition recs */
 	bool part_nodes_missing;	/* set if job's nodes removed from this
@@ -717,6 +799,9 @@ struct	depend_spec {
 	uint16_t	depend_flags;	/* SLURM_FLAGS_* type */
 	uint32_t	job_id;		/* SLURM job_id */
 	struct job_record *job_ptr;	/* pointer to this job */
+	struct job_record *depend_job_ptr; /* job with this dependency, set
+					 * once in the reverse index */
+	struct depend_spec *depend_next; /* reverse index hash chain */
 };
 
 struct 	step_record {
@@ -1146,9 +1231,36 @@ extern int job_hold_by_qos_id(uint32_t qos_id);
 extern int job_checkpoint(checkpoint_msg_t *ckpt_ptr, uid_t uid,
 			  slurm_fd_t conn_fd, uint16_t protocol_version);
 
+/*
+ * all_jobs_changed - Record that the information of any job may have changed,
+ *	as job_changed() would for every job. Sets last_job_update.
+ * IN now - time of the change
+ * NOTE: Call while holding the job write lock
+ */
+extern void all_jobs_changed(time_t now);
+
+/*
+ * all_nodes_changed - Record that the information of any node may have
+ *	changed, as node_changed() would for every node. Sets last_node_update.
+ * IN now - time of the change
+ * NOTE: Call while holding the node write lock
+ */
+extern void all_nodes_changed(time_t now);
+
 /* log the completion of the specified job */
 extern void job_completion_logger(struct job_record  *job_ptr, bool requeue);
 
+/*
+ * job_changed - Record that a job's information, as reported by job
+ *	information RPCs, changed. Sets last_job_update, so clients which
+ *	loaded job information earlier load it again. Cached packed records
+ *	of jobs are checked against the job itself, see _job_pack_gen().
+ * IN job_ptr - the job changed
+ * IN now - time of the change
+ * NOTE: Call while holding the job write lock
+ */
+extern void job_changed(struct job_record *job_ptr, time_t now);
+
 /*
  * job_epilog_complete - Note the completion of the epilog script for a
  *	given job
@@ -1390,7 +1502,9 @@ extern int job_step_signal(uint32_t job_id, uint32_t step_id,
 			   uint16_t signal, uid_t uid);
 
 /*
- * job_time_limit - terminate jobs which have exceeded their time limit
+ * job_time_limit - terminate jobs which have exceeded their time limit.
+ *	Only jobs queued by queue_job_time_check() which are now due are
+ *	tested.
  * global: job_list - pointer global job list
  *	last_job_update - time of last job table update
  */
@@ -1413,6 +1527,13 @@ extern int job_update_cpu_cnt(struct job_record *job_ptr, int node_inx);
  */
 extern void check_job_step_time_limit (struct job_record *job_ptr, time_t now);
 
+/*
+ * job_step_time_limit_due - Return when check_job_step_time_limit() next
+ *	needs to test a job's steps, zero if never
+ * IN job_ptr - pointer to job containing steps to check
+ */
+extern time_t job_step_time_limit_due(struct job_record *job_ptr);
+
 /*
  * kill_job_by_part_name - Given a partition name, deallocate resource for
  *	its jobs and kill them
@@ -1562,10 +1683,27 @@ extern void msg_to_slurmd (slurm_msg_type_t msg_type);
 /* node_fini - free all memory associated with node records */
 extern void node_fini (void);
 
+/*
+ * node_changed - Record that a node's information, as reported by node
+ *	info RPCs, has changed. Sets last_node_update.
+ * IN node_ptr - the node
+ * IN now - time of the change
+ * NOTE: Call while holding the node write lock
+ */
+extern void node_changed(struct node_record *node_ptr, time_t now);
+
 /* node_did_resp - record that the specified node is responding
  * IN name - name of the node */
 extern void node_did_resp (char *name);
 
+/*
+ * node_did_resp_aggr - record that the nodes of an aggregated ping
+ *	response are responding, along with their CPU load
+ * IN node_list - hostlist expression of the nodes
+ * IN aggr - their CPU load in the order of node_list
+ */
+extern void node_did_resp_aggr(char *node_list, ping_slurmd_aggr_msg_t *aggr);
+
 /*
  * node_not_resp - record that the specified node is not responding
  * IN name - name of the node
@@ -1582,19 +1720,24 @@ extern void node_no_resp_msg(void);
 /*
  * pack_all_jobs - dump all job information for all jobs in
  *	machine independent form (for network transmission)
- * OUT buffer_ptr - the pointer is set to the allocated buffer.
- * OUT buffer_size - set to size of the buffer in bytes
+ * OUT chain_ptr - set to the packed information, which references cached
+ *	job records rather than copying them
  * IN show_flags - job filtering options
  * IN uid - uid of user making request (for partition filtering)
  * IN filter_uid - pack only jobs belonging to this user if not NO_VAL
+ * IN filter - pack only jobs and fields matching this filter, NULL for all
+ * IN update_time - with SHOW_DELTA, pack only jobs changed since this time
+ *	and the IDs of jobs removed since this time, if possible
  * IN protocol_version - slurm protocol version of client
  * global: job_list - global list of job records
- * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
+ * NOTE: the chain at *chain_ptr must be freed by the caller with
+ *	free_buf_chain()
  * NOTE: change _unpack_job_desc_msg() in common/slurm_protocol_pack.c
  *	whenever the data format changes
  */
-extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
-			  uint16_t show_flags, uid_t uid, uint32_t filter_uid,
+extern void pack_all_jobs(BufChain *chain_ptr, uint16_t show_flags,
+			  uid_t uid, uint32_t filter_uid,
+			  job_info_filter_t *filter, time_t update_time,
 			  uint16_t protocol_version);
 
 /*
@@ -1604,6 +1747,10 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
  * OUT buffer_size - set to size of the buffer in bytes
  * IN show_flags - node filtering options
  * IN uid - uid of user making request (for partition filtering)
+ * IN filter - nodes not matching this filter are packed without a name,
+ *	NULL for all
+ * IN update_time - with SHOW_DELTA, pack only nodes changed since this time,
+ *	if possible
  * IN protocol_version - slurm protocol version of client
  * global: node_record_table_ptr - pointer to global node table
  * NOTE: the caller must xfree the buffer at *buffer_ptr
@@ -1612,6 +1759,7 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
  */
 extern void pack_all_node (char **buffer_ptr, int *buffer_size,
 			   uint16_t show_flags, uid_t uid,
+			   node_info_filter_t *filter, time_t update_time,
 			   uint16_t protocol_version);
 
 /* Pack all scheduling statistics */
@@ -1654,6 +1802,7 @@ extern void pack_all_part(char **buffer_ptr, int *buffer_size,
  *	machine independent form (for network transmission)
  * IN dump_job_ptr - pointer to job for which information is requested
  * IN show_flags - job filtering options
+ * IN field_mask - JOB_FIELD_* values to pack, others are packed as NULL
  * IN/OUT buffer - buffer in which data is placed, pointers automatically
  *	updated
  * IN uid - user requesting the data
@@ -1661,7 +1810,8 @@ extern void pack_all_part(char **buffer_ptr, int *buffer_size,
  *	  whenever the data format changes
  */
 extern void pack_job (struct job_record *dump_job_ptr, uint16_t show_flags,
-		      Buf buffer, uint16_t protocol_version, uid_t uid);
+		      uint32_t field_mask, Buf buffer,
+		      uint16_t protocol_version, uid_t uid);
 
 /*
  * pack_part - dump all configuration information about a specific partition
@@ -1679,17 +1829,17 @@ extern void pack_part (struct part_record *part_ptr, Buf buffer,
 /*
  * pack_one_job - dump information for one jobs in
  *	machine independent form (for network transmission)
- * OUT buffer_ptr - the pointer is set to the allocated buffer.
- * OUT buffer_size - set to size of the buffer in bytes
+ * OUT chain_ptr - set to the packed information, see pack_all_jobs()
  * IN job_id - ID of job that we want info for
  * IN show_flags - job filtering options
  * IN uid - uid of user making request (for partition filtering)
- * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
+ * NOTE: the chain at *chain_ptr must be freed by the caller with
+ *	free_buf_chain()
  * NOTE: change _unpack_job_desc_msg() in common/slurm_protocol_pack.c
  *	whenever the data format changes
  */
-extern int pack_one_job(char **buffer_ptr, int *buffer_size,
-			uint32_t job_id, uint16_t show_flags, uid_t uid,
+extern int pack_one_job(BufChain *chain_ptr, uint32_t job_id,
+			uint16_t show_flags, uid_t uid,
 			uint16_t protocol_version);
 
 /*
@@ -1767,6 +1917,8 @@ extern int prolog_complete(uint32_t job_id, uint32_t prolog_return_code);
 /*
  * purge_old_job - purge old job records.
  *	The jobs must have completed at least MIN_JOB_AGE minutes ago.
+ *	Only jobs queued by queue_job_purge_check() which are now due are
+ *	tested.
  *	Test job dependencies, handle after_ok, after_not_ok before
  *	purging any jobs.
  * NOTE: READ lock slurmctld config and WRITE lock jobs before entry
@@ -1776,9 +1928,22 @@ void purge_old_job(void);
 /* Convert a comma delimited list of QOS names into a bitmap */
 extern void qos_list_build(char *qos, bitstr_t **qos_bits);
 
+/*
+ * queue_job_purge_check - queue a finished job to be tested by
+ *	purge_old_job() once it reaches MinJobAge. Call when a job finishes.
+ */
+extern void queue_job_purge_check(struct job_record *job_ptr);
+
 /* Request that the job scheduler execute soon (typically within seconds) */
 extern void queue_job_scheduler(void);
 
+/*
+ * queue_job_time_check - queue a running or suspended job to be tested by
+ *	job_time_limit() at the job's next time limit event. Call when a job
+ *	starts or resumes, or its end time, steps or reservation change.
+ */
+extern void queue_job_time_check(struct job_record *job_ptr);
+
 /*
  * rehash_jobs - Create or rebuild the job hash table.
  * NOTE: run lock_slurmctld before entry: Read config, write job
@@ -1921,6 +2086,20 @@ void signal_step_tasks_on_node(char* node_name, struct step_record *step_ptr,
  */
 extern int slurmctld_shutdown(void);
 
+/* Map a latency in microseconds to its latency histogram bucket */
+extern int stat_hist_bucket(uint64_t usec);
+
+/*
+ * stat_hist_percentile - Return the upper bound of the latency histogram
+ *	bucket holding the given fraction of samples
+ * IN hist - histogram of STAT_HIST_BUCKETS counts
+ * IN max_usec - largest sample recorded, limits the value returned
+ * IN per_mille - fraction of samples, in parts per thousand
+ * RET latency in microseconds or zero if the histogram is empty
+ */
+extern uint32_t stat_hist_percentile(uint32_t *hist, uint32_t max_usec,
+				     uint32_t per_mille);
+
 /* Perform periodic job step checkpoints (per user request) */
 extern void step_checkpoint(void);
 
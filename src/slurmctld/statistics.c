@@ -43,6 +43,8 @@
 #include <stdio.h>
 
 #include "src/slurmctld/agent.h"
+#include "src/slurmctld/locks.h"
+#include "src/slurmctld/rpc_queue.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/common/list.h"
 #include "src/common/pack.h"
@@ -58,6 +60,8 @@ extern void pack_all_stat(int resp, char **buffer_ptr, int *buffer_size,
 	int parts_packed;
 	int agent_queue_size;
 	time_t now = time(NULL);
+	uint64_t pool_hits, pool_misses, pool_bytes;
+	uint32_t pool_cnt;
 
 	buffer_ptr[0] = NULL;
 	*buffer_size = 0;
@@ -116,6 +120,18 @@ extern void pack_all_stat(int resp, char **buffer_ptr, int *buffer_size,
 			pack32(slurmctld_diag_stats.bf_depth_try_sum, buffer);
 			pack32(slurmctld_diag_stats.bf_queue_len_sum, buffer);
 			pack32(slurmctld_diag_stats.bf_active,	 buffer);
+
+			if (protocol_version >= SLURM_15_08_PROTOCOL_VERSION) {
+				rpc_queue_pack_stats(buffer, protocol_version);
+				pack_lock_stats(buffer, protocol_version);
+
+				get_buf_pool_stats(&pool_hits, &pool_misses,
+						   &pool_cnt, &pool_bytes);
+				pack64(pool_hits, buffer);
+				pack64(pool_misses, buffer);
+				pack32(pool_cnt, buffer);
+				pack64(pool_bytes, buffer);
+			}
 		}
 	}
 
@@ -156,5 +172,61 @@ extern void reset_stats(int level)
 	slurmctld_diag_stats.bf_last_depth_try = 0;
 	slurmctld_diag_stats.bf_active = 0;
 
+	rpc_queue_reset_stats();
+	reset_lock_stats();
+	reset_buf_pool_stats();
+
 	last_proc_req_start = time(NULL);
 }
+
+/* Map a latency in microseconds to its latency histogram bucket */
+extern int stat_hist_bucket(uint64_t usec)
+{
+	uint64_t tmp;
+	int bucket, msb = 0;
+
+	if (usec < STAT_HIST_SUB)
+		return (int) usec;
+	for (tmp = usec; tmp > 1; tmp >>= 1)
+		msb++;
+	bucket = (msb - STAT_HIST_SUB_BITS + 1) * STAT_HIST_SUB;
+	bucket += (usec >> (msb - STAT_HIST_SUB_BITS)) & (STAT_HIST_SUB - 1);
+	if (bucket >= STAT_HIST_BUCKETS)
+		bucket = STAT_HIST_BUCKETS - 1;
+	return bucket;
+}
+
+/* Return the upper bound of the latency histogram bucket holding the given
+ * fraction (in parts per thousand) of samples, limited to the largest
+ * sample recorded */
+extern uint32_t stat_hist_percentile(uint32_t *hist, uint32_t max_usec,
+				     uint32_t per_mille)
+{
+	uint64_t total = 0, rank, sum = 0, upper;
+	int i, msb, sub;
+
+	for (i = 0; i < STAT_HIST_BUCKETS; i++)
+		total += hist[i];
+	if (total == 0)
+		return 0;
+	rank = (total * per_mille + 999) / 1000;
+	if (rank == 0)
+		rank = 1;
+
+	for (i = 0; i < STAT_HIST_BUCKETS; i++) {
+		sum += hist[i];
+		if (sum >= rank)
+			break;
+	}
+	if (i < STAT_HIST_SUB) {
+		upper = i;
+	} else {
+		msb = (i / STAT_HIST_SUB) + STAT_HIST_SUB_BITS - 1;
+		sub = i % STAT_HIST_SUB;
+		upper = ((uint64_t) (STAT_HIST_SUB + sub + 1) <<
+			 (msb - STAT_HIST_SUB_BITS)) - 1;
+	}
+	if (upper > max_usec)
+		upper = max_usec;
+	return (uint32_t) upper;
+}
@@ -159,6 +159,8 @@ static int _opt_node_cnt(uint32_t step_min_nodes, uint32_t step_max_nodes,
  * IN job_ptr - pointer to job table entry to have step record added
  * RET a pointer to the record or NULL if error
  * NOTE: allocates memory that should be xfreed with delete_step_record
+ * NOTE: The caller must call job_changed(), job records recovered by
+ *	load_step_state() may be unpacked by multiple threads
  */
 static struct step_record * _create_step_record(struct job_record *job_ptr)
 {
@@ -175,7 +177,6 @@ static struct step_record * _create_step_record(struct job_record *job_ptr)
 
 	step_ptr = (struct step_record *) xmalloc(sizeof(struct step_record));
 
-	last_job_update = time(NULL);
 	step_ptr->job_ptr    = job_ptr;
 	step_ptr->exit_code  = NO_VAL;
 	step_ptr->time_limit = INFINITE;
@@ -200,6 +201,7 @@ static void _build_pending_step(struct job_record *job_ptr,
 	step_ptr = _create_step_record(job_ptr);
 	if (step_ptr == NULL)
 		return;
+	job_changed(job_ptr, time(NULL));
 
 	step_ptr->port      = step_specs->port;
 	step_ptr->host      = xstrdup(step_specs->host);
@@ -241,7 +243,7 @@ extern void delete_step_records (struct job_record *job_ptr)
 
 	xassert(job_ptr);
 
-	last_job_update = time(NULL);
+	job_changed(job_ptr, time(NULL));
 	step_iterator = list_iterator_create(job_ptr->step_list);
 	while ((step_ptr = (struct step_record *) list_next (step_iterator))) {
 		/* Only check if not a pending step */
@@ -340,7 +342,7 @@ delete_step_record (struct job_record *job_ptr, uint32_t step_id)
 	if (!job_ptr->step_list)
 		return error_code;
 
-	last_job_update = time(NULL);
+	job_changed(job_ptr, time(NULL));
 	step_iterator = list_iterator_create (job_ptr->step_list);
 	while ((step_ptr = (struct step_record *) list_next (step_iterator))) {
 		if (step_ptr->step_id != step_id)
@@ -729,7 +731,7 @@ int job_step_complete(uint32_t job_id, uint32_t step_id, uid_t uid,
 
 	_internal_step_complete(job_ptr, step_ptr);
 
-	last_job_update = time(NULL);
+	job_changed(job_ptr, time(NULL));
 
 	return SLURM_SUCCESS;
 }
@@ -1362,8 +1364,7 @@ _pick_step_nodes (struct job_record  *job_ptr,
 				selected_nodes = NULL;
 			} else {
 				nodes_picked = bit_copy(selected_nodes);
-				bit_not(selected_nodes);
-				bit_and(nodes_avail, selected_nodes);
+				bit_and_not(nodes_avail, selected_nodes);
 				FREE_NULL_BITMAP(selected_nodes);
 			}
 		}
@@ -1386,8 +1387,7 @@ _pick_step_nodes (struct job_record  *job_ptr,
 			      step_spec->relative, job_ptr->job_id);
 			goto cleanup;
 		}
-		bit_not (relative_nodes);
-		bit_and (nodes_avail, relative_nodes);
+		bit_and_not(nodes_avail, relative_nodes);
 		FREE_NULL_BITMAP (relative_nodes);
 	} else {
 		nodes_idle = bit_alloc (bit_size (nodes_avail) );
@@ -1487,9 +1487,8 @@ _pick_step_nodes (struct job_record  *job_ptr,
 							 usable_cpu_cnt);
 			if (node_tmp) {
 				bit_or  (nodes_picked, node_tmp);
-				bit_not (node_tmp);
-				bit_and (nodes_idle, node_tmp);
-				bit_and (nodes_avail, node_tmp);
+				bit_and_not(nodes_idle, node_tmp);
+				bit_and_not(nodes_avail, node_tmp);
 				FREE_NULL_BITMAP (node_tmp);
 				node_tmp = NULL;
 				nodes_picked_cnt = step_spec->min_nodes;
@@ -1532,8 +1531,7 @@ _pick_step_nodes (struct job_record  *job_ptr,
 				goto cleanup;
 			}
 			bit_or  (nodes_picked, node_tmp);
-			bit_not (node_tmp);
-			bit_and (nodes_avail, node_tmp);
+			bit_and_not(nodes_avail, node_tmp);
 			FREE_NULL_BITMAP (node_tmp);
 			node_tmp = NULL;
 			nodes_picked_cnt = step_spec->min_nodes;
@@ -1570,15 +1568,13 @@ _pick_step_nodes (struct job_record  *job_ptr,
 				if (cpu_cnt == 0) {
 					/* Node not usable (memory insufficient
 					 * to allocate any CPUs, etc.) */
-					bit_not(node_tmp);
-					bit_and(nodes_avail, node_tmp);
+					bit_and_not(nodes_avail, node_tmp);
 					FREE_NULL_BITMAP(node_tmp);
 					continue;
 				}
 
 				bit_or  (nodes_picked, node_tmp);
-				bit_not (node_tmp);
-				bit_and (nodes_avail, node_tmp);
+				bit_and_not(nodes_avail, node_tmp);
 				FREE_NULL_BITMAP (node_tmp);
 				node_tmp = NULL;
 				nodes_picked_cnt += 1;
@@ -1628,9 +1624,8 @@ cleanup:
 	} else if (*return_code == ESLURM_NODE_NOT_AVAIL) {
 		/* Return ESLURM_NODES_BUSY if the node is not responding.
 		 * The node will eventually either come back UP or go DOWN. */
-		nodes_picked = bit_copy(up_node_bitmap);
-		bit_not(nodes_picked);
-		bit_and(nodes_picked, job_ptr->node_bitmap);
+		nodes_picked = bit_copy(job_ptr->node_bitmap);
+		bit_and_not(nodes_picked, up_node_bitmap);
 		first_bit = bit_ffs(nodes_picked);
 		if (first_bit == -1)
 			last_bit = -2;
@@ -2295,6 +2290,7 @@ step_create(job_step_create_request_msg_t *step_specs,
 		select_g_select_jobinfo_free(select_jobinfo);
 		return ESLURMD_TOOMANYSTEPS;
 	}
+	job_changed(job_ptr, time(NULL));
 	step_ptr->start_time = time(NULL);
 	step_ptr->state      = JOB_RUNNING;
 	step_ptr->step_id    = job_ptr->next_step_id++;
@@ -2435,6 +2431,7 @@ step_create(job_step_create_request_msg_t *step_specs,
 		jobacct_storage_g_job_start(acct_db_conn, job_ptr);
 
 	select_g_step_start(step_ptr);
+	queue_job_time_check(job_ptr);	/* step time limit */
 
 	jobacct_storage_g_step_start(acct_db_conn, step_ptr);
 	return SLURM_SUCCESS;
@@ -2839,7 +2836,7 @@ extern int job_step_checkpoint(checkpoint_msg_t *ckpt_ptr,
 				   ckpt_ptr->image_dir, &resp_data.event_time,
 				   &resp_data.error_code,
 				   &resp_data.error_msg);
-		last_job_update = time(NULL);
+		job_changed(job_ptr, time(NULL));
 	}
 
     reply:
@@ -2905,7 +2902,7 @@ extern int job_step_checkpoint_comp(checkpoint_comp_msg_t *ckpt_ptr,
 	} else {
 		rc = checkpoint_comp((void *)step_ptr, ckpt_ptr->begin_time,
 			ckpt_ptr->error_code, ckpt_ptr->error_msg);
-		last_job_update = time(NULL);
+		job_changed(job_ptr, time(NULL));
 	}
 
     reply:
@@ -2964,7 +2961,7 @@ extern int job_step_checkpoint_task_comp(checkpoint_task_comp_msg_t *ckpt_ptr,
 		rc = checkpoint_task_comp((void *)step_ptr,
 			ckpt_ptr->task_id, ckpt_ptr->begin_time,
 			ckpt_ptr->error_code, ckpt_ptr->error_msg);
-		last_job_update = time(NULL);
+		job_changed(job_ptr, time(NULL));
 	}
 
     reply:
@@ -3659,7 +3656,7 @@ extern void step_checkpoint(void)
 			job_checkpoint(&ckpt_req, getuid(), -1,
 				       (uint16_t)NO_VAL);
 			job_ptr->ckpt_time = now;
-			last_job_update = now;
+			job_changed(job_ptr, now);
 			continue; /* ignore periodic step ckpt */
 		}
 		step_iterator = list_iterator_create (job_ptr->step_list);
@@ -3685,7 +3682,7 @@ extern void step_checkpoint(void)
 				continue;
 
 			step_ptr->ckpt_time = now;
-			last_job_update = now;
+			job_changed(job_ptr, now);
 			image_dir = xstrdup(step_ptr->ckpt_dir);
 			xstrfmtcat(image_dir, "/%u.%u", job_ptr->job_id,
 				   step_ptr->step_id);
@@ -3819,6 +3816,32 @@ check_job_step_time_limit (struct job_record *job_ptr, time_t now)
 	list_iterator_destroy (step_iterator);
 }
 
+extern time_t job_step_time_limit_due(struct job_record *job_ptr)
+{
+	ListIterator step_iterator;
+	struct step_record *step_ptr;
+	time_t due = 0, step_due;
+
+	if ((job_ptr->job_state != JOB_RUNNING) || !job_ptr->step_list)
+		return due;
+
+	step_iterator = list_iterator_create (job_ptr->step_list);
+	while ((step_ptr = (struct step_record *) list_next (step_iterator))) {
+		if (step_ptr->state != JOB_RUNNING)
+			continue;
+		if (step_ptr->time_limit == INFINITE ||
+		    step_ptr->time_limit == NO_VAL)
+			continue;
+		step_due = step_ptr->start_time + step_ptr->tot_sus_time +
+			   (step_ptr->time_limit * 60);
+		if ((due == 0) || (step_due < due))
+			due = step_due;
+	}
+	list_iterator_destroy (step_iterator);
+
+	return due;
+}
+
 /* Return true if memory is a reserved resources, false otherwise */
 static bool _is_mem_resv(void)
 {
@@ -3956,8 +3979,10 @@ extern int update_step(step_update_request_msg_t *req, uid_t uid)
 			     req->job_id, req->step_id, req->time_limit);
 		}
 	}
-	if (mod_cnt)
-		last_job_update = time(NULL);
+	if (mod_cnt) {
+		job_changed(job_ptr, time(NULL));
+		queue_job_time_check(job_ptr);	/* step time limit */
+	}
 
 	return SLURM_SUCCESS;
 }
@@ -4055,7 +4080,7 @@ extern int post_job_step(struct step_record *step_ptr)
 				 job_ptr->gres_list, job_ptr->job_id,
 				 step_ptr->step_id);
 
-	last_job_update = time(NULL);
+	job_changed(job_ptr, time(NULL));
 	step_ptr->state = JOB_COMPLETE;
 
 	error_code = delete_step_record(job_ptr, step_ptr->step_id);
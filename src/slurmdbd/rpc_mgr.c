@@ -246,6 +246,7 @@ static void * _service_connection(void *arg)
 			fini = true;
 		}
 
+		buffer = slurmdbd_compress_msg(buffer, conn->rpc_version);
 		(void) _send_resp(conn->newsockfd, buffer);
 		xfree(msg);
 	}
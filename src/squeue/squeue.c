@@ -62,8 +62,10 @@ int max_line_size;
 /************
  * Funtions *
  ************/
+static job_info_filter_t *_build_job_filter(void);
 static int  _get_info(bool clear_old);
 static int  _get_window_width( void );
+static uint32_t _job_field_mask(void);
 static void _print_date( void );
 static int  _multi_cluster(List clusters);
 static int  _print_job ( bool clear_old );
@@ -87,6 +89,10 @@ main (int argc, char *argv[])
 	if (params.clusters)
 		working_cluster_rec = list_peek(params.clusters);
 
+	/* Keep one connection to the controller between iterations */
+	if (params.iterate && !params.clusters)
+		(void) slurm_open_session();
+
 	while (1) {
 		if ((!params.no_header) &&
 		    (params.iterate || params.verbose || params.long_list))
@@ -164,6 +170,122 @@ _get_window_width( void )
 }
 
 
+/* _job_field_mask - identify the job fields which may be reported */
+static uint32_t _job_field_mask(void)
+{
+	uint32_t field_mask = 0;
+	ListIterator iterator;
+	job_format_t *job_format;
+
+	/* User specified sort order may use any field */
+	if (params.sort)
+		return JOB_FIELD_ALL;
+
+	if (params.licenses_list)
+		field_mask |= JOB_FIELD_LICENSES;
+
+	iterator = list_iterator_create(params.format_list);
+	while ((job_format = list_next(iterator))) {
+		if (job_format->function == _print_job_batch_host)
+			field_mask |= JOB_FIELD_BATCH_HOST;
+		else if (job_format->function == _print_job_command)
+			field_mask |= JOB_FIELD_COMMAND;
+		else if (job_format->function == _print_job_comment)
+			field_mask |= JOB_FIELD_COMMENT;
+		else if (job_format->function == _print_job_dependency)
+			field_mask |= JOB_FIELD_DEPENDENCY;
+		else if (job_format->function == _print_job_features)
+			field_mask |= JOB_FIELD_FEATURES;
+		else if (job_format->function == _print_job_gres)
+			field_mask |= JOB_FIELD_GRES;
+		else if (job_format->function == _print_job_licenses)
+			field_mask |= JOB_FIELD_LICENSES;
+		else if (job_format->function == _print_job_network)
+			field_mask |= JOB_FIELD_NETWORK;
+		else if (job_format->function == _print_job_node_inx)
+			field_mask |= JOB_FIELD_NODE_INX;
+		else if ((job_format->function == _print_job_num_nodes) ||
+			 (job_format->function == _print_job_req_nodes) ||
+			 (job_format->function == _print_job_exc_nodes) ||
+			 (job_format->function == _print_job_req_node_inx) ||
+			 (job_format->function == _print_job_exc_node_inx))
+			field_mask |= JOB_FIELD_REQ_NODES;
+		else if ((job_format->function == _print_job_reason) ||
+			 (job_format->function == _print_job_reason_list))
+			field_mask |= JOB_FIELD_STATE_DESC;
+		else if ((job_format->function == _print_job_std_err) ||
+			 (job_format->function == _print_job_std_in) ||
+			 (job_format->function == _print_job_std_out))
+			field_mask |= (JOB_FIELD_STD_IO | JOB_FIELD_WORK_DIR);
+		else if (job_format->function == _print_job_work_dir)
+			field_mask |= JOB_FIELD_WORK_DIR;
+	}
+	list_iterator_destroy(iterator);
+
+	return field_mask;
+}
+
+/* _build_job_filter - build a filter so that the controller only returns
+ *	jobs and fields which may be reported, see _filter_job() in print.c */
+static job_info_filter_t *_build_job_filter(void)
+{
+	static job_info_filter_t *filter = NULL;
+	static uint16_t default_states[] = {
+		JOB_PENDING, JOB_RUNNING, JOB_SUSPENDED, JOB_COMPLETING };
+	ListIterator iterator;
+	squeue_job_step_t *job_step_id;
+	uint32_t *user;
+	uint16_t *state_id;
+	int i;
+
+	if (filter)
+		return filter;
+
+	filter = xmalloc(sizeof(job_info_filter_t));
+	slurm_init_job_info_filter(filter);
+	filter->accounts = xstrdup(params.accounts);
+	filter->partitions = xstrdup(params.partitions);
+	filter->reservations = xstrdup(params.reservation);
+
+	if (params.job_list && list_count(params.job_list)) {
+		filter->job_ids = xmalloc(sizeof(uint32_t) *
+					  list_count(params.job_list));
+		iterator = list_iterator_create(params.job_list);
+		while ((job_step_id = list_next(iterator))) {
+			filter->job_ids[filter->job_id_cnt++] =
+				job_step_id->job_id;
+		}
+		list_iterator_destroy(iterator);
+	}
+
+	if (params.user_list && list_count(params.user_list)) {
+		filter->user_ids = xmalloc(sizeof(uint32_t) *
+					   list_count(params.user_list));
+		iterator = list_iterator_create(params.user_list);
+		while ((user = list_next(iterator)))
+			filter->user_ids[filter->user_id_cnt++] = *user;
+		list_iterator_destroy(iterator);
+	}
+
+	if (params.state_list) {
+		filter->states = xmalloc(sizeof(uint16_t) *
+					 list_count(params.state_list));
+		iterator = list_iterator_create(params.state_list);
+		while ((state_id = list_next(iterator)))
+			filter->states[filter->state_cnt++] = *state_id;
+		list_iterator_destroy(iterator);
+	} else {
+		filter->state_cnt = sizeof(default_states) / sizeof(uint16_t);
+		filter->states = xmalloc(sizeof(default_states));
+		for (i = 0; i < filter->state_cnt; i++)
+			filter->states[i] = default_states[i];
+	}
+
+	filter->field_mask = _job_field_mask();
+
+	return filter;
+}
+
 /* _print_job - print the specified job's information */
 static int
 _print_job ( bool clear_old )
@@ -179,6 +301,23 @@ _print_job ( bool clear_old )
 	if (params.format && strstr(params.format, "C"))
 		show_flags |= SHOW_DETAIL;
 
+	if (!params.format && !params.format_long) {
+		if (params.long_list) {
+			xstrcat(params.format,
+				"%.18i %.9P %.8j %.8u %.8T %.10M %.9l %.6D %R");
+		} else {
+			xstrcat(params.format,
+				"%.18i %.9P %.8j %.8u %.2t %.10M %.6D %R");
+		}
+	}
+
+	if (!params.format_list) {
+		if (params.format)
+			parse_format(params.format);
+		else if (params.format_long)
+			parse_long_format(params.format_long);
+	}
+
 	if (old_job_ptr) {
 		if (clear_old)
 			old_job_ptr->last_update = 0;
@@ -191,9 +330,10 @@ _print_job ( bool clear_old )
 							 params.user_id,
 							 show_flags);
 		} else {
-			error_code = slurm_load_jobs(
+			error_code = slurm_load_jobs_filter(
 				old_job_ptr->last_update,
-				&new_job_ptr, show_flags);
+				&new_job_ptr, show_flags,
+				_build_job_filter());
 		}
 		if (error_code ==  SLURM_SUCCESS)
 			slurm_free_job_info_msg( old_job_ptr );
@@ -208,8 +348,9 @@ _print_job ( bool clear_old )
 		error_code = slurm_load_job_user(&new_job_ptr, params.user_id,
 						 show_flags);
 	} else {
-		error_code = slurm_load_jobs((time_t) NULL, &new_job_ptr,
-					     show_flags);
+		error_code = slurm_load_jobs_filter((time_t) NULL, &new_job_ptr,
+						    show_flags,
+						    _build_job_filter());
 	}
 
 	if (error_code) {
@@ -226,23 +367,6 @@ _print_job ( bool clear_old )
 			new_job_ptr->record_count);
 	}
 
-	if (!params.format && !params.format_long) {
-		if (params.long_list) {
-			xstrcat(params.format,
-				"%.18i %.9P %.8j %.8u %.8T %.10M %.9l %.6D %R");
-		} else {
-			xstrcat(params.format,
-				"%.18i %.9P %.8j %.8u %.2t %.10M %.6D %R");
-		}
-	}
-
-	if (!params.format_list) {
-		if (params.format)
-			parse_format(params.format);
-		else if (params.format_long)
-			parse_long_format(params.format_long);
-	}
-
 	print_jobs_array(new_job_ptr->job_array, new_job_ptr->record_count,
 			 params.format_list) ;
 	return SLURM_SUCCESS;
@@ -925,8 +925,9 @@ extern int get_new_info_node(node_info_msg_t **info_ptr, int force)
 	if (g_node_info_ptr) {
 		if (show_flags != last_flags)
 			g_node_info_ptr->last_update = 0;
-		error_code = slurm_load_node(g_node_info_ptr->last_update,
-					     &new_node_ptr, show_flags);
+		error_code = slurm_load_node_delta(g_node_info_ptr,
+						   &new_node_ptr, show_flags,
+						   NULL);
 		if (error_code == SLURM_SUCCESS) {
 			slurm_free_node_info_msg(g_node_info_ptr);
 			changed = 1;
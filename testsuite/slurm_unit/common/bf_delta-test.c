@@ -0,0 +1,238 @@
+/* Test of src/plugins/sched/backfill/bf_delta.c
+ *
+ * Checks which changes in resources move a backfill reservation and the
+ * changes found from the end time and suspend state of running jobs, and
+ * times a scan of many running jobs. Usage: bf_delta-test [jobs]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <src/common/bitstring.h>
+#include <src/common/list.h>
+#include <src/common/xmalloc.h>
+#include <src/plugins/sched/backfill/bf_delta.h>
+#include <src/slurmctld/slurmctld.h>
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+#define BASE_TIME	1420070417
+#define NODE_CNT	16
+
+static struct job_record *_job_create(List jobs, uint32_t job_id,
+				      int first_node, int last_node,
+				      time_t end_time)
+{
+	struct job_record *job_ptr = xmalloc(sizeof(struct job_record));
+
+	job_ptr->job_id = job_id;
+	job_ptr->job_state = JOB_RUNNING;
+	job_ptr->end_time = end_time;
+	job_ptr->node_bitmap = bit_alloc(NODE_CNT);
+	bit_nset(job_ptr->node_bitmap, first_node, last_node);
+	list_append(jobs, job_ptr);
+	return job_ptr;
+}
+
+static void _job_free(void *x)
+{
+	struct job_record *job_ptr = (struct job_record *) x;
+
+	FREE_NULL_BITMAP(job_ptr->node_bitmap);
+	xfree(job_ptr);
+}
+
+/* Return the only delta in a list, or NULL if there is not exactly one */
+static bf_delta_t *_only_delta(List deltas)
+{
+	if (list_count(deltas) != 1)
+		return NULL;
+	return (bf_delta_t *) list_peek(deltas);
+}
+
+static long _usec_since(struct timeval *tv1)
+{
+	struct timeval tv2;
+
+	gettimeofday(&tv2, NULL);
+	return (tv2.tv_sec - tv1->tv_sec) * 1000000 +
+	       (tv2.tv_usec - tv1->tv_usec);
+}
+
+int
+main(int argc, char *argv[])
+{
+	note("Testing reservation changes");
+	{
+		time_t now = BASE_TIME;
+		List deltas = list_create(bf_delta_free);
+		bitstr_t *res_bitmap = bit_alloc(NODE_CNT);
+		bitstr_t *other_bitmap = bit_alloc(NODE_CNT);
+		time_t job_start = now + 630, start_time = now + 600;
+		time_t end_time = now + 1200;
+
+		/* Reservation of nodes 0-3 from 600 to 1200 seconds */
+		bit_nset(res_bitmap, 0, 3);
+		bit_nset(other_bitmap, 8, 11);
+		TEST(!bf_delta_affects(deltas, job_start, start_time,
+				       end_time, res_bitmap),
+		     "no changes");
+
+		bf_delta_add(deltas, true, 0, now + 300, 0, other_bitmap);
+		TEST(!bf_delta_affects(deltas, job_start, start_time,
+				       end_time, res_bitmap),
+		     "other nodes freed");
+		bf_delta_add(deltas, true, 0, job_start, 0, res_bitmap);
+		TEST(!bf_delta_affects(deltas, job_start, start_time,
+				       end_time, res_bitmap),
+		     "nodes freed when the job starts");
+		bf_delta_add(deltas, false, 0, now, start_time, res_bitmap);
+		TEST(!bf_delta_affects(deltas, job_start, start_time,
+				       end_time, res_bitmap),
+		     "nodes consumed until the reservation");
+		bf_delta_add(deltas, false, 0, now, now + 3600, other_bitmap);
+		TEST(!bf_delta_affects(deltas, job_start, start_time,
+				       end_time, res_bitmap),
+		     "other nodes consumed");
+		bf_delta_add(deltas, false, 0, now, now, res_bitmap);
+		TEST(list_count(deltas) == 4, "empty change not added");
+
+		bf_delta_add(deltas, true, 0, job_start - 1, 0, res_bitmap);
+		TEST(bf_delta_affects(deltas, job_start, start_time,
+				      end_time, res_bitmap),
+		     "nodes freed before the job starts");
+		list_flush(deltas);
+		bf_delta_add(deltas, false, 0, end_time - 1, end_time + 600,
+			     res_bitmap);
+		TEST(bf_delta_affects(deltas, job_start, start_time,
+				      end_time, res_bitmap),
+		     "nodes consumed during the reservation");
+
+		list_destroy(deltas);
+		FREE_NULL_BITMAP(res_bitmap);
+		FREE_NULL_BITMAP(other_bitmap);
+	}
+
+	note("Testing running job changes");
+	{
+		time_t now = BASE_TIME;
+		List jobs = list_create(_job_free);
+		List deltas = list_create(bf_delta_free);
+		bf_job_ends_t *ends = bf_job_ends_create();
+		struct job_record *job1, *job2, *job3;
+		bf_delta_t *delta;
+
+		job1 = _job_create(jobs, 1, 0, 3, now + 600);
+		job2 = _job_create(jobs, 2, 4, 7, now + 1200);
+		TEST(bf_job_ends_scan(ends, jobs, deltas, now) == 0,
+		     "first scan");
+		TEST(list_count(deltas) == 0, "first scan has no changes");
+
+		job3 = _job_create(jobs, 3, 8, 9, now + 900);
+		TEST(bf_job_ends_scan(ends, jobs, deltas, now + 1) == 0,
+		     "started job not a change");
+
+		job1->end_time = now + 300;
+		TEST(bf_job_ends_scan(ends, jobs, deltas, now + 2) == 1,
+		     "earlier end found");
+		delta = _only_delta(deltas);
+		TEST(delta && delta->freed && (delta->begin_time == now + 300) &&
+		     bit_equal(delta->node_bitmap, job1->node_bitmap),
+		     "earlier end frees nodes");
+		list_flush(deltas);
+
+		job2->end_time = now + 1800;
+		TEST(bf_job_ends_scan(ends, jobs, deltas, now + 3) == 1,
+		     "later end found");
+		delta = _only_delta(deltas);
+		TEST(delta && !delta->freed &&
+		     (delta->begin_time == now + 1200) &&
+		     (delta->end_time == now + 1800),
+		     "later end consumes nodes");
+		list_flush(deltas);
+
+		job3->job_state = JOB_SUSPENDED;
+		TEST(bf_job_ends_scan(ends, jobs, deltas, now + 4) == 1,
+		     "suspend found");
+		delta = _only_delta(deltas);
+		TEST(delta && delta->freed && (delta->begin_time == now + 4) &&
+		     bit_equal(delta->node_bitmap, job3->node_bitmap),
+		     "suspend frees nodes");
+		list_flush(deltas);
+
+		job3->end_time = now + 1000;
+		TEST(bf_job_ends_scan(ends, jobs, deltas, now + 5) == 0,
+		     "suspended job end time ignored");
+
+		job3->job_state = JOB_RUNNING;
+		TEST(bf_job_ends_scan(ends, jobs, deltas, now + 6) == 1,
+		     "resume found");
+		delta = _only_delta(deltas);
+		TEST(delta && !delta->freed && (delta->begin_time == now + 6) &&
+		     (delta->end_time == now + 1000),
+		     "resume consumes nodes");
+		list_flush(deltas);
+
+		job2->job_state = JOB_COMPLETE;
+		job2->end_time = now + 7;
+		TEST(bf_job_ends_scan(ends, jobs, deltas, now + 7) == 0,
+		     "ended job not a change");
+		job2->job_state = JOB_RUNNING;
+		TEST(bf_job_ends_scan(ends, jobs, deltas, now + 8) == 0,
+		     "job not seen by previous scan not a change");
+
+		bf_job_ends_destroy(ends);
+		list_destroy(deltas);
+		list_destroy(jobs);
+	}
+
+	note("Timing scan of running jobs");
+	{
+		time_t now = BASE_TIME;
+		int job_cnt = 20000, i, change_cnt;
+		List jobs = list_create(_job_free);
+		List deltas = list_create(bf_delta_free);
+		bf_job_ends_t *ends = bf_job_ends_create();
+		ListIterator iter;
+		struct job_record *job_ptr;
+		struct timeval tv;
+		long usec;
+
+		if (argc > 1)
+			job_cnt = atoi(argv[1]);
+		for (i = 0; i < job_cnt; i++) {
+			_job_create(jobs, i + 1, i % NODE_CNT, i % NODE_CNT,
+				    now + 600 + i);
+		}
+		(void) bf_job_ends_scan(ends, jobs, deltas, now);
+
+		/* Extend the time limit of one job in a hundred */
+		i = 0;
+		iter = list_iterator_create(jobs);
+		while ((job_ptr = (struct job_record *) list_next(iter))) {
+			if ((i++ % 100) == 0)
+				job_ptr->end_time += 60;
+		}
+		list_iterator_destroy(iter);
+
+		gettimeofday(&tv, NULL);
+		change_cnt = bf_job_ends_scan(ends, jobs, deltas, now + 1);
+		usec = _usec_since(&tv);
+		note("%d running jobs scanned in %ld usec", job_cnt, usec);
+		TEST(change_cnt == ((job_cnt + 99) / 100), "changes found");
+
+		bf_job_ends_destroy(ends);
+		list_destroy(deltas);
+		list_destroy(jobs);
+	}
+	totals();
+	return failed;
+}
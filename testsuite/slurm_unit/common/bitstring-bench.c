@@ -0,0 +1,314 @@
+/* Benchmark of src/common/bitstring.c word level operations
+ *
+ * Usage: bitstring-bench [nbits [iterations]]
+ *
+ * Times each operation on bitmaps of nbits bits against its implementation
+ * before word level scanning and vector kernels were added, and checks that
+ * the results agree. Not run by "make check".
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <src/common/bitstring.h>
+
+static int errors = 0;
+
+static double
+_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+/*
+ * The reference functions are the implementations in bitstring.c before
+ * word level scanning and vector kernels were added, so the speedup shown
+ * is against the code they replaced.
+ */
+#define	_bit_word(bit) 		(((bit) >> BITSTR_SHIFT) + BITSTR_OVERHEAD)
+#define _bitstr_bits(name) 	((name)[1])
+
+/* Keep each reference a real call, as the library functions are */
+#if defined(__GNUC__)
+#  define REF_FUNC	static __attribute__((noinline))
+#else
+#  define REF_FUNC	static
+#endif
+
+#if !defined(USE_64BIT_BITSTR)
+static uint32_t
+_ref_hweight(uint32_t w)
+{
+	uint32_t res;
+
+	res = (w   & 0x55555555) + ((w >> 1)    & 0x55555555);
+	res = (res & 0x33333333) + ((res >> 2)  & 0x33333333);
+	res = (res & 0x0F0F0F0F) + ((res >> 4)  & 0x0F0F0F0F);
+	res = (res & 0x00FF00FF) + ((res >> 8)  & 0x00FF00FF);
+	res = (res & 0x0000FFFF) + ((res >> 16) & 0x0000FFFF);
+
+	return res;
+}
+#else
+static uint64_t
+_ref_hweight(uint64_t w)
+{
+	uint64_t res;
+
+	res = (w   & 0x5555555555555555) + ((w >> 1)    & 0x5555555555555555);
+	res = (res & 0x3333333333333333) + ((res >> 2)  & 0x3333333333333333);
+	res = (res & 0x0F0F0F0F0F0F0F0F) + ((res >> 4)  & 0x0F0F0F0F0F0F0F0F);
+	res = (res & 0x00FF00FF00FF00FF) + ((res >> 8)  & 0x00FF00FF00FF00FF);
+	res = (res & 0x0000FFFF0000FFFF) + ((res >> 16) & 0x0000FFFF0000FFFF);
+	res = (res & 0x00000000FFFFFFFF) + ((res >> 32) & 0x00000000FFFFFFFF);
+
+	return res;
+}
+#endif
+
+REF_FUNC bitoff_t
+_ref_ffs(bitstr_t *b)
+{
+	bitoff_t bit = 0, value = -1;
+
+	while (bit < _bitstr_bits(b) && value == -1) {
+		int32_t word = _bit_word(bit);
+
+		if (b[word] == 0) {
+			bit += sizeof(bitstr_t)*8;
+			continue;
+		}
+		while (bit < _bitstr_bits(b) && _bit_word(bit) == word) {
+			if (bit_test(b, bit)) {
+				value = bit;
+				break;
+			}
+			bit++;
+		}
+	}
+	return value;
+}
+
+REF_FUNC bitoff_t
+_ref_ffc(bitstr_t *b)
+{
+	bitoff_t bit = 0, value = -1;
+
+	while (bit < _bitstr_bits(b) && value == -1) {
+		int32_t word = _bit_word(bit);
+
+		if (b[word] == BITSTR_MAXPOS) {
+			bit += sizeof(bitstr_t)*8;
+			continue;
+		}
+		while (bit < _bitstr_bits(b) && _bit_word(bit) == word) {
+			if (!bit_test(b, bit)) {
+				value = bit;
+				break;
+			}
+			bit++;
+		}
+	}
+	return value;
+}
+
+REF_FUNC bitoff_t
+_ref_nffc(bitstr_t *b, int32_t n)
+{
+	bitoff_t value = -1;
+	bitoff_t bit;
+	int32_t cnt = 0;
+
+	for (bit = 0; bit < _bitstr_bits(b); bit++) {
+		if (bit_test(b, bit)) {		/* fail */
+			cnt = 0;
+		} else {
+			cnt++;
+			if (cnt >= n) {
+				value = bit - (cnt - 1);
+				break;
+			}
+		}
+	}
+
+	return value;
+}
+
+REF_FUNC int32_t
+_ref_set_count(bitstr_t *b)
+{
+	int32_t count = 0;
+	bitoff_t bit, bit_cnt;
+	int32_t word_size = sizeof(bitstr_t) * 8;
+
+	bit_cnt = _bitstr_bits(b);
+	for (bit = 0; (bit + word_size) <= bit_cnt; bit += word_size) {
+		count += _ref_hweight(b[_bit_word(bit)]);
+	}
+	for ( ; bit < bit_cnt; bit++) {
+		if (bit_test(b, bit))
+			count++;
+	}
+	return count;
+}
+
+REF_FUNC int32_t
+_ref_overlap(bitstr_t *b1, bitstr_t *b2)
+{
+	int32_t count = 0;
+	bitoff_t bit, bit_cnt;
+	int32_t word_size = sizeof(bitstr_t) * 8;
+
+	bit_cnt = _bitstr_bits(b1);
+	for (bit = 0; bit < bit_cnt; bit += word_size) {
+		if ((bit + word_size - 1) >= bit_cnt)
+			break;
+		count += _ref_hweight(b1[_bit_word(bit)] & b2[_bit_word(bit)]);
+	}
+	for ( ; bit < bit_cnt; bit++) {
+		if (bit_test(b1, bit) && bit_test(b2, bit))
+			count++;
+	}
+
+	return count;
+}
+
+REF_FUNC int
+_ref_super_set(bitstr_t *b1, bitstr_t *b2)
+{
+	bitoff_t bit;
+
+	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8) {
+		if (b1[_bit_word(bit)] != (b1[_bit_word(bit)] &
+		                           b2[_bit_word(bit)]))
+			return 0;
+	}
+
+	return 1;
+}
+
+REF_FUNC void
+_ref_and(bitstr_t *b1, bitstr_t *b2)
+{
+	bitoff_t bit;
+
+	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8)
+		b1[_bit_word(bit)] &= b2[_bit_word(bit)];
+}
+
+REF_FUNC void
+_ref_not(bitstr_t *b)
+{
+	bitoff_t bit;
+
+	for (bit = 0; bit < _bitstr_bits(b); bit += sizeof(bitstr_t)*8)
+		b[_bit_word(bit)] = ~b[_bit_word(bit)];
+}
+
+/* bit_and_not() replaces a copy, bit_not() and bit_and() */
+REF_FUNC void
+_ref_and_not(bitstr_t *b1, bitstr_t *b2)
+{
+	bitstr_t *tmp = bit_copy(b2);
+
+	_ref_not(tmp);
+	_ref_and(b1, tmp);
+	bit_free(tmp);
+}
+
+static void
+_report(char *name, double ref_time, double new_time, long ref_val,
+	long new_val, int iters)
+{
+	if (ref_val != new_val) {
+		printf("%-16s MISMATCH reference=%ld new=%ld\n",
+		       name, ref_val, new_val);
+		errors++;
+		return;
+	}
+	printf("%-16s %10.3f %10.3f %8.1fx\n", name,
+	       ref_time * 1000000.0 / iters, new_time * 1000000.0 / iters,
+	       (new_time > 0) ? (ref_time / new_time) : 0.0);
+}
+
+#define BENCH(_name, _ref, _new) do {					\
+	long _ref_val = 0, _new_val = 0;				\
+	double _start;							\
+	int _i;								\
+	_start = _now();						\
+	for (_i = 0; _i < iters; _i++)					\
+		_ref_val = (long) (_ref);				\
+	ref_time = _now() - _start;					\
+	_start = _now();						\
+	for (_i = 0; _i < iters; _i++)					\
+		_new_val = (long) (_new);				\
+	new_time = _now() - _start;					\
+	_report(_name, ref_time, new_time, _ref_val, _new_val, iters);	\
+} while (0)
+
+int
+main(int argc, char *argv[])
+{
+	bitoff_t nbits = 100000, bit;
+	int iters = 200, i;
+	double ref_time, new_time;
+	bitstr_t *sparse, *dense, *tmp1, *tmp2;
+
+	if (argc > 1)
+		nbits = atoi(argv[1]);
+	if (argc > 2)
+		iters = atoi(argv[2]);
+	if ((nbits < 64) || (iters < 1)) {
+		fprintf(stderr, "Usage: %s [nbits [iterations]]\n", argv[0]);
+		exit(1);
+	}
+
+	/* sparse: a few bits near the end, dense: mostly full core map */
+	srand(1);
+	sparse = bit_alloc(nbits);
+	dense = bit_alloc(nbits);
+	for (i = 0; i < 8; i++)
+		bit_set(sparse, nbits - 1 - (rand() % (nbits / 16)));
+	bit_nset(dense, 0, nbits - 1);
+	for (bit = 17; bit < (nbits - 64); bit += 17 + (rand() % 64))
+		bit_clear(dense, bit);
+	bit_nset(dense, nbits - 64, nbits - 1);
+	bit_nclear(dense, nbits - 40, nbits - 9);
+	tmp1 = bit_alloc(nbits);
+	tmp2 = bit_alloc(nbits);
+
+	printf("bitstring-bench: %d bits, %d iterations, usec per call\n",
+	       (int) nbits, iters);
+	printf("%-16s %10s %10s %9s\n", "operation", "reference", "new",
+	       "speedup");
+
+	BENCH("bit_ffs", _ref_ffs(sparse), bit_ffs(sparse));
+	BENCH("bit_ffc", _ref_ffc(dense), bit_ffc(dense));
+	BENCH("bit_nffc", _ref_nffc(dense, 30), bit_nffc(dense, 30));
+	BENCH("bit_set_count", _ref_set_count(dense), bit_set_count(dense));
+	BENCH("bit_overlap", _ref_overlap(dense, sparse),
+	      bit_overlap(dense, sparse));
+	/* bit_overlap_any() replaces tests of bit_overlap() != 0 */
+	BENCH("bit_overlap_any", _ref_overlap(sparse, dense) != 0,
+	      bit_overlap_any(sparse, dense));
+
+	bit_copybits(tmp1, dense);
+	bit_copybits(tmp2, dense);
+	BENCH("bit_and_not", (_ref_and_not(tmp1, sparse), 0),
+	      (bit_and_not(tmp2, sparse), 0));
+	if (!bit_equal(tmp1, tmp2)) {
+		printf("%-16s MISMATCH\n", "bit_and_not");
+		errors++;
+	}
+	BENCH("bit_super_set", _ref_super_set(sparse, dense),
+	      bit_super_set(sparse, dense));
+
+	bit_free(sparse);
+	bit_free(dense);
+	bit_free(tmp1);
+	bit_free(tmp2);
+
+	return errors ? 1 : 0;
+}
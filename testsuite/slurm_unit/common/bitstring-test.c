@@ -1,7 +1,9 @@
 /* Test of src/bitstring.c 
  */
 #include <stdlib.h>
+#include <src/common/bitrle.h>
 #include <src/common/bitstring.h>
+#include <src/common/xmalloc.h>
 #include <sys/time.h>
 #include <testsuite/dejagnu.h>
 
@@ -108,6 +110,43 @@ main(int argc, char *argv[])
 		bit_free(bs2);
 	}
 
+	note("Testing word level operations");
+	{
+		bitstr_t *bs1 = bit_alloc(1000);
+		bitstr_t *bs2 = bit_alloc(1000);
+
+		bit_nset(bs1, 30, 700);
+		bit_nset(bs2, 650, 999);
+		TEST(bit_overlap(bs1, bs2) == 51, "overlap");
+		TEST(bit_overlap_any(bs1, bs2), "overlap_any");
+		bit_and_not(bs1, bs2);
+		TEST(bit_fls(bs1) == 649, "and_not");
+		TEST(bit_set_count(bs1) == 620, "and_not");
+		TEST(bit_test(bs2, 650), "and_not leaves b2");
+		TEST(!bit_overlap_any(bs1, bs2), "overlap_any");
+		TEST(bit_set_count_range(bs1, 31, 64) == 33, "count_range");
+		TEST(bit_set_count_range(bs1, 40, 45) == 5, "count_range");
+		TEST(bit_get_bit_num(bs1, 100) == 130, "get_bit_num");
+		TEST(bit_get_pos_num(bs1, 130) == 100, "get_pos_num");
+		TEST(bit_nset_max_count(bs1) == 620, "nset_max_count");
+
+		/* bits past the end of the bitmap must be ignored */
+		bit_not(bs2);
+		TEST(bit_set_count(bs2) == 650, "not count");
+		TEST(bit_fls(bs2) == 649, "not fls");
+		TEST(bit_ffc(bs2) == 650, "not ffc");
+		bit_nset(bs2, 650, 999);
+		TEST(bit_ffc(bs2) == -1, "ffc full");
+		TEST(bit_super_set(bs1, bs2), "super_set");
+		bit_clear(bs2, 31);
+		TEST(!bit_super_set(bs1, bs2), "super_set");
+		TEST(bit_nffc(bs2, 1) == 31, "nffc");
+		TEST(bit_noc(bs2, 1, 500) == 31, "noc");
+
+		bit_free(bs1);
+		bit_free(bs2);
+	}
+
 	note("testing bit selection");
 	{
 		bitstr_t *bs1 = bit_alloc(128), *bs2;
@@ -202,6 +241,59 @@ main(int argc, char *argv[])
 		TEST(bit_equal(bs, bs2), "bitstring");
 	}
 
+	note("Testing run length bitmaps");
+	{
+		bitstr_t *bs = bit_alloc(1024), *bs2;
+		bitrle_t *r, *r2;
+		char *str;
+
+		bit_set(bs, 0);
+		bit_nset(bs, 40, 70);
+		bit_nset(bs, 500, 1023);
+		r = bit_rle_from_bitstr(bs);
+		TEST(bit_rle_size(r) == 1024, "rle size");
+		TEST(bit_rle_set_count(r) == 556, "rle set_count");
+		TEST(bit_rle_test(r, 0), "rle test");
+		TEST(!bit_rle_test(r, 1), "rle test");
+		TEST(bit_rle_test(r, 70), "rle test");
+		TEST(!bit_rle_test(r, 71), "rle test");
+		TEST(bit_rle_test(r, 1023), "rle test");
+
+		bs2 = bit_rle_to_bitstr(r);
+		TEST(bit_equal(bs, bs2), "rle to_bitstr");
+		bit_nclear(bs2, 0, 1023);
+		bit_nset(bs2, 60, 600);
+		TEST(bit_rle_overlap(r, bs2) == 112, "rle overlap");
+		bit_rle_and_not(bs2, r);
+		TEST(bit_set_count(bs2) == 429, "rle and_not");
+		TEST(bit_ffs(bs2) == 71, "rle and_not");
+		bit_rle_or(bs2, r);
+		TEST(bit_set_count(bs2) == 985, "rle or");
+		FREE_NULL_BITMAP(bs2);
+
+		str = bit_rle_fmt(r);
+		TEST(!strcmp(str, "0,40-70,500-1023"), "rle fmt");
+		r2 = bit_rle_unfmt(1024, str);
+		TEST(r2 && (bit_rle_set_count(r2) == 556), "rle unfmt");
+		xfree(str);
+		FREE_NULL_BITRLE(r);
+		r = bit_rle_copy(r2);
+		FREE_NULL_BITRLE(r2);
+		str = bit_rle_fmt(r);
+		TEST(!strcmp(str, "0,40-70,500-1023"), "rle copy");
+		xfree(str);
+		r2 = bit_rle_unfmt(1024, "1-2,3-4");
+		str = bit_rle_fmt(r2);
+		TEST(!strcmp(str, "1-4"), "rle unfmt merge");
+		xfree(str);
+		FREE_NULL_BITRLE(r2);
+		TEST(bit_rle_unfmt(1024, "1000-1024") == NULL, "rle unfmt range");
+		TEST(bit_rle_unfmt(1024, "5,2") == NULL, "rle unfmt order");
+
+		FREE_NULL_BITRLE(r);
+		bit_free(bs);
+	}
+
 	totals();
 	return failed;
 }
@@ -0,0 +1,162 @@
+/* Benchmark of message compression in src/common/pack.c
+ *
+ * Usage: compress-bench [records [iterations]]
+ *
+ * Packs a node information like message of the given number of records,
+ * plus random data of the same size, then times compressing and
+ * decompressing them and reports the time to send each message over
+ * 1 and 10 Gb/s links with and without compression. Not run by
+ * "make check".
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <src/common/pack.h>
+#include <src/common/xmalloc.h>
+
+static int errors = 0;
+
+static double
+_now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+/* Pack records similar to those of a node information response */
+static Buf
+_pack_nodes(int records)
+{
+	static char *states[] = { "IDLE", "ALLOCATED", "MIXED", "DOWN" };
+	char name[64], str[256];
+	Buf buffer = init_buf(BUF_SIZE);
+	int i;
+
+	pack32(records, buffer);
+	pack_time(time(NULL), buffer);
+	for (i = 0; i < records; i++) {
+		snprintf(name, sizeof(name), "nid%05d", i);
+		packstr(name, buffer);		/* name */
+		packstr(name, buffer);		/* node_hostname */
+		packstr(name, buffer);		/* node_addr */
+		pack32(rand() % 4, buffer);	/* node_state */
+		packstr("15.08.0-0pre1", buffer);
+		pack16(2, buffer);		/* boards */
+		pack16(2, buffer);		/* sockets */
+		pack16(16, buffer);		/* cores */
+		pack16(2, buffer);		/* threads */
+		pack32(128 * 1024, buffer);	/* real_memory */
+		pack32(1024 * 1024, buffer);	/* tmp_disk */
+		pack32(rand() % 64, buffer);	/* cpu_load */
+		pack32(1, buffer);		/* weight */
+		pack16(rand() % 65, buffer);	/* alloc_cpus */
+		pack_time(time(NULL) - (rand() % 86400), buffer);
+		pack_time(time(NULL) - (rand() % 3600), buffer);
+		packstr("haswell,ib,ssd", buffer);	/* features */
+		packstr("gpu:k80:4", buffer);		/* gres */
+		packstr("Linux", buffer);		/* os */
+		snprintf(str, sizeof(str), "%s", states[rand() % 4]);
+		packstr(str, buffer);		/* reason */
+		pack32(0, buffer);		/* reason_uid */
+		pack_time(0, buffer);		/* reason_time */
+		pack16(0, buffer);		/* energy */
+		pack64(rand(), buffer);
+	}
+	return buffer;
+}
+
+static Buf
+_pack_random(uint32_t size)
+{
+	Buf buffer = init_buf(size);
+	uint32_t i;
+
+	for (i = 0; i < size / sizeof(uint32_t); i++)
+		pack32((uint32_t) rand(), buffer);
+	return buffer;
+}
+
+static void
+_bench(char *name, Buf in, int iters)
+{
+	uint32_t size = get_buf_offset(in), csize = 0;
+	double start, ctime, dtime;
+	Buf out = NULL, copy;
+	int i;
+
+	start = _now();
+	for (i = 0; i < iters; i++) {
+		if (out)
+			free_buf(out);
+		out = init_buf(size);
+		if (pack_compressed(get_buf_data(in), size, out)) {
+			printf("%-8s %10u bytes, does not compress\n", name,
+			       size);
+			free_buf(out);
+			return;
+		}
+	}
+	ctime = (_now() - start) / iters;
+	csize = get_buf_offset(out);
+
+	start = _now();
+	for (i = 0; i < iters; i++) {
+		copy = create_buf(xmalloc(csize), csize);
+		memcpy(get_buf_data(copy), get_buf_data(out), csize);
+		if (buf_decompress(copy) ||
+		    (remaining_buf(copy) != size) ||
+		    memcmp(get_buf_data(copy), get_buf_data(in), size)) {
+			printf("%-8s MISMATCH\n", name);
+			errors++;
+			free_buf(copy);
+			break;
+		}
+		free_buf(copy);
+	}
+	dtime = (_now() - start) / iters;
+	free_buf(out);
+
+	printf("%-8s %10u %10u %6.2f %9.1f %9.1f "
+	       "%8.2f %8.2f %8.2f %8.2f\n", name, size, csize,
+	       (double) size / csize,
+	       size / ctime / 1000000.0, size / dtime / 1000000.0,
+	       size * 8 / 1.0e9 * 1000.0,
+	       (csize * 8 / 1.0e9 + ctime + dtime) * 1000.0,
+	       size * 8 / 1.0e10 * 1000.0,
+	       (csize * 8 / 1.0e10 + ctime + dtime) * 1000.0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int records = 10000, iters = 20;
+	Buf nodes, random;
+
+	if (argc > 1)
+		records = atoi(argv[1]);
+	if (argc > 2)
+		iters = atoi(argv[2]);
+	if ((records < 1) || (iters < 1)) {
+		fprintf(stderr, "Usage: %s [records [iterations]]\n", argv[0]);
+		exit(1);
+	}
+
+	srand(1);
+	nodes = _pack_nodes(records);
+	random = _pack_random(get_buf_offset(nodes));
+
+	printf("compress-bench: %d records, %d iterations\n", records, iters);
+	printf("%-8s %10s %10s %6s %9s %9s %8s %8s %8s %8s\n", "data",
+	       "bytes", "compressed", "ratio", "comp_MB/s", "decomp_MB/s",
+	       "1Gb_ms", "1Gb_z_ms", "10Gb_ms", "10Gb_z_ms");
+	_bench("nodes", nodes, iters);
+	_bench("random", random, iters);
+
+	free_buf(nodes);
+	free_buf(random);
+
+	return errors ? 1 : 0;
+}
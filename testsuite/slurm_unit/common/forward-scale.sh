@@ -0,0 +1,204 @@
+#!/bin/sh
+# Scale test of message forwarding in src/common/forward.c
+#
+# Usage: forward-scale.sh [nodes [iterations [tree_width]]]
+#
+# Starts a private cluster of one slurmctld and the given number of slurmd
+# daemons on this host, all from an installation configured with
+# --enable-multiple-slurmd. A small TreeWidth makes the slurmd daemons
+# forward messages to each other. It then times launching a step on every
+# node (forwarded by srun and the slurmd) and terminating the job
+# (forwarded by slurmctld and the slurmd), reporting the most threads any
+# slurmd used. Run as root, as slurmd must launch the tasks. Not run by
+# "make check".
+#
+# Environment:
+#   SLURM_PREFIX - installation directory (default /usr/local)
+#   FS_PORT      - first TCP port to use, one per slurmd plus one for
+#                  slurmctld (default 17900)
+#   FS_KEEP      - if set, keep the cluster's directory for examination
+
+nodes=${1:-100}
+iters=${2:-5}
+width=${3:-5}
+prefix=${SLURM_PREFIX:-/usr/local}
+port=${FS_PORT:-17900}
+
+if [ "$nodes" -lt 2 ] || [ "$iters" -lt 1 ] || [ "$width" -lt 1 ]; then
+	echo "Usage: $0 [nodes [iterations [tree_width]]]" >&2
+	exit 1
+fi
+for prog in sbin/slurmctld sbin/slurmd bin/srun bin/sbatch bin/scontrol; do
+	if [ ! -x $prefix/$prog ]; then
+		echo "$0: $prefix/$prog not found, set SLURM_PREFIX" >&2
+		exit 1
+	fi
+done
+
+dir=`mktemp -d /tmp/forward-scale.XXXXXX` || exit 1
+PATH=$prefix/bin:$prefix/sbin:$PATH
+SLURM_CONF=$dir/slurm.conf
+export PATH SLURM_CONF
+errors=0
+
+cleanup() {
+	scontrol shutdown >/dev/null 2>&1
+	sleep 2
+	for pidfile in $dir/slurmd-*.pid; do
+		[ -f $pidfile ] && kill `cat $pidfile` 2>/dev/null
+	done
+	if [ -z "$FS_KEEP" ]; then
+		rm -rf $dir
+	else
+		echo "cluster files kept in $dir"
+	fi
+}
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+
+now() {
+	date +%s.%N
+}
+
+# Seconds elapsed since $1
+since() {
+	awk "BEGIN { print `now` - $1 }"
+}
+
+# Most threads of any slurmd of the cluster, from the Threads: line of
+# /proc/<pid>/status, read without starting a process for each slurmd
+max_threads() {
+	max=0
+	for pidfile in $dir/slurmd-*.pid; do
+		[ -f $pidfile ] && read pid <$pidfile || continue
+		[ -r /proc/$pid/status ] || continue
+		while read key cnt; do
+			[ "$key" = "Threads:" ] || continue
+			[ -n "$cnt" ] && [ $cnt -gt $max ] && max=$cnt
+			break
+		done </proc/$pid/status
+	done
+	echo $max
+}
+
+# Record in $dir/threads the most threads of any slurmd, sampled every
+# tenth of a second until $dir/sampling is removed
+sample_threads() {
+	peak=0
+	while [ -f $dir/sampling ]; do
+		cnt=`max_threads`
+		[ $cnt -gt $peak ] && peak=$cnt
+		sleep 0.1
+	done
+	echo $peak >$dir/threads
+}
+
+# Job $1 is still in the queue
+job_queued() {
+	[ -n "`squeue -h -j $1 -t PD,R,CG -o %t 2>/dev/null`" ]
+}
+
+openssl genrsa -out $dir/key 1024 >/dev/null 2>&1 &&
+openssl rsa -in $dir/key -pubout -out $dir/cert >/dev/null 2>&1 || {
+	echo "$0: openssl failed to create the job credential keys" >&2
+	exit 1
+}
+mkdir $dir/state $dir/spool
+
+last=`expr $nodes - 1`
+cat >$SLURM_CONF <<EOF
+ClusterName=fwdscale
+ControlMachine=`hostname -s`
+ControlAddr=127.0.0.1
+SlurmUser=`id -un`
+SlurmctldPort=$port
+SlurmdPort=`expr $port + 1`
+StateSaveLocation=$dir/state
+SlurmdSpoolDir=$dir/spool/%n
+SlurmctldPidFile=$dir/slurmctld.pid
+SlurmdPidFile=$dir/slurmd-%n.pid
+SlurmctldLogFile=$dir/slurmctld.log
+SlurmdLogFile=$dir/slurmd-%n.log
+PluginDir=$prefix/lib/slurm
+AuthType=auth/none
+CryptoType=crypto/openssl
+JobCredentialPrivateKey=$dir/key
+JobCredentialPublicCertificate=$dir/cert
+SelectType=select/linear
+ProctrackType=proctrack/pgid
+MpiDefault=none
+FastSchedule=2
+ReturnToService=2
+TreeWidth=$width
+NodeName=fs[0-$last] NodeHostname=localhost NodeAddr=127.0.0.1 Port=[`expr $port + 1`-`expr $port + $nodes`] CPUs=1 State=UNKNOWN
+PartitionName=fs Nodes=fs[0-$last] Default=YES MaxTime=INFINITE State=UP
+EOF
+
+echo "forward-scale: $nodes nodes, $iters iterations, TreeWidth=$width"
+slurmctld || exit 1
+i=0
+while [ $i -lt $nodes ]; do
+	slurmd -N fs$i || exit 1
+	i=`expr $i + 1`
+done
+
+# Wait for every slurmd to register
+i=0
+while [ "`sinfo -h -t idle -o %D`" != "$nodes" ]; do
+	i=`expr $i + 1`
+	if [ $i -gt 60 ]; then
+		echo "$0: nodes not idle:" >&2
+		sinfo >&2
+		exit 1
+	fi
+	sleep 1
+done
+echo "slurmd threads idle: `max_threads`"
+
+i=0
+while [ $i -lt $iters ]; do
+	i=`expr $i + 1`
+	job=`sbatch -N$nodes -o /dev/null --parsable --wrap "sleep 600"`
+	if [ -z "$job" ]; then
+		echo "$0: sbatch failed" >&2
+		exit 1
+	fi
+	while [ "`squeue -h -j $job -o %t`" != "R" ]; do
+		sleep 1
+	done
+
+	touch $dir/sampling
+	sample_threads &
+	start=`now`
+	if ! srun --jobid=$job -N$nodes -n$nodes true; then
+		echo "$0: srun failed" >&2
+		errors=`expr $errors + 1`
+	fi
+	launch=`since $start`
+
+	start=`now`
+	scancel $job
+	while job_queued $job; do
+		sleep 0.1
+	done
+	term=`since $start`
+	rm -f $dir/sampling
+	wait
+	threads=`cat $dir/threads`
+	printf "iteration %d: launch %.3fs terminate %.3fs slurmd threads %d\n" \
+	       $i $launch $term $threads
+done
+
+if [ "`sinfo -h -t idle -o %D`" != "$nodes" ]; then
+	echo "$0: nodes not idle after test:" >&2
+	sinfo >&2
+	errors=`expr $errors + 1`
+fi
+if grep -q "failed to forward\|problem with forward" $dir/slurm*.log; then
+	echo "$0: forwarding errors logged:" >&2
+	grep -h "failed to forward\|problem with forward" $dir/slurm*.log | \
+		head >&2
+	errors=`expr $errors + 1`
+fi
+
+[ $errors -eq 0 ]
@@ -0,0 +1,324 @@
+/* Test of src/slurmctld/job_mgr.c
+ *
+ * Checks that any change to a job record, whether reported with
+ * job_changed() or not, replaces the job's cached record packed by
+ * pack_all_jobs() and is written to the job state journal, so that it is
+ * recovered by load_all_job_state(). Links the slurmctld objects other than
+ * controller.o, whose definitions are given here, and uses a slurm.conf of
+ * its own with select/linear and checkpoint/none from the build tree.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <src/common/checkpoint.h>
+#include <src/common/list.h>
+#include <src/common/log.h>
+#include <src/common/pack.h>
+#include <src/common/xmalloc.h>
+#include <src/common/xstring.h>
+#include <src/slurmctld/slurmctld.h>
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+/* Definitions of src/slurmctld/controller.c */
+int accounting_enforce = 0;
+void *acct_db_conn = NULL;
+int association_based_accounting = 0;
+int batch_sched_delay = 3;
+uint32_t cluster_cpus = 0;
+time_t last_proc_req_start = 0;
+bool ping_nodes_now = false;
+int sched_interval = 60;
+char *slurmctld_cluster_name = NULL;
+slurmctld_config_t slurmctld_config;
+diag_stats_t slurmctld_diag_stats;
+int slurmctld_primary = 1;
+bool want_nodes_reboot = false;
+int with_slurmdbd = 0;
+
+void ctld_assoc_mgr_init(slurm_trigger_callbacks_t *callbacks) { }
+void queue_job_scheduler(void) { }
+void save_all_state(void) { }
+void send_all_to_accounting(time_t event_time) { }
+void set_cluster_cpus(void) { }
+void set_slurmctld_state_loc(void) { }
+int slurmctld_shutdown(void) { return SLURM_SUCCESS; }
+void update_logging(void) { }
+
+/* Write a slurm.conf using plugins from the build tree */
+static char *_write_conf(char *state_dir)
+{
+	char *conf = xstrdup("/tmp/job_mgr-test.XXXXXX");
+	FILE *fp;
+	int fd;
+
+	if ((fd = mkstemp(conf)) < 0) {
+		xfree(conf);
+		return NULL;
+	}
+	fp = fdopen(fd, "w");
+	fprintf(fp, "ClusterName=jobmgr\n");
+	fprintf(fp, "ControlMachine=localhost\n");
+	fprintf(fp, "PluginDir=%s\n", PLUGIN_DIRS);
+	fprintf(fp, "SelectType=select/linear\n");
+	fprintf(fp, "CheckpointType=checkpoint/none\n");
+	fprintf(fp, "StateSaveLocation=%s\n", state_dir);
+	fclose(fp);
+	return conf;
+}
+
+static struct job_record *_job_create(uint32_t job_id, time_t now)
+{
+	struct job_record *job_ptr = xmalloc(sizeof(struct job_record));
+	struct job_details *detail_ptr = xmalloc(sizeof(struct job_details));
+
+	job_ptr->magic = JOB_MAGIC;
+	job_ptr->job_id = job_id;
+	job_ptr->array_task_id = NO_VAL;
+	job_ptr->user_id = getuid();
+	job_ptr->group_id = getgid();
+	job_ptr->job_state = JOB_PENDING;
+	job_ptr->state_reason = WAIT_RESOURCES;
+	job_ptr->priority = 100;
+	job_ptr->time_limit = 60;
+	job_ptr->name = xstrdup("test");
+	job_ptr->partition = xstrdup("debug");
+	job_ptr->step_list = list_create(NULL);
+	detail_ptr->magic = DETAILS_MAGIC;
+	detail_ptr->submit_time = now;
+	detail_ptr->min_cpus = 1;
+	detail_ptr->min_nodes = 1;
+	detail_ptr->num_tasks = 1;
+	job_ptr->details = detail_ptr;
+	list_append(job_list, job_ptr);
+	return job_ptr;
+}
+
+/* Pack all jobs as for a full load of job information
+ * RET the message's data, of size bytes */
+static char *_pack_all(uint32_t *size)
+{
+	BufChain chain = NULL;
+	struct iovec *iov;
+	char *data;
+	int i, cnt;
+
+	pack_all_jobs(&chain, 0, 0, NO_VAL, NULL, 0, SLURM_PROTOCOL_VERSION);
+	*size = size_buf_chain(chain);
+	data = xmalloc(*size);
+	iov = xmalloc(sizeof(struct iovec) * chain->seg_cnt);
+	cnt = buf_chain_iovec(chain, iov);
+	for (i = 0, *size = 0; i < cnt; i++) {
+		memcpy(data + *size, iov[i].iov_base, iov[i].iov_len);
+		*size += iov[i].iov_len;
+	}
+	xfree(iov);
+	free_buf_chain(chain);
+	return data;
+}
+
+static bool _contains(char *data, uint32_t size, char *rec, uint32_t len)
+{
+	uint32_t i;
+
+	for (i = 0; i + len <= size; i++) {
+		if (!memcmp(data + i, rec, len))
+			return true;
+	}
+	return false;
+}
+
+/* Return true if a full load of job information reports the job as
+ * pack_job() does now */
+static bool _pack_current(struct job_record *job_ptr)
+{
+	Buf buffer = init_buf(BUF_SIZE);
+	char *data;
+	uint32_t size;
+	bool found;
+
+	pack_job(job_ptr, 0, JOB_FIELD_ALL, buffer, SLURM_PROTOCOL_VERSION, 0);
+	data = _pack_all(&size);
+	found = _contains(data, size, get_buf_data(buffer),
+			  get_buf_offset(buffer));
+	xfree(data);
+	free_buf(buffer);
+	return found;
+}
+
+/* Pack all jobs as _pack_current() does
+ * IN/OUT cached - the job's cached record for a full load, held by the
+ *	caller, replaced with its current one
+ * RET true if the job is reported as packed now and its cached record was
+ *	replaced */
+static bool _repacked(struct job_record *job_ptr, BufShared *cached)
+{
+	BufShared old_cached = *cached;
+	bool current = _pack_current(job_ptr);
+
+	*cached = NULL;
+	if (job_ptr->pack_cache && job_ptr->pack_cache[0].data)
+		*cached = hold_buf_shared(job_ptr->pack_cache[0].data);
+	if (old_cached)
+		release_buf_shared(old_cached);
+	return current && *cached && (*cached != old_cached);
+}
+
+/* Remove all jobs from the job list, as lost when slurmctld stops */
+static void _jobs_lost(void)
+{
+	ListIterator job_iterator = list_iterator_create(job_list);
+
+	while (list_next(job_iterator))
+		(void) list_remove(job_iterator);
+	list_iterator_destroy(job_iterator);
+}
+
+static off_t _file_size(char *dir, char *name)
+{
+	struct stat stat_buf;
+	char *file = NULL;
+	off_t size = -1;
+
+	xstrfmtcat(file, "%s/%s", dir, name);
+	if (stat(file, &stat_buf) == 0)
+		size = stat_buf.st_size;
+	xfree(file);
+	return size;
+}
+
+static void _remove_state(char *dir)
+{
+	char *file = NULL;
+
+	xstrfmtcat(file, "%s/job_state", dir);
+	(void) unlink(file);
+	xstrcat(file, ".old");
+	(void) unlink(file);
+	xfree(file);
+	xstrfmtcat(file, "%s/job_state.journal", dir);
+	(void) unlink(file);
+	xfree(file);
+	(void) rmdir(dir);
+}
+
+int
+main(int argc, char *argv[])
+{
+	log_options_t log_opts = LOG_OPTS_STDERR_ONLY;
+	struct job_record *job_ptr, *other_job_ptr;
+	BufShared cached = NULL;
+	char *conf, state_dir[] = "/tmp/job_mgr-test.XXXXXX";
+	time_t now = time(NULL);
+	off_t journal_size;
+
+	log_opts.stderr_level = LOG_LEVEL_FATAL;
+	log_init("job_mgr-test", log_opts, 0, NULL);
+	if (!mkdtemp(state_dir) || !(conf = _write_conf(state_dir))) {
+		fail("write slurm.conf");
+		totals();
+		return failed;
+	}
+	setenv("SLURM_CONF", conf, 1);
+	if (checkpoint_init("checkpoint/none") != SLURM_SUCCESS) {
+		fail("load plugins");
+		unlink(conf);
+		_remove_state(state_dir);
+		totals();
+		return failed;
+	}
+	slurmctld_conf.max_job_cnt = 10000;
+	slurmctld_conf.state_save_location = xstrdup(state_dir);
+	init_job_conf();
+	rehash_jobs();
+	init_part_conf();
+	/* Records are cached once partitions are a second old */
+	last_part_update = now - 1;
+
+	note("Testing packed job cache");
+	{
+		job_ptr = _job_create(1001, now);
+		TEST(_repacked(job_ptr, &cached), "job packed and cached");
+		TEST(!_repacked(job_ptr, &cached) && _pack_current(job_ptr),
+		     "cached job record reused");
+
+		/* Changes not reported with job_changed() */
+		job_ptr->job_state = JOB_CANCELLED;
+		job_ptr->end_time = now;
+		TEST(_repacked(job_ptr, &cached), "cancelled job repacked");
+
+		job_ptr->state_reason = WAIT_PRIORITY;
+		TEST(_repacked(job_ptr, &cached),
+		     "job with new reason repacked");
+
+		job_ptr->start_time = now + 3600;
+		TEST(_repacked(job_ptr, &cached),
+		     "job with new start time repacked");
+
+		/* A string changed in place */
+		job_ptr->name[0] = 'T';
+		TEST(_repacked(job_ptr, &cached),
+		     "job with new name repacked");
+
+		/* Fields which are not packed are ignored */
+		job_ptr->time_last_active = now + 60;
+		TEST(!_repacked(job_ptr, &cached) && _pack_current(job_ptr),
+		     "job with new activity time not repacked");
+		release_buf_shared(cached);
+	}
+
+	note("Testing job state journal");
+	{
+		job_ptr = _job_create(1002, now);
+		other_job_ptr = _job_create(1003, now);
+		TEST((dump_all_job_state() == SLURM_SUCCESS) &&
+		     (_file_size(state_dir, "job_state") > 0),
+		     "job state snapshot written");
+		journal_size = _file_size(state_dir, "job_state.journal");
+
+		/* Changes not reported with job_changed() */
+		job_ptr->job_state = JOB_CANCELLED;
+		job_ptr->end_time = now;
+		job_ptr->db_index = 77;
+		TEST((dump_all_job_state() == SLURM_SUCCESS) &&
+		     (_file_size(state_dir, "job_state.journal") >
+		      journal_size),
+		     "changed job journaled");
+		journal_size = _file_size(state_dir, "job_state.journal");
+		TEST((dump_all_job_state() == SLURM_SUCCESS) &&
+		     (_file_size(state_dir, "job_state.journal") ==
+		      journal_size),
+		     "unchanged jobs not journaled");
+
+		/* Jobs are recovered beyond MaxJobCount */
+		_jobs_lost();
+		slurmctld_conf.max_job_cnt = 2;
+		TEST((load_all_job_state() == SLURM_SUCCESS) &&
+		     find_job_record(1001),
+		     "job state recovered");
+		job_ptr = find_job_record(1002);
+		TEST(job_ptr && (job_ptr->job_state == JOB_CANCELLED) &&
+		     (job_ptr->end_time == now) && (job_ptr->db_index == 77),
+		     "changed job recovered");
+		other_job_ptr = find_job_record(1003);
+		TEST(other_job_ptr && (other_job_ptr->job_state == JOB_PENDING),
+		     "unchanged job recovered");
+	}
+
+	unlink(conf);
+	xfree(conf);
+	_remove_state(state_dir);
+	totals();
+	return failed;
+}
@@ -0,0 +1,168 @@
+/* Test and microbenchmark of src/common/lhash.c
+ */
+#include <stddef.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <src/common/lhash.h>
+#include <src/common/xmalloc.h>
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+#define BENCH_RECS	1000000
+
+typedef struct test_rec {
+	uint32_t id;
+	uint32_t array_id;
+	struct test_rec *next;
+} test_rec_t;
+
+static uint32_t _rec_key(void *rec)
+{
+	return ((test_rec_t *) rec)->id;
+}
+
+static uint32_t _rec_array_key(void *rec)
+{
+	return ((test_rec_t *) rec)->array_id;
+}
+
+static test_rec_t *_find(lhash_t *table, uint32_t id)
+{
+	test_rec_t *rec = lhash_first(table, id);
+
+	while (rec && (rec->id != id))
+		rec = rec->next;
+	return rec;
+}
+
+static long _usec_since(struct timeval *tv1)
+{
+	struct timeval tv2;
+
+	gettimeofday(&tv2, NULL);
+	return (tv2.tv_sec - tv1->tv_sec) * 1000000 +
+	       (tv2.tv_usec - tv1->tv_usec);
+}
+
+int
+main(int argc, char *argv[])
+{
+	note("Testing basic functions");
+	{
+		lhash_t *table = lhash_create(4,
+					      offsetof(test_rec_t, next),
+					      _rec_key);
+		test_rec_t *recs = xmalloc(sizeof(test_rec_t) * 1000);
+		int i, found = 0;
+
+		TEST(lhash_size(table) == 4, "initial size");
+		TEST(lhash_first(table, 1) == NULL, "empty table");
+		for (i = 0; i < 1000; i++) {
+			recs[i].id = i * 7;
+			lhash_add(table, &recs[i]);
+		}
+		TEST(lhash_count(table) == 1000, "count after add");
+		TEST(lhash_size(table) >= 1000, "table grew");
+		for (i = 0; i < 1000; i++) {
+			if (_find(table, i * 7) == &recs[i])
+				found++;
+		}
+		TEST(found == 1000, "find all records");
+		TEST(_find(table, 3) == NULL, "find missing record");
+
+		for (i = 0; i < 1000; i += 2)
+			TEST(lhash_remove(table, &recs[i]), "remove");
+		TEST(!lhash_remove(table, &recs[0]), "remove twice");
+		TEST(lhash_count(table) == 500, "count after remove");
+		for (i = 1, found = 0; i < 1000; i += 2) {
+			if (_find(table, i * 7) == &recs[i])
+				found++;
+		}
+		TEST(found == 500, "find remaining records");
+		TEST(_find(table, 14) == NULL, "find removed record");
+
+		for (i = 1; i < 1000; i += 2)
+			lhash_remove(table, &recs[i]);
+		TEST(lhash_count(table) == 0, "table empty");
+		TEST(lhash_size(table) == 4, "table shrank");
+		lhash_destroy(table);
+		xfree(recs);
+	}
+
+	note("Testing records sharing a key");
+	{
+		lhash_t *table = lhash_create(1,
+					      offsetof(test_rec_t, next),
+					      _rec_array_key);
+		test_rec_t *recs = xmalloc(sizeof(test_rec_t) * 2000);
+		test_rec_t *rec;
+		int i, cnt = 0;
+		uint32_t last_id = 0;
+		bool ordered = true;
+
+		for (i = 0; i < 2000; i++) {
+			recs[i].id = i;
+			recs[i].array_id = i % 10;
+			lhash_add(table, &recs[i]);
+		}
+		/* Records are walked newest first, despite splits */
+		for (rec = lhash_first(table, 3); rec; rec = rec->next) {
+			if (rec->array_id != 3)
+				continue;
+			if (cnt && (rec->id >= last_id))
+				ordered = false;
+			last_id = rec->id;
+			cnt++;
+		}
+		TEST(cnt == 200, "walk records of key");
+		TEST(ordered, "chain order preserved");
+		lhash_destroy(table);
+		xfree(recs);
+	}
+
+	note("Benchmarking %d records", BENCH_RECS);
+	{
+		lhash_t *table = lhash_create(1024,
+					      offsetof(test_rec_t, next),
+					      _rec_key);
+		test_rec_t *recs = xmalloc(sizeof(test_rec_t) * BENCH_RECS);
+		struct timeval tv;
+		int i, found = 0;
+
+		gettimeofday(&tv, NULL);
+		for (i = 0; i < BENCH_RECS; i++) {
+			recs[i].id = i + 1;
+			lhash_add(table, &recs[i]);
+		}
+		note("add: %ld usec, %u buckets", _usec_since(&tv),
+		     lhash_size(table));
+
+		gettimeofday(&tv, NULL);
+		for (i = 0; i < BENCH_RECS; i++) {
+			if (_find(table, i + 1))
+				found++;
+		}
+		note("find: %ld usec", _usec_since(&tv));
+		TEST(found == BENCH_RECS, "find all records");
+
+		gettimeofday(&tv, NULL);
+		for (i = 0; i < BENCH_RECS; i++)
+			lhash_remove(table, &recs[i]);
+		note("remove: %ld usec, %u buckets", _usec_since(&tv),
+		     lhash_size(table));
+		TEST(lhash_count(table) == 0, "remove all records");
+		lhash_destroy(table);
+		xfree(recs);
+	}
+
+	totals();
+	return failed;
+}
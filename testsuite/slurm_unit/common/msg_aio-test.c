@@ -0,0 +1,443 @@
+/* Test of src/common/msg_aio.c
+ *
+ * Sends messages to nodes played by threads of this program listening on
+ * local ports and checks the responses collected by the engine: a
+ * connection retried until the node listens, a tree request falling back
+ * to the next nodes when the first ones fail, and requests left without
+ * a response until their deadline. Uses a slurm.conf of its own with
+ * auth/none from the build tree.
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <src/common/forward.h>
+#include <src/common/hostlist.h>
+#include <src/common/msg_aio.h>
+#include <src/common/pack.h>
+#include <src/common/slurm_auth.h>
+#include <src/common/slurm_protocol_api.h>
+#include <src/common/slurm_protocol_pack.h>
+#include <src/common/xmalloc.h>
+#include <src/common/xstring.h>
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+#define NODE_CNT	4
+#define WAIT_SEC	20	/* longest wait for a request */
+
+typedef enum {
+	NODE_REPLY,		/* answer each message */
+	NODE_CLOSE,		/* close connections without reading */
+	NODE_SILENT		/* read messages but never answer */
+} node_mode_t;
+
+typedef struct {
+	int fd;			/* listening socket */
+	uint16_t port;
+	node_mode_t mode;
+	pthread_mutex_t mutex;
+	int msg_cnt;		/* messages received */
+	int bad_cnt;		/* messages which could not be unpacked */
+	int fwd_cnt;		/* forward count of the last message */
+	char *fwd_nodes;	/* forward list of the last message */
+} node_t;
+
+typedef struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool done;
+	List ret_list;
+	int rc;
+} result_t;
+
+static node_t nodes[NODE_CNT];
+
+static int _read_full(int fd, void *buf, size_t size)
+{
+	char *ptr = buf;
+	ssize_t n;
+
+	while (size) {
+		n = read(fd, ptr, size);
+		if ((n < 0) && (errno == EINTR))
+			continue;
+		if (n <= 0)
+			return -1;
+		ptr += n;
+		size -= n;
+	}
+	return 0;
+}
+
+/* Read a message as sent by msg_aio and check that it can be unpacked
+ * RET its header's protocol version, or 0 on error */
+static uint16_t _node_read(node_t *node, int fd)
+{
+	header_t header;
+	uint32_t len;
+	char *data;
+	Buf buffer;
+	void *auth_cred;
+	uint16_t version = 0;
+
+	if (_read_full(fd, &len, sizeof(len)))
+		return 0;
+	len = ntohl(len);
+	data = xmalloc(len);
+	if (_read_full(fd, data, len)) {
+		xfree(data);
+		return 0;
+	}
+	buffer = create_buf(data, len);
+	slurm_mutex_lock(&node->mutex);
+	node->msg_cnt++;
+	if ((unpack_header(&header, buffer) == SLURM_ERROR) ||
+	    !(auth_cred = g_slurm_auth_unpack(buffer))) {
+		node->bad_cnt++;
+	} else {
+		if ((header.msg_type != REQUEST_PING) ||
+		    (header.body_length != remaining_buf(buffer)))
+			node->bad_cnt++;
+		else
+			version = header.version;
+		node->fwd_cnt = header.forward.cnt;
+		xfree(node->fwd_nodes);
+		node->fwd_nodes = xstrdup(header.forward.nodelist);
+		destroy_forward(&header.forward);
+		g_slurm_auth_destroy(auth_cred);
+	}
+	slurm_mutex_unlock(&node->mutex);
+	free_buf(buffer);
+	return version;
+}
+
+static void *_node_thread(void *arg)
+{
+	node_t *node = (node_t *) arg;
+	slurm_msg_t msg;
+	uint16_t version;
+	char c;
+	int fd;
+
+	while ((fd = accept(node->fd, NULL, NULL)) >= 0) {
+		if (node->mode == NODE_CLOSE) {
+			close(fd);
+			continue;
+		}
+		if (!(version = _node_read(node, fd))) {
+			close(fd);
+			continue;
+		}
+		if (node->mode == NODE_REPLY) {
+			slurm_msg_t_init(&msg);
+			msg.conn_fd = fd;
+			msg.protocol_version = version;
+			slurm_send_rc_msg(&msg, SLURM_SUCCESS);
+		} else {
+			/* Until the engine gives up */
+			while (read(fd, &c, 1) > 0)
+				;
+		}
+		close(fd);
+	}
+	return NULL;
+}
+
+/* Create a socket listening on a free local port
+ * RET the socket or -1 on error */
+static int _node_listen(uint16_t *port)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	int fd, on = 1;
+
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+		return -1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(*port);
+	if ((bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) ||
+	    (listen(fd, 16) < 0) ||
+	    (getsockname(fd, (struct sockaddr *) &addr, &len) < 0)) {
+		close(fd);
+		return -1;
+	}
+	*port = ntohs(addr.sin_port);
+	return fd;
+}
+
+/* Start playing node inx, on the port it was given before if any */
+static int _node_start(int inx, node_mode_t mode)
+{
+	node_t *node = &nodes[inx];
+	pthread_t tid;
+
+	node->mode = mode;
+	if ((node->fd = _node_listen(&node->port)) < 0)
+		return -1;
+	if (pthread_create(&tid, NULL, _node_thread, node))
+		return -1;
+	pthread_detach(tid);
+	return 0;
+}
+
+static void _node_stats(int inx, int *msg_cnt, int *fwd_cnt)
+{
+	slurm_mutex_lock(&nodes[inx].mutex);
+	*msg_cnt = nodes[inx].msg_cnt;
+	*fwd_cnt = nodes[inx].fwd_cnt;
+	slurm_mutex_unlock(&nodes[inx].mutex);
+}
+
+/* Write a slurm.conf naming the nodes played by this program */
+static char *_write_conf(void)
+{
+	char *conf = xstrdup("/tmp/msg_aio-test.XXXXXX");
+	FILE *fp;
+	int fd, i;
+
+	if ((fd = mkstemp(conf)) < 0) {
+		xfree(conf);
+		return NULL;
+	}
+	fp = fdopen(fd, "w");
+	fprintf(fp, "ClusterName=msgaio\n");
+	fprintf(fp, "ControlMachine=localhost\n");
+	fprintf(fp, "AuthType=auth/none\n");
+	fprintf(fp, "PluginDir=%s\n", AUTH_PLUGIN_DIR);
+	fprintf(fp, "MessageTimeout=3\n");
+	for (i = 0; i < NODE_CNT; i++) {
+		fprintf(fp, "NodeName=n%d NodeHostname=localhost "
+			"NodeAddr=127.0.0.1 Port=%u\n", i, nodes[i].port);
+	}
+	fclose(fp);
+	return conf;
+}
+
+static void _done(List ret_list, int rc, void *arg)
+{
+	result_t *result = (result_t *) arg;
+
+	slurm_mutex_lock(&result->mutex);
+	result->ret_list = ret_list;
+	result->rc = rc;
+	result->done = true;
+	pthread_cond_signal(&result->cond);
+	slurm_mutex_unlock(&result->mutex);
+}
+
+static void _result_init(result_t *result)
+{
+	memset(result, 0, sizeof(result_t));
+	slurm_mutex_init(&result->mutex);
+	pthread_cond_init(&result->cond, NULL);
+}
+
+/* Wait for a request to complete
+ * RET false if it did not in WAIT_SEC */
+static bool _result_wait(result_t *result)
+{
+	struct timespec ts;
+
+	ts.tv_sec = time(NULL) + WAIT_SEC;
+	ts.tv_nsec = 0;
+	slurm_mutex_lock(&result->mutex);
+	while (!result->done) {
+		if (pthread_cond_timedwait(&result->cond, &result->mutex,
+					   &ts) == ETIMEDOUT)
+			break;
+	}
+	slurm_mutex_unlock(&result->mutex);
+	return result->done;
+}
+
+static void _result_free(result_t *result)
+{
+	if (result->ret_list)
+		list_destroy(result->ret_list);
+	slurm_mutex_destroy(&result->mutex);
+	pthread_cond_destroy(&result->cond);
+}
+
+/* Find the response of a node in a ret_list */
+static ret_data_info_t *_find_ret(List ret_list, char *name)
+{
+	ret_data_info_t *ret_data_info;
+	ListIterator itr;
+
+	if (!ret_list)
+		return NULL;
+	itr = list_iterator_create(ret_list);
+	while ((ret_data_info = list_next(itr))) {
+		if (ret_data_info->node_name &&
+		    !strcmp(ret_data_info->node_name, name))
+			break;
+	}
+	list_iterator_destroy(itr);
+	return ret_data_info;
+}
+
+/* Check that a node answered successfully */
+static bool _ret_ok(ret_data_info_t *ret_data_info)
+{
+	return (ret_data_info &&
+		(ret_data_info->type == RESPONSE_SLURM_RC) &&
+		(slurm_get_return_code(ret_data_info->type,
+				       ret_data_info->data) == SLURM_SUCCESS));
+}
+
+static long _msec_since(struct timeval *tv1)
+{
+	struct timeval tv2;
+
+	gettimeofday(&tv2, NULL);
+	return (tv2.tv_sec - tv1->tv_sec) * 1000 +
+	       (tv2.tv_usec - tv1->tv_usec) / 1000;
+}
+
+static void _ping_init(slurm_msg_t *msg, int inx)
+{
+	slurm_msg_t_init(msg);
+	msg->msg_type = REQUEST_PING;
+	slurm_set_addr(&msg->address, nodes[inx].port, "127.0.0.1");
+}
+
+int
+main(int argc, char *argv[])
+{
+	msg_aio_t *aio;
+	result_t result;
+	slurm_msg_t msg;
+	struct timeval tv;
+	char *conf;
+	long msec;
+	int fd, i, msg_cnt, fwd_cnt;
+
+	/* n0 refuses connections until it is started by the test,
+	 * n1 closes connections, n2 answers, n3 never answers */
+	for (i = 0; i < NODE_CNT; i++)
+		slurm_mutex_init(&nodes[i].mutex);
+	if (((fd = _node_listen(&nodes[0].port)) < 0) ||
+	    (_node_start(1, NODE_CLOSE) < 0) ||
+	    (_node_start(2, NODE_REPLY) < 0) ||
+	    (_node_start(3, NODE_SILENT) < 0) ||
+	    !(conf = _write_conf())) {
+		fail("listen on local ports");
+		totals();
+		return failed;
+	}
+	close(fd);
+	setenv("SLURM_CONF", conf, 1);
+	aio = msg_aio_create(2, 16);
+
+	note("Testing connect retry");
+	{
+		_result_init(&result);
+		_ping_init(&msg, 0);
+		gettimeofday(&tv, NULL);
+		msg_aio_send_addr(aio, &msg, "n0", false, 0, _done, &result);
+		TEST(_result_wait(&result) && (result.rc == ECONNREFUSED),
+		     "refused message without response fails");
+		TEST(_msec_since(&tv) < 1000,
+		     "refused message without response not retried");
+		_result_free(&result);
+
+		_result_init(&result);
+		gettimeofday(&tv, NULL);
+		msg_aio_send_addr(aio, &msg, "n0", true, 0, _done, &result);
+		usleep(1500000);
+		TEST(_node_start(0, NODE_REPLY) == 0, "n0 started");
+		TEST(_result_wait(&result) &&
+		     _ret_ok(_find_ret(result.ret_list, "n0")),
+		     "refused connection retried");
+		note("response after %ld msec", _msec_since(&tv));
+		_result_free(&result);
+	}
+
+	note("Testing tree fallback");
+	{
+		hostlist_t hl = hostlist_create("n[1-2],n0");
+
+		_result_init(&result);
+		_ping_init(&msg, 1);
+		msg_aio_send_tree(aio, &msg, hl, 0, _done, &result);
+		TEST(_result_wait(&result) && result.ret_list &&
+		     (list_count(result.ret_list) == 3),
+		     "response of each node");
+		TEST(!_ret_ok(_find_ret(result.ret_list, "n1")),
+		     "failed head node reported");
+		TEST(_ret_ok(_find_ret(result.ret_list, "n2")),
+		     "next node sent to");
+		TEST(_ret_ok(_find_ret(result.ret_list, "n0")),
+		     "node not forwarded to sent to");
+		_node_stats(2, &msg_cnt, &fwd_cnt);
+		TEST((msg_cnt == 1) && (fwd_cnt == 1) &&
+		     !strcmp(nodes[2].fwd_nodes, "n0"),
+		     "forward list of next node");
+		_node_stats(0, &msg_cnt, &fwd_cnt);
+		TEST((msg_cnt == 2) && (fwd_cnt == 0),
+		     "forward list of last node");
+		_result_free(&result);
+	}
+
+	note("Testing deadlines");
+	{
+		ret_data_info_t *ret_data_info;
+
+		_result_init(&result);
+		_ping_init(&msg, 3);
+		gettimeofday(&tv, NULL);
+		msg_aio_send_addr(aio, &msg, "n3", true, 500, _done, &result);
+		TEST(_result_wait(&result), "silent node request complete");
+		msec = _msec_since(&tv);
+		note("silent node given up after %ld msec", msec);
+		TEST((msec >= 450) && (msec < 2000),
+		     "response timeout honored");
+		ret_data_info = _find_ret(result.ret_list, "n3");
+		TEST(ret_data_info && (ret_data_info->err ==
+				       SLURM_PROTOCOL_SOCKET_IMPL_TIMEOUT),
+		     "timeout reported");
+		_result_free(&result);
+
+		_result_init(&result);
+		msg_aio_send_addr(aio, &msg, "n3", false, 500, _done, &result);
+		TEST(_result_wait(&result) && (result.rc == SLURM_SUCCESS),
+		     "message without response sent");
+		_result_free(&result);
+
+		/* The node may not have read the last message yet */
+		for (i = 0; i < 10; i++) {
+			_node_stats(3, &msg_cnt, &fwd_cnt);
+			if (msg_cnt == 2)
+				break;
+			usleep(100000);
+		}
+		TEST(msg_cnt == 2, "messages received by silent node");
+	}
+
+	msg_aio_destroy(aio);
+	unlink(conf);
+	xfree(conf);
+	for (i = 0; i < NODE_CNT; i++)
+		TEST(nodes[i].bad_cnt == 0, "messages unpacked");
+	totals();
+	return failed;
+}
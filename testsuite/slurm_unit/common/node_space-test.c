@@ -0,0 +1,476 @@
+/* Test and benchmark of src/plugins/sched/backfill/node_space.c
+ *
+ * The benchmark replays a queue recorded with squeue, see
+ * node_space-queue.txt, planning the pending jobs the way the backfill
+ * scheduler does with both the node_space map and the linked list of time
+ * slices which it replaced. Usage: node_space-test [queue_file]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <src/common/bitstring.h>
+#include <src/common/xmalloc.h>
+#include <src/common/xstring.h>
+#include <src/plugins/sched/backfill/node_space.h>
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+#define BASE_TIME	1420070417	/* not a multiple of the resolution */
+#define WINDOW		(24 * 60 * 60)
+
+typedef struct queue_job {
+	bool running;
+	uint32_t node_cnt;
+	uint32_t duration;	/* time left if running, else time limit */
+} queue_job_t;
+
+/* The time slice list which node_space_t replaced, from backfill.c */
+typedef struct slice {
+	time_t begin_time;
+	time_t end_time;
+	bitstr_t *avail_bitmap;
+	int next;	/* next record, by time, zero termination */
+} slice_t;
+
+static void _slice_reserve(uint32_t start_time, uint32_t end_reserve,
+			   bitstr_t *res_bitmap, slice_t *node_space,
+			   int *node_space_recs)
+{
+	bool placed = false;
+	int i, j;
+
+	start_time = MAX(start_time, node_space[0].begin_time);
+	for (j = 0; ; ) {
+		if (node_space[j].end_time > start_time) {
+			/* insert start entry record */
+			i = *node_space_recs;
+			node_space[i].begin_time = start_time;
+			node_space[i].end_time = node_space[j].end_time;
+			node_space[j].end_time = start_time;
+			node_space[i].avail_bitmap =
+				bit_copy(node_space[j].avail_bitmap);
+			node_space[i].next = node_space[j].next;
+			node_space[j].next = i;
+			(*node_space_recs)++;
+			placed = true;
+		}
+		if (node_space[j].end_time == start_time) {
+			/* no need to insert new start entry record */
+			placed = true;
+		}
+		if (placed == true) {
+			while ((j = node_space[j].next)) {
+				if (end_reserve < node_space[j].end_time) {
+					/* insert end entry record */
+					i = *node_space_recs;
+					node_space[i].begin_time = end_reserve;
+					node_space[i].end_time = node_space[j].
+								 end_time;
+					node_space[j].end_time = end_reserve;
+					node_space[i].avail_bitmap =
+						bit_copy(node_space[j].
+							 avail_bitmap);
+					node_space[i].next = node_space[j].next;
+					node_space[j].next = i;
+					(*node_space_recs)++;
+					break;
+				}
+				if (end_reserve == node_space[j].end_time) {
+					break;
+				}
+			}
+			break;
+		}
+		if ((j = node_space[j].next) == 0)
+			break;
+	}
+
+	for (j = 0; ; ) {
+		if ((node_space[j].begin_time >= start_time) &&
+		    (node_space[j].end_time <= end_reserve))
+			bit_and(node_space[j].avail_bitmap, res_bitmap);
+		if ((node_space[j].begin_time >= end_reserve) ||
+		    ((j = node_space[j].next) == 0))
+			break;
+	}
+
+	/* Drop records with identical bitmaps (up to one record). */
+	for (i = 0; ; ) {
+		if ((j = node_space[i].next) == 0)
+			break;
+		if (!bit_equal(node_space[i].avail_bitmap,
+			       node_space[j].avail_bitmap)) {
+			i = j;
+			continue;
+		}
+		node_space[i].end_time = node_space[j].end_time;
+		node_space[i].next = node_space[j].next;
+		FREE_NULL_BITMAP(node_space[j].avail_bitmap);
+		break;
+	}
+}
+
+static time_t _slice_avail(slice_t *node_space, bitstr_t *avail_bitmap,
+			   time_t start_res, time_t end_time)
+{
+	time_t later_start = 0;
+	int j;
+
+	for (j = 0; ; ) {
+		if ((node_space[j].end_time > start_res) &&
+		     node_space[j].next && (later_start == 0))
+			later_start = node_space[j].end_time;
+		if (node_space[j].end_time <= start_res)
+			;
+		else if (node_space[j].begin_time <= end_time) {
+			bit_and(avail_bitmap,
+				node_space[j].avail_bitmap);
+		} else
+			break;
+		if ((j = node_space[j].next) == 0)
+			break;
+	}
+	return later_start;
+}
+
+static long _usec_since(struct timeval *tv1)
+{
+	struct timeval tv2;
+
+	gettimeofday(&tv2, NULL);
+	return (tv2.tv_sec - tv1->tv_sec) * 1000000 +
+	       (tv2.tv_usec - tv1->tv_usec);
+}
+
+/* Convert squeue's "days-hours:minutes:seconds" to seconds */
+static uint32_t _parse_time(char *str)
+{
+	uint32_t days = 0, val[3] = {0, 0, 0};
+	int cnt = 0;
+	char *ptr;
+
+	if ((ptr = strchr(str, '-'))) {
+		days = atoi(str);
+		str = ptr + 1;
+	}
+	while (*str && (cnt < 3)) {
+		val[cnt++] = strtoul(str, &ptr, 10);
+		if (*ptr != ':')
+			break;
+		str = ptr + 1;
+	}
+	if (cnt == 3)
+		return (days * 86400) + (val[0] * 3600) + (val[1] * 60) +
+		       val[2];
+	if (cnt == 2)
+		return (days * 86400) + (val[0] * 60) + val[1];
+	return (days * 86400) + (val[0] * 60);
+}
+
+static queue_job_t *_read_queue(char *file_name, int *job_cnt, int *node_cnt,
+				uint32_t *resolution)
+{
+	FILE *fp;
+	char line[256], state[16], nodes[16], left[32], limit[32];
+	queue_job_t *jobs = NULL;
+	int size = 0;
+
+	*job_cnt = 0;
+	if (!(fp = fopen(file_name, "r")))
+		return NULL;
+	while (fgets(line, sizeof(line), fp)) {
+		if (line[0] == '#')
+			continue;
+		if (sscanf(line, "nodes %d", node_cnt) == 1)
+			continue;
+		if (sscanf(line, "resolution %u", resolution) == 1)
+			continue;
+		if (sscanf(line, "%15s %15s %31s %31s",
+			   state, nodes, left, limit) != 4)
+			continue;
+		if (*job_cnt >= size) {
+			size = MAX(size * 2, 1024);
+			xrealloc(jobs, sizeof(queue_job_t) * size);
+		}
+		jobs[*job_cnt].running = (strcmp(state, "R") == 0);
+		jobs[*job_cnt].node_cnt = atoi(nodes);
+		if (jobs[*job_cnt].running)
+			jobs[*job_cnt].duration = _parse_time(left);
+		else
+			jobs[*job_cnt].duration = _parse_time(limit);
+		(*job_cnt)++;
+	}
+	fclose(fp);
+	return jobs;
+}
+
+/* Plan the queue's jobs using either the node_space map or the time slice
+ * list, recording each pending job's planned start time and first node */
+static long _replay(queue_job_t *jobs, int job_cnt, int node_cnt,
+		    uint32_t resolution, bool use_map, time_t *start,
+		    int *first_node, int *recs)
+{
+	time_t now = BASE_TIME, window_end = BASE_TIME + WINDOW;
+	time_t start_res, end_time, start_time, end_reserve, later_start;
+	node_space_t *node_space = NULL;
+	slice_t *slices = NULL;
+	bitstr_t *all_bitmap, *idle_bitmap, *avail_bitmap, *res_bitmap;
+	struct timeval tv;
+	int i, slice_recs = 1;
+
+	all_bitmap = bit_alloc(node_cnt);
+	bit_nset(all_bitmap, 0, node_cnt - 1);
+	idle_bitmap = bit_copy(all_bitmap);
+	avail_bitmap = bit_alloc(node_cnt);
+
+	gettimeofday(&tv, NULL);
+	if (use_map) {
+		node_space = node_space_create(now, window_end, resolution,
+					       all_bitmap);
+	} else {
+		slices = xmalloc(sizeof(slice_t) * (job_cnt * 2 + 1));
+		slices[0].begin_time = now;
+		slices[0].end_time = window_end;
+		slices[0].avail_bitmap = bit_copy(all_bitmap);
+		slices[0].next = 0;
+	}
+
+	/* Nodes of running jobs are reserved until the job ends */
+	for (i = 0; i < job_cnt; i++) {
+		if (!jobs[i].running)
+			continue;
+		res_bitmap = bit_pick_cnt(idle_bitmap, jobs[i].node_cnt);
+		if (!res_bitmap)
+			continue;
+		bit_not(res_bitmap);
+		bit_and(idle_bitmap, res_bitmap);
+		end_reserve = now + jobs[i].duration + resolution - 1;
+		end_reserve = (end_reserve / resolution) * resolution;
+		if (use_map) {
+			node_space_reserve(node_space, now, end_reserve,
+					   res_bitmap);
+		} else {
+			_slice_reserve(now, end_reserve, res_bitmap, slices,
+				       &slice_recs);
+		}
+		FREE_NULL_BITMAP(res_bitmap);
+	}
+
+	/* Pending jobs start at the first time with enough free nodes */
+	for (i = 0; i < job_cnt; i++) {
+		start[i] = 0;
+		first_node[i] = -1;
+		if (jobs[i].running)
+			continue;
+		start_res = now;
+		while (start_res) {
+			end_time = start_res + jobs[i].duration;
+			bit_copybits(avail_bitmap, all_bitmap);
+			if (use_map) {
+				later_start = node_space_next_window(
+					node_space, all_bitmap,
+					jobs[i].node_cnt, start_res,
+					jobs[i].duration);
+				node_space_avail(node_space, avail_bitmap,
+						 start_res, end_time);
+			} else {
+				later_start = _slice_avail(slices,
+							   avail_bitmap,
+							   start_res,
+							   end_time);
+			}
+			if (bit_set_count(avail_bitmap) >= jobs[i].node_cnt)
+				break;
+			start_res = later_start;
+		}
+		if (start_res == 0)
+			continue;
+
+		res_bitmap = bit_pick_cnt(avail_bitmap, jobs[i].node_cnt);
+		start[i] = start_res;
+		first_node[i] = bit_ffs(res_bitmap);
+		bit_not(res_bitmap);
+		start_time  = (start_res / resolution) * resolution;
+		end_reserve = start_res + jobs[i].duration;
+		end_reserve = (end_reserve / resolution) * resolution;
+		if (use_map) {
+			node_space_reserve(node_space, start_time, end_reserve,
+					   res_bitmap);
+		} else {
+			_slice_reserve(start_time, end_reserve, res_bitmap,
+				       slices, &slice_recs);
+		}
+		FREE_NULL_BITMAP(res_bitmap);
+	}
+
+	if (use_map) {
+		*recs = node_space_recs(node_space);
+		node_space_destroy(node_space);
+	} else {
+		*recs = slice_recs;
+		for (i = 0; ; ) {
+			FREE_NULL_BITMAP(slices[i].avail_bitmap);
+			if ((i = slices[i].next) == 0)
+				break;
+		}
+		xfree(slices);
+	}
+	FREE_NULL_BITMAP(all_bitmap);
+	FREE_NULL_BITMAP(idle_bitmap);
+	FREE_NULL_BITMAP(avail_bitmap);
+	return _usec_since(&tv);
+}
+
+static int _count_slice(time_t begin_time, time_t end_time,
+			bitstr_t *avail_bitmap, void *arg)
+{
+	(*(int *) arg)++;
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	note("Testing basic functions");
+	{
+		time_t now = BASE_TIME;
+		node_space_t *node_space;
+		bitstr_t *all_bitmap = bit_alloc(16);
+		bitstr_t *res_bitmap = bit_alloc(16);
+		bitstr_t *test_bitmap = bit_alloc(16);
+		int slice_cnt = 0;
+
+		bit_nset(all_bitmap, 0, 15);
+		node_space = node_space_create(now, now + 3600, 60, all_bitmap);
+		TEST(node_space_recs(node_space) == 1, "one slice");
+
+		/* Reserve nodes 0-7 from 600 to 1200 seconds after
+		 * the resolution preceding now */
+		bit_nset(res_bitmap, 8, 15);
+		node_space_reserve(node_space, now - 17 + 600,
+				   now - 17 + 1200, res_bitmap);
+		TEST(node_space_recs(node_space) == 3, "three slices");
+
+		bit_copybits(test_bitmap, all_bitmap);
+		node_space_avail(node_space, test_bitmap, now, now + 500);
+		TEST(bit_set_count(test_bitmap) == 16, "free before");
+		node_space_avail(node_space, test_bitmap, now, now + 900);
+		TEST(bit_set_count(test_bitmap) == 8, "reserved during");
+		bit_copybits(test_bitmap, all_bitmap);
+		node_space_avail(node_space, test_bitmap, now - 17 + 1200,
+				 now + 3600);
+		TEST(bit_set_count(test_bitmap) == 16, "free after");
+
+		TEST(node_space_next_window(node_space, all_bitmap, 16, now,
+					    60) == now - 17 + 1200,
+		     "window at release");
+		TEST(node_space_next_window(node_space, all_bitmap, 16,
+					    now - 17 + 1200, 60) == 0,
+		     "no later window");
+
+		bit_clear_all(test_bitmap);
+		bit_set(test_bitmap, 3);
+		TEST(node_space_overlap(node_space, test_bitmap,
+					now - 17 + 1140, now - 17 + 1260),
+		     "reserved node overlaps");
+		TEST(!node_space_overlap(node_space, test_bitmap,
+					 now - 17 + 1200, now - 17 + 1800),
+		     "no overlap after");
+		TEST(node_space_conflict(node_space, test_bitmap, now,
+					 now + 3600) == now - 17 + 600,
+		     "conflict at reservation start");
+		bit_clear_all(test_bitmap);
+		bit_set(test_bitmap, 12);
+		TEST(node_space_conflict(node_space, test_bitmap, now,
+					 now + 3600) == 0,
+		     "no conflict on free node");
+
+		(void) node_space_walk(node_space, _count_slice, &slice_cnt);
+		TEST(slice_cnt == 3, "walk three slices");
+
+		/* Reservation shorter than the resolution */
+		bit_nset(res_bitmap, 0, 15);
+		bit_clear(res_bitmap, 15);
+		node_space_reserve(node_space, now - 17 + 2400,
+				   now - 17 + 2400, res_bitmap);
+		bit_clear_all(test_bitmap);
+		bit_set(test_bitmap, 15);
+		TEST(node_space_overlap(node_space, test_bitmap,
+					now - 17 + 2400, now - 17 + 2460),
+		     "short reservation held");
+
+		node_space_destroy(node_space);
+		FREE_NULL_BITMAP(all_bitmap);
+		FREE_NULL_BITMAP(res_bitmap);
+		FREE_NULL_BITMAP(test_bitmap);
+	}
+	note("Replaying queue");
+	{
+		char *file_name = NULL, *srcdir;
+		queue_job_t *jobs;
+		int i, job_cnt, node_cnt = 0, list_recs, map_recs;
+		int mismatch = 0, planned = 0;
+		uint32_t resolution = 60;
+		time_t *list_start, *map_start;
+		int *list_node, *map_node;
+		long list_usec, map_usec;
+
+		if (argc > 1) {
+			file_name = xstrdup(argv[1]);
+		} else {
+			if (!(srcdir = getenv("srcdir")))
+				srcdir = ".";
+			file_name = xstrdup_printf("%s/node_space-queue.txt",
+						   srcdir);
+		}
+		jobs = _read_queue(file_name, &job_cnt, &node_cnt,
+				   &resolution);
+		TEST(jobs && job_cnt && node_cnt, "read queue");
+		if (!jobs || !job_cnt || !node_cnt) {
+			xfree(file_name);
+			totals();
+			return failed;
+		}
+
+		list_start = xmalloc(sizeof(time_t) * job_cnt);
+		map_start  = xmalloc(sizeof(time_t) * job_cnt);
+		list_node  = xmalloc(sizeof(int) * job_cnt);
+		map_node   = xmalloc(sizeof(int) * job_cnt);
+		list_usec = _replay(jobs, job_cnt, node_cnt, resolution, false,
+				    list_start, list_node, &list_recs);
+		map_usec  = _replay(jobs, job_cnt, node_cnt, resolution, true,
+				    map_start, map_node, &map_recs);
+		for (i = 0; i < job_cnt; i++) {
+			if (map_start[i])
+				planned++;
+			if ((list_start[i] != map_start[i]) ||
+			    (list_node[i] != map_node[i]))
+				mismatch++;
+		}
+		note("%d jobs on %d nodes, %d planned in window",
+		     job_cnt, node_cnt, planned);
+		note("time slice list: %ld usec, %d records",
+		     list_usec, list_recs);
+		note("node_space map:  %ld usec, %d records",
+		     map_usec, map_recs);
+		TEST(mismatch == 0, "same plan from both");
+
+		xfree(list_start);
+		xfree(map_start);
+		xfree(list_node);
+		xfree(map_node);
+		xfree(jobs);
+		xfree(file_name);
+	}
+	totals();
+	return failed;
+}
@@ -15,8 +15,12 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <slurm/slurm_errno.h>
+#include <src/common/forward.h>
 #include <src/common/pack.h>
+#include <src/common/slurm_protocol_pack.h>
 #include <src/common/xmalloc.h>
+#include <src/common/xstring.h>
 
 #include <testsuite/dejagnu.h>
 
@@ -95,6 +99,182 @@ int main (int argc, char *argv[])
 	xfree(outstring);
 
 	free_buf(buffer);
+
+	buffer = init_buf(0);
+	pack8('a', buffer);
+	TEST(get_buf_digest(buffer, 0) != 0xaf63dc4c8601ec8cULL,
+	     "get_buf_digest");
+	TEST(get_buf_digest(buffer, 1) != 0xcbf29ce484222325ULL,
+	     "get_buf_digest of nothing");
+	free_buf(buffer);
+
+	{
+		BufChain chain = init_buf_chain();
+		BufShared shared;
+		struct iovec iov[8];
+		char caller_mem[] = "0123456789";
+		int iov_cnt;
+
+		pack32(0x01020304, buf_chain_tail(chain));
+		buf_chain_append_mem(chain, caller_mem, 10);
+		shared = create_buf_shared(xstrdup("shared"), 6);
+		buf_chain_append_shared(chain, shared);
+		buf_chain_append_shared(chain, shared);
+		release_buf_shared(shared);	/* chain still holds it */
+		pack8('z', buf_chain_tail(chain));
+		TEST(size_buf_chain(chain) != 4 + 10 + 6 + 6 + 1,
+		     "size_buf_chain");
+		iov_cnt = buf_chain_iovec(chain, iov);
+		TEST(iov_cnt != 5, "buf_chain_iovec count");
+		TEST(iov[1].iov_base != caller_mem, "buf_chain mem not copied");
+		TEST(memcmp(iov[3].iov_base, "shared", 6) != 0,
+		     "buf_chain shared data");
+		TEST(*(char *) iov[4].iov_base != 'z', "buf_chain_tail");
+		free_buf_chain(chain);
+	}
+
+	{
+		uint64_t hits, misses, bytes, hits2, misses2, bytes2;
+		uint32_t cnt, cnt2;
+		char *data, *data2;
+		int i;
+
+		buffer = init_buf_pooled(100);
+		TEST(size_buf(buffer) != BUF_SIZE, "init_buf_pooled size");
+		for (i = 0; i < BUF_SIZE; i++)
+			pack32(i, buffer);
+		TEST(size_buf(buffer) != BUF_SIZE * 4,
+		     "pooled buffer grows by size class");
+		data = get_buf_data(buffer);
+		get_buf_pool_stats(&hits, &misses, &cnt, &bytes);
+		free_buf(buffer);
+		get_buf_pool_stats(&hits2, &misses2, &cnt2, &bytes2);
+		TEST((cnt2 != cnt + 1) || (bytes2 != bytes + BUF_SIZE * 4),
+		     "free_buf returns data to pool");
+		data2 = buf_pool_alloc(BUF_SIZE * 2 + 1);
+		get_buf_pool_stats(&hits, &misses, &cnt, &bytes);
+		TEST((data2 != data) || (hits != hits2 + 1),
+		     "buf_pool_alloc reuses data");
+		buf_pool_free(data2);
+		data = buf_pool_alloc(BUF_SIZE * 128);
+		TEST(xsize(data) != BUF_SIZE * 128, "buf_pool_alloc large");
+		buf_pool_free(data);
+		get_buf_pool_stats(&hits2, &misses2, &cnt2, &bytes2);
+		TEST((misses2 != misses + 1) || (cnt2 != cnt + 1),
+		     "large buffers not retained");
+	}
+
+	{
+		char *data[256];
+		uint32_t cnt, cnt2;
+		uint64_t hits, misses, bytes;
+		int i;
+
+		/* Sized for 100 threads, 200 buffers of the smallest size */
+		set_buf_pool_threads(100);
+		for (i = 0; i < 256; i++)
+			data[i] = buf_pool_alloc(100);
+		get_buf_pool_stats(&hits, &misses, &cnt, &bytes);
+		for (i = 0; i < 256; i++)
+			buf_pool_free(data[i]);
+		get_buf_pool_stats(&hits, &misses, &cnt2, &bytes);
+		TEST(cnt2 - cnt != 200, "set_buf_pool_threads");
+	}
+
+	{
+		BufChain chain = init_buf_chain();
+		char *data = xmalloc(BUF_SIZE * 4);
+		uint32_t i, out;
+
+		for (i = 0; i < BUF_SIZE; i++)
+			pack32(i % 100, buf_chain_tail(chain));
+		buf_chain_append_mem(chain, data, BUF_SIZE * 4);
+		TEST(buf_chain_compress(chain, 2 * BUF_SIZE) != SLURM_SUCCESS,
+		     "buf_chain_compress");
+		TEST(size_buf_chain(chain) >= 3 * BUF_SIZE,
+		     "buf_chain_compress size");
+		buffer = init_buf(BUF_SIZE);
+		for (i = 0; i < chain->seg_cnt; i++) {
+			Buf seg = chain->seg[i].buf;
+			packmem_array(get_buf_data(seg), get_buf_offset(seg),
+				      buffer);
+		}
+		free_buf_chain(chain);
+		i = get_buf_offset(buffer);
+		buffer = create_buf(xfer_buf_data(buffer), i);
+		set_buf_offset(buffer, 2 * BUF_SIZE);
+		TEST(buf_decompress(buffer) != SLURM_SUCCESS, "buf_decompress");
+		TEST(remaining_buf(buffer) != 6 * BUF_SIZE,
+		     "buf_decompress size");
+		set_buf_offset(buffer, 0);
+		for (i = 0; i < BUF_SIZE; i++) {
+			unpack32(&out, buffer);
+			if (out != i % 100)
+				break;
+		}
+		TEST(i != BUF_SIZE, "buf_decompress data");
+		TEST(memcmp(&buffer->head[buffer->processed], data,
+			    BUF_SIZE * 4), "buf_decompress data");
+		free_buf(buffer);
+		xfree(data);
+	}
+
+	{
+		header_t header, header2;
+
+		memset(&header, 0, sizeof(header_t));
+		forward_init(&header.forward, NULL);
+		header.version = SLURM_PROTOCOL_VERSION;
+		header.flags = SLURM_MSG_SESSION;
+		header.msg_type = REQUEST_PING;
+		header.msg_id = 4242;
+		header.body_length = 7;
+		buffer = init_buf(0);
+		pack_header(&header, buffer);
+		set_buf_offset(buffer, 0);
+		TEST(unpack_header(&header2, buffer) != SLURM_SUCCESS,
+		     "unpack_header of session message");
+		TEST((header2.msg_id != 4242) || (header2.body_length != 7),
+		     "session header msg_id");
+		free_buf(buffer);
+	}
+
+	{
+		ping_slurmd_aggr_msg_t aggr, *aggr2;
+		ret_data_info_t *ret_data_info;
+		uint32_t cpu_load[3] = { 100, 0, 4200 };
+		slurm_msg_t msg;
+		List ret_list;
+
+		aggr.node_cnt = 3;
+		aggr.cpu_load = cpu_load;
+		slurm_msg_t_init(&msg);
+		msg.msg_type = RESPONSE_PING_AGGREGATE;
+		msg.data = &aggr;
+		buffer = init_buf(0);
+		TEST(pack_msg(&msg, buffer) != SLURM_SUCCESS,
+		     "pack ping aggregate");
+		set_buf_offset(buffer, 0);
+		msg.data = NULL;
+		TEST(unpack_msg(&msg, buffer) != SLURM_SUCCESS,
+		     "unpack ping aggregate");
+		aggr2 = msg.data;
+		TEST((aggr2->node_cnt != 3) || (aggr2->cpu_load[2] != 4200),
+		     "ping aggregate loads");
+		free_buf(buffer);
+
+		ret_list = list_create(destroy_data_info);
+		ret_data_info = xmalloc(sizeof(ret_data_info_t));
+		ret_data_info->type = RESPONSE_PING_AGGREGATE;
+		ret_data_info->node_name = xstrdup("n[1-3]");
+		ret_data_info->data = aggr2;
+		list_push(ret_list, ret_data_info);
+		mark_as_failed_forward(&ret_list, "n4", SLURM_ERROR);
+		TEST(ret_list_node_count(ret_list) != 4,
+		     "ret_list_node_count of ping aggregate");
+		list_destroy(ret_list);
+	}
+
 	totals();
 	return failed;
 